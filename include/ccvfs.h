@@ -179,6 +179,295 @@ typedef struct {
 
 int sqlite3_ccvfs_get_stats(const char *compressed_db, CCVFSStats *stats);
 
+/*
+ * 离线压缩进度回调，大约每完成百分之一的块调用一次，结束时再调用一次
+ * Offline compression progress callback, called about once per percent of the blocks and once at the end
+ *   pArg - Context from the options
+ *   nDone - Blocks written so far
+ *   nTotal - Blocks of the database
+ */
+typedef void (*CCVFSProgressCallback)(void *pArg, uint32_t nDone, uint32_t nTotal);
+
+/*
+ * 并行离线压缩选项
+ * Parallel offline compression options
+ */
+typedef struct {
+    const char *compress_algorithm;   // "zlib", NULL or "none" for no compression
+    const char *encrypt_algorithm;    // "aes128", "aes256", NULL for no encryption
+    uint32_t page_size;               // CCVFS block size, 0 for CCVFS_DEFAULT_PAGE_SIZE
+    int compression_level;            // 1-9, 0 for the VFS default
+    const unsigned char *key;         // Encryption key, required with an encryption algorithm
+    int key_len;
+    int threads;                      // Encoding workers, 0 for one per online CPU
+    CCVFSProgressCallback xProgress;  // Progress callback (or NULL)
+    void *pProgressArg;
+} CCVFSCompressOptions;
+
+/*
+ * 并行流水线压缩一个SQLite数据库
+ * Compress a SQLite database through a parallel pipeline
+ * 源文件按块顺序读取（持有读事务，WAL中的帧先检查点到主文件），N个工作线程压缩并加密，
+ * 写入线程按块顺序连续排布数据，最后一次性写入索引表和文件头。
+ * The source file is read block by block under a read transaction (frames in its WAL are
+ * checkpointed into the main file first), N workers compress and encrypt the blocks, and the
+ * writer lays them out contiguously in block order, then writes the index table and the
+ * header once. The result is the same format the VFS writes and opens with a matching VFS.
+ * Parameters:
+ *   source_db - Plain SQLite database
+ *   compressed_db - Target file, replaced if it exists and removed again on failure
+ *   pOptions - Options, NULL behaves as all fields zero
+ * Return value:
+ *   SQLITE_OK - Success
+ *   SQLITE_BUSY - The source WAL could not be checkpointed
+ *   SQLITE_FULL - The database needs more than 65536 blocks of this size
+ *   Other values - Error code
+ */
+int sqlite3_ccvfs_compress_database_parallel(
+    const char *source_db,
+    const char *compressed_db,
+    const CCVFSCompressOptions *pOptions
+);
+
+/*
+ * 并行解压选项
+ * Parallel decompression options
+ */
+typedef struct {
+    const char *vfs_name;             // CCVFS to read through, NULL to take the algorithms from the file header
+    const unsigned char *key;         // Decryption key without vfs_name, required for encrypted files
+    int key_len;
+    int threads;                      // Decoding workers, 0 for one per online CPU
+    int direct_io;                    // Write the output with O_DIRECT where the file system allows it
+    CCVFSProgressCallback xProgress;  // Progress callback (or NULL)
+    void *pProgressArg;
+} CCVFSDecompressOptions;
+
+/*
+ * 直接转码：把CCVFS文件还原为普通SQLite数据库
+ * Transcode a CCVFS file straight back into a plain SQLite database
+ * 在读事务下直接读取索引表，按物理偏移顺序读取数据块，N个工作线程校验、解密和解压，
+ * 写入线程把逻辑上连续的块合并成大块对齐写入。稀疏块在输出中保留为空洞。
+ * Under a read transaction the index table is read directly, stored blocks are read in
+ * physical offset order, N workers verify, decrypt and decompress them, and the writer merges
+ * logically consecutive blocks into large aligned writes. Sparse blocks stay holes in the output.
+ * Parameters:
+ *   compressed_db - CCVFS database
+ *   output_db - Target file, replaced if it exists and removed again on failure; its stale
+ *               -journal, -wal and -shm files are removed
+ *   pOptions - Options, NULL behaves as all fields zero
+ * Return value:
+ *   SQLITE_OK - Success
+ *   SQLITE_BUSY - The source WAL could not be checkpointed
+ *   SQLITE_CORRUPT - A block failed its checksum or did not decode
+ *   SQLITE_MISUSE - The file is encrypted and no key was given
+ *   Other values - Error code
+ */
+int sqlite3_ccvfs_decompress_database_parallel(
+    const char *compressed_db,
+    const char *output_db,
+    const CCVFSDecompressOptions *pOptions
+);
+
+/*
+ * 重新压缩选项；目标配置中为零或NULL的字段沿用源文件的设置
+ * Recompression options, zero or NULL target fields keep the setting of the source file
+ */
+typedef struct {
+    const char *vfs_name;             // CCVFS to read the source through, NULL to take the algorithms from its header
+    const unsigned char *key;         // Source key without vfs_name, required for encrypted sources
+    int key_len;
+    const char *compress_algorithm;   // Target: "zlib", "none", NULL keeps the source algorithm
+    const char *encrypt_algorithm;    // Target: "aes128", "aes256", "none", NULL keeps the source algorithm
+    uint32_t page_size;               // Target CCVFS block size, 0 keeps the source block size
+    int compression_level;            // 1-9, 0 keeps the level of the source blocks
+    const unsigned char *target_key;  // Target key, NULL keeps the source key
+    int target_key_len;
+    int threads;                      // Recoding workers, 0 for one per online CPU
+    CCVFSProgressCallback xProgress;  // Progress callback in target blocks (or NULL)
+    void *pProgressArg;
+} CCVFSRecompressOptions;
+
+/*
+ * 流式重新压缩：把CCVFS文件直接转码为另一种配置的CCVFS文件
+ * Streaming recompression: transcode a CCVFS file straight into a CCVFS file of another configuration
+ * 不经过普通数据库中转。在读事务下读取源文件的索引表，按逻辑顺序读取数据块，N个工作线程
+ * 校验、解码并按新的算法、等级和块大小重新编码，写入线程按块顺序连续排布。源数据库可以
+ * 正在使用：WAL模式下写入者在复制期间继续向WAL提交，输出是读事务开始时的快照；回滚日志
+ * 模式下写入者等待复制结束。
+ * No plain copy is made on the way. Under a read transaction the index table of the source is
+ * read, stored blocks are read in logical order, N workers verify and decode them and encode
+ * them again with the new algorithms, level and block size, and the writer lays the result out
+ * contiguously in block order. The source may be in use: in WAL mode writers go on committing
+ * to the WAL during the copy and the output is the snapshot the read transaction started on,
+ * in rollback journal mode writers wait until the copy is done.
+ * Parameters:
+ *   source_db - CCVFS database
+ *   target_db - Target file, replaced if it exists and removed again on failure; its stale
+ *               -journal, -wal and -shm files are removed
+ *   pOptions - Options, NULL keeps every setting and only rewrites the layout
+ * Return value:
+ *   SQLITE_OK - Success
+ *   SQLITE_BUSY - The source WAL could not be checkpointed or the source changed during the copy
+ *   SQLITE_CORRUPT - A block failed its checksum or did not decode
+ *   SQLITE_FULL - The database needs more than 65536 blocks of the target size
+ *   SQLITE_MISUSE - A key is missing or the target is the source
+ *   Other values - Error code
+ */
+int sqlite3_ccvfs_recompress(
+    const char *source_db,
+    const char *target_db,
+    const CCVFSRecompressOptions *pOptions
+);
+
+/*
+ * 页级校验选项
+ * Page-level verification options
+ */
+typedef struct {
+    const char *vfs_name;             // CCVFS whose algorithms and key to use, NULL to take the algorithms from the file header
+    const unsigned char *key;         // Key without vfs_name; without any key encrypted blocks are only checksummed
+    int key_len;
+    int threads;                      // Verifying workers, 0 for one per online CPU
+    CCVFSProgressCallback xProgress;  // Progress callback in stored blocks (or NULL)
+    void *pProgressArg;
+} CCVFSVerifyOptions;
+
+#define CCVFS_VERIFY_MAX_REPORTED 32  // Corrupt block numbers kept in CCVFSVerifyResult
+
+/*
+ * 页级校验结果
+ * Page-level verification result
+ */
+typedef struct {
+    uint64_t file_size;
+    uint32_t block_size;              // CCVFS block size
+    uint32_t total_blocks;            // Index entries in use
+    uint32_t stored_blocks;           // Blocks with data in the file
+    uint32_t sparse_blocks;           // Sparse or never written blocks
+    uint64_t stored_bytes;            // Bytes the index references
+    uint32_t checksum_errors;         // Stored bytes do not match the index checksum
+    uint32_t decode_errors;           // Decryption or decompression failed or gave the wrong size
+    uint32_t invalid_entries;         // Index entries pointing outside the data area
+    uint32_t overlapping_extents;     // Stored blocks that overlap the block before them in the file
+    uint32_t unreferenced_extents;    // Gaps in the data area no index entry references
+    uint64_t unreferenced_bytes;
+    int decoded;                      // Blocks were decrypted and decompressed, not only checksummed
+    int threads;
+    uint32_t corrupt_count;           // Blocks with a checksum error, a decode error or an invalid entry
+    uint32_t corrupt_blocks[CCVFS_VERIFY_MAX_REPORTED];  // Up to CCVFS_VERIFY_MAX_REPORTED of them, ascending
+} CCVFSVerifyResult;
+
+/*
+ * 页级校验：不经过SQL检查CCVFS文件的每个数据块
+ * Page-level verification: check every stored block of a CCVFS file without going through SQL
+ * 在共享锁下直接读取文件头和索引表，按物理偏移顺序把相邻的数据块合并成大块顺序读取，
+ * N个工作线程检查校验和、解密和解压。另外报告越界的索引条目、相互重叠的数据块和没有被
+ * 引用的空间。文件在检查期间被检查点改写时返回SQLITE_BUSY，可以重试。
+ * Under a shared lock the header and the index table are read directly, stored blocks are read
+ * in physical offset order with neighbouring blocks merged into large sequential reads, and N
+ * workers check checksums, decryption and decompression. Index entries outside the data area,
+ * overlapping blocks and unreferenced space are reported as well. SQLITE_BUSY means a checkpoint
+ * rewrote the file during the check, which can be retried.
+ * Parameters:
+ *   path - CCVFS database
+ *   pOptions - Options, NULL behaves as all fields zero
+ *   pResult - Receives the findings, also when the file is corrupt
+ * Return value:
+ *   SQLITE_OK - Every stored block is intact; unreferenced space alone is not an error
+ *   SQLITE_CORRUPT - Corrupt blocks, invalid index entries, overlapping blocks or an invalid header
+ *   SQLITE_NOTADB - The file is not a CCVFS file
+ *   SQLITE_BUSY - The file changed while it was checked
+ *   Other values - Error code
+ */
+int sqlite3_ccvfs_verify(
+    const char *path,
+    const CCVFSVerifyOptions *pOptions,
+    CCVFSVerifyResult *pResult
+);
+
+/*
+ * 原始热备份选项
+ * Raw hot backup options
+ */
+typedef struct {
+    int compact;                      // Lay the stored blocks out back to back in block order
+    int verify;                       // Check the checksum of every stored block while it is copied
+    CCVFSProgressCallback xProgress;  // Progress callback in stored blocks (or NULL)
+    void *pProgressArg;
+} CCVFSBackupOptions;
+
+/*
+ * 原始热备份：不解码地复制压缩数据块和索引表
+ * Raw hot backup: copy the stored blocks and the index table without decoding them
+ * 在自己的读事务下（WAL中的帧先检查点到主文件）按物理偏移顺序复制被索引引用的数据块，
+ * 不解压、不解密也不重新编码。默认保持原偏移，未引用的空间在副本中为空洞；compact时
+ * 按块顺序紧密排列并改写索引偏移。副本由与源相同算法和密钥的VFS打开。
+ * Under a read transaction of its own (WAL frames are checkpointed into the main file first)
+ * the blocks the index references are copied in physical offset order, never decompressed,
+ * decrypted or encoded again. By default they keep their offsets and unreferenced space becomes
+ * holes in the copy; with compact they are packed back to back in block order and the index
+ * offsets are rewritten. The copy opens with a VFS of the same algorithms and key as the source.
+ * Parameters:
+ *   db - Connection whose main database is a CCVFS file, it may be inside a read transaction
+ *   dst_path - Target file, replaced if it exists and removed again on failure; its stale
+ *              -journal, -wal, -shm and shared index files are removed
+ *   pOptions - Options, NULL behaves as all fields zero
+ * Return value:
+ *   SQLITE_OK - Success
+ *   SQLITE_BUSY - A writer holds the database or its WAL could not be checkpointed
+ *   SQLITE_CORRUPT - The index is invalid, or a block failed its checksum with verify
+ *   SQLITE_MISUSE - The main database of db is not a CCVFS file
+ *   Other values - Error code
+ */
+int sqlite3_ccvfs_backup(sqlite3 *db, const char *dst_path, const CCVFSBackupOptions *pOptions);
+
+/*
+ * 增量备份：只写出索引条目与上一次备份不同的数据块
+ * Incremental backup: write out only the stored blocks whose index entry changed since an
+ * earlier backup
+ * 数据块不带序列号，上一次备份由其索引代（change_counter）和索引表标识：增量文件携带索引
+ * 条目（偏移、大小、校验和、标志）与基础不同的块和完整的目标索引。基础可以是不带compact的
+ * sqlite3_ccvfs_backup()副本、应用过增量的副本，或者上一个增量文件本身，因此每晚的增量链
+ * 不需要在本地保留完整副本。
+ * Stored blocks carry no sequence number, an earlier backup is identified by its index
+ * generation (change_counter) and index table: the delta carries the blocks whose index entry
+ * (offset, sizes, checksum, flags) differs from the base, and the whole target index. The base
+ * is a copy made by sqlite3_ccvfs_backup() without compact, a copy deltas were applied to, or
+ * the previous delta itself, so a nightly chain needs no full copy at hand.
+ * Parameters:
+ *   db - Connection whose main database is a CCVFS file
+ *   base_path - Earlier backup copy or delta
+ *   delta_path - Delta file, replaced if it exists and removed again on failure
+ *   pOptions - verify, xProgress and pProgressArg are used; compact is not allowed
+ * Return value:
+ *   SQLITE_OK - Success
+ *   SQLITE_BUSY - A writer holds the database or its WAL could not be checkpointed
+ *   SQLITE_CORRUPT - The index or base delta is invalid, or a block failed its checksum with verify
+ *   SQLITE_NOTADB - base_path is neither a CCVFS file nor a delta
+ *   SQLITE_MISUSE - db is not a CCVFS connection, compact was set, or paths coincide
+ *   Other values - Error code
+ */
+int sqlite3_ccvfs_backup_incremental(sqlite3 *db, const char *base_path, const char *delta_path,
+                                     const CCVFSBackupOptions *pOptions);
+
+/*
+ * 把增量文件应用到它所基于的备份副本上（原地修改）
+ * Apply a delta to the backup copy it was taken against, in place
+ * 先完整检查增量文件，再把副本标记为正在应用、写入变化的块和目标索引，最后写入文件头。
+ * 中断的副本不能作为数据库打开，可以再次应用同一增量。副本不能同时被打开。
+ * The whole delta is checked first, then the copy is marked as being applied to, the changed
+ * blocks and the target index are written, and the header goes last. An interrupted copy does
+ * not open as a database and takes the same delta again. The copy must not be open meanwhile.
+ * Return value:
+ *   SQLITE_OK - Success
+ *   SQLITE_CORRUPT - The delta is damaged, the copy is untouched
+ *   SQLITE_MISMATCH - The copy is not at the generation the delta was taken against
+ *   SQLITE_NOTADB - Either file has the wrong format
+ *   Other values - Error code
+ */
+int sqlite3_ccvfs_apply_delta(const char *base_path, const char *delta_path);
+
 /*
  * Configure write buffer settings for a VFS
  * Parameters:
@@ -199,6 +488,21 @@ int sqlite3_ccvfs_configure_write_buffer(
     uint32_t auto_flush_pages
 );
 
+/*
+ * Configure the shared page index for a VFS
+ * When enabled, the page index of each main database is kept in a shared memory
+ * mapping of a companion "<db>-ccvfs" file, so processes opening the same database
+ * share one copy of the index instead of loading it per connection.
+ * Only affects files opened after the call.
+ * Parameters:
+ *   zVfsName - Name of the VFS to configure
+ *   enabled - Whether to use the shared page index (0 or 1)
+ * Return value:
+ *   SQLITE_OK - Success
+ *   Other values - Error code
+ */
+int sqlite3_ccvfs_configure_shared_index(const char *zVfsName, int enabled);
+
 /*
  * Get write buffer statistics for an open database
  * Parameters:
@@ -219,6 +523,474 @@ int sqlite3_ccvfs_get_buffer_stats(
     uint32_t *total_buffered_writes
 );
 
+/*
+ * File statistics - 文件统计
+ * Lifetime counters of one open file, or totals across files for the VFS variant.
+ * All counters are 64-bit and never wrap in practice.
+ */
+typedef struct {
+    // Space management
+    uint64_t space_reuse_count;          // Pages rewritten in place
+    uint64_t space_expansion_count;      // In-place expansions
+    uint64_t new_allocation_count;       // New space allocations
+    uint64_t hole_reclaim_count;         // Holes reused for a page
+    uint64_t best_fit_count;             // Best-fit allocations
+    uint64_t sequential_write_count;     // Sequential writes detected
+    uint64_t cow_relocation_count;       // Pages moved because a concurrent reader could still see them
+
+    // Hole manager
+    uint64_t hole_allocation_count;      // Successful hole allocations
+    uint64_t hole_merge_count;           // Hole merges
+    uint64_t hole_cleanup_count;         // Small holes dropped
+
+    // Write buffer
+    uint64_t buffer_hit_count;           // Reads served from the write buffer
+    uint64_t buffer_flush_count;         // Buffer flushes
+    uint64_t buffer_merge_count;         // Writes merged into a buffered page
+    uint64_t total_buffered_writes;      // Writes that went through the buffer
+
+    // Data integrity
+    uint64_t checksum_error_count;       // Checksum mismatches
+    uint64_t corrupted_page_count;       // Corrupted pages detected
+    uint64_t recovery_attempt_count;     // Data recovery attempts
+    uint64_t successful_recovery_count;  // Successful recoveries
+
+    // Background scrubber
+    uint64_t scrubbed_block_count;       // Stored blocks whose checksum the scrubber validated
+    uint64_t scrubbed_bytes;             // Stored bytes read by the scrubber
+    uint64_t scrub_pass_count;           // Completed scrubber passes over the file
+    uint64_t trusted_read_count;         // Page reads that skipped the CRC of a recently scrubbed block
+
+    uint32_t open_files;                 // Open files included (1 for a single file)
+} CCVFSFileStats;
+
+/*
+ * Get statistics for an open database
+ * The counters are copied while writers of the file are held off, so related counters
+ * (e.g. allocations and hole reuse) come from the same moment.
+ * Parameters:
+ *   db - Open database connection
+ *   pStats - Statistics (output)
+ * Return value:
+ *   SQLITE_OK - Success
+ *   Other values - Error code
+ */
+int sqlite3_ccvfs_get_file_stats(sqlite3 *db, CCVFSFileStats *pStats);
+
+/*
+ * Get statistics aggregated over a VFS
+ * Sums the counters of every file currently open through the VFS, plus the final
+ * counters of files already closed, so the totals only ever grow.
+ * Parameters:
+ *   zVfsName - Name of the VFS
+ *   pStats - Aggregated statistics (output); open_files is the number of open files
+ * Return value:
+ *   SQLITE_OK - Success
+ *   Other values - Error code
+ */
+int sqlite3_ccvfs_get_vfs_stats(const char *zVfsName, CCVFSFileStats *pStats);
+
+/*
+ * Background scrubber - 后台巡检
+ * One low-priority thread per VFS walks the stored blocks of every open main database in
+ * physical order, holding the file's index lock shared for a bounded chunk at a time, and
+ * checks each block against the CRC32 in its index entry. Mismatches count towards
+ * checksum_error_count and corrupted_page_count once per damaged block; reads are throttled
+ * to io_budget_kb. A mismatch is only reported after a re-read while no other connection
+ * holds a RESERVED lock, so blocks rewritten by another process are not flagged.
+ *
+ * With trust_window_ms set, a page read skips the CRC of its stored block when the scrubber
+ * validated exactly that block (same offset, size and checksum) within the window. Damage is
+ * then caught by the next scrubber pass instead of the read; set the window above the time of
+ * one pass so busy pages stay trusted. Databases in WAL mode always verify the CRC, since a
+ * checkpoint on another connection can move blocks under a reader's index.
+ */
+#define CCVFS_SCRUB_DEFAULT_BUDGET_KB    4096   // 4MB of stored bytes per second
+#define CCVFS_SCRUB_DEFAULT_INTERVAL_MS  60000  // One minute between passes
+
+typedef struct {
+    uint32_t io_budget_kb;        // Stored KB read per second (0 for CCVFS_SCRUB_DEFAULT_BUDGET_KB)
+    uint32_t pass_interval_ms;    // Pause after a pass over every open file (0 for CCVFS_SCRUB_DEFAULT_INTERVAL_MS)
+    uint32_t trust_window_ms;     // Reads skip the CRC of blocks validated this recently (0 never skips)
+} CCVFSScrubOptions;
+
+/*
+ * Start, reconfigure or stop the background scrubber of a VFS
+ * New options apply to a running scrubber at its next chunk. Stopping waits for the thread
+ * and turns trusted reads off. sqlite3_ccvfs_destroy() stops the scrubber as well.
+ * Parameters:
+ *   zVfsName - Name of the VFS
+ *   pOptions - Scrubber options, NULL to stop the scrubber
+ * Return value:
+ *   SQLITE_OK - Success
+ *   SQLITE_ERROR - The VFS does not exist or is not a CCVFS
+ *   Other values - Error code
+ */
+int sqlite3_ccvfs_configure_scrubber(const char *zVfsName, const CCVFSScrubOptions *pOptions);
+
+/*
+ * Page pipeline stages timed by the latency histograms - 页面处理阶段
+ */
+typedef enum {
+    CCVFS_STAGE_READ_IO = 0,      // Physical read of a stored page
+    CCVFS_STAGE_CRC_VERIFY,       // Checksum verification on read
+    CCVFS_STAGE_DECRYPT,          // Decryption
+    CCVFS_STAGE_DECOMPRESS,       // Decompression (or copy of an uncompressed page)
+    CCVFS_STAGE_COMPRESS,         // Compression
+    CCVFS_STAGE_ENCRYPT,          // Encryption
+    CCVFS_STAGE_CRC_COMPUTE,      // Checksum computation on write
+    CCVFS_STAGE_ALLOCATE,         // Space allocation, including the allocator lock wait
+    CCVFS_STAGE_OVERLAP_CHECK,    // Overlap safety check of the chosen extent
+    CCVFS_STAGE_WRITE_IO,         // Physical write of a stored page
+    CCVFS_STAGE_READ_PAGE,        // Whole page read
+    CCVFS_STAGE_WRITE_PAGE,       // Whole page write
+    CCVFS_STAGE_COUNT
+} CCVFSStage;
+
+#define CCVFS_HISTOGRAM_BUCKETS 32  // Log2 buckets of nanoseconds, the last one is open-ended
+
+/*
+ * Latency histogram of one stage - 阶段延迟直方图
+ * buckets[0] counts samples under 1ns, buckets[i] samples in [2^(i-1), 2^i) ns,
+ * and buckets[CCVFS_HISTOGRAM_BUCKETS - 1] everything from 2^30 ns (about 1s) up.
+ */
+typedef struct {
+    uint64_t count;                              // Samples recorded
+    uint64_t total_ns;                           // Sum of all samples
+    uint64_t buckets[CCVFS_HISTOGRAM_BUCKETS];   // Log-scaled sample counts
+} CCVFSLatencyHistogram;
+
+/*
+ * Enable or disable latency histograms for a VFS
+ * Applies to the files already open through the VFS and to files opened later.
+ * When disabled, each timed stage costs one relaxed load and a branch.
+ * PRAGMA ccvfs_histograms=ON|OFF|RESET does the same for a single database, and
+ * PRAGMA ccvfs_histograms returns a per-stage report with estimated percentiles.
+ * Parameters:
+ *   zVfsName - Name of the VFS to configure
+ *   enabled - Whether to time page pipeline stages (0 or 1)
+ * Return value:
+ *   SQLITE_OK - Success
+ *   Other values - Error code
+ */
+int sqlite3_ccvfs_configure_histograms(const char *zVfsName, int enabled);
+
+/*
+ * Get the latency histograms of an open database
+ * Parameters:
+ *   db - Open database connection
+ *   aHist - Array of CCVFS_STAGE_COUNT histograms, indexed by CCVFSStage (output)
+ * Return value:
+ *   SQLITE_OK - Success
+ *   Other values - Error code
+ */
+int sqlite3_ccvfs_get_histograms(sqlite3 *db, CCVFSLatencyHistogram *aHist);
+
+/*
+ * Clear the latency histograms of an open database
+ */
+int sqlite3_ccvfs_reset_histograms(sqlite3 *db);
+
+/*
+ * Name of a stage as used in reports ("read_io", "decompress", ...), NULL if out of range
+ */
+const char *sqlite3_ccvfs_stage_name(int stage);
+
+/*
+ * Log levels - 日志级别
+ * Messages up to the current level are formatted and passed to the log callback; messages
+ * above it cost one relaxed load and a branch. The default is CCVFS_LOG_ERROR
+ * (CCVFS_LOG_DEBUG or CCVFS_LOG_VERBOSE in builds with -DDEBUG or -DVERBOSE).
+ */
+#define CCVFS_LOG_OFF      0
+#define CCVFS_LOG_ERROR    1
+#define CCVFS_LOG_INFO     2
+#define CCVFS_LOG_DEBUG    3
+#define CCVFS_LOG_VERBOSE  4
+
+/*
+ * Log callback
+ * zMsg is "function:line: message" and only valid during the call. The callback may run on
+ * any thread that uses a CCVFS file, concurrently with itself, and must not call back into CCVFS.
+ */
+typedef void (*CCVFSLogCallback)(void *pArg, int level, const char *zMsg);
+
+/*
+ * Set the process-wide log level
+ * PRAGMA ccvfs_log_level = OFF|ERROR|INFO|DEBUG|VERBOSE does the same from SQL.
+ * Parameters:
+ *   level - One of CCVFS_LOG_OFF .. CCVFS_LOG_VERBOSE
+ * Return value:
+ *   SQLITE_OK - Success
+ *   SQLITE_RANGE - Unknown level
+ */
+int sqlite3_ccvfs_set_log_level(int level);
+
+/*
+ * Get the process-wide log level
+ */
+int sqlite3_ccvfs_get_log_level(void);
+
+/*
+ * Install a log callback
+ * Passing NULL restores the default, which writes errors to stderr and everything else to stdout.
+ * Parameters:
+ *   xLog - Callback receiving every message up to the current level (or NULL)
+ *   pArg - First argument passed to the callback
+ */
+void sqlite3_ccvfs_set_log_callback(CCVFSLogCallback xLog, void *pArg);
+
+/*
+ * Page events recorded in the trace ring - 跟踪环中的页面事件
+ */
+typedef enum {
+    CCVFS_EVENT_READ = 0,         // Page read by SQLite (offset and stored size when read from disk, aux=page flags)
+    CCVFS_EVENT_WRITE,            // Page written by SQLite (offset and stored size when written directly, aux=page flags)
+    CCVFS_EVENT_ALLOCATE,         // Space chosen for a page (offset, size, aux=1 if reused space)
+    CCVFS_EVENT_FLUSH,            // Write buffer flushed (aux=pages written)
+    CCVFS_EVENT_SYNC,             // Index saved and file synced
+    CCVFS_EVENT_CHECKSUM,         // Checksum mismatch on read (offset, stored size)
+    CCVFS_EVENT_COUNT
+} CCVFSEventType;
+
+#define CCVFS_TRACE_RING_SIZE 4096  // Events kept, the oldest are overwritten
+
+/*
+ * Trace ring flags
+ */
+#define CCVFS_TRACE_ON             (1 << 0)  // Record page events
+#define CCVFS_TRACE_DUMP_ON_ERROR  (1 << 1)  // Pass the events since the last dump to the log callback after each logged error
+
+/*
+ * One recorded page event
+ */
+typedef struct {
+    uint64_t sequence;      // Event number, increasing across the process
+    uint64_t timestamp_ns;  // Monotonic clock when the operation started
+    uint64_t offset;        // Physical offset, 0 if not applicable
+    uint32_t file_id;       // Id of the file, unique within the process
+    uint32_t type;          // CCVFSEventType
+    uint32_t page;          // CCVFS page number
+    uint32_t size;          // Bytes involved
+    uint32_t aux;           // Event specific value
+    int32_t rc;             // Result code of the operation
+} CCVFSTraceEvent;
+
+/*
+ * Configure the process-wide page event ring
+ * Recording is lock-free: one relaxed load and a branch per event while off, a clock read,
+ * an atomic increment and a few relaxed stores while on.
+ * PRAGMA ccvfs_trace = ON|OFF|ERROR does the same from SQL.
+ * Parameters:
+ *   flags - CCVFS_TRACE_* flags, 0 to stop recording
+ * Return value:
+ *   The previous flags
+ */
+int sqlite3_ccvfs_trace_config(int flags);
+
+/*
+ * Copy the latest recorded events, oldest first
+ * Events being overwritten during the copy are skipped.
+ * Parameters:
+ *   aEvent - Array receiving the events (output)
+ *   nMax - Size of aEvent
+ * Return value:
+ *   Number of events copied
+ */
+int sqlite3_ccvfs_trace_read(CCVFSTraceEvent *aEvent, int nMax);
+
+/*
+ * Pass the latest nMax events to the log callback at CCVFS_LOG_INFO, whatever the log level
+ */
+void sqlite3_ccvfs_trace_dump(int nMax);
+
+/*
+ * Name of an event type as used in dumps ("read", "write", ...), NULL if out of range
+ */
+const char *sqlite3_ccvfs_event_name(int type);
+
+/*
+ * Where a page access was served - 页面访问的来源
+ * Pages found in SQLite's own page cache never reach the VFS and produce no event.
+ */
+typedef enum {
+    CCVFS_CACHE_NONE = 0,         // Not a page access (allocation, flush, sync, checksum)
+    CCVFS_CACHE_BUFFER,           // Read from, or written into, the CCVFS write buffer
+    CCVFS_CACHE_DISK,             // Stored page read and decoded, or encoded and written
+    CCVFS_CACHE_SPARSE            // All-zero page, no stored data involved
+} CCVFSCacheOutcome;
+
+/*
+ * Page I/O event passed to I/O hooks
+ * Hooks run synchronously on the thread doing the I/O, which is the thread executing the
+ * SQL statement, so a profiler can attribute events to the query it is currently timing.
+ */
+typedef struct {
+    uint32_t type;            // CCVFSEventType
+    uint32_t file_id;         // Id of the file, unique within the process
+    const char *zFile;        // File name without directory (may be NULL)
+    uint32_t page;            // CCVFS page number (0 for flush and sync)
+    uint64_t offset;          // Physical offset of the stored page, 0 if not applicable
+    uint32_t stored_size;     // Bytes stored on disk (compressed and encrypted)
+    uint32_t original_size;   // Logical bytes of the page
+    uint32_t aux;             // Event specific value, as in CCVFSTraceEvent
+    uint32_t cache;           // CCVFSCacheOutcome
+    uint64_t start_ns;        // Monotonic clock when the operation started
+    uint64_t duration_ns;     // Time spent in the operation
+    int rc;                   // Result code of the operation
+} CCVFSIoEvent;
+
+typedef void (*CCVFSIoHook)(void *pArg, const CCVFSIoEvent *pEvent);
+
+#define CCVFS_EVENT_MASK(type) (1u << (type))
+#define CCVFS_EVENT_ALL        (CCVFS_EVENT_MASK(CCVFS_EVENT_COUNT) - 1)
+#define CCVFS_MAX_IO_HOOKS     8
+
+/*
+ * Register a process-wide page I/O hook
+ * The hook receives the events selected by mask for every CCVFS file. While no hook and no
+ * trace ring wants an event type, each such event costs one relaxed load and a branch.
+ * Registering the same xHook/pArg pair again replaces its mask. Hooks must not register or
+ * unregister hooks themselves.
+ * Parameters:
+ *   xHook - Callback
+ *   pArg - First argument passed to the callback
+ *   mask - CCVFS_EVENT_MASK() bits of the wanted event types, or CCVFS_EVENT_ALL
+ * Return value:
+ *   SQLITE_OK - Success
+ *   SQLITE_MISUSE - xHook is NULL or mask is empty
+ *   SQLITE_FULL - CCVFS_MAX_IO_HOOKS hooks are already registered
+ */
+int sqlite3_ccvfs_register_io_hook(CCVFSIoHook xHook, void *pArg, uint32_t mask);
+
+/*
+ * Unregister a page I/O hook
+ * Waits for calls of the hook in progress on other threads; once it returns the hook is not
+ * called again and pArg may be released.
+ * Return value:
+ *   SQLITE_OK - Success
+ *   SQLITE_NOTFOUND - The xHook/pArg pair is not registered
+ */
+int sqlite3_ccvfs_unregister_io_hook(CCVFSIoHook xHook, void *pArg);
+
+/*
+ * I/O trace recording - I/O录制
+ * While a VFS records, every xRead, xWrite, xTruncate, xSync, xLock and xUnlock that SQLite
+ * issues on its files (main database, journal and WAL) is appended to a binary trace, together
+ * with the opens and closes needed to replay them. The trace holds the logical calls above
+ * CCVFS, so it can be replayed against any page size, codec or buffer configuration
+ * (db_tool replay). Files already open when recording starts are introduced by an open record
+ * on their first recorded call.
+ *
+ * Trace layout, all integers little-endian:
+ *   Header (CCVFS_RECORD_HEADER_SIZE bytes):
+ *     0  magic CCVFS_RECORD_MAGIC (8 bytes)
+ *     8  u32 version (CCVFS_RECORD_VERSION)
+ *     12 u32 CCVFS_RECORD_* flags
+ *     16 u64 wall-clock start time, seconds since the Unix epoch
+ *     24 u32 CCVFS block size of the recording VFS
+ *     28 u32 reserved
+ *     32 compression algorithm name, NUL padded (16 bytes)
+ *     48 encryption algorithm name, NUL padded (16 bytes)
+ *   Records (CCVFS_RECORD_SIZE bytes each, decoded by sqlite3_ccvfs_record_decode()):
+ *     0  u64 time_ns, 8 u64 offset, 16 u32 file_id, 20 u32 arg, 24 u32 duration_us,
+ *     28 u8 op, 29 u8 rc, 30 u16 reserved
+ *   An open or delete record is followed by the file name without its directory (offset bytes,
+ *   no terminator), a write record by the written bytes (arg bytes) when the trace has
+ *   CCVFS_RECORD_DATA.
+ */
+#define CCVFS_RECORD_MAGIC        "CCVFSTRC"
+#define CCVFS_RECORD_VERSION      1
+#define CCVFS_RECORD_HEADER_SIZE  64
+#define CCVFS_RECORD_SIZE         32
+
+/*
+ * Recording flags
+ */
+#define CCVFS_RECORD_DATA  (1 << 0)  // Store the bytes of every write, so a replay compresses the real data
+
+/*
+ * Recorded operations
+ */
+typedef enum {
+    CCVFS_RECORD_OPEN = 0,        // arg=open flags, offset=length of the file name that follows
+    CCVFS_RECORD_CLOSE,
+    CCVFS_RECORD_READ,            // arg=bytes, offset=file offset
+    CCVFS_RECORD_WRITE,           // arg=bytes, offset=file offset
+    CCVFS_RECORD_TRUNCATE,        // offset=new size
+    CCVFS_RECORD_SYNC,            // arg=sync flags
+    CCVFS_RECORD_LOCK,            // arg=lock level
+    CCVFS_RECORD_UNLOCK,          // arg=lock level
+    CCVFS_RECORD_DELETE,          // file_id=0, arg=sync directory flag, offset=length of the file name that follows
+    CCVFS_RECORD_OP_COUNT
+} CCVFSRecordOp;
+
+/*
+ * One decoded trace record
+ */
+typedef struct {
+    uint64_t time_ns;       // Monotonic time the call started, relative to the start of the recording
+    uint64_t offset;        // Operation specific, see CCVFSRecordOp
+    uint32_t file_id;       // Id of the file, unique within the recording process
+    uint32_t arg;           // Operation specific, see CCVFSRecordOp
+    uint32_t duration_us;   // Time spent in the call, saturated at UINT32_MAX
+    uint32_t op;            // CCVFSRecordOp
+    int rc;                 // Primary result code of the call (rc & 0xff)
+} CCVFSRecord;
+
+/*
+ * Start recording the I/O of a VFS into a trace file
+ * The file is created or truncated. While not recording, each recorded call costs one
+ * relaxed load and a branch; while recording, a clock read and a buffered append under
+ * a VFS-wide mutex. PRAGMA ccvfs_record = '<path>' | OFF does the same from SQL.
+ * Parameters:
+ *   zVfsName - Name of the VFS
+ *   zTracePath - Trace file to write
+ *   flags - CCVFS_RECORD_* flags
+ * Return value:
+ *   SQLITE_OK - Success
+ *   SQLITE_MISUSE - The VFS is already recording
+ *   SQLITE_CANTOPEN - The trace file cannot be created
+ *   Other values - Error code
+ */
+int sqlite3_ccvfs_record_start(const char *zVfsName, const char *zTracePath, int flags);
+
+/*
+ * Stop recording and close the trace file
+ * Parameters:
+ *   zVfsName - Name of the VFS
+ *   pnRecord - Number of records written (output, may be NULL)
+ * Return value:
+ *   SQLITE_OK - Success
+ *   SQLITE_NOTFOUND - The VFS is not recording
+ *   SQLITE_IOERR_WRITE - Writing the trace failed, records after the failure were dropped
+ */
+int sqlite3_ccvfs_record_stop(const char *zVfsName, uint64_t *pnRecord);
+
+/*
+ * Decode one CCVFS_RECORD_SIZE byte record of a trace
+ */
+void sqlite3_ccvfs_record_decode(const unsigned char *aRecord, CCVFSRecord *pRecord);
+
+/*
+ * Name of a recorded operation ("read", "write", ...), NULL if out of range
+ */
+const char *sqlite3_ccvfs_record_op_name(int op);
+
+/*
+ * Register the ccvfs_pages eponymous virtual table on a connection
+ * One row per logical page of a CCVFS database: physical offset, compressed and original size,
+ * flags, checksum and the owning b-tree from dbstat. Usable as an sqlite3_auto_extension() entry point.
+ * Parameters:
+ *   db - Open database connection
+ *   pzErrMsg - Error message (output, may be NULL)
+ *   pApi - Unused, present for the extension entry point signature
+ * Return value:
+ *   SQLITE_OK - Success
+ *   Other values - Error code
+ */
+int sqlite3_ccvfs_pages_init(sqlite3 *db, char **pzErrMsg, const struct sqlite3_api_routines *pApi);
+
 /*
  * Force flush write buffer for an open database
  * Parameters:
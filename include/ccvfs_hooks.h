@@ -0,0 +1,58 @@
+#ifndef CCVFS_HOOKS_H
+#define CCVFS_HOOKS_H
+
+#include "ccvfs_internal.h"
+#include "ccvfs_latency.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Page event functions - 页面事件函数
+ * ccvfs_event_mask has one bit per event type wanted by the trace ring or an I/O hook.
+ * A page operation starts with ccvfs_event_begin(), which reads the clock only when its
+ * event type is wanted, and ends with ccvfs_event(), which builds the event and passes it
+ * to the ring and the hooks. Both cost one relaxed load and a branch while nobody listens.
+ */
+extern uint32_t ccvfs_event_mask;
+
+void ccvfs_event_update_mask(void);
+void ccvfs_event_emit(CCVFSIoEvent *pEvent);
+
+static inline int ccvfs_event_wanted(CCVFSEventType type) {
+    return (CCVFS_COUNTER_GET(ccvfs_event_mask) & CCVFS_EVENT_MASK(type)) != 0;
+}
+
+static inline uint64_t ccvfs_event_begin(CCVFSEventType type) {
+    return ccvfs_event_wanted(type) ? ccvfs_latency_now() : 0;
+}
+
+static inline void ccvfs_event(CCVFSFile *pFile, CCVFSEventType type, uint64_t tStart,
+                               uint32_t page, uint64_t offset, uint32_t storedSize,
+                               uint32_t originalSize, uint32_t aux, CCVFSCacheOutcome cache, int rc) {
+    CCVFSIoEvent event;
+
+    if (!ccvfs_event_wanted(type)) {
+        return;
+    }
+    event.type = (uint32_t)type;
+    event.file_id = pFile->file_id;
+    event.zFile = pFile->filename;
+    event.page = page;
+    event.offset = offset;
+    event.stored_size = storedSize;
+    event.original_size = originalSize;
+    event.aux = aux;
+    event.cache = (uint32_t)cache;
+    event.start_ns = tStart;
+    event.duration_ns = 0;
+    event.rc = rc;
+    ccvfs_event_emit(&event);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CCVFS_HOOKS_H */
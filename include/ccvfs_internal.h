@@ -2,6 +2,7 @@
 #define CCVFS_INTERNAL_H
 
 #include "ccvfs.h"
+#include "ccvfs_sync.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -15,6 +16,7 @@ extern "C" {
 // Internal constants
 #define CCVFS_MAX_ALGORITHMS 16
 #define CCVFS_CRC32_POLYNOMIAL 0xEDB88320
+#define CCVFS_CACHE_LINE_SIZE 64  // Padding unit keeping hot counters off shared cache lines
 
 // File layout constants
 #define CCVFS_MAX_PAGES 65536  // Maximum pages supported (2^16)
@@ -22,6 +24,23 @@ extern "C" {
 #define CCVFS_INDEX_TABLE_OFFSET CCVFS_HEADER_SIZE  // Fixed position after header
 #define CCVFS_DATA_PAGES_OFFSET (CCVFS_INDEX_TABLE_OFFSET + CCVFS_INDEX_TABLE_SIZE)  // Start of data pages
 
+// Index block constants (used for incremental index reload across connections)
+#define CCVFS_INDEX_BLOCK_COUNT 128  // One bit per block in the header change mask
+#define CCVFS_INDEX_BLOCK_PAGES (CCVFS_MAX_PAGES / CCVFS_INDEX_BLOCK_COUNT)  // 512 entries per block
+
+// Shared index constants (authoritative index kept in a shared mapping next to the file)
+#define CCVFS_SHM_SUFFIX        "-ccvfs"  // Companion file, the mapping lives in "<db>-ccvfs-shm"
+#define CCVFS_SHM_MAGIC         "CCVFSSHM"
+#define CCVFS_SHM_HEADER_SIZE   4096      // One OS page for the mapping header
+#define CCVFS_SHM_REGION_SIZE   (CCVFS_SHM_HEADER_SIZE + CCVFS_INDEX_TABLE_SIZE)
+#define CCVFS_SHM_INDEX_LOCK    0         // xShmLock slot guarding the shared index
+
+// Backup delta constants (stored blocks changed since an earlier backup)
+#define CCVFS_DELTA_MAGIC       "CCVFSDLT"
+#define CCVFS_DELTA_VERSION     1
+#define CCVFS_DELTA_HEADER_SIZE 64
+#define CCVFS_APPLY_MAGIC       "CCVFSAPL"  // Header magic of a copy while a delta is applied to it
+
 // Page flags
 #define CCVFS_PAGE_COMPRESSED   (1 << 0)
 #define CCVFS_PAGE_ENCRYPTED    (1 << 1)
@@ -47,21 +66,56 @@ extern "C" {
 #define CCVFS_MAX_BUFFER_SIZE             (64*1024*1024) // 64MB maximum buffer
 #define CCVFS_DEFAULT_AUTO_FLUSH_PAGES    16       // Auto flush every 16 pages
 
-// Debug macro definitions
-#ifdef DEBUG
-#define CCVFS_DEBUG(fmt, ...) fprintf(stdout, "[CCVFS DEBUG] %s:%d: " fmt "\n", __func__, __LINE__, ##__VA_ARGS__)
-#else
-#define CCVFS_DEBUG(fmt, ...)
-#endif
+// Compression level constants (stored in page flags, see CCVFS_COMPRESSION_LEVEL_MASK)
+#define CCVFS_DEFAULT_COMPRESS_LEVEL      1        // Favour speed, as before levels were configurable
+#define CCVFS_MIN_COMPRESS_LEVEL          1        // Minimum compression level
+#define CCVFS_MAX_COMPRESS_LEVEL          9        // Maximum compression level
 
-#ifdef VERBOSE
-#define CCVFS_VERBOSE(fmt, ...) fprintf(stdout, "[CCVFS VERBOSE] %s:%d: " fmt "\n", __func__, __LINE__, ##__VA_ARGS__)
-#else
-#define CCVFS_VERBOSE(fmt, ...)
+/*
+ * 日志宏
+ * 级别在运行时检查，超出当前级别的消息不会格式化参数。
+ * Logging macros
+ * The level is checked at run time; arguments of messages above the current level are not evaluated.
+ */
+extern int ccvfs_log_level;
+void ccvfs_log_write(int level, const char *zFunc, int line, const char *zFormat, ...)
+#if defined(__GNUC__) || defined(__clang__)
+    __attribute__((format(printf, 4, 5)))
 #endif
+    ;
+
+#define CCVFS_LOG_ENABLED(level) (CCVFS_COUNTER_GET(ccvfs_log_level) >= (level))
+#define CCVFS_LOG(level, fmt, ...) do { \
+    if (CCVFS_LOG_ENABLED(level)) { \
+        ccvfs_log_write((level), __func__, __LINE__, fmt, ##__VA_ARGS__); \
+    } \
+} while (0)
 
-#define CCVFS_INFO(fmt, ...) fprintf(stdout, "[CCVFS INFO] " fmt "\n", ##__VA_ARGS__)
-#define CCVFS_ERROR(fmt, ...) fprintf(stderr, "[CCVFS ERROR] %s:%d: " fmt "\n", __func__, __LINE__, ##__VA_ARGS__)
+#define CCVFS_DEBUG(fmt, ...) CCVFS_LOG(CCVFS_LOG_DEBUG, fmt, ##__VA_ARGS__)
+#define CCVFS_VERBOSE(fmt, ...) CCVFS_LOG(CCVFS_LOG_VERBOSE, fmt, ##__VA_ARGS__)
+#define CCVFS_INFO(fmt, ...) CCVFS_LOG(CCVFS_LOG_INFO, fmt, ##__VA_ARGS__)
+#define CCVFS_ERROR(fmt, ...) CCVFS_LOG(CCVFS_LOG_ERROR, fmt, ##__VA_ARGS__)
+
+/*
+ * 索引块掩码辅助函数
+ * Index block mask helpers
+ */
+static inline int ccvfs_index_mask_test(const uint8_t *mask, uint32_t block) {
+    return (mask[block >> 3] >> (block & 7)) & 1;
+}
+
+static inline void ccvfs_index_mask_set(uint8_t *mask, uint32_t block) {
+    mask[block >> 3] |= (uint8_t)(1 << (block & 7));
+}
+
+static inline int ccvfs_index_mask_any(const uint8_t *mask) {
+    for (uint32_t i = 0; i < CCVFS_INDEX_BLOCK_COUNT / 8; i++) {
+        if (mask[i]) {
+            return 1;
+        }
+    }
+    return 0;
+}
 
 /*
  * File header structure (128 bytes)
@@ -77,7 +131,7 @@ typedef struct {
     uint32_t original_page_size; // Original SQLite page size (原始SQLite页面大小)
     uint32_t sqlite_version; // Original SQLite version
     uint32_t database_size_pages; // Total database pages (数据库总页数)
-    uint32_t reserved1;
+    uint32_t change_counter; // Index generation, bumped on every index save (索引代计数器)
 
     // Compression configuration (24 bytes)
     char compress_algorithm[CCVFS_MAX_ALGORITHM_NAME]; // Compression algorithm name
@@ -99,10 +153,41 @@ typedef struct {
     uint32_t master_key_hash; // Master key hash (optional)
     uint64_t timestamp; // Creation timestamp
 
-    // Reserved fields (16 bytes)
-    uint8_t reserved[16]; // Reserved for extension
+    // Index change tracking (16 bytes) - 索引变更跟踪
+    uint8_t index_change_mask[CCVFS_INDEX_BLOCK_COUNT / 8]; // Blocks changed by the last save (上次保存修改的索引块)
 } CCVFSFileHeader;
 
+/*
+ * Shared index mapping header - 共享索引映射头
+ * Followed at CCVFS_SHM_HEADER_SIZE by CCVFS_MAX_PAGES index entries
+ */
+typedef struct {
+    char magic[8]; // "CCVFSSHM" when the entries are valid
+    uint32_t generation; // File change_counter the entries correspond to (对应的索引代)
+    uint32_t total_pages; // Number of valid entries (有效条目数)
+} CCVFSShmHeader;
+
+/*
+ * Backup delta header - 备份增量文件头
+ * Followed by the target file header, target_total_pages index entries, changed_blocks block
+ * numbers in physical offset order, and the stored bytes of those blocks in the same order
+ */
+typedef struct {
+    char magic[8]; // "CCVFSDLT"
+    uint32_t version; // CCVFS_DELTA_VERSION
+    uint32_t base_generation; // change_counter of the copy the delta applies to (基础副本的索引代)
+    uint32_t base_index_checksum; // CRC32 of the index entries of that copy (基础副本索引校验和)
+    uint32_t base_total_pages; // Index entries of that copy
+    uint32_t target_total_pages; // Index entries after the delta is applied
+    uint32_t changed_blocks; // Blocks whose stored bytes are carried (携带数据的块数)
+    uint32_t target_header_checksum; // CRC32 of the target file header
+    uint32_t target_index_checksum; // CRC32 of the target index entries
+    uint64_t target_file_size; // Size of the copy after the delta is applied
+    uint64_t data_size; // Stored bytes carried
+    uint32_t block_list_checksum; // CRC32 of the block numbers
+    uint32_t header_checksum; // CRC32 of the preceding fields
+} CCVFSDeltaHeader;
+
 /*
  * Page index entry - 页面索引条目
  */
@@ -132,6 +217,40 @@ typedef struct {
     // uint8_t data[];             // Compressed data (压缩数据)
 } CCVFSDataPage;
 
+/*
+ * Index snapshot block - 索引快照块
+ * Immutable copy of CCVFS_INDEX_BLOCK_PAGES index entries, shared by every snapshot in which it did not change
+ */
+typedef struct CCVFSIndexBlock {
+    uint32_t ref_count; // Snapshots referencing this block (引用此块的快照数)
+    CCVFSPageIndex entries[CCVFS_INDEX_BLOCK_PAGES]; // Index entries (索引条目)
+} CCVFSIndexBlock;
+
+/*
+ * Index snapshot - 索引快照
+ * Read-only version of the page index published by writers; readers pin it with a reference
+ */
+typedef struct CCVFSIndexSnapshot {
+    uint64_t epoch; // Publish epoch, increases with every snapshot (发布代)
+    uint32_t ref_count; // Pinning readers, plus one while it is the current snapshot (引用计数)
+    uint32_t page_size; // Logical page size (逻辑页面大小)
+    uint32_t total_pages; // Number of valid entries (有效条目数)
+    uint32_t database_size_pages; // Logical database size (数据库页数)
+    CCVFSIndexBlock *blocks[CCVFS_INDEX_BLOCK_COUNT]; // NULL past total_pages (超出总页数为NULL)
+    struct CCVFSIndexSnapshot *next; // Next live snapshot, oldest first (下一个存活快照)
+} CCVFSIndexSnapshot;
+
+/*
+ * Deferred extent - 延迟释放的空间
+ * Space abandoned by a writer that a snapshot may still read; becomes a hole once no such snapshot is alive
+ */
+typedef struct CCVFSDeferredExtent {
+    sqlite3_int64 offset; // Starting offset (起始偏移)
+    uint32_t size; // Size in bytes (大小，字节)
+    uint64_t epoch; // Newest snapshot that can still reference it (仍可能引用它的最新快照代)
+    struct CCVFSDeferredExtent *next; // Next deferred extent (下一个延迟空间)
+} CCVFSDeferredExtent;
+
 /*
  * Space hole structure for tracking available space - 空间洞结构用于跟踪可用空间
  */
@@ -177,6 +296,50 @@ typedef struct CCVFSWriteBuffer {
     sqlite3_int64 last_flush_time; // Last flush timestamp (上次刷新时间戳)
 } CCVFSWriteBuffer;
 
+/*
+ * Statistics counters of one file - 文件统计计数器
+ * 64-bit, updated with CCVFS_COUNTER_* only. Counters bumped by concurrent page reads sit on
+ * their own cache line, apart from the write path counters and from the rest of CCVFSFile;
+ * full-line pads keep them apart whatever the alignment of the file structure.
+ */
+typedef struct CCVFSCounters {
+    char pad_head[CCVFS_CACHE_LINE_SIZE];
+
+    // 读路径（并发读取者更新）
+    // Read path (updated by concurrent readers)
+    uint64_t buffer_hit_count; // Reads served from the write buffer (写缓冲命中次数)
+    uint64_t checksum_error_count; // Checksum mismatches (校验和错误次数)
+    uint64_t corrupted_page_count; // Corrupted pages detected (损坏页数量)
+    uint64_t recovery_attempt_count; // Data recovery attempts (数据恢复尝试次数)
+    uint64_t successful_recovery_count; // Successful recoveries (成功恢复次数)
+    uint64_t trusted_read_count; // Reads that skipped the CRC of a scrubbed block (免校验读取次数)
+    char pad_read[CCVFS_CACHE_LINE_SIZE];
+
+    // 后台巡检（巡检线程更新）
+    // Background scrubber (updated by the scrubber thread)
+    uint64_t scrubbed_block_count; // Blocks validated (已校验块数)
+    uint64_t scrubbed_bytes; // Stored bytes read (已读取的存储字节数)
+    uint64_t scrub_pass_count; // Completed passes over the file (完成的巡检轮数)
+    char pad_scrub[CCVFS_CACHE_LINE_SIZE];
+
+    // 写路径（持有索引写锁时更新）
+    // Write path (updated with the index lock held exclusively)
+    uint64_t space_reuse_count; // Pages rewritten in place (原位重写次数)
+    uint64_t space_expansion_count; // In-place expansions (原位扩展次数)
+    uint64_t new_allocation_count; // New space allocations (新空间分配次数)
+    uint64_t hole_reclaim_count; // Holes reused for a page (空洞回收次数)
+    uint64_t best_fit_count; // Best-fit allocations (最佳适配分配次数)
+    uint64_t sequential_write_count; // Sequential writes detected (顺序写入次数)
+    uint64_t hole_allocation_count; // Successful hole allocations (空洞分配次数)
+    uint64_t hole_merge_count; // Hole merges (空洞合并次数)
+    uint64_t hole_cleanup_count; // Small holes dropped (小空洞清理次数)
+    uint64_t buffer_flush_count; // Write buffer flushes (写缓冲刷新次数)
+    uint64_t buffer_merge_count; // Writes merged into a buffered page (缓冲合并次数)
+    uint64_t total_buffered_writes; // Writes that went through the buffer (缓冲写入总数)
+    uint64_t cow_relocation_count; // Pages moved because a snapshot could read them (写时复制迁移次数)
+    char pad_tail[CCVFS_CACHE_LINE_SIZE];
+} CCVFSCounters;
+
 /*
  * CCVFS structure
  */
@@ -214,6 +377,32 @@ typedef struct CCVFS {
     uint32_t max_buffer_entries; /* 最大缓冲条目数 Maximum buffer entries */
     uint32_t max_buffer_size; /* 最大缓冲区大小 Maximum buffer size in bytes */
     uint32_t auto_flush_pages; /* 自动刷新页数阈值 Auto flush page threshold */
+
+    // 共享索引配置
+    // Shared index configuration
+    int enable_shared_index; /* 多进程共享页索引 Share one page index across processes */
+
+    // 延迟直方图配置
+    // Latency histogram configuration
+    int enable_histograms; /* 新打开文件是否计时页面处理阶段 Time page pipeline stages in newly opened files */
+
+    // 打开文件列表和已关闭文件的累计统计
+    // Open files and statistics accumulated from closed files
+    sqlite3_mutex *files_mutex; /* Guards pOpenFiles and retired */
+    struct CCVFSFile *pOpenFiles; /* CCVFS format files currently open */
+    CCVFSFileStats retired; /* Final counters of files already closed */
+
+    // I/O录制
+    // I/O recording
+    sqlite3_mutex *record_mutex; /* Guards pRecorder and the trace file */
+    struct CCVFSRecorder *pRecorder; /* Active recording (NULL when not recording) */
+    uint32_t record_active; /* Read on every recorded call, switched with CCVFS_COUNTER_SET */
+    uint32_t record_session; /* Number of the latest recording, 0 before the first one */
+
+    // 后台巡检
+    // Background scrubber
+    struct CCVFSScrubber *pScrubber; /* Running scrubber (NULL when stopped), guarded by files_mutex */
+    uint32_t scrub_trust_ms; /* Trust window of reads, read on every page read with CCVFS_COUNTER_GET */
 } CCVFS;
 
 /*
@@ -226,48 +415,75 @@ typedef struct CCVFSFile {
     CCVFSFileHeader header; /* Cached file header */
     CCVFSPageIndex *pPageIndex; /* Page index table (in-memory) 页面索引表（内存中） */
     int index_dirty; /* 1 if index needs to be saved */
+    uint8_t index_dirty_blocks[CCVFS_INDEX_BLOCK_COUNT / 8]; /* Index blocks modified since last save */
+    uint32_t index_generation; /* change_counter the in-memory index corresponds to */
+    int lock_level; /* Current SQLite lock level held on this file, set with CCVFS_COUNTER_SET for the scrubber */
+    int wal_mapped; /* 1 while the WAL index of this file is mapped */
+    int wal_checkpointing; /* 1 while this connection holds the WAL checkpoint lock */
+    int wal_read_pending; /* 1 between taking a WAL read lock and the next xShmBarrier */
     uint32_t index_capacity; /* Allocated capacity for page index */
     int header_loaded; /* Header loaded flag */
     int open_flags; /* File open flags */
     int is_ccvfs_file; /* Is this a CCVFS format file */
     char *filename; /* File path for debugging */
+    uint32_t file_id; /* Process-wide id identifying the file in trace events */
+    uint32_t record_session; /* Recording whose trace already has this file's open record */
+
+    // 并发控制
+    // Concurrency control (lock order: pOwner->files_mutex -> index_lock -> alloc_mutex;
+    // snapshot_mutex and buffer_mutex are leaves)
+    CCVFSRwLock index_lock; /* Guards page index, header and write buffer */
+    sqlite3_mutex *alloc_mutex; /* Guards hole manager, deferred extents and space tracking */
+    sqlite3_mutex *snapshot_mutex; /* Guards snapshot pointers and reference counts, held only briefly */
+    sqlite3_mutex *buffer_mutex; /* Guards the write buffer list against snapshot readers */
+
+    // 索引快照（写时复制，按发布代回收旧空间）
+    // Index snapshots (copy-on-write, old extents reclaimed by epoch)
+    CCVFSIndexSnapshot *pSnapshot; /* Current published snapshot (NULL if none) */
+    CCVFSIndexSnapshot *pLiveSnapshots; /* Snapshots still referenced, oldest first */
+    uint64_t snapshot_epoch; /* Epoch of the most recent snapshot */
+    int snapshot_stale; /* 1 if the last publish failed, readers then use the index lock */
+    uint8_t snapshot_dirty_blocks[CCVFS_INDEX_BLOCK_COUNT / 8]; /* Index blocks changed since the last publish */
+    CCVFSDeferredExtent *pDeferred; /* Abandoned extents still visible to a snapshot */
+
+    // 共享索引映射
+    // Shared index mapping
+    sqlite3_file *pShmFile; /* Companion file owning the shared mapping (NULL if disabled) */
+    char *zShmName; /* Companion file name */
+    CCVFSShmHeader volatile *pShm; /* Shared mapping header */
+    int index_shared; /* 1 if pPageIndex points into the shared mapping */
 
     // Space utilization tracking - 空间利用跟踪
     uint64_t total_allocated_space; /* Total space allocated for data pages */
     uint64_t total_used_space; /* Total space actually used by compressed data */
     uint32_t fragmentation_score; /* Fragmentation score (0-100, higher = more fragmented) */
-    uint32_t space_reuse_count; /* Number of successful space reuses */
-    uint32_t space_expansion_count; /* Number of space expansions */
-    uint32_t new_allocation_count; /* Number of new space allocations */
 
     // Advanced space management - 高级空间管理
-    uint32_t hole_reclaim_count; /* Number of space holes reclaimed */
-    uint32_t best_fit_count; /* Number of best-fit allocations */
-    uint32_t sequential_write_count; /* Number of sequential writes detected */
     uint32_t last_written_page; /* Last page number written (for sequential detection) */
 
-    // 空洞管理器和统计
-    // Hole manager and statistics
+    // 空洞管理器
+    // Hole manager
     CCVFSHoleManager hole_manager; /* Hole tracking system */
-    uint32_t hole_allocation_count; /* Number of successful hole allocations */
-    uint32_t hole_merge_count; /* Number of hole merge operations */
-    uint32_t hole_cleanup_count; /* Number of small holes removed */
     uint32_t hole_operations_count; /* Counter for triggering maintenance */
 
-    // 写入缓冲管理器和统计
-    // Write buffer manager and statistics
+    // 写入缓冲管理器
+    // Write buffer manager
     CCVFSWriteBuffer write_buffer; /* Write buffering system */
-    uint32_t buffer_hit_count; /* Number of buffer hits during reads */
-    uint32_t buffer_flush_count; /* Number of buffer flushes performed */
-    uint32_t buffer_merge_count; /* Number of write merges in buffer */
-    uint32_t total_buffered_writes; /* Total writes that went through buffer */
-
-    // 数据完整性统计和错误跟踪
-    // Data integrity statistics and error tracking
-    uint32_t checksum_error_count; /* 校验和错误次数 Number of checksum errors encountered */
-    uint32_t corrupted_page_count; /* 损坏页数量 Number of corrupted pages detected */
-    uint32_t recovery_attempt_count; /* 数据恢复尝试次数 Number of data recovery attempts */
-    uint32_t successful_recovery_count; /* 成功恢复次数 Number of successful recoveries */
+    int compress_level; /* Level passed to the compression algorithm, changed with PRAGMA ccvfs_compress_level */
+
+    // 统计计数器（空间、空洞、缓冲、数据完整性），以及VFS打开文件列表链接
+    // Statistics counters (space, holes, buffer, data integrity) and the VFS open file list link
+    CCVFSCounters counters; /* Lifetime counters, folded into the VFS totals on close */
+    int latency_enabled; /* Read on every timed stage, switched with CCVFS_COUNTER_SET */
+    CCVFSLatencyHistogram latency[CCVFS_STAGE_COUNT]; /* Per-stage latency histograms */
+    struct CCVFSFile *pNextOpen; /* Next file in pOwner->pOpenFiles */
+    int stats_registered; /* 1 while linked into pOwner->pOpenFiles */
+
+    // 巡检标记：每个块最近一次校验通过的时间和条目标签，按索引块分配
+    // Scrub marks: time and entry tag of each block's latest validation, allocated per index block
+    uint64_t *scrub_marks[CCVFS_INDEX_BLOCK_COUNT]; /* Published with CCVFS_COUNTER_SET, freed on close */
+    int scrub_detached; /* Set under files_mutex when closing, the scrubber skips the file */
+    int scrub_pins; /* Chunks the scrubber checks outside files_mutex, guarded by files_mutex */
 } CCVFSFile;
 
 #ifdef __cplusplus
@@ -51,6 +51,13 @@ int ccvfs_buffer_write(CCVFSFile *pFile, uint32_t pageNum, const unsigned char *
 int ccvfs_buffer_read(CCVFSFile *pFile, uint32_t pageNum, unsigned char *buffer, uint32_t bufferSize);
 int ccvfs_flush_write_buffer(CCVFSFile *pFile);
 int ccvfs_flush_buffer_entry(CCVFSFile *pFile, uint32_t pageNum);
+void ccvfs_buffer_discard_clean(CCVFSFile *pFile, uint32_t firstPage, uint32_t endPage);
+
+/*
+ * Compaction (declared here, defined in ccvfs_io.c)
+ */
+int ccvfs_compact_file(CCVFSFile *pFile, uint32_t *pMovedPages,
+                       sqlite3_int64 *pOldSize, sqlite3_int64 *pNewSize);
 
 #ifdef __cplusplus
 }
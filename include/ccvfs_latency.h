@@ -0,0 +1,44 @@
+#ifndef CCVFS_LATENCY_H
+#define CCVFS_LATENCY_H
+
+#include "ccvfs_internal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Latency histogram functions - 延迟直方图函数
+ * A timed section starts with ccvfs_latency_begin() and ends each stage with
+ * ccvfs_latency_lap(), which records the stage and returns the start of the next one.
+ * Both return 0 while timing is disabled, and a lap with a zero start records nothing.
+ */
+uint64_t ccvfs_latency_now(void);
+void ccvfs_latency_record(CCVFSFile *pFile, CCVFSStage stage, uint64_t ns);
+void ccvfs_latency_set_enabled(CCVFSFile *pFile, int enabled);
+void ccvfs_latency_configure_vfs(CCVFS *pVfs, int enabled);
+void ccvfs_latency_reset(CCVFSFile *pFile);
+void ccvfs_latency_copy(CCVFSFile *pFile, CCVFSLatencyHistogram *aHist);
+uint64_t ccvfs_latency_percentile(const CCVFSLatencyHistogram *pHist, double fraction);
+char *ccvfs_latency_report(CCVFSFile *pFile);
+
+static inline uint64_t ccvfs_latency_begin(CCVFSFile *pFile) {
+    return CCVFS_COUNTER_GET(pFile->latency_enabled) ? ccvfs_latency_now() : 0;
+}
+
+static inline uint64_t ccvfs_latency_lap(CCVFSFile *pFile, CCVFSStage stage, uint64_t start) {
+    uint64_t now;
+
+    if (start == 0) {
+        return 0;
+    }
+    now = ccvfs_latency_now();
+    ccvfs_latency_record(pFile, stage, now - start);
+    return now;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CCVFS_LATENCY_H */
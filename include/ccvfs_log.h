@@ -0,0 +1,26 @@
+#ifndef CCVFS_LOG_H
+#define CCVFS_LOG_H
+
+#include "ccvfs_internal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Trace ring functions - 跟踪环函数
+ * Events reach the ring through ccvfs_event() (see ccvfs_hooks.h). ccvfs_trace_report()
+ * formats the latest events as text (caller frees with sqlite3_free).
+ */
+extern int ccvfs_trace_flags;
+
+void ccvfs_trace_record(const CCVFSIoEvent *pEvent);
+char *ccvfs_trace_report(int nMax);
+uint32_t ccvfs_log_next_file_id(void);
+const char *ccvfs_log_level_name(int level);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CCVFS_LOG_H */
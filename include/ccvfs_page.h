@@ -17,6 +17,9 @@ int ccvfs_save_page_index(CCVFSFile *pFile);
 int ccvfs_force_save_page_index(CCVFSFile *pFile); /* Force save even if not dirty */
 int ccvfs_init_header(CCVFSFile *pFile, CCVFS *pVfs);
 int ccvfs_expand_page_index(CCVFSFile *pFile, uint32_t new_page_count);
+void ccvfs_mark_index_dirty(CCVFSFile *pFile, uint32_t pageNum);
+void ccvfs_mark_index_range_dirty(CCVFSFile *pFile, uint32_t firstPage, uint32_t endPage);
+int ccvfs_refresh_page_index(CCVFSFile *pFile); /* Reload index blocks changed by other connections */
 
 #ifdef __cplusplus
 }
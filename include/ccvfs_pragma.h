@@ -0,0 +1,22 @@
+#ifndef CCVFS_PRAGMA_H
+#define CCVFS_PRAGMA_H
+
+#include "ccvfs_internal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * PRAGMA functions - PRAGMA函数
+ * Handles SQLITE_FCNTL_PRAGMA for CCVFS format files. azArg[1] is the pragma name and
+ * azArg[2] its value (NULL when queried); the result or error message goes to azArg[0].
+ * Returns SQLITE_NOTFOUND for pragmas that are not CCVFS specific.
+ */
+int ccvfs_pragma(CCVFSFile *pFile, char **azArg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CCVFS_PRAGMA_H */
@@ -0,0 +1,45 @@
+#ifndef CCVFS_RECORD_H
+#define CCVFS_RECORD_H
+
+#include "ccvfs_internal.h"
+#include "ccvfs_latency.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * I/O recording functions - I/O录制函数
+ * A recorded file method starts with ccvfs_record_begin(), which reads the clock only while
+ * the owning VFS records, and ends with ccvfs_record(), which appends the call to the trace.
+ * Both cost one relaxed load and a branch while the VFS does not record. File deletions go
+ * through the VFS rather than a file and use ccvfs_record_vfs_begin().
+ */
+int ccvfs_record_init_vfs(CCVFS *pVfs);
+void ccvfs_record_destroy_vfs(CCVFS *pVfs);
+void ccvfs_record_append(CCVFSFile *pFile, CCVFSRecordOp op, uint64_t tStart,
+                         uint64_t offset, uint32_t arg, const void *pData, int rc);
+void ccvfs_record_delete(CCVFS *pVfs, uint64_t tStart, const char *zName, int syncDir, int rc);
+char *ccvfs_record_report(CCVFS *pVfs);
+
+static inline uint64_t ccvfs_record_vfs_begin(CCVFS *pVfs) {
+    return CCVFS_COUNTER_GET(pVfs->record_active) ? ccvfs_latency_now() : 0;
+}
+
+static inline uint64_t ccvfs_record_begin(CCVFSFile *pFile) {
+    return ccvfs_record_vfs_begin(pFile->pOwner);
+}
+
+static inline void ccvfs_record(CCVFSFile *pFile, CCVFSRecordOp op, uint64_t tStart,
+                                uint64_t offset, uint32_t arg, const void *pData, int rc) {
+    if (tStart == 0) {
+        return;
+    }
+    ccvfs_record_append(pFile, op, tStart, offset, arg, pData, rc);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CCVFS_RECORD_H */
@@ -0,0 +1,37 @@
+#ifndef CCVFS_SCRUB_H
+#define CCVFS_SCRUB_H
+
+#include "ccvfs_internal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Background scrubber functions - 后台巡检函数
+ * The scrubber thread of a VFS records a mark for every block it validates. While the VFS
+ * trusts scrubbed blocks, ccvfs_scrub_trusted() lets a page read skip its CRC; otherwise it
+ * costs one relaxed load and a branch. A closing file detaches first and frees its marks last.
+ * Files in WAL mode are never trusted: another connection's checkpoint can move and reuse a
+ * block while this connection's index is stale, and only the CRC mismatch makes the read retry
+ * on a refreshed index.
+ */
+void ccvfs_scrub_destroy_vfs(CCVFS *pVfs);
+void ccvfs_scrub_detach(CCVFSFile *pFile);
+void ccvfs_scrub_free_marks(CCVFSFile *pFile);
+int ccvfs_scrub_check_mark(CCVFSFile *pFile, uint32_t pageNum, const CCVFSPageIndex *pIndex, uint32_t window);
+
+static inline int ccvfs_scrub_trusted(CCVFSFile *pFile, uint32_t pageNum, const CCVFSPageIndex *pIndex) {
+    uint32_t window = pFile->pOwner ? CCVFS_COUNTER_GET(pFile->pOwner->scrub_trust_ms) : 0;
+
+    if (window == 0 || pFile->wal_mapped) {
+        return 0;
+    }
+    return ccvfs_scrub_check_mark(pFile, pageNum, pIndex, window);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CCVFS_SCRUB_H */
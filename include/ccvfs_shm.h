@@ -0,0 +1,25 @@
+#ifndef CCVFS_SHM_H
+#define CCVFS_SHM_H
+
+#include "ccvfs_internal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Shared page index functions - 共享页索引函数
+ * The authoritative index is kept in a mapping obtained through the root VFS
+ * xShmMap/xShmLock on a companion file, so all processes read one copy.
+ */
+int ccvfs_shm_open(CCVFSFile *pFile, const char *zDbName);
+void ccvfs_shm_close(CCVFSFile *pFile);
+int ccvfs_shm_attach_index(CCVFSFile *pFile, const CCVFSFileHeader *pDiskHeader);
+int ccvfs_shm_detach_index(CCVFSFile *pFile);
+void ccvfs_shm_publish_index(CCVFSFile *pFile);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CCVFS_SHM_H */
@@ -0,0 +1,36 @@
+#ifndef CCVFS_SNAPSHOT_H
+#define CCVFS_SNAPSHOT_H
+
+#include "ccvfs_internal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Index snapshot functions - 索引快照函数
+ * Writers publish a copy-on-write version of the page index at the end of every
+ * modifying call; readers pin the current version and never wait for a flush.
+ * Space a snapshot can still read is only reused after all such snapshots are released.
+ */
+void ccvfs_snapshot_publish(CCVFSFile *pFile);
+CCVFSIndexSnapshot *ccvfs_snapshot_acquire(CCVFSFile *pFile);
+void ccvfs_snapshot_release(CCVFSFile *pFile, CCVFSIndexSnapshot *pSnap);
+const CCVFSPageIndex *ccvfs_snapshot_entry(const CCVFSIndexSnapshot *pSnap, uint32_t pageNum);
+void ccvfs_snapshot_cleanup(CCVFSFile *pFile);
+
+/*
+ * Deferred space functions - 延迟释放空间函数
+ * Called with alloc_mutex held (except ccvfs_snapshot_reclaim, which takes it)
+ */
+int ccvfs_snapshot_extent_published(CCVFSFile *pFile, uint32_t pageNum, sqlite3_int64 offset);
+int ccvfs_snapshot_defer_extent(CCVFSFile *pFile, sqlite3_int64 offset, uint32_t size);
+int ccvfs_snapshot_range_deferred(CCVFSFile *pFile, sqlite3_int64 offset, uint32_t size);
+void ccvfs_snapshot_reclaim(CCVFSFile *pFile);
+void ccvfs_snapshot_forget_deferred(CCVFSFile *pFile);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CCVFS_SNAPSHOT_H */
@@ -0,0 +1,26 @@
+#ifndef CCVFS_STATS_H
+#define CCVFS_STATS_H
+
+#include "ccvfs_internal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Statistics functions - 统计函数
+ * Files update their CCVFSCounters lock-free; these functions copy them out consistently
+ * and keep the per-VFS list of open files whose counters make up the VFS totals.
+ */
+int ccvfs_stats_init_vfs(CCVFS *pVfs);
+void ccvfs_stats_destroy_vfs(CCVFS *pVfs);
+void ccvfs_stats_register(CCVFSFile *pFile);
+void ccvfs_stats_unregister(CCVFSFile *pFile);
+void ccvfs_stats_collect(CCVFSFile *pFile, CCVFSFileStats *pStats);
+void ccvfs_stats_collect_vfs(CCVFS *pVfs, CCVFSFileStats *pStats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CCVFS_STATS_H */
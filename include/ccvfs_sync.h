@@ -0,0 +1,56 @@
+#ifndef CCVFS_SYNC_H
+#define CCVFS_SYNC_H
+
+#include <stdint.h>
+
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Reader-writer lock - 读写锁
+ * Guards the page index and write buffer of one CCVFSFile: anything that modifies them
+ * takes it exclusively; page reads share it only while no index snapshot is published.
+ * Not recursive - only taken at the IO method / public API boundary.
+ */
+typedef struct CCVFSRwLock {
+    pthread_rwlock_t lock;
+    int initialized;
+} CCVFSRwLock;
+
+/*
+ * Static initializer for locks with static storage, which need no ccvfs_rwlock_init()
+ */
+#define CCVFS_RWLOCK_INITIALIZER { PTHREAD_RWLOCK_INITIALIZER, 1 }
+
+int ccvfs_rwlock_init(CCVFSRwLock *pLock);
+void ccvfs_rwlock_destroy(CCVFSRwLock *pLock);
+void ccvfs_rwlock_read_enter(CCVFSRwLock *pLock);
+void ccvfs_rwlock_read_leave(CCVFSRwLock *pLock);
+void ccvfs_rwlock_write_enter(CCVFSRwLock *pLock);
+void ccvfs_rwlock_write_leave(CCVFSRwLock *pLock);
+
+/*
+ * Statistics counters - 统计计数器
+ * Relaxed atomic updates: counters carry no ordering, they only must not tear or lose increments.
+ * CCVFS_COUNTER_SET is for resets and runtime switches read on hot paths.
+ */
+#if defined(__GNUC__) || defined(__clang__)
+#define CCVFS_COUNTER_ADD(var, n) ((void)__atomic_fetch_add(&(var), (n), __ATOMIC_RELAXED))
+#define CCVFS_COUNTER_GET(var)    __atomic_load_n(&(var), __ATOMIC_RELAXED)
+#define CCVFS_COUNTER_SET(var, v) __atomic_store_n(&(var), (v), __ATOMIC_RELAXED)
+#else
+#define CCVFS_COUNTER_ADD(var, n) ((void)((var) += (n)))
+#define CCVFS_COUNTER_GET(var)    (var)
+#define CCVFS_COUNTER_SET(var, v) ((void)((var) = (v)))
+#endif
+
+#define CCVFS_COUNTER_INC(var) CCVFS_COUNTER_ADD(var, 1)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CCVFS_SYNC_H */
@@ -0,0 +1,34 @@
+#ifndef CCVFS_TRANSCODE_H
+#define CCVFS_TRANSCODE_H
+
+#include "ccvfs_internal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Offline copy helpers - 离线复制辅助函数
+ * Shared by the transcoder and the raw backup.
+ */
+
+/*
+ * 打开源数据库并持有读事务，使主文件在复制期间保持不变；WAL中的帧先检查点到主文件
+ * Open a database and hold a read transaction so the main file stays put while it is copied,
+ * frames in its WAL are checkpointed into the main file first. A NULL zVfs uses the default VFS.
+ * Returns SQLITE_BUSY when the WAL could not be checkpointed.
+ */
+int ccvfs_transcode_open_source(const char *source_db, const char *zVfs, sqlite3 **pDb,
+                                uint32_t *pSqlitePageSize, uint32_t *pPageCount);
+
+/*
+ * 删除目标文件旁边属于旧数据库的日志、WAL和共享索引文件
+ * Remove the journal, WAL and shared index files a replaced target left behind
+ */
+void ccvfs_transcode_remove_journals(const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CCVFS_TRANSCODE_H */
@@ -19,12 +19,12 @@ typedef struct {
     uint64_t total_allocated_space;
     uint64_t total_used_space;
     uint32_t fragmentation_score;
-    uint32_t space_reuse_count;
-    uint32_t space_expansion_count;
-    uint32_t new_allocation_count;
-    uint32_t hole_reclaim_count;
-    uint32_t best_fit_count;
-    uint32_t sequential_write_count;
+    uint64_t space_reuse_count;
+    uint64_t space_expansion_count;
+    uint64_t new_allocation_count;
+    uint64_t hole_reclaim_count;
+    uint64_t best_fit_count;
+    uint64_t sequential_write_count;
     double space_efficiency_ratio;
     double reuse_efficiency_ratio;
     double hole_reclaim_ratio;
@@ -5,6 +5,11 @@
 #include <sys/stat.h>
 
 #include "ccvfs_io.h"
+#include "ccvfs_snapshot.h"
+#include "ccvfs_stats.h"
+#include "ccvfs_latency.h"
+#include "ccvfs_record.h"
+#include "ccvfs_scrub.h"
 
 // ============================================================================
 // VFS级别密钥管理函数 - 推荐使用
@@ -211,6 +216,9 @@ int sqlite3_ccvfs_create(
     pNew->max_buffer_size = CCVFS_DEFAULT_MAX_BUFFER_SIZE;
     pNew->auto_flush_pages = CCVFS_DEFAULT_AUTO_FLUSH_PAGES;
     
+    // Shared page index is opt-in
+    pNew->enable_shared_index = 0;
+    
     // Initialize data integrity configuration with defaults
     pNew->strict_checksum_mode = 1;
     pNew->enable_data_recovery = 0;
@@ -233,10 +241,29 @@ int sqlite3_ccvfs_create(
         pNew->zEncryptType = pEncryptAlg->name;
     }
     
+    // Open file list for VFS-wide statistics
+    int rc = ccvfs_stats_init_vfs(pNew);
+    if (rc != SQLITE_OK) {
+        CCVFS_ERROR("Failed to initialize VFS statistics: %d", rc);
+        sqlite3_free(pNew);
+        return rc;
+    }
+    
+    // I/O recording, off until sqlite3_ccvfs_record_start()
+    rc = ccvfs_record_init_vfs(pNew);
+    if (rc != SQLITE_OK) {
+        CCVFS_ERROR("Failed to initialize I/O recording: %d", rc);
+        ccvfs_stats_destroy_vfs(pNew);
+        sqlite3_free(pNew);
+        return rc;
+    }
+    
     // Register VFS
-    int rc = sqlite3_vfs_register(&pNew->base, 0);
+    rc = sqlite3_vfs_register(&pNew->base, 0);
     if (rc != SQLITE_OK) {
         CCVFS_ERROR("Failed to register VFS: %d", rc);
+        ccvfs_record_destroy_vfs(pNew);
+        ccvfs_stats_destroy_vfs(pNew);
         sqlite3_free(pNew);
         return rc;
     }
@@ -299,7 +326,10 @@ int sqlite3_ccvfs_destroy(const char *zVfsName) {
     // Unregister VFS
     sqlite3_vfs_unregister(pVfs);
     
-    // Free memory
+    // Stop the scrubber, then free memory
+    ccvfs_scrub_destroy_vfs(pCcvfs);
+    ccvfs_record_destroy_vfs(pCcvfs);
+    ccvfs_stats_destroy_vfs(pCcvfs);
     sqlite3_free(pCcvfs);
     
     CCVFS_DEBUG("Successfully destroyed CCVFS: %s", zVfsName);
@@ -361,6 +391,27 @@ int sqlite3_ccvfs_configure_write_buffer(
     return SQLITE_OK;
 }
 
+/*
+ * Configure the shared page index for a VFS
+ */
+int sqlite3_ccvfs_configure_shared_index(const char *zVfsName, int enabled) {
+    sqlite3_vfs *pVfs;
+    CCVFS *pCcvfs;
+    
+    pVfs = sqlite3_vfs_find(zVfsName);
+    if (!pVfs) {
+        CCVFS_ERROR("VFS not found: %s", zVfsName);
+        return SQLITE_ERROR;
+    }
+    
+    pCcvfs = (CCVFS*)pVfs;
+    pCcvfs->enable_shared_index = enabled ? 1 : 0;
+    
+    CCVFS_DEBUG("Shared page index %s for VFS: %s",
+              pCcvfs->enable_shared_index ? "enabled" : "disabled", zVfsName);
+    return SQLITE_OK;
+}
+
 /*
  * Get write buffer statistics for an open database
  */
@@ -393,16 +444,137 @@ int sqlite3_ccvfs_get_buffer_stats(
         return SQLITE_ERROR;
     }
     
-    // Return statistics
-    if (buffer_hits) *buffer_hits = pCcvfsFile->buffer_hit_count;
-    if (buffer_flushes) *buffer_flushes = pCcvfsFile->buffer_flush_count;
-    if (buffer_merges) *buffer_merges = pCcvfsFile->buffer_merge_count;
-    if (total_buffered_writes) *total_buffered_writes = pCcvfsFile->total_buffered_writes;
+    // Return statistics (truncated to 32 bits, sqlite3_ccvfs_get_file_stats has the full values)
+    if (buffer_hits) *buffer_hits = (uint32_t)CCVFS_COUNTER_GET(pCcvfsFile->counters.buffer_hit_count);
+    if (buffer_flushes) *buffer_flushes = (uint32_t)CCVFS_COUNTER_GET(pCcvfsFile->counters.buffer_flush_count);
+    if (buffer_merges) *buffer_merges = (uint32_t)CCVFS_COUNTER_GET(pCcvfsFile->counters.buffer_merge_count);
+    if (total_buffered_writes) *total_buffered_writes = (uint32_t)CCVFS_COUNTER_GET(pCcvfsFile->counters.total_buffered_writes);
+    
+    CCVFS_DEBUG("Buffer stats: hits=%llu, flushes=%llu, merges=%llu, total_writes=%llu",
+               (unsigned long long)pCcvfsFile->counters.buffer_hit_count,
+               (unsigned long long)pCcvfsFile->counters.buffer_flush_count,
+               (unsigned long long)pCcvfsFile->counters.buffer_merge_count,
+               (unsigned long long)pCcvfsFile->counters.total_buffered_writes);
+    
+    return SQLITE_OK;
+}
+
+/*
+ * Get statistics for an open database
+ */
+int sqlite3_ccvfs_get_file_stats(sqlite3 *db, CCVFSFileStats *pStats) {
+    sqlite3_file *pFile;
+    CCVFSFile *pCcvfsFile;
+    
+    if (!db || !pStats) {
+        CCVFS_ERROR("Database connection or statistics pointer is NULL");
+        return SQLITE_ERROR;
+    }
+    
+    // Get the main database file
+    int rc = sqlite3_file_control(db, NULL, SQLITE_FCNTL_FILE_POINTER, &pFile);
+    if (rc != SQLITE_OK || !pFile) {
+        CCVFS_ERROR("Failed to get file pointer from database: %d", rc);
+        return SQLITE_ERROR;
+    }
+    
+    // Check if this is a CCVFS file
+    pCcvfsFile = (CCVFSFile*)pFile;
+    if (!pCcvfsFile->is_ccvfs_file) {
+        CCVFS_ERROR("Database is not using CCVFS");
+        return SQLITE_ERROR;
+    }
+    
+    ccvfs_stats_collect(pCcvfsFile, pStats);
+    return SQLITE_OK;
+}
+
+/*
+ * Get statistics aggregated over a VFS
+ */
+int sqlite3_ccvfs_get_vfs_stats(const char *zVfsName, CCVFSFileStats *pStats) {
+    sqlite3_vfs *pVfs;
+    
+    if (!zVfsName || !pStats) {
+        return SQLITE_ERROR;
+    }
+    
+    pVfs = sqlite3_vfs_find(zVfsName);
+    if (!pVfs || pVfs->xOpen != ccvfsOpen) {
+        CCVFS_ERROR("VFS not found or not a CCVFS: %s", zVfsName);
+        return SQLITE_ERROR;
+    }
+    
+    ccvfs_stats_collect_vfs((CCVFS*)pVfs, pStats);
+    return SQLITE_OK;
+}
+
+/*
+ * Enable or disable latency histograms for a VFS
+ */
+int sqlite3_ccvfs_configure_histograms(const char *zVfsName, int enabled) {
+    sqlite3_vfs *pVfs;
+    
+    if (!zVfsName) {
+        return SQLITE_ERROR;
+    }
+    
+    pVfs = sqlite3_vfs_find(zVfsName);
+    if (!pVfs || pVfs->xOpen != ccvfsOpen) {
+        CCVFS_ERROR("VFS not found or not a CCVFS: %s", zVfsName);
+        return SQLITE_ERROR;
+    }
+    
+    ccvfs_latency_configure_vfs((CCVFS*)pVfs, enabled);
+    
+    CCVFS_DEBUG("Latency histograms %s for VFS: %s", enabled ? "enabled" : "disabled", zVfsName);
+    return SQLITE_OK;
+}
+
+/*
+ * Get the CCVFS file behind the main database of a connection, NULL if it is not a CCVFS file
+ */
+static CCVFSFile *ccvfs_main_file(sqlite3 *db) {
+    sqlite3_file *pFile = NULL;
+    
+    if (!db) {
+        CCVFS_ERROR("Database connection is NULL");
+        return NULL;
+    }
+    if (sqlite3_file_control(db, NULL, SQLITE_FCNTL_FILE_POINTER, &pFile) != SQLITE_OK || !pFile) {
+        CCVFS_ERROR("Failed to get file pointer from database");
+        return NULL;
+    }
+    if (!((CCVFSFile*)pFile)->is_ccvfs_file) {
+        CCVFS_ERROR("Database is not using CCVFS");
+        return NULL;
+    }
+    return (CCVFSFile*)pFile;
+}
+
+/*
+ * Get the latency histograms of an open database
+ */
+int sqlite3_ccvfs_get_histograms(sqlite3 *db, CCVFSLatencyHistogram *aHist) {
+    CCVFSFile *pCcvfsFile = ccvfs_main_file(db);
     
-    CCVFS_DEBUG("Buffer stats: hits=%u, flushes=%u, merges=%u, total_writes=%u",
-               pCcvfsFile->buffer_hit_count, pCcvfsFile->buffer_flush_count,
-               pCcvfsFile->buffer_merge_count, pCcvfsFile->total_buffered_writes);
+    if (!pCcvfsFile || !aHist) {
+        return SQLITE_ERROR;
+    }
+    ccvfs_latency_copy(pCcvfsFile, aHist);
+    return SQLITE_OK;
+}
+
+/*
+ * Clear the latency histograms of an open database
+ */
+int sqlite3_ccvfs_reset_histograms(sqlite3 *db) {
+    CCVFSFile *pCcvfsFile = ccvfs_main_file(db);
     
+    if (!pCcvfsFile) {
+        return SQLITE_ERROR;
+    }
+    ccvfs_latency_reset(pCcvfsFile);
     return SQLITE_OK;
 }
 
@@ -432,20 +604,24 @@ int sqlite3_ccvfs_flush_write_buffer(sqlite3 *db) {
         return SQLITE_ERROR;
     }
     
-    // Flush write buffer
+    // Flush write buffer (may run on a different thread than the connection's I/O)
+    rc = SQLITE_OK;
+    ccvfs_rwlock_write_enter(&pCcvfsFile->index_lock);
     if (pCcvfsFile->write_buffer.enabled && pCcvfsFile->write_buffer.entry_count > 0) {
         CCVFS_DEBUG("Force flushing %u buffered entries", pCcvfsFile->write_buffer.entry_count);
         rc = ccvfs_flush_write_buffer(pCcvfsFile);
         if (rc != SQLITE_OK) {
             CCVFS_ERROR("Failed to flush write buffer: %d", rc);
-            return rc;
+        } else {
+            CCVFS_DEBUG("Write buffer flushed successfully");
         }
-        CCVFS_DEBUG("Write buffer flushed successfully");
     } else {
         CCVFS_DEBUG("No buffered data to flush");
     }
+    ccvfs_snapshot_publish(pCcvfsFile);
+    ccvfs_rwlock_write_leave(&pCcvfsFile->index_lock);
     
-    return SQLITE_OK;
+    return rc;
 }
 
 /*
@@ -579,9 +755,7 @@ int sqlite3_ccvfs_decompress_decrypt(
     const char *source_db,
     const char *target_db
 ) {
-    sqlite3 *source = NULL;
-    sqlite3 *target = NULL;
-    int rc = SQLITE_OK;
+    int rc;
     
     if (!zVfsName || !source_db || !target_db) {
         CCVFS_ERROR("参数不能为NULL");
@@ -606,50 +780,21 @@ int sqlite3_ccvfs_decompress_decrypt(
         return SQLITE_ERROR;
     }
     
-    // 使用指定VFS打开压缩/加密数据库（只读模式）
-    rc = sqlite3_open_v2(source_db, &source, SQLITE_OPEN_READONLY, zVfsName);
-    if (rc != SQLITE_OK) {
-        CCVFS_ERROR("打开源数据库失败: %s", sqlite3_errmsg(source));
-        return rc;
-    }
-    
-    // 创建标准SQLite数据库
-    rc = sqlite3_open_v2(target_db, &target, 
-                         SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, 
-                         NULL);
-    if (rc != SQLITE_OK) {
-        CCVFS_ERROR("创建目标数据库失败: %s", sqlite3_errmsg(target));
-        sqlite3_close(source);
-        return rc;
-    }
-    
-    // 使用SQLite备份API进行高效复制
-    sqlite3_backup *backup = sqlite3_backup_init(target, "main", source, "main");
-    if (!backup) {
-        CCVFS_ERROR("初始化备份失败");
-        sqlite3_close(source);
-        sqlite3_close(target);
-        return SQLITE_ERROR;
-    }
+    // 直接转码，使用该VFS的算法和密钥
+    // Transcode directly with the algorithms and the key of this VFS
+    CCVFSDecompressOptions opts;
+    memset(&opts, 0, sizeof(opts));
+    opts.vfs_name = zVfsName;
     
     CCVFS_DEBUG("正在解压解密数据库...");
     
-    // 复制所有页面
-    do {
-        rc = sqlite3_backup_step(backup, -1);  // 一次性复制所有页面
-    } while (rc == SQLITE_OK || rc == SQLITE_BUSY || rc == SQLITE_LOCKED);
-    
-    sqlite3_backup_finish(backup);
-    sqlite3_close(source);
-    sqlite3_close(target);
-    
-    if (rc == SQLITE_DONE) {
+    rc = sqlite3_ccvfs_decompress_database_parallel(source_db, target_db, &opts);
+    if (rc == SQLITE_OK) {
         CCVFS_DEBUG("数据库解压解密成功");
-        return SQLITE_OK;
     } else {
         CCVFS_ERROR("数据库解压解密失败: %d", rc);
-        return rc;
     }
+    return rc;
 }
 
 /*
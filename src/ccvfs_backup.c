@@ -0,0 +1,846 @@
+#include "ccvfs_transcode.h"
+#include "ccvfs_utils.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * 原始热备份
+ * 在自己的读事务下把被索引引用的压缩数据块原样复制到副本，不解码也不重新编码，CPU开销只有
+ * 可选的校验和检查。数据块按物理偏移顺序读取，物理上和副本中都相邻的块合并成一次读写。
+ *
+ * Raw hot backup
+ * Under a read transaction of its own the stored blocks the index references are copied to the
+ * replica as they are, never decoded or encoded again, so the only CPU cost is the optional
+ * checksum check. Blocks are read in physical offset order and blocks that are adjacent both in
+ * the source and in the replica are merged into one read and one write.
+ *
+ * 增量备份
+ * 数据块本身不带序列号，索引代（change_counter）充当备份的序列点：增量文件只携带索引条目
+ * 与上一次备份不同的块，再加上完整的目标索引。应用时只写入这些块，未变化的块在原偏移处不动。
+ *
+ * Incremental backup
+ * Stored blocks carry no sequence number of their own, the index generation (change_counter)
+ * is the sequence point of a backup: a delta carries only the blocks whose index entry differs
+ * from the earlier backup, plus the whole target index. Applying it writes just those blocks,
+ * unchanged blocks stay where they are.
+ */
+
+#define CCVFS_BACKUP_RUN_SIZE (1024 * 1024)  // Largest merged read and write
+
+typedef struct {
+    uint64_t src_offset;
+    uint64_t dst_offset;
+    uint32_t size;
+    uint32_t iBlock;
+} CCVFSBackupExtent;
+
+// Source of a backup: a reading connection of its own and the index it saw
+typedef struct {
+    const char *zPath;
+    sqlite3 *rdb;
+    sqlite3_file *pSrc;
+    sqlite3_int64 nFile;
+    CCVFSFileHeader header;
+    CCVFSPageIndex *aIndex;
+    uint32_t nEntry;
+} CCVFSBackupSource;
+
+static int ccvfs_backup_extent_cmp(const void *a, const void *b) {
+    const CCVFSBackupExtent *x = (const CCVFSBackupExtent *)a;
+    const CCVFSBackupExtent *y = (const CCVFSBackupExtent *)b;
+    if (x->src_offset != y->src_offset) {
+        return x->src_offset < y->src_offset ? -1 : 1;
+    }
+    return x->iBlock < y->iBlock ? -1 : (x->iBlock > y->iBlock);
+}
+
+static int ccvfs_backup_stored(const CCVFSPageIndex *pIndex) {
+    return pIndex->physical_offset != 0 && !(pIndex->flags & CCVFS_PAGE_SPARSE) && pIndex->compressed_size != 0;
+}
+
+static int ccvfs_backup_write(int fd, const unsigned char *aData, size_t nData, uint64_t iOffset) {
+    while (nData > 0) {
+        ssize_t n = pwrite(fd, aData, nData, (off_t)iOffset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return SQLITE_IOERR_WRITE;
+        }
+        aData += n;
+        nData -= (size_t)n;
+        iOffset += (uint64_t)n;
+    }
+    return SQLITE_OK;
+}
+
+static int ccvfs_backup_read(int fd, void *pBuf, size_t nData, uint64_t iOffset) {
+    unsigned char *aData = (unsigned char *)pBuf;
+    while (nData > 0) {
+        ssize_t n = pread(fd, aData, nData, (off_t)iOffset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            return SQLITE_IOERR_READ;
+        }
+        if (n == 0) {
+            return SQLITE_IOERR_SHORT_READ;
+        }
+        aData += n;
+        nData -= (size_t)n;
+        iOffset += (uint64_t)n;
+    }
+    return SQLITE_OK;
+}
+
+// Every stored block of the index must lie between the end of the index and the end of the file
+static int ccvfs_backup_check_index(const CCVFSPageIndex *aIndex, uint32_t nEntry, uint64_t nIndexEnd,
+                                    uint64_t nFile) {
+    uint32_t i;
+    for (i = 0; i < nEntry; i++) {
+        if (ccvfs_backup_stored(&aIndex[i]) &&
+            (aIndex[i].physical_offset < nIndexEnd ||
+             aIndex[i].physical_offset + aIndex[i].compressed_size > nFile)) {
+            CCVFS_ERROR("Block %u has an invalid index entry: offset=%llu, size=%u",
+                        i, (unsigned long long)aIndex[i].physical_offset, aIndex[i].compressed_size);
+            return SQLITE_CORRUPT;
+        }
+    }
+    return SQLITE_OK;
+}
+
+static void ccvfs_backup_source_close(CCVFSBackupSource *p) {
+    sqlite3_close(p->rdb);
+    sqlite3_free(p->aIndex);
+    memset(p, 0, sizeof(*p));
+}
+
+/*
+ * 单独的读连接：不改变调用方连接的事务状态。文件头和索引通过读连接自己的文件句柄读取，
+ * 见ccvfs_transcode_read_header()
+ * A separate reading connection leaves the transaction state of the caller's connection alone.
+ * The header and the index are read through the handle of that connection, see
+ * ccvfs_transcode_read_header()
+ */
+static int ccvfs_backup_source_open(sqlite3 *db, CCVFSBackupSource *p) {
+    sqlite3_file *pFile = NULL;
+    uint32_t sqlitePageSize = 0, sqlitePages = 0;
+    int rc;
+
+    memset(p, 0, sizeof(*p));
+    if (sqlite3_file_control(db, NULL, SQLITE_FCNTL_FILE_POINTER, &pFile) != SQLITE_OK || !pFile ||
+        !((CCVFSFile *)pFile)->is_ccvfs_file) {
+        CCVFS_ERROR("Database is not using CCVFS");
+        return SQLITE_MISUSE;
+    }
+    p->zPath = sqlite3_db_filename(db, "main");
+    if (!p->zPath || !p->zPath[0]) {
+        CCVFS_ERROR("Cannot back up a temporary database");
+        return SQLITE_MISUSE;
+    }
+
+    rc = ccvfs_transcode_open_source(p->zPath, ((CCVFSFile *)pFile)->pOwner->base.zName, &p->rdb,
+                                     &sqlitePageSize, &sqlitePages);
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+
+    pFile = NULL;
+    if (sqlite3_file_control(p->rdb, NULL, SQLITE_FCNTL_FILE_POINTER, &pFile) != SQLITE_OK || !pFile ||
+        !((CCVFSFile *)pFile)->is_ccvfs_file) {
+        ccvfs_backup_source_close(p);
+        return SQLITE_ERROR;
+    }
+    p->pSrc = ((CCVFSFile *)pFile)->pReal;
+    if (p->pSrc->pMethods->xFileSize(p->pSrc, &p->nFile) != SQLITE_OK ||
+        p->pSrc->pMethods->xRead(p->pSrc, &p->header, CCVFS_HEADER_SIZE, 0) != SQLITE_OK ||
+        memcmp(p->header.magic, CCVFS_MAGIC, 8) != 0 ||
+        p->header.total_pages > CCVFS_MAX_PAGES ||
+        p->header.index_table_offset < CCVFS_HEADER_SIZE) {
+        CCVFS_ERROR("Invalid CCVFS header in %s", p->zPath);
+        ccvfs_backup_source_close(p);
+        return SQLITE_CORRUPT;
+    }
+    p->nEntry = p->header.total_pages;
+
+    p->aIndex = (CCVFSPageIndex *)sqlite3_malloc64(sizeof(CCVFSPageIndex) * (p->nEntry ? p->nEntry : 1));
+    if (!p->aIndex) {
+        ccvfs_backup_source_close(p);
+        return SQLITE_NOMEM;
+    }
+    if (p->nEntry > 0) {
+        rc = p->pSrc->pMethods->xRead(p->pSrc, p->aIndex, (int)(sizeof(CCVFSPageIndex) * p->nEntry),
+                                      (sqlite3_int64)p->header.index_table_offset);
+        if (rc != SQLITE_OK) {
+            CCVFS_ERROR("Failed to read the index table of %s: %d", p->zPath, rc);
+            ccvfs_backup_source_close(p);
+            return rc;
+        }
+    }
+    rc = ccvfs_backup_check_index(p->aIndex, p->nEntry,
+                                  p->header.index_table_offset + (uint64_t)p->nEntry * sizeof(CCVFSPageIndex),
+                                  (uint64_t)p->nFile);
+    if (rc != SQLITE_OK) {
+        ccvfs_backup_source_close(p);
+    }
+    return rc;
+}
+
+/*
+ * 复制数据块：aExtent按源偏移排序，在源和目标中都相邻的块合并成一次读写
+ * Copy stored blocks: aExtent is sorted by source offset, blocks that are adjacent both in the
+ * source and in the target are merged into one read and one write
+ */
+static int ccvfs_backup_copy(CCVFSBackupSource *p, const CCVFSBackupExtent *aExtent, uint32_t nExtent,
+                             int fd, const CCVFSBackupOptions *pOpts, uint64_t *pnCopied) {
+    unsigned char *aRun;
+    uint32_t nRunMax = CCVFS_BACKUP_RUN_SIZE;
+    uint32_t i, nDone = 0, nReported = 0;
+    int rc = SQLITE_OK;
+
+    for (i = 0; i < nExtent; i++) {
+        if (aExtent[i].size > nRunMax) {
+            nRunMax = aExtent[i].size;
+        }
+    }
+    aRun = (unsigned char *)sqlite3_malloc64(nRunMax);
+    if (!aRun) {
+        return SQLITE_NOMEM;
+    }
+
+    for (i = 0; i < nExtent; ) {
+        uint32_t j = i + 1;
+        uint64_t nRun = aExtent[i].size;
+        while (j < nExtent &&
+               aExtent[j].src_offset == aExtent[i].src_offset + nRun &&
+               aExtent[j].dst_offset == aExtent[i].dst_offset + nRun &&
+               nRun + aExtent[j].size <= nRunMax) {
+            nRun += aExtent[j].size;
+            j++;
+        }
+
+        rc = p->pSrc->pMethods->xRead(p->pSrc, aRun, (int)nRun, (sqlite3_int64)aExtent[i].src_offset);
+        if (rc != SQLITE_OK) {
+            CCVFS_ERROR("Failed to read %llu bytes at %llu from %s: %d", (unsigned long long)nRun,
+                        (unsigned long long)aExtent[i].src_offset, p->zPath, rc);
+            break;
+        }
+        if (pOpts->verify) {
+            const unsigned char *pData = aRun;
+            uint32_t k;
+            for (k = i; k < j; k++) {
+                if (ccvfs_crc32(pData, (int)aExtent[k].size) != p->aIndex[aExtent[k].iBlock].checksum) {
+                    CCVFS_ERROR("Block %u checksum mismatch at offset %llu", aExtent[k].iBlock,
+                                (unsigned long long)aExtent[k].src_offset);
+                    rc = SQLITE_CORRUPT;
+                    break;
+                }
+                pData += aExtent[k].size;
+            }
+            if (rc != SQLITE_OK) {
+                break;
+            }
+        }
+        rc = ccvfs_backup_write(fd, aRun, (size_t)nRun, aExtent[i].dst_offset);
+        if (rc != SQLITE_OK) {
+            break;
+        }
+        *pnCopied += nRun;
+        nDone += j - i;
+        i = j;
+
+        if (pOpts->xProgress && (nDone - nReported >= (nExtent + 99) / 100 || nDone == nExtent)) {
+            pOpts->xProgress(pOpts->pProgressArg, nDone, nExtent);
+            nReported = nDone;
+        }
+    }
+    if (rc == SQLITE_OK && nExtent == 0 && pOpts->xProgress) {
+        pOpts->xProgress(pOpts->pProgressArg, 0, 0);
+    }
+
+    sqlite3_free(aRun);
+    return rc;
+}
+
+/*
+ * 文件头沿用源文件的字段，只更新大小统计、变更掩码和校验和
+ * The header keeps the fields of the source, only the size statistics, the change mask and the
+ * checksum are updated
+ */
+static void ccvfs_backup_finish_header(CCVFSFileHeader *pHeader, uint64_t nFile) {
+    pHeader->compressed_file_size = nFile;
+    pHeader->compression_ratio = pHeader->original_file_size > 0 && nFile <= pHeader->original_file_size
+                               ? (uint32_t)((pHeader->original_file_size - nFile) * 100 / pHeader->original_file_size)
+                               : 0;
+    memset(pHeader->index_change_mask, 0xFF, sizeof(pHeader->index_change_mask));
+    pHeader->header_checksum = ccvfs_crc32((const unsigned char *)pHeader, CCVFS_HEADER_SIZE - sizeof(uint32_t));
+}
+
+int sqlite3_ccvfs_backup(sqlite3 *db, const char *dst_path, const CCVFSBackupOptions *pOptions) {
+    CCVFSBackupOptions opts;
+    CCVFSBackupSource src;
+    CCVFSBackupExtent *aExtent = NULL;
+    const char *zPath;
+    int fd = -1;
+    int rc;
+    uint32_t nExtent = 0;
+    uint64_t nIndexEnd, nFile, nCopied = 0;
+    uint32_t i;
+
+    if (!db || !dst_path) {
+        return SQLITE_MISUSE;
+    }
+    memset(&opts, 0, sizeof(opts));
+    if (pOptions) {
+        opts = *pOptions;
+    }
+    zPath = sqlite3_db_filename(db, "main");
+    if (zPath && strcmp(zPath, dst_path) == 0) {
+        CCVFS_ERROR("Cannot back up %s onto itself", dst_path);
+        return SQLITE_MISUSE;
+    }
+
+    rc = ccvfs_backup_source_open(db, &src);
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+    nIndexEnd = src.header.index_table_offset + (uint64_t)src.nEntry * sizeof(CCVFSPageIndex);
+
+    aExtent = (CCVFSBackupExtent *)sqlite3_malloc64(sizeof(CCVFSBackupExtent) * (src.nEntry ? src.nEntry : 1));
+    if (!aExtent) {
+        rc = SQLITE_NOMEM;
+        goto cleanup;
+    }
+
+    // 压缩时按块顺序紧密排列，索引中的偏移随之改写
+    // Compaction packs the blocks back to back in block order and rewrites their index offsets
+    uint64_t iNext = CCVFS_DATA_PAGES_OFFSET;
+    for (i = 0; i < src.nEntry; i++) {
+        CCVFSPageIndex *pIndex = &src.aIndex[i];
+        if (!ccvfs_backup_stored(pIndex)) {
+            continue;
+        }
+        CCVFSBackupExtent *pExtent = &aExtent[nExtent++];
+        pExtent->src_offset = pIndex->physical_offset;
+        pExtent->size = pIndex->compressed_size;
+        pExtent->iBlock = i;
+        if (opts.compact) {
+            pExtent->dst_offset = iNext;
+            pIndex->physical_offset = iNext;
+            iNext += pIndex->compressed_size;
+        } else {
+            pExtent->dst_offset = pExtent->src_offset;
+        }
+    }
+    qsort(aExtent, nExtent, sizeof(CCVFSBackupExtent), ccvfs_backup_extent_cmp);
+    if (opts.compact) {
+        nFile = iNext > CCVFS_DATA_PAGES_OFFSET ? iNext : nIndexEnd;
+    } else {
+        nFile = (uint64_t)src.nFile;
+    }
+
+    ccvfs_transcode_remove_journals(dst_path);
+    fd = open(dst_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        CCVFS_ERROR("Failed to create %s", dst_path);
+        rc = SQLITE_CANTOPEN;
+        goto cleanup;
+    }
+
+    CCVFS_INFO("Backing up %s to %s: %u stored blocks%s", src.zPath, dst_path, nExtent,
+               opts.compact ? ", compacted" : "");
+
+    rc = ccvfs_backup_copy(&src, aExtent, nExtent, fd, &opts, &nCopied);
+    if (rc != SQLITE_OK) {
+        goto cleanup;
+    }
+
+    ccvfs_backup_finish_header(&src.header, nFile);
+    rc = ccvfs_backup_write(fd, (const unsigned char *)&src.header, CCVFS_HEADER_SIZE, 0);
+    if (rc == SQLITE_OK && src.nEntry > 0) {
+        rc = ccvfs_backup_write(fd, (const unsigned char *)src.aIndex, sizeof(CCVFSPageIndex) * src.nEntry,
+                                src.header.index_table_offset);
+    }
+    if (rc != SQLITE_OK) {
+        goto cleanup;
+    }
+
+    // 未引用的空间在副本中为空洞
+    // Space nothing references stays a hole in the replica
+    if (ftruncate(fd, (off_t)nFile) != 0 || fsync(fd) != 0) {
+        rc = SQLITE_IOERR_FSYNC;
+        goto cleanup;
+    }
+
+    CCVFS_INFO("Backed up %s: %llu of %llu bytes copied", src.zPath, (unsigned long long)nCopied,
+               (unsigned long long)src.nFile);
+
+cleanup:
+    ccvfs_backup_source_close(&src);
+    if (fd >= 0 && close(fd) != 0 && rc == SQLITE_OK) {
+        rc = SQLITE_IOERR_CLOSE;
+    }
+    if (rc != SQLITE_OK && fd >= 0) {
+        unlink(dst_path);
+    }
+    sqlite3_free(aExtent);
+    return rc;
+}
+
+static uint32_t ccvfs_delta_header_checksum(const CCVFSDeltaHeader *pDelta) {
+    return ccvfs_crc32((const unsigned char *)pDelta, CCVFS_DELTA_HEADER_SIZE - sizeof(uint32_t));
+}
+
+static uint32_t ccvfs_delta_index_checksum(const CCVFSPageIndex *aIndex, uint32_t nEntry) {
+    return nEntry > 0 ? ccvfs_crc32((const unsigned char *)aIndex, (int)(sizeof(CCVFSPageIndex) * nEntry)) : 0;
+}
+
+/*
+ * 读取基础备份的索引代和索引：基础可以是备份副本，也可以是上一个增量文件（其目标索引）。
+ * 通过默认VFS的连接读取，见ccvfs_transcode_read_header()
+ * Read the index generation and the index of the base of a delta: either a backup copy or an
+ * earlier delta, whose target index describes the copy once it is applied. Read through a
+ * connection of the default VFS, see ccvfs_transcode_read_header()
+ */
+static int ccvfs_delta_read_base(const char *base_path, uint32_t *pGeneration, CCVFSPageIndex **paIndex,
+                                 uint32_t *pnEntry) {
+    sqlite3 *db = NULL;
+    sqlite3_file *pFile = NULL;
+    CCVFSFileHeader header;
+    CCVFSDeltaHeader delta;
+    CCVFSPageIndex *aIndex = NULL;
+    sqlite3_int64 iIndex;
+    uint32_t nEntry;
+    int isDelta = 0;
+    int rc;
+
+    *paIndex = NULL;
+    *pnEntry = 0;
+    memset(&delta, 0, sizeof(delta));
+    rc = sqlite3_open_v2(base_path, &db, SQLITE_OPEN_READONLY, NULL);
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_file_control(db, NULL, SQLITE_FCNTL_FILE_POINTER, &pFile);
+    }
+    if (rc == SQLITE_OK && (!pFile || !pFile->pMethods)) {
+        rc = SQLITE_CANTOPEN;
+    }
+    if (rc == SQLITE_OK) {
+        rc = pFile->pMethods->xRead(pFile, &header, CCVFS_HEADER_SIZE, 0);
+    }
+    if (rc != SQLITE_OK) {
+        CCVFS_ERROR("Cannot read the base backup %s: %d", base_path, rc);
+        sqlite3_close(db);
+        return rc == SQLITE_IOERR_SHORT_READ ? SQLITE_NOTADB : rc;
+    }
+
+    if (memcmp(header.magic, CCVFS_MAGIC, 8) == 0) {
+        *pGeneration = header.change_counter;
+        nEntry = header.total_pages;
+        iIndex = (sqlite3_int64)header.index_table_offset;
+    } else if (memcmp(header.magic, CCVFS_DELTA_MAGIC, 8) == 0) {
+        isDelta = 1;
+        memcpy(&delta, &header, CCVFS_DELTA_HEADER_SIZE);
+        if (delta.version != CCVFS_DELTA_VERSION ||
+            delta.header_checksum != ccvfs_delta_header_checksum(&delta) ||
+            pFile->pMethods->xRead(pFile, &header, CCVFS_HEADER_SIZE, CCVFS_DELTA_HEADER_SIZE) != SQLITE_OK) {
+            CCVFS_ERROR("Damaged delta header in %s", base_path);
+            sqlite3_close(db);
+            return SQLITE_CORRUPT;
+        }
+        *pGeneration = header.change_counter;
+        nEntry = delta.target_total_pages;
+        iIndex = CCVFS_DELTA_HEADER_SIZE + CCVFS_HEADER_SIZE;
+    } else {
+        CCVFS_ERROR("%s is neither a CCVFS backup nor a backup delta", base_path);
+        sqlite3_close(db);
+        return SQLITE_NOTADB;
+    }
+    if (nEntry > CCVFS_MAX_PAGES) {
+        sqlite3_close(db);
+        return SQLITE_CORRUPT;
+    }
+
+    aIndex = (CCVFSPageIndex *)sqlite3_malloc64(sizeof(CCVFSPageIndex) * (nEntry ? nEntry : 1));
+    if (!aIndex) {
+        sqlite3_close(db);
+        return SQLITE_NOMEM;
+    }
+    if (nEntry > 0) {
+        rc = pFile->pMethods->xRead(pFile, aIndex, (int)(sizeof(CCVFSPageIndex) * nEntry), iIndex);
+        if (rc == SQLITE_IOERR_SHORT_READ ||
+            (rc == SQLITE_OK && isDelta && ccvfs_delta_index_checksum(aIndex, nEntry) != delta.target_index_checksum)) {
+            rc = SQLITE_CORRUPT;
+        }
+    }
+    sqlite3_close(db);
+    if (rc != SQLITE_OK) {
+        sqlite3_free(aIndex);
+        return rc;
+    }
+    *paIndex = aIndex;
+    *pnEntry = nEntry;
+    return SQLITE_OK;
+}
+
+int sqlite3_ccvfs_backup_incremental(sqlite3 *db, const char *base_path, const char *delta_path,
+                                     const CCVFSBackupOptions *pOptions) {
+    CCVFSBackupOptions opts;
+    CCVFSBackupSource src;
+    CCVFSDeltaHeader delta;
+    CCVFSBackupExtent *aExtent = NULL;
+    CCVFSPageIndex *aBase = NULL;
+    uint32_t *aBlock = NULL;
+    const char *zPath;
+    uint32_t baseGeneration = 0, nBase = 0, nExtent = 0;
+    uint64_t iData, nData = 0, nCopied = 0;
+    int fd = -1;
+    int rc;
+    uint32_t i;
+
+    if (!db || !base_path || !delta_path) {
+        return SQLITE_MISUSE;
+    }
+    memset(&opts, 0, sizeof(opts));
+    if (pOptions) {
+        opts = *pOptions;
+    }
+    zPath = sqlite3_db_filename(db, "main");
+    if (opts.compact || strcmp(base_path, delta_path) == 0 ||
+        (zPath && (strcmp(zPath, delta_path) == 0 || strcmp(zPath, base_path) == 0))) {
+        CCVFS_ERROR("Invalid incremental backup of %s against %s to %s", zPath ? zPath : "(temporary)",
+                    base_path, delta_path);
+        return SQLITE_MISUSE;
+    }
+
+    rc = ccvfs_delta_read_base(base_path, &baseGeneration, &aBase, &nBase);
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+    rc = ccvfs_backup_source_open(db, &src);
+    if (rc != SQLITE_OK) {
+        sqlite3_free(aBase);
+        return rc;
+    }
+
+    aExtent = (CCVFSBackupExtent *)sqlite3_malloc64(sizeof(CCVFSBackupExtent) * (src.nEntry ? src.nEntry : 1));
+    aBlock = (uint32_t *)sqlite3_malloc64(sizeof(uint32_t) * (src.nEntry ? src.nEntry : 1));
+    if (!aExtent || !aBlock) {
+        rc = SQLITE_NOMEM;
+        goto cleanup;
+    }
+
+    // 索引条目（偏移、大小、校验和、标志）与基础相同的块在副本中已经存在
+    // A block whose index entry (offset, sizes, checksum, flags) equals the base entry is already
+    // in the copy
+    for (i = 0; i < src.nEntry; i++) {
+        const CCVFSPageIndex *pIndex = &src.aIndex[i];
+        if (!ccvfs_backup_stored(pIndex) ||
+            (i < nBase && memcmp(pIndex, &aBase[i], sizeof(CCVFSPageIndex)) == 0)) {
+            continue;
+        }
+        aExtent[nExtent].src_offset = pIndex->physical_offset;
+        aExtent[nExtent].size = pIndex->compressed_size;
+        aExtent[nExtent].iBlock = i;
+        nExtent++;
+        nData += pIndex->compressed_size;
+    }
+
+    // 增量文件中的数据按源偏移顺序首尾相接，读取和写入都是顺序的
+    // Blocks follow each other in the delta in source offset order, reads and writes are sequential
+    qsort(aExtent, nExtent, sizeof(CCVFSBackupExtent), ccvfs_backup_extent_cmp);
+    iData = CCVFS_DELTA_HEADER_SIZE + CCVFS_HEADER_SIZE + (uint64_t)src.nEntry * sizeof(CCVFSPageIndex) +
+            (uint64_t)nExtent * sizeof(uint32_t);
+    for (i = 0; i < nExtent; i++) {
+        aExtent[i].dst_offset = iData;
+        iData += aExtent[i].size;
+        aBlock[i] = aExtent[i].iBlock;
+    }
+
+    fd = open(delta_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        CCVFS_ERROR("Failed to create %s", delta_path);
+        rc = SQLITE_CANTOPEN;
+        goto cleanup;
+    }
+
+    CCVFS_INFO("Incremental backup of %s: generation %u to %u, %u of %u blocks changed", src.zPath,
+               baseGeneration, src.header.change_counter, nExtent, src.nEntry);
+
+    rc = ccvfs_backup_copy(&src, aExtent, nExtent, fd, &opts, &nCopied);
+    if (rc != SQLITE_OK) {
+        goto cleanup;
+    }
+
+    ccvfs_backup_finish_header(&src.header, (uint64_t)src.nFile);
+    memset(&delta, 0, sizeof(delta));
+    memcpy(delta.magic, CCVFS_DELTA_MAGIC, 8);
+    delta.version = CCVFS_DELTA_VERSION;
+    delta.base_generation = baseGeneration;
+    delta.base_index_checksum = ccvfs_delta_index_checksum(aBase, nBase);
+    delta.base_total_pages = nBase;
+    delta.target_total_pages = src.nEntry;
+    delta.changed_blocks = nExtent;
+    delta.target_header_checksum = ccvfs_crc32((const unsigned char *)&src.header, CCVFS_HEADER_SIZE);
+    delta.target_index_checksum = ccvfs_delta_index_checksum(src.aIndex, src.nEntry);
+    delta.target_file_size = (uint64_t)src.nFile;
+    delta.data_size = nData;
+    delta.block_list_checksum = nExtent > 0 ? ccvfs_crc32((const unsigned char *)aBlock,
+                                                          (int)(sizeof(uint32_t) * nExtent)) : 0;
+    delta.header_checksum = ccvfs_delta_header_checksum(&delta);
+
+    rc = ccvfs_backup_write(fd, (const unsigned char *)&src.header, CCVFS_HEADER_SIZE, CCVFS_DELTA_HEADER_SIZE);
+    if (rc == SQLITE_OK && src.nEntry > 0) {
+        rc = ccvfs_backup_write(fd, (const unsigned char *)src.aIndex, sizeof(CCVFSPageIndex) * src.nEntry,
+                                CCVFS_DELTA_HEADER_SIZE + CCVFS_HEADER_SIZE);
+    }
+    if (rc == SQLITE_OK && nExtent > 0) {
+        rc = ccvfs_backup_write(fd, (const unsigned char *)aBlock, sizeof(uint32_t) * nExtent,
+                                CCVFS_DELTA_HEADER_SIZE + CCVFS_HEADER_SIZE +
+                                (uint64_t)src.nEntry * sizeof(CCVFSPageIndex));
+    }
+    // 增量文件头最后写入，不完整的文件无法通过检查
+    // The delta header goes last, an incomplete file fails its checks
+    if (rc == SQLITE_OK && fsync(fd) != 0) {
+        rc = SQLITE_IOERR_FSYNC;
+    }
+    if (rc == SQLITE_OK) {
+        rc = ccvfs_backup_write(fd, (const unsigned char *)&delta, CCVFS_DELTA_HEADER_SIZE, 0);
+    }
+    if (rc == SQLITE_OK && fsync(fd) != 0) {
+        rc = SQLITE_IOERR_FSYNC;
+    }
+    if (rc != SQLITE_OK) {
+        goto cleanup;
+    }
+
+    CCVFS_INFO("Wrote delta %s: %llu bytes for a %llu byte file", delta_path, (unsigned long long)iData,
+               (unsigned long long)src.nFile);
+
+cleanup:
+    ccvfs_backup_source_close(&src);
+    if (fd >= 0 && close(fd) != 0 && rc == SQLITE_OK) {
+        rc = SQLITE_IOERR_CLOSE;
+    }
+    if (rc != SQLITE_OK && fd >= 0) {
+        unlink(delta_path);
+    }
+    sqlite3_free(aBlock);
+    sqlite3_free(aExtent);
+    sqlite3_free(aBase);
+    return rc;
+}
+
+int sqlite3_ccvfs_apply_delta(const char *base_path, const char *delta_path) {
+    CCVFSDeltaHeader delta;
+    CCVFSFileHeader target, header;
+    CCVFSPageIndex *aIndex = NULL;
+    CCVFSPageIndex *aBase = NULL;
+    uint32_t *aBlock = NULL;
+    unsigned char *aData = NULL;
+    uint64_t iData, iBlock, nData = 0, nIndexEnd;
+    uint32_t nMax = 1, nBaseRead;
+    struct stat st;
+    int fdDelta = -1, fdBase = -1;
+    int rc;
+    uint32_t i;
+
+    if (!base_path || !delta_path || strcmp(base_path, delta_path) == 0) {
+        return SQLITE_MISUSE;
+    }
+
+    fdDelta = open(delta_path, O_RDONLY);
+    if (fdDelta < 0) {
+        CCVFS_ERROR("Failed to open %s", delta_path);
+        return SQLITE_CANTOPEN;
+    }
+    rc = ccvfs_backup_read(fdDelta, &delta, CCVFS_DELTA_HEADER_SIZE, 0);
+    if (rc != SQLITE_OK || memcmp(delta.magic, CCVFS_DELTA_MAGIC, 8) != 0) {
+        CCVFS_ERROR("%s is not a backup delta", delta_path);
+        rc = SQLITE_NOTADB;
+        goto cleanup;
+    }
+
+    // 修改基础副本之前先完整检查增量文件
+    // The whole delta is checked before the copy is touched
+    rc = SQLITE_CORRUPT;
+    if (delta.version != CCVFS_DELTA_VERSION ||
+        delta.header_checksum != ccvfs_delta_header_checksum(&delta) ||
+        delta.target_total_pages > CCVFS_MAX_PAGES || delta.base_total_pages > CCVFS_MAX_PAGES ||
+        delta.changed_blocks > delta.target_total_pages ||
+        fstat(fdDelta, &st) != 0) {
+        CCVFS_ERROR("Damaged delta header in %s", delta_path);
+        goto cleanup;
+    }
+    iBlock = CCVFS_DELTA_HEADER_SIZE + CCVFS_HEADER_SIZE + (uint64_t)delta.target_total_pages * sizeof(CCVFSPageIndex);
+    iData = iBlock + (uint64_t)delta.changed_blocks * sizeof(uint32_t);
+    if ((uint64_t)st.st_size != iData + delta.data_size) {
+        CCVFS_ERROR("Delta %s is truncated", delta_path);
+        goto cleanup;
+    }
+
+    aIndex = (CCVFSPageIndex *)sqlite3_malloc64(sizeof(CCVFSPageIndex) * (delta.target_total_pages + 1));
+    aBlock = (uint32_t *)sqlite3_malloc64(sizeof(uint32_t) * (delta.changed_blocks + 1));
+    if (!aIndex || !aBlock) {
+        rc = SQLITE_NOMEM;
+        goto cleanup;
+    }
+    if (ccvfs_backup_read(fdDelta, &target, CCVFS_HEADER_SIZE, CCVFS_DELTA_HEADER_SIZE) != SQLITE_OK ||
+        ccvfs_backup_read(fdDelta, aIndex, sizeof(CCVFSPageIndex) * delta.target_total_pages,
+                          CCVFS_DELTA_HEADER_SIZE + CCVFS_HEADER_SIZE) != SQLITE_OK ||
+        ccvfs_backup_read(fdDelta, aBlock, sizeof(uint32_t) * delta.changed_blocks, iBlock) != SQLITE_OK ||
+        memcmp(target.magic, CCVFS_MAGIC, 8) != 0 ||
+        ccvfs_crc32((const unsigned char *)&target, CCVFS_HEADER_SIZE) != delta.target_header_checksum ||
+        target.total_pages != delta.target_total_pages ||
+        ccvfs_delta_index_checksum(aIndex, delta.target_total_pages) != delta.target_index_checksum ||
+        (delta.changed_blocks > 0 &&
+         ccvfs_crc32((const unsigned char *)aBlock, (int)(sizeof(uint32_t) * delta.changed_blocks)) !=
+         delta.block_list_checksum)) {
+        CCVFS_ERROR("Damaged target index in %s", delta_path);
+        goto cleanup;
+    }
+    nIndexEnd = target.index_table_offset + (uint64_t)delta.target_total_pages * sizeof(CCVFSPageIndex);
+    if (ccvfs_backup_check_index(aIndex, delta.target_total_pages, nIndexEnd, delta.target_file_size) != SQLITE_OK) {
+        goto cleanup;
+    }
+    for (i = 0; i < delta.changed_blocks; i++) {
+        if (aBlock[i] >= delta.target_total_pages || !ccvfs_backup_stored(&aIndex[aBlock[i]])) {
+            break;
+        }
+        nData += aIndex[aBlock[i]].compressed_size;
+        if (aIndex[aBlock[i]].compressed_size > nMax) {
+            nMax = aIndex[aBlock[i]].compressed_size;
+        }
+    }
+    if (i < delta.changed_blocks || nData != delta.data_size) {
+        CCVFS_ERROR("Damaged block list in %s", delta_path);
+        goto cleanup;
+    }
+    aData = (unsigned char *)sqlite3_malloc64(nMax);
+    if (!aData) {
+        rc = SQLITE_NOMEM;
+        goto cleanup;
+    }
+    nData = iData;
+    for (i = 0; i < delta.changed_blocks; i++) {
+        const CCVFSPageIndex *pIndex = &aIndex[aBlock[i]];
+        if (ccvfs_backup_read(fdDelta, aData, pIndex->compressed_size, nData) != SQLITE_OK ||
+            ccvfs_crc32(aData, (int)pIndex->compressed_size) != pIndex->checksum) {
+            CCVFS_ERROR("Block %u in %s failed its checksum", aBlock[i], delta_path);
+            goto cleanup;
+        }
+        nData += pIndex->compressed_size;
+    }
+    rc = SQLITE_OK;
+
+    // 基础副本必须处于增量文件记录的索引代；上次应用中断时也可以已经写入目标索引
+    // The copy must be at the generation the delta was taken against, or already hold the target
+    // index when an earlier apply was interrupted
+    fdBase = open(base_path, O_RDWR);
+    if (fdBase < 0) {
+        CCVFS_ERROR("Failed to open %s", base_path);
+        rc = SQLITE_CANTOPEN;
+        goto cleanup;
+    }
+    nBaseRead = delta.base_total_pages > delta.target_total_pages ? delta.base_total_pages
+                                                                  : delta.target_total_pages;
+    aBase = (CCVFSPageIndex *)sqlite3_malloc64(sizeof(CCVFSPageIndex) * (nBaseRead + 1));
+    if (!aBase) {
+        rc = SQLITE_NOMEM;
+        goto cleanup;
+    }
+    memset(aBase, 0, sizeof(CCVFSPageIndex) * (nBaseRead + 1));
+    if (ccvfs_backup_read(fdBase, &header, CCVFS_HEADER_SIZE, 0) != SQLITE_OK ||
+        (memcmp(header.magic, CCVFS_MAGIC, 8) != 0 && memcmp(header.magic, CCVFS_APPLY_MAGIC, 8) != 0)) {
+        CCVFS_ERROR("%s is not a CCVFS backup", base_path);
+        rc = SQLITE_NOTADB;
+        goto cleanup;
+    }
+    // 索引之后可能是文件末尾，读不到的条目视为零
+    // The file may end inside the index, entries that cannot be read count as zeros
+    if (fstat(fdBase, &st) == 0 && (uint64_t)st.st_size > header.index_table_offset) {
+        uint64_t nAvail = (uint64_t)st.st_size - header.index_table_offset;
+        uint64_t nWant = sizeof(CCVFSPageIndex) * nBaseRead;
+        if (ccvfs_backup_read(fdBase, aBase, nAvail < nWant ? nAvail : nWant, header.index_table_offset) != SQLITE_OK) {
+            rc = SQLITE_IOERR_READ;
+            goto cleanup;
+        }
+    }
+    int atBase = header.change_counter == delta.base_generation && header.total_pages == delta.base_total_pages &&
+                 ccvfs_delta_index_checksum(aBase, delta.base_total_pages) == delta.base_index_checksum;
+    int atTarget = memcmp(header.magic, CCVFS_APPLY_MAGIC, 8) == 0 &&
+                   ccvfs_delta_index_checksum(aBase, delta.target_total_pages) == delta.target_index_checksum;
+    if (!atBase && !atTarget) {
+        CCVFS_ERROR("%s is not at generation %u the delta %s was taken against", base_path,
+                    delta.base_generation, delta_path);
+        rc = SQLITE_MISMATCH;
+        goto cleanup;
+    }
+
+    // 先把副本标记为正在应用：中断后的副本不会被当作完整的数据库打开，同一增量可以再次应用
+    // Mark the copy first: an interrupted copy does not open as a complete database and the same
+    // delta can be applied to it again
+    ccvfs_transcode_remove_journals(base_path);
+    memcpy(header.magic, CCVFS_APPLY_MAGIC, 8);
+    if (ccvfs_backup_write(fdBase, (const unsigned char *)&header, CCVFS_HEADER_SIZE, 0) != SQLITE_OK ||
+        fsync(fdBase) != 0) {
+        rc = SQLITE_IOERR_WRITE;
+        goto cleanup;
+    }
+
+    // 新块只写入目标索引引用的位置，未变化的块不会被覆盖
+    // New blocks only land where the target index points, no unchanged block is overwritten
+    nData = iData;
+    for (i = 0; i < delta.changed_blocks; i++) {
+        const CCVFSPageIndex *pIndex = &aIndex[aBlock[i]];
+        rc = ccvfs_backup_read(fdDelta, aData, pIndex->compressed_size, nData);
+        if (rc == SQLITE_OK) {
+            rc = ccvfs_backup_write(fdBase, aData, pIndex->compressed_size, pIndex->physical_offset);
+        }
+        if (rc != SQLITE_OK) {
+            goto cleanup;
+        }
+        nData += pIndex->compressed_size;
+    }
+
+    // 新索引之后多出的旧条目清零，文件头最后写入
+    // Old entries past the new index are cleared, the header goes last
+    if (delta.base_total_pages > delta.target_total_pages) {
+        memset(aBase, 0, sizeof(CCVFSPageIndex) * (delta.base_total_pages - delta.target_total_pages));
+        rc = ccvfs_backup_write(fdBase, (const unsigned char *)aBase,
+                                sizeof(CCVFSPageIndex) * (delta.base_total_pages - delta.target_total_pages),
+                                nIndexEnd);
+    }
+    if (rc == SQLITE_OK && delta.target_total_pages > 0) {
+        rc = ccvfs_backup_write(fdBase, (const unsigned char *)aIndex,
+                                sizeof(CCVFSPageIndex) * delta.target_total_pages, target.index_table_offset);
+    }
+    if (rc == SQLITE_OK && (ftruncate(fdBase, (off_t)delta.target_file_size) != 0 || fsync(fdBase) != 0)) {
+        rc = SQLITE_IOERR_FSYNC;
+    }
+    if (rc == SQLITE_OK) {
+        rc = ccvfs_backup_write(fdBase, (const unsigned char *)&target, CCVFS_HEADER_SIZE, 0);
+    }
+    if (rc == SQLITE_OK && fsync(fdBase) != 0) {
+        rc = SQLITE_IOERR_FSYNC;
+    }
+    if (rc == SQLITE_OK) {
+        CCVFS_INFO("Applied %s to %s: generation %u, %u blocks written", delta_path, base_path,
+                   target.change_counter, delta.changed_blocks);
+    }
+
+cleanup:
+    if (fdBase >= 0 && close(fdBase) != 0 && rc == SQLITE_OK) {
+        rc = SQLITE_IOERR_CLOSE;
+    }
+    close(fdDelta);
+    sqlite3_free(aData);
+    sqlite3_free(aBase);
+    sqlite3_free(aBlock);
+    sqlite3_free(aIndex);
+    return rc;
+}
@@ -2,6 +2,12 @@
 #include "ccvfs_io.h"
 #include "ccvfs_algorithm.h"
 #include "ccvfs_page.h"
+#include "ccvfs_shm.h"
+#include "ccvfs_snapshot.h"
+#include "ccvfs_stats.h"
+#include "ccvfs_latency.h"
+#include "ccvfs_log.h"
+#include "ccvfs_record.h"
 
 /*
  * Open file
@@ -25,6 +31,9 @@ int ccvfsOpen(sqlite3_vfs *pVfs, sqlite3_filename zName, sqlite3_file *pFile,
     pCcvfsFile->pPageIndex = NULL;
     pCcvfsFile->index_dirty = 0;
     pCcvfsFile->index_capacity = 0;
+    pCcvfsFile->compress_level = CCVFS_DEFAULT_COMPRESS_LEVEL;
+    pCcvfsFile->file_id = ccvfs_log_next_file_id();
+    uint64_t tRecord = ccvfs_record_begin(pCcvfsFile);
     
     // Copy filename for debugging purposes
     if (zName) {
@@ -62,6 +71,20 @@ int ccvfsOpen(sqlite3_vfs *pVfs, sqlite3_filename zName, sqlite3_file *pFile,
     
     pCcvfsFile->pReal = pRealFile;
     
+    // 索引读写锁和分配器锁，允许多个线程共用同一个文件句柄
+    // Index reader-writer lock and allocator lock, so several threads can share one file handle
+    rc = ccvfs_rwlock_init(&pCcvfsFile->index_lock);
+    if (rc == SQLITE_OK) {
+        pCcvfsFile->alloc_mutex = sqlite3_mutex_alloc(SQLITE_MUTEX_RECURSIVE);
+        pCcvfsFile->snapshot_mutex = sqlite3_mutex_alloc(SQLITE_MUTEX_FAST);
+        pCcvfsFile->buffer_mutex = sqlite3_mutex_alloc(SQLITE_MUTEX_FAST);
+    }
+    if (rc != SQLITE_OK) {
+        CCVFS_ERROR("Failed to initialize file locks: %d", rc);
+        pRealFile->pMethods->xClose(pRealFile);
+        return rc;
+    }
+    
     // Determine file type at open time
     if (flags & SQLITE_OPEN_CREATE) {
         // Check if this is a SQLite auxiliary file (should not be compressed)
@@ -98,6 +121,10 @@ int ccvfsOpen(sqlite3_vfs *pVfs, sqlite3_filename zName, sqlite3_file *pFile,
                 if (rc != SQLITE_OK) {
                     CCVFS_ERROR("Failed to load page index: %d", rc);
                     pRealFile->pMethods->xClose(pRealFile);
+                    ccvfs_rwlock_destroy(&pCcvfsFile->index_lock);
+                    sqlite3_mutex_free(pCcvfsFile->alloc_mutex);
+                    sqlite3_mutex_free(pCcvfsFile->snapshot_mutex);
+                    sqlite3_mutex_free(pCcvfsFile->buffer_mutex);
                     return rc;
                 }
             } else {
@@ -113,6 +140,14 @@ int ccvfsOpen(sqlite3_vfs *pVfs, sqlite3_filename zName, sqlite3_file *pFile,
         }
     }
     
+    // 可选的共享页索引，仅用于主数据库文件；不可用时继续使用私有索引
+    // Optional shared page index, main database files only; falls back to a private index if unavailable
+    if (pCcvfsFile->is_ccvfs_file && pCcvfs->enable_shared_index && (flags & SQLITE_OPEN_MAIN_DB)) {
+        if (ccvfs_shm_open(pCcvfsFile, zName) != SQLITE_OK) {
+            CCVFS_DEBUG("Continuing with a private page index");
+        }
+    }
+    
     // Initialize hole manager for CCVFS files
     if (pCcvfsFile->is_ccvfs_file) {
         rc = ccvfs_init_hole_manager(pCcvfsFile);
@@ -122,10 +157,22 @@ int ccvfsOpen(sqlite3_vfs *pVfs, sqlite3_filename zName, sqlite3_file *pFile,
             pCcvfsFile->hole_manager.enabled = 0;
             CCVFS_DEBUG("Hole detection disabled due to initialization failure");
         }
+        
+        // 发布第一个索引快照，读取者从此不再需要索引锁
+        // Publish the first index snapshot, from here on readers do not need the index lock
+        ccvfs_snapshot_publish(pCcvfsFile);
+        
+        // 计入VFS级统计，按VFS设置启用阶段计时
+        // Count towards the VFS-wide statistics, time pipeline stages if the VFS asks for it
+        sqlite3_mutex_enter(pCcvfs->files_mutex);
+        ccvfs_latency_set_enabled(pCcvfsFile, pCcvfs->enable_histograms);
+        sqlite3_mutex_leave(pCcvfs->files_mutex);
+        ccvfs_stats_register(pCcvfsFile);
     }
     
-    CCVFS_DEBUG("Successfully opened file (CCVFS: %s)", 
-                pCcvfsFile->is_ccvfs_file ? "yes" : "no");
+    CCVFS_DEBUG("Successfully opened file %u: %s (CCVFS: %s)", pCcvfsFile->file_id,
+                pCcvfsFile->filename ? pCcvfsFile->filename : "", pCcvfsFile->is_ccvfs_file ? "yes" : "no");
+    ccvfs_record(pCcvfsFile, CCVFS_RECORD_OPEN, tRecord, 0, (uint32_t)flags, NULL, SQLITE_OK);
     return SQLITE_OK;
 }
 
@@ -134,10 +181,16 @@ int ccvfsOpen(sqlite3_vfs *pVfs, sqlite3_filename zName, sqlite3_file *pFile,
  */
 int ccvfsDelete(sqlite3_vfs *pVfs, const char *zName, int syncDir) {
     CCVFS *pCcvfs = (CCVFS*)pVfs;
+    uint64_t tRecord = ccvfs_record_vfs_begin(pCcvfs);
+    int rc;
     
     CCVFS_DEBUG("Deleting file: %s", zName);
     
-    return pCcvfs->pRootVfs->xDelete(pCcvfs->pRootVfs, zName, syncDir);
+    rc = pCcvfs->pRootVfs->xDelete(pCcvfs->pRootVfs, zName, syncDir);
+    if (tRecord) {
+        ccvfs_record_delete(pCcvfs, tRecord, zName, syncDir, rc);
+    }
+    return rc;
 }
 
 /*
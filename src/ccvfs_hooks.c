@@ -0,0 +1,123 @@
+#include "ccvfs_hooks.h"
+#include "ccvfs_log.h"
+
+/*
+ * 页面I/O钩子
+ * 外部分析工具注册进程级回调，接收页面读写、空间分配、缓冲刷新、同步和校验和错误事件。
+ * ccvfs_event_mask汇总跟踪环和所有钩子需要的事件类型，热路径只读取它一次；
+ * 钩子表由读写锁保护：分发事件时共享，注册和注销时独占，因此注销返回后钩子不会再被调用。
+ *
+ * Page I/O hooks
+ * External profilers register process-wide callbacks receiving page read, write, allocation,
+ * buffer flush, sync and checksum events. ccvfs_event_mask merges the event types wanted by
+ * the trace ring and by every hook, and the hot path loads only that. The hook table is guarded
+ * by a reader-writer lock: shared while dispatching, exclusive while registering or
+ * unregistering, so a hook is never called once its unregistration returned.
+ */
+
+typedef struct {
+    CCVFSIoHook xHook;
+    void *pArg;
+    uint32_t mask;
+} CCVFSHookSlot;
+
+uint32_t ccvfs_event_mask = 0;
+
+static CCVFSRwLock ccvfs_hooks_lock = CCVFS_RWLOCK_INITIALIZER;
+static CCVFSHookSlot ccvfs_hooks[CCVFS_MAX_IO_HOOKS];
+static int ccvfs_hook_count = 0;  // Read without the lock to skip dispatching when zero
+
+/*
+ * 重新计算事件掩码（调用者持有钩子表写锁）
+ * Recompute the event mask (caller holds the hook table lock exclusively)
+ */
+static void ccvfs_event_update_mask_locked(void) {
+    uint32_t mask = (CCVFS_COUNTER_GET(ccvfs_trace_flags) & CCVFS_TRACE_ON) ? CCVFS_EVENT_ALL : 0;
+
+    for (int i = 0; i < ccvfs_hook_count; i++) {
+        mask |= ccvfs_hooks[i].mask;
+    }
+    CCVFS_COUNTER_SET(ccvfs_event_mask, mask);
+}
+
+void ccvfs_event_update_mask(void) {
+    ccvfs_rwlock_write_enter(&ccvfs_hooks_lock);
+    ccvfs_event_update_mask_locked();
+    ccvfs_rwlock_write_leave(&ccvfs_hooks_lock);
+}
+
+int sqlite3_ccvfs_register_io_hook(CCVFSIoHook xHook, void *pArg, uint32_t mask) {
+    int rc = SQLITE_OK;
+    int i;
+
+    mask &= CCVFS_EVENT_ALL;
+    if (!xHook || mask == 0) {
+        return SQLITE_MISUSE;
+    }
+    ccvfs_rwlock_write_enter(&ccvfs_hooks_lock);
+    for (i = 0; i < ccvfs_hook_count; i++) {
+        if (ccvfs_hooks[i].xHook == xHook && ccvfs_hooks[i].pArg == pArg) {
+            break;
+        }
+    }
+    if (i == ccvfs_hook_count) {
+        if (ccvfs_hook_count == CCVFS_MAX_IO_HOOKS) {
+            rc = SQLITE_FULL;
+        } else {
+            ccvfs_hooks[i].xHook = xHook;
+            ccvfs_hooks[i].pArg = pArg;
+            CCVFS_COUNTER_SET(ccvfs_hook_count, ccvfs_hook_count + 1);
+        }
+    }
+    if (rc == SQLITE_OK) {
+        ccvfs_hooks[i].mask = mask;
+        ccvfs_event_update_mask_locked();
+    }
+    ccvfs_rwlock_write_leave(&ccvfs_hooks_lock);
+    return rc;
+}
+
+int sqlite3_ccvfs_unregister_io_hook(CCVFSIoHook xHook, void *pArg) {
+    int rc = SQLITE_NOTFOUND;
+
+    ccvfs_rwlock_write_enter(&ccvfs_hooks_lock);
+    for (int i = 0; i < ccvfs_hook_count; i++) {
+        if (ccvfs_hooks[i].xHook == xHook && ccvfs_hooks[i].pArg == pArg) {
+            ccvfs_hooks[i] = ccvfs_hooks[ccvfs_hook_count - 1];
+            CCVFS_COUNTER_SET(ccvfs_hook_count, ccvfs_hook_count - 1);
+            ccvfs_event_update_mask_locked();
+            rc = SQLITE_OK;
+            break;
+        }
+    }
+    ccvfs_rwlock_write_leave(&ccvfs_hooks_lock);
+    return rc;
+}
+
+/*
+ * 补全时间字段，写入跟踪环并调用需要该事件的钩子
+ * Complete the timing fields, record the event in the trace ring and call the hooks that want it
+ */
+void ccvfs_event_emit(CCVFSIoEvent *pEvent) {
+    uint64_t now = ccvfs_latency_now();
+    uint32_t bit = CCVFS_EVENT_MASK(pEvent->type);
+
+    if (pEvent->start_ns == 0) {
+        pEvent->start_ns = now;
+    }
+    pEvent->duration_ns = now - pEvent->start_ns;
+
+    if (CCVFS_COUNTER_GET(ccvfs_trace_flags) & CCVFS_TRACE_ON) {
+        ccvfs_trace_record(pEvent);
+    }
+    if (CCVFS_COUNTER_GET(ccvfs_hook_count) == 0) {
+        return;
+    }
+    ccvfs_rwlock_read_enter(&ccvfs_hooks_lock);
+    for (int i = 0; i < ccvfs_hook_count; i++) {
+        if (ccvfs_hooks[i].mask & bit) {
+            ccvfs_hooks[i].xHook(ccvfs_hooks[i].pArg, pEvent);
+        }
+    }
+    ccvfs_rwlock_read_leave(&ccvfs_hooks_lock);
+}
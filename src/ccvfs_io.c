@@ -2,19 +2,60 @@
 #include "ccvfs_page.h"
 #include "ccvfs_core.h"
 #include "ccvfs_utils.h"
+#include "ccvfs_shm.h"
+#include "ccvfs_snapshot.h"
+#include "ccvfs_stats.h"
+#include "ccvfs_latency.h"
+#include "ccvfs_hooks.h"
+#include "ccvfs_pragma.h"
+#include "ccvfs_record.h"
+#include "ccvfs_scrub.h"
 #include <string.h>
 
 // Forward declarations
 static void ccvfs_update_space_tracking(CCVFSFile *pFile);
 static sqlite3_int64 ccvfs_find_best_fit_space(CCVFSFile *pFile, uint32_t requiredSize, uint32_t *pWastedSpace);
 static void ccvfs_report_file_health(CCVFSFile *pFile);
+static int readPageEntry(CCVFSFile *pFile, uint32_t pageNum, const CCVFSPageIndex *pIndex,
+                         unsigned char *buffer, uint32_t bufferSize);
 
 // Hole management function declarations
 static int ccvfs_remove_hole(CCVFSFile *pFile, sqlite3_int64 offset);
+static int ccvfs_claim_hole_range(CCVFSFile *pFile, sqlite3_int64 offset, uint32_t size);
 static void ccvfs_merge_adjacent_holes(CCVFSFile *pFile);
 static void ccvfs_cleanup_small_holes(CCVFSFile *pFile);
 static void ccvfs_check_hole_maintenance_threshold(CCVFSFile *pFile);
 
+/*
+ * 把 [offset, offset+size) 从空洞列表中划出，供页面原地扩展使用
+ * 区域与任何空洞都不相交或完全位于一个空洞内时返回1；只与空洞部分重叠时返回0（不能使用）
+ * Take [offset, offset+size) out of the hole list for an in-place page expansion
+ * Returns 1 if the range touches no hole or lies inside one hole, 0 if it only partly overlaps a hole (unusable)
+ */
+static int ccvfs_claim_hole_range(CCVFSFile *pFile, sqlite3_int64 offset, uint32_t size) {
+    CCVFSSpaceHole *pHole;
+    sqlite3_int64 end = offset + size;
+    
+    if (!pFile->hole_manager.enabled) {
+        return 1;
+    }
+    
+    for (pHole = pFile->hole_manager.holes; pHole; pHole = pHole->next) {
+        sqlite3_int64 holeEnd = pHole->offset + pHole->size;
+        if (offset >= holeEnd || end <= pHole->offset) {
+            continue;
+        }
+        if (offset >= pHole->offset && end <= holeEnd) {
+            return ccvfs_allocate_from_hole(pFile, offset, size) == SQLITE_OK;
+        }
+        CCVFS_DEBUG("Expansion [%llu,%llu] partly overlaps hole[%llu,%u]",
+                   (unsigned long long)offset, (unsigned long long)end,
+                   (unsigned long long)pHole->offset, pHole->size);
+        return 0;
+    }
+    return 1;
+}
+
 /*
  * 寻找最佳匹配的可用空间洞或间隙来满足所需大小
  * 使用最佳适配算法：选择能容纳所需大小的最小空洞
@@ -125,11 +166,20 @@ sqlite3_io_methods ccvfsIoMethods = {
  */
 int ccvfsIoClose(sqlite3_file *pFile) {
     CCVFSFile *p = (CCVFSFile *)pFile;
+    uint64_t tRecord = ccvfs_record_begin(p);
     int rc = SQLITE_OK;
     
     CCVFS_DEBUG("Closing CCVFS file");
     
+    // 巡检线程不再访问正在关闭的文件
+    // The scrubber no longer visits the closing file
+    if (p->stats_registered) {
+        ccvfs_scrub_detach(p);
+    }
+    
     if (p->pReal) {
+        ccvfs_rwlock_write_enter(&p->index_lock);
+        
         // 刷新写入缓冲区（如果启用）
         // Flush write buffer if enabled
         if (p->is_ccvfs_file && p->write_buffer.enabled && p->write_buffer.entry_count > 0) {
@@ -142,8 +192,19 @@ int ccvfsIoClose(sqlite3_file *pFile) {
         }
         
         // 关闭前保存页索引和文件头（仅对可写文件）
+        // 只有本连接有未保存的修改或文件头尚未写入时才保存，避免用过期的文件头覆盖其他连接的提交
         // Save page index and header before closing (only for writable files)
-        if (p->pPageIndex && p->header_loaded && !(p->open_flags & SQLITE_OPEN_READONLY)) {
+        // Only when this connection has unsaved changes or the header was never written,
+        // so a stale header never overwrites another connection's commit
+        int needSave = p->index_dirty;
+        if (!needSave && p->header_loaded) {
+            sqlite3_int64 physicalSize = 0;
+            if (p->pReal->pMethods->xFileSize(p->pReal, &physicalSize) != SQLITE_OK ||
+                physicalSize < CCVFS_HEADER_SIZE) {
+                needSave = 1;
+            }
+        }
+        if (needSave && p->pPageIndex && p->header_loaded && !(p->open_flags & SQLITE_OPEN_READONLY)) {
             int saveRc = ccvfs_save_page_index(p);
             if (saveRc != SQLITE_OK) {
                 CCVFS_ERROR("Failed to save page index: %d", saveRc);
@@ -158,6 +219,8 @@ int ccvfsIoClose(sqlite3_file *pFile) {
             }
         }
         
+        ccvfs_rwlock_write_leave(&p->index_lock);
+        
         // 关闭底层文件
         // Close underlying file
         int closeRc = p->pReal->pMethods->xClose(p->pReal);
@@ -166,6 +229,11 @@ int ccvfsIoClose(sqlite3_file *pFile) {
             rc = closeRc;
         }
     }
+    ccvfs_record(p, CCVFS_RECORD_CLOSE, tRecord, 0, 0, NULL, rc);
+    
+    // 关闭共享索引映射（共享索引不属于本连接，不释放）
+    // Close the shared index mapping (a shared index is not owned by this connection)
+    ccvfs_shm_close(p);
     
     // 释放页索引内存
     // Free page index
@@ -180,11 +248,12 @@ int ccvfsIoClose(sqlite3_file *pFile) {
         ccvfs_cleanup_write_buffer(p);
     }
 
-    // 清理空洞管理器
-    // Clean up hole manager
+    // 清理空洞管理器和索引快照
+    // Clean up hole manager and index snapshots
     if (p->is_ccvfs_file) {
         ccvfs_cleanup_hole_manager(p);
     }
+    ccvfs_snapshot_cleanup(p);
 
     // 在关闭前报告文件健康状态
     // Report file health status before closing
@@ -192,6 +261,11 @@ int ccvfsIoClose(sqlite3_file *pFile) {
         ccvfs_report_file_health(p);
     }
 
+    // 最终计数并入VFS累计值
+    // Fold the final counters into the VFS totals
+    ccvfs_stats_unregister(p);
+    ccvfs_scrub_free_marks(p);
+
     CCVFS_DEBUG("File closed: %s", p->filename ? p->filename : "(null)");
 
     // Free filename
@@ -200,6 +274,22 @@ int ccvfsIoClose(sqlite3_file *pFile) {
         p->filename = NULL;
     }
     
+    // 释放同步对象
+    // Release synchronization objects
+    ccvfs_rwlock_destroy(&p->index_lock);
+    if (p->alloc_mutex) {
+        sqlite3_mutex_free(p->alloc_mutex);
+        p->alloc_mutex = NULL;
+    }
+    if (p->snapshot_mutex) {
+        sqlite3_mutex_free(p->snapshot_mutex);
+        p->snapshot_mutex = NULL;
+    }
+    if (p->buffer_mutex) {
+        sqlite3_mutex_free(p->buffer_mutex);
+        p->buffer_mutex = NULL;
+    }
+    
     return rc;
 }
 
@@ -260,7 +350,19 @@ static int readPage(CCVFSFile *pFile, uint32_t pageNum, unsigned char *buffer, u
         return SQLITE_OK;
     }
     
-    CCVFSPageIndex *pIndex = &pFile->pPageIndex[pageNum];
+    return readPageEntry(pFile, pageNum, &pFile->pPageIndex[pageNum], buffer, bufferSize);
+}
+
+/*
+ * 按给定的索引条目读取页面（条目来自当前索引或已固定的快照）
+ * Read a page described by the given index entry (from the live index or a pinned snapshot)
+ */
+static int readPageEntry(CCVFSFile *pFile, uint32_t pageNum, const CCVFSPageIndex *pIndex,
+                         unsigned char *buffer, uint32_t bufferSize) {
+    // 阶段计时（未启用时为0）
+    // Stage timing (0 while disabled)
+    uint64_t tPage = ccvfs_latency_begin(pFile);
+    uint64_t tStage = tPage;
     
     CCVFS_DEBUG("Page[%u] mapping: physical_offset=%llu, compressed_size=%u, original_size=%u, flags=0x%x",
                pageNum, (unsigned long long)pIndex->physical_offset, 
@@ -271,6 +373,7 @@ static int readPage(CCVFSFile *pFile, uint32_t pageNum, unsigned char *buffer, u
     if (pIndex->physical_offset == 0 || (pIndex->flags & CCVFS_PAGE_SPARSE)) {
         CCVFS_DEBUG("Page %u is sparse, returning zeros", pageNum);
         memset(buffer, 0, bufferSize);
+        ccvfs_latency_lap(pFile, CCVFS_STAGE_READ_PAGE, tPage);
         return SQLITE_OK;
     }
     
@@ -292,20 +395,30 @@ static int readPage(CCVFSFile *pFile, uint32_t pageNum, unsigned char *buffer, u
         sqlite3_free(compressedData);
         return rc;
     }
+    tStage = ccvfs_latency_lap(pFile, CCVFS_STAGE_READ_IO, tStage);
     
-    // 验证校验和并提供数据恢复选项
-    // Verify checksum with data recovery options
-    uint32_t checksum = ccvfs_crc32(compressedData, pIndex->compressed_size);
+    // 验证校验和并提供数据恢复选项；巡检线程在信任窗口内校验过的块跳过CRC
+    // Verify checksum with data recovery options; blocks the scrubber validated within the trust window skip the CRC
+    int trusted = ccvfs_scrub_trusted(pFile, pageNum, pIndex);
+    uint32_t checksum = trusted ? pIndex->checksum : ccvfs_crc32(compressedData, pIndex->compressed_size);
+    if (trusted) {
+        CCVFS_COUNTER_INC(pFile->counters.trusted_read_count);
+    } else {
+        tStage = ccvfs_latency_lap(pFile, CCVFS_STAGE_CRC_VERIFY, tStage);
+    }
     if (checksum != pIndex->checksum) {
         // 记录校验和错误统计
         // Record checksum error statistics
-        pFile->checksum_error_count++;
-        pFile->corrupted_page_count++;
-        
-        CCVFS_ERROR("Page %u checksum mismatch: expected 0x%08x, got 0x%08x (error #%u)", 
-                   pageNum, pIndex->checksum, checksum, pFile->checksum_error_count);
+        CCVFS_COUNTER_INC(pFile->counters.checksum_error_count);
+        CCVFS_COUNTER_INC(pFile->counters.corrupted_page_count);
+        ccvfs_event(pFile, CCVFS_EVENT_CHECKSUM, 0, pageNum, pIndex->physical_offset,
+                    pIndex->compressed_size, pIndex->original_size, checksum, CCVFS_CACHE_NONE, SQLITE_CORRUPT);
+        
+        CCVFS_ERROR("Page %u checksum mismatch: expected 0x%08x, got 0x%08x (error #%llu)", 
+                   pageNum, pIndex->checksum, checksum,
+                   (unsigned long long)pFile->counters.checksum_error_count);
         CCVFS_ERROR("Page %u details: phys_offset=%llu, comp_size=%u, orig_size=%u, flags=0x%x", 
-                   pageNum, pIndex->physical_offset, pIndex->compressed_size,
+                   pageNum, (unsigned long long)pIndex->physical_offset, pIndex->compressed_size,
                    pIndex->original_size, pIndex->flags);
         
         // 显示损坏数据的前几个字节用于调试
@@ -329,9 +442,9 @@ static int readPage(CCVFSFile *pFile, uint32_t pageNum, unsigned char *buffer, u
         
         // 选项2：容错模式 - 尝试继续处理损坏的数据
         // Option 2: Tolerant mode - try to continue with corrupted data
-        pFile->recovery_attempt_count++;
-        CCVFS_ERROR("Tolerant mode: continuing with potentially corrupted page %u (attempt #%u)", 
-                   pageNum, pFile->recovery_attempt_count);
+        CCVFS_COUNTER_INC(pFile->counters.recovery_attempt_count);
+        CCVFS_ERROR("Tolerant mode: continuing with potentially corrupted page %u (attempt #%llu)", 
+                   pageNum, (unsigned long long)pFile->counters.recovery_attempt_count);
         
         // 未来可以在这里实现更多恢复策略：
         // Future recovery strategies could be implemented here:
@@ -354,9 +467,9 @@ static int readPage(CCVFSFile *pFile, uint32_t pageNum, unsigned char *buffer, u
         }
         
         if (canRecover) {
-            pFile->successful_recovery_count++;
-            CCVFS_ERROR("Data recovery enabled: attempting to continue (success #%u)", 
-                       pFile->successful_recovery_count);
+            CCVFS_COUNTER_INC(pFile->counters.successful_recovery_count);
+            CCVFS_ERROR("Data recovery enabled: attempting to continue (success #%llu)", 
+                       (unsigned long long)pFile->counters.successful_recovery_count);
         }
     }
     
@@ -397,6 +510,7 @@ static int readPage(CCVFSFile *pFile, uint32_t pageNum, unsigned char *buffer, u
             return SQLITE_CORRUPT;
         }
         sqlite3_free(compressedData);
+        tStage = ccvfs_latency_lap(pFile, CCVFS_STAGE_DECRYPT, tStage);
     }
     
     // 如果需要则解压缩数据
@@ -450,6 +564,8 @@ static int readPage(CCVFSFile *pFile, uint32_t pageNum, unsigned char *buffer, u
     if (decryptedData != compressedData) {
         sqlite3_free(decryptedData);
     }
+    ccvfs_latency_lap(pFile, CCVFS_STAGE_DECOMPRESS, tStage);
+    ccvfs_latency_lap(pFile, CCVFS_STAGE_READ_PAGE, tPage);
     
     CCVFS_VERBOSE("Successfully read and decompressed page %u", pageNum);
     return SQLITE_OK;
@@ -457,8 +573,11 @@ static int readPage(CCVFSFile *pFile, uint32_t pageNum, unsigned char *buffer, u
 
 /*
  * Read from file
+ * 调用者持有索引锁（pSnap为NULL），或者已固定索引快照pSnap，此时不访问当前索引
+ * The caller holds the index lock (pSnap is NULL), or has pinned the snapshot pSnap and the live index is not touched
  */
-int ccvfsIoRead(sqlite3_file *pFile, void *zBuf, int iAmt, sqlite3_int64 iOfst) {
+static int ccvfs_io_read_locked(sqlite3_file *pFile, const CCVFSIndexSnapshot *pSnap,
+                                void *zBuf, int iAmt, sqlite3_int64 iOfst) {
     CCVFSFile *p = (CCVFSFile *)pFile;
     unsigned char *buffer = (unsigned char*)zBuf;
     int bytesRead = 0;
@@ -487,8 +606,8 @@ int ccvfsIoRead(sqlite3_file *pFile, void *zBuf, int iAmt, sqlite3_int64 iOfst)
         return SQLITE_IOERR_SHORT_READ;
     }
     
-    // For CCVFS files, ensure header is loaded
-    if (!p->header_loaded) {
+    // For CCVFS files, ensure header is loaded (always true once a snapshot was published)
+    if (!pSnap && !p->header_loaded) {
         // Try to load existing header
         CCVFS_DEBUG("Header not loaded, loading now");
         rc = ccvfs_load_header(p);
@@ -509,11 +628,10 @@ int ccvfsIoRead(sqlite3_file *pFile, void *zBuf, int iAmt, sqlite3_int64 iOfst)
     }
     
     // CCVFS file - use page-based reading with buffer checking
-    uint32_t pageSize = p->header.page_size;
+    uint32_t pageSize = pSnap ? pSnap->page_size : p->header.page_size;
     if (pageSize == 0) {
         CCVFS_ERROR("Invalid page size in header, using default");
         pageSize = CCVFS_DEFAULT_PAGE_SIZE;
-        p->header.page_size = pageSize;
     }
     
     uint32_t startPage = getPageNumber(iOfst, pageSize);
@@ -543,14 +661,35 @@ int ccvfsIoRead(sqlite3_file *pFile, void *zBuf, int iAmt, sqlite3_int64 iOfst)
         
         // 首先尝试从缓冲区读取页面
         // First try to read page from buffer
+        uint64_t tRead = ccvfs_event_begin(CCVFS_EVENT_READ);
         rc = ccvfs_buffer_read(p, currentPage, pageBuffer, pageSize);
         if (rc == SQLITE_OK) {
             // Successfully read from buffer
             CCVFS_DEBUG("Buffer hit for page %u during read", currentPage);
+            ccvfs_event(p, CCVFS_EVENT_READ, tRead, currentPage, 0, 0, pageSize, 0, CCVFS_CACHE_BUFFER, rc);
         } else if (rc == SQLITE_NOTFOUND) {
             // Not in buffer, read from disk
+            const CCVFSPageIndex *pEntry;
             CCVFS_DEBUG("Buffer miss for page %u, reading from disk", currentPage);
-            rc = readPage(p, currentPage, pageBuffer, pageSize);
+            if (pSnap) {
+                pEntry = ccvfs_snapshot_entry(pSnap, currentPage);
+                if (pEntry) {
+                    rc = readPageEntry(p, currentPage, pEntry, pageBuffer, pageSize);
+                } else {
+                    memset(pageBuffer, 0, pageSize);
+                    rc = SQLITE_OK;
+                }
+            } else {
+                rc = readPage(p, currentPage, pageBuffer, pageSize);
+                pEntry = (p->pPageIndex && currentPage < p->header.total_pages) ? &p->pPageIndex[currentPage] : NULL;
+            }
+            if (ccvfs_event_wanted(CCVFS_EVENT_READ)) {
+                int stored = pEntry && pEntry->physical_offset != 0 && !(pEntry->flags & CCVFS_PAGE_SPARSE);
+                ccvfs_event(p, CCVFS_EVENT_READ, tRead, currentPage,
+                            stored ? pEntry->physical_offset : 0, stored ? pEntry->compressed_size : 0,
+                            pageSize, stored ? pEntry->flags : CCVFS_PAGE_SPARSE,
+                            stored ? CCVFS_CACHE_DISK : CCVFS_CACHE_SPARSE, rc);
+            }
             if (rc != SQLITE_OK) {
                 CCVFS_ERROR("Failed to read page %u from disk: %d", currentPage, rc);
                 sqlite3_free(pageBuffer);
@@ -572,12 +711,111 @@ int ccvfsIoRead(sqlite3_file *pFile, void *zBuf, int iAmt, sqlite3_int64 iOfst)
     
     sqlite3_free(pageBuffer);
     
-    CCVFS_DEBUG("Read complete: buffer_hits=%u, buffer_entries=%u", 
-               p->buffer_hit_count, p->write_buffer.entry_count);
+    CCVFS_DEBUG("Read complete: buffer_hits=%llu, buffer_entries=%u", 
+               (unsigned long long)p->counters.buffer_hit_count, p->write_buffer.entry_count);
     CCVFS_VERBOSE("Successfully read %d bytes from offset %lld", iAmt, iOfst);
     return SQLITE_OK;
 }
 
+#define CCVFS_WAL_CKPT_LOCK 1              // WAL_CKPT_LOCK slot of the WAL index
+#define CCVFS_WAL_READ_LOCK0 3             // WAL_READ_LOCK(0), the first read mark slot
+#define CCVFS_READ_RETRIES 4               // Reads retried after the index changed under them
+#define CCVFS_READ_CKPT_WAIT_MS 10000      // Longest wait for a running checkpoint to publish its index
+
+static int ccvfs_io_read_once(CCVFSFile *p, void *zBuf, int iAmt, sqlite3_int64 iOfst) {
+    sqlite3_file *pFile = (sqlite3_file *)p;
+    int rc;
+    
+    CCVFSIndexSnapshot *pSnap = ccvfs_snapshot_acquire(p);
+    if (pSnap) {
+        rc = ccvfs_io_read_locked(pFile, pSnap, zBuf, iAmt, iOfst);
+        ccvfs_snapshot_release(p, pSnap);
+    } else if (!p->header_loaded || !p->pPageIndex) {
+        ccvfs_rwlock_write_enter(&p->index_lock);
+        rc = ccvfs_io_read_locked(pFile, NULL, zBuf, iAmt, iOfst);
+        ccvfs_snapshot_publish(p);
+        ccvfs_rwlock_write_leave(&p->index_lock);
+    } else {
+        ccvfs_rwlock_read_enter(&p->index_lock);
+        rc = ccvfs_io_read_locked(pFile, NULL, zBuf, iAmt, iOfst);
+        ccvfs_rwlock_read_leave(&p->index_lock);
+    }
+    return rc;
+}
+
+/*
+ * 读取失败后重新加载索引，返回索引是否变化
+ * Reload the index after a failed read, returns whether the index changed
+ * WAL模式下其他连接的检查点可以在本连接的读事务期间重写块：块被移到新位置，旧位置随即被复用。
+ * 读事务需要的页在WAL中或内容未变，因此只读连接可以采用新索引重试。检查点独占WAL_CKPT_LOCK
+ * 直到保存索引之后，所以先以共享方式获取该锁，等待正在进行的检查点发布。
+ * In WAL mode a checkpoint of another connection can rewrite blocks during this connection's read
+ * transaction: the block moves and its old location is reused right away. The pages the read
+ * transaction needs are either in the WAL or unchanged, so a read-only connection can retry on the
+ * new index. A checkpoint holds WAL_CKPT_LOCK exclusively until its index is saved, so the lock is
+ * first taken shared to wait for a running checkpoint to publish.
+ */
+static int ccvfs_io_read_refresh(CCVFSFile *p) {
+    sqlite3_vfs *pRootVfs = p->pOwner->pRootVfs;
+    int walLock = p->wal_mapped && p->pReal->pMethods->xShmLock;
+    int rc = SQLITE_OK;
+    int changed;
+    
+    for (int waited = 0; walLock; waited++) {
+        rc = p->pReal->pMethods->xShmLock(p->pReal, CCVFS_WAL_CKPT_LOCK, 1, SQLITE_SHM_LOCK | SQLITE_SHM_SHARED);
+        if (rc != SQLITE_BUSY || waited >= CCVFS_READ_CKPT_WAIT_MS) {
+            break;
+        }
+        pRootVfs->xSleep(pRootVfs, 1000);
+    }
+    if (walLock && rc != SQLITE_OK) {
+        return 0;
+    }
+    
+    ccvfs_rwlock_write_enter(&p->index_lock);
+    uint32_t generation = p->index_generation;
+    rc = ccvfs_refresh_page_index(p);
+    changed = (rc == SQLITE_OK && p->index_generation != generation);
+    ccvfs_snapshot_publish(p);
+    ccvfs_rwlock_write_leave(&p->index_lock);
+    
+    if (walLock) {
+        p->pReal->pMethods->xShmLock(p->pReal, CCVFS_WAL_CKPT_LOCK, 1, SQLITE_SHM_UNLOCK | SQLITE_SHM_SHARED);
+    }
+    return changed;
+}
+
+/*
+ * Read from file
+ * 通常固定当前索引快照读取，不等待正在刷新的写入者；
+ * 没有快照时页读取共享索引锁，首次读取需要加载文件头和索引，此时独占
+ * Normally reads through the pinned current index snapshot without waiting for a flushing writer;
+ * without a snapshot page reads share the index lock, and the first read loads header and index exclusively
+ * 只读连接读到损坏的块时，若索引已被其他连接的检查点修改，则按新索引重试
+ * When a read-only connection reads a corrupt block and a checkpoint of another connection changed
+ * the index, the read is retried on the new index
+ */
+int ccvfsIoRead(sqlite3_file *pFile, void *zBuf, int iAmt, sqlite3_int64 iOfst) {
+    CCVFSFile *p = (CCVFSFile *)pFile;
+    uint64_t tRecord = ccvfs_record_begin(p);
+    int rc;
+    
+    if (!p->is_ccvfs_file) {
+        rc = p->pReal->pMethods->xRead(p->pReal, zBuf, iAmt, iOfst);
+    } else {
+        rc = ccvfs_io_read_once(p, zBuf, iAmt, iOfst);
+        // 写连接的索引是权威的，只有只读连接才可能看到被移走的块
+        // A writer's index is authoritative, only read-only connections can see a block that moved away
+        for (int retry = 0; rc == SQLITE_CORRUPT && retry < CCVFS_READ_RETRIES && p->lock_level <= SQLITE_LOCK_SHARED &&
+             !p->wal_checkpointing && !p->index_dirty && ccvfs_io_read_refresh(p); retry++) {
+            CCVFS_DEBUG("Index changed under a read transaction, retrying read at offset %lld", iOfst);
+            rc = ccvfs_io_read_once(p, zBuf, iAmt, iOfst);
+        }
+    }
+    ccvfs_record(p, CCVFS_RECORD_READ, tRecord, (uint64_t)iOfst, (uint32_t)iAmt, NULL, rc);
+    return rc;
+}
+
 /*
  * 压缩并将一个页写入文件
  * 处理流程：检查稀疏页 -> 压缩 -> 加密 -> 空间分配 -> 写入磁盘 -> 更新索引
@@ -591,6 +829,19 @@ static int writePage(CCVFSFile *pFile, uint32_t pageNum, const unsigned char *da
     // Track whether this write is using hole allocation
     int isHoleAllocation = 0;
     
+    // 阶段计时（未启用时为0）
+    // Stage timing (0 while disabled)
+    uint64_t tPage = ccvfs_latency_begin(pFile);
+    
+    // 写入前切换到私有索引，共享索引只在保存后发布
+    // Switch to a private index before writing; the shared index is only updated on publish
+    if (pFile->index_shared) {
+        int rc = ccvfs_shm_detach_index(pFile);
+        if (rc != SQLITE_OK) {
+            return rc;
+        }
+    }
+    
     // 确保页索引足够大
     // Ensure page index is large enough
     if (pageNum >= pFile->header.total_pages) {
@@ -627,7 +878,16 @@ static int writePage(CCVFSFile *pFile, uint32_t pageNum, const unsigned char *da
             CCVFS_DEBUG("Converting page %u from physical to sparse, adding hole[%llu,%u]",
                        pageNum, (unsigned long long)pIndex->physical_offset, pIndex->compressed_size);
             
-            int rc = ccvfs_add_hole(pFile, pIndex->physical_offset, pIndex->compressed_size);
+            // 快照仍可见的空间延迟到读者离开后再回收
+            // Space still visible to a snapshot is only reclaimed after its readers moved on
+            sqlite3_mutex_enter(pFile->alloc_mutex);
+            int rc;
+            if (ccvfs_snapshot_extent_published(pFile, pageNum, pIndex->physical_offset)) {
+                rc = ccvfs_snapshot_defer_extent(pFile, pIndex->physical_offset, pIndex->compressed_size);
+            } else {
+                rc = ccvfs_add_hole(pFile, pIndex->physical_offset, pIndex->compressed_size);
+            }
+            sqlite3_mutex_leave(pFile->alloc_mutex);
             if (rc != SQLITE_OK) {
                 CCVFS_ERROR("Failed to add hole for sparse page conversion: %d", rc);
                 // Continue anyway, don't fail the operation
@@ -642,7 +902,7 @@ static int writePage(CCVFSFile *pFile, uint32_t pageNum, const unsigned char *da
         
         // 将索引标记为脏，但不立即保存
         // Mark index as dirty but don't save immediately
-        pFile->index_dirty = 1;
+        ccvfs_mark_index_dirty(pFile, pageNum);
         
         // 即使是稀疏页也要更新逻辑数据库大小
         // Update logical database size for sparse pages too
@@ -653,6 +913,7 @@ static int writePage(CCVFSFile *pFile, uint32_t pageNum, const unsigned char *da
         }
         
         CCVFS_DEBUG("Page[%u] updated to sparse, index marked dirty", pageNum);
+        ccvfs_latency_lap(pFile, CCVFS_STAGE_WRITE_PAGE, tPage);
         return SQLITE_OK;
     }
     
@@ -661,6 +922,7 @@ static int writePage(CCVFSFile *pFile, uint32_t pageNum, const unsigned char *da
     unsigned char *compressedData = NULL;
     uint32_t compressedSize = dataSize;
     uint32_t flags = 0;
+    uint64_t tStage = tPage ? ccvfs_latency_now() : 0;
     
     if (pFile->pOwner->pCompressAlg) {
         int maxCompressedSize = pFile->pOwner->pCompressAlg->get_max_compressed_size(dataSize);
@@ -670,12 +932,14 @@ static int writePage(CCVFSFile *pFile, uint32_t pageNum, const unsigned char *da
             return SQLITE_NOMEM;
         }
         
-        int rc = pFile->pOwner->pCompressAlg->compress(data, dataSize, compressedData, maxCompressedSize, 1);
+        int rc = pFile->pOwner->pCompressAlg->compress(data, dataSize, compressedData, maxCompressedSize,
+                                                      pFile->compress_level);
         if (rc > 0 && (uint32_t)rc < dataSize) {
-            // 压缩成功且有效
-            // Compression successful and beneficial
+            // 压缩成功且有效，记录使用的压缩级别
+            // Compression successful and beneficial, remember the level used
             compressedSize = rc;
             flags |= CCVFS_PAGE_COMPRESSED;
+            flags |= ((uint32_t)pFile->compress_level << CCVFS_COMPRESSION_LEVEL_SHIFT) & CCVFS_COMPRESSION_LEVEL_MASK;
             CCVFS_VERBOSE("Page %u compressed from %u to %u bytes", pageNum, dataSize, compressedSize);
         } else {
             // 压缩失败或无效，使用原始数据
@@ -685,6 +949,7 @@ static int writePage(CCVFSFile *pFile, uint32_t pageNum, const unsigned char *da
             compressedSize = dataSize;
             CCVFS_DEBUG("Page %u compression not beneficial, using original data", pageNum);
         }
+        tStage = ccvfs_latency_lap(pFile, CCVFS_STAGE_COMPRESS, tStage);
     }
     
     // 如果没有压缩或压缩失败，使用原始数据
@@ -718,6 +983,7 @@ static int writePage(CCVFSFile *pFile, uint32_t pageNum, const unsigned char *da
                 flags |= CCVFS_PAGE_ENCRYPTED;
                 dataToWrite = encryptedData;
                 CCVFS_VERBOSE("Page %u encrypted with %d-byte key, size %u", pageNum, keyLen, compressedSize);
+                tStage = ccvfs_latency_lap(pFile, CCVFS_STAGE_ENCRYPT, tStage);
             } else {
                 CCVFS_ERROR("Failed to encrypt page %u: %d", pageNum, rc);
                 sqlite3_free(encryptedData);
@@ -734,6 +1000,12 @@ static int writePage(CCVFSFile *pFile, uint32_t pageNum, const unsigned char *da
     
     // 计算数据校验和
     uint32_t checksum = ccvfs_crc32(dataToWrite, compressedSize);
+    tStage = ccvfs_latency_lap(pFile, CCVFS_STAGE_CRC_COMPUTE, tStage);
+    
+    // 空间分配在分配器锁内进行，与空洞列表和空间统计的读取者互斥
+    // Space allocation runs under the allocator lock, excluding readers of the hole list and space stats
+    uint64_t tAlloc = ccvfs_event_begin(CCVFS_EVENT_ALLOCATE);
+    sqlite3_mutex_enter(pFile->alloc_mutex);
     
     // 确定写入偏移：重用现有页位置或分配新空间
     sqlite3_int64 writeOffset;
@@ -742,6 +1014,19 @@ static int writePage(CCVFSFile *pFile, uint32_t pageNum, const unsigned char *da
     if (pIndex->physical_offset != 0) {
         uint32_t existingSpace = pIndex->compressed_size;
         
+        // 【写时复制】：已发布的快照可能正在读取当前位置，不能原地覆盖；
+        // 写入新空间，旧空间等所有可能读取它的快照释放后再回收
+        if (ccvfs_snapshot_extent_published(pFile, pageNum, pIndex->physical_offset)) {
+            int rc = ccvfs_snapshot_defer_extent(pFile, pIndex->physical_offset, existingSpace);
+            if (rc != SQLITE_OK) {
+                CCVFS_ERROR("Failed to defer snapshot-visible page space: %d", rc);
+                // Continue anyway, the old space is leaked instead of reused
+            }
+            CCVFS_COUNTER_INC(pFile->counters.cow_relocation_count);
+            CCVFS_DEBUG("页 %u 的当前位置在快照中可见，写时复制到新空间", pageNum);
+            goto allocate_new_space;
+        }
+        
         // 【增强空间重用策略】：多种重用场景
         if (compressedSize <= existingSpace) {
             // 【场景1】：完美匹配或更小 - 直接重用
@@ -753,7 +1038,7 @@ static int writePage(CCVFSFile *pFile, uint32_t pageNum, const unsigned char *da
             double spaceEfficiency = (double)compressedSize / (double)existingSpace;
             
             // 更新空间跟踪计数器
-            pFile->space_reuse_count++;
+            CCVFS_COUNTER_INC(pFile->counters.space_reuse_count);
             
             CCVFS_DEBUG("重用现有空间在偏移 %llu: 新=%u, 现有=%u, 浪费=%u (%.1f%% 效率)",
                        (unsigned long long)writeOffset, compressedSize, existingSpace, 
@@ -772,7 +1057,7 @@ static int writePage(CCVFSFile *pFile, uint32_t pageNum, const unsigned char *da
                 double growthRatio = (double)compressedSize / (double)existingSpace;
                 if (growthRatio > 10.0) {
                     CCVFS_DEBUG("检测到极端增长 (%.1fx)，为稳定性分配新空间", growthRatio);
-                    pFile->new_allocation_count++;
+                    CCVFS_COUNTER_INC(pFile->counters.new_allocation_count);
                     goto allocate_new_space;
                 }
                 
@@ -797,11 +1082,24 @@ static int writePage(CCVFSFile *pFile, uint32_t pageNum, const unsigned char *da
                     }
                 }
                 
-                if (canExpand && pageEndOffset + expansionNeeded <= fileSize) {
+                // 扩展区域可能落在已跟踪的空洞中：完全位于一个空洞内时从空洞中划出，
+                // 否则该空洞之后会被分配给其他页面并覆盖本页的尾部
+                // The expansion may fall into a tracked hole: carve it out when it lies inside one hole,
+                // otherwise that hole is later handed to another page and overwrites this page's tail
+                // 延迟释放的空间仍可能被快照读取，同样不能占用
+                // Deferred space may still be read through a snapshot and must not be taken either
+                if (canExpand && pageEndOffset + expansionNeeded <= fileSize &&
+                    !ccvfs_snapshot_range_deferred(pFile, pageEndOffset, expansionNeeded)) {
+                    canExpand = ccvfs_claim_hole_range(pFile, pageEndOffset, expansionNeeded);
+                } else {
+                    canExpand = 0;
+                }
+                
+                if (canExpand) {
                     // 可以安全扩展现有空间
                     writeOffset = pIndex->physical_offset;
                     isHoleAllocation = 1;  // Mark as hole allocation since we're reusing existing space
-                    pFile->space_expansion_count++;
+                    CCVFS_COUNTER_INC(pFile->counters.space_expansion_count);
                     CCVFS_DEBUG("扩展现有页在偏移 %llu: %u->%u 字节 (+%u 扩展, %.1fx 增长)",
                                (unsigned long long)writeOffset, existingSpace, compressedSize, expansionNeeded, growthRatio);
                 } else {
@@ -815,7 +1113,7 @@ static int writePage(CCVFSFile *pFile, uint32_t pageNum, const unsigned char *da
                         // Continue anyway, don't fail the operation
                     }
                     
-                    pFile->new_allocation_count++;
+                    CCVFS_COUNTER_INC(pFile->counters.new_allocation_count);
                     goto allocate_new_space;
                 }
             } else {
@@ -828,14 +1126,14 @@ static int writePage(CCVFSFile *pFile, uint32_t pageNum, const unsigned char *da
                     // Continue anyway, don't fail the operation
                 }
                 
-                pFile->new_allocation_count++;
+                CCVFS_COUNTER_INC(pFile->counters.new_allocation_count);
                 goto allocate_new_space;
             }
         }
     } else {
         allocate_new_space:
         // 【智能空间分配】：先尝试最佳适配，然后追加到文件末尾
-        pFile->new_allocation_count++;
+        CCVFS_COUNTER_INC(pFile->counters.new_allocation_count);
         
         // 尝试使用最佳适配算法找到合适的空洞
         uint32_t wastedSpace = 0;
@@ -844,8 +1142,8 @@ static int writePage(CCVFSFile *pFile, uint32_t pageNum, const unsigned char *da
         if (writeOffset > 0) {
             // 找到合适的空洞 - 标记为空洞分配但暂不更新空洞记录
             // (空洞记录将在写入成功后更新)
-            pFile->hole_reclaim_count++;
-            pFile->best_fit_count++;
+            CCVFS_COUNTER_INC(pFile->counters.hole_reclaim_count);
+            CCVFS_COUNTER_INC(pFile->counters.best_fit_count);
             isHoleAllocation = 1;  // Mark this as hole allocation
             CCVFS_DEBUG("使用最佳适配空洞在偏移 %llu 存储 %u 字节 (浪费: %u)", 
                        (unsigned long long)writeOffset, compressedSize, wastedSpace);
@@ -857,12 +1155,13 @@ static int writePage(CCVFSFile *pFile, uint32_t pageNum, const unsigned char *da
                 CCVFS_ERROR("获取文件大小失败: %d", sizeRc);
                 if (encryptedData) sqlite3_free(encryptedData);
                 if (compressedData) sqlite3_free(compressedData);
+                sqlite3_mutex_leave(pFile->alloc_mutex);
                 return sizeRc;
             }
             
             // 检查顺序写入模式（多个连续页分配）
             if (pFile->last_written_page != UINT32_MAX && pageNum == pFile->last_written_page + 1) {
-                pFile->sequential_write_count++;
+                CCVFS_COUNTER_INC(pFile->counters.sequential_write_count);
                 CCVFS_DEBUG("检测到顺序写入: 页 %u->%u", pFile->last_written_page, pageNum);
             }
             pFile->last_written_page = pageNum;
@@ -904,24 +1203,31 @@ static int writePage(CCVFSFile *pFile, uint32_t pageNum, const unsigned char *da
                 
                 if (foundSafeOffset) {
                     writeOffset = candidateOffset;
-                    CCVFS_DEBUG("在文件末尾分配新页: 偏移 %llu (顺序: %u, 安全检查通过)",
-                               (unsigned long long)writeOffset, pFile->sequential_write_count);
+                    CCVFS_DEBUG("在文件末尾分配新页: 偏移 %llu (顺序: %llu, 安全检查通过)",
+                               (unsigned long long)writeOffset,
+                               (unsigned long long)pFile->counters.sequential_write_count);
                 } else {
                     CCVFS_ERROR("无法找到安全的写入位置，页面布局可能损坏");
                     if (encryptedData) sqlite3_free(encryptedData);
                     if (compressedData) sqlite3_free(compressedData);
+                    sqlite3_mutex_leave(pFile->alloc_mutex);
                     return SQLITE_IOERR;
                 }
             }
         }
     }
     
+    tStage = ccvfs_latency_lap(pFile, CCVFS_STAGE_ALLOCATE, tStage);
+    ccvfs_event(pFile, CCVFS_EVENT_ALLOCATE, tAlloc, pageNum, (uint64_t)writeOffset, compressedSize,
+                dataSize, (uint32_t)isHoleAllocation, CCVFS_CACHE_NONE, SQLITE_OK);
+    
     // Verify that the allocated space is valid and safe to write to
     if (writeOffset < CCVFS_DATA_PAGES_OFFSET) {
         CCVFS_ERROR("Invalid write offset %llu < %d (reserved space)", 
                    (unsigned long long)writeOffset, CCVFS_DATA_PAGES_OFFSET);
         if (encryptedData) sqlite3_free(encryptedData);
         if (compressedData) sqlite3_free(compressedData);
+        sqlite3_mutex_leave(pFile->alloc_mutex);
         return SQLITE_IOERR;
     }
     
@@ -977,18 +1283,23 @@ static int writePage(CCVFSFile *pFile, uint32_t pageNum, const unsigned char *da
                            (unsigned long long)otherStart, (unsigned long long)otherEnd, isHoleAllocation);
                 if (encryptedData) sqlite3_free(encryptedData);
                 if (compressedData) sqlite3_free(compressedData);
+                sqlite3_mutex_leave(pFile->alloc_mutex);
                 return SQLITE_IOERR;
             }
         }
     }
     
+    tStage = ccvfs_latency_lap(pFile, CCVFS_STAGE_OVERLAP_CHECK, tStage);
+    
     int rc = pFile->pReal->pMethods->xWrite(pFile->pReal, dataToWrite, compressedSize, writeOffset);
     if (rc != SQLITE_OK) {
         CCVFS_ERROR("Failed to write page data: %d", rc);
         if (encryptedData) sqlite3_free(encryptedData);
         if (compressedData) sqlite3_free(compressedData);
+        sqlite3_mutex_leave(pFile->alloc_mutex);
         return rc;
     }
+    ccvfs_latency_lap(pFile, CCVFS_STAGE_WRITE_IO, tStage);
     
     // If this was a hole allocation, update the hole records now that write succeeded
     if (isHoleAllocation) {
@@ -1010,9 +1321,10 @@ static int writePage(CCVFSFile *pFile, uint32_t pageNum, const unsigned char *da
     
     // Update space utilization tracking
     ccvfs_update_space_tracking(pFile);
+    sqlite3_mutex_leave(pFile->alloc_mutex);
     
     // Mark index as dirty (will be saved on sync/close)
-    pFile->index_dirty = 1;
+    ccvfs_mark_index_dirty(pFile, pageNum);
     
     // Update logical database size
     uint32_t maxPage = 0;
@@ -1034,6 +1346,7 @@ static int writePage(CCVFSFile *pFile, uint32_t pageNum, const unsigned char *da
     if (encryptedData) sqlite3_free(encryptedData);
     if (compressedData) sqlite3_free(compressedData);
     
+    ccvfs_latency_lap(pFile, CCVFS_STAGE_WRITE_PAGE, tPage);
     CCVFS_VERBOSE("Successfully wrote page %u at offset %lld", pageNum, writeOffset);
     return SQLITE_OK;
 }
@@ -1045,7 +1358,7 @@ static int writePage(CCVFSFile *pFile, uint32_t pageNum, const unsigned char *da
 static void ccvfs_report_file_health(CCVFSFile *pFile) {
     if (!pFile) return;
     
-    uint32_t totalErrors = pFile->checksum_error_count + pFile->corrupted_page_count;
+    uint64_t totalErrors = pFile->counters.checksum_error_count + pFile->counters.corrupted_page_count;
     if (totalErrors == 0) {
         CCVFS_DEBUG("文件健康状况良好：没有发现数据损坏 File health: Good - no data corruption detected");
         return;
@@ -1056,15 +1369,16 @@ static void ccvfs_report_file_health(CCVFSFile *pFile) {
     uint32_t totalPages = pFile->header.total_pages;
     uint32_t integrityScore = 100;
     if (totalPages > 0) {
-        uint32_t corruptionRate = (pFile->corrupted_page_count * 100) / totalPages;
-        integrityScore = (corruptionRate > 100) ? 0 : (100 - corruptionRate);
+        uint64_t corruptionRate = (pFile->counters.corrupted_page_count * 100) / totalPages;
+        integrityScore = (corruptionRate > 100) ? 0 : (uint32_t)(100 - corruptionRate);
     }
     
     // 计算恢复成功率
     // Calculate recovery success rate
     uint32_t recoveryRate = 0;
-    if (pFile->recovery_attempt_count > 0) {
-        recoveryRate = (pFile->successful_recovery_count * 100) / pFile->recovery_attempt_count;
+    if (pFile->counters.recovery_attempt_count > 0) {
+        recoveryRate = (uint32_t)((pFile->counters.successful_recovery_count * 100) /
+                                  pFile->counters.recovery_attempt_count);
     }
     
     const char *healthStatus;
@@ -1081,12 +1395,12 @@ static void ccvfs_report_file_health(CCVFSFile *pFile) {
     }
     
     CCVFS_DEBUG("文件健康报告 File Health Report: %s (评分Score: %u/100)", healthStatus, integrityScore);
-    CCVFS_DEBUG("  校验和错误 Checksum errors: %u", pFile->checksum_error_count);
-    CCVFS_DEBUG("  损坏页数量 Corrupted pages: %u/%u (%.1f%%)",
-               pFile->corrupted_page_count, totalPages, 
-               totalPages > 0 ? (pFile->corrupted_page_count * 100.0f / totalPages) : 0.0f);
-    CCVFS_DEBUG("  恢复尝试 Recovery attempts: %u (成功率Success rate: %u%%)",
-               pFile->recovery_attempt_count, recoveryRate);
+    CCVFS_DEBUG("  校验和错误 Checksum errors: %llu", (unsigned long long)pFile->counters.checksum_error_count);
+    CCVFS_DEBUG("  损坏页数量 Corrupted pages: %llu/%u (%.1f%%)",
+               (unsigned long long)pFile->counters.corrupted_page_count, totalPages, 
+               totalPages > 0 ? (pFile->counters.corrupted_page_count * 100.0f / totalPages) : 0.0f);
+    CCVFS_DEBUG("  恢复尝试 Recovery attempts: %llu (成功率Success rate: %u%%)",
+               (unsigned long long)pFile->counters.recovery_attempt_count, recoveryRate);
     
     if (integrityScore < 80) {
         CCVFS_ERROR("警告：文件存在数据完整性问题，建议检查和修复");
@@ -1138,19 +1452,19 @@ static void ccvfs_update_space_tracking(CCVFSFile *pFile) {
         uint32_t holeReclaimScore = 0;
         uint32_t sequentialWriteScore = 0;
         
-        uint32_t totalOperations = pFile->space_reuse_count + pFile->space_expansion_count + pFile->new_allocation_count;
+        uint64_t totalOperations = pFile->counters.space_reuse_count + pFile->counters.space_expansion_count + pFile->counters.new_allocation_count;
         if (totalOperations > 0) {
             // 重用效率（0-30分）
-            uint32_t reuseRatio = (pFile->space_reuse_count * 100) / totalOperations;
+            uint32_t reuseRatio = (uint32_t)((pFile->counters.space_reuse_count * 100) / totalOperations);
             reuseEfficiencyScore = (100 - reuseRatio) * 30 / 100;
             
             // 空洞回收效率（0-25分）- 良好的空洞回收减少碎片化
-            uint32_t holeReclaimRatio = (pFile->hole_reclaim_count * 100) / totalOperations;
+            uint32_t holeReclaimRatio = (uint32_t)((pFile->counters.hole_reclaim_count * 100) / totalOperations);
             holeReclaimScore = (100 - holeReclaimRatio) * 25 / 100;
             
             // 顺序写入效率（0-15分）- 顺序写入减少碎片化
             if (pageCount > 1) {
-                uint32_t sequentialRatio = (pFile->sequential_write_count * 100) / (pageCount - 1);
+                uint32_t sequentialRatio = (uint32_t)((pFile->counters.sequential_write_count * 100) / (pageCount - 1));
                 sequentialWriteScore = (100 - sequentialRatio) * 15 / 100;
             }
         }
@@ -1162,19 +1476,24 @@ static void ccvfs_update_space_tracking(CCVFSFile *pFile) {
     }
     
     CCVFS_DEBUG("Advanced space tracking: allocated=%llu, used=%llu, fragmentation=%u%%, "
-               "reuse=%u, expansion=%u, new=%u, holes=%u, bestfit=%u, sequential=%u", 
+               "reuse=%llu, expansion=%llu, new=%llu, holes=%llu, bestfit=%llu, sequential=%llu", 
                (unsigned long long)totalAllocated, (unsigned long long)totalUsed, 
-               pFile->fragmentation_score, pFile->space_reuse_count, 
-               pFile->space_expansion_count, pFile->new_allocation_count,
-               pFile->hole_reclaim_count, pFile->best_fit_count, pFile->sequential_write_count);
+               pFile->fragmentation_score, (unsigned long long)pFile->counters.space_reuse_count, 
+               (unsigned long long)pFile->counters.space_expansion_count,
+               (unsigned long long)pFile->counters.new_allocation_count,
+               (unsigned long long)pFile->counters.hole_reclaim_count,
+               (unsigned long long)pFile->counters.best_fit_count,
+               (unsigned long long)pFile->counters.sequential_write_count);
     
     // 输出数据完整性统计信息
     // Output data integrity statistics
-    if (pFile->checksum_error_count > 0 || pFile->corrupted_page_count > 0) {
-        CCVFS_DEBUG("Data integrity stats: checksum_errors=%u, corrupted_pages=%u, "
-                   "recovery_attempts=%u, successful_recoveries=%u", 
-                   pFile->checksum_error_count, pFile->corrupted_page_count,
-                   pFile->recovery_attempt_count, pFile->successful_recovery_count);
+    if (pFile->counters.checksum_error_count > 0 || pFile->counters.corrupted_page_count > 0) {
+        CCVFS_DEBUG("Data integrity stats: checksum_errors=%llu, corrupted_pages=%llu, "
+                   "recovery_attempts=%llu, successful_recoveries=%llu", 
+                   (unsigned long long)pFile->counters.checksum_error_count,
+                   (unsigned long long)pFile->counters.corrupted_page_count,
+                   (unsigned long long)pFile->counters.recovery_attempt_count,
+                   (unsigned long long)pFile->counters.successful_recovery_count);
     }
 }
 
@@ -1186,7 +1505,7 @@ static void ccvfs_update_space_tracking(CCVFSFile *pFile) {
  * For CCVFS files: initialize header, use page-based writing, handle cross-page writes, support write buffering
  * For regular files: pass directly to underlying VFS
  */
-int ccvfsIoWrite(sqlite3_file *pFile, const void *zBuf, int iAmt, sqlite3_int64 iOfst) {
+static int ccvfs_io_write_locked(sqlite3_file *pFile, const void *zBuf, int iAmt, sqlite3_int64 iOfst) {
     CCVFSFile *p = (CCVFSFile *)pFile;
     const unsigned char *data = (const unsigned char*)zBuf;
     int bytesWritten = 0;
@@ -1219,7 +1538,6 @@ int ccvfsIoWrite(sqlite3_file *pFile, const void *zBuf, int iAmt, sqlite3_int64
     if (pageSize == 0) {
         CCVFS_ERROR("Invalid page size in header, using default");
         pageSize = CCVFS_DEFAULT_PAGE_SIZE;
-        p->header.page_size = pageSize;
     }
     
     uint32_t startPage = getPageNumber(iOfst, pageSize);
@@ -1282,11 +1600,21 @@ int ccvfsIoWrite(sqlite3_file *pFile, const void *zBuf, int iAmt, sqlite3_int64
         
         // 尝试将页面写入缓冲区，如果失败则直接写入磁盘
         // Try to write page to buffer, if it fails write directly to disk
+        uint64_t tWrite = ccvfs_event_begin(CCVFS_EVENT_WRITE);
         rc = ccvfs_buffer_write(p, currentPage, pageBuffer, pageSize);
         if (rc == SQLITE_NOTFOUND) {
             // Write buffering is disabled or not available, write directly
             CCVFS_DEBUG("Write buffering not available, writing page %u directly to disk", currentPage);
             rc = writePage(p, currentPage, pageBuffer, pageSize);
+            if (ccvfs_event_wanted(CCVFS_EVENT_WRITE)) {
+                const CCVFSPageIndex *pEntry = (rc == SQLITE_OK && currentPage < p->header.total_pages) ?
+                                               &p->pPageIndex[currentPage] : NULL;
+                int stored = pEntry && pEntry->physical_offset != 0;
+                ccvfs_event(p, CCVFS_EVENT_WRITE, tWrite, currentPage,
+                            stored ? pEntry->physical_offset : 0, stored ? pEntry->compressed_size : 0,
+                            pageSize, pEntry ? pEntry->flags : 0,
+                            (pEntry && !stored) ? CCVFS_CACHE_SPARSE : CCVFS_CACHE_DISK, rc);
+            }
             if (rc != SQLITE_OK) {
                 CCVFS_ERROR("Failed to write page %u directly: %d", currentPage, rc);
                 sqlite3_free(pageBuffer);
@@ -1298,6 +1626,7 @@ int ccvfsIoWrite(sqlite3_file *pFile, const void *zBuf, int iAmt, sqlite3_int64
             return rc;
         } else {
             CCVFS_DEBUG("Successfully buffered page %u", currentPage);
+            ccvfs_event(p, CCVFS_EVENT_WRITE, tWrite, currentPage, 0, 0, pageSize, 0, CCVFS_CACHE_BUFFER, rc);
         }
         
         bytesWritten += bytesToWrite;
@@ -1313,6 +1642,23 @@ int ccvfsIoWrite(sqlite3_file *pFile, const void *zBuf, int iAmt, sqlite3_int64
     return SQLITE_OK;
 }
 
+/*
+ * 在独占索引锁内执行
+ * Runs under the exclusive index lock
+ */
+int ccvfsIoWrite(sqlite3_file *pFile, const void *zBuf, int iAmt, sqlite3_int64 iOfst) {
+    CCVFSFile *p = (CCVFSFile *)pFile;
+    uint64_t tRecord = ccvfs_record_begin(p);
+    int rc;
+    
+    ccvfs_rwlock_write_enter(&p->index_lock);
+    rc = ccvfs_io_write_locked(pFile, zBuf, iAmt, iOfst);
+    ccvfs_snapshot_publish(p);
+    ccvfs_rwlock_write_leave(&p->index_lock);
+    ccvfs_record(p, CCVFS_RECORD_WRITE, tRecord, (uint64_t)iOfst, (uint32_t)iAmt, zBuf, rc);
+    return rc;
+}
+
 /*
  * 将文件截断到指定大小
  * 对于CCVFS文件：更新元数据和页计数
@@ -1321,7 +1667,7 @@ int ccvfsIoWrite(sqlite3_file *pFile, const void *zBuf, int iAmt, sqlite3_int64
  * For CCVFS files: update metadata and page count
  * For regular files: truncate underlying file directly
  */
-int ccvfsIoTruncate(sqlite3_file *pFile, sqlite3_int64 size) {
+static int ccvfs_io_truncate_locked(sqlite3_file *pFile, sqlite3_int64 size) {
     CCVFSFile *p = (CCVFSFile *)pFile;
     
     CCVFS_DEBUG("Truncating file to %lld bytes", size);
@@ -1338,9 +1684,10 @@ int ccvfsIoTruncate(sqlite3_file *pFile, sqlite3_int64 size) {
     uint32_t pageSize = p->header.page_size;
     uint32_t newPageCount = (uint32_t)((size + pageSize - 1) / pageSize);
     
-    // 更新文件头
-    // Update header
-    p->header.database_size_pages = (uint32_t)(size / pageSize);
+    // 更新文件头；目标大小落在块中间时保留该块，否则块内尚在截断点之前的数据会丢失
+    // Update header; a size inside a block keeps that block, otherwise the data
+    // before the truncation point in it would be lost
+    p->header.database_size_pages = newPageCount;
     
     // 如果减小大小，我们可以在这里释放未使用的页
     // 现在只更新页计数
@@ -1350,17 +1697,38 @@ int ccvfsIoTruncate(sqlite3_file *pFile, sqlite3_int64 size) {
         p->header.total_pages = newPageCount;
     }
     
+    // 标记为脏，确保新的大小会被发布给其他连接
+    // Mark dirty so the new size gets published to other connections
+    ccvfs_mark_index_dirty(p, newPageCount > 0 ? newPageCount - 1 : 0);
+    
     CCVFS_VERBOSE("CCVFS file truncated to size %lld", size);
     return SQLITE_OK;
 }
 
+/*
+ * 在独占索引锁内执行
+ * Runs under the exclusive index lock
+ */
+int ccvfsIoTruncate(sqlite3_file *pFile, sqlite3_int64 size) {
+    CCVFSFile *p = (CCVFSFile *)pFile;
+    uint64_t tRecord = ccvfs_record_begin(p);
+    int rc;
+    
+    ccvfs_rwlock_write_enter(&p->index_lock);
+    rc = ccvfs_io_truncate_locked(pFile, size);
+    ccvfs_snapshot_publish(p);
+    ccvfs_rwlock_write_leave(&p->index_lock);
+    ccvfs_record(p, CCVFS_RECORD_TRUNCATE, tRecord, (uint64_t)size, 0, NULL, rc);
+    return rc;
+}
+
 /*
  * 将文件同步到磁盘
  * 先刷新写入缓冲区、保存CCVFS的页索引和文件头，然后同步底层文件
  * Sync file to disk
  * Flush write buffer first, save CCVFS page index and header, then sync underlying file
  */
-int ccvfsIoSync(sqlite3_file *pFile, int flags) {
+static int ccvfs_io_sync_locked(sqlite3_file *pFile, int flags) {
     CCVFSFile *p = (CCVFSFile *)pFile;
     
     CCVFS_DEBUG("Syncing file with flags %d", flags);
@@ -1396,6 +1764,7 @@ int ccvfsIoSync(sqlite3_file *pFile, int flags) {
     // Perform hole maintenance operations (only for CCVFS files)
     if (p->is_ccvfs_file && p->hole_manager.enabled) {
         CCVFS_DEBUG("Performing hole maintenance during sync");
+        sqlite3_mutex_enter(p->alloc_mutex);
         
         // Merge adjacent holes to reduce fragmentation
         ccvfs_merge_adjacent_holes(p);
@@ -1403,6 +1772,8 @@ int ccvfsIoSync(sqlite3_file *pFile, int flags) {
         // Clean up holes that are too small to be useful
         ccvfs_cleanup_small_holes(p);
         
+        sqlite3_mutex_leave(p->alloc_mutex);
+        
         CCVFS_DEBUG("Hole maintenance completed: %u holes remaining", 
                    p->hole_manager.hole_count);
     }
@@ -1420,14 +1791,35 @@ int ccvfsIoSync(sqlite3_file *pFile, int flags) {
     // 输出同步统计信息
     // Output sync statistics
     if (p->is_ccvfs_file) {
-        CCVFS_DEBUG("Sync completed: buffer_flushes=%u, buffer_hits=%u, total_buffered_writes=%u", 
-                   p->buffer_flush_count, p->buffer_hit_count, p->total_buffered_writes);
+        CCVFS_DEBUG("Sync completed: buffer_flushes=%llu, buffer_hits=%llu, total_buffered_writes=%llu", 
+                   (unsigned long long)p->counters.buffer_flush_count,
+                   (unsigned long long)p->counters.buffer_hit_count,
+                   (unsigned long long)p->counters.total_buffered_writes);
     }
     
     CCVFS_VERBOSE("File synced successfully");
     return SQLITE_OK;
 }
 
+/*
+ * 在独占索引锁内执行
+ * Runs under the exclusive index lock
+ */
+int ccvfsIoSync(sqlite3_file *pFile, int flags) {
+    CCVFSFile *p = (CCVFSFile *)pFile;
+    uint64_t tSync = ccvfs_event_begin(CCVFS_EVENT_SYNC);
+    uint64_t tRecord = ccvfs_record_begin(p);
+    int rc;
+    
+    ccvfs_rwlock_write_enter(&p->index_lock);
+    rc = ccvfs_io_sync_locked(pFile, flags);
+    ccvfs_snapshot_publish(p);
+    ccvfs_rwlock_write_leave(&p->index_lock);
+    ccvfs_event(p, CCVFS_EVENT_SYNC, tSync, 0, 0, 0, 0, (uint32_t)flags, CCVFS_CACHE_NONE, rc);
+    ccvfs_record(p, CCVFS_RECORD_SYNC, tRecord, 0, (uint32_t)flags, NULL, rc);
+    return rc;
+}
+
 /*
  * 获取文件大小
  * 对于CCVFS文件：返回基于页结构的逻辑文件大小
@@ -1436,7 +1828,7 @@ int ccvfsIoSync(sqlite3_file *pFile, int flags) {
  * For CCVFS files: return logical file size based on page structure
  * For regular files: return underlying file size
  */
-int ccvfsIoFileSize(sqlite3_file *pFile, sqlite3_int64 *pSize) {
+static int ccvfs_io_file_size_locked(sqlite3_file *pFile, sqlite3_int64 *pSize) {
     CCVFSFile *p = (CCVFSFile *)pFile;
     
     CCVFS_DEBUG("Getting file size");
@@ -1466,7 +1858,6 @@ int ccvfsIoFileSize(sqlite3_file *pFile, sqlite3_int64 *pSize) {
     if (pageSize == 0) {
         CCVFS_ERROR("Invalid page size in header, using default");
         pageSize = CCVFS_DEFAULT_PAGE_SIZE;
-        p->header.page_size = pageSize;
     }
     
     *pSize = (sqlite3_int64)p->header.database_size_pages * pageSize;
@@ -1475,40 +1866,171 @@ int ccvfsIoFileSize(sqlite3_file *pFile, sqlite3_int64 *pSize) {
     return SQLITE_OK;
 }
 
+/*
+ * 优先使用当前索引快照中的逻辑大小；否则在共享索引锁内执行
+ * Prefer the logical size recorded in the current index snapshot; otherwise runs under the shared index lock
+ */
+int ccvfsIoFileSize(sqlite3_file *pFile, sqlite3_int64 *pSize) {
+    CCVFSFile *p = (CCVFSFile *)pFile;
+    int rc;
+    
+    CCVFSIndexSnapshot *pSnap = p->is_ccvfs_file ? ccvfs_snapshot_acquire(p) : NULL;
+    if (pSnap) {
+        uint32_t pageSize = pSnap->page_size ? pSnap->page_size : CCVFS_DEFAULT_PAGE_SIZE;
+        *pSize = (sqlite3_int64)pSnap->database_size_pages * pageSize;
+        ccvfs_snapshot_release(p, pSnap);
+        return SQLITE_OK;
+    }
+    
+    // 文件头尚未加载时会初始化文件头，需要独占锁
+    // Initializes the header when not loaded yet, which needs the exclusive lock
+    if (!p->header_loaded) {
+        ccvfs_rwlock_write_enter(&p->index_lock);
+        rc = ccvfs_io_file_size_locked(pFile, pSize);
+        ccvfs_rwlock_write_leave(&p->index_lock);
+    } else {
+        ccvfs_rwlock_read_enter(&p->index_lock);
+        rc = ccvfs_io_file_size_locked(pFile, pSize);
+        ccvfs_rwlock_read_leave(&p->index_lock);
+    }
+    return rc;
+}
+
 /*
  * 锁定文件
- * 直接传递给底层VFS处理
+ * 传递给底层VFS处理；获取SHARED锁时检查其他连接是否修改了索引
  * Lock file
- * Pass through to underlying VFS
+ * Pass through to underlying VFS; when the SHARED lock is taken, check whether other connections changed the index
  */
-int ccvfsIoLock(sqlite3_file *pFile, int eLock) {
+static int ccvfs_io_lock(sqlite3_file *pFile, int eLock) {
     CCVFSFile *p = (CCVFSFile *)pFile;
+    int rc = SQLITE_OK;
     
     CCVFS_DEBUG("Locking file with level %d", eLock);
     
     if (p->pReal && p->pReal->pMethods->xLock) {
-        return p->pReal->pMethods->xLock(p->pReal, eLock);
+        rc = p->pReal->pMethods->xLock(p->pReal, eLock);
+        if (rc != SQLITE_OK) {
+            return rc;
+        }
     }
     
-    return SQLITE_OK;
+    int prevLevel = p->lock_level;
+    if (eLock > p->lock_level) {
+        CCVFS_COUNTER_SET(p->lock_level, eLock);
+    }
+    
+    if (!p->is_ccvfs_file) {
+        return SQLITE_OK;
+    }
+    
+    ccvfs_rwlock_write_enter(&p->index_lock);
+    
+    // 新的读事务开始：只重新加载被其他连接修改的索引块
+    // A new read transaction starts: reload only index blocks changed by other connections
+    if (eLock == SQLITE_LOCK_SHARED && prevLevel == SQLITE_LOCK_NONE) {
+        rc = ccvfs_refresh_page_index(p);
+        if (rc != SQLITE_OK) {
+            CCVFS_ERROR("Failed to refresh page index: %d", rc);
+        }
+    }
+    
+    // 写事务开始：本连接的修改在提交前不能出现在共享索引中
+    // A write transaction starts: this connection's changes must not appear in the shared index before commit
+    if (rc == SQLITE_OK && p->index_shared && eLock >= SQLITE_LOCK_RESERVED) {
+        rc = ccvfs_shm_detach_index(p);
+    }
+    
+    ccvfs_snapshot_publish(p);
+    ccvfs_rwlock_write_leave(&p->index_lock);
+    
+    // 失败的加锁不能改变锁状态：退回到原来的锁（底层VFS只能退回到SHARED或NONE）
+    // A failed lock must leave the lock state unchanged: step back to the previous lock (the
+    // underlying VFS can only step back to SHARED or NONE)
+    if (rc != SQLITE_OK && eLock > prevLevel && prevLevel <= SQLITE_LOCK_SHARED) {
+        if (p->pReal && p->pReal->pMethods->xUnlock) {
+            p->pReal->pMethods->xUnlock(p->pReal, prevLevel);
+        }
+        CCVFS_COUNTER_SET(p->lock_level, prevLevel);
+    }
+    return rc;
+}
+
+int ccvfsIoLock(sqlite3_file *pFile, int eLock) {
+    CCVFSFile *p = (CCVFSFile *)pFile;
+    uint64_t tRecord = ccvfs_record_begin(p);
+    int rc = ccvfs_io_lock(pFile, eLock);
+    
+    ccvfs_record(p, CCVFS_RECORD_LOCK, tRecord, 0, (uint32_t)eLock, NULL, rc);
+    return rc;
+}
+
+/*
+ * 刷新写入缓冲区并保存已修改的索引和文件头，使其他连接能看到本连接的修改
+ * Flush the write buffer and save a modified index and header so other connections see this connection's changes
+ */
+static int ccvfs_io_publish_changes(CCVFSFile *p) {
+    int rc = SQLITE_OK;
+    
+    if (!p->is_ccvfs_file || !p->pPageIndex || !p->header_loaded || (p->open_flags & SQLITE_OPEN_READONLY)) {
+        return SQLITE_OK;
+    }
+    ccvfs_rwlock_write_enter(&p->index_lock);
+    if (p->write_buffer.enabled && p->write_buffer.entry_count > 0) {
+        rc = ccvfs_flush_write_buffer(p);
+    }
+    if (rc == SQLITE_OK && p->index_dirty) {
+        rc = ccvfs_save_page_index(p);
+        if (rc == SQLITE_OK) {
+            rc = ccvfs_save_header(p);
+        }
+    }
+    ccvfs_snapshot_publish(p);
+    ccvfs_rwlock_write_leave(&p->index_lock);
+    if (rc != SQLITE_OK) {
+        CCVFS_ERROR("Failed to publish index: %d", rc);
+    }
+    return rc;
 }
 
 /*
  * 解锁文件
- * 直接传递给底层VFS处理
+ * 释放写锁前发布本连接的修改，然后传递给底层VFS处理
  * Unlock file
- * Pass through to underlying VFS
+ * Publish this connection's changes before dropping a write lock, then pass through to underlying VFS
  */
-int ccvfsIoUnlock(sqlite3_file *pFile, int eLock) {
+static int ccvfs_io_unlock(sqlite3_file *pFile, int eLock) {
     CCVFSFile *p = (CCVFSFile *)pFile;
+    int rc = SQLITE_OK;
     
     CCVFS_DEBUG("Unlocking file with level %d", eLock);
     
+    // 未调用xSync的事务（如synchronous=OFF）也必须在释放写锁前保存索引，
+    // 否则其他连接看不到这些修改
+    // Transactions that never called xSync (e.g. synchronous=OFF) must still save the index
+    // before the write lock is released, otherwise other connections never see the changes
+    if (p->lock_level > SQLITE_LOCK_SHARED && eLock <= SQLITE_LOCK_SHARED) {
+        rc = ccvfs_io_publish_changes(p);
+    }
+    
     if (p->pReal && p->pReal->pMethods->xUnlock) {
-        return p->pReal->pMethods->xUnlock(p->pReal, eLock);
+        int unlockRc = p->pReal->pMethods->xUnlock(p->pReal, eLock);
+        if (unlockRc != SQLITE_OK) {
+            return unlockRc;
+        }
     }
     
-    return SQLITE_OK;
+    CCVFS_COUNTER_SET(p->lock_level, eLock);
+    return rc;
+}
+
+int ccvfsIoUnlock(sqlite3_file *pFile, int eLock) {
+    CCVFSFile *p = (CCVFSFile *)pFile;
+    uint64_t tRecord = ccvfs_record_begin(p);
+    int rc = ccvfs_io_unlock(pFile, eLock);
+    
+    ccvfs_record(p, CCVFS_RECORD_UNLOCK, tRecord, 0, (uint32_t)eLock, NULL, rc);
+    return rc;
 }
 
 /*
@@ -1541,9 +2063,32 @@ int ccvfsIoFileControl(sqlite3_file *pFile, int op, void *pArg) {
     
     CCVFS_DEBUG("File control operation %d", op);
     
-    // 在这里处理CCVFS特定操作（如果需要）
-    // Handle CCVFS specific operations here if needed
-    
+    // CCVFS专用的PRAGMA，其余的交给底层文件
+    // CCVFS specific PRAGMAs, everything else goes to the underlying file
+    if (op == SQLITE_FCNTL_PRAGMA && p->is_ccvfs_file) {
+        int rc = ccvfs_pragma(p, (char**)pArg);
+        if (rc != SQLITE_NOTFOUND) {
+            return rc;
+        }
+    }
+
+    // 大小提示是逻辑大小；底层文件开启 mmap 时会按它截断物理文件，截掉压缩块
+    // A size hint is a logical size; with mmap on, the underlying file truncates the
+    // physical file to it and cuts off compressed blocks
+    if (op == SQLITE_FCNTL_SIZE_HINT && p->is_ccvfs_file) {
+        return SQLITE_OK;
+    }
+
+    // 检查点写完主文件后、公布nBackfill之前保存索引，synchronous=OFF时不会调用xSync
+    // A checkpoint saves the index once the main file is written and before nBackfill is
+    // published; with synchronous=OFF xSync is never called
+    if (op == SQLITE_FCNTL_CKPT_DONE && p->is_ccvfs_file) {
+        int rc = ccvfs_io_publish_changes(p);
+        if (rc != SQLITE_OK) {
+            return rc;
+        }
+    }
+
     if (p->pReal && p->pReal->pMethods->xFileControl) {
         return p->pReal->pMethods->xFileControl(p->pReal, op, pArg);
     }
@@ -1591,24 +2136,73 @@ int ccvfsIoShmMap(sqlite3_file *pFile, int iPg, int pgsz, int bExtend, void vola
     CCVFSFile *p = (CCVFSFile *)pFile;
     
     if (p->pReal && p->pReal->pMethods->xShmMap) {
-        return p->pReal->pMethods->xShmMap(p->pReal, iPg, pgsz, bExtend, pp);
+        int rc = p->pReal->pMethods->xShmMap(p->pReal, iPg, pgsz, bExtend, pp);
+        if (rc == SQLITE_OK && *pp) {
+            p->wal_mapped = 1;
+        }
+        return rc;
     }
     
     return SQLITE_IOERR_SHMMAP;
 }
 
 /*
- * 共享内存锁 - 传递给底层VFS
- * Shared memory lock - pass through to underlying VFS
+ * 重新加载其他连接修改的索引并发布
+ * Reload the index changed by other connections and publish it
+ */
+static int ccvfs_io_refresh_index(CCVFSFile *p) {
+    int rc;
+    
+    ccvfs_rwlock_write_enter(&p->index_lock);
+    rc = ccvfs_refresh_page_index(p);
+    ccvfs_snapshot_publish(p);
+    ccvfs_rwlock_write_leave(&p->index_lock);
+    return rc;
+}
+
+/*
+ * 共享内存锁 - 传递给底层VFS，并在WAL锁边界上同步索引
+ * Shared memory lock - pass through to underlying VFS and synchronize the index on WAL lock boundaries
+ * WAL模式下连接一直持有主文件的SHARED锁，xLock/xUnlock不再经历索引刷新和发布的边界：
+ * - 检查点在WAL_CKPT_LOCK独占期间改写主文件，获取时重新加载索引，释放前保存截断等后续修改；
+ * - 每个读事务以共享方式获取一个读标记槽（WAL_READ_LOCK(0)起），索引在之后的xShmBarrier中重新加载。
+ * In WAL mode a connection keeps its SHARED lock on the main file, so xLock/xUnlock no longer mark
+ * where the index is refreshed and published:
+ * - a checkpoint rewrites the main file while holding WAL_CKPT_LOCK exclusively, the index is
+ *   reloaded when it is taken and later changes such as a truncate are saved before it is released;
+ * - every read transaction takes one read mark slot shared (WAL_READ_LOCK(0) onwards), the index
+ *   is reloaded at the following xShmBarrier.
  */
 int ccvfsIoShmLock(sqlite3_file *pFile, int offset, int n, int flags) {
     CCVFSFile *p = (CCVFSFile *)pFile;
+    int ckpt = (offset == CCVFS_WAL_CKPT_LOCK && n == 1 && (flags & SQLITE_SHM_EXCLUSIVE));
+    int rc;
     
-    if (p->pReal && p->pReal->pMethods->xShmLock) {
+    if (!p->pReal || !p->pReal->pMethods->xShmLock) {
+        return SQLITE_IOERR_SHMLOCK;
+    }
+    if (!p->is_ccvfs_file) {
         return p->pReal->pMethods->xShmLock(p->pReal, offset, n, flags);
     }
+    if (ckpt && (flags & SQLITE_SHM_UNLOCK)) {
+        ccvfs_io_publish_changes(p);
+        p->wal_checkpointing = 0;
+    }
+    rc = p->pReal->pMethods->xShmLock(p->pReal, offset, n, flags);
     
-    return SQLITE_IOERR_SHMLOCK;
+    if (rc == SQLITE_OK && ckpt && (flags & SQLITE_SHM_LOCK)) {
+        rc = ccvfs_io_refresh_index(p);
+        if (rc != SQLITE_OK) {
+            CCVFS_ERROR("Failed to refresh page index before a checkpoint: %d", rc);
+            p->pReal->pMethods->xShmLock(p->pReal, offset, n, SQLITE_SHM_UNLOCK | SQLITE_SHM_EXCLUSIVE);
+        } else {
+            p->wal_checkpointing = 1;
+        }
+    }
+    if (rc == SQLITE_OK && offset >= CCVFS_WAL_READ_LOCK0 && n == 1 && (flags & SQLITE_SHM_SHARED)) {
+        p->wal_read_pending = (flags & SQLITE_SHM_LOCK) != 0;
+    }
+    return rc;
 }
 
 /*
@@ -1621,6 +2215,19 @@ void ccvfsIoShmBarrier(sqlite3_file *pFile) {
     if (p->pReal && p->pReal->pMethods->xShmBarrier) {
         p->pReal->pMethods->xShmBarrier(p->pReal);
     }
+    
+    // 读事务在获取读标记槽之后才读取nBackfill，紧接着调用xShmBarrier：此时刷新索引，才能看到
+    // 它认为已回填到主文件的所有帧（检查点在公布nBackfill之前的SQLITE_FCNTL_CKPT_DONE中保存索引）
+    // A read transaction reads nBackfill after taking its read mark slot and calls xShmBarrier
+    // right after: refreshing here sees every frame it takes as backfilled into the main file
+    // (a checkpoint saves its index at SQLITE_FCNTL_CKPT_DONE, before nBackfill is published)
+    if (p->wal_read_pending) {
+        p->wal_read_pending = 0;
+        int rc = ccvfs_io_refresh_index(p);
+        if (rc != SQLITE_OK) {
+            CCVFS_ERROR("Failed to refresh page index for a WAL read: %d", rc);
+        }
+    }
 }
 
 /*
@@ -1630,6 +2237,7 @@ void ccvfsIoShmBarrier(sqlite3_file *pFile) {
 int ccvfsIoShmUnmap(sqlite3_file *pFile, int deleteFlag) {
     CCVFSFile *p = (CCVFSFile *)pFile;
     
+    p->wal_mapped = 0;
     if (p->pReal && p->pReal->pMethods->xShmUnmap) {
         return p->pReal->pMethods->xShmUnmap(p->pReal, deleteFlag);
     }
@@ -1638,12 +2246,13 @@ int ccvfsIoShmUnmap(sqlite3_file *pFile, int deleteFlag) {
 }
 
 /*
- * 获取页面 - 压缩VFS不支持此操作
- * Fetch page - not supported for compressed VFS
+ * 获取页面 - 压缩VFS不支持内存映射，返回空指针让SQLite改用xRead
+ * Fetch page - compressed VFS has no memory mapping, a NULL page makes SQLite fall back to xRead
  */
 int ccvfsIoFetch(sqlite3_file *pFile, sqlite3_int64 iOfst, int iAmt, void **pp) {
     CCVFS_DEBUG("Fetch operation not supported for compressed VFS");
-    return SQLITE_IOERR;
+    *pp = 0;
+    return SQLITE_OK;
 }
 
 /*
@@ -1668,6 +2277,10 @@ int ccvfs_init_write_buffer(CCVFSFile *pFile) {
     
     CCVFS_DEBUG("Initializing write buffer for file: %s", pFile->filename ? pFile->filename : "unknown");
     
+    // 快照读取者不持有索引锁，通过缓冲区锁观察缓冲区
+    // Snapshot readers do not hold the index lock and observe the buffer through the buffer lock
+    sqlite3_mutex_enter(pFile->buffer_mutex);
+    
     // Initialize write buffer structure
     memset(pBuffer, 0, sizeof(CCVFSWriteBuffer));
     
@@ -1712,11 +2325,7 @@ int ccvfs_init_write_buffer(CCVFSFile *pFile) {
     pBuffer->buffer_size = 0;
     pBuffer->last_flush_time = 0;
     
-    // Initialize buffer statistics
-    pFile->buffer_hit_count = 0;
-    pFile->buffer_flush_count = 0;
-    pFile->buffer_merge_count = 0;
-    pFile->total_buffered_writes = 0;
+    sqlite3_mutex_leave(pFile->buffer_mutex);
     
     CCVFS_DEBUG("Write buffer initialized: enabled=%d, max_entries=%u, max_size=%u KB, auto_flush=%u",
               pBuffer->enabled, pBuffer->max_entries, pBuffer->max_buffer_size / 1024, pBuffer->auto_flush_pages);
@@ -1756,21 +2365,17 @@ void ccvfs_cleanup_write_buffer(CCVFSFile *pFile) {
     }
     
     // Report final statistics
-    if (1 || pBuffer->entry_count > 0 || pFile->total_buffered_writes > 0) {
-        CCVFS_DEBUG("Write buffer cleanup stats: entries=%u, hits=%u, flushes=%u, merges=%u, total_writes=%u",
-                  pBuffer->entry_count, pFile->buffer_hit_count, 
-                  pFile->buffer_flush_count, pFile->buffer_merge_count, pFile->total_buffered_writes);
+    if (1 || pBuffer->entry_count > 0 || pFile->counters.total_buffered_writes > 0) {
+        CCVFS_DEBUG("Write buffer cleanup stats: entries=%u, hits=%llu, flushes=%llu, merges=%llu, total_writes=%llu",
+                  pBuffer->entry_count, (unsigned long long)pFile->counters.buffer_hit_count, 
+                  (unsigned long long)pFile->counters.buffer_flush_count,
+                  (unsigned long long)pFile->counters.buffer_merge_count,
+                  (unsigned long long)pFile->counters.total_buffered_writes);
     }
     
     // Reset buffer structure
     memset(pBuffer, 0, sizeof(CCVFSWriteBuffer));
     
-    // Reset buffer statistics
-    pFile->buffer_hit_count = 0;
-    pFile->buffer_flush_count = 0;
-    pFile->buffer_merge_count = 0;
-    pFile->total_buffered_writes = 0;
-    
     CCVFS_DEBUG("Write buffer cleanup completed");
 }
 
@@ -1816,6 +2421,7 @@ static int ccvfs_remove_buffer_entry(CCVFSFile *pFile, CCVFSBufferEntry *pTarget
     while (pEntry) {
         if (pEntry == pTargetEntry) {
             // Remove from list
+            sqlite3_mutex_enter(pFile->buffer_mutex);
             if (pPrev) {
                 pPrev->next = pEntry->next;
             } else {
@@ -1825,6 +2431,7 @@ static int ccvfs_remove_buffer_entry(CCVFSFile *pFile, CCVFSBufferEntry *pTarget
             // Update buffer statistics
             pBuffer->entry_count--;
             pBuffer->buffer_size -= pEntry->data_size;
+            sqlite3_mutex_leave(pFile->buffer_mutex);
             
             // Free memory
             if (pEntry->data) {
@@ -1879,29 +2486,34 @@ int ccvfs_buffer_write(CCVFSFile *pFile, uint32_t pageNum, const unsigned char *
     if (pEntry) {
         CCVFS_DEBUG("Updating existing buffer entry for page %u", pageNum);
         
-        // Update buffer size statistics
-        pBuffer->buffer_size -= pEntry->data_size;
-        pBuffer->buffer_size += dataSize;
-        
         // Reallocate data if size changed
+        unsigned char *pNewData = pEntry->data;
         if (pEntry->data_size != dataSize) {
-            sqlite3_free(pEntry->data);
-            pEntry->data = sqlite3_malloc(dataSize);
-            if (!pEntry->data) {
+            pNewData = sqlite3_malloc(dataSize);
+            if (!pNewData) {
                 CCVFS_ERROR("Failed to allocate memory for buffer entry update");
                 return SQLITE_NOMEM;
             }
         }
         
-        // Copy new data
+        // Copy new data (readers of the entry hold the buffer lock)
+        sqlite3_mutex_enter(pFile->buffer_mutex);
+        if (pNewData != pEntry->data) {
+            sqlite3_free(pEntry->data);
+            pEntry->data = pNewData;
+        }
         memcpy(pEntry->data, data, dataSize);
+        pBuffer->buffer_size -= pEntry->data_size;
+        pBuffer->buffer_size += dataSize;
         pEntry->data_size = dataSize;
         pEntry->is_dirty = 1;
+        sqlite3_mutex_leave(pFile->buffer_mutex);
         
-        pFile->buffer_merge_count++;
-        pFile->total_buffered_writes++;
+        CCVFS_COUNTER_INC(pFile->counters.buffer_merge_count);
+        CCVFS_COUNTER_INC(pFile->counters.total_buffered_writes);
         
-        CCVFS_DEBUG("Updated buffer entry for page %u, merge count: %u", pageNum, pFile->buffer_merge_count);
+        CCVFS_DEBUG("Updated buffer entry for page %u, merge count: %llu", pageNum,
+                   (unsigned long long)pFile->counters.buffer_merge_count);
         return SQLITE_OK;
     }
     
@@ -1926,13 +2538,15 @@ int ccvfs_buffer_write(CCVFSFile *pFile, uint32_t pageNum, const unsigned char *
     memcpy(pEntry->data, data, dataSize);
     
     // Add to front of list
+    sqlite3_mutex_enter(pFile->buffer_mutex);
     pEntry->next = pBuffer->entries;
     pBuffer->entries = pEntry;
     
     // Update buffer statistics
     pBuffer->entry_count++;
     pBuffer->buffer_size += dataSize;
-    pFile->total_buffered_writes++;
+    sqlite3_mutex_leave(pFile->buffer_mutex);
+    CCVFS_COUNTER_INC(pFile->counters.total_buffered_writes);
     
     CCVFS_DEBUG("Added new buffer entry for page %u, total entries: %u, buffer size: %u", 
                pageNum, pBuffer->entry_count, pBuffer->buffer_size);
@@ -1960,14 +2574,20 @@ int ccvfs_buffer_read(CCVFSFile *pFile, uint32_t pageNum, unsigned char *buffer,
     
     CCVFS_DEBUG("Checking buffer for page %u read", pageNum);
     
+    // 快照读取者可能与写入者并发，查找和复制在缓冲区锁内进行
+    // Snapshot readers may run alongside the writer, so lookup and copy happen under the buffer lock
+    sqlite3_mutex_enter(pFile->buffer_mutex);
+    
     // Check if buffering is enabled
     if (!pWriteBuffer->enabled) {
+        sqlite3_mutex_leave(pFile->buffer_mutex);
         return SQLITE_NOTFOUND;  // Indicate caller should read from disk
     }
     
     // Look for the page in buffer
     pEntry = ccvfs_find_buffer_entry(pFile, pageNum);
     if (!pEntry) {
+        sqlite3_mutex_leave(pFile->buffer_mutex);
         CCVFS_DEBUG("Page %u not found in buffer", pageNum);
         return SQLITE_NOTFOUND;  // Indicate caller should read from disk
     }
@@ -1975,6 +2595,7 @@ int ccvfs_buffer_read(CCVFSFile *pFile, uint32_t pageNum, unsigned char *buffer,
     // Check buffer size compatibility
     if (pEntry->data_size > bufferSize) {
         CCVFS_ERROR("Buffer entry size %u exceeds read buffer size %u", pEntry->data_size, bufferSize);
+        sqlite3_mutex_leave(pFile->buffer_mutex);
         return SQLITE_ERROR;
     }
     
@@ -1986,12 +2607,38 @@ int ccvfs_buffer_read(CCVFSFile *pFile, uint32_t pageNum, unsigned char *buffer,
         memset(buffer + pEntry->data_size, 0, bufferSize - pEntry->data_size);
     }
     
-    pFile->buffer_hit_count++;
+    CCVFS_COUNTER_INC(pFile->counters.buffer_hit_count);
+    sqlite3_mutex_leave(pFile->buffer_mutex);
     
-    CCVFS_DEBUG("Buffer hit for page %u, hit count: %u", pageNum, pFile->buffer_hit_count);
+    CCVFS_DEBUG("Buffer hit for page %u, hit count: %llu", pageNum,
+               (unsigned long long)pFile->counters.buffer_hit_count);
     return SQLITE_OK;
 }
 
+/*
+ * 丢弃页面范围 [firstPage, endPage) 内的干净缓冲条目
+ * 其他连接修改了这些页面后，缓冲区中保留的副本已过期
+ * Discard clean buffer entries for pages in [firstPage, endPage)
+ * Copies kept in the buffer are stale once another connection changed those pages
+ */
+void ccvfs_buffer_discard_clean(CCVFSFile *pFile, uint32_t firstPage, uint32_t endPage) {
+    CCVFSWriteBuffer *pBuffer = &pFile->write_buffer;
+    CCVFSBufferEntry *pEntry, *pNext;
+    
+    if (!pBuffer->enabled || pBuffer->entry_count == 0) {
+        return;
+    }
+    
+    pEntry = pBuffer->entries;
+    while (pEntry) {
+        pNext = pEntry->next;
+        if (!pEntry->is_dirty && pEntry->page_number >= firstPage && pEntry->page_number < endPage) {
+            ccvfs_remove_buffer_entry(pFile, pEntry);
+        }
+        pEntry = pNext;
+    }
+}
+
 /*
  * 刷新指定页面的缓冲条目到磁盘
  * Flush specific buffer entry to disk
@@ -2047,6 +2694,7 @@ int ccvfs_flush_write_buffer(CCVFSFile *pFile) {
     }
     
     // Flush all dirty entries
+    uint64_t tFlush = ccvfs_event_begin(CCVFS_EVENT_FLUSH);
     pEntry = pBuffer->entries;
     while (pEntry) {
         if (pEntry->is_dirty) {
@@ -2067,8 +2715,10 @@ int ccvfs_flush_write_buffer(CCVFSFile *pFile) {
     }
     
     // Update statistics
-    pFile->buffer_flush_count++;
+    CCVFS_COUNTER_INC(pFile->counters.buffer_flush_count);
     pBuffer->last_flush_time = time(NULL);
+    ccvfs_event(pFile, CCVFS_EVENT_FLUSH, tFlush, 0, 0, 0, pBuffer->buffer_size, (uint32_t)flushed_count,
+                CCVFS_CACHE_NONE, rc);
     
     if (error_count > 0) {
         CCVFS_ERROR("Buffer flush completed with errors: flushed=%d, errors=%d", flushed_count, error_count);
@@ -2135,10 +2785,7 @@ int ccvfs_init_hole_manager(CCVFSFile *pFile) {
     pManager->holes = NULL;
     pManager->hole_count = 0;
     
-    // Initialize hole statistics
-    pFile->hole_allocation_count = 0;
-    pFile->hole_merge_count = 0;
-    pFile->hole_cleanup_count = 0;
+    // Restart the maintenance trigger (statistics counters live as long as the file)
     pFile->hole_operations_count = 0;
     
     CCVFS_DEBUG("Hole manager initialized: enabled=%d, max_holes=%u, min_hole_size=%u",
@@ -2170,20 +2817,16 @@ void ccvfs_cleanup_hole_manager(CCVFSFile *pFile) {
     }
     
     // Report final statistics
-    if (1 || pManager->hole_count > 0 || pFile->hole_allocation_count > 0) {
-        CCVFS_DEBUG("Hole manager cleanup stats: tracked_holes=%u, allocations=%u, merges=%u, cleanups=%u",
-                  pManager->hole_count, pFile->hole_allocation_count, 
-                  pFile->hole_merge_count, pFile->hole_cleanup_count);
+    if (1 || pManager->hole_count > 0 || pFile->counters.hole_allocation_count > 0) {
+        CCVFS_DEBUG("Hole manager cleanup stats: tracked_holes=%u, allocations=%llu, merges=%llu, cleanups=%llu",
+                  pManager->hole_count, (unsigned long long)pFile->counters.hole_allocation_count, 
+                  (unsigned long long)pFile->counters.hole_merge_count,
+                  (unsigned long long)pFile->counters.hole_cleanup_count);
     }
     
     // Reset hole manager structure
     memset(pManager, 0, sizeof(CCVFSHoleManager));
     
-    // Reset hole statistics
-    pFile->hole_allocation_count = 0;
-    pFile->hole_merge_count = 0;
-    pFile->hole_cleanup_count = 0;
-    
     CCVFS_DEBUG("Hole manager cleanup completed");
 }
 
@@ -2241,7 +2884,7 @@ int ccvfs_add_hole(CCVFSFile *pFile, sqlite3_int64 offset, uint32_t size) {
             pCurrent->offset = mergedStart;
             pCurrent->size = mergedSize;
             
-            pFile->hole_merge_count++;
+            CCVFS_COUNTER_INC(pFile->counters.hole_merge_count);
             
             // Check if we need to merge with the next hole too
             CCVFSSpaceHole *pNext = pCurrent->next;
@@ -2306,7 +2949,7 @@ int ccvfs_add_hole(CCVFSFile *pFile, sqlite3_int64 offset, uint32_t size) {
             }
             sqlite3_free(pSmallest);
             pManager->hole_count--;
-            pFile->hole_cleanup_count++;
+            CCVFS_COUNTER_INC(pFile->counters.hole_cleanup_count);
         } else {
             CCVFS_DEBUG("New hole[%llu,%u] not larger than smallest[%llu,%u], ignoring",
                        (unsigned long long)offset, size,
@@ -2501,10 +3144,10 @@ int ccvfs_allocate_from_hole(CCVFSFile *pFile, sqlite3_int64 offset, uint32_t al
                 
                 sqlite3_free(pCurrent);
                 pManager->hole_count--;
-                pFile->hole_cleanup_count++;
+                CCVFS_COUNTER_INC(pFile->counters.hole_cleanup_count);
             }
             
-            pFile->hole_allocation_count++;
+            CCVFS_COUNTER_INC(pFile->counters.hole_allocation_count);
             CCVFS_DEBUG("Hole allocation completed, remaining holes: %u", pManager->hole_count);
             
             // Check if maintenance is needed
@@ -2577,9 +3220,9 @@ static void ccvfs_merge_adjacent_holes(CCVFSFile *pFile) {
     }
     
     if (mergeCount > 0) {
-        pFile->hole_merge_count += mergeCount;
-        CCVFS_DEBUG("Merged %d holes, total merges: %u, remaining holes: %u",
-                  mergeCount, pFile->hole_merge_count, pManager->hole_count);
+        CCVFS_COUNTER_ADD(pFile->counters.hole_merge_count, mergeCount);
+        CCVFS_DEBUG("Merged %d holes, total merges: %llu, remaining holes: %u",
+                  mergeCount, (unsigned long long)pFile->counters.hole_merge_count, pManager->hole_count);
     } else {
         CCVFS_DEBUG("No adjacent holes found to merge");
     }
@@ -2634,9 +3277,9 @@ static void ccvfs_cleanup_small_holes(CCVFSFile *pFile) {
     }
     
     if (cleanupCount > 0) {
-        pFile->hole_cleanup_count += cleanupCount;
-        CCVFS_DEBUG("Cleaned up %d small holes, total cleanups: %u, remaining holes: %u",
-                  cleanupCount, pFile->hole_cleanup_count, pManager->hole_count);
+        CCVFS_COUNTER_ADD(pFile->counters.hole_cleanup_count, cleanupCount);
+        CCVFS_DEBUG("Cleaned up %d small holes, total cleanups: %llu, remaining holes: %u",
+                  cleanupCount, (unsigned long long)pFile->counters.hole_cleanup_count, pManager->hole_count);
     } else {
         CCVFS_DEBUG("No small holes found to cleanup");
     }
@@ -2667,4 +3310,323 @@ static void ccvfs_check_hole_maintenance_threshold(CCVFSFile *pFile) {
         
         CCVFS_DEBUG("Threshold-based maintenance completed");
     }
-}
\ No newline at end of file
+}
+
+/*
+ * ============================================================================
+ * 在线压实
+ * 把位于文件尾部的页面移动到前面的空闲空间，然后截断文件。每一轮只把页面写入当前索引、
+ * 快照和延迟释放列表都未引用的空间，先同步数据再保存索引，因此任何时刻崩溃都只会看到
+ * 旧位置或新位置的完整页面；被移走页面的旧位置要到下一轮才会再次使用。
+ *
+ * Online compaction
+ * Moves pages near the end of the file into free space further down, then truncates the file.
+ * Every pass only writes into space referenced by neither the current index, a snapshot nor the
+ * deferred list, and syncs the data before saving the index, so a crash at any point sees every
+ * page complete at either its old or its new location; space vacated in one pass is reused in the next.
+ * ============================================================================
+ */
+
+#define CCVFS_COMPACT_MAX_PASSES 16  // Each pass strictly lowers page offsets, this only bounds pathological layouts
+
+typedef struct CCVFSCompactExtent {
+    sqlite3_int64 offset; // Starting offset (起始偏移)
+    uint32_t size; // Size in bytes (大小，字节)
+    uint32_t page_number; // Owning page, UINT32_MAX for space owned by a snapshot (所属页)
+} CCVFSCompactExtent;
+
+static int ccvfs_compact_extent_cmp(const void *pA, const void *pB) {
+    const CCVFSCompactExtent *a = (const CCVFSCompactExtent*)pA;
+    const CCVFSCompactExtent *b = (const CCVFSCompactExtent*)pB;
+    
+    if (a->offset != b->offset) {
+        return a->offset < b->offset ? -1 : 1;
+    }
+    return 0;
+}
+
+typedef struct CCVFSCompactList {
+    CCVFSCompactExtent *a; // Extents (空间数组)
+    uint32_t n; // Number used (已用数量)
+    uint32_t nAlloc; // Number allocated (已分配数量)
+} CCVFSCompactList;
+
+static int ccvfs_compact_append(CCVFSCompactList *pList, sqlite3_int64 offset, uint32_t size, uint32_t pageNum) {
+    if (pList->n == pList->nAlloc) {
+        uint32_t nNew = pList->nAlloc ? pList->nAlloc * 2 : 64;
+        CCVFSCompactExtent *aNew = (CCVFSCompactExtent*)sqlite3_realloc64(pList->a,
+                                        (sqlite3_uint64)nNew * sizeof(CCVFSCompactExtent));
+        if (!aNew) {
+            return SQLITE_NOMEM;
+        }
+        pList->a = aNew;
+        pList->nAlloc = nNew;
+    }
+    pList->a[pList->n].offset = offset;
+    pList->a[pList->n].size = size;
+    pList->a[pList->n].page_number = pageNum;
+    pList->n++;
+    return SQLITE_OK;
+}
+
+/*
+ * 收集所有仍被引用的空间，按偏移排序（调用者持有alloc_mutex）
+ * 截断后超出总页数的页面不再出现在当前索引中，但仍可能被旧快照读取
+ * Collect every extent still referenced, sorted by offset (caller holds alloc_mutex)
+ * Pages past total_pages after a truncate are gone from the current index but may still be read through an old snapshot
+ */
+static int ccvfs_compact_collect(CCVFSFile *pFile, CCVFSCompactExtent **paExtent, uint32_t *pnExtent) {
+    CCVFSCompactList list = {NULL, 0, 0};
+    int rc = SQLITE_OK;
+    
+    for (uint32_t i = 0; rc == SQLITE_OK && i < pFile->header.total_pages; i++) {
+        const CCVFSPageIndex *pIndex = &pFile->pPageIndex[i];
+        if (pIndex->physical_offset != 0 && pIndex->compressed_size > 0) {
+            rc = ccvfs_compact_append(&list, (sqlite3_int64)pIndex->physical_offset, pIndex->compressed_size, i);
+        }
+    }
+    for (CCVFSDeferredExtent *pDeferred = pFile->pDeferred; rc == SQLITE_OK && pDeferred; pDeferred = pDeferred->next) {
+        rc = ccvfs_compact_append(&list, pDeferred->offset, pDeferred->size, UINT32_MAX);
+    }
+    
+    sqlite3_mutex_enter(pFile->snapshot_mutex);
+    for (CCVFSIndexSnapshot *pSnap = pFile->pLiveSnapshots; rc == SQLITE_OK && pSnap; pSnap = pSnap->next) {
+        for (uint32_t i = pFile->header.total_pages; rc == SQLITE_OK && i < pSnap->total_pages; i++) {
+            const CCVFSPageIndex *pEntry = ccvfs_snapshot_entry(pSnap, i);
+            if (pEntry && pEntry->physical_offset != 0 && pEntry->compressed_size > 0) {
+                rc = ccvfs_compact_append(&list, (sqlite3_int64)pEntry->physical_offset,
+                                          pEntry->compressed_size, UINT32_MAX);
+            }
+        }
+    }
+    sqlite3_mutex_leave(pFile->snapshot_mutex);
+    
+    if (rc != SQLITE_OK) {
+        sqlite3_free(list.a);
+        return rc;
+    }
+    if (list.n > 0) {
+        qsort(list.a, list.n, sizeof(CCVFSCompactExtent), ccvfs_compact_extent_cmp);
+    }
+    *paExtent = list.a;
+    *pnExtent = list.n;
+    return SQLITE_OK;
+}
+
+/*
+ * 根据已排序的占用空间计算空闲区间，返回占用空间的末尾
+ * Derive the free ranges from the sorted extents, returns the end of the used space
+ */
+static sqlite3_int64 ccvfs_compact_gaps(const CCVFSCompactExtent *aExtent, uint32_t nExtent,
+                                        CCVFSCompactExtent *aGap, uint32_t *pnGap) {
+    sqlite3_int64 cursor = CCVFS_DATA_PAGES_OFFSET;
+    uint32_t nGap = 0;
+    
+    for (uint32_t i = 0; i < nExtent; i++) {
+        if (aExtent[i].offset > cursor) {
+            aGap[nGap].offset = cursor;
+            aGap[nGap].size = aExtent[i].offset - cursor > UINT32_MAX ?
+                              UINT32_MAX : (uint32_t)(aExtent[i].offset - cursor);
+            aGap[nGap].page_number = UINT32_MAX;
+            nGap++;
+        }
+        if (aExtent[i].offset + aExtent[i].size > cursor) {
+            cursor = aExtent[i].offset + aExtent[i].size;
+        }
+    }
+    *pnGap = nGap;
+    return cursor;
+}
+
+/*
+ * 一轮压实：从文件尾部开始，把每个页面移动到它之前第一个足够大的空闲区间
+ * One compaction pass: starting from the end of the file, move every page into the first
+ * large enough free range below it
+ */
+static int ccvfs_compact_pass(CCVFSFile *pFile, uint32_t *pMoved) {
+    CCVFSCompactExtent *aExtent = NULL;
+    CCVFSCompactExtent *aGap = NULL;
+    unsigned char *pData = NULL;
+    uint32_t nExtent = 0, nGap = 0, nData = 0;
+    uint32_t moved = 0;
+    int rc;
+    
+    *pMoved = 0;
+    sqlite3_mutex_enter(pFile->alloc_mutex);
+    
+    rc = ccvfs_compact_collect(pFile, &aExtent, &nExtent);
+    if (rc == SQLITE_OK) {
+        aGap = (CCVFSCompactExtent*)sqlite3_malloc64(((sqlite3_uint64)nExtent + 1) * sizeof(CCVFSCompactExtent));
+        if (!aGap) {
+            rc = SQLITE_NOMEM;
+        }
+    }
+    if (rc == SQLITE_OK) {
+        ccvfs_compact_gaps(aExtent, nExtent, aGap, &nGap);
+    }
+    
+    for (uint32_t e = nExtent; rc == SQLITE_OK && e > 0 && nGap > 0; e--) {
+        const CCVFSCompactExtent *pExtent = &aExtent[e - 1];
+        CCVFSPageIndex *pIndex;
+        uint32_t g;
+        
+        if (pExtent->page_number == UINT32_MAX) {
+            continue;  // Owned by a snapshot, cannot move
+        }
+        for (g = 0; g < nGap && aGap[g].offset < pExtent->offset; g++) {
+            if (aGap[g].size >= pExtent->size) {
+                break;
+            }
+        }
+        if (g == nGap || aGap[g].offset >= pExtent->offset) {
+            continue;
+        }
+        
+        if (pExtent->size > nData) {
+            unsigned char *pNew = (unsigned char*)sqlite3_realloc(pData, (int)pExtent->size);
+            if (!pNew) {
+                rc = SQLITE_NOMEM;
+                break;
+            }
+            pData = pNew;
+            nData = pExtent->size;
+        }
+        
+        // 存储的字节原样复制，校验和不变
+        // Stored bytes are copied as they are, the checksum stays valid
+        rc = pFile->pReal->pMethods->xRead(pFile->pReal, pData, (int)pExtent->size, pExtent->offset);
+        if (rc == SQLITE_OK) {
+            rc = pFile->pReal->pMethods->xWrite(pFile->pReal, pData, (int)pExtent->size, aGap[g].offset);
+        }
+        if (rc != SQLITE_OK) {
+            CCVFS_ERROR("Failed to move page %u during compaction: %d", pExtent->page_number, rc);
+            break;
+        }
+        
+        // 快照仍可能读取旧位置
+        // A snapshot may still read the old location
+        if (ccvfs_snapshot_extent_published(pFile, pExtent->page_number, pExtent->offset)) {
+            ccvfs_snapshot_defer_extent(pFile, pExtent->offset, pExtent->size);
+        }
+        
+        CCVFS_DEBUG("Compaction moved page %u: %llu -> %llu (%u bytes)", pExtent->page_number,
+                   (unsigned long long)pExtent->offset, (unsigned long long)aGap[g].offset, pExtent->size);
+        
+        pIndex = &pFile->pPageIndex[pExtent->page_number];
+        pIndex->physical_offset = (uint64_t)aGap[g].offset;
+        ccvfs_mark_index_dirty(pFile, pExtent->page_number);
+        aGap[g].offset += pExtent->size;
+        aGap[g].size -= pExtent->size;
+        moved++;
+    }
+    
+    sqlite3_mutex_leave(pFile->alloc_mutex);
+    sqlite3_free(pData);
+    sqlite3_free(aGap);
+    sqlite3_free(aExtent);
+    *pMoved = moved;
+    return rc;
+}
+
+/*
+ * 压实文件（调用者持有数据库EXCLUSIVE锁和索引写锁）
+ * 结束后空洞列表按剩余的空闲区间重建，文件截断到最后一个仍被引用的字节
+ * Compact the file (caller holds the database EXCLUSIVE lock and the index write lock)
+ * Afterwards the hole list is rebuilt from the remaining free ranges and the file is
+ * truncated after the last byte still referenced
+ */
+int ccvfs_compact_file(CCVFSFile *pFile, uint32_t *pMovedPages,
+                       sqlite3_int64 *pOldSize, sqlite3_int64 *pNewSize) {
+    CCVFSCompactExtent *aExtent = NULL;
+    CCVFSCompactExtent *aGap = NULL;
+    uint32_t nExtent = 0, nGap = 0;
+    uint32_t movedTotal = 0;
+    sqlite3_int64 oldSize = 0, newSize = 0, usedEnd;
+    int rc;
+    
+    *pMovedPages = 0;
+    if (!pFile->is_ccvfs_file || !pFile->pPageIndex || !pFile->header_loaded) {
+        return SQLITE_OK;
+    }
+    
+    rc = pFile->pReal->pMethods->xFileSize(pFile->pReal, &oldSize);
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+    newSize = oldSize;
+    
+    if (pFile->write_buffer.enabled && pFile->write_buffer.entry_count > 0) {
+        rc = ccvfs_flush_write_buffer(pFile);
+    }
+    
+    for (int pass = 0; rc == SQLITE_OK && pass < CCVFS_COMPACT_MAX_PASSES; pass++) {
+        uint32_t moved = 0;
+        
+        rc = ccvfs_compact_pass(pFile, &moved);
+        if (rc != SQLITE_OK || moved == 0) {
+            break;
+        }
+        movedTotal += moved;
+        
+        // 新位置落盘后才能让索引指向它们
+        // The new locations must be durable before the index points at them
+        rc = pFile->pReal->pMethods->xSync(pFile->pReal, SQLITE_SYNC_NORMAL);
+        if (rc == SQLITE_OK) {
+            rc = ccvfs_save_page_index(pFile);
+        }
+        if (rc == SQLITE_OK) {
+            rc = ccvfs_save_header(pFile);
+        }
+        if (rc == SQLITE_OK) {
+            rc = pFile->pReal->pMethods->xSync(pFile->pReal, SQLITE_SYNC_NORMAL);
+        }
+        ccvfs_snapshot_publish(pFile);
+        CCVFS_DEBUG("Compaction pass %d moved %u pages", pass + 1, moved);
+    }
+    
+    if (rc == SQLITE_OK) {
+        sqlite3_mutex_enter(pFile->alloc_mutex);
+        rc = ccvfs_compact_collect(pFile, &aExtent, &nExtent);
+        if (rc == SQLITE_OK) {
+            aGap = (CCVFSCompactExtent*)sqlite3_malloc64(((sqlite3_uint64)nExtent + 1) * sizeof(CCVFSCompactExtent));
+            if (!aGap) {
+                rc = SQLITE_NOMEM;
+            }
+        }
+        if (rc == SQLITE_OK) {
+            usedEnd = ccvfs_compact_gaps(aExtent, nExtent, aGap, &nGap);
+            
+            // 空洞列表只保留截断点之前的空闲区间
+            // The hole list keeps only the free ranges below the truncation point
+            if (pFile->hole_manager.enabled) {
+                ccvfs_cleanup_hole_manager(pFile);
+                ccvfs_init_hole_manager(pFile);
+                for (uint32_t g = 0; g < nGap; g++) {
+                    ccvfs_add_hole(pFile, aGap[g].offset, aGap[g].size);
+                }
+            }
+            
+            if (usedEnd < oldSize) {
+                rc = pFile->pReal->pMethods->xTruncate(pFile->pReal, usedEnd);
+                if (rc == SQLITE_OK) {
+                    newSize = usedEnd;
+                }
+            }
+            ccvfs_update_space_tracking(pFile);
+        }
+        sqlite3_mutex_leave(pFile->alloc_mutex);
+    }
+    if (rc == SQLITE_OK && newSize < oldSize) {
+        rc = pFile->pReal->pMethods->xSync(pFile->pReal, SQLITE_SYNC_NORMAL);
+    }
+    
+    sqlite3_free(aGap);
+    sqlite3_free(aExtent);
+    
+    CCVFS_DEBUG("Compaction of %s moved %u pages, file %lld -> %lld bytes",
+               pFile->filename ? pFile->filename : "unknown", movedTotal, oldSize, newSize);
+    *pMovedPages = movedTotal;
+    if (pOldSize) *pOldSize = oldSize;
+    if (pNewSize) *pNewSize = newSize;
+    return rc;
+}
@@ -0,0 +1,340 @@
+#include "ccvfs_log.h"
+#include "ccvfs_hooks.h"
+#include <stdarg.h>
+
+/*
+ * 运行时日志与页面事件跟踪环
+ * 日志级别是一个进程级变量，日志宏先做一次宽松原子读取，只有级别足够时才格式化参数，
+ * 因此DEBUG和VERBOSE消息可以在生产环境中按需打开，无需重新编译。消息交给用户回调
+ * （默认写到stderr/stdout）。
+ * 跟踪环是一个固定大小的无锁环形缓冲区，记录页面读写、空间分配、缓冲刷新、同步和
+ * 校验和错误。写入者用原子递增领取序号，再以序列锁方式写入槽位：先清零槽位序号，
+ * 写入字段，最后以release语义写入序号。读取者校验槽位序号前后一致，被覆盖中的事件直接跳过。
+ * 环满后覆盖最旧的事件；两个写入者恰好相隔整圈写同一槽位时，该事件可能被丢弃。
+ *
+ * Runtime logging and the page event trace ring
+ * The log level is a process-wide variable; the logging macros do one relaxed atomic load and
+ * only format their arguments when the level allows it, so DEBUG and VERBOSE messages can be
+ * switched on in production without rebuilding. Messages go to a user callback (stderr/stdout
+ * by default).
+ * The trace ring is a fixed-size lock-free ring buffer of page reads, writes, space
+ * allocations, buffer flushes, syncs and checksum errors. A writer claims a sequence number
+ * with an atomic increment and fills the slot seqlock style: clear the slot sequence, store
+ * the fields, then store the sequence with release semantics. Readers check that the slot
+ * sequence is the same before and after copying and skip events being overwritten.
+ * A full ring overwrites its oldest events; an event may be lost when two writers a whole
+ * ring apart hit the same slot.
+ */
+
+#if defined(__GNUC__) || defined(__clang__)
+#define CCVFS_TRACE_CLAIM(var)             __atomic_fetch_add(&(var), 1, __ATOMIC_RELAXED)
+#define CCVFS_TRACE_LOAD_ACQUIRE(var)      __atomic_load_n(&(var), __ATOMIC_ACQUIRE)
+#define CCVFS_TRACE_STORE_RELEASE(var, v)  __atomic_store_n(&(var), (v), __ATOMIC_RELEASE)
+#define CCVFS_TRACE_FENCE_ACQUIRE()        __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define CCVFS_TRACE_FENCE_RELEASE()        __atomic_thread_fence(__ATOMIC_RELEASE)
+#else
+#define CCVFS_TRACE_CLAIM(var)             ((var)++)
+#define CCVFS_TRACE_LOAD_ACQUIRE(var)      (var)
+#define CCVFS_TRACE_STORE_RELEASE(var, v)  ((void)((var) = (v)))
+#define CCVFS_TRACE_FENCE_ACQUIRE()        ((void)0)
+#define CCVFS_TRACE_FENCE_RELEASE()        ((void)0)
+#endif
+
+#define CCVFS_TRACE_RING_MASK       (CCVFS_TRACE_RING_SIZE - 1)
+#define CCVFS_TRACE_ERROR_EVENTS    32   // Events passed to the log callback after an error
+#define CCVFS_LOG_MESSAGE_SIZE      1024
+
+/*
+ * 跟踪环槽位：seq为事件序号（从1开始），0表示空或正在写入
+ * Trace ring slot: seq is the event sequence number (from 1), 0 while empty or being written
+ */
+typedef struct {
+    uint64_t seq;
+    uint64_t timestamp_ns;
+    uint64_t offset;
+    uint32_t file_id;
+    uint32_t type;
+    uint32_t page;
+    uint32_t size;
+    uint32_t aux;
+    int32_t rc;
+} CCVFSTraceSlot;
+
+#if defined(VERBOSE)
+int ccvfs_log_level = CCVFS_LOG_VERBOSE;
+#elif defined(DEBUG)
+int ccvfs_log_level = CCVFS_LOG_DEBUG;
+#else
+int ccvfs_log_level = CCVFS_LOG_ERROR;
+#endif
+int ccvfs_trace_flags = 0;
+
+static CCVFSLogCallback ccvfs_log_callback = NULL;
+static void *ccvfs_log_callback_arg = NULL;
+
+static CCVFSTraceSlot ccvfs_trace_ring[CCVFS_TRACE_RING_SIZE];
+static uint64_t ccvfs_trace_head = 0;       // Events claimed so far
+static uint64_t ccvfs_trace_dumped = 0;     // Newest event already dumped after an error
+static uint64_t ccvfs_file_id_counter = 0;
+
+static const char *const ccvfs_event_names[CCVFS_EVENT_COUNT] = {
+    "read",
+    "write",
+    "allocate",
+    "flush",
+    "sync",
+    "checksum"
+};
+
+static const char *const ccvfs_level_names[] = {
+    "OFF", "ERROR", "INFO", "DEBUG", "VERBOSE"
+};
+
+const char *sqlite3_ccvfs_event_name(int type) {
+    if (type < 0 || type >= CCVFS_EVENT_COUNT) {
+        return NULL;
+    }
+    return ccvfs_event_names[type];
+}
+
+uint32_t ccvfs_log_next_file_id(void) {
+    return (uint32_t)CCVFS_TRACE_CLAIM(ccvfs_file_id_counter) + 1;
+}
+
+/*
+ * 日志回调与参数成对读写，由静态互斥锁保护；回调本身在锁外调用
+ * The callback and its argument are read and written as a pair under a static mutex;
+ * the callback itself runs outside the lock
+ */
+static void ccvfs_log_get_sink(CCVFSLogCallback *pxLog, void **ppArg) {
+    sqlite3_mutex *pMutex = sqlite3_mutex_alloc(SQLITE_MUTEX_STATIC_VFS3);
+
+    sqlite3_mutex_enter(pMutex);
+    *pxLog = ccvfs_log_callback;
+    *ppArg = ccvfs_log_callback_arg;
+    sqlite3_mutex_leave(pMutex);
+}
+
+static void ccvfs_log_emit(int level, const char *zMsg) {
+    CCVFSLogCallback xLog;
+    void *pArg;
+
+    ccvfs_log_get_sink(&xLog, &pArg);
+    if (xLog) {
+        xLog(pArg, level, zMsg);
+    } else if (level <= CCVFS_LOG_ERROR) {
+        fprintf(stderr, "[CCVFS ERROR] %s\n", zMsg);
+    } else {
+        fprintf(stdout, "[CCVFS %s] %s\n", ccvfs_level_names[level], zMsg);
+    }
+}
+
+void sqlite3_ccvfs_set_log_callback(CCVFSLogCallback xLog, void *pArg) {
+    sqlite3_mutex *pMutex = sqlite3_mutex_alloc(SQLITE_MUTEX_STATIC_VFS3);
+
+    sqlite3_mutex_enter(pMutex);
+    ccvfs_log_callback = xLog;
+    ccvfs_log_callback_arg = pArg;
+    sqlite3_mutex_leave(pMutex);
+}
+
+int sqlite3_ccvfs_set_log_level(int level) {
+    if (level < CCVFS_LOG_OFF || level > CCVFS_LOG_VERBOSE) {
+        return SQLITE_RANGE;
+    }
+    CCVFS_COUNTER_SET(ccvfs_log_level, level);
+    return SQLITE_OK;
+}
+
+int sqlite3_ccvfs_get_log_level(void) {
+    return CCVFS_COUNTER_GET(ccvfs_log_level);
+}
+
+/*
+ * 日志级别名称，无效级别返回NULL
+ * Name of a log level, NULL if invalid
+ */
+const char *ccvfs_log_level_name(int level) {
+    if (level < CCVFS_LOG_OFF || level > CCVFS_LOG_VERBOSE) {
+        return NULL;
+    }
+    return ccvfs_level_names[level];
+}
+
+static void ccvfs_trace_dump_at(int nMax, int level);
+
+/*
+ * 错误后转储上次转储以来的新事件（最多CCVFS_TRACE_ERROR_EVENTS个）
+ * After an error, dump the events recorded since the previous dump (at most CCVFS_TRACE_ERROR_EVENTS)
+ */
+static void ccvfs_trace_dump_since_error(void) {
+    uint64_t head = CCVFS_TRACE_LOAD_ACQUIRE(ccvfs_trace_head);
+    uint64_t dumped = CCVFS_COUNTER_GET(ccvfs_trace_dumped);
+    uint64_t fresh;
+
+    if (head <= dumped) {
+        return;
+    }
+    CCVFS_COUNTER_SET(ccvfs_trace_dumped, head);
+    fresh = head - dumped;
+    ccvfs_trace_dump_at(fresh < CCVFS_TRACE_ERROR_EVENTS ? (int)fresh : CCVFS_TRACE_ERROR_EVENTS, CCVFS_LOG_ERROR);
+}
+
+void ccvfs_log_write(int level, const char *zFunc, int line, const char *zFormat, ...) {
+    char zMsg[CCVFS_LOG_MESSAGE_SIZE];
+    va_list ap;
+    int n;
+
+    n = snprintf(zMsg, sizeof(zMsg), "%s:%d: ", zFunc, line);
+    if (n < 0 || n >= (int)sizeof(zMsg)) {
+        n = 0;
+    }
+    va_start(ap, zFormat);
+    vsnprintf(zMsg + n, sizeof(zMsg) - n, zFormat, ap);
+    va_end(ap);
+    ccvfs_log_emit(level, zMsg);
+
+    if (level == CCVFS_LOG_ERROR && (CCVFS_COUNTER_GET(ccvfs_trace_flags) & CCVFS_TRACE_DUMP_ON_ERROR)) {
+        ccvfs_trace_dump_since_error();
+    }
+}
+
+int sqlite3_ccvfs_trace_config(int flags) {
+    int prev = CCVFS_COUNTER_GET(ccvfs_trace_flags);
+
+    CCVFS_COUNTER_SET(ccvfs_trace_flags, flags & (CCVFS_TRACE_ON | CCVFS_TRACE_DUMP_ON_ERROR));
+    ccvfs_event_update_mask();
+    return prev;
+}
+
+void ccvfs_trace_record(const CCVFSIoEvent *pEvent) {
+    uint64_t seq = CCVFS_TRACE_CLAIM(ccvfs_trace_head) + 1;
+    CCVFSTraceSlot *pSlot = &ccvfs_trace_ring[(seq - 1) & CCVFS_TRACE_RING_MASK];
+
+    CCVFS_COUNTER_SET(pSlot->seq, 0);
+    CCVFS_TRACE_FENCE_RELEASE();
+    CCVFS_COUNTER_SET(pSlot->timestamp_ns, pEvent->start_ns);
+    CCVFS_COUNTER_SET(pSlot->offset, pEvent->offset);
+    CCVFS_COUNTER_SET(pSlot->file_id, pEvent->file_id);
+    CCVFS_COUNTER_SET(pSlot->type, pEvent->type);
+    CCVFS_COUNTER_SET(pSlot->page, pEvent->page);
+    CCVFS_COUNTER_SET(pSlot->size, pEvent->stored_size);
+    CCVFS_COUNTER_SET(pSlot->aux, pEvent->aux);
+    CCVFS_COUNTER_SET(pSlot->rc, (int32_t)pEvent->rc);
+    CCVFS_TRACE_STORE_RELEASE(pSlot->seq, seq);
+}
+
+int sqlite3_ccvfs_trace_read(CCVFSTraceEvent *aEvent, int nMax) {
+    uint64_t head = CCVFS_TRACE_LOAD_ACQUIRE(ccvfs_trace_head);
+    uint64_t first;
+    int n = 0;
+
+    if (!aEvent || nMax <= 0) {
+        return 0;
+    }
+    if ((uint64_t)nMax > CCVFS_TRACE_RING_SIZE) {
+        nMax = CCVFS_TRACE_RING_SIZE;
+    }
+    first = head > (uint64_t)nMax ? head - (uint64_t)nMax + 1 : 1;
+
+    for (uint64_t seq = first; seq <= head; seq++) {
+        CCVFSTraceSlot *pSlot = &ccvfs_trace_ring[(seq - 1) & CCVFS_TRACE_RING_MASK];
+        CCVFSTraceEvent *pEvent = &aEvent[n];
+
+        if (CCVFS_TRACE_LOAD_ACQUIRE(pSlot->seq) != seq) {
+            continue;  // Not written yet, being written or already overwritten
+        }
+        pEvent->sequence = seq;
+        pEvent->timestamp_ns = CCVFS_COUNTER_GET(pSlot->timestamp_ns);
+        pEvent->offset = CCVFS_COUNTER_GET(pSlot->offset);
+        pEvent->file_id = CCVFS_COUNTER_GET(pSlot->file_id);
+        pEvent->type = CCVFS_COUNTER_GET(pSlot->type);
+        pEvent->page = CCVFS_COUNTER_GET(pSlot->page);
+        pEvent->size = CCVFS_COUNTER_GET(pSlot->size);
+        pEvent->aux = CCVFS_COUNTER_GET(pSlot->aux);
+        pEvent->rc = CCVFS_COUNTER_GET(pSlot->rc);
+        CCVFS_TRACE_FENCE_ACQUIRE();
+        if (CCVFS_COUNTER_GET(pSlot->seq) == seq) {
+            n++;
+        }
+    }
+    return n;
+}
+
+/*
+ * 格式化一个事件，时间为相对最新事件的微秒数
+ * Format one event, with its time in microseconds before the newest event
+ */
+static void ccvfs_trace_format(sqlite3_str *pStr, const CCVFSTraceEvent *pEvent, uint64_t newest) {
+    const char *zType = sqlite3_ccvfs_event_name((int)pEvent->type);
+
+    sqlite3_str_appendf(pStr, "#%llu t-%.1fus file=%u %s page=%u offset=%llu size=%u aux=%u rc=%d",
+                        (unsigned long long)pEvent->sequence,
+                        (double)(newest - pEvent->timestamp_ns) / 1000.0,
+                        pEvent->file_id, zType ? zType : "?", pEvent->page,
+                        (unsigned long long)pEvent->offset, pEvent->size, pEvent->aux, pEvent->rc);
+}
+
+/*
+ * 读取最新事件，返回事件数（调用者用sqlite3_free释放*paEvent）
+ * Read the latest events, returns how many (caller frees *paEvent with sqlite3_free)
+ */
+static int ccvfs_trace_snapshot(int nMax, CCVFSTraceEvent **paEvent) {
+    if (nMax <= 0 || nMax > CCVFS_TRACE_RING_SIZE) {
+        nMax = CCVFS_TRACE_RING_SIZE;
+    }
+    *paEvent = sqlite3_malloc64(sizeof(CCVFSTraceEvent) * (sqlite3_uint64)nMax);
+    if (!*paEvent) {
+        return 0;
+    }
+    return sqlite3_ccvfs_trace_read(*paEvent, nMax);
+}
+
+/*
+ * 把最新事件逐行交给日志回调，不受日志级别限制
+ * Pass the latest events to the log callback line by line, whatever the log level
+ */
+static void ccvfs_trace_dump_at(int nMax, int level) {
+    CCVFSTraceEvent *aEvent;
+    int n = ccvfs_trace_snapshot(nMax, &aEvent);
+
+    for (int i = 0; i < n; i++) {
+        sqlite3_str *pStr = sqlite3_str_new(NULL);
+        char *zLine;
+
+        sqlite3_str_appendf(pStr, "trace ");
+        ccvfs_trace_format(pStr, &aEvent[i], aEvent[n - 1].timestamp_ns);
+        zLine = sqlite3_str_finish(pStr);
+        if (zLine) {
+            ccvfs_log_emit(level, zLine);
+            sqlite3_free(zLine);
+        }
+    }
+    sqlite3_free(aEvent);
+}
+
+void sqlite3_ccvfs_trace_dump(int nMax) {
+    ccvfs_trace_dump_at(nMax, CCVFS_LOG_INFO);
+}
+
+/*
+ * 生成文本报告：状态行加最新事件，每个事件一行（调用者用sqlite3_free释放）
+ * Build a text report: a status line and the latest events, one per line (caller frees with sqlite3_free)
+ */
+char *ccvfs_trace_report(int nMax) {
+    int flags = CCVFS_COUNTER_GET(ccvfs_trace_flags);
+    CCVFSTraceEvent *aEvent;
+    int n = ccvfs_trace_snapshot(nMax, &aEvent);
+    sqlite3_str *pStr = sqlite3_str_new(NULL);
+
+    sqlite3_str_appendf(pStr, "ccvfs_trace: %s, %llu events recorded\n",
+                        !(flags & CCVFS_TRACE_ON) ? "off" :
+                        (flags & CCVFS_TRACE_DUMP_ON_ERROR) ? "error" : "on",
+                        (unsigned long long)CCVFS_TRACE_LOAD_ACQUIRE(ccvfs_trace_head));
+    for (int i = 0; i < n; i++) {
+        ccvfs_trace_format(pStr, &aEvent[i], aEvent[n - 1].timestamp_ns);
+        sqlite3_str_appendf(pStr, "\n");
+    }
+    sqlite3_free(aEvent);
+    return sqlite3_str_finish(pStr);
+}
@@ -1,9 +1,25 @@
 #include "ccvfs_page.h"
 #include "ccvfs_utils.h"
+#include "ccvfs_io.h"
+#include "ccvfs_shm.h"
+#include "ccvfs_snapshot.h"
 
 // Forward declarations
 static sqlite3_int64 ccvfs_calculate_index_position(CCVFSFile *pFile);
 
+/*
+ * 递增索引代计数器并把本次修改的块掩码记录到文件头
+ * Bump the index generation and record the changed-block mask in the header
+ */
+static void ccvfs_publish_index_change(CCVFSFile *pFile) {
+    pFile->header.change_counter++;
+    memcpy(pFile->header.index_change_mask, pFile->index_dirty_blocks,
+           sizeof(pFile->header.index_change_mask));
+    memset(pFile->index_dirty_blocks, 0, sizeof(pFile->index_dirty_blocks));
+    pFile->index_generation = pFile->header.change_counter;
+    ccvfs_shm_publish_index(pFile);
+}
+
 /*
  * Load file header from disk
  */
@@ -118,6 +134,9 @@ int ccvfs_load_page_index(CCVFSFile *pFile) {
             return SQLITE_NOMEM;
         }
         memset(pFile->pPageIndex, 0, pFile->index_capacity * sizeof(CCVFSPageIndex));
+        memset(pFile->index_dirty_blocks, 0, sizeof(pFile->index_dirty_blocks));
+        memset(pFile->snapshot_dirty_blocks, 0xFF, sizeof(pFile->snapshot_dirty_blocks));
+        pFile->index_generation = pFile->header.change_counter;
         CCVFS_DEBUG("Initialized empty page index with capacity %u", pFile->index_capacity);
         return SQLITE_OK;
     }
@@ -149,6 +168,9 @@ int ccvfs_load_page_index(CCVFSFile *pFile) {
     }
     
     pFile->index_dirty = 0; // Just loaded, so it's not dirty
+    memset(pFile->index_dirty_blocks, 0, sizeof(pFile->index_dirty_blocks));
+    memset(pFile->snapshot_dirty_blocks, 0xFF, sizeof(pFile->snapshot_dirty_blocks));
+    pFile->index_generation = pFile->header.change_counter;
     
     CCVFS_DEBUG("Loaded page index: %d pages, capacity %u",
               pFile->header.total_pages, pFile->index_capacity);
@@ -213,17 +235,49 @@ int ccvfs_save_page_index(CCVFSFile *pFile) {
     }
     CCVFS_DEBUG("=== END MAPPING TABLE ===");
     
-    // Write page index to file
-    rc = pFile->pReal->pMethods->xWrite(pFile->pReal, pFile->pPageIndex,
-                                        index_size, pFile->header.index_table_offset);
-    if (rc != SQLITE_OK) {
-        CCVFS_ERROR("Failed to write page index to disk: %d", rc);
-        return rc;
+    // 如果没有块级脏标记（直接设置了index_dirty），保存整个索引
+    // Without block-level dirty bits (index_dirty set directly), save the whole index
+    if (!ccvfs_index_mask_any(pFile->index_dirty_blocks)) {
+        memset(pFile->index_dirty_blocks, 0xFF, sizeof(pFile->index_dirty_blocks));
     }
     
+    // 只写入被修改的索引块
+    // Write only the index blocks that were modified
+    uint32_t blocksWritten = 0;
+    for (uint32_t block = 0; block < CCVFS_INDEX_BLOCK_COUNT; block++) {
+        uint32_t firstPage = block * CCVFS_INDEX_BLOCK_PAGES;
+        if (firstPage >= pFile->header.total_pages) {
+            break;
+        }
+        if (!ccvfs_index_mask_test(pFile->index_dirty_blocks, block)) {
+            continue;
+        }
+        
+        uint32_t pageCount = pFile->header.total_pages - firstPage;
+        if (pageCount > CCVFS_INDEX_BLOCK_PAGES) {
+            pageCount = CCVFS_INDEX_BLOCK_PAGES;
+        }
+        
+        rc = pFile->pReal->pMethods->xWrite(pFile->pReal, &pFile->pPageIndex[firstPage],
+                                            pageCount * sizeof(CCVFSPageIndex),
+                                            pFile->header.index_table_offset +
+                                            (sqlite3_int64)firstPage * sizeof(CCVFSPageIndex));
+        if (rc != SQLITE_OK) {
+            CCVFS_ERROR("Failed to write page index block %u to disk: %d", block, rc);
+            return rc;
+        }
+        blocksWritten++;
+    }
+    
+    // 发布新的索引代：其他连接据此只重新加载变化的块
+    // Publish a new index generation so other connections reload only the changed blocks
+    ccvfs_publish_index_change(pFile);
+    
     // Mark as clean after successful save
     pFile->index_dirty = 0;
     
+    CCVFS_DEBUG("Saved %u dirty index blocks, generation now %u", 
+               blocksWritten, pFile->header.change_counter);
     CCVFS_DEBUG("Successfully saved page index: %d pages at offset %llu",
               pFile->header.total_pages, (unsigned long long)pFile->header.index_table_offset);
     return SQLITE_OK;
@@ -277,12 +331,6 @@ int ccvfs_init_header(CCVFSFile *pFile, CCVFS *pVfs) {
     pFile->total_allocated_space = 0;
     pFile->total_used_space = 0;
     pFile->fragmentation_score = 0;
-    pFile->space_reuse_count = 0;
-    pFile->space_expansion_count = 0;
-    pFile->new_allocation_count = 0;
-    pFile->hole_reclaim_count = 0;
-    pFile->best_fit_count = 0;
-    pFile->sequential_write_count = 0;
     pFile->last_written_page = UINT32_MAX;
     
     CCVFS_DEBUG("Initialized new CCVFS header with advanced space tracking");
@@ -296,6 +344,15 @@ int ccvfs_expand_page_index(CCVFSFile *pFile, uint32_t new_page_count) {
     CCVFSPageIndex *new_index;
     size_t new_size, old_capacity_size;
     
+    // 共享索引不能原地修改
+    // The shared index must not be modified in place
+    if (pFile->index_shared) {
+        int rc = ccvfs_shm_detach_index(pFile);
+        if (rc != SQLITE_OK) {
+            return rc;
+        }
+    }
+    
     CCVFS_DEBUG("=== EXPANDING PAGE INDEX ===");
     CCVFS_DEBUG("Current: total_pages=%u, capacity=%u, requesting=%u", 
                pFile->header.total_pages, pFile->index_capacity, new_page_count);
@@ -316,8 +373,8 @@ int ccvfs_expand_page_index(CCVFSFile *pFile, uint32_t new_page_count) {
         size_t new_size_used = new_page_count * sizeof(CCVFSPageIndex);
         memset((char*)pFile->pPageIndex + old_size, 0, new_size_used - old_size);
         
+        ccvfs_mark_index_range_dirty(pFile, pFile->header.total_pages, new_page_count);
         pFile->header.total_pages = new_page_count;
-        pFile->index_dirty = 1; // Mark as dirty since we're changing it
         
         CCVFS_DEBUG("Expanded page count to %u (within capacity %u)",
                   new_page_count, pFile->index_capacity);
@@ -358,8 +415,8 @@ int ccvfs_expand_page_index(CCVFSFile *pFile, uint32_t new_page_count) {
     
     pFile->pPageIndex = new_index;
     pFile->index_capacity = new_capacity;
+    ccvfs_mark_index_range_dirty(pFile, pFile->header.total_pages, new_page_count);
     pFile->header.total_pages = new_page_count;
-    pFile->index_dirty = 1; // Mark as dirty since we're changing it
     
     CCVFS_DEBUG("Successfully expanded page index: capacity=%u, active_pages=%u",
               new_capacity, new_page_count);
@@ -394,6 +451,11 @@ int ccvfs_force_save_page_index(CCVFSFile *pFile) {
         return rc;
     }
     
+    // 整个索引都已重写，所有块都视为已修改
+    // The whole index was rewritten, treat every block as changed
+    memset(pFile->index_dirty_blocks, 0xFF, sizeof(pFile->index_dirty_blocks));
+    ccvfs_publish_index_change(pFile);
+    
     // Mark as clean after successful save
     pFile->index_dirty = 0;
     
@@ -401,6 +463,190 @@ int ccvfs_force_save_page_index(CCVFSFile *pFile) {
     return SQLITE_OK;
 }
 
+/*
+ * 标记页面索引条目所在的块为脏（下次保存和下次发布快照时处理）
+ * Mark the index block holding pageNum as dirty (for the next save and the next snapshot)
+ */
+void ccvfs_mark_index_dirty(CCVFSFile *pFile, uint32_t pageNum) {
+    uint32_t block = pageNum / CCVFS_INDEX_BLOCK_PAGES;
+    if (block >= CCVFS_INDEX_BLOCK_COUNT) {
+        block = CCVFS_INDEX_BLOCK_COUNT - 1;
+    }
+    ccvfs_index_mask_set(pFile->index_dirty_blocks, block);
+    ccvfs_index_mask_set(pFile->snapshot_dirty_blocks, block);
+    pFile->index_dirty = 1;
+}
+
+/*
+ * 标记页面范围 [firstPage, endPage) 覆盖的索引块为脏
+ * Mark every index block covering pages [firstPage, endPage) as dirty
+ */
+void ccvfs_mark_index_range_dirty(CCVFSFile *pFile, uint32_t firstPage, uint32_t endPage) {
+    uint32_t page;
+    
+    for (page = firstPage; page < endPage; page += CCVFS_INDEX_BLOCK_PAGES) {
+        ccvfs_mark_index_dirty(pFile, page);
+    }
+    if (endPage > firstPage) {
+        ccvfs_mark_index_dirty(pFile, endPage - 1);
+    }
+}
+
+/*
+ * 检查其他连接是否修改了文件，并只重新加载变化的索引块
+ * 在获取SHARED锁时调用：重新读取文件头，比较索引代计数器。
+ * 如果只相差一代，按文件头中的块掩码增量加载；否则重新加载全部索引块。
+ * Check whether another connection changed the file and reload only the changed index blocks.
+ * Called when the SHARED lock is taken: re-read the header and compare the index generation.
+ * If exactly one generation behind, reload the blocks named in the header mask; otherwise reload all blocks.
+ */
+int ccvfs_refresh_page_index(CCVFSFile *pFile) {
+    CCVFSFileHeader diskHeader;
+    sqlite3_int64 fileSize;
+    int rc;
+    
+    if (!pFile->is_ccvfs_file || !pFile->header_loaded) {
+        return SQLITE_OK;
+    }
+    
+    // 本连接有尚未保存的修改，不能被磁盘内容覆盖
+    // This connection has unsaved changes that must not be overwritten
+    if (pFile->index_dirty) {
+        CCVFS_DEBUG("Index dirty, skipping refresh");
+        return SQLITE_OK;
+    }
+    
+    rc = pFile->pReal->pMethods->xFileSize(pFile->pReal, &fileSize);
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+    if (fileSize < CCVFS_HEADER_SIZE) {
+        return SQLITE_OK;  // Nothing published yet
+    }
+    
+    rc = pFile->pReal->pMethods->xRead(pFile->pReal, &diskHeader, CCVFS_HEADER_SIZE, 0);
+    if (rc != SQLITE_OK) {
+        CCVFS_ERROR("Failed to re-read file header: %d", rc);
+        return rc;
+    }
+    if (memcmp(diskHeader.magic, CCVFS_MAGIC, 8) != 0) {
+        return SQLITE_OK;
+    }
+    
+    // 启用共享索引时直接使用映射，只有映射正被其他进程更新时才退回私有索引
+    // With a shared index use the mapping; fall back to a private index only while another process updates it
+    if (pFile->pShm) {
+        uint32_t oldGeneration = pFile->index_generation;
+        rc = ccvfs_shm_attach_index(pFile, &diskHeader);
+        if (rc == SQLITE_OK && pFile->index_generation != oldGeneration) {
+            memset(pFile->snapshot_dirty_blocks, 0xFF, sizeof(pFile->snapshot_dirty_blocks));
+        }
+        if (rc != SQLITE_BUSY) {
+            return rc;
+        }
+        if (pFile->index_shared) {
+            pFile->pPageIndex = NULL;
+            pFile->index_shared = 0;
+        }
+    }
+    
+    // 索引尚未加载（例如在空文件上打开），直接完整加载
+    // Index never loaded (e.g. opened on an empty file), do a full load
+    if (!pFile->pPageIndex) {
+        pFile->header = diskHeader;
+        return ccvfs_load_page_index(pFile);
+    }
+    
+    if (diskHeader.change_counter == pFile->index_generation) {
+        // 索引未变化，但仍采用磁盘上的文件头（例如截断后的大小）
+        // Index unchanged, still adopt the on-disk header (e.g. size after truncate)
+        pFile->header = diskHeader;
+        return SQLITE_OK;
+    }
+    
+    int incremental = (diskHeader.change_counter == pFile->index_generation + 1);
+    uint32_t oldTotal = pFile->header.total_pages;
+    uint32_t newTotal = diskHeader.total_pages;
+    
+    if (newTotal > CCVFS_MAX_PAGES) {
+        CCVFS_ERROR("Invalid page count in header: %u", newTotal);
+        return SQLITE_CORRUPT;
+    }
+    
+    // 必要时扩展内存中的索引容量
+    // Grow in-memory index capacity if needed
+    if (newTotal > pFile->index_capacity) {
+        uint32_t newCapacity = newTotal + 16;
+        CCVFSPageIndex *pNew = (CCVFSPageIndex*)sqlite3_realloc(pFile->pPageIndex,
+                                                               newCapacity * sizeof(CCVFSPageIndex));
+        if (!pNew) {
+            CCVFS_ERROR("Failed to grow page index to %u entries", newCapacity);
+            return SQLITE_NOMEM;
+        }
+        memset(pNew + pFile->index_capacity, 0,
+               (newCapacity - pFile->index_capacity) * sizeof(CCVFSPageIndex));
+        pFile->pPageIndex = pNew;
+        pFile->index_capacity = newCapacity;
+    }
+    
+    uint32_t blocksReloaded = 0;
+    for (uint32_t block = 0; block < CCVFS_INDEX_BLOCK_COUNT; block++) {
+        uint32_t firstPage = block * CCVFS_INDEX_BLOCK_PAGES;
+        if (firstPage >= newTotal) {
+            break;
+        }
+        
+        uint32_t pageCount = newTotal - firstPage;
+        if (pageCount > CCVFS_INDEX_BLOCK_PAGES) {
+            pageCount = CCVFS_INDEX_BLOCK_PAGES;
+        }
+        
+        // 未变化且完全位于旧范围内的块可以跳过
+        // Blocks that did not change and lie within the old range can be skipped
+        if (incremental && firstPage + pageCount <= oldTotal &&
+            !ccvfs_index_mask_test(diskHeader.index_change_mask, block)) {
+            continue;
+        }
+        
+        rc = pFile->pReal->pMethods->xRead(pFile->pReal, &pFile->pPageIndex[firstPage],
+                                           pageCount * sizeof(CCVFSPageIndex),
+                                           diskHeader.index_table_offset +
+                                           (sqlite3_int64)firstPage * sizeof(CCVFSPageIndex));
+        if (rc != SQLITE_OK) {
+            CCVFS_ERROR("Failed to reload index block %u: %d", block, rc);
+            return rc;
+        }
+        
+        // 丢弃这些页面在写入缓冲区中已过期的干净副本
+        // Drop stale clean copies of these pages held in the write buffer
+        ccvfs_buffer_discard_clean(pFile, firstPage, firstPage + pageCount);
+        ccvfs_index_mask_set(pFile->snapshot_dirty_blocks, block);
+        blocksReloaded++;
+    }
+    
+    if (newTotal < oldTotal) {
+        memset(&pFile->pPageIndex[newTotal], 0, (oldTotal - newTotal) * sizeof(CCVFSPageIndex));
+        ccvfs_buffer_discard_clean(pFile, newTotal, oldTotal);
+    }
+    
+    pFile->header = diskHeader;
+    pFile->index_generation = diskHeader.change_counter;
+    
+    // 空洞列表只在本连接内跟踪，其他连接可能已经重用了这些空间
+    // The hole list is tracked per connection; another connection may have reused that space
+    if (pFile->hole_manager.enabled) {
+        sqlite3_mutex_enter(pFile->alloc_mutex);
+        ccvfs_snapshot_forget_deferred(pFile);
+        ccvfs_cleanup_hole_manager(pFile);
+        ccvfs_init_hole_manager(pFile);
+        sqlite3_mutex_leave(pFile->alloc_mutex);
+    }
+    
+    CCVFS_DEBUG("Index refreshed to generation %u: %u blocks reloaded (%s)",
+               pFile->index_generation, blocksReloaded, incremental ? "incremental" : "full");
+    return SQLITE_OK;
+}
+
 /*
  * Calculate optimal position for index table
  */
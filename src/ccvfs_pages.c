@@ -0,0 +1,490 @@
+#include "ccvfs_internal.h"
+#include "ccvfs_io.h"
+#include "ccvfs_sync.h"
+
+/*
+ * ccvfs_pages 虚拟表
+ * 每个逻辑页一行：物理偏移、压缩前后大小、标志、校验和，以及从dbstat得到的所属b-tree。
+ * 这是一个同名（eponymous）只读表，不需要CREATE VIRTUAL TABLE：
+ *
+ *   SELECT name, count(*), sum(compressed_size), sum(original_size)
+ *     FROM ccvfs_pages GROUP BY name;
+ *   SELECT * FROM ccvfs_pages('aux') WHERE sparse;
+ *
+ * pageno以CCVFS页为单位（从1开始）；只有CCVFS页面大小等于SQLite页面大小时才与dbstat.pageno相同。
+ * 行内容是执行查询时索引的副本；仍在写入缓冲区中的页面显示其上次写出的位置。
+ * 只有用到name或pagetype列时才扫描dbstat；对pageno的等值约束只复制一个索引条目，
+ * 因此与dbstat按pageno连接时不会为每一行复制整个索引。
+ *
+ * ccvfs_pages virtual table
+ * One row per logical page: physical offset, compressed and original size, flags, checksum,
+ * and the owning b-tree from dbstat. This is an eponymous read-only table, no
+ * CREATE VIRTUAL TABLE needed (see the queries above).
+ * pageno counts CCVFS pages from 1; it equals dbstat.pageno only when the CCVFS page size
+ * (page_size column) equals the SQLite page size.
+ * Rows are a copy of the index taken when the query runs; pages still in the write buffer
+ * show where they were last written. dbstat is only scanned when the name or pagetype
+ * column is used; an equality constraint on pageno copies a single index entry, so joining
+ * with dbstat on pageno does not copy the whole index for every row.
+ */
+
+#define CCVFS_PAGES_SCHEMA \
+    "CREATE TABLE x(pageno INTEGER, physical_offset INTEGER, compressed_size INTEGER, " \
+    "original_size INTEGER, flags INTEGER, checksum INTEGER, compressed INTEGER, " \
+    "encrypted INTEGER, sparse INTEGER, compress_level INTEGER, page_size INTEGER, name TEXT, " \
+    "pagetype TEXT, schema TEXT HIDDEN)"
+
+enum {
+    CCVFS_PAGES_PAGENO,
+    CCVFS_PAGES_PHYSICAL_OFFSET,
+    CCVFS_PAGES_COMPRESSED_SIZE,
+    CCVFS_PAGES_ORIGINAL_SIZE,
+    CCVFS_PAGES_FLAGS,
+    CCVFS_PAGES_CHECKSUM,
+    CCVFS_PAGES_COMPRESSED,
+    CCVFS_PAGES_ENCRYPTED,
+    CCVFS_PAGES_SPARSE,
+    CCVFS_PAGES_COMPRESS_LEVEL,
+    CCVFS_PAGES_PAGE_SIZE,
+    CCVFS_PAGES_NAME,
+    CCVFS_PAGES_PAGETYPE,
+    CCVFS_PAGES_SCHEMA_COLUMN
+};
+
+// idxNum bits chosen by xBestIndex
+#define CCVFS_PAGES_IDX_SCHEMA  0x01  // argv carries the schema name
+#define CCVFS_PAGES_IDX_PAGENO  0x02  // argv carries one page number
+#define CCVFS_PAGES_IDX_OWNERS  0x04  // name or pagetype is used, scan dbstat
+
+typedef struct CCVFSPagesTable {
+    sqlite3_vtab base;
+    sqlite3 *db;
+} CCVFSPagesTable;
+
+typedef struct CCVFSPagesCursor {
+    sqlite3_vtab_cursor base;
+    char *zSchema; // Schema being listed (列出的数据库)
+    CCVFSPageIndex *aEntry; // Copy of the index entries (索引条目副本)
+    uint32_t nEntry; // Entries in aEntry (条目数)
+    uint32_t firstPage; // Page number of aEntry[0], 0-based (第一个条目的页号)
+    uint32_t iEntry; // Current entry (当前条目)
+    uint32_t pageSize; // CCVFS page size (CCVFS页面大小)
+    uint32_t *aOwner; // Per entry: index into azName plus one, 0 if unknown (所属b-tree)
+    uint8_t *aType; // Per entry: index into ccvfs_page_types (页面类型)
+    char **azName; // Distinct b-tree names (不同的b-tree名称)
+    uint32_t nName; // Entries in azName (名称数)
+} CCVFSPagesCursor;
+
+static const char *const ccvfs_page_types[] = { NULL, "internal", "leaf", "overflow" };
+
+static int ccvfsPagesConnect(sqlite3 *db, void *pAux, int argc, const char *const *argv,
+                             sqlite3_vtab **ppVtab, char **pzErr) {
+    CCVFSPagesTable *pTab;
+    int rc;
+
+    (void)pAux; (void)argc; (void)argv; (void)pzErr;
+    rc = sqlite3_declare_vtab(db, CCVFS_PAGES_SCHEMA);
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+    pTab = (CCVFSPagesTable*)sqlite3_malloc(sizeof(CCVFSPagesTable));
+    if (!pTab) {
+        return SQLITE_NOMEM;
+    }
+    memset(pTab, 0, sizeof(CCVFSPagesTable));
+    pTab->db = db;
+    sqlite3_vtab_config(db, SQLITE_VTAB_DIRECTONLY);
+    *ppVtab = &pTab->base;
+    return SQLITE_OK;
+}
+
+static int ccvfsPagesDisconnect(sqlite3_vtab *pVtab) {
+    sqlite3_free(pVtab);
+    return SQLITE_OK;
+}
+
+static int ccvfsPagesBestIndex(sqlite3_vtab *pVtab, sqlite3_index_info *pInfo) {
+    int iSchema = -1, iPageno = -1;
+    int idxNum = 0, nArg = 0;
+
+    (void)pVtab;
+    for (int i = 0; i < pInfo->nConstraint; i++) {
+        const struct sqlite3_index_constraint *pCons = &pInfo->aConstraint[i];
+        if (pCons->op != SQLITE_INDEX_CONSTRAINT_EQ) {
+            continue;
+        }
+        if (pCons->iColumn == CCVFS_PAGES_SCHEMA_COLUMN) {
+            // 无法使用的schema约束意味着该计划不可行
+            // An unusable schema constraint makes this plan impossible
+            if (!pCons->usable) {
+                return SQLITE_CONSTRAINT;
+            }
+            iSchema = i;
+        } else if (pCons->iColumn == CCVFS_PAGES_PAGENO && pCons->usable) {
+            iPageno = i;
+        }
+    }
+
+    if (iSchema >= 0) {
+        pInfo->aConstraintUsage[iSchema].argvIndex = ++nArg;
+        pInfo->aConstraintUsage[iSchema].omit = 1;
+        idxNum |= CCVFS_PAGES_IDX_SCHEMA;
+    }
+    if (iPageno >= 0) {
+        pInfo->aConstraintUsage[iPageno].argvIndex = ++nArg;
+        pInfo->aConstraintUsage[iPageno].omit = 1;
+        idxNum |= CCVFS_PAGES_IDX_PAGENO;
+        pInfo->estimatedCost = 10.0;
+        pInfo->estimatedRows = 1;
+        pInfo->idxFlags = SQLITE_INDEX_SCAN_UNIQUE;
+    } else {
+        pInfo->estimatedCost = 100000.0;
+        pInfo->estimatedRows = 100000;
+    }
+    if (pInfo->colUsed & (((sqlite3_uint64)1 << CCVFS_PAGES_NAME) | ((sqlite3_uint64)1 << CCVFS_PAGES_PAGETYPE))) {
+        idxNum |= CCVFS_PAGES_IDX_OWNERS;
+        pInfo->estimatedCost *= 4;
+    }
+
+    // 行按pageno递增输出
+    // Rows come out in increasing pageno order
+    if (pInfo->nOrderBy == 1 && pInfo->aOrderBy[0].iColumn == CCVFS_PAGES_PAGENO && !pInfo->aOrderBy[0].desc) {
+        pInfo->orderByConsumed = 1;
+    }
+    pInfo->idxNum = idxNum;
+    return SQLITE_OK;
+}
+
+static int ccvfsPagesOpen(sqlite3_vtab *pVtab, sqlite3_vtab_cursor **ppCursor) {
+    CCVFSPagesCursor *pCur;
+
+    (void)pVtab;
+    pCur = (CCVFSPagesCursor*)sqlite3_malloc(sizeof(CCVFSPagesCursor));
+    if (!pCur) {
+        return SQLITE_NOMEM;
+    }
+    memset(pCur, 0, sizeof(CCVFSPagesCursor));
+    *ppCursor = &pCur->base;
+    return SQLITE_OK;
+}
+
+static void ccvfsPagesReset(CCVFSPagesCursor *pCur) {
+    for (uint32_t i = 0; i < pCur->nName; i++) {
+        sqlite3_free(pCur->azName[i]);
+    }
+    sqlite3_free(pCur->azName);
+    sqlite3_free(pCur->aOwner);
+    sqlite3_free(pCur->aType);
+    sqlite3_free(pCur->aEntry);
+    sqlite3_free(pCur->zSchema);
+    pCur->azName = NULL;
+    pCur->nName = 0;
+    pCur->aOwner = NULL;
+    pCur->aType = NULL;
+    pCur->aEntry = NULL;
+    pCur->nEntry = 0;
+    pCur->firstPage = 0;
+    pCur->iEntry = 0;
+    pCur->zSchema = NULL;
+}
+
+static int ccvfsPagesClose(sqlite3_vtab_cursor *pCursor) {
+    CCVFSPagesCursor *pCur = (CCVFSPagesCursor*)pCursor;
+
+    ccvfsPagesReset(pCur);
+    sqlite3_free(pCur);
+    return SQLITE_OK;
+}
+
+/*
+ * 复制索引条目：全部有效页，或pageno约束指定的一页（pageno从1开始）
+ * Copy index entries: every valid page, or the one page named by a pageno constraint (pageno is 1-based)
+ */
+static int ccvfsPagesCopyIndex(CCVFSPagesCursor *pCur, CCVFSFile *pFile, int hasPageno, sqlite3_int64 pageno) {
+    uint32_t nPages, first = 0, count;
+
+    ccvfs_rwlock_read_enter(&pFile->index_lock);
+    nPages = pFile->header.total_pages < pFile->header.database_size_pages ?
+             pFile->header.total_pages : pFile->header.database_size_pages;
+    count = nPages;
+    if (hasPageno) {
+        if (pageno >= 1 && pageno <= (sqlite3_int64)nPages) {
+            first = (uint32_t)(pageno - 1);
+            count = 1;
+        } else {
+            count = 0;
+        }
+    }
+    if (count > 0 && pFile->pPageIndex) {
+        pCur->aEntry = (CCVFSPageIndex*)sqlite3_malloc64((sqlite3_uint64)count * sizeof(CCVFSPageIndex));
+        if (!pCur->aEntry) {
+            ccvfs_rwlock_read_leave(&pFile->index_lock);
+            return SQLITE_NOMEM;
+        }
+        memcpy(pCur->aEntry, &pFile->pPageIndex[first], (size_t)count * sizeof(CCVFSPageIndex));
+        pCur->nEntry = count;
+        pCur->firstPage = first;
+    }
+    pCur->pageSize = pFile->header.page_size ? pFile->header.page_size : CCVFS_DEFAULT_PAGE_SIZE;
+    ccvfs_rwlock_read_leave(&pFile->index_lock);
+    return SQLITE_OK;
+}
+
+/*
+ * 通过dbstat确定每个CCVFS页所属的b-tree；SQLite页面大小与CCVFS页面大小不同时，
+ * CCVFS页归属于包含其第一个字节的SQLite页。没有编译dbstat时名称保持为NULL。
+ * Find the b-tree owning every CCVFS page through dbstat; when the SQLite page size differs
+ * from the CCVFS page size, a CCVFS page belongs to the SQLite page holding its first byte.
+ * Names stay NULL when dbstat is not compiled in.
+ */
+static int ccvfsPagesLoadOwners(CCVFSPagesCursor *pCur, sqlite3 *db) {
+    sqlite3_stmt *pStmt = NULL;
+    uint32_t nAlloc = 0;
+    int rc;
+
+    if (pCur->nEntry == 0) {
+        return SQLITE_OK;
+    }
+    pCur->aOwner = (uint32_t*)sqlite3_malloc64((sqlite3_uint64)pCur->nEntry * sizeof(uint32_t));
+    pCur->aType = (uint8_t*)sqlite3_malloc64(pCur->nEntry);
+    if (!pCur->aOwner || !pCur->aType) {
+        return SQLITE_NOMEM;
+    }
+    memset(pCur->aOwner, 0, (size_t)pCur->nEntry * sizeof(uint32_t));
+    memset(pCur->aType, 0, pCur->nEntry);
+
+    if (sqlite3_prepare_v2(db, "SELECT name, pagetype, pageno, pgsize FROM dbstat(?1)", -1,
+                           &pStmt, NULL) != SQLITE_OK) {
+        CCVFS_DEBUG("dbstat unavailable, ccvfs_pages.name stays NULL: %s", sqlite3_errmsg(db));
+        return SQLITE_OK;
+    }
+    sqlite3_bind_text(pStmt, 1, pCur->zSchema, -1, SQLITE_STATIC);
+
+    while ((rc = sqlite3_step(pStmt)) == SQLITE_ROW) {
+        const char *zName = (const char*)sqlite3_column_text(pStmt, 0);
+        const char *zType = (const char*)sqlite3_column_text(pStmt, 1);
+        sqlite3_int64 pgno = sqlite3_column_int64(pStmt, 2);
+        sqlite3_int64 pgsize = sqlite3_column_int64(pStmt, 3);
+        sqlite3_int64 firstByte, lastByte, lo, hi;
+        uint8_t type = 0;
+
+        if (!zName || pgno < 1 || pgsize <= 0) {
+            continue;
+        }
+        firstByte = (pgno - 1) * pgsize;
+        lastByte = pgno * pgsize - 1;
+        lo = (firstByte + pCur->pageSize - 1) / pCur->pageSize;
+        hi = lastByte / pCur->pageSize;
+        if (lo < pCur->firstPage) lo = pCur->firstPage;
+        if (hi >= (sqlite3_int64)pCur->firstPage + pCur->nEntry) hi = (sqlite3_int64)pCur->firstPage + pCur->nEntry - 1;
+        if (lo > hi) {
+            continue;
+        }
+
+        // dbstat按b-tree顺序输出，相同名称连续出现
+        // dbstat walks one b-tree at a time, so equal names come in runs
+        if (pCur->nName == 0 || strcmp(pCur->azName[pCur->nName - 1], zName) != 0) {
+            if (pCur->nName == nAlloc) {
+                uint32_t nNew = nAlloc ? nAlloc * 2 : 16;
+                char **azNew = (char**)sqlite3_realloc64(pCur->azName, (sqlite3_uint64)nNew * sizeof(char*));
+                if (!azNew) {
+                    rc = SQLITE_NOMEM;
+                    break;
+                }
+                pCur->azName = azNew;
+                nAlloc = nNew;
+            }
+            pCur->azName[pCur->nName] = sqlite3_mprintf("%s", zName);
+            if (!pCur->azName[pCur->nName]) {
+                rc = SQLITE_NOMEM;
+                break;
+            }
+            pCur->nName++;
+        }
+        if (zType) {
+            for (uint8_t t = 1; t < sizeof(ccvfs_page_types) / sizeof(ccvfs_page_types[0]); t++) {
+                if (strcmp(zType, ccvfs_page_types[t]) == 0) {
+                    type = t;
+                    break;
+                }
+            }
+        }
+        for (sqlite3_int64 i = lo; i <= hi; i++) {
+            uint32_t slot = (uint32_t)(i - pCur->firstPage);
+            if (pCur->aOwner[slot] == 0) {
+                pCur->aOwner[slot] = pCur->nName;
+                pCur->aType[slot] = type;
+            }
+        }
+    }
+    sqlite3_finalize(pStmt);
+    return rc == SQLITE_DONE ? SQLITE_OK : rc;
+}
+
+static int ccvfsPagesFilter(sqlite3_vtab_cursor *pCursor, int idxNum, const char *idxStr,
+                            int argc, sqlite3_value **argv) {
+    CCVFSPagesCursor *pCur = (CCVFSPagesCursor*)pCursor;
+    CCVFSPagesTable *pTab = (CCVFSPagesTable*)pCursor->pVtab;
+    sqlite3_file *pFile = NULL;
+    const char *zSchema = "main";
+    sqlite3_int64 pageno = 0;
+    int iArg = 0;
+    int rc;
+
+    (void)idxStr; (void)argc;
+    ccvfsPagesReset(pCur);
+
+    if (idxNum & CCVFS_PAGES_IDX_SCHEMA) {
+        const char *zArg = (const char*)sqlite3_value_text(argv[iArg++]);
+        if (zArg) {
+            zSchema = zArg;
+        }
+    }
+    if (idxNum & CCVFS_PAGES_IDX_PAGENO) {
+        pageno = sqlite3_value_int64(argv[iArg++]);
+    }
+
+    pCur->zSchema = sqlite3_mprintf("%s", zSchema);
+    if (!pCur->zSchema) {
+        return SQLITE_NOMEM;
+    }
+    if (sqlite3_file_control(pTab->db, zSchema, SQLITE_FCNTL_FILE_POINTER, &pFile) != SQLITE_OK) {
+        sqlite3_free(pTab->base.zErrMsg);
+        pTab->base.zErrMsg = sqlite3_mprintf("no such schema: %s", zSchema);
+        return SQLITE_ERROR;
+    }
+
+    // 不是通过CCVFS打开的数据库没有页索引，返回空结果
+    // Databases not opened through CCVFS have no page index and produce no rows
+    if (!pFile || pFile->pMethods != &ccvfsIoMethods || !((CCVFSFile*)pFile)->is_ccvfs_file) {
+        return SQLITE_OK;
+    }
+
+    rc = ccvfsPagesCopyIndex(pCur, (CCVFSFile*)pFile, (idxNum & CCVFS_PAGES_IDX_PAGENO) != 0, pageno);
+    if (rc == SQLITE_OK && (idxNum & CCVFS_PAGES_IDX_OWNERS)) {
+        rc = ccvfsPagesLoadOwners(pCur, pTab->db);
+    }
+    return rc;
+}
+
+static int ccvfsPagesNext(sqlite3_vtab_cursor *pCursor) {
+    ((CCVFSPagesCursor*)pCursor)->iEntry++;
+    return SQLITE_OK;
+}
+
+static int ccvfsPagesEof(sqlite3_vtab_cursor *pCursor) {
+    CCVFSPagesCursor *pCur = (CCVFSPagesCursor*)pCursor;
+
+    return pCur->iEntry >= pCur->nEntry;
+}
+
+static int ccvfsPagesColumn(sqlite3_vtab_cursor *pCursor, sqlite3_context *ctx, int iCol) {
+    CCVFSPagesCursor *pCur = (CCVFSPagesCursor*)pCursor;
+    const CCVFSPageIndex *pEntry = &pCur->aEntry[pCur->iEntry];
+    int sparse = pEntry->physical_offset == 0 || (pEntry->flags & CCVFS_PAGE_SPARSE);
+
+    switch (iCol) {
+        case CCVFS_PAGES_PAGENO:
+            sqlite3_result_int64(ctx, (sqlite3_int64)pCur->firstPage + pCur->iEntry + 1);
+            break;
+        case CCVFS_PAGES_PHYSICAL_OFFSET:
+            sqlite3_result_int64(ctx, (sqlite3_int64)pEntry->physical_offset);
+            break;
+        case CCVFS_PAGES_COMPRESSED_SIZE:
+            sqlite3_result_int64(ctx, pEntry->compressed_size);
+            break;
+        case CCVFS_PAGES_ORIGINAL_SIZE:
+            sqlite3_result_int64(ctx, pEntry->original_size);
+            break;
+        case CCVFS_PAGES_FLAGS:
+            sqlite3_result_int64(ctx, pEntry->flags);
+            break;
+        case CCVFS_PAGES_CHECKSUM:
+            sqlite3_result_int64(ctx, pEntry->checksum);
+            break;
+        case CCVFS_PAGES_COMPRESSED:
+            sqlite3_result_int(ctx, (pEntry->flags & CCVFS_PAGE_COMPRESSED) != 0);
+            break;
+        case CCVFS_PAGES_ENCRYPTED:
+            sqlite3_result_int(ctx, (pEntry->flags & CCVFS_PAGE_ENCRYPTED) != 0);
+            break;
+        case CCVFS_PAGES_SPARSE:
+            sqlite3_result_int(ctx, sparse);
+            break;
+        case CCVFS_PAGES_COMPRESS_LEVEL:
+            // 旧文件的页面没有记录级别
+            // Pages of older files carry no level
+            if ((pEntry->flags & CCVFS_PAGE_COMPRESSED) && (pEntry->flags & CCVFS_COMPRESSION_LEVEL_MASK)) {
+                sqlite3_result_int(ctx, (int)((pEntry->flags & CCVFS_COMPRESSION_LEVEL_MASK) >>
+                                              CCVFS_COMPRESSION_LEVEL_SHIFT));
+            }
+            break;
+        case CCVFS_PAGES_PAGE_SIZE:
+            sqlite3_result_int64(ctx, pCur->pageSize);
+            break;
+        case CCVFS_PAGES_NAME:
+            if (pCur->aOwner && pCur->aOwner[pCur->iEntry]) {
+                sqlite3_result_text(ctx, pCur->azName[pCur->aOwner[pCur->iEntry] - 1], -1, SQLITE_TRANSIENT);
+            }
+            break;
+        case CCVFS_PAGES_PAGETYPE:
+            if (pCur->aType && pCur->aType[pCur->iEntry]) {
+                sqlite3_result_text(ctx, ccvfs_page_types[pCur->aType[pCur->iEntry]], -1, SQLITE_STATIC);
+            }
+            break;
+        case CCVFS_PAGES_SCHEMA_COLUMN:
+            sqlite3_result_text(ctx, pCur->zSchema, -1, SQLITE_TRANSIENT);
+            break;
+    }
+    return SQLITE_OK;
+}
+
+static int ccvfsPagesRowid(sqlite3_vtab_cursor *pCursor, sqlite3_int64 *pRowid) {
+    CCVFSPagesCursor *pCur = (CCVFSPagesCursor*)pCursor;
+
+    *pRowid = (sqlite3_int64)pCur->firstPage + pCur->iEntry + 1;
+    return SQLITE_OK;
+}
+
+static sqlite3_module ccvfsPagesModule = {
+    0,                     /* iVersion */
+    0,                     /* xCreate - eponymous only */
+    ccvfsPagesConnect,     /* xConnect */
+    ccvfsPagesBestIndex,   /* xBestIndex */
+    ccvfsPagesDisconnect,  /* xDisconnect */
+    0,                     /* xDestroy */
+    ccvfsPagesOpen,        /* xOpen */
+    ccvfsPagesClose,       /* xClose */
+    ccvfsPagesFilter,      /* xFilter */
+    ccvfsPagesNext,        /* xNext */
+    ccvfsPagesEof,         /* xEof */
+    ccvfsPagesColumn,      /* xColumn */
+    ccvfsPagesRowid,       /* xRowid */
+    0,                     /* xUpdate */
+    0,                     /* xBegin */
+    0,                     /* xSync */
+    0,                     /* xCommit */
+    0,                     /* xRollback */
+    0,                     /* xFindFunction */
+    0,                     /* xRename */
+    0,                     /* xSavepoint */
+    0,                     /* xRelease */
+    0,                     /* xRollbackTo */
+    0,                     /* xShadowName */
+    0                      /* xIntegrity */
+};
+
+/*
+ * 在连接上注册ccvfs_pages虚拟表
+ * Register the ccvfs_pages virtual table on a connection
+ */
+int sqlite3_ccvfs_pages_init(sqlite3 *db, char **pzErrMsg, const struct sqlite3_api_routines *pApi) {
+    int rc;
+
+    (void)pApi;
+    rc = sqlite3_create_module(db, "ccvfs_pages", &ccvfsPagesModule, NULL);
+    if (rc != SQLITE_OK && pzErrMsg) {
+        *pzErrMsg = sqlite3_mprintf("failed to register ccvfs_pages: %s", sqlite3_errmsg(db));
+    }
+    return rc;
+}
@@ -0,0 +1,490 @@
+#include "ccvfs_pragma.h"
+#include "ccvfs_io.h"
+#include "ccvfs_utils.h"
+#include "ccvfs_snapshot.h"
+#include "ccvfs_stats.h"
+#include "ccvfs_latency.h"
+#include "ccvfs_log.h"
+#include "ccvfs_record.h"
+#include <errno.h>
+
+/*
+ * CCVFS专用PRAGMA
+ * 通过SQLITE_FCNTL_PRAGMA处理，因此任何SQLite客户端（包括shell）都能在运行中的数据库上
+ * 查看统计、调整单个数据库的设置并执行维护操作。设置只作用于当前连接打开的文件，
+ * 不会修改VFS的默认值，也不会写入数据库文件。
+ *
+ * CCVFS specific PRAGMAs
+ * Handled through SQLITE_FCNTL_PRAGMA, so any SQLite client (the shell included) can inspect
+ * statistics, tune a single database and run maintenance on a live database. Settings only
+ * apply to the file opened by this connection; they neither change the VFS defaults nor
+ * get written to the database file.
+ *
+ *   PRAGMA ccvfs_stats [= FILE | VFS]           counters of this file or of the whole VFS
+ *   PRAGMA ccvfs_cache_size [= N]                pages held in the write buffer
+ *   PRAGMA ccvfs_write_buffer [= ON | OFF]       write buffering
+ *   PRAGMA ccvfs_compress_level [= N]            level used for pages written from now on
+ *   PRAGMA ccvfs_flush                           write out buffered pages
+ *   PRAGMA ccvfs_compact                         move pages to the front and truncate the file
+ *   PRAGMA ccvfs_histograms [= ON | OFF | RESET] per-stage latency histograms
+ *   PRAGMA ccvfs_log_level [= LEVEL]             process-wide log level (OFF, ERROR, INFO, DEBUG, VERBOSE)
+ *   PRAGMA ccvfs_trace [= ON | OFF | ERROR]      process-wide page event ring, ERROR also dumps it after errors
+ *   PRAGMA ccvfs_record [= 'PATH' | OFF]         record the I/O of the whole VFS to a trace file (db_tool replay)
+ */
+
+#define CCVFS_PRAGMA_TRACE_EVENTS 64  // Events listed by PRAGMA ccvfs_trace
+
+typedef int (*CCVFSPragmaHandler)(CCVFSFile *pFile, const char *zValue, char **pzResult);
+
+/*
+ * 解析布尔值，无法识别时返回-1
+ * Parse a boolean value, -1 if it is not recognised
+ */
+static int ccvfs_pragma_bool(const char *zValue) {
+    if (sqlite3_stricmp(zValue, "on") == 0 || sqlite3_stricmp(zValue, "1") == 0 ||
+        sqlite3_stricmp(zValue, "true") == 0 || sqlite3_stricmp(zValue, "yes") == 0) {
+        return 1;
+    }
+    if (sqlite3_stricmp(zValue, "off") == 0 || sqlite3_stricmp(zValue, "0") == 0 ||
+        sqlite3_stricmp(zValue, "false") == 0 || sqlite3_stricmp(zValue, "no") == 0) {
+        return 0;
+    }
+    return -1;
+}
+
+/*
+ * 解析[min, max]范围内的整数
+ * Parse an integer in [min, max]
+ */
+static int ccvfs_pragma_int(const char *zValue, long min, long max, long *pOut) {
+    char *zEnd;
+    long value;
+
+    errno = 0;
+    value = strtol(zValue, &zEnd, 10);
+    if (zEnd == zValue || *zEnd != '\0' || errno != 0 || value < min || value > max) {
+        return 0;
+    }
+    *pOut = value;
+    return 1;
+}
+
+/*
+ * 刷新写入缓冲区并发布新索引快照，返回写出的页数（调用者持有索引写锁）
+ * Flush the write buffer and publish a new index snapshot, returns the pages written (caller holds the index write lock)
+ */
+static int ccvfs_pragma_flush_buffer(CCVFSFile *pFile, uint32_t *pFlushed) {
+    int rc = SQLITE_OK;
+
+    *pFlushed = 0;
+    for (CCVFSBufferEntry *pEntry = pFile->write_buffer.entries; pEntry; pEntry = pEntry->next) {
+        if (pEntry->is_dirty) {
+            (*pFlushed)++;
+        }
+    }
+    if (pFile->write_buffer.entry_count > 0) {
+        rc = ccvfs_flush_write_buffer(pFile);
+        ccvfs_snapshot_publish(pFile);
+    }
+    return rc;
+}
+
+/*
+ * PRAGMA ccvfs_stats [= FILE | VFS]
+ */
+static int ccvfs_pragma_stats(CCVFSFile *pFile, const char *zValue, char **pzResult) {
+    CCVFSFileStats stats;
+    CCVFSSpaceStats space;
+    sqlite3_str *pStr;
+    int vfsScope = 0;
+
+    if (zValue) {
+        if (sqlite3_stricmp(zValue, "vfs") == 0) {
+            vfsScope = 1;
+        } else if (sqlite3_stricmp(zValue, "file") != 0) {
+            *pzResult = sqlite3_mprintf("ccvfs_stats: expected FILE or VFS, got '%s'", zValue);
+            return SQLITE_ERROR;
+        }
+    }
+
+    pStr = sqlite3_str_new(NULL);
+    if (vfsScope) {
+        ccvfs_stats_collect_vfs(pFile->pOwner, &stats);
+        sqlite3_str_appendf(pStr, "ccvfs_stats: vfs %s\n", pFile->pOwner->base.zName);
+    } else {
+        sqlite3_int64 fileSize = 0;
+        uint32_t databasePages, bufferedPages, holes;
+
+        ccvfs_stats_collect(pFile, &stats);
+        ccvfs_get_space_stats((sqlite3_file*)pFile, &space);
+        pFile->pReal->pMethods->xFileSize(pFile->pReal, &fileSize);
+
+        ccvfs_rwlock_read_enter(&pFile->index_lock);
+        sqlite3_mutex_enter(pFile->alloc_mutex);
+        databasePages = pFile->header.database_size_pages;
+        bufferedPages = pFile->write_buffer.entry_count;
+        holes = pFile->hole_manager.hole_count;
+        sqlite3_mutex_leave(pFile->alloc_mutex);
+        ccvfs_rwlock_read_leave(&pFile->index_lock);
+
+        sqlite3_str_appendf(pStr, "ccvfs_stats: file %s\n", pFile->filename ? pFile->filename : "(unknown)");
+        sqlite3_str_appendf(pStr, "%-26s %u\n", "database_pages", databasePages);
+        sqlite3_str_appendf(pStr, "%-26s %lld\n", "file_size_bytes", fileSize);
+        sqlite3_str_appendf(pStr, "%-26s %llu\n", "allocated_bytes",
+                            (unsigned long long)space.total_allocated_space);
+        sqlite3_str_appendf(pStr, "%-26s %u\n", "fragmentation_score", space.fragmentation_score);
+        sqlite3_str_appendf(pStr, "%-26s %u\n", "tracked_holes", holes);
+        sqlite3_str_appendf(pStr, "%-26s %u\n", "buffered_pages", bufferedPages);
+        sqlite3_str_appendf(pStr, "%-26s %d\n", "compress_level", pFile->compress_level);
+    }
+
+#define CCVFS_PRAGMA_COUNTER(name) \
+    sqlite3_str_appendf(pStr, "%-26s %llu\n", #name, (unsigned long long)stats.name)
+    sqlite3_str_appendf(pStr, "%-26s %u\n", "open_files", stats.open_files);
+    CCVFS_PRAGMA_COUNTER(space_reuse_count);
+    CCVFS_PRAGMA_COUNTER(space_expansion_count);
+    CCVFS_PRAGMA_COUNTER(new_allocation_count);
+    CCVFS_PRAGMA_COUNTER(hole_reclaim_count);
+    CCVFS_PRAGMA_COUNTER(best_fit_count);
+    CCVFS_PRAGMA_COUNTER(sequential_write_count);
+    CCVFS_PRAGMA_COUNTER(cow_relocation_count);
+    CCVFS_PRAGMA_COUNTER(hole_allocation_count);
+    CCVFS_PRAGMA_COUNTER(hole_merge_count);
+    CCVFS_PRAGMA_COUNTER(hole_cleanup_count);
+    CCVFS_PRAGMA_COUNTER(buffer_hit_count);
+    CCVFS_PRAGMA_COUNTER(buffer_flush_count);
+    CCVFS_PRAGMA_COUNTER(buffer_merge_count);
+    CCVFS_PRAGMA_COUNTER(total_buffered_writes);
+    CCVFS_PRAGMA_COUNTER(checksum_error_count);
+    CCVFS_PRAGMA_COUNTER(corrupted_page_count);
+    CCVFS_PRAGMA_COUNTER(recovery_attempt_count);
+    CCVFS_PRAGMA_COUNTER(successful_recovery_count);
+    CCVFS_PRAGMA_COUNTER(scrubbed_block_count);
+    CCVFS_PRAGMA_COUNTER(scrubbed_bytes);
+    CCVFS_PRAGMA_COUNTER(scrub_pass_count);
+    CCVFS_PRAGMA_COUNTER(trusted_read_count);
+#undef CCVFS_PRAGMA_COUNTER
+
+    *pzResult = sqlite3_str_finish(pStr);
+    return SQLITE_OK;
+}
+
+/*
+ * PRAGMA ccvfs_cache_size [= N]
+ * 写入缓冲区可容纳的页数；缩小到已缓冲的页数以下时先刷新
+ * Pages the write buffer can hold; shrinking below the pages already buffered flushes first
+ */
+static int ccvfs_pragma_cache_size(CCVFSFile *pFile, const char *zValue, char **pzResult) {
+    int rc = SQLITE_OK;
+    uint32_t maxEntries;
+
+    if (zValue) {
+        long value;
+        uint32_t flushed;
+
+        if (!ccvfs_pragma_int(zValue, CCVFS_MIN_BUFFER_ENTRIES, CCVFS_MAX_BUFFER_ENTRIES, &value)) {
+            *pzResult = sqlite3_mprintf("ccvfs_cache_size: expected %d..%d pages, got '%s'",
+                                        CCVFS_MIN_BUFFER_ENTRIES, CCVFS_MAX_BUFFER_ENTRIES, zValue);
+            return SQLITE_ERROR;
+        }
+        ccvfs_rwlock_write_enter(&pFile->index_lock);
+        if (pFile->write_buffer.entry_count > (uint32_t)value) {
+            rc = ccvfs_pragma_flush_buffer(pFile, &flushed);
+        }
+        if (rc == SQLITE_OK) {
+            pFile->write_buffer.max_entries = (uint32_t)value;
+        }
+        ccvfs_rwlock_write_leave(&pFile->index_lock);
+        if (rc != SQLITE_OK) {
+            *pzResult = sqlite3_mprintf("ccvfs_cache_size: flushing the write buffer failed (%d)", rc);
+            return rc;
+        }
+    }
+
+    ccvfs_rwlock_read_enter(&pFile->index_lock);
+    maxEntries = pFile->write_buffer.max_entries;
+    ccvfs_rwlock_read_leave(&pFile->index_lock);
+    *pzResult = sqlite3_mprintf("%u", maxEntries);
+    return SQLITE_OK;
+}
+
+/*
+ * PRAGMA ccvfs_write_buffer [= ON | OFF]
+ * 关闭时先写出已缓冲的页
+ * Switching it off writes out the buffered pages first
+ */
+static int ccvfs_pragma_write_buffer(CCVFSFile *pFile, const char *zValue, char **pzResult) {
+    int rc = SQLITE_OK;
+    int enabled;
+
+    if (zValue) {
+        uint32_t flushed;
+
+        enabled = ccvfs_pragma_bool(zValue);
+        if (enabled < 0) {
+            *pzResult = sqlite3_mprintf("ccvfs_write_buffer: expected ON or OFF, got '%s'", zValue);
+            return SQLITE_ERROR;
+        }
+        ccvfs_rwlock_write_enter(&pFile->index_lock);
+        if (!enabled) {
+            rc = ccvfs_pragma_flush_buffer(pFile, &flushed);
+        }
+        if (rc == SQLITE_OK) {
+            pFile->write_buffer.enabled = enabled;
+        }
+        ccvfs_rwlock_write_leave(&pFile->index_lock);
+        if (rc != SQLITE_OK) {
+            *pzResult = sqlite3_mprintf("ccvfs_write_buffer: flushing the write buffer failed (%d)", rc);
+            return rc;
+        }
+    }
+
+    ccvfs_rwlock_read_enter(&pFile->index_lock);
+    enabled = pFile->write_buffer.enabled;
+    ccvfs_rwlock_read_leave(&pFile->index_lock);
+    *pzResult = sqlite3_mprintf("%s", enabled ? "on" : "off");
+    return SQLITE_OK;
+}
+
+/*
+ * PRAGMA ccvfs_compress_level [= N]
+ * 只影响之后写入的页面；每个页面的级别记录在其索引标志中
+ * Only affects pages written from now on; the level of every page is kept in its index flags
+ */
+static int ccvfs_pragma_compress_level(CCVFSFile *pFile, const char *zValue, char **pzResult) {
+    int level;
+
+    if (zValue) {
+        long value;
+
+        if (!ccvfs_pragma_int(zValue, CCVFS_MIN_COMPRESS_LEVEL, CCVFS_MAX_COMPRESS_LEVEL, &value)) {
+            *pzResult = sqlite3_mprintf("ccvfs_compress_level: expected %d..%d, got '%s'",
+                                        CCVFS_MIN_COMPRESS_LEVEL, CCVFS_MAX_COMPRESS_LEVEL, zValue);
+            return SQLITE_ERROR;
+        }
+        ccvfs_rwlock_write_enter(&pFile->index_lock);
+        pFile->compress_level = (int)value;
+        ccvfs_rwlock_write_leave(&pFile->index_lock);
+    }
+
+    ccvfs_rwlock_read_enter(&pFile->index_lock);
+    level = pFile->compress_level;
+    ccvfs_rwlock_read_leave(&pFile->index_lock);
+    *pzResult = sqlite3_mprintf("%d", level);
+    return SQLITE_OK;
+}
+
+/*
+ * PRAGMA ccvfs_flush
+ * 返回写出的页数
+ * Returns the number of pages written out
+ */
+static int ccvfs_pragma_flush(CCVFSFile *pFile, const char *zValue, char **pzResult) {
+    uint32_t flushed;
+    int rc;
+
+    if (zValue) {
+        *pzResult = sqlite3_mprintf("ccvfs_flush: takes no value");
+        return SQLITE_ERROR;
+    }
+    ccvfs_rwlock_write_enter(&pFile->index_lock);
+    rc = ccvfs_pragma_flush_buffer(pFile, &flushed);
+    ccvfs_rwlock_write_leave(&pFile->index_lock);
+    if (rc != SQLITE_OK) {
+        *pzResult = sqlite3_mprintf("ccvfs_flush: flushing the write buffer failed (%d)", rc);
+        return rc;
+    }
+    *pzResult = sqlite3_mprintf("%u", flushed);
+    return SQLITE_OK;
+}
+
+/*
+ * PRAGMA ccvfs_compact
+ * 页面移动需要独占数据库：在没有写事务时临时获取EXCLUSIVE锁，完成后恢复原来的锁级别
+ * Moving pages needs the database to itself: take an EXCLUSIVE lock for the duration when
+ * no write transaction is open, and return to the previous lock level afterwards
+ */
+static int ccvfs_pragma_compact(CCVFSFile *pFile, const char *zValue, char **pzResult) {
+    sqlite3_file *pBase = (sqlite3_file*)pFile;
+    int prevLevel = pFile->lock_level;
+    uint32_t moved = 0;
+    sqlite3_int64 oldSize = 0, newSize = 0;
+    int rc = SQLITE_OK;
+
+    if (zValue) {
+        *pzResult = sqlite3_mprintf("ccvfs_compact: takes no value");
+        return SQLITE_ERROR;
+    }
+    if (pFile->open_flags & SQLITE_OPEN_READONLY) {
+        *pzResult = sqlite3_mprintf("ccvfs_compact: database is read-only");
+        return SQLITE_READONLY;
+    }
+    if (prevLevel > SQLITE_LOCK_SHARED) {
+        *pzResult = sqlite3_mprintf("ccvfs_compact: cannot compact inside a write transaction");
+        return SQLITE_ERROR;
+    }
+
+    if (prevLevel < SQLITE_LOCK_SHARED) {
+        rc = ccvfsIoLock(pBase, SQLITE_LOCK_SHARED);
+    }
+    if (rc == SQLITE_OK) {
+        rc = ccvfsIoLock(pBase, SQLITE_LOCK_RESERVED);
+    }
+    if (rc == SQLITE_OK) {
+        rc = ccvfsIoLock(pBase, SQLITE_LOCK_EXCLUSIVE);
+    }
+    if (rc == SQLITE_OK) {
+        ccvfs_rwlock_write_enter(&pFile->index_lock);
+        rc = ccvfs_compact_file(pFile, &moved, &oldSize, &newSize);
+        ccvfs_snapshot_publish(pFile);
+        ccvfs_rwlock_write_leave(&pFile->index_lock);
+    }
+    if (pFile->lock_level > prevLevel) {
+        ccvfsIoUnlock(pBase, prevLevel);
+    }
+
+    if (rc == SQLITE_BUSY) {
+        *pzResult = sqlite3_mprintf("ccvfs_compact: database is locked");
+        return rc;
+    }
+    if (rc != SQLITE_OK) {
+        *pzResult = sqlite3_mprintf("ccvfs_compact: compaction failed (%d)", rc);
+        return rc;
+    }
+    *pzResult = sqlite3_mprintf("moved_pages=%u file_size=%lld reclaimed_bytes=%lld",
+                                moved, newSize, oldSize - newSize);
+    return SQLITE_OK;
+}
+
+/*
+ * PRAGMA ccvfs_histograms [= ON | OFF | RESET]
+ */
+static int ccvfs_pragma_histograms(CCVFSFile *pFile, const char *zValue, char **pzResult) {
+    if (zValue) {
+        int enabled = ccvfs_pragma_bool(zValue);
+
+        if (sqlite3_stricmp(zValue, "reset") == 0) {
+            ccvfs_latency_reset(pFile);
+        } else if (enabled >= 0) {
+            ccvfs_latency_set_enabled(pFile, enabled);
+        } else {
+            *pzResult = sqlite3_mprintf("ccvfs_histograms: expected ON, OFF or RESET, got '%s'", zValue);
+            return SQLITE_ERROR;
+        }
+    }
+    *pzResult = ccvfs_latency_report(pFile);
+    return SQLITE_OK;
+}
+
+/*
+ * PRAGMA ccvfs_log_level [= OFF | ERROR | INFO | DEBUG | VERBOSE | 0..4]
+ * 作用于整个进程，而不只是当前文件
+ * Applies to the whole process, not only to this file
+ */
+static int ccvfs_pragma_log_level(CCVFSFile *pFile, const char *zValue, char **pzResult) {
+    (void)pFile;
+
+    if (zValue) {
+        long level = -1;
+
+        for (int i = CCVFS_LOG_OFF; i <= CCVFS_LOG_VERBOSE; i++) {
+            if (sqlite3_stricmp(zValue, ccvfs_log_level_name(i)) == 0) {
+                level = i;
+            }
+        }
+        if (level < 0 && !ccvfs_pragma_int(zValue, CCVFS_LOG_OFF, CCVFS_LOG_VERBOSE, &level)) {
+            *pzResult = sqlite3_mprintf("ccvfs_log_level: expected OFF, ERROR, INFO, DEBUG or VERBOSE, got '%s'",
+                                        zValue);
+            return SQLITE_ERROR;
+        }
+        sqlite3_ccvfs_set_log_level((int)level);
+    }
+    *pzResult = sqlite3_mprintf("%s", ccvfs_log_level_name(sqlite3_ccvfs_get_log_level()));
+    return SQLITE_OK;
+}
+
+/*
+ * PRAGMA ccvfs_trace [= ON | OFF | ERROR]
+ * 返回状态行和最新的事件；跟踪环由进程内所有CCVFS文件共用
+ * Returns a status line and the latest events; the ring is shared by every CCVFS file in the process
+ */
+static int ccvfs_pragma_trace(CCVFSFile *pFile, const char *zValue, char **pzResult) {
+    (void)pFile;
+
+    if (zValue) {
+        int enabled = ccvfs_pragma_bool(zValue);
+
+        if (sqlite3_stricmp(zValue, "error") == 0) {
+            sqlite3_ccvfs_trace_config(CCVFS_TRACE_ON | CCVFS_TRACE_DUMP_ON_ERROR);
+        } else if (enabled >= 0) {
+            sqlite3_ccvfs_trace_config(enabled ? CCVFS_TRACE_ON : 0);
+        } else {
+            *pzResult = sqlite3_mprintf("ccvfs_trace: expected ON, OFF or ERROR, got '%s'", zValue);
+            return SQLITE_ERROR;
+        }
+    }
+    *pzResult = ccvfs_trace_report(CCVFS_PRAGMA_TRACE_EVENTS);
+    return SQLITE_OK;
+}
+
+/*
+ * PRAGMA ccvfs_record [= 'PATH' | OFF]
+ * 录制所属VFS上所有文件的I/O；不保存写入的数据，需要数据时使用sqlite3_ccvfs_record_start()
+ * Records the I/O of every file of the owning VFS; written bytes are not stored, use
+ * sqlite3_ccvfs_record_start() with CCVFS_RECORD_DATA when the replay needs them
+ */
+static int ccvfs_pragma_record(CCVFSFile *pFile, const char *zValue, char **pzResult) {
+    const char *zVfsName = pFile->pOwner->base.zName;
+
+    if (zValue) {
+        int rc;
+
+        if (sqlite3_stricmp(zValue, "off") == 0) {
+            rc = sqlite3_ccvfs_record_stop(zVfsName, NULL);
+            if (rc == SQLITE_NOTFOUND) {
+                rc = SQLITE_OK;
+            }
+        } else {
+            rc = sqlite3_ccvfs_record_start(zVfsName, zValue, 0);
+        }
+        if (rc != SQLITE_OK) {
+            *pzResult = sqlite3_mprintf("ccvfs_record: %s failed: %s",
+                                        sqlite3_stricmp(zValue, "off") == 0 ? "stop" : "start",
+                                        sqlite3_errstr(rc));
+            return SQLITE_ERROR;
+        }
+    }
+    *pzResult = ccvfs_record_report(pFile->pOwner);
+    return SQLITE_OK;
+}
+
+static const struct {
+    const char *zName;
+    CCVFSPragmaHandler xHandler;
+} ccvfs_pragmas[] = {
+    { "ccvfs_stats",          ccvfs_pragma_stats },
+    { "ccvfs_cache_size",     ccvfs_pragma_cache_size },
+    { "ccvfs_write_buffer",   ccvfs_pragma_write_buffer },
+    { "ccvfs_compress_level", ccvfs_pragma_compress_level },
+    { "ccvfs_flush",          ccvfs_pragma_flush },
+    { "ccvfs_compact",        ccvfs_pragma_compact },
+    { "ccvfs_histograms",     ccvfs_pragma_histograms },
+    { "ccvfs_log_level",      ccvfs_pragma_log_level },
+    { "ccvfs_trace",          ccvfs_pragma_trace },
+    { "ccvfs_record",         ccvfs_pragma_record },
+};
+
+int ccvfs_pragma(CCVFSFile *pFile, char **azArg) {
+    const char *zName = azArg[1];
+
+    if (!zName || sqlite3_strnicmp(zName, "ccvfs_", 6) != 0) {
+        return SQLITE_NOTFOUND;
+    }
+    for (size_t i = 0; i < sizeof(ccvfs_pragmas) / sizeof(ccvfs_pragmas[0]); i++) {
+        if (sqlite3_stricmp(zName, ccvfs_pragmas[i].zName) == 0) {
+            CCVFS_DEBUG("PRAGMA %s = %s", zName, azArg[2] ? azArg[2] : "(query)");
+            return ccvfs_pragmas[i].xHandler(pFile, azArg[2], &azArg[0]);
+        }
+    }
+    return SQLITE_NOTFOUND;
+}
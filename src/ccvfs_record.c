@@ -0,0 +1,346 @@
+#include "ccvfs_record.h"
+#include "ccvfs_core.h"
+
+/*
+ * I/O录制
+ * 录制中的VFS把SQLite对其文件发出的每次读、写、截断、同步、加锁和解锁以及文件删除追加到二进制跟踪文件。
+ * 记录的是CCVFS之上的逻辑调用，因此可以在任意页大小、编解码器和缓冲配置上重放，
+ * 用生产环境的真实访问模式离线调整配置。记录按固定32字节编码，写入stdio缓冲区，
+ * 由VFS级互斥锁串行化；未录制时每次调用只有一次宽松原子读取和一个分支。
+ *
+ * I/O recording
+ * A recording VFS appends every read, write, truncate, sync, lock and unlock SQLite issues
+ * on its files, and every file it deletes, to a binary trace. The trace holds the logical calls above CCVFS, so it can be
+ * replayed on any page size, codec or buffer configuration to tune them offline against real
+ * production access patterns. Records are fixed 32-byte encodings appended to a stdio buffer
+ * and serialized by a VFS-wide mutex; while not recording each call costs one relaxed atomic
+ * load and a branch.
+ */
+
+#define CCVFS_RECORD_NAME_SIZE   16        // Algorithm name fields of the trace header
+#define CCVFS_RECORD_BUFFER_SIZE (1 << 20) // stdio buffer of the trace file
+
+typedef struct CCVFSRecorder {
+    FILE *out;              // Trace file
+    char *zPath;            // Trace file path, reported by PRAGMA ccvfs_record
+    int flags;              // CCVFS_RECORD_* flags
+    int failed;             // Set after a failed write, later records are dropped
+    uint32_t session;       // Matched against CCVFSFile.record_session
+    uint64_t start_ns;      // Monotonic clock when recording started
+    uint64_t n_record;      // Records written
+    uint64_t n_byte;        // Bytes written, header included
+} CCVFSRecorder;
+
+static const char *const ccvfs_record_op_names[CCVFS_RECORD_OP_COUNT] = {
+    "open",
+    "close",
+    "read",
+    "write",
+    "truncate",
+    "sync",
+    "lock",
+    "unlock",
+    "delete"
+};
+
+const char *sqlite3_ccvfs_record_op_name(int op) {
+    if (op < 0 || op >= CCVFS_RECORD_OP_COUNT) {
+        return NULL;
+    }
+    return ccvfs_record_op_names[op];
+}
+
+static void ccvfs_record_put32(unsigned char *p, uint32_t v) {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
+}
+
+static void ccvfs_record_put64(unsigned char *p, uint64_t v) {
+    ccvfs_record_put32(p, (uint32_t)v);
+    ccvfs_record_put32(p + 4, (uint32_t)(v >> 32));
+}
+
+static uint32_t ccvfs_record_get32(const unsigned char *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t ccvfs_record_get64(const unsigned char *p) {
+    return (uint64_t)ccvfs_record_get32(p) | ((uint64_t)ccvfs_record_get32(p + 4) << 32);
+}
+
+void sqlite3_ccvfs_record_decode(const unsigned char *aRecord, CCVFSRecord *pRecord) {
+    pRecord->time_ns = ccvfs_record_get64(aRecord);
+    pRecord->offset = ccvfs_record_get64(aRecord + 8);
+    pRecord->file_id = ccvfs_record_get32(aRecord + 16);
+    pRecord->arg = ccvfs_record_get32(aRecord + 20);
+    pRecord->duration_us = ccvfs_record_get32(aRecord + 24);
+    pRecord->op = aRecord[28];
+    pRecord->rc = aRecord[29];
+}
+
+/*
+ * 写入跟踪文件，失败后停止写入（调用者持有record_mutex）
+ * Write to the trace, stopping after a failure (caller holds record_mutex)
+ */
+static void ccvfs_record_write(CCVFSRecorder *pRec, const void *pData, size_t n) {
+    if (pRec->failed || n == 0) {
+        return;
+    }
+    if (fwrite(pData, 1, n, pRec->out) != n) {
+        pRec->failed = 1;
+        CCVFS_ERROR("Failed to write I/O trace %s, recording stopped", pRec->zPath);
+        return;
+    }
+    pRec->n_byte += n;
+}
+
+static void ccvfs_record_emit(CCVFSRecorder *pRec, CCVFSRecordOp op, uint32_t fileId, uint64_t tStart,
+                              uint64_t tEnd, uint64_t offset, uint32_t arg, int rc) {
+    unsigned char aRecord[CCVFS_RECORD_SIZE];
+    uint64_t durationUs = tEnd > tStart ? (tEnd - tStart) / 1000 : 0;
+
+    memset(aRecord, 0, sizeof(aRecord));
+    ccvfs_record_put64(aRecord, tStart > pRec->start_ns ? tStart - pRec->start_ns : 0);
+    ccvfs_record_put64(aRecord + 8, offset);
+    ccvfs_record_put32(aRecord + 16, fileId);
+    ccvfs_record_put32(aRecord + 20, arg);
+    ccvfs_record_put32(aRecord + 24, durationUs > 0xFFFFFFFFull ? 0xFFFFFFFFu : (uint32_t)durationUs);
+    aRecord[28] = (unsigned char)op;
+    aRecord[29] = (unsigned char)(rc & 0xff);
+    ccvfs_record_write(pRec, aRecord, sizeof(aRecord));
+    pRec->n_record++;
+}
+
+/*
+ * 追加一次调用；文件在本次录制中首次出现时先写它的打开记录
+ * Append one call; a file seen for the first time in this recording gets its open record first
+ */
+void ccvfs_record_append(CCVFSFile *pFile, CCVFSRecordOp op, uint64_t tStart,
+                         uint64_t offset, uint32_t arg, const void *pData, int rc) {
+    CCVFS *pVfs = pFile->pOwner;
+    uint64_t tEnd = ccvfs_latency_now();
+    CCVFSRecorder *pRec;
+
+    sqlite3_mutex_enter(pVfs->record_mutex);
+    pRec = pVfs->pRecorder;
+    if (!pRec || pRec->failed) {
+        sqlite3_mutex_leave(pVfs->record_mutex);
+        return;
+    }
+
+    if (pFile->record_session != pRec->session) {
+        size_t nName = pFile->filename ? strlen(pFile->filename) : 0;
+
+        pFile->record_session = pRec->session;
+        if (op == CCVFS_RECORD_OPEN) {
+            ccvfs_record_emit(pRec, op, pFile->file_id, tStart, tEnd, nName, arg, rc);
+        } else {
+            ccvfs_record_emit(pRec, CCVFS_RECORD_OPEN, pFile->file_id, tStart, tStart,
+                              nName, (uint32_t)pFile->open_flags, SQLITE_OK);
+        }
+        ccvfs_record_write(pRec, pFile->filename, nName);
+        if (op == CCVFS_RECORD_OPEN) {
+            sqlite3_mutex_leave(pVfs->record_mutex);
+            return;
+        }
+    }
+
+    ccvfs_record_emit(pRec, op, pFile->file_id, tStart, tEnd, offset, arg, rc);
+    if (op == CCVFS_RECORD_WRITE && (pRec->flags & CCVFS_RECORD_DATA) && pData) {
+        ccvfs_record_write(pRec, pData, arg);
+    }
+    sqlite3_mutex_leave(pVfs->record_mutex);
+}
+
+/*
+ * 追加一次文件删除；日志文件在每次提交后被删除，重放时也必须删除
+ * Append a file deletion; journals are deleted after every commit and a replay must do the same
+ */
+void ccvfs_record_delete(CCVFS *pVfs, uint64_t tStart, const char *zName, int syncDir, int rc) {
+    uint64_t tEnd = ccvfs_latency_now();
+    const char *zBase = zName;
+    size_t nName;
+    CCVFSRecorder *pRec;
+
+    // 与打开记录一样只保留文件名部分
+    // Keep only the file name part, like open records
+    if (zName) {
+        const char *zSlash = strrchr(zName, '/');
+        const char *zBackslash = strrchr(zName, '\\');
+        if (zSlash) zBase = zSlash + 1;
+        if (zBackslash && zBackslash + 1 > zBase) zBase = zBackslash + 1;
+    }
+    nName = zBase ? strlen(zBase) : 0;
+
+    sqlite3_mutex_enter(pVfs->record_mutex);
+    pRec = pVfs->pRecorder;
+    if (pRec && !pRec->failed) {
+        ccvfs_record_emit(pRec, CCVFS_RECORD_DELETE, 0, tStart, tEnd, nName, (uint32_t)syncDir, rc);
+        ccvfs_record_write(pRec, zBase, nName);
+    }
+    sqlite3_mutex_leave(pVfs->record_mutex);
+}
+
+int ccvfs_record_init_vfs(CCVFS *pVfs) {
+    pVfs->record_mutex = sqlite3_mutex_alloc(SQLITE_MUTEX_FAST);
+    pVfs->pRecorder = NULL;
+    pVfs->record_active = 0;
+    pVfs->record_session = 0;
+    if (!pVfs->record_mutex && sqlite3_threadsafe()) {
+        return SQLITE_NOMEM;
+    }
+    return SQLITE_OK;
+}
+
+/*
+ * 关闭跟踪文件并释放录制状态（调用者持有record_mutex）
+ * Close the trace and free the recording (caller holds record_mutex)
+ */
+static int ccvfs_record_close(CCVFS *pVfs, uint64_t *pnRecord) {
+    CCVFSRecorder *pRec = pVfs->pRecorder;
+    int rc;
+
+    CCVFS_COUNTER_SET(pVfs->record_active, 0);
+    pVfs->pRecorder = NULL;
+    if (fclose(pRec->out) != 0) {
+        pRec->failed = 1;
+    }
+    rc = pRec->failed ? SQLITE_IOERR_WRITE : SQLITE_OK;
+    if (pnRecord) {
+        *pnRecord = pRec->n_record;
+    }
+    CCVFS_INFO("Recorded %llu I/O calls to %s", (unsigned long long)pRec->n_record, pRec->zPath);
+    sqlite3_free(pRec->zPath);
+    sqlite3_free(pRec);
+    return rc;
+}
+
+void ccvfs_record_destroy_vfs(CCVFS *pVfs) {
+    if (pVfs->pRecorder) {
+        sqlite3_mutex_enter(pVfs->record_mutex);
+        ccvfs_record_close(pVfs, NULL);
+        sqlite3_mutex_leave(pVfs->record_mutex);
+    }
+    if (pVfs->record_mutex) {
+        sqlite3_mutex_free(pVfs->record_mutex);
+        pVfs->record_mutex = NULL;
+    }
+}
+
+static CCVFS *ccvfs_record_find_vfs(const char *zVfsName) {
+    sqlite3_vfs *pVfs = zVfsName ? sqlite3_vfs_find(zVfsName) : NULL;
+
+    if (!pVfs || pVfs->xOpen != ccvfsOpen) {
+        CCVFS_ERROR("VFS not found or not a CCVFS: %s", zVfsName ? zVfsName : "(null)");
+        return NULL;
+    }
+    return (CCVFS*)pVfs;
+}
+
+int sqlite3_ccvfs_record_start(const char *zVfsName, const char *zTracePath, int flags) {
+    CCVFS *pVfs = ccvfs_record_find_vfs(zVfsName);
+    unsigned char aHeader[CCVFS_RECORD_HEADER_SIZE];
+    CCVFSRecorder *pRec;
+
+    if (!pVfs || !zTracePath) {
+        return SQLITE_ERROR;
+    }
+
+    pRec = (CCVFSRecorder*)sqlite3_malloc(sizeof(CCVFSRecorder));
+    if (!pRec) {
+        return SQLITE_NOMEM;
+    }
+    memset(pRec, 0, sizeof(CCVFSRecorder));
+    pRec->flags = flags & CCVFS_RECORD_DATA;
+    pRec->zPath = sqlite3_mprintf("%s", zTracePath);
+    if (!pRec->zPath) {
+        sqlite3_free(pRec);
+        return SQLITE_NOMEM;
+    }
+
+    sqlite3_mutex_enter(pVfs->record_mutex);
+    if (pVfs->pRecorder) {
+        sqlite3_mutex_leave(pVfs->record_mutex);
+        sqlite3_free(pRec->zPath);
+        sqlite3_free(pRec);
+        return SQLITE_MISUSE;
+    }
+    pRec->out = fopen(zTracePath, "wb");
+    if (!pRec->out) {
+        sqlite3_mutex_leave(pVfs->record_mutex);
+        CCVFS_ERROR("Cannot create I/O trace %s", zTracePath);
+        sqlite3_free(pRec->zPath);
+        sqlite3_free(pRec);
+        return SQLITE_CANTOPEN;
+    }
+    setvbuf(pRec->out, NULL, _IOFBF, CCVFS_RECORD_BUFFER_SIZE);
+
+    memset(aHeader, 0, sizeof(aHeader));
+    memcpy(aHeader, CCVFS_RECORD_MAGIC, 8);
+    ccvfs_record_put32(aHeader + 8, CCVFS_RECORD_VERSION);
+    ccvfs_record_put32(aHeader + 12, (uint32_t)pRec->flags);
+    ccvfs_record_put64(aHeader + 16, (uint64_t)time(NULL));
+    ccvfs_record_put32(aHeader + 24, pVfs->page_size ? pVfs->page_size : CCVFS_DEFAULT_PAGE_SIZE);
+    if (pVfs->zCompressType) {
+        strncpy((char*)aHeader + 32, pVfs->zCompressType, CCVFS_RECORD_NAME_SIZE - 1);
+    }
+    if (pVfs->zEncryptType) {
+        strncpy((char*)aHeader + 48, pVfs->zEncryptType, CCVFS_RECORD_NAME_SIZE - 1);
+    }
+    ccvfs_record_write(pRec, aHeader, sizeof(aHeader));
+
+    // 每次录制使用新的会话号，已打开的文件在下一次调用时补写打开记录
+    // Every recording gets a new session, files already open get their open record on their next call
+    pRec->session = ++pVfs->record_session;
+    pRec->start_ns = ccvfs_latency_now();
+    pVfs->pRecorder = pRec;
+    CCVFS_COUNTER_SET(pVfs->record_active, 1);
+    sqlite3_mutex_leave(pVfs->record_mutex);
+
+    CCVFS_INFO("Recording I/O of VFS %s to %s", zVfsName, zTracePath);
+    return SQLITE_OK;
+}
+
+int sqlite3_ccvfs_record_stop(const char *zVfsName, uint64_t *pnRecord) {
+    CCVFS *pVfs = ccvfs_record_find_vfs(zVfsName);
+    int rc;
+
+    if (pnRecord) {
+        *pnRecord = 0;
+    }
+    if (!pVfs) {
+        return SQLITE_ERROR;
+    }
+    sqlite3_mutex_enter(pVfs->record_mutex);
+    if (!pVfs->pRecorder) {
+        sqlite3_mutex_leave(pVfs->record_mutex);
+        return SQLITE_NOTFOUND;
+    }
+    rc = ccvfs_record_close(pVfs, pnRecord);
+    sqlite3_mutex_leave(pVfs->record_mutex);
+    return rc;
+}
+
+/*
+ * 录制状态，供PRAGMA ccvfs_record使用（sqlite3_malloc分配）
+ * Recording status for PRAGMA ccvfs_record (allocated with sqlite3_malloc)
+ */
+char *ccvfs_record_report(CCVFS *pVfs) {
+    CCVFSRecorder *pRec;
+    char *zReport;
+
+    sqlite3_mutex_enter(pVfs->record_mutex);
+    pRec = pVfs->pRecorder;
+    if (!pRec) {
+        zReport = sqlite3_mprintf("off");
+    } else {
+        zReport = sqlite3_mprintf("recording to %s: %llu records, %llu bytes%s%s", pRec->zPath,
+                                  (unsigned long long)pRec->n_record, (unsigned long long)pRec->n_byte,
+                                  (pRec->flags & CCVFS_RECORD_DATA) ? ", with data" : "",
+                                  pRec->failed ? ", write failed" : "");
+    }
+    sqlite3_mutex_leave(pVfs->record_mutex);
+    return zReport;
+}
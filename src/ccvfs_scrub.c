@@ -0,0 +1,569 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE  // SCHED_IDLE
+#endif
+#include "ccvfs_scrub.h"
+#include "ccvfs_core.h"
+#include "ccvfs_hooks.h"
+#include "ccvfs_latency.h"
+#include "ccvfs_utils.h"
+#include <pthread.h>
+#include <sched.h>
+
+/*
+ * 后台巡检
+ * 每个VFS最多一个巡检线程，按文件编号依次巡检打开的主数据库：每轮开始时在共享索引锁下
+ * 按物理偏移排序已存储的块，之后每次检查一段（最多CCVFS_SCRUB_CHUNK_BYTES字节）。线程以
+ * SCHED_IDLE运行，读取期间不持有其他线程需要的锁：在VFS打开文件锁下给文件加一个引用
+ * （关闭文件时等待引用归零），在共享索引锁下复制这一段的索引条目，然后释放两把锁再读取。
+ * 索引条目在排序后改变的块跳过，它们由写入者用新数据重新计算了校验和。读取速度按令牌桶
+ * 限制在配置的预算内。
+ *
+ * 校验不一致时，在共享索引锁下确认条目没有变化并重读一次；条目已变化，或者仍不一致且
+ * 另一个连接持有RESERVED锁、磁盘上的索引代已经超过内存中的索引时，块可能正被改写，
+ * 留到下一轮。确认的损坏每个块只计数一次。
+ *
+ * 每个通过校验的块记录一个标记：高32位是校验时间（毫秒），低32位是索引条目的标签。
+ * 读取者在信任窗口内找到与当前条目标签相同的标记时跳过CRC；条目一旦改变（改写、迁移），
+ * 标签不再匹配，页面重新按CRC校验。
+ *
+ * Background scrubber
+ * A VFS runs at most one scrubber thread, which visits the open main databases in file id
+ * order. At the start of a file's pass the stored blocks are sorted by physical offset under
+ * the shared index lock; each later step checks one chunk of at most CCVFS_SCRUB_CHUNK_BYTES.
+ * The thread runs as SCHED_IDLE and holds no lock other threads need while it reads: it pins
+ * the file with a reference under the VFS open file mutex (a closing file waits for the pins to
+ * drop), copies the chunk's index entries under the shared index lock, and releases both before
+ * reading. Blocks whose index entry changed since the sort are skipped, their writer computed
+ * the checksum from the new data. Reads are throttled to the configured budget with a token bucket.
+ *
+ * A mismatching block is read again under the shared index lock once its entry is confirmed
+ * unchanged. If the entry changed, or the block still differs while another connection holds a
+ * RESERVED lock or the generation on disk is ahead of the in-memory index, it may be being
+ * rewritten and is left for the next pass. Confirmed damage counts once per block.
+ *
+ * Every block that passes leaves a mark: the validation time in milliseconds in the high 32
+ * bits and a tag of the index entry in the low 32 bits. A reader that finds a mark with the
+ * tag of its current entry inside the trust window skips the CRC; once the entry changes
+ * (rewrite, relocation) the tag no longer matches and the page is checked by CRC again.
+ */
+
+#define CCVFS_SCRUB_CHUNK_BYTES  (256 * 1024)  // Stored bytes checked per pin of the file
+#define CCVFS_SCRUB_CHUNK_BLOCKS 256           // Index entries copied per chunk
+#define CCVFS_SCRUB_MARK_BAD     0xFFFFFFFFu   // Time field of a mark whose block is damaged
+
+typedef struct {
+    uint64_t offset;              // Physical offset when the pass was planned
+    uint32_t page;
+} CCVFSScrubTarget;
+
+typedef struct {
+    uint32_t page;
+    CCVFSPageIndex entry;         // Copied under the shared index lock
+} CCVFSScrubBlock;
+
+typedef struct CCVFSScrubber {
+    CCVFS *pVfs;
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t wake;          // Signalled on reconfiguration and stop
+    int stop;
+    CCVFSScrubOptions options;    // Guarded by mutex
+
+    // 仅巡检线程访问
+    // Scrubber thread only
+    uint32_t file_id;             // File of the current pass, 0 between passes
+    CCVFSScrubTarget *aTarget;    // Stored blocks of that file in physical order (NULL before planning)
+    uint32_t nTarget;
+    uint32_t iTarget;             // Next block to check
+    CCVFSScrubBlock aChunk[CCVFS_SCRUB_CHUNK_BLOCKS];
+    unsigned char *aBuf;
+    uint32_t nBuf;
+} CCVFSScrubber;
+
+/*
+ * 毫秒时钟（截断为32位，按差值比较，约49天回绕一次）
+ * Millisecond clock, truncated to 32 bits and only compared by difference (wraps every 49 days)
+ */
+static uint32_t ccvfs_scrub_clock(void) {
+    uint32_t now = (uint32_t)(ccvfs_latency_now() / 1000000);
+    return now == CCVFS_SCRUB_MARK_BAD ? now - 1 : now;
+}
+
+/*
+ * 索引条目标签：偏移、大小和校验和的混合，不为0
+ * Tag of an index entry: a mix of offset, size and checksum, never 0
+ */
+static uint32_t ccvfs_scrub_tag(const CCVFSPageIndex *pIndex) {
+    uint64_t h = pIndex->physical_offset * 0x9E3779B97F4A7C15ull;
+
+    h ^= ((uint64_t)pIndex->compressed_size << 32) | pIndex->checksum;
+    h *= 0xBF58476D1CE4E5B9ull;
+    return (uint32_t)(h >> 32) | 1;
+}
+
+static uint64_t ccvfs_scrub_get_mark(CCVFSFile *pFile, uint32_t pageNum) {
+    uint64_t *aMark;
+
+    if (pageNum >= CCVFS_MAX_PAGES) {
+        return 0;
+    }
+    aMark = CCVFS_COUNTER_GET(pFile->scrub_marks[pageNum / CCVFS_INDEX_BLOCK_PAGES]);
+    return aMark ? CCVFS_COUNTER_GET(aMark[pageNum % CCVFS_INDEX_BLOCK_PAGES]) : 0;
+}
+
+/*
+ * 记录标记，按需分配所在的标记块（仅巡检线程调用，文件已加引用）
+ * Store a mark, allocating its mark block on first use (scrubber thread only, file pinned)
+ */
+static void ccvfs_scrub_set_mark(CCVFSFile *pFile, uint32_t pageNum, uint64_t mark) {
+    uint32_t block = pageNum / CCVFS_INDEX_BLOCK_PAGES;
+    uint64_t *aMark;
+
+    if (pageNum >= CCVFS_MAX_PAGES) {
+        return;
+    }
+    aMark = pFile->scrub_marks[block];
+    if (!aMark) {
+        if (mark == 0) {
+            return;
+        }
+        aMark = (uint64_t*)sqlite3_malloc(CCVFS_INDEX_BLOCK_PAGES * sizeof(uint64_t));
+        if (!aMark) {
+            return;
+        }
+        memset(aMark, 0, CCVFS_INDEX_BLOCK_PAGES * sizeof(uint64_t));
+        CCVFS_COUNTER_SET(pFile->scrub_marks[block], aMark);
+    }
+    CCVFS_COUNTER_SET(aMark[pageNum % CCVFS_INDEX_BLOCK_PAGES], mark);
+}
+
+int ccvfs_scrub_check_mark(CCVFSFile *pFile, uint32_t pageNum, const CCVFSPageIndex *pIndex, uint32_t window) {
+    uint64_t mark = ccvfs_scrub_get_mark(pFile, pageNum);
+    uint32_t validated = (uint32_t)(mark >> 32);
+
+    if (mark == 0 || (uint32_t)mark != ccvfs_scrub_tag(pIndex) || validated == CCVFS_SCRUB_MARK_BAD) {
+        return 0;
+    }
+    return (uint32_t)(ccvfs_scrub_clock() - validated) <= window;
+}
+
+/*
+ * 关闭文件时让巡检线程不再访问它；返回时没有正在进行的检查
+ * Keep the scrubber away from a closing file; on return no chunk of it is being checked
+ */
+void ccvfs_scrub_detach(CCVFSFile *pFile) {
+    CCVFS *pVfs = pFile->pOwner;
+
+    if (!pVfs) {
+        return;
+    }
+    sqlite3_mutex_enter(pVfs->files_mutex);
+    CCVFS_COUNTER_SET(pFile->scrub_detached, 1);
+    while (pFile->scrub_pins > 0) {
+        // 巡检线程在每个块之间检查detached，最多等待一个块的读取
+        // The scrubber checks detached between blocks, this waits for one block read at most
+        sqlite3_mutex_leave(pVfs->files_mutex);
+        pVfs->pRootVfs->xSleep(pVfs->pRootVfs, 1000);
+        sqlite3_mutex_enter(pVfs->files_mutex);
+    }
+    sqlite3_mutex_leave(pVfs->files_mutex);
+}
+
+void ccvfs_scrub_free_marks(CCVFSFile *pFile) {
+    for (uint32_t i = 0; i < CCVFS_INDEX_BLOCK_COUNT; i++) {
+        if (pFile->scrub_marks[i]) {
+            sqlite3_free(pFile->scrub_marks[i]);
+            pFile->scrub_marks[i] = NULL;
+        }
+    }
+}
+
+static int ccvfs_scrub_target_cmp(const void *pA, const void *pB) {
+    const CCVFSScrubTarget *a = (const CCVFSScrubTarget *)pA;
+    const CCVFSScrubTarget *b = (const CCVFSScrubTarget *)pB;
+
+    if (a->offset != b->offset) {
+        return a->offset < b->offset ? -1 : 1;
+    }
+    return a->page < b->page ? -1 : (a->page > b->page);
+}
+
+/*
+ * 只看打开后不再改变的字段；文件头和索引是否已加载在索引锁下检查，见ccvfs_scrub_chunk()
+ * Only looks at fields fixed once the file is open; whether the header and index are loaded is
+ * checked under the index lock, see ccvfs_scrub_chunk()
+ */
+static int ccvfs_scrub_eligible(CCVFSFile *pFile) {
+    return pFile->is_ccvfs_file && !CCVFS_COUNTER_GET(pFile->scrub_detached) &&
+           (pFile->open_flags & SQLITE_OPEN_MAIN_DB);
+}
+
+static void ccvfs_scrub_drop_plan(CCVFSScrubber *p) {
+    sqlite3_free(p->aTarget);
+    p->aTarget = NULL;
+    p->nTarget = 0;
+    p->iTarget = 0;
+}
+
+/*
+ * 选择要巡检的文件：继续当前文件，否则取编号更大的下一个文件（调用者持有files_mutex）
+ * Pick the file to scrub: the current one, else the next one by file id (caller holds files_mutex)
+ */
+static CCVFSFile *ccvfs_scrub_next_file(CCVFSScrubber *p) {
+    CCVFSFile *pNext = NULL;
+
+    for (CCVFSFile *pFile = p->pVfs->pOpenFiles; pFile; pFile = pFile->pNextOpen) {
+        if (!ccvfs_scrub_eligible(pFile)) {
+            continue;
+        }
+        if (p->aTarget && pFile->file_id == p->file_id) {
+            return pFile;
+        }
+        if (pFile->file_id > p->file_id && (!pNext || pFile->file_id < pNext->file_id)) {
+            pNext = pFile;
+        }
+    }
+    ccvfs_scrub_drop_plan(p);
+    p->file_id = pNext ? pNext->file_id : 0;
+    return pNext;
+}
+
+/*
+ * 按物理偏移排列文件的已存储块（调用者持有共享索引锁）
+ * List the stored blocks of a file in physical order (caller holds the index lock shared)
+ */
+static int ccvfs_scrub_plan(CCVFSScrubber *p, CCVFSFile *pFile) {
+    uint32_t nPage = pFile->header.total_pages;
+
+    p->aTarget = (CCVFSScrubTarget*)sqlite3_malloc64((sqlite3_uint64)(nPage ? nPage : 1) * sizeof(CCVFSScrubTarget));
+    if (!p->aTarget) {
+        return SQLITE_NOMEM;
+    }
+    for (uint32_t i = 0; i < nPage; i++) {
+        const CCVFSPageIndex *pEntry = &pFile->pPageIndex[i];
+        if (pEntry->physical_offset != 0 && pEntry->compressed_size != 0 && !(pEntry->flags & CCVFS_PAGE_SPARSE)) {
+            p->aTarget[p->nTarget].offset = pEntry->physical_offset;
+            p->aTarget[p->nTarget].page = i;
+            p->nTarget++;
+        }
+    }
+    qsort(p->aTarget, p->nTarget, sizeof(CCVFSScrubTarget), ccvfs_scrub_target_cmp);
+    return SQLITE_OK;
+}
+
+/*
+ * 读取一个块并比较校验和，返回SQLITE_OK（一致）、SQLITE_CORRUPT（不一致或超出文件）或I/O错误
+ * Read one block and compare its checksum: SQLITE_OK (match), SQLITE_CORRUPT (mismatch or past the end) or an I/O error
+ */
+static int ccvfs_scrub_read(CCVFSScrubber *p, CCVFSFile *pFile, const CCVFSPageIndex *pEntry) {
+    int rc;
+
+    if (pEntry->compressed_size > p->nBuf) {
+        unsigned char *aNew = (unsigned char*)sqlite3_realloc(p->aBuf, (int)pEntry->compressed_size);
+        if (!aNew) {
+            return SQLITE_NOMEM;
+        }
+        p->aBuf = aNew;
+        p->nBuf = pEntry->compressed_size;
+    }
+    rc = pFile->pReal->pMethods->xRead(pFile->pReal, p->aBuf, (int)pEntry->compressed_size,
+                                       (sqlite3_int64)pEntry->physical_offset);
+    if (rc == SQLITE_IOERR_SHORT_READ) {
+        return SQLITE_CORRUPT;
+    }
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+    return ccvfs_crc32(p->aBuf, (int)pEntry->compressed_size) == pEntry->checksum ? SQLITE_OK : SQLITE_CORRUPT;
+}
+
+/*
+ * 不一致是否可能来自另一个进程的改写（调用者持有共享索引锁）
+ * Whether a mismatch may come from another process rewriting the file (caller holds the index lock shared)
+ */
+static int ccvfs_scrub_foreign_writer(CCVFSFile *pFile) {
+    CCVFSFileHeader diskHeader;
+    int reserved = 0;
+
+    if (CCVFS_COUNTER_GET(pFile->lock_level) < SQLITE_LOCK_RESERVED &&
+        (pFile->pReal->pMethods->xCheckReservedLock(pFile->pReal, &reserved) != SQLITE_OK || reserved)) {
+        return 1;
+    }
+    if (pFile->pReal->pMethods->xRead(pFile->pReal, &diskHeader, CCVFS_HEADER_SIZE, 0) != SQLITE_OK) {
+        return 1;
+    }
+    return diskHeader.change_counter != pFile->index_generation;
+}
+
+/*
+ * 检查一个块并更新其标记和计数
+ * Check one block and update its mark and counters
+ */
+static void ccvfs_scrub_block(CCVFSScrubber *p, CCVFSFile *pFile, uint32_t pageNum, const CCVFSPageIndex *pEntry) {
+    uint32_t tag = ccvfs_scrub_tag(pEntry);
+    uint64_t tStart = ccvfs_event_begin(CCVFS_EVENT_CHECKSUM);
+    int rc = ccvfs_scrub_read(p, pFile, pEntry);
+
+    CCVFS_COUNTER_INC(pFile->counters.scrubbed_block_count);
+    CCVFS_COUNTER_ADD(pFile->counters.scrubbed_bytes, pEntry->compressed_size);
+    if (rc == SQLITE_CORRUPT) {
+        // 不持锁读取时写入者可能已经改写或移走了这个块：在共享索引锁下确认条目未变再重读
+        // A writer may have rewritten or moved the block during the unlocked read: confirm the
+        // entry is unchanged under the shared index lock before reading it again
+        ccvfs_rwlock_read_enter(&pFile->index_lock);
+        const CCVFSPageIndex *pCurrent = pageNum < pFile->header.total_pages ? &pFile->pPageIndex[pageNum] : NULL;
+        if (!pCurrent || pCurrent->physical_offset != pEntry->physical_offset ||
+            pCurrent->compressed_size != pEntry->compressed_size || pCurrent->checksum != pEntry->checksum) {
+            rc = SQLITE_BUSY;
+        } else {
+            rc = ccvfs_scrub_read(p, pFile, pEntry);
+            if (rc == SQLITE_CORRUPT && ccvfs_scrub_foreign_writer(pFile)) {
+                rc = SQLITE_BUSY;
+            }
+        }
+        ccvfs_rwlock_read_leave(&pFile->index_lock);
+    }
+    if (rc == SQLITE_OK) {
+        ccvfs_scrub_set_mark(pFile, pageNum, ((uint64_t)ccvfs_scrub_clock() << 32) | tag);
+        return;
+    }
+    if (rc != SQLITE_CORRUPT) {
+        CCVFS_DEBUG("Scrubber: page %u of %s left for the next pass (%d)", pageNum,
+                    pFile->filename ? pFile->filename : "", rc);
+        ccvfs_scrub_set_mark(pFile, pageNum, 0);
+        return;
+    }
+    if (ccvfs_scrub_get_mark(pFile, pageNum) == (((uint64_t)CCVFS_SCRUB_MARK_BAD << 32) | tag)) {
+        return;
+    }
+    CCVFS_COUNTER_INC(pFile->counters.checksum_error_count);
+    CCVFS_COUNTER_INC(pFile->counters.corrupted_page_count);
+    ccvfs_event(pFile, CCVFS_EVENT_CHECKSUM, tStart, pageNum, pEntry->physical_offset,
+                pEntry->compressed_size, pEntry->original_size, 0, CCVFS_CACHE_NONE, SQLITE_CORRUPT);
+    CCVFS_ERROR("Scrubber: page %u of %s is corrupt (offset=%llu, size=%u)", pageNum,
+                pFile->filename ? pFile->filename : "", (unsigned long long)pEntry->physical_offset,
+                pEntry->compressed_size);
+    ccvfs_scrub_set_mark(pFile, pageNum, ((uint64_t)CCVFS_SCRUB_MARK_BAD << 32) | tag);
+}
+
+/*
+ * 检查文件的下一段，返回读取的字节数（调用者已给文件加引用）
+ * Check the next chunk of a file, returns the bytes read (caller pinned the file)
+ * 只在复制索引条目时持有共享索引锁，读取块时不持有
+ * The shared index lock is held while the index entries are copied, not while blocks are read
+ */
+static uint32_t ccvfs_scrub_chunk(CCVFSScrubber *p, CCVFSFile *pFile) {
+    uint32_t nRead = 0;
+    uint32_t nBlock = 0;
+    int passDone;
+
+    ccvfs_rwlock_read_enter(&pFile->index_lock);
+    if (!pFile->header_loaded || !pFile->pPageIndex ||
+        (!p->aTarget && ccvfs_scrub_plan(p, pFile) != SQLITE_OK)) {
+        ccvfs_rwlock_read_leave(&pFile->index_lock);
+        ccvfs_scrub_drop_plan(p);
+        return 0;
+    }
+    while (p->iTarget < p->nTarget && nRead < CCVFS_SCRUB_CHUNK_BYTES && nBlock < CCVFS_SCRUB_CHUNK_BLOCKS) {
+        const CCVFSScrubTarget *pTarget = &p->aTarget[p->iTarget++];
+        CCVFSScrubBlock *pBlock = &p->aChunk[nBlock];
+
+        if (pTarget->page >= pFile->header.total_pages) {
+            continue;
+        }
+        pBlock->entry = pFile->pPageIndex[pTarget->page];
+        if (pBlock->entry.physical_offset != pTarget->offset || pBlock->entry.compressed_size == 0 ||
+            (pBlock->entry.flags & CCVFS_PAGE_SPARSE)) {
+            continue;
+        }
+        pBlock->page = pTarget->page;
+        nRead += pBlock->entry.compressed_size;
+        nBlock++;
+    }
+    passDone = p->iTarget >= p->nTarget;
+    ccvfs_rwlock_read_leave(&pFile->index_lock);
+
+    for (uint32_t i = 0; i < nBlock && !CCVFS_COUNTER_GET(pFile->scrub_detached); i++) {
+        ccvfs_scrub_block(p, pFile, p->aChunk[i].page, &p->aChunk[i].entry);
+    }
+    if (passDone) {
+        CCVFS_COUNTER_INC(pFile->counters.scrub_pass_count);
+        ccvfs_scrub_drop_plan(p);
+    }
+    return nRead;
+}
+
+/*
+ * 等待到单调时钟的deadline，或者被停止、重新配置唤醒（调用者持有mutex）
+ * Wait until the monotonic deadline, or until woken by stop or reconfiguration (caller holds mutex)
+ */
+static void ccvfs_scrub_wait(CCVFSScrubber *p, uint64_t deadline) {
+    uint64_t now = ccvfs_latency_now();
+    struct timespec ts;
+
+    if (p->stop || deadline <= now) {
+        return;
+    }
+    clock_gettime(CLOCK_REALTIME, &ts);
+    uint64_t wake = (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec + (deadline - now);
+    ts.tv_sec = (time_t)(wake / 1000000000ull);
+    ts.tv_nsec = (long)(wake % 1000000000ull);
+    pthread_cond_timedwait(&p->wake, &p->mutex, &ts);
+}
+
+static void *ccvfs_scrub_main(void *pArg) {
+    CCVFSScrubber *p = (CCVFSScrubber *)pArg;
+    uint64_t tNext = ccvfs_latency_now();
+
+#if defined(__linux__) && defined(SCHED_IDLE)
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+#endif
+
+    pthread_mutex_lock(&p->mutex);
+    while (!p->stop) {
+        CCVFSScrubOptions options = p->options;
+        CCVFSFile *pFile;
+        uint32_t nRead = 0;
+        pthread_mutex_unlock(&p->mutex);
+
+        // 引用使文件在读取期间保持打开，而不必持有files_mutex
+        // The pin keeps the file open during the reads without holding files_mutex
+        sqlite3_mutex_enter(p->pVfs->files_mutex);
+        pFile = ccvfs_scrub_next_file(p);
+        if (pFile) {
+            pFile->scrub_pins++;
+        }
+        sqlite3_mutex_leave(p->pVfs->files_mutex);
+        if (pFile) {
+            nRead = ccvfs_scrub_chunk(p, pFile);
+            sqlite3_mutex_enter(p->pVfs->files_mutex);
+            pFile->scrub_pins--;
+            sqlite3_mutex_leave(p->pVfs->files_mutex);
+        }
+
+        // 令牌桶：每读取一段推迟下一段的开始时间，空闲太久不积攒额度
+        // Token bucket: every chunk pushes the next start back, idle time does not bank credit
+        uint64_t now = ccvfs_latency_now();
+        if (!pFile) {
+            tNext = now + (uint64_t)options.pass_interval_ms * 1000000ull;
+        } else {
+            if (tNext + 1000000000ull < now) {
+                tNext = now;
+            }
+            tNext += (uint64_t)nRead * 1000000000ull / ((uint64_t)options.io_budget_kb * 1024);
+        }
+        pthread_mutex_lock(&p->mutex);
+        ccvfs_scrub_wait(p, tNext);
+        if (!pFile) {
+            tNext = ccvfs_latency_now();
+        }
+    }
+    pthread_mutex_unlock(&p->mutex);
+    return NULL;
+}
+
+static CCVFS *ccvfs_scrub_find_vfs(const char *zVfsName) {
+    sqlite3_vfs *pVfs = zVfsName ? sqlite3_vfs_find(zVfsName) : NULL;
+
+    if (!pVfs || pVfs->xOpen != ccvfsOpen) {
+        CCVFS_ERROR("VFS not found or not a CCVFS: %s", zVfsName ? zVfsName : "(null)");
+        return NULL;
+    }
+    return (CCVFS*)pVfs;
+}
+
+/*
+ * 停止巡检线程并关闭免校验读取
+ * Stop the scrubber thread and turn trusted reads off
+ */
+static void ccvfs_scrub_stop(CCVFS *pVfs) {
+    CCVFSScrubber *p;
+
+    sqlite3_mutex_enter(pVfs->files_mutex);
+    p = pVfs->pScrubber;
+    pVfs->pScrubber = NULL;
+    CCVFS_COUNTER_SET(pVfs->scrub_trust_ms, 0);
+    sqlite3_mutex_leave(pVfs->files_mutex);
+    if (!p) {
+        return;
+    }
+
+    pthread_mutex_lock(&p->mutex);
+    p->stop = 1;
+    pthread_cond_signal(&p->wake);
+    pthread_mutex_unlock(&p->mutex);
+    pthread_join(p->thread, NULL);
+
+    ccvfs_scrub_drop_plan(p);
+    sqlite3_free(p->aBuf);
+    pthread_cond_destroy(&p->wake);
+    pthread_mutex_destroy(&p->mutex);
+    sqlite3_free(p);
+}
+
+void ccvfs_scrub_destroy_vfs(CCVFS *pVfs) {
+    ccvfs_scrub_stop(pVfs);
+}
+
+int sqlite3_ccvfs_configure_scrubber(const char *zVfsName, const CCVFSScrubOptions *pOptions) {
+    CCVFS *pVfs = ccvfs_scrub_find_vfs(zVfsName);
+    CCVFSScrubOptions options;
+    CCVFSScrubber *p;
+    int rc = SQLITE_OK;
+
+    if (!pVfs) {
+        return SQLITE_ERROR;
+    }
+    if (!pOptions) {
+        ccvfs_scrub_stop(pVfs);
+        CCVFS_DEBUG("Scrubber of %s stopped", zVfsName);
+        return SQLITE_OK;
+    }
+    options = *pOptions;
+    if (options.io_budget_kb == 0) {
+        options.io_budget_kb = CCVFS_SCRUB_DEFAULT_BUDGET_KB;
+    }
+    if (options.pass_interval_ms == 0) {
+        options.pass_interval_ms = CCVFS_SCRUB_DEFAULT_INTERVAL_MS;
+    }
+
+    sqlite3_mutex_enter(pVfs->files_mutex);
+    p = pVfs->pScrubber;
+    if (p) {
+        pthread_mutex_lock(&p->mutex);
+        p->options = options;
+        pthread_cond_signal(&p->wake);
+        pthread_mutex_unlock(&p->mutex);
+    } else {
+        p = (CCVFSScrubber*)sqlite3_malloc(sizeof(CCVFSScrubber));
+        if (!p) {
+            rc = SQLITE_NOMEM;
+        } else {
+            memset(p, 0, sizeof(CCVFSScrubber));
+            p->pVfs = pVfs;
+            p->options = options;
+            pthread_mutex_init(&p->mutex, NULL);
+            pthread_cond_init(&p->wake, NULL);
+            // 线程在本函数释放files_mutex之后才开始巡检
+            // The thread starts scrubbing once this function releases files_mutex
+            if (pthread_create(&p->thread, NULL, ccvfs_scrub_main, p) != 0) {
+                pthread_cond_destroy(&p->wake);
+                pthread_mutex_destroy(&p->mutex);
+                sqlite3_free(p);
+                rc = SQLITE_ERROR;
+            } else {
+                pVfs->pScrubber = p;
+            }
+        }
+    }
+    if (rc == SQLITE_OK) {
+        CCVFS_COUNTER_SET(pVfs->scrub_trust_ms, options.trust_window_ms);
+    }
+    sqlite3_mutex_leave(pVfs->files_mutex);
+
+    CCVFS_DEBUG("Scrubber of %s: budget=%uKB/s, interval=%ums, trust window=%ums, rc=%d", zVfsName,
+                options.io_budget_kb, options.pass_interval_ms, options.trust_window_ms, rc);
+    return rc;
+}
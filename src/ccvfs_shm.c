@@ -0,0 +1,341 @@
+#include "ccvfs_shm.h"
+#include "ccvfs_io.h"
+
+/*
+ * 共享页索引
+ * 权威索引保存在伴随文件 "<db>-ccvfs" 的共享内存映射中（通过底层VFS的xShmMap/xShmLock），
+ * 所有进程直接读取同一份索引，而不是每个连接各自保存一份完整副本。
+ * 读取者在持有数据库SHARED锁时使用映射；写入者在修改前复制一份私有索引，
+ * 保存索引后再把变化的块发布回映射。
+ *
+ * Shared page index
+ * The authoritative index lives in a shared mapping of the companion file "<db>-ccvfs"
+ * (through the root VFS xShmMap/xShmLock), so every process reads one copy of the index
+ * instead of each connection holding its own full copy.
+ * Readers use the mapping while holding the database SHARED lock; writers take a private
+ * copy before modifying it and publish the changed blocks back after saving the index.
+ */
+
+static CCVFSPageIndex *ccvfs_shm_entries(CCVFSFile *pFile) {
+    return (CCVFSPageIndex*)((char*)pFile->pShm + CCVFS_SHM_HEADER_SIZE);
+}
+
+static int ccvfs_shm_is_valid(CCVFSFile *pFile) {
+    return memcmp((const char*)pFile->pShm->magic, CCVFS_SHM_MAGIC, 8) == 0;
+}
+
+static int ccvfs_shm_lock(CCVFSFile *pFile, int flags) {
+    return pFile->pShmFile->pMethods->xShmLock(pFile->pShmFile, CCVFS_SHM_INDEX_LOCK, 1, flags);
+}
+
+/*
+ * 打开伴随文件并映射共享索引区域
+ * 失败时不影响数据库打开，调用者退回到私有索引
+ * Open the companion file and map the shared index region
+ * Failure does not fail the database open; the caller falls back to a private index
+ */
+int ccvfs_shm_open(CCVFSFile *pFile, const char *zDbName) {
+    sqlite3_vfs *pRootVfs = pFile->pOwner->pRootVfs;
+    sqlite3_file *pShmFile;
+    void volatile *pMap = NULL;
+    char *zPath;
+    int outFlags = 0;
+    int rc;
+
+    if (!zDbName || pRootVfs->iVersion < 1) {
+        return SQLITE_OK;
+    }
+
+    // 底层VFS要求文件名来自sqlite3_create_filename()
+    // The root VFS requires a filename built by sqlite3_create_filename()
+    zPath = sqlite3_mprintf("%s%s", zDbName, CCVFS_SHM_SUFFIX);
+    if (!zPath) {
+        return SQLITE_NOMEM;
+    }
+    pFile->zShmName = (char*)sqlite3_create_filename(zPath, "", "", 0, NULL);
+    sqlite3_free(zPath);
+    if (!pFile->zShmName) {
+        return SQLITE_NOMEM;
+    }
+
+    pShmFile = (sqlite3_file*)sqlite3_malloc(pRootVfs->szOsFile);
+    if (!pShmFile) {
+        sqlite3_free_filename(pFile->zShmName);
+        pFile->zShmName = NULL;
+        return SQLITE_NOMEM;
+    }
+    memset(pShmFile, 0, pRootVfs->szOsFile);
+
+    rc = pRootVfs->xOpen(pRootVfs, pFile->zShmName, pShmFile,
+                         SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_MAIN_DB, &outFlags);
+    if (rc == SQLITE_OK) {
+        if (pShmFile->pMethods->iVersion < 2 || !pShmFile->pMethods->xShmMap) {
+            CCVFS_DEBUG("Root VFS has no shared memory support, shared index disabled");
+            rc = SQLITE_NOTFOUND;
+        } else {
+            rc = pShmFile->pMethods->xShmMap(pShmFile, 0, CCVFS_SHM_REGION_SIZE, 1, &pMap);
+            if (rc == SQLITE_OK && !pMap) {
+                rc = SQLITE_IOERR_SHMMAP;
+            }
+        }
+    }
+
+    if (rc != SQLITE_OK) {
+        CCVFS_DEBUG("Shared index unavailable for %s: %d", zDbName, rc);
+        if (pShmFile->pMethods) {
+            pShmFile->pMethods->xClose(pShmFile);
+        }
+        sqlite3_free(pShmFile);
+        sqlite3_free_filename(pFile->zShmName);
+        pFile->zShmName = NULL;
+        return rc;
+    }
+
+    pFile->pShmFile = pShmFile;
+    pFile->pShm = (CCVFSShmHeader volatile*)pMap;
+
+    CCVFS_DEBUG("Shared index mapped for %s (%d bytes)", zDbName, CCVFS_SHM_REGION_SIZE);
+    return SQLITE_OK;
+}
+
+/*
+ * 取消映射并关闭伴随文件
+ * Unmap the shared index and close the companion file
+ */
+void ccvfs_shm_close(CCVFSFile *pFile) {
+    if (pFile->index_shared) {
+        pFile->pPageIndex = NULL;
+        pFile->index_shared = 0;
+    }
+
+    if (pFile->pShmFile) {
+        if (pFile->pShm) {
+            pFile->pShmFile->pMethods->xShmUnmap(pFile->pShmFile, 0);
+        }
+        pFile->pShmFile->pMethods->xClose(pFile->pShmFile);
+        sqlite3_free(pFile->pShmFile);
+    }
+    if (pFile->zShmName) {
+        sqlite3_free_filename(pFile->zShmName);
+    }
+
+    pFile->pShmFile = NULL;
+    pFile->pShm = NULL;
+    pFile->zShmName = NULL;
+}
+
+/*
+ * 从磁盘重建共享索引（调用者持有共享索引的EXCLUSIVE锁）
+ * 如果映射只落后一代，只读取文件头掩码中标记的块
+ * Rebuild the shared index from disk (caller holds the shared index EXCLUSIVE lock)
+ * If the mapping is exactly one generation behind, only the blocks in the header mask are read
+ */
+static int ccvfs_shm_rebuild(CCVFSFile *pFile, const CCVFSFileHeader *pDiskHeader) {
+    CCVFSShmHeader volatile *pShm = pFile->pShm;
+    CCVFSPageIndex *aEntry = ccvfs_shm_entries(pFile);
+    int incremental = ccvfs_shm_is_valid(pFile) &&
+                      pShm->generation + 1 == pDiskHeader->change_counter;
+    uint32_t oldTotal = incremental ? pShm->total_pages : 0;
+    uint32_t newTotal = pDiskHeader->total_pages;
+    uint32_t blocksRead = 0;
+    int rc;
+
+    if (newTotal > CCVFS_MAX_PAGES) {
+        CCVFS_ERROR("Invalid page count in header: %u", newTotal);
+        return SQLITE_CORRUPT;
+    }
+
+    // 重建期间标记为无效，进程在中途崩溃时下一个读取者会完整重建
+    // Invalid while rebuilding, so a crash midway makes the next reader rebuild fully
+    memset((char*)pShm->magic, 0, sizeof(pShm->magic));
+    pFile->pShmFile->pMethods->xShmBarrier(pFile->pShmFile);
+
+    for (uint32_t block = 0; block < CCVFS_INDEX_BLOCK_COUNT; block++) {
+        uint32_t firstPage = block * CCVFS_INDEX_BLOCK_PAGES;
+        if (firstPage >= newTotal) {
+            break;
+        }
+
+        uint32_t pageCount = newTotal - firstPage;
+        if (pageCount > CCVFS_INDEX_BLOCK_PAGES) {
+            pageCount = CCVFS_INDEX_BLOCK_PAGES;
+        }
+
+        if (incremental && firstPage + pageCount <= oldTotal &&
+            !ccvfs_index_mask_test(pDiskHeader->index_change_mask, block)) {
+            continue;
+        }
+
+        rc = pFile->pReal->pMethods->xRead(pFile->pReal, &aEntry[firstPage],
+                                           pageCount * sizeof(CCVFSPageIndex),
+                                           pDiskHeader->index_table_offset +
+                                           (sqlite3_int64)firstPage * sizeof(CCVFSPageIndex));
+        if (rc != SQLITE_OK) {
+            CCVFS_ERROR("Failed to read index block %u into shared index: %d", block, rc);
+            return rc;
+        }
+        blocksRead++;
+    }
+
+    pShm->generation = pDiskHeader->change_counter;
+    pShm->total_pages = newTotal;
+    pFile->pShmFile->pMethods->xShmBarrier(pFile->pShmFile);
+    memcpy((char*)pShm->magic, CCVFS_SHM_MAGIC, sizeof(pShm->magic));
+
+    CCVFS_DEBUG("Shared index rebuilt to generation %u: %u blocks read (%s)",
+               pDiskHeader->change_counter, blocksRead, incremental ? "incremental" : "full");
+    return SQLITE_OK;
+}
+
+/*
+ * 让本连接使用共享索引（调用者持有数据库SHARED锁）
+ * 共享索引过期时先从磁盘更新；另一个进程正在更新时返回SQLITE_BUSY
+ * Make this connection use the shared index (caller holds the database SHARED lock)
+ * The mapping is brought up to date from disk first if stale; returns SQLITE_BUSY while another process updates it
+ */
+int ccvfs_shm_attach_index(CCVFSFile *pFile, const CCVFSFileHeader *pDiskHeader) {
+    CCVFSShmHeader volatile *pShm = pFile->pShm;
+    int current;
+    int rc;
+
+    if (!pShm) {
+        return SQLITE_BUSY;
+    }
+
+    rc = ccvfs_shm_lock(pFile, SQLITE_SHM_LOCK | SQLITE_SHM_SHARED);
+    if (rc != SQLITE_OK) {
+        return SQLITE_BUSY;
+    }
+    current = ccvfs_shm_is_valid(pFile) &&
+              pShm->generation == pDiskHeader->change_counter &&
+              pShm->total_pages == pDiskHeader->total_pages;
+    ccvfs_shm_lock(pFile, SQLITE_SHM_UNLOCK | SQLITE_SHM_SHARED);
+
+    if (!current) {
+        rc = ccvfs_shm_lock(pFile, SQLITE_SHM_LOCK | SQLITE_SHM_EXCLUSIVE);
+        if (rc != SQLITE_OK) {
+            return SQLITE_BUSY;
+        }
+
+        // 获取锁期间其他进程可能已经完成了更新
+        // Another process may have finished the update while we waited
+        current = ccvfs_shm_is_valid(pFile) &&
+                  pShm->generation == pDiskHeader->change_counter &&
+                  pShm->total_pages == pDiskHeader->total_pages;
+        if (!current) {
+            rc = ccvfs_shm_rebuild(pFile, pDiskHeader);
+        }
+        ccvfs_shm_lock(pFile, SQLITE_SHM_UNLOCK | SQLITE_SHM_EXCLUSIVE);
+        if (rc != SQLITE_OK) {
+            return rc;
+        }
+    }
+
+    // 索引代变化时，缓冲区中的干净副本和本地空洞列表都已过期
+    // When the generation changed, clean buffered copies and the local hole list are stale
+    if (pFile->index_generation != pDiskHeader->change_counter) {
+        ccvfs_buffer_discard_clean(pFile, 0, UINT32_MAX);
+        if (pFile->hole_manager.enabled) {
+            ccvfs_cleanup_hole_manager(pFile);
+            ccvfs_init_hole_manager(pFile);
+        }
+    }
+
+    if (!pFile->index_shared && pFile->pPageIndex) {
+        sqlite3_free(pFile->pPageIndex);
+    }
+    pFile->pPageIndex = ccvfs_shm_entries(pFile);
+    pFile->index_capacity = CCVFS_MAX_PAGES;
+    pFile->index_shared = 1;
+    pFile->header = *pDiskHeader;
+    pFile->index_generation = pDiskHeader->change_counter;
+    memset(pFile->index_dirty_blocks, 0, sizeof(pFile->index_dirty_blocks));
+
+    CCVFS_VERBOSE("Attached to shared index at generation %u", pFile->index_generation);
+    return SQLITE_OK;
+}
+
+/*
+ * 写入前把共享索引复制为私有索引
+ * Copy the shared index into a private index before writing
+ */
+int ccvfs_shm_detach_index(CCVFSFile *pFile) {
+    CCVFSPageIndex *pPrivate;
+    uint32_t capacity;
+
+    if (!pFile->index_shared) {
+        return SQLITE_OK;
+    }
+
+    capacity = pFile->header.total_pages + 16;
+    pPrivate = (CCVFSPageIndex*)sqlite3_malloc(capacity * sizeof(CCVFSPageIndex));
+    if (!pPrivate) {
+        CCVFS_ERROR("Failed to allocate private page index: %u entries", capacity);
+        return SQLITE_NOMEM;
+    }
+    memset(pPrivate, 0, capacity * sizeof(CCVFSPageIndex));
+    memcpy(pPrivate, pFile->pPageIndex, pFile->header.total_pages * sizeof(CCVFSPageIndex));
+
+    pFile->pPageIndex = pPrivate;
+    pFile->index_capacity = capacity;
+    pFile->index_shared = 0;
+
+    CCVFS_DEBUG("Detached from shared index for writing: %u entries", pFile->header.total_pages);
+    return SQLITE_OK;
+}
+
+/*
+ * 索引保存后把变化的块发布到共享索引
+ * 无法获得锁时跳过：映射的索引代与文件头不一致，读取者会从磁盘重建
+ * Publish changed blocks to the shared index after the index was saved
+ * Skipped if the lock is unavailable: the mapping generation then differs from the header and readers rebuild it from disk
+ */
+void ccvfs_shm_publish_index(CCVFSFile *pFile) {
+    CCVFSShmHeader volatile *pShm = pFile->pShm;
+    CCVFSPageIndex *aEntry;
+    uint32_t newTotal = pFile->header.total_pages;
+
+    if (!pShm || pFile->index_shared || !pFile->pPageIndex) {
+        return;
+    }
+    if (ccvfs_shm_lock(pFile, SQLITE_SHM_LOCK | SQLITE_SHM_EXCLUSIVE) != SQLITE_OK) {
+        CCVFS_DEBUG("Shared index busy, readers will rebuild generation %u from disk",
+                   pFile->header.change_counter);
+        return;
+    }
+
+    aEntry = ccvfs_shm_entries(pFile);
+    int incremental = ccvfs_shm_is_valid(pFile) &&
+                      pShm->generation + 1 == pFile->header.change_counter;
+    uint32_t oldTotal = incremental ? pShm->total_pages : 0;
+
+    memset((char*)pShm->magic, 0, sizeof(pShm->magic));
+    pFile->pShmFile->pMethods->xShmBarrier(pFile->pShmFile);
+
+    for (uint32_t block = 0; block < CCVFS_INDEX_BLOCK_COUNT; block++) {
+        uint32_t firstPage = block * CCVFS_INDEX_BLOCK_PAGES;
+        if (firstPage >= newTotal) {
+            break;
+        }
+
+        uint32_t pageCount = newTotal - firstPage;
+        if (pageCount > CCVFS_INDEX_BLOCK_PAGES) {
+            pageCount = CCVFS_INDEX_BLOCK_PAGES;
+        }
+
+        if (incremental && firstPage + pageCount <= oldTotal &&
+            !ccvfs_index_mask_test(pFile->header.index_change_mask, block)) {
+            continue;
+        }
+        memcpy(&aEntry[firstPage], &pFile->pPageIndex[firstPage], pageCount * sizeof(CCVFSPageIndex));
+    }
+
+    pShm->generation = pFile->header.change_counter;
+    pShm->total_pages = newTotal;
+    pFile->pShmFile->pMethods->xShmBarrier(pFile->pShmFile);
+    memcpy((char*)pShm->magic, CCVFS_SHM_MAGIC, sizeof(pShm->magic));
+
+    ccvfs_shm_lock(pFile, SQLITE_SHM_UNLOCK | SQLITE_SHM_EXCLUSIVE);
+
+    CCVFS_DEBUG("Published index generation %u to shared index", pFile->header.change_counter);
+}
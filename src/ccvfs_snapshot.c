@@ -0,0 +1,343 @@
+#include "ccvfs_snapshot.h"
+#include "ccvfs_io.h"
+
+/*
+ * 索引快照
+ * 写入者在每次修改调用结束时发布一个只读的索引版本。未变化的索引块在新旧版本之间共享，
+ * 因此发布只复制本次修改过的块。读取者在短暂持有snapshot_mutex时固定当前版本，
+ * 之后不持有任何锁读取页面，即使写入者正在执行很长的刷新也不会被阻塞。
+ * 写入者不再原地覆盖快照可见的页面数据：页面改写到新空间，旧空间按发布代延迟释放，
+ * 直到没有存活的快照可能读取它时才交还空洞管理器。
+ *
+ * Index snapshots
+ * Writers publish a read-only version of the index at the end of every modifying call.
+ * Unchanged index blocks are shared between versions, so a publish only copies the blocks
+ * changed since the previous one. Readers pin the current version while briefly holding
+ * snapshot_mutex and then read pages without any lock, so a long flush never blocks them.
+ * Writers no longer overwrite page data a snapshot can see: the page moves to new space and
+ * the old extent is deferred by epoch, returning to the hole manager only once no live
+ * snapshot can read it.
+ */
+
+/*
+ * 计算块中有效条目数
+ * Number of valid entries in a block for the given page count
+ */
+static uint32_t ccvfs_snapshot_block_entries(uint32_t totalPages, uint32_t block) {
+    uint32_t firstPage = block * CCVFS_INDEX_BLOCK_PAGES;
+
+    if (firstPage >= totalPages) {
+        return 0;
+    }
+    if (totalPages - firstPage < CCVFS_INDEX_BLOCK_PAGES) {
+        return totalPages - firstPage;
+    }
+    return CCVFS_INDEX_BLOCK_PAGES;
+}
+
+/*
+ * 释放快照及其不再被引用的块（调用者持有snapshot_mutex）
+ * Free a snapshot and the blocks no other snapshot references (caller holds snapshot_mutex)
+ */
+static void ccvfs_snapshot_free_locked(CCVFSFile *pFile, CCVFSIndexSnapshot *pSnap) {
+    CCVFSIndexSnapshot **ppLive = &pFile->pLiveSnapshots;
+
+    while (*ppLive && *ppLive != pSnap) {
+        ppLive = &(*ppLive)->next;
+    }
+    if (*ppLive) {
+        *ppLive = pSnap->next;
+    }
+
+    for (uint32_t block = 0; block < CCVFS_INDEX_BLOCK_COUNT; block++) {
+        CCVFSIndexBlock *pBlock = pSnap->blocks[block];
+        if (pBlock && --pBlock->ref_count == 0) {
+            sqlite3_free(pBlock);
+        }
+    }
+    sqlite3_free(pSnap);
+}
+
+/*
+ * 发布失败或无法发布时，让读取者回退到索引锁
+ * Make readers fall back to the index lock when a snapshot cannot be published
+ */
+static void ccvfs_snapshot_mark_stale(CCVFSFile *pFile) {
+    if (!pFile->pSnapshot || pFile->snapshot_stale) {
+        return;
+    }
+    sqlite3_mutex_enter(pFile->snapshot_mutex);
+    pFile->snapshot_stale = 1;
+    sqlite3_mutex_leave(pFile->snapshot_mutex);
+}
+
+/*
+ * 发布当前索引的新版本（调用者持有独占索引锁）
+ * 只复制自上次发布以来变化的块；索引和逻辑大小都未变化时只回收延迟空间
+ * Publish a new version of the current index (caller holds the exclusive index lock)
+ * Only blocks changed since the last publish are copied; with nothing changed only deferred space is reclaimed
+ */
+void ccvfs_snapshot_publish(CCVFSFile *pFile) {
+    CCVFSIndexSnapshot *pOld = pFile->pSnapshot;
+    CCVFSIndexSnapshot *pNew;
+    uint32_t totalPages = pFile->header.total_pages;
+    uint32_t blockCount;
+    int shared[CCVFS_INDEX_BLOCK_COUNT];
+
+    // 快照依赖空洞管理器回收旧空间；没有它时读取者使用索引锁
+    // Snapshots rely on the hole manager to reclaim old space; without it readers use the index lock
+    if (!pFile->is_ccvfs_file || !pFile->header_loaded || !pFile->pPageIndex ||
+        !pFile->hole_manager.enabled || totalPages > CCVFS_MAX_PAGES) {
+        ccvfs_snapshot_mark_stale(pFile);
+        return;
+    }
+
+    if (pOld && !pFile->snapshot_stale && !ccvfs_index_mask_any(pFile->snapshot_dirty_blocks) &&
+        pOld->total_pages == totalPages &&
+        pOld->database_size_pages == pFile->header.database_size_pages) {
+        ccvfs_snapshot_reclaim(pFile);
+        return;
+    }
+
+    pNew = (CCVFSIndexSnapshot*)sqlite3_malloc(sizeof(CCVFSIndexSnapshot));
+    if (!pNew) {
+        CCVFS_ERROR("Failed to allocate index snapshot");
+        ccvfs_snapshot_mark_stale(pFile);
+        return;
+    }
+    memset(pNew, 0, sizeof(CCVFSIndexSnapshot));
+    memset(shared, 0, sizeof(shared));
+    pNew->ref_count = 1;
+    pNew->page_size = pFile->header.page_size;
+    pNew->total_pages = totalPages;
+    pNew->database_size_pages = pFile->header.database_size_pages;
+
+    blockCount = (totalPages + CCVFS_INDEX_BLOCK_PAGES - 1) / CCVFS_INDEX_BLOCK_PAGES;
+    for (uint32_t block = 0; block < blockCount; block++) {
+        uint32_t entries = ccvfs_snapshot_block_entries(totalPages, block);
+
+        // 未修改且有效范围相同的块直接共享
+        // Share blocks that did not change and cover the same range
+        if (pOld && pOld->blocks[block] &&
+            !ccvfs_index_mask_test(pFile->snapshot_dirty_blocks, block) &&
+            ccvfs_snapshot_block_entries(pOld->total_pages, block) == entries) {
+            pNew->blocks[block] = pOld->blocks[block];
+            shared[block] = 1;
+            continue;
+        }
+
+        CCVFSIndexBlock *pBlock = (CCVFSIndexBlock*)sqlite3_malloc(sizeof(CCVFSIndexBlock));
+        if (!pBlock) {
+            CCVFS_ERROR("Failed to allocate index snapshot block %u", block);
+            for (uint32_t i = 0; i < block; i++) {
+                if (!shared[i]) {
+                    sqlite3_free(pNew->blocks[i]);
+                }
+            }
+            sqlite3_free(pNew);
+            ccvfs_snapshot_mark_stale(pFile);
+            return;
+        }
+        pBlock->ref_count = 1;
+        memcpy(pBlock->entries, &pFile->pPageIndex[block * CCVFS_INDEX_BLOCK_PAGES],
+               entries * sizeof(CCVFSPageIndex));
+        memset(&pBlock->entries[entries], 0,
+               (CCVFS_INDEX_BLOCK_PAGES - entries) * sizeof(CCVFSPageIndex));
+        pNew->blocks[block] = pBlock;
+    }
+
+    // 只在交换指针时持有快照锁
+    // The snapshot lock is only held to swap the pointer
+    sqlite3_mutex_enter(pFile->snapshot_mutex);
+    for (uint32_t block = 0; block < blockCount; block++) {
+        if (shared[block]) {
+            pNew->blocks[block]->ref_count++;
+        }
+    }
+    pNew->epoch = ++pFile->snapshot_epoch;
+    CCVFSIndexSnapshot **ppLive = &pFile->pLiveSnapshots;
+    while (*ppLive) {
+        ppLive = &(*ppLive)->next;
+    }
+    *ppLive = pNew;
+    pFile->pSnapshot = pNew;
+    pFile->snapshot_stale = 0;
+    sqlite3_mutex_leave(pFile->snapshot_mutex);
+
+    memset(pFile->snapshot_dirty_blocks, 0, sizeof(pFile->snapshot_dirty_blocks));
+    CCVFS_VERBOSE("Published index snapshot %llu: %u pages",
+                  (unsigned long long)pNew->epoch, totalPages);
+
+    ccvfs_snapshot_release(pFile, pOld);
+    ccvfs_snapshot_reclaim(pFile);
+}
+
+/*
+ * 固定当前快照；没有可用快照时返回NULL，调用者改用索引锁
+ * Pin the current snapshot; returns NULL if none is usable and the caller takes the index lock instead
+ */
+CCVFSIndexSnapshot *ccvfs_snapshot_acquire(CCVFSFile *pFile) {
+    CCVFSIndexSnapshot *pSnap;
+
+    sqlite3_mutex_enter(pFile->snapshot_mutex);
+    pSnap = pFile->snapshot_stale ? NULL : pFile->pSnapshot;
+    if (pSnap) {
+        pSnap->ref_count++;
+    }
+    sqlite3_mutex_leave(pFile->snapshot_mutex);
+    return pSnap;
+}
+
+/*
+ * 释放对快照的引用
+ * Drop a reference to a snapshot
+ */
+void ccvfs_snapshot_release(CCVFSFile *pFile, CCVFSIndexSnapshot *pSnap) {
+    if (!pSnap) {
+        return;
+    }
+    sqlite3_mutex_enter(pFile->snapshot_mutex);
+    if (--pSnap->ref_count == 0) {
+        ccvfs_snapshot_free_locked(pFile, pSnap);
+    }
+    sqlite3_mutex_leave(pFile->snapshot_mutex);
+}
+
+/*
+ * 查找快照中的页索引条目；超出范围返回NULL
+ * Look up a page index entry in a snapshot; NULL when out of range
+ */
+const CCVFSPageIndex *ccvfs_snapshot_entry(const CCVFSIndexSnapshot *pSnap, uint32_t pageNum) {
+    const CCVFSIndexBlock *pBlock;
+
+    if (pageNum >= pSnap->total_pages) {
+        return NULL;
+    }
+    pBlock = pSnap->blocks[pageNum / CCVFS_INDEX_BLOCK_PAGES];
+    return pBlock ? &pBlock->entries[pageNum % CCVFS_INDEX_BLOCK_PAGES] : NULL;
+}
+
+/*
+ * 关闭文件时释放所有快照和延迟空间
+ * Free all snapshots and deferred extents when the file is closed
+ */
+void ccvfs_snapshot_cleanup(CCVFSFile *pFile) {
+    sqlite3_mutex_enter(pFile->snapshot_mutex);
+    if (pFile->pSnapshot && --pFile->pSnapshot->ref_count == 0) {
+        ccvfs_snapshot_free_locked(pFile, pFile->pSnapshot);
+    }
+    pFile->pSnapshot = NULL;
+    while (pFile->pLiveSnapshots) {
+        CCVFS_ERROR("Index snapshot %llu still pinned at close",
+                    (unsigned long long)pFile->pLiveSnapshots->epoch);
+        ccvfs_snapshot_free_locked(pFile, pFile->pLiveSnapshots);
+    }
+    sqlite3_mutex_leave(pFile->snapshot_mutex);
+
+    ccvfs_snapshot_forget_deferred(pFile);
+}
+
+/*
+ * 检查页面当前的物理位置是否在已发布的快照中可见
+ * 当前位置只可能被当前快照引用：之后分配的空间来自空洞或文件末尾，不会被任何存活快照引用
+ * Check whether the page's current extent is visible in the published snapshot
+ * Only the current snapshot can reference it: space allocated since then came from holes or EOF,
+ * which no live snapshot references
+ */
+int ccvfs_snapshot_extent_published(CCVFSFile *pFile, uint32_t pageNum, sqlite3_int64 offset) {
+    const CCVFSPageIndex *pEntry;
+
+    if (!pFile->pSnapshot || offset == 0) {
+        return 0;
+    }
+    pEntry = ccvfs_snapshot_entry(pFile->pSnapshot, pageNum);
+    return pEntry && (sqlite3_int64)pEntry->physical_offset == offset;
+}
+
+/*
+ * 推迟释放快照仍可读取的空间（调用者持有alloc_mutex）
+ * 分配失败时该空间被泄漏而不是过早重用
+ * Defer freeing space a snapshot can still read (caller holds alloc_mutex)
+ * On allocation failure the space is leaked rather than reused too early
+ */
+int ccvfs_snapshot_defer_extent(CCVFSFile *pFile, sqlite3_int64 offset, uint32_t size) {
+    CCVFSDeferredExtent *pExtent;
+
+    pExtent = (CCVFSDeferredExtent*)sqlite3_malloc(sizeof(CCVFSDeferredExtent));
+    if (!pExtent) {
+        CCVFS_ERROR("Failed to defer extent [%llu,%u], space leaked",
+                    (unsigned long long)offset, size);
+        return SQLITE_NOMEM;
+    }
+    pExtent->offset = offset;
+    pExtent->size = size;
+    pExtent->epoch = pFile->pSnapshot ? pFile->pSnapshot->epoch : pFile->snapshot_epoch;
+    pExtent->next = pFile->pDeferred;
+    pFile->pDeferred = pExtent;
+
+    CCVFS_DEBUG("Deferred extent [%llu,%u] until snapshot %llu is released",
+                (unsigned long long)offset, size, (unsigned long long)pExtent->epoch);
+    return SQLITE_OK;
+}
+
+/*
+ * 检查范围是否与延迟释放的空间重叠（调用者持有alloc_mutex）
+ * Check whether a range overlaps deferred space (caller holds alloc_mutex)
+ */
+int ccvfs_snapshot_range_deferred(CCVFSFile *pFile, sqlite3_int64 offset, uint32_t size) {
+    for (CCVFSDeferredExtent *pExtent = pFile->pDeferred; pExtent; pExtent = pExtent->next) {
+        if (offset < pExtent->offset + pExtent->size && offset + size > pExtent->offset) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * 把不再被任何存活快照引用的延迟空间交还空洞管理器
+ * Hand deferred space no live snapshot references back to the hole manager
+ */
+void ccvfs_snapshot_reclaim(CCVFSFile *pFile) {
+    uint64_t oldestLive;
+    uint32_t reclaimed = 0;
+
+    if (!pFile->pDeferred) {
+        return;
+    }
+
+    sqlite3_mutex_enter(pFile->snapshot_mutex);
+    oldestLive = pFile->pLiveSnapshots ? pFile->pLiveSnapshots->epoch : pFile->snapshot_epoch + 1;
+    sqlite3_mutex_leave(pFile->snapshot_mutex);
+
+    sqlite3_mutex_enter(pFile->alloc_mutex);
+    CCVFSDeferredExtent **ppExtent = &pFile->pDeferred;
+    while (*ppExtent) {
+        CCVFSDeferredExtent *pExtent = *ppExtent;
+        if (pExtent->epoch < oldestLive) {
+            *ppExtent = pExtent->next;
+            ccvfs_add_hole(pFile, pExtent->offset, pExtent->size);
+            sqlite3_free(pExtent);
+            reclaimed++;
+        } else {
+            ppExtent = &pExtent->next;
+        }
+    }
+    sqlite3_mutex_leave(pFile->alloc_mutex);
+
+    if (reclaimed > 0) {
+        CCVFS_DEBUG("Reclaimed %u deferred extents older than snapshot %llu",
+                    reclaimed, (unsigned long long)oldestLive);
+    }
+}
+
+/*
+ * 丢弃延迟空间列表（空洞列表被重建时，调用者持有alloc_mutex）
+ * Drop the deferred list (when the hole list is rebuilt; caller holds alloc_mutex)
+ */
+void ccvfs_snapshot_forget_deferred(CCVFSFile *pFile) {
+    while (pFile->pDeferred) {
+        CCVFSDeferredExtent *pNext = pFile->pDeferred->next;
+        sqlite3_free(pFile->pDeferred);
+        pFile->pDeferred = pNext;
+    }
+}
@@ -0,0 +1,151 @@
+#include "ccvfs_stats.h"
+
+/*
+ * 统计计数器
+ * 热路径只对CCVFSCounters做宽松原子递增，不持有任何锁。需要一致视图时，
+ * 在持有索引写锁和缓冲锁的情况下复制计数器：所有写路径计数器和缓冲命中计数器在复制期间
+ * 静止，相关计数器（例如分配次数和空洞复用次数）来自同一时刻。
+ * 每个VFS维护一个打开文件列表；文件关闭时其最终计数并入VFS的累计值，因此VFS总计只增不减。
+ *
+ * Statistics counters
+ * The hot path only does relaxed atomic increments on CCVFSCounters, without any lock.
+ * A consistent view is copied while holding the index write lock and the buffer lock: all
+ * write path counters and the buffer hit counter are quiet meanwhile, so related counters
+ * (e.g. allocations and hole reuse) come from the same moment.
+ * Every VFS keeps a list of its open files; a closing file folds its final counters into the
+ * VFS totals, so the VFS totals never go backwards.
+ */
+
+/*
+ * 累加一个文件的计数器
+ * Add the counters of one file to a statistics structure
+ */
+static void ccvfs_stats_add(CCVFSFileStats *pStats, CCVFSCounters *pCounters) {
+    pStats->space_reuse_count += CCVFS_COUNTER_GET(pCounters->space_reuse_count);
+    pStats->space_expansion_count += CCVFS_COUNTER_GET(pCounters->space_expansion_count);
+    pStats->new_allocation_count += CCVFS_COUNTER_GET(pCounters->new_allocation_count);
+    pStats->hole_reclaim_count += CCVFS_COUNTER_GET(pCounters->hole_reclaim_count);
+    pStats->best_fit_count += CCVFS_COUNTER_GET(pCounters->best_fit_count);
+    pStats->sequential_write_count += CCVFS_COUNTER_GET(pCounters->sequential_write_count);
+    pStats->cow_relocation_count += CCVFS_COUNTER_GET(pCounters->cow_relocation_count);
+
+    pStats->hole_allocation_count += CCVFS_COUNTER_GET(pCounters->hole_allocation_count);
+    pStats->hole_merge_count += CCVFS_COUNTER_GET(pCounters->hole_merge_count);
+    pStats->hole_cleanup_count += CCVFS_COUNTER_GET(pCounters->hole_cleanup_count);
+
+    pStats->buffer_hit_count += CCVFS_COUNTER_GET(pCounters->buffer_hit_count);
+    pStats->buffer_flush_count += CCVFS_COUNTER_GET(pCounters->buffer_flush_count);
+    pStats->buffer_merge_count += CCVFS_COUNTER_GET(pCounters->buffer_merge_count);
+    pStats->total_buffered_writes += CCVFS_COUNTER_GET(pCounters->total_buffered_writes);
+
+    pStats->checksum_error_count += CCVFS_COUNTER_GET(pCounters->checksum_error_count);
+    pStats->corrupted_page_count += CCVFS_COUNTER_GET(pCounters->corrupted_page_count);
+    pStats->recovery_attempt_count += CCVFS_COUNTER_GET(pCounters->recovery_attempt_count);
+    pStats->successful_recovery_count += CCVFS_COUNTER_GET(pCounters->successful_recovery_count);
+
+    pStats->scrubbed_block_count += CCVFS_COUNTER_GET(pCounters->scrubbed_block_count);
+    pStats->scrubbed_bytes += CCVFS_COUNTER_GET(pCounters->scrubbed_bytes);
+    pStats->scrub_pass_count += CCVFS_COUNTER_GET(pCounters->scrub_pass_count);
+    pStats->trusted_read_count += CCVFS_COUNTER_GET(pCounters->trusted_read_count);
+}
+
+/*
+ * 在写入者静止时累加一个文件的计数器
+ * Add the counters of one file while its writers are held off
+ */
+static void ccvfs_stats_add_quiesced(CCVFSFileStats *pStats, CCVFSFile *pFile) {
+    ccvfs_rwlock_write_enter(&pFile->index_lock);
+    sqlite3_mutex_enter(pFile->buffer_mutex);
+    ccvfs_stats_add(pStats, &pFile->counters);
+    sqlite3_mutex_leave(pFile->buffer_mutex);
+    ccvfs_rwlock_write_leave(&pFile->index_lock);
+}
+
+/*
+ * 初始化VFS的打开文件列表
+ * Initialize the open file list of a VFS
+ */
+int ccvfs_stats_init_vfs(CCVFS *pVfs) {
+    pVfs->files_mutex = sqlite3_mutex_alloc(SQLITE_MUTEX_FAST);
+    pVfs->pOpenFiles = NULL;
+    memset(&pVfs->retired, 0, sizeof(pVfs->retired));
+    if (!pVfs->files_mutex && sqlite3_threadsafe()) {
+        return SQLITE_NOMEM;
+    }
+    return SQLITE_OK;
+}
+
+void ccvfs_stats_destroy_vfs(CCVFS *pVfs) {
+    if (pVfs->files_mutex) {
+        sqlite3_mutex_free(pVfs->files_mutex);
+        pVfs->files_mutex = NULL;
+    }
+}
+
+/*
+ * 把文件加入所属VFS的打开文件列表
+ * Link a file into the open file list of its VFS
+ */
+void ccvfs_stats_register(CCVFSFile *pFile) {
+    CCVFS *pVfs = pFile->pOwner;
+
+    if (pFile->stats_registered) {
+        return;
+    }
+    sqlite3_mutex_enter(pVfs->files_mutex);
+    pFile->pNextOpen = pVfs->pOpenFiles;
+    pVfs->pOpenFiles = pFile;
+    pFile->stats_registered = 1;
+    sqlite3_mutex_leave(pVfs->files_mutex);
+}
+
+/*
+ * 从打开文件列表移除文件，并把其最终计数并入VFS累计值
+ * Unlink a file from the open file list and fold its final counters into the VFS totals
+ */
+void ccvfs_stats_unregister(CCVFSFile *pFile) {
+    CCVFS *pVfs = pFile->pOwner;
+    CCVFSFile **ppLink;
+
+    if (!pFile->stats_registered) {
+        return;
+    }
+    sqlite3_mutex_enter(pVfs->files_mutex);
+    for (ppLink = &pVfs->pOpenFiles; *ppLink; ppLink = &(*ppLink)->pNextOpen) {
+        if (*ppLink == pFile) {
+            *ppLink = pFile->pNextOpen;
+            break;
+        }
+    }
+    ccvfs_stats_add(&pVfs->retired, &pFile->counters);
+    pFile->pNextOpen = NULL;
+    pFile->stats_registered = 0;
+    sqlite3_mutex_leave(pVfs->files_mutex);
+}
+
+/*
+ * 复制单个文件的一致计数视图
+ * Copy a consistent view of the counters of one file
+ */
+void ccvfs_stats_collect(CCVFSFile *pFile, CCVFSFileStats *pStats) {
+    memset(pStats, 0, sizeof(*pStats));
+    ccvfs_stats_add_quiesced(pStats, pFile);
+    pStats->open_files = 1;
+}
+
+/*
+ * 汇总VFS的计数：已关闭文件的累计值加上每个打开文件的一致视图
+ * Aggregate the counters of a VFS: totals of closed files plus a consistent view of each open file
+ */
+void ccvfs_stats_collect_vfs(CCVFS *pVfs, CCVFSFileStats *pStats) {
+    CCVFSFile *pFile;
+
+    sqlite3_mutex_enter(pVfs->files_mutex);
+    *pStats = pVfs->retired;
+    pStats->open_files = 0;
+    for (pFile = pVfs->pOpenFiles; pFile; pFile = pFile->pNextOpen) {
+        ccvfs_stats_add_quiesced(pStats, pFile);
+        pStats->open_files++;
+    }
+    sqlite3_mutex_leave(pVfs->files_mutex);
+}
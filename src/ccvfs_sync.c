@@ -0,0 +1,55 @@
+#include "ccvfs_sync.h"
+#include "sqlite3.h"
+
+/*
+ * 初始化读写锁
+ * Initialize reader-writer lock
+ */
+int ccvfs_rwlock_init(CCVFSRwLock *pLock) {
+    if (pthread_rwlock_init(&pLock->lock, NULL) != 0) {
+        pLock->initialized = 0;
+        return SQLITE_NOMEM;
+    }
+    pLock->initialized = 1;
+    return SQLITE_OK;
+}
+
+/*
+ * 销毁读写锁
+ * Destroy reader-writer lock
+ */
+void ccvfs_rwlock_destroy(CCVFSRwLock *pLock) {
+    if (!pLock->initialized) {
+        return;
+    }
+    pthread_rwlock_destroy(&pLock->lock);
+    pLock->initialized = 0;
+}
+
+void ccvfs_rwlock_read_enter(CCVFSRwLock *pLock) {
+    if (!pLock->initialized) {
+        return;
+    }
+    pthread_rwlock_rdlock(&pLock->lock);
+}
+
+void ccvfs_rwlock_read_leave(CCVFSRwLock *pLock) {
+    if (!pLock->initialized) {
+        return;
+    }
+    pthread_rwlock_unlock(&pLock->lock);
+}
+
+void ccvfs_rwlock_write_enter(CCVFSRwLock *pLock) {
+    if (!pLock->initialized) {
+        return;
+    }
+    pthread_rwlock_wrlock(&pLock->lock);
+}
+
+void ccvfs_rwlock_write_leave(CCVFSRwLock *pLock) {
+    if (!pLock->initialized) {
+        return;
+    }
+    pthread_rwlock_unlock(&pLock->lock);
+}
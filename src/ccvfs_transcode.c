@@ -0,0 +1,2138 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE             // O_DIRECT
+#endif
+#include "ccvfs_transcode.h"
+#include "ccvfs_utils.h"
+#include "sqlite3.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * 离线转码
+ * 并行压缩把普通SQLite数据库直接编码成CCVFS文件，并行解压把CCVFS文件直接还原成普通数据库，
+ * 重新压缩把CCVFS文件直接转成另一种配置。三者都绕过逐页的sqlite3_backup，由有序工作环在
+ * 多个线程上编解码。
+ *
+ * Offline transcoding
+ * Parallel compression encodes a plain SQLite database straight into a CCVFS file, parallel
+ * decompression restores a CCVFS file straight into a plain database and recompression turns a
+ * CCVFS file straight into another configuration. All of them bypass the page by page
+ * sqlite3_backup path and code blocks on several threads through an ordered work ring.
+ */
+
+static long get_file_size(const char *filename) {
+    struct stat st;
+    if (stat(filename, &st) == 0) {
+        return st.st_size;
+    }
+    return -1;
+}
+
+/*
+ * 有序工作环
+ * Ordered work ring
+ *
+ * 主线程按序号填充并提交槽位，工作线程并行处理，主线程再按提交顺序取回结果。
+ * The main thread fills and submits slots by sequence number, the workers process them in
+ * parallel and the main thread collects the results in submission order. A slot is busy from
+ * its submission until it is collected, so at most nSlot items are in flight.
+ */
+#define CCVFS_PIPELINE_MAX_THREADS      64
+#define CCVFS_PIPELINE_SLOTS_PER_THREAD 2
+#define CCVFS_PIPELINE_WRITE_BUFFER     (1024 * 1024)
+
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t work;          // Signalled when a slot was submitted or on shutdown
+    pthread_cond_t done;          // Signalled when a slot was processed
+    uint32_t nSlot;
+    uint32_t nSubmitted;          // Items handed to the workers
+    uint32_t nTaken;              // Next item a worker picks up
+    int shutdown;
+    int *aDone;                   // Per slot, set by the worker under the mutex
+    int *aRc;                     // Per slot result of xWork
+    int (*xWork)(void *pCtx, uint32_t iSlot);
+    void *pCtx;
+    pthread_t aThread[CCVFS_PIPELINE_MAX_THREADS];
+    int nThread;
+} CCVFSWorkRing;
+
+static void *ccvfs_ring_worker(void *pArg) {
+    CCVFSWorkRing *pRing = (CCVFSWorkRing *)pArg;
+    
+    pthread_mutex_lock(&pRing->mutex);
+    for (;;) {
+        while (!pRing->shutdown && pRing->nTaken >= pRing->nSubmitted) {
+            pthread_cond_wait(&pRing->work, &pRing->mutex);
+        }
+        if (pRing->shutdown) {
+            break;
+        }
+        uint32_t iSlot = pRing->nTaken++ % pRing->nSlot;
+        pthread_mutex_unlock(&pRing->mutex);
+        
+        int rc = pRing->xWork(pRing->pCtx, iSlot);
+        
+        pthread_mutex_lock(&pRing->mutex);
+        pRing->aRc[iSlot] = rc;
+        pRing->aDone[iSlot] = 1;
+        pthread_cond_broadcast(&pRing->done);
+    }
+    pthread_mutex_unlock(&pRing->mutex);
+    return NULL;
+}
+
+/*
+ * 线程数：0表示每个在线CPU一个，限制在1到CCVFS_PIPELINE_MAX_THREADS之间且不超过工作项数
+ * Thread count: 0 for one per online CPU, clamped to 1..CCVFS_PIPELINE_MAX_THREADS and the number of items
+ */
+static int ccvfs_ring_threads(int threads, uint32_t nItem) {
+    int n = threads > 0 ? threads : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (n < 1) n = 1;
+    if (n > CCVFS_PIPELINE_MAX_THREADS) n = CCVFS_PIPELINE_MAX_THREADS;
+    if (nItem > 0 && (uint32_t)n > nItem) n = (int)nItem;
+    return n;
+}
+
+static int ccvfs_ring_start(CCVFSWorkRing *pRing, int nThread,
+                            int (*xWork)(void *pCtx, uint32_t iSlot), void *pCtx) {
+    memset(pRing, 0, sizeof(*pRing));
+    pRing->nSlot = (uint32_t)nThread * CCVFS_PIPELINE_SLOTS_PER_THREAD;
+    pRing->xWork = xWork;
+    pRing->pCtx = pCtx;
+    pRing->aDone = (int *)sqlite3_malloc64(sizeof(int) * pRing->nSlot * 2);
+    if (!pRing->aDone) {
+        return SQLITE_NOMEM;
+    }
+    memset(pRing->aDone, 0, sizeof(int) * pRing->nSlot * 2);
+    pRing->aRc = pRing->aDone + pRing->nSlot;
+    
+    pthread_mutex_init(&pRing->mutex, NULL);
+    pthread_cond_init(&pRing->work, NULL);
+    pthread_cond_init(&pRing->done, NULL);
+    for (pRing->nThread = 0; pRing->nThread < nThread; pRing->nThread++) {
+        if (pthread_create(&pRing->aThread[pRing->nThread], NULL, ccvfs_ring_worker, pRing) != 0) {
+            break;
+        }
+    }
+    return pRing->nThread > 0 ? SQLITE_OK : SQLITE_ERROR;
+}
+
+// Slot of the next submission, free once the item nSlot positions earlier was collected
+static uint32_t ccvfs_ring_next(const CCVFSWorkRing *pRing) {
+    return pRing->nSubmitted % pRing->nSlot;
+}
+
+static void ccvfs_ring_submit(CCVFSWorkRing *pRing) {
+    pthread_mutex_lock(&pRing->mutex);
+    pRing->aDone[pRing->nSubmitted % pRing->nSlot] = 0;
+    pRing->nSubmitted++;
+    pthread_cond_signal(&pRing->work);
+    pthread_mutex_unlock(&pRing->mutex);
+}
+
+// Wait for item iSeq, returns its slot and stores the result of xWork in *pRc
+static uint32_t ccvfs_ring_collect(CCVFSWorkRing *pRing, uint32_t iSeq, int *pRc) {
+    uint32_t iSlot = iSeq % pRing->nSlot;
+    pthread_mutex_lock(&pRing->mutex);
+    while (!pRing->aDone[iSlot]) {
+        pthread_cond_wait(&pRing->done, &pRing->mutex);
+    }
+    *pRc = pRing->aRc[iSlot];
+    pthread_mutex_unlock(&pRing->mutex);
+    return iSlot;
+}
+
+static void ccvfs_ring_stop(CCVFSWorkRing *pRing) {
+    if (!pRing->aDone) {
+        return;
+    }
+    pthread_mutex_lock(&pRing->mutex);
+    pRing->shutdown = 1;
+    pthread_cond_broadcast(&pRing->work);
+    pthread_mutex_unlock(&pRing->mutex);
+    for (int i = 0; i < pRing->nThread; i++) {
+        pthread_join(pRing->aThread[i], NULL);
+    }
+    pthread_cond_destroy(&pRing->done);
+    pthread_cond_destroy(&pRing->work);
+    pthread_mutex_destroy(&pRing->mutex);
+    sqlite3_free(pRing->aDone);
+    pRing->aDone = NULL;
+}
+
+/*
+ * 并行离线压缩流水线
+ * Parallel offline compression pipeline
+ *
+ * 主线程按块顺序读取源文件并写出结果，工作线程在两者之间压缩和加密。
+ * The main thread reads blocks of the source file and writes the results in block order,
+ * the workers compress and encrypt in between.
+ */
+typedef struct {
+    unsigned char *aInput;        // Block read from the source
+    unsigned char *aCompressed;   // Compression output
+    unsigned char *aEncrypted;    // Encryption output
+    const unsigned char *pOut;    // Bytes to store, points into one of the buffers above
+    uint32_t nOut;
+    uint32_t flags;
+    uint32_t checksum;
+} CCVFSPipelineSlot;
+
+typedef struct {
+    CCVFSPipelineSlot *aSlot;
+    const CompressAlgorithm *pCompressAlg;
+    const EncryptAlgorithm *pEncryptAlg;
+    const unsigned char *key;
+    int key_len;
+    int level;
+    uint32_t page_size;
+    int nCompressed;              // Size of aCompressed
+    int nEncrypted;               // Size of aEncrypted
+} CCVFSPipeline;
+
+/*
+ * 按writePage()的方式编码一个块：全零块为稀疏块，压缩无收益时保存原始数据
+ * Encode one block the way writePage() does: all-zero blocks are sparse, blocks that do not
+ * shrink are stored uncompressed
+ */
+static int ccvfs_block_encode(const CCVFSPipeline *p, CCVFSPipelineSlot *pSlot) {
+    uint32_t i;
+    
+    pSlot->flags = 0;
+    pSlot->pOut = pSlot->aInput;
+    pSlot->nOut = p->page_size;
+    
+    for (i = 0; i < p->page_size && pSlot->aInput[i] == 0; i++) {
+    }
+    if (i == p->page_size) {
+        pSlot->flags = CCVFS_PAGE_SPARSE;
+        pSlot->nOut = 0;
+        pSlot->checksum = 0;
+        return SQLITE_OK;
+    }
+    
+    if (p->pCompressAlg) {
+        int n = p->pCompressAlg->compress(pSlot->aInput, (int)p->page_size,
+                                          pSlot->aCompressed, p->nCompressed, p->level);
+        if (n > 0 && (uint32_t)n < p->page_size) {
+            pSlot->pOut = pSlot->aCompressed;
+            pSlot->nOut = (uint32_t)n;
+            pSlot->flags |= CCVFS_PAGE_COMPRESSED;
+            pSlot->flags |= ((uint32_t)p->level << CCVFS_COMPRESSION_LEVEL_SHIFT) & CCVFS_COMPRESSION_LEVEL_MASK;
+        }
+    }
+    
+    if (p->pEncryptAlg) {
+        int n = p->pEncryptAlg->encrypt(p->key, p->key_len, pSlot->pOut, (int)pSlot->nOut,
+                                        pSlot->aEncrypted, p->nEncrypted);
+        if (n <= 0) {
+            return SQLITE_IOERR;
+        }
+        pSlot->pOut = pSlot->aEncrypted;
+        pSlot->nOut = (uint32_t)n;
+        pSlot->flags |= CCVFS_PAGE_ENCRYPTED;
+    }
+    
+    pSlot->checksum = ccvfs_crc32(pSlot->pOut, (int)pSlot->nOut);
+    return SQLITE_OK;
+}
+
+static int ccvfs_pipeline_encode(void *pCtx, uint32_t iSlot) {
+    const CCVFSPipeline *p = (const CCVFSPipeline *)pCtx;
+    return ccvfs_block_encode(p, &p->aSlot[iSlot]);
+}
+
+/*
+ * 数据块写完后一次性写入文件头和索引表，字段与ccvfs_init_header()一致
+ * Write the header and the index table once the blocks are written, fields as in ccvfs_init_header()
+ *   iOffset - End of the data written, CCVFS_DATA_PAGES_OFFSET when every block is sparse
+ *   nOriginal - Size of the plain database for the compression ratio
+ */
+static int ccvfs_pipeline_finish(FILE *dst, const CCVFSPipeline *p, const CCVFSPageIndex *aIndex,
+                                 uint32_t nBlock, uint64_t iOffset, uint64_t nOriginal, uint64_t *pnFile) {
+    CCVFSFileHeader header;
+    
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CCVFS_MAGIC, 8);
+    header.major_version = CCVFS_VERSION_MAJOR;
+    header.minor_version = CCVFS_VERSION_MINOR;
+    header.header_size = CCVFS_HEADER_SIZE;
+    header.original_page_size = p->page_size;
+    header.sqlite_version = sqlite3_libversion_number();
+    header.database_size_pages = nBlock;
+    header.change_counter = 1;
+    if (p->pCompressAlg) {
+        strncpy(header.compress_algorithm, p->pCompressAlg->name, CCVFS_MAX_ALGORITHM_NAME - 1);
+    }
+    if (p->pEncryptAlg) {
+        strncpy(header.encrypt_algorithm, p->pEncryptAlg->name, CCVFS_MAX_ALGORITHM_NAME - 1);
+    }
+    header.page_size = p->page_size;
+    header.total_pages = nBlock;
+    header.index_table_offset = CCVFS_INDEX_TABLE_OFFSET;
+    header.creation_flags = CCVFS_CREATE_OFFLINE;
+    header.timestamp = (uint64_t)time(NULL);
+    memset(header.index_change_mask, 0xFF, sizeof(header.index_change_mask));
+    
+    // 全部为稀疏块时文件止于索引表
+    // With only sparse blocks the file ends with the index table
+    uint64_t nFile = iOffset > CCVFS_DATA_PAGES_OFFSET ? iOffset
+                   : CCVFS_INDEX_TABLE_OFFSET + (uint64_t)nBlock * sizeof(CCVFSPageIndex);
+    header.original_file_size = nOriginal;
+    header.compressed_file_size = nFile;
+    header.compression_ratio = nOriginal > 0 && nFile <= nOriginal
+                             ? (uint32_t)((nOriginal - nFile) * 100 / nOriginal)
+                             : 0;
+    header.header_checksum = ccvfs_crc32((const unsigned char *)&header,
+                                         CCVFS_HEADER_SIZE - sizeof(uint32_t));
+    
+    if (fseeko(dst, 0, SEEK_SET) != 0 ||
+        fwrite(&header, CCVFS_HEADER_SIZE, 1, dst) != 1 ||
+        (nBlock > 0 && fwrite(aIndex, sizeof(CCVFSPageIndex), nBlock, dst) != nBlock) ||
+        fflush(dst) != 0) {
+        return SQLITE_IOERR_WRITE;
+    }
+    *pnFile = nFile;
+    return SQLITE_OK;
+}
+
+/*
+ * 按名称查找算法，未知的压缩算法名表示不压缩（与VFS路径一致）
+ * Look up the algorithms by name, an unknown compression name means no compression as on the VFS path
+ */
+static int ccvfs_pipeline_algorithms(const char *compress_algorithm, const char *encrypt_algorithm,
+                                     const CompressAlgorithm **ppCompress,
+                                     const EncryptAlgorithm **ppEncrypt) {
+    *ppCompress = NULL;
+    *ppEncrypt = NULL;
+    
+    if (compress_algorithm && strcmp(compress_algorithm, "zlib") == 0) {
+#ifdef HAVE_ZLIB
+        *ppCompress = CCVFS_COMPRESS_ZLIB;
+#else
+        CCVFS_ERROR("zlib compression is not compiled in");
+        return SQLITE_ERROR;
+#endif
+    }
+    
+    if (encrypt_algorithm && encrypt_algorithm[0] && strcmp(encrypt_algorithm, "none") != 0) {
+#ifdef HAVE_OPENSSL
+        if (strcmp(encrypt_algorithm, "aes128") == 0) {
+            *ppEncrypt = CCVFS_ENCRYPT_AES128;
+        } else if (strcmp(encrypt_algorithm, "aes256") == 0) {
+            *ppEncrypt = CCVFS_ENCRYPT_AES256;
+        }
+#endif
+        if (!*ppEncrypt) {
+            CCVFS_ERROR("Encryption algorithm %s is not available", encrypt_algorithm);
+            return SQLITE_ERROR;
+        }
+    }
+    
+    return SQLITE_OK;
+}
+
+/*
+ * 旧的日志文件属于被替换的数据库，留着会在下次打开时被回放；旧的共享索引会描述错误的数据
+ * Stale journals belong to the replaced database and would be replayed on the next open, a stale
+ * shared index would describe the wrong data
+ */
+void ccvfs_transcode_remove_journals(const char *path) {
+    static const char *const azSuffix[] = { "-journal", "-wal", "-shm", "-ccvfs", "-ccvfs-shm" };
+    size_t i;
+    
+    for (i = 0; i < sizeof(azSuffix) / sizeof(azSuffix[0]); i++) {
+        char *zAux = sqlite3_mprintf("%s%s", path, azSuffix[i]);
+        if (zAux) {
+            unlink(zAux);
+            sqlite3_free(zAux);
+        }
+    }
+}
+
+/*
+ * 读取文件头，调用方还没有打开它的连接
+ * Read the file header before the caller has a connection on the file
+ * 经由默认VFS读取而不是自己打开描述符：关闭同一文件的任何描述符都会释放本进程在该文件上的
+ * 全部POSIX锁，包括同一进程中其他连接持有的锁，而SQLite的unix VFS会推迟这种关闭。
+ * The read goes through the default VFS rather than a descriptor of our own: closing any
+ * descriptor of a file drops every POSIX lock the process holds on it, including those of other
+ * connections in the same process, and the SQLite unix VFS defers such closes.
+ */
+static int ccvfs_transcode_read_header(const char *path, CCVFSFileHeader *pHeader) {
+    sqlite3 *db = NULL;
+    sqlite3_file *pFile = NULL;
+    int rc;
+    
+    rc = sqlite3_open_v2(path, &db, SQLITE_OPEN_READONLY, NULL);
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_file_control(db, NULL, SQLITE_FCNTL_FILE_POINTER, &pFile);
+    }
+    if (rc == SQLITE_OK && pFile && pFile->pMethods) {
+        rc = pFile->pMethods->xRead(pFile, pHeader, CCVFS_HEADER_SIZE, 0);
+        if (rc == SQLITE_IOERR_SHORT_READ) {
+            rc = SQLITE_NOTADB;
+        }
+    } else if (rc == SQLITE_OK) {
+        rc = SQLITE_CANTOPEN;
+    }
+    sqlite3_close(db);
+    return rc;
+}
+
+/*
+ * 打开源数据库时检查点的等待时间与重试次数
+ * How long the source checkpoint waits for writers and old readers, and how often opening retries
+ */
+#define CCVFS_SOURCE_BUSY_TIMEOUT_MS 5000
+#define CCVFS_SOURCE_OPEN_RETRIES    4
+
+/*
+ * 读事务开始后主文件是否已包含读快照的全部WAL帧
+ * Whether the main file holds every WAL frame of the read snapshot once the read transaction has
+ * started. A passive checkpoint reports the log and backfill sizes: the snapshot's read mark caps
+ * the backfill, so equal sizes mean the snapshot is fully backfilled and the main file stays as
+ * it is for as long as the read transaction lasts. Without a read-write connection only an empty
+ * WAL proves it.
+ */
+static int ccvfs_source_backfilled(sqlite3 *rw, const char *zWal) {
+    int nLog = -1;
+    int nCkpt = -1;
+    
+    if (!rw) {
+        return get_file_size(zWal) <= 0;
+    }
+    if (sqlite3_wal_checkpoint_v2(rw, NULL, SQLITE_CHECKPOINT_PASSIVE, &nLog, &nCkpt) != SQLITE_OK) {
+        return 0;
+    }
+    return nLog >= 0 && nLog == nCkpt;
+}
+
+/*
+ * WAL中尚未检查点的帧不在主文件里：先用一个读写连接做FULL检查点，读事务开始后再确认读快照已全部回填，
+ * 否则重试。
+ * Frames not yet checkpointed are not in the main file: a read-write connection runs a FULL
+ * checkpoint first, waiting for writers and for readers on older snapshots, and once the read
+ * transaction has started its snapshot must be fully backfilled, otherwise opening retries. A
+ * non-empty WAL is fine, readers that keep their transactions open do not get in the way.
+ */
+int ccvfs_transcode_open_source(const char *source_db, const char *zVfs, sqlite3 **pDb,
+                                uint32_t *pSqlitePageSize, uint32_t *pPageCount) {
+    sqlite3 *db = NULL;
+    sqlite3 *rw = NULL;
+    sqlite3_stmt *stmt = NULL;
+    char *zWal = NULL;
+    int isWal = 0;
+    int nTry;
+    int rc;
+    
+    *pDb = NULL;
+    rc = sqlite3_open_v2(source_db, &db, SQLITE_OPEN_READONLY, zVfs);
+    if (rc != SQLITE_OK) {
+        CCVFS_ERROR("Failed to open source database %s: %s", source_db, sqlite3_errmsg(db));
+        sqlite3_close(db);
+        return rc;
+    }
+    sqlite3_busy_timeout(db, CCVFS_SOURCE_BUSY_TIMEOUT_MS);
+    
+    rc = sqlite3_prepare_v2(db, "PRAGMA journal_mode", -1, &stmt, NULL);
+    if (rc == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW) {
+        const char *zMode = (const char *)sqlite3_column_text(stmt, 0);
+        isWal = zMode && sqlite3_stricmp(zMode, "wal") == 0;
+    }
+    sqlite3_finalize(stmt);
+    stmt = NULL;
+    if (rc != SQLITE_OK) {
+        goto error;
+    }
+    
+    zWal = sqlite3_mprintf("%s-wal", source_db);
+    if (!zWal) {
+        rc = SQLITE_NOMEM;
+        goto error;
+    }
+    if (isWal) {
+        if (sqlite3_open_v2(source_db, &rw, SQLITE_OPEN_READWRITE, zVfs) == SQLITE_OK) {
+            sqlite3_busy_timeout(rw, CCVFS_SOURCE_BUSY_TIMEOUT_MS);
+        }
+        // 先读取一次，让新连接识别出WAL模式，否则检查点什么都不做
+        // Read once so the fresh connection knows it is in WAL mode, otherwise the checkpoint does nothing
+        if (rw && sqlite3_exec(rw, "SELECT count(*) FROM sqlite_schema", NULL, NULL, NULL) != SQLITE_OK) {
+            sqlite3_close(rw);
+            rw = NULL;
+        }
+    }
+    
+    for (nTry = 0; ; nTry++) {
+        if (rw) {
+            sqlite3_wal_checkpoint_v2(rw, NULL, SQLITE_CHECKPOINT_FULL, NULL, NULL);
+        }
+        
+        rc = sqlite3_exec(db, "BEGIN", NULL, NULL, NULL);
+        if (rc != SQLITE_OK) {
+            goto error;
+        }
+        
+        // 第一次读取开始读事务
+        // The first read starts the read transaction
+        rc = sqlite3_prepare_v2(db, "PRAGMA page_count", -1, &stmt, NULL);
+        if (rc == SQLITE_OK) {
+            rc = sqlite3_step(stmt) == SQLITE_ROW ? SQLITE_OK : sqlite3_errcode(db);
+            *pPageCount = (uint32_t)sqlite3_column_int64(stmt, 0);
+        }
+        sqlite3_finalize(stmt);
+        stmt = NULL;
+        if (rc != SQLITE_OK) {
+            goto error;
+        }
+        
+        if (!isWal || ccvfs_source_backfilled(rw, zWal)) {
+            break;
+        }
+        
+        // 检查点与读事务之间有新的提交，或者旧读者挡住了回填
+        // A commit landed between the checkpoint and the read transaction, or an old reader held up the backfill
+        sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
+        if (nTry + 1 >= CCVFS_SOURCE_OPEN_RETRIES) {
+            CCVFS_ERROR("WAL of %s could not be checkpointed, close its writers first", source_db);
+            rc = SQLITE_BUSY;
+            goto error;
+        }
+    }
+    
+    rc = sqlite3_prepare_v2(db, "PRAGMA page_size", -1, &stmt, NULL);
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_step(stmt) == SQLITE_ROW ? SQLITE_OK : sqlite3_errcode(db);
+        *pSqlitePageSize = (uint32_t)sqlite3_column_int(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    stmt = NULL;
+    if (rc != SQLITE_OK) {
+        goto error;
+    }
+    
+    sqlite3_close(rw);
+    sqlite3_free(zWal);
+    *pDb = db;
+    return SQLITE_OK;
+    
+error:
+    CCVFS_ERROR("Failed to prepare source database %s: %d", source_db, rc);
+    sqlite3_close(rw);
+    sqlite3_free(zWal);
+    sqlite3_close(db);
+    return rc;
+}
+
+int sqlite3_ccvfs_compress_database_parallel(
+    const char *source_db,
+    const char *compressed_db,
+    const CCVFSCompressOptions *pOptions
+) {
+    CCVFSCompressOptions opts;
+    CCVFSPipeline pipe;
+    CCVFSPageIndex *aIndex = NULL;
+    CCVFSWorkRing ring;
+    sqlite3 *db = NULL;
+    sqlite3_file *pSrc = NULL;
+    FILE *dst = NULL;
+    int rc;
+    uint32_t sqlitePageSize = 0, sqlitePages = 0;
+    uint32_t nBlock, nSlot = 0, nWritten = 0, nReported = 0;
+    uint64_t nLogical;
+    uint64_t iOffset = CCVFS_DATA_PAGES_OFFSET;
+    uint32_t i;
+    
+    if (!source_db || !compressed_db) {
+        return SQLITE_MISUSE;
+    }
+    
+    memset(&opts, 0, sizeof(opts));
+    if (pOptions) {
+        opts = *pOptions;
+    }
+    if (opts.page_size == 0) {
+        opts.page_size = CCVFS_DEFAULT_PAGE_SIZE;
+    }
+    if (opts.page_size < CCVFS_MIN_PAGE_SIZE || opts.page_size > CCVFS_MAX_PAGE_SIZE ||
+        (opts.page_size & (opts.page_size - 1)) != 0) {
+        CCVFS_ERROR("Invalid page size %u", opts.page_size);
+        return SQLITE_MISUSE;
+    }
+    if (opts.compression_level == 0) {
+        opts.compression_level = CCVFS_DEFAULT_COMPRESS_LEVEL;
+    }
+    if (opts.compression_level < CCVFS_MIN_COMPRESS_LEVEL || opts.compression_level > CCVFS_MAX_COMPRESS_LEVEL) {
+        CCVFS_ERROR("Invalid compression level %d", opts.compression_level);
+        return SQLITE_MISUSE;
+    }
+    
+    memset(&pipe, 0, sizeof(pipe));
+    memset(&ring, 0, sizeof(ring));
+    rc = ccvfs_pipeline_algorithms(opts.compress_algorithm, opts.encrypt_algorithm,
+                                   &pipe.pCompressAlg, &pipe.pEncryptAlg);
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+    if (pipe.pEncryptAlg && (!opts.key || opts.key_len <= 0 || opts.key_len > 64)) {
+        CCVFS_ERROR("Encryption with %s needs a key of 1 to 64 bytes", pipe.pEncryptAlg->name);
+        return SQLITE_MISUSE;
+    }
+    
+    rc = ccvfs_transcode_open_source(source_db, NULL, &db, &sqlitePageSize, &sqlitePages);
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+    
+    nLogical = (uint64_t)sqlitePages * sqlitePageSize;
+    if ((nLogical + opts.page_size - 1) / opts.page_size > CCVFS_MAX_PAGES) {
+        CCVFS_ERROR("%llu bytes need more than %d blocks of %u bytes",
+                    (unsigned long long)nLogical, CCVFS_MAX_PAGES, opts.page_size);
+        sqlite3_close(db);
+        return SQLITE_FULL;
+    }
+    nBlock = (uint32_t)((nLogical + opts.page_size - 1) / opts.page_size);
+    
+    pipe.key = opts.key;
+    pipe.key_len = opts.key_len;
+    pipe.level = opts.compression_level;
+    pipe.page_size = opts.page_size;
+    pipe.nCompressed = pipe.pCompressAlg ? pipe.pCompressAlg->get_max_compressed_size((int)opts.page_size)
+                                         : (int)opts.page_size;
+    if (pipe.nCompressed < (int)opts.page_size) {
+        pipe.nCompressed = (int)opts.page_size;
+    }
+    // AES-CBC需要IV和最多16字节填充
+    // AES-CBC needs room for the IV and up to 16 bytes of padding
+    pipe.nEncrypted = pipe.nCompressed + 16 + 16;
+    
+    int nThread = ccvfs_ring_threads(opts.threads, nBlock);
+    nSlot = (uint32_t)nThread * CCVFS_PIPELINE_SLOTS_PER_THREAD;
+    pipe.aSlot = (CCVFSPipelineSlot *)sqlite3_malloc64(sizeof(CCVFSPipelineSlot) * nSlot);
+    aIndex = (CCVFSPageIndex *)sqlite3_malloc64(sizeof(CCVFSPageIndex) * (nBlock ? nBlock : 1));
+    if (!pipe.aSlot || !aIndex) {
+        rc = SQLITE_NOMEM;
+        goto cleanup;
+    }
+    memset(pipe.aSlot, 0, sizeof(CCVFSPipelineSlot) * nSlot);
+    memset(aIndex, 0, sizeof(CCVFSPageIndex) * (nBlock ? nBlock : 1));
+    for (i = 0; i < nSlot; i++) {
+        pipe.aSlot[i].aInput = (unsigned char *)sqlite3_malloc(opts.page_size);
+        pipe.aSlot[i].aCompressed = (unsigned char *)sqlite3_malloc(pipe.nCompressed);
+        pipe.aSlot[i].aEncrypted = (unsigned char *)sqlite3_malloc(pipe.nEncrypted);
+        if (!pipe.aSlot[i].aInput || !pipe.aSlot[i].aCompressed || !pipe.aSlot[i].aEncrypted) {
+            rc = SQLITE_NOMEM;
+            goto cleanup;
+        }
+    }
+    
+    // 通过读连接自己的文件句柄读取源文件，见ccvfs_transcode_read_header()
+    // The source is read through the handle of the reading connection, see ccvfs_transcode_read_header()
+    if (sqlite3_file_control(db, NULL, SQLITE_FCNTL_FILE_POINTER, &pSrc) != SQLITE_OK || !pSrc) {
+        rc = SQLITE_ERROR;
+        goto cleanup;
+    }
+    ccvfs_transcode_remove_journals(compressed_db);
+    dst = fopen(compressed_db, "wb");
+    if (!dst) {
+        CCVFS_ERROR("Failed to open %s", compressed_db);
+        rc = SQLITE_CANTOPEN;
+        goto cleanup;
+    }
+    setvbuf(dst, NULL, _IOFBF, CCVFS_PIPELINE_WRITE_BUFFER);
+    if (fseeko(dst, (off_t)CCVFS_DATA_PAGES_OFFSET, SEEK_SET) != 0) {
+        rc = SQLITE_IOERR_SEEK;
+        goto cleanup;
+    }
+    
+    rc = ccvfs_ring_start(&ring, nThread, ccvfs_pipeline_encode, &pipe);
+    if (rc != SQLITE_OK) {
+        goto shutdown;
+    }
+    
+    CCVFS_INFO("Compressing %s: %u blocks of %u bytes on %d workers",
+               source_db, nBlock, opts.page_size, ring.nThread);
+    
+    while (nWritten < nBlock) {
+        // 读取：填满在途窗口
+        // Read: fill the in-flight window
+        while (ring.nSubmitted < nBlock && ring.nSubmitted - nWritten < nSlot) {
+            CCVFSPipelineSlot *pSlot = &pipe.aSlot[ccvfs_ring_next(&ring)];
+            uint64_t iStart = (uint64_t)ring.nSubmitted * opts.page_size;
+            size_t nWant = (size_t)(nLogical - iStart < opts.page_size ? nLogical - iStart : opts.page_size);
+            
+            rc = pSrc->pMethods->xRead(pSrc, pSlot->aInput, (int)nWant, (sqlite3_int64)iStart);
+            if (rc != SQLITE_OK) {
+                CCVFS_ERROR("Failed to read block %u from %s: %d", ring.nSubmitted, source_db, rc);
+                goto shutdown;
+            }
+            if (nWant < opts.page_size) {
+                memset(pSlot->aInput + nWant, 0, opts.page_size - nWant);
+            }
+            
+            ccvfs_ring_submit(&ring);
+        }
+        
+        // 写入：按块顺序等待下一个编码完成的块
+        // Write: wait for the next block in order
+        CCVFSPipelineSlot *pSlot = &pipe.aSlot[ccvfs_ring_collect(&ring, nWritten, &rc)];
+        if (rc != SQLITE_OK) {
+            CCVFS_ERROR("Failed to encode block %u: %d", nWritten, rc);
+            goto shutdown;
+        }
+        
+        CCVFSPageIndex *pIndex = &aIndex[nWritten];
+        pIndex->original_size = opts.page_size;
+        pIndex->flags = pSlot->flags;
+        if (pSlot->nOut > 0) {
+            if (fwrite(pSlot->pOut, 1, pSlot->nOut, dst) != pSlot->nOut) {
+                rc = SQLITE_IOERR_WRITE;
+                goto shutdown;
+            }
+            pIndex->physical_offset = iOffset;
+            pIndex->compressed_size = pSlot->nOut;
+            pIndex->checksum = pSlot->checksum;
+            iOffset += pSlot->nOut;
+        }
+        nWritten++;
+        
+        if (opts.xProgress && (nWritten - nReported >= (nBlock + 99) / 100 || nWritten == nBlock)) {
+            opts.xProgress(opts.pProgressArg, nWritten, nBlock);
+            nReported = nWritten;
+        }
+    }
+    rc = SQLITE_OK;
+    
+shutdown:
+    ccvfs_ring_stop(&ring);
+    if (rc != SQLITE_OK) {
+        goto cleanup;
+    }
+    
+    if (nBlock == 0 && opts.xProgress) {
+        opts.xProgress(opts.pProgressArg, 0, 0);
+    }
+    
+    long nSource = get_file_size(source_db);
+    uint64_t nOriginal = nSource > 0 ? (uint64_t)nSource : nLogical;
+    uint64_t nFile = 0;
+    rc = ccvfs_pipeline_finish(dst, &pipe, aIndex, nBlock, iOffset, nOriginal, &nFile);
+    if (rc != SQLITE_OK) {
+        goto cleanup;
+    }
+    
+    CCVFS_INFO("Compressed %s: %llu -> %llu bytes", source_db,
+               (unsigned long long)nOriginal, (unsigned long long)nFile);
+    
+cleanup:
+    if (dst && fclose(dst) != 0 && rc == SQLITE_OK) {
+        rc = SQLITE_IOERR_WRITE;
+    }
+    if (rc != SQLITE_OK && dst) {
+        remove(compressed_db);
+    }
+    if (pipe.aSlot) {
+        for (i = 0; i < nSlot; i++) {
+            sqlite3_free(pipe.aSlot[i].aInput);
+            sqlite3_free(pipe.aSlot[i].aCompressed);
+            sqlite3_free(pipe.aSlot[i].aEncrypted);
+        }
+        sqlite3_free(pipe.aSlot);
+    }
+    sqlite3_free(aIndex);
+    sqlite3_close(db);
+    return rc;
+}
+
+/*
+ * 并行直接解压转码
+ * Parallel direct decompression transcoder
+ *
+ * 主线程按物理偏移顺序读取数据块，工作线程校验、解密和解压，主线程再按读取顺序取回，
+ * 把逻辑上连续的块合并到对齐的写缓冲中。
+ * The main thread reads stored blocks in physical offset order, the workers verify, decrypt and
+ * decompress them, and the main thread collects them in read order and merges logically
+ * consecutive blocks in an aligned run buffer.
+ */
+#define CCVFS_RESTORE_ALIGN 4096
+
+typedef struct {
+    uint64_t physical_offset;
+    uint32_t iBlock;
+} CCVFSRestoreExtent;
+
+typedef struct {
+    uint32_t iBlock;
+    unsigned char *aStored;       // Block as stored in the file
+    unsigned char *aDecrypted;    // Decryption output
+    unsigned char *aPage;         // Decoded block
+    uint32_t nAlloc;              // Size of aStored and aDecrypted
+} CCVFSRestoreSlot;
+
+typedef struct {
+    CCVFSRestoreSlot *aSlot;
+    const CCVFSPageIndex *aIndex;
+    const CompressAlgorithm *pCompressAlg;
+    const EncryptAlgorithm *pEncryptAlg;
+    const unsigned char *key;
+    int key_len;
+    uint32_t page_size;
+} CCVFSRestore;
+
+static int ccvfs_restore_extent_cmp(const void *a, const void *b) {
+    const CCVFSRestoreExtent *x = (const CCVFSRestoreExtent *)a;
+    const CCVFSRestoreExtent *y = (const CCVFSRestoreExtent *)b;
+    if (x->physical_offset != y->physical_offset) {
+        return x->physical_offset < y->physical_offset ? -1 : 1;
+    }
+    return x->iBlock < y->iBlock ? -1 : (x->iBlock > y->iBlock);
+}
+
+/*
+ * 按readPageEntry()的方式解密和解压一个已通过校验和检查的块；aDecrypted至少有nAlloc字节
+ * Decrypt and decompress one block that passed its checksum the way readPageEntry() does,
+ * aDecrypted holds at least nAlloc bytes
+ */
+static int ccvfs_block_decode(const CCVFSRestore *p, uint32_t iBlock, const unsigned char *aStored,
+                              unsigned char *aDecrypted, uint32_t nAlloc, unsigned char *aPage) {
+    const CCVFSPageIndex *pIndex = &p->aIndex[iBlock];
+    const unsigned char *pData = aStored;
+    int nData = (int)pIndex->compressed_size;
+    
+    if (pIndex->flags & CCVFS_PAGE_ENCRYPTED) {
+        if (!p->pEncryptAlg) {
+            CCVFS_ERROR("Block %u is encrypted but no encryption algorithm is set", iBlock);
+            return SQLITE_CORRUPT;
+        }
+        nData = p->pEncryptAlg->decrypt(p->key, p->key_len, pData, nData, aDecrypted, (int)nAlloc);
+        if (nData < 0) {
+            CCVFS_ERROR("Failed to decrypt block %u: %d", iBlock, nData);
+            return SQLITE_CORRUPT;
+        }
+        pData = aDecrypted;
+    }
+    
+    if (pIndex->flags & CCVFS_PAGE_COMPRESSED) {
+        if (!p->pCompressAlg) {
+            CCVFS_ERROR("Block %u is compressed but no compression algorithm is set", iBlock);
+            return SQLITE_CORRUPT;
+        }
+        int n = p->pCompressAlg->decompress(pData, nData, aPage, (int)p->page_size);
+        if (n < 0 || (uint32_t)n != pIndex->original_size) {
+            CCVFS_ERROR("Block %u decompressed to %d bytes, expected %u", iBlock, n, pIndex->original_size);
+            return SQLITE_CORRUPT;
+        }
+    } else {
+        if (pIndex->original_size > (uint32_t)nData) {
+            CCVFS_ERROR("Block %u holds %d bytes, expected %u", iBlock, nData, pIndex->original_size);
+            return SQLITE_CORRUPT;
+        }
+        memcpy(aPage, pData, pIndex->original_size);
+    }
+    if (pIndex->original_size < p->page_size) {
+        memset(aPage + pIndex->original_size, 0, p->page_size - pIndex->original_size);
+    }
+    return SQLITE_OK;
+}
+
+/*
+ * 解码一个块，校验和不符时总是失败
+ * Decode one block, a checksum mismatch always fails
+ */
+static int ccvfs_restore_decode(void *pCtx, uint32_t iSlot) {
+    const CCVFSRestore *p = (const CCVFSRestore *)pCtx;
+    CCVFSRestoreSlot *pSlot = &p->aSlot[iSlot];
+    const CCVFSPageIndex *pIndex = &p->aIndex[pSlot->iBlock];
+    
+    if (ccvfs_crc32(pSlot->aStored, (int)pIndex->compressed_size) != pIndex->checksum) {
+        CCVFS_ERROR("Block %u checksum mismatch at offset %llu", pSlot->iBlock,
+                    (unsigned long long)pIndex->physical_offset);
+        return SQLITE_CORRUPT;
+    }
+    return ccvfs_block_decode(p, pSlot->iBlock, pSlot->aStored, pSlot->aDecrypted, pSlot->nAlloc, pSlot->aPage);
+}
+
+/*
+ * 写出一段逻辑上连续的块；O_DIRECT被拒绝时改为普通写入
+ * Write a run of logically consecutive blocks, falling back to buffered I/O when O_DIRECT is refused
+ */
+static int ccvfs_restore_write(int fd, int *pDirect, const unsigned char *aRun, size_t nRun, uint64_t iOffset) {
+    while (nRun > 0) {
+        ssize_t n = pwrite(fd, aRun, nRun, (off_t)iOffset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+#ifdef O_DIRECT
+        if (n < 0 && errno == EINVAL && *pDirect) {
+            CCVFS_INFO("O_DIRECT write refused, continuing with buffered I/O");
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+            *pDirect = 0;
+            continue;
+        }
+#endif
+        if (n <= 0) {
+            return SQLITE_IOERR_WRITE;
+        }
+        aRun += n;
+        nRun -= (size_t)n;
+        iOffset += (uint64_t)n;
+    }
+    return SQLITE_OK;
+}
+
+/*
+ * 确定源CCVFS文件的算法和密钥以及读取它所用的VFS
+ * Find the algorithms and the key of a CCVFS source and the VFS to read it through
+ * 给出vfs_name时使用调用方VFS的算法和密钥；否则算法名取自文件头，并用它们和key创建一个
+ * 临时VFS，调用方用完后销毁*pzTempVfs。
+ * With vfs_name the algorithms and the key of the caller's VFS are used, otherwise the algorithm
+ * names come from the header and a temporary VFS is created with them and key, which the caller
+ * destroys through *pzTempVfs when done.
+ */
+static int ccvfs_transcode_source_vfs(const char *path, const char *vfs_name,
+                                      const unsigned char *key, int key_len, CCVFSRestore *pCodec,
+                                      char **pzTempVfs, const char **pzVfs) {
+    CCVFSFileHeader header;
+    int rc;
+    
+    *pzTempVfs = NULL;
+    if (vfs_name) {
+        CCVFS *pCcvfs = (CCVFS *)sqlite3_vfs_find(vfs_name);
+        if (!pCcvfs) {
+            CCVFS_ERROR("VFS %s does not exist", vfs_name);
+            return SQLITE_ERROR;
+        }
+        pCodec->pCompressAlg = pCcvfs->pCompressAlg;
+        pCodec->pEncryptAlg = pCcvfs->pEncryptAlg;
+        if (pCcvfs->key_set) {
+            pCodec->key = pCcvfs->encryption_key;
+            pCodec->key_len = pCcvfs->key_length;
+        }
+        *pzVfs = vfs_name;
+        return SQLITE_OK;
+    }
+    
+    // 在打开数据库之前读取文件头，锁定后再读一次
+    // The header is read before the database is opened and read again under the lock
+    rc = ccvfs_transcode_read_header(path, &header);
+    if (rc == SQLITE_OK && memcmp(header.magic, CCVFS_MAGIC, 8) != 0) {
+        rc = SQLITE_NOTADB;
+    }
+    if (rc != SQLITE_OK) {
+        CCVFS_ERROR("%s is not a CCVFS file", path);
+        return rc;
+    }
+    header.compress_algorithm[CCVFS_MAX_ALGORITHM_NAME - 1] = '\0';
+    header.encrypt_algorithm[CCVFS_MAX_ALGORITHM_NAME - 1] = '\0';
+    rc = ccvfs_pipeline_algorithms(header.compress_algorithm, header.encrypt_algorithm,
+                                   &pCodec->pCompressAlg, &pCodec->pEncryptAlg);
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+    if (header.compress_algorithm[0] && strcmp(header.compress_algorithm, "none") != 0 &&
+        !pCodec->pCompressAlg) {
+        CCVFS_ERROR("Compression algorithm %s is not available", header.compress_algorithm);
+        return SQLITE_ERROR;
+    }
+    pCodec->key = key;
+    pCodec->key_len = key_len;
+    
+    *pzTempVfs = sqlite3_mprintf("ccvfs_restore_%p", (void *)pCodec);
+    if (!*pzTempVfs) {
+        return SQLITE_NOMEM;
+    }
+    if (pCodec->pEncryptAlg && key && key_len > 0 && key_len <= 64) {
+        rc = sqlite3_ccvfs_create_with_key(*pzTempVfs, NULL, pCodec->pCompressAlg, pCodec->pEncryptAlg,
+                                           0, 0, key, key_len);
+    } else {
+        rc = sqlite3_ccvfs_create(*pzTempVfs, NULL, pCodec->pCompressAlg, pCodec->pEncryptAlg, 0, 0);
+    }
+    if (rc != SQLITE_OK) {
+        sqlite3_free(*pzTempVfs);
+        *pzTempVfs = NULL;
+        return rc;
+    }
+    *pzVfs = *pzTempVfs;
+    return SQLITE_OK;
+}
+
+/*
+ * 在读事务下读取并检查源文件头和逻辑大小以内的索引条目
+ * Read and check the header of a source and its index entries within the logical size, under
+ * the read transaction
+ *   pSrc - Underlying file of the source
+ *   paIndex - Receives the entries, freed by the caller
+ *   pnBlock - Entries read; blocks past the logical size of the database are left out
+ *   pnStoredMax - Largest stored block
+ */
+static int ccvfs_transcode_load_index(const char *path, sqlite3_file *pSrc, uint64_t nLogical,
+                                      CCVFSFileHeader *pHeader, sqlite3_int64 *pnFile,
+                                      CCVFSPageIndex **paIndex, uint32_t *pnBlock, uint32_t *pnStoredMax) {
+    CCVFSPageIndex *aIndex;
+    uint32_t nBlock, nStoredMax = 0;
+    uint32_t i;
+    int rc;
+    
+    if (pSrc->pMethods->xFileSize(pSrc, pnFile) != SQLITE_OK ||
+        pSrc->pMethods->xRead(pSrc, pHeader, CCVFS_HEADER_SIZE, 0) != SQLITE_OK ||
+        memcmp(pHeader->magic, CCVFS_MAGIC, 8) != 0 ||
+        pHeader->page_size < CCVFS_MIN_PAGE_SIZE || pHeader->page_size > CCVFS_MAX_PAGE_SIZE ||
+        (pHeader->page_size & (pHeader->page_size - 1)) != 0 ||
+        pHeader->total_pages > CCVFS_MAX_PAGES) {
+        CCVFS_ERROR("Invalid CCVFS header in %s", path);
+        return SQLITE_CORRUPT;
+    }
+    
+    // 超出数据库逻辑大小的块不输出
+    // Blocks past the logical size of the database are not written
+    nBlock = (uint32_t)((nLogical + pHeader->page_size - 1) / pHeader->page_size);
+    if (nBlock > pHeader->total_pages) {
+        nBlock = pHeader->total_pages;
+    }
+    
+    aIndex = (CCVFSPageIndex *)sqlite3_malloc64(sizeof(CCVFSPageIndex) * (nBlock ? nBlock : 1));
+    if (!aIndex) {
+        return SQLITE_NOMEM;
+    }
+    if (nBlock > 0) {
+        rc = pSrc->pMethods->xRead(pSrc, aIndex, (int)(sizeof(CCVFSPageIndex) * nBlock),
+                                   (sqlite3_int64)pHeader->index_table_offset);
+        if (rc != SQLITE_OK) {
+            CCVFS_ERROR("Failed to read the index table of %s: %d", path, rc);
+            sqlite3_free(aIndex);
+            return rc;
+        }
+    }
+    
+    for (i = 0; i < nBlock; i++) {
+        const CCVFSPageIndex *pIndex = &aIndex[i];
+        if (pIndex->physical_offset == 0 || (pIndex->flags & CCVFS_PAGE_SPARSE) ||
+            pIndex->compressed_size == 0) {
+            continue;
+        }
+        if (pIndex->original_size > pHeader->page_size ||
+            pIndex->compressed_size > pHeader->page_size * 2 + 64 ||
+            pIndex->physical_offset + pIndex->compressed_size > (uint64_t)*pnFile) {
+            CCVFS_ERROR("Block %u has an invalid index entry: offset=%llu, size=%u, original=%u",
+                        i, (unsigned long long)pIndex->physical_offset, pIndex->compressed_size,
+                        pIndex->original_size);
+            sqlite3_free(aIndex);
+            return SQLITE_CORRUPT;
+        }
+        if (pIndex->compressed_size > nStoredMax) {
+            nStoredMax = pIndex->compressed_size;
+        }
+    }
+    
+    *paIndex = aIndex;
+    *pnBlock = nBlock;
+    *pnStoredMax = nStoredMax;
+    return SQLITE_OK;
+}
+
+int sqlite3_ccvfs_decompress_database_parallel(
+    const char *compressed_db,
+    const char *output_db,
+    const CCVFSDecompressOptions *pOptions
+) {
+    CCVFSDecompressOptions opts;
+    CCVFSRestore restore;
+    CCVFSFileHeader header;
+    CCVFSPageIndex *aIndex = NULL;
+    CCVFSRestoreExtent *aExtent = NULL;
+    CCVFSWorkRing ring;
+    unsigned char *aRun = NULL;
+    char *zTempVfs = NULL;
+    const char *zVfs;
+    sqlite3 *db = NULL;
+    sqlite3_file *pSrc = NULL;
+    sqlite3_int64 nSourceFile = 0;
+    int fdDst = -1;
+    int direct = 0;
+    int rc;
+    uint32_t sqlitePageSize = 0, sqlitePages = 0;
+    uint32_t nBlock = 0, nExtent = 0, nSlot = 0, nDone = 0, nReported = 0, nStoredMax = 0;
+    uint32_t nRunBlocks = 0, iRunStart = 0, nRunMax;
+    uint64_t nLogical;
+    uint32_t i;
+    
+    if (!compressed_db || !output_db) {
+        return SQLITE_MISUSE;
+    }
+    
+    memset(&opts, 0, sizeof(opts));
+    if (pOptions) {
+        opts = *pOptions;
+    }
+    memset(&restore, 0, sizeof(restore));
+    memset(&ring, 0, sizeof(ring));
+    
+    rc = ccvfs_transcode_source_vfs(compressed_db, opts.vfs_name, opts.key, opts.key_len, &restore,
+                                    &zTempVfs, &zVfs);
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+    if (restore.pEncryptAlg && (!restore.key || restore.key_len <= 0 || restore.key_len > 64)) {
+        CCVFS_ERROR("%s is encrypted with %s and needs its key", compressed_db, restore.pEncryptAlg->name);
+        rc = SQLITE_MISUSE;
+        goto cleanup;
+    }
+    
+    // 读事务使其他连接无法提交，文件头和索引表在复制期间保持不变
+    // The read transaction keeps other connections from committing, so the header and the index
+    // table stay put while they are copied
+    rc = ccvfs_transcode_open_source(compressed_db, zVfs, &db, &sqlitePageSize, &sqlitePages);
+    if (rc != SQLITE_OK) {
+        goto cleanup;
+    }
+    nLogical = (uint64_t)sqlitePages * sqlitePageSize;
+    
+    // 通过连接自己的文件句柄读取：关闭另一个描述符会释放本进程在该文件上的全部POSIX锁
+    // Read through the connection's own file handle: closing another descriptor would drop every
+    // POSIX lock this process holds on the file
+    if (sqlite3_file_control(db, NULL, SQLITE_FCNTL_FILE_POINTER, &pSrc) != SQLITE_OK || !pSrc ||
+        !((CCVFSFile *)pSrc)->is_ccvfs_file) {
+        CCVFS_ERROR("%s is not open through a CCVFS", compressed_db);
+        rc = SQLITE_ERROR;
+        goto cleanup;
+    }
+    pSrc = ((CCVFSFile *)pSrc)->pReal;
+    rc = ccvfs_transcode_load_index(compressed_db, pSrc, nLogical, &header, &nSourceFile,
+                                    &aIndex, &nBlock, &nStoredMax);
+    if (rc != SQLITE_OK) {
+        goto cleanup;
+    }
+    restore.page_size = header.page_size;
+    
+    aExtent = (CCVFSRestoreExtent *)sqlite3_malloc64(sizeof(CCVFSRestoreExtent) * (nBlock ? nBlock : 1));
+    if (!aExtent) {
+        rc = SQLITE_NOMEM;
+        goto cleanup;
+    }
+    for (i = 0; i < nBlock; i++) {
+        const CCVFSPageIndex *pIndex = &aIndex[i];
+        if (pIndex->physical_offset == 0 || (pIndex->flags & CCVFS_PAGE_SPARSE) ||
+            pIndex->compressed_size == 0) {
+            continue;
+        }
+        aExtent[nExtent].physical_offset = pIndex->physical_offset;
+        aExtent[nExtent].iBlock = i;
+        nExtent++;
+    }
+    qsort(aExtent, nExtent, sizeof(CCVFSRestoreExtent), ccvfs_restore_extent_cmp);
+    
+    ccvfs_transcode_remove_journals(output_db);
+    
+    // 块大小不是设备块大小的整数倍时无法对齐写入
+    // Writes cannot stay aligned when blocks are smaller than the device block
+#ifdef O_DIRECT
+    direct = opts.direct_io && header.page_size >= CCVFS_RESTORE_ALIGN;
+    fdDst = open(output_db, O_WRONLY | O_CREAT | O_TRUNC | (direct ? O_DIRECT : 0), 0644);
+    if (fdDst < 0 && direct && errno == EINVAL) {
+        CCVFS_INFO("O_DIRECT is not supported for %s, using buffered I/O", output_db);
+        direct = 0;
+        fdDst = open(output_db, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    }
+#else
+    fdDst = open(output_db, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+    if (fdDst < 0) {
+        CCVFS_ERROR("Failed to create %s", output_db);
+        rc = SQLITE_CANTOPEN;
+        goto cleanup;
+    }
+    
+    nRunMax = CCVFS_PIPELINE_WRITE_BUFFER / header.page_size;
+    if (nRunMax == 0) nRunMax = 1;
+    if (posix_memalign((void **)&aRun, CCVFS_RESTORE_ALIGN, (size_t)nRunMax * header.page_size) != 0) {
+        aRun = NULL;
+        rc = SQLITE_NOMEM;
+        goto cleanup;
+    }
+    
+    int nThread = ccvfs_ring_threads(opts.threads, nExtent);
+    nSlot = (uint32_t)nThread * CCVFS_PIPELINE_SLOTS_PER_THREAD;
+    restore.aIndex = aIndex;
+    restore.aSlot = (CCVFSRestoreSlot *)sqlite3_malloc64(sizeof(CCVFSRestoreSlot) * nSlot);
+    if (!restore.aSlot) {
+        rc = SQLITE_NOMEM;
+        goto cleanup;
+    }
+    memset(restore.aSlot, 0, sizeof(CCVFSRestoreSlot) * nSlot);
+    for (i = 0; i < nSlot; i++) {
+        CCVFSRestoreSlot *pSlot = &restore.aSlot[i];
+        pSlot->nAlloc = nStoredMax ? nStoredMax : 1;
+        pSlot->aStored = (unsigned char *)sqlite3_malloc(pSlot->nAlloc);
+        pSlot->aDecrypted = (unsigned char *)sqlite3_malloc(pSlot->nAlloc);
+        pSlot->aPage = (unsigned char *)sqlite3_malloc(header.page_size);
+        if (!pSlot->aStored || !pSlot->aDecrypted || !pSlot->aPage) {
+            rc = SQLITE_NOMEM;
+            goto cleanup;
+        }
+    }
+    
+    rc = ccvfs_ring_start(&ring, nThread, ccvfs_restore_decode, &restore);
+    if (rc != SQLITE_OK) {
+        goto shutdown;
+    }
+    
+    CCVFS_INFO("Decompressing %s: %u of %u blocks stored, %u bytes each, on %d workers%s",
+               compressed_db, nExtent, nBlock, header.page_size, ring.nThread, direct ? ", O_DIRECT" : "");
+    
+    while (nDone < nExtent) {
+        // 读取：按物理偏移顺序填满在途窗口
+        // Read: fill the in-flight window in physical offset order
+        while (ring.nSubmitted < nExtent && ring.nSubmitted - nDone < nSlot) {
+            CCVFSRestoreSlot *pSlot = &restore.aSlot[ccvfs_ring_next(&ring)];
+            const CCVFSRestoreExtent *pExtent = &aExtent[ring.nSubmitted];
+            uint32_t nStored = aIndex[pExtent->iBlock].compressed_size;
+            
+            pSlot->iBlock = pExtent->iBlock;
+            rc = pSrc->pMethods->xRead(pSrc, pSlot->aStored, (int)nStored, (sqlite3_int64)pExtent->physical_offset);
+            if (rc != SQLITE_OK) {
+                CCVFS_ERROR("Failed to read block %u from %s: %d", pExtent->iBlock, compressed_db, rc);
+                goto shutdown;
+            }
+            ccvfs_ring_submit(&ring);
+        }
+        
+        // 写入：按读取顺序取回，逻辑上不连续或缓冲已满时写出当前段
+        // Write: collect in read order, the run is written when the next block does not extend it
+        // or the buffer is full
+        CCVFSRestoreSlot *pSlot = &restore.aSlot[ccvfs_ring_collect(&ring, nDone, &rc)];
+        if (rc != SQLITE_OK) {
+            goto shutdown;
+        }
+        if (nRunBlocks > 0 && (pSlot->iBlock != iRunStart + nRunBlocks || nRunBlocks == nRunMax)) {
+            rc = ccvfs_restore_write(fdDst, &direct, aRun, (size_t)nRunBlocks * header.page_size,
+                                     (uint64_t)iRunStart * header.page_size);
+            if (rc != SQLITE_OK) {
+                goto shutdown;
+            }
+            nRunBlocks = 0;
+        }
+        if (nRunBlocks == 0) {
+            iRunStart = pSlot->iBlock;
+        }
+        memcpy(aRun + (size_t)nRunBlocks * header.page_size, pSlot->aPage, header.page_size);
+        nRunBlocks++;
+        nDone++;
+        
+        if (opts.xProgress && (nDone - nReported >= (nExtent + 99) / 100 || nDone == nExtent)) {
+            opts.xProgress(opts.pProgressArg, nDone, nExtent);
+            nReported = nDone;
+        }
+    }
+    if (nRunBlocks > 0) {
+        rc = ccvfs_restore_write(fdDst, &direct, aRun, (size_t)nRunBlocks * header.page_size,
+                                 (uint64_t)iRunStart * header.page_size);
+    }
+    
+shutdown:
+    ccvfs_ring_stop(&ring);
+    if (rc != SQLITE_OK) {
+        goto cleanup;
+    }
+    
+    if (nExtent == 0 && opts.xProgress) {
+        opts.xProgress(opts.pProgressArg, 0, 0);
+    }
+    
+    // 最后一块可能超出逻辑大小，未存储的块保留为空洞
+    // The last block may reach past the logical size, blocks that are not stored stay holes
+    if (ftruncate(fdDst, (off_t)nLogical) != 0 || fsync(fdDst) != 0) {
+        rc = SQLITE_IOERR_FSYNC;
+        goto cleanup;
+    }
+    
+    CCVFS_INFO("Decompressed %s: %llu -> %llu bytes", compressed_db,
+               (unsigned long long)nSourceFile, (unsigned long long)nLogical);
+    
+cleanup:
+    sqlite3_close(db);
+    if (fdDst >= 0 && close(fdDst) != 0 && rc == SQLITE_OK) {
+        rc = SQLITE_IOERR_CLOSE;
+    }
+    if (rc != SQLITE_OK && fdDst >= 0) {
+        unlink(output_db);
+    }
+    if (restore.aSlot) {
+        for (i = 0; i < nSlot; i++) {
+            sqlite3_free(restore.aSlot[i].aStored);
+            sqlite3_free(restore.aSlot[i].aDecrypted);
+            sqlite3_free(restore.aSlot[i].aPage);
+        }
+        sqlite3_free(restore.aSlot);
+    }
+    free(aRun);
+    sqlite3_free(aExtent);
+    sqlite3_free(aIndex);
+    if (zTempVfs) {
+        sqlite3_ccvfs_destroy(zTempVfs);
+        sqlite3_free(zTempVfs);
+    }
+    return rc;
+}
+
+/*
+ * 流式重新压缩
+ * Streaming recompression
+ *
+ * 工作项是一组逻辑上连续的字节，大小取源块和目标块中较大者，因此每组含整数个源块和目标块。
+ * 主线程按逻辑顺序读取一组的已存储源块（物理上相邻的块合并成一次读取），工作线程解码整组
+ * 再按目标配置逐块编码，主线程按组的顺序连续写出目标块。
+ * A work item is a logically contiguous group the size of the larger of the source and the
+ * target block, so every group holds whole source and target blocks. The main thread reads the
+ * stored source blocks of a group in logical order, physically adjacent blocks with one call,
+ * a worker decodes the group and encodes it block by block for the target, and the main thread
+ * writes the target blocks contiguously in group order.
+ */
+typedef struct {
+    uint32_t iAt;                 // Offset in aStored, when stored
+    int stored;                   // Zero for sparse blocks and blocks past the end of the source
+} CCVFSRecompressSource;
+
+typedef struct {
+    uint32_t iGroup;
+    CCVFSRecompressSource *aSource;  // Source blocks of the group
+    unsigned char *aStored;       // Stored source blocks, back to back
+    unsigned char *aDecrypted;    // Decryption output
+    unsigned char *aGroup;        // Decoded group
+    CCVFSPipelineSlot *aTarget;   // Target blocks of the group, their input points into aGroup
+} CCVFSRecompressSlot;
+
+typedef struct {
+    CCVFSRecompressSlot *aSlot;
+    CCVFSRestore source;          // Source index, algorithms and key for ccvfs_block_decode()
+    CCVFSPipeline target;         // Target algorithms, key and level for ccvfs_block_encode()
+    uint32_t nAlloc;              // Size of aDecrypted
+    uint32_t nGroupSize;
+    uint32_t nSourcePer;          // Source blocks per group
+    uint32_t nTargetPer;          // Target blocks per group
+    uint32_t nTarget;             // Target blocks in total
+    uint64_t nLogical;
+} CCVFSRecompress;
+
+static int ccvfs_recompress_group(void *pCtx, uint32_t iSlot) {
+    const CCVFSRecompress *p = (const CCVFSRecompress *)pCtx;
+    CCVFSRecompressSlot *pSlot = &p->aSlot[iSlot];
+    uint64_t iStart = (uint64_t)pSlot->iGroup * p->nGroupSize;
+    uint32_t i;
+    int rc;
+    
+    for (i = 0; i < p->nSourcePer; i++) {
+        uint32_t iBlock = pSlot->iGroup * p->nSourcePer + i;
+        unsigned char *aPage = pSlot->aGroup + (size_t)i * p->source.page_size;
+        
+        if (!pSlot->aSource[i].stored) {
+            memset(aPage, 0, p->source.page_size);
+            continue;
+        }
+        const CCVFSPageIndex *pIndex = &p->source.aIndex[iBlock];
+        const unsigned char *aStored = pSlot->aStored + pSlot->aSource[i].iAt;
+        if (ccvfs_crc32(aStored, (int)pIndex->compressed_size) != pIndex->checksum) {
+            CCVFS_ERROR("Block %u checksum mismatch at offset %llu", iBlock,
+                        (unsigned long long)pIndex->physical_offset);
+            return SQLITE_CORRUPT;
+        }
+        rc = ccvfs_block_decode(&p->source, iBlock, aStored, pSlot->aDecrypted, p->nAlloc, aPage);
+        if (rc != SQLITE_OK) {
+            return rc;
+        }
+    }
+    
+    // 源文件最后一块超出逻辑大小的部分可能残留旧数据，按普通数据库的末尾补零
+    // The last source block may hold stale bytes past the logical size, they are zero as past the
+    // end of a plain database
+    if (iStart + p->nGroupSize > p->nLogical) {
+        memset(pSlot->aGroup + (p->nLogical - iStart), 0, (size_t)(iStart + p->nGroupSize - p->nLogical));
+    }
+    
+    for (i = 0; i < p->nTargetPer && pSlot->iGroup * p->nTargetPer + i < p->nTarget; i++) {
+        rc = ccvfs_block_encode(&p->target, &pSlot->aTarget[i]);
+        if (rc != SQLITE_OK) {
+            return rc;
+        }
+    }
+    return SQLITE_OK;
+}
+
+static void ccvfs_recompress_free_slots(CCVFSRecompress *p, uint32_t nSlot) {
+    uint32_t i, j;
+    
+    if (!p->aSlot) {
+        return;
+    }
+    for (i = 0; i < nSlot; i++) {
+        CCVFSRecompressSlot *pSlot = &p->aSlot[i];
+        if (pSlot->aTarget) {
+            for (j = 0; j < p->nTargetPer; j++) {
+                sqlite3_free(pSlot->aTarget[j].aCompressed);
+                sqlite3_free(pSlot->aTarget[j].aEncrypted);
+            }
+            sqlite3_free(pSlot->aTarget);
+        }
+        sqlite3_free(pSlot->aSource);
+        sqlite3_free(pSlot->aStored);
+        sqlite3_free(pSlot->aDecrypted);
+        sqlite3_free(pSlot->aGroup);
+    }
+    sqlite3_free(p->aSlot);
+    p->aSlot = NULL;
+}
+
+int sqlite3_ccvfs_recompress(
+    const char *source_db,
+    const char *target_db,
+    const CCVFSRecompressOptions *pOptions
+) {
+    CCVFSRecompressOptions opts;
+    CCVFSRecompress rec;
+    CCVFSFileHeader header, after;
+    CCVFSPageIndex *aSourceIndex = NULL;
+    CCVFSPageIndex *aIndex = NULL;
+    CCVFSWorkRing ring;
+    char *zTempVfs = NULL;
+    const char *zVfs;
+    sqlite3 *db = NULL;
+    sqlite3_file *pSrc = NULL;
+    sqlite3_int64 nSourceFile = 0;
+    FILE *dst = NULL;
+    int rc;
+    uint32_t sqlitePageSize = 0, sqlitePages = 0;
+    uint32_t nSourceBlock = 0, nStoredMax = 0, nGroup, nSlot = 0;
+    uint32_t nCollected = 0, nWritten = 0, nReported = 0;
+    uint64_t iOffset = CCVFS_DATA_PAGES_OFFSET;
+    uint64_t nFile = 0;
+    uint32_t i, j;
+    
+    if (!source_db || !target_db) {
+        return SQLITE_MISUSE;
+    }
+    if (strcmp(source_db, target_db) == 0) {
+        CCVFS_ERROR("Cannot recompress %s onto itself", source_db);
+        return SQLITE_MISUSE;
+    }
+    
+    memset(&opts, 0, sizeof(opts));
+    if (pOptions) {
+        opts = *pOptions;
+    }
+    memset(&rec, 0, sizeof(rec));
+    memset(&ring, 0, sizeof(ring));
+    
+    rc = ccvfs_transcode_source_vfs(source_db, opts.vfs_name, opts.key, opts.key_len, &rec.source,
+                                    &zTempVfs, &zVfs);
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+    if (rec.source.pEncryptAlg && (!rec.source.key || rec.source.key_len <= 0 || rec.source.key_len > 64)) {
+        CCVFS_ERROR("%s is encrypted with %s and needs its key", source_db, rec.source.pEncryptAlg->name);
+        rc = SQLITE_MISUSE;
+        goto cleanup;
+    }
+    
+    // 读事务开始于空的WAL：WAL模式下写入者继续提交，主文件在复制期间保持不变
+    // The read transaction starts on an empty WAL: in WAL mode writers go on committing while the
+    // main file stays put during the copy
+    rc = ccvfs_transcode_open_source(source_db, zVfs, &db, &sqlitePageSize, &sqlitePages);
+    if (rc != SQLITE_OK) {
+        goto cleanup;
+    }
+    rec.nLogical = (uint64_t)sqlitePages * sqlitePageSize;
+    
+    // 通过连接自己的文件句柄读取，见sqlite3_ccvfs_decompress_database_parallel()
+    // Read through the connection's own file handle, see sqlite3_ccvfs_decompress_database_parallel()
+    if (sqlite3_file_control(db, NULL, SQLITE_FCNTL_FILE_POINTER, &pSrc) != SQLITE_OK || !pSrc ||
+        !((CCVFSFile *)pSrc)->is_ccvfs_file) {
+        CCVFS_ERROR("%s is not open through a CCVFS", source_db);
+        rc = SQLITE_ERROR;
+        goto cleanup;
+    }
+    pSrc = ((CCVFSFile *)pSrc)->pReal;
+    rc = ccvfs_transcode_load_index(source_db, pSrc, rec.nLogical, &header, &nSourceFile,
+                                    &aSourceIndex, &nSourceBlock, &nStoredMax);
+    if (rc != SQLITE_OK) {
+        goto cleanup;
+    }
+    rec.source.aIndex = aSourceIndex;
+    rec.source.page_size = header.page_size;
+    rec.nAlloc = nStoredMax ? nStoredMax : 1;
+    
+    // 目标配置：没有给出的设置沿用源文件
+    // Target configuration: settings not given are kept from the source
+    rc = ccvfs_pipeline_algorithms(opts.compress_algorithm ? opts.compress_algorithm
+                                                           : (rec.source.pCompressAlg ? rec.source.pCompressAlg->name : NULL),
+                                   opts.encrypt_algorithm ? opts.encrypt_algorithm
+                                                          : (rec.source.pEncryptAlg ? rec.source.pEncryptAlg->name : NULL),
+                                   &rec.target.pCompressAlg, &rec.target.pEncryptAlg);
+    if (rc != SQLITE_OK) {
+        goto cleanup;
+    }
+    rec.target.page_size = opts.page_size ? opts.page_size : header.page_size;
+    rec.target.level = opts.compression_level;
+    for (i = 0; i < nSourceBlock && rec.target.level == 0; i++) {
+        if (aSourceIndex[i].flags & CCVFS_PAGE_COMPRESSED) {
+            rec.target.level = (int)((aSourceIndex[i].flags & CCVFS_COMPRESSION_LEVEL_MASK) >> CCVFS_COMPRESSION_LEVEL_SHIFT);
+            break;
+        }
+    }
+    if (rec.target.level == 0) {
+        rec.target.level = CCVFS_DEFAULT_COMPRESS_LEVEL;
+    }
+    rec.target.key = opts.target_key ? opts.target_key : rec.source.key;
+    rec.target.key_len = opts.target_key ? opts.target_key_len : rec.source.key_len;
+    if (rec.target.page_size < CCVFS_MIN_PAGE_SIZE || rec.target.page_size > CCVFS_MAX_PAGE_SIZE ||
+        (rec.target.page_size & (rec.target.page_size - 1)) != 0) {
+        CCVFS_ERROR("Invalid page size %u", rec.target.page_size);
+        rc = SQLITE_MISUSE;
+        goto cleanup;
+    }
+    if (rec.target.level < CCVFS_MIN_COMPRESS_LEVEL || rec.target.level > CCVFS_MAX_COMPRESS_LEVEL) {
+        CCVFS_ERROR("Invalid compression level %d", rec.target.level);
+        rc = SQLITE_MISUSE;
+        goto cleanup;
+    }
+    if (rec.target.pEncryptAlg && (!rec.target.key || rec.target.key_len <= 0 || rec.target.key_len > 64)) {
+        CCVFS_ERROR("Encryption with %s needs a key of 1 to 64 bytes", rec.target.pEncryptAlg->name);
+        rc = SQLITE_MISUSE;
+        goto cleanup;
+    }
+    if ((rec.nLogical + rec.target.page_size - 1) / rec.target.page_size > CCVFS_MAX_PAGES) {
+        CCVFS_ERROR("%llu bytes need more than %d blocks of %u bytes",
+                    (unsigned long long)rec.nLogical, CCVFS_MAX_PAGES, rec.target.page_size);
+        rc = SQLITE_FULL;
+        goto cleanup;
+    }
+    rec.nTarget = (uint32_t)((rec.nLogical + rec.target.page_size - 1) / rec.target.page_size);
+    rec.target.nCompressed = rec.target.pCompressAlg
+                           ? rec.target.pCompressAlg->get_max_compressed_size((int)rec.target.page_size)
+                           : (int)rec.target.page_size;
+    if (rec.target.nCompressed < (int)rec.target.page_size) {
+        rec.target.nCompressed = (int)rec.target.page_size;
+    }
+    // AES-CBC需要IV和最多16字节填充
+    // AES-CBC needs room for the IV and up to 16 bytes of padding
+    rec.target.nEncrypted = rec.target.nCompressed + 16 + 16;
+    
+    rec.nGroupSize = header.page_size > rec.target.page_size ? header.page_size : rec.target.page_size;
+    rec.nSourcePer = rec.nGroupSize / header.page_size;
+    rec.nTargetPer = rec.nGroupSize / rec.target.page_size;
+    nGroup = (uint32_t)((rec.nLogical + rec.nGroupSize - 1) / rec.nGroupSize);
+    
+    int nThread = ccvfs_ring_threads(opts.threads, nGroup);
+    nSlot = (uint32_t)nThread * CCVFS_PIPELINE_SLOTS_PER_THREAD;
+    aIndex = (CCVFSPageIndex *)sqlite3_malloc64(sizeof(CCVFSPageIndex) * (rec.nTarget ? rec.nTarget : 1));
+    rec.aSlot = (CCVFSRecompressSlot *)sqlite3_malloc64(sizeof(CCVFSRecompressSlot) * nSlot);
+    if (!aIndex || !rec.aSlot) {
+        rc = SQLITE_NOMEM;
+        goto cleanup;
+    }
+    memset(aIndex, 0, sizeof(CCVFSPageIndex) * (rec.nTarget ? rec.nTarget : 1));
+    memset(rec.aSlot, 0, sizeof(CCVFSRecompressSlot) * nSlot);
+    for (i = 0; i < nSlot; i++) {
+        CCVFSRecompressSlot *pSlot = &rec.aSlot[i];
+        pSlot->aSource = (CCVFSRecompressSource *)sqlite3_malloc64(sizeof(CCVFSRecompressSource) * rec.nSourcePer);
+        pSlot->aStored = (unsigned char *)sqlite3_malloc64((sqlite3_uint64)rec.nAlloc * rec.nSourcePer);
+        pSlot->aDecrypted = (unsigned char *)sqlite3_malloc(rec.nAlloc);
+        pSlot->aGroup = (unsigned char *)sqlite3_malloc(rec.nGroupSize);
+        pSlot->aTarget = (CCVFSPipelineSlot *)sqlite3_malloc64(sizeof(CCVFSPipelineSlot) * rec.nTargetPer);
+        if (!pSlot->aSource || !pSlot->aStored || !pSlot->aDecrypted || !pSlot->aGroup || !pSlot->aTarget) {
+            rc = SQLITE_NOMEM;
+            goto cleanup;
+        }
+        memset(pSlot->aTarget, 0, sizeof(CCVFSPipelineSlot) * rec.nTargetPer);
+        for (j = 0; j < rec.nTargetPer; j++) {
+            pSlot->aTarget[j].aInput = pSlot->aGroup + (size_t)j * rec.target.page_size;
+            pSlot->aTarget[j].aCompressed = (unsigned char *)sqlite3_malloc(rec.target.nCompressed);
+            pSlot->aTarget[j].aEncrypted = (unsigned char *)sqlite3_malloc(rec.target.nEncrypted);
+            if (!pSlot->aTarget[j].aCompressed || !pSlot->aTarget[j].aEncrypted) {
+                rc = SQLITE_NOMEM;
+                goto cleanup;
+            }
+        }
+    }
+    
+    ccvfs_transcode_remove_journals(target_db);
+    dst = fopen(target_db, "wb");
+    if (!dst) {
+        CCVFS_ERROR("Failed to open %s", target_db);
+        rc = SQLITE_CANTOPEN;
+        goto cleanup;
+    }
+    setvbuf(dst, NULL, _IOFBF, CCVFS_PIPELINE_WRITE_BUFFER);
+    if (fseeko(dst, (off_t)CCVFS_DATA_PAGES_OFFSET, SEEK_SET) != 0) {
+        rc = SQLITE_IOERR_SEEK;
+        goto cleanup;
+    }
+    
+    rc = ccvfs_ring_start(&ring, nThread, ccvfs_recompress_group, &rec);
+    if (rc != SQLITE_OK) {
+        goto shutdown;
+    }
+    
+    CCVFS_INFO("Recompressing %s: %u blocks of %u bytes into %u blocks of %u bytes on %d workers",
+               source_db, nSourceBlock, header.page_size, rec.nTarget, rec.target.page_size, ring.nThread);
+    
+    while (nCollected < nGroup) {
+        // 读取：按逻辑顺序填满在途窗口，物理上相邻的已存储块一次读取
+        // Read: fill the in-flight window in logical order, physically adjacent stored blocks are
+        // read with one call
+        while (ring.nSubmitted < nGroup && ring.nSubmitted - nCollected < nSlot) {
+            CCVFSRecompressSlot *pSlot = &rec.aSlot[ccvfs_ring_next(&ring)];
+            uint64_t iRead = 0;
+            uint32_t nRead = 0, nAt = 0;
+            
+            pSlot->iGroup = ring.nSubmitted;
+            for (i = 0; i <= rec.nSourcePer; i++) {
+                uint32_t iBlock = pSlot->iGroup * rec.nSourcePer + i;
+                const CCVFSPageIndex *pIndex = i < rec.nSourcePer && iBlock < nSourceBlock ? &aSourceIndex[iBlock] : NULL;
+                int stored = pIndex && pIndex->physical_offset != 0 && !(pIndex->flags & CCVFS_PAGE_SPARSE) &&
+                             pIndex->compressed_size != 0;
+                
+                if (nRead > 0 && (!stored || pIndex->physical_offset != iRead + nRead)) {
+                    rc = pSrc->pMethods->xRead(pSrc, pSlot->aStored + nAt - nRead, (int)nRead, (sqlite3_int64)iRead);
+                    if (rc != SQLITE_OK) {
+                        CCVFS_ERROR("Failed to read %u bytes at offset %llu of %s: %d", nRead,
+                                    (unsigned long long)iRead, source_db, rc);
+                        goto shutdown;
+                    }
+                    nRead = 0;
+                }
+                if (i == rec.nSourcePer) {
+                    break;
+                }
+                pSlot->aSource[i].stored = stored;
+                if (stored) {
+                    if (nRead == 0) {
+                        iRead = pIndex->physical_offset;
+                    }
+                    pSlot->aSource[i].iAt = nAt;
+                    nAt += pIndex->compressed_size;
+                    nRead += pIndex->compressed_size;
+                }
+            }
+            ccvfs_ring_submit(&ring);
+        }
+        
+        // 写入：按组的顺序连续写出目标块
+        // Write: the target blocks go out contiguously in group order
+        CCVFSRecompressSlot *pSlot = &rec.aSlot[ccvfs_ring_collect(&ring, nCollected, &rc)];
+        if (rc != SQLITE_OK) {
+            CCVFS_ERROR("Failed to recode group %u: %d", nCollected, rc);
+            goto shutdown;
+        }
+        for (i = 0; i < rec.nTargetPer && nWritten < rec.nTarget; i++) {
+            const CCVFSPipelineSlot *pTarget = &pSlot->aTarget[i];
+            CCVFSPageIndex *pIndex = &aIndex[nWritten];
+            
+            pIndex->original_size = rec.target.page_size;
+            pIndex->flags = pTarget->flags;
+            if (pTarget->nOut > 0) {
+                if (fwrite(pTarget->pOut, 1, pTarget->nOut, dst) != pTarget->nOut) {
+                    rc = SQLITE_IOERR_WRITE;
+                    goto shutdown;
+                }
+                pIndex->physical_offset = iOffset;
+                pIndex->compressed_size = pTarget->nOut;
+                pIndex->checksum = pTarget->checksum;
+                iOffset += pTarget->nOut;
+            }
+            nWritten++;
+        }
+        nCollected++;
+        
+        if (opts.xProgress && (nWritten - nReported >= (rec.nTarget + 99) / 100 || nWritten == rec.nTarget)) {
+            opts.xProgress(opts.pProgressArg, nWritten, rec.nTarget);
+            nReported = nWritten;
+        }
+    }
+    rc = SQLITE_OK;
+    
+shutdown:
+    ccvfs_ring_stop(&ring);
+    if (rc != SQLITE_OK) {
+        goto cleanup;
+    }
+    if (rec.nTarget == 0 && opts.xProgress) {
+        opts.xProgress(opts.pProgressArg, 0, 0);
+    }
+    
+    // 读事务应使文件头保持不变；变化时复制结果不可信
+    // The read transaction should keep the header put, the copy is void if it changed
+    rc = pSrc->pMethods->xRead(pSrc, &after, CCVFS_HEADER_SIZE, 0);
+    if (rc == SQLITE_OK && (after.change_counter != header.change_counter ||
+                            after.total_pages != header.total_pages)) {
+        CCVFS_ERROR("%s changed while it was recompressed", source_db);
+        rc = SQLITE_BUSY;
+    }
+    if (rc != SQLITE_OK) {
+        goto cleanup;
+    }
+    
+    rc = ccvfs_pipeline_finish(dst, &rec.target, aIndex, rec.nTarget, iOffset, rec.nLogical, &nFile);
+    if (rc != SQLITE_OK) {
+        goto cleanup;
+    }
+    
+    CCVFS_INFO("Recompressed %s: %llu -> %llu bytes", source_db,
+               (unsigned long long)nSourceFile, (unsigned long long)nFile);
+    
+cleanup:
+    sqlite3_close(db);
+    if (dst && fclose(dst) != 0 && rc == SQLITE_OK) {
+        rc = SQLITE_IOERR_WRITE;
+    }
+    if (rc != SQLITE_OK && dst) {
+        remove(target_db);
+    }
+    ccvfs_recompress_free_slots(&rec, nSlot);
+    sqlite3_free(aIndex);
+    sqlite3_free(aSourceIndex);
+    if (zTempVfs) {
+        sqlite3_ccvfs_destroy(zTempVfs);
+        sqlite3_free(zTempVfs);
+    }
+    return rc;
+}
+
+/*
+ * 页级校验
+ * Page-level verification
+ *
+ * 主线程按物理偏移顺序把相邻的数据块合并成一段读取，工作线程逐块检查段内的数据块，
+ * 主线程再按读取顺序汇总结果。段之间不超过CCVFS_VERIFY_RUN_GAP的空隙一并读过，
+ * 以换取更少更大的顺序读取。
+ * The main thread reads neighbouring stored blocks as one run in physical offset order, the
+ * workers check the blocks of a run one by one, and the main thread tallies the results in
+ * read order. Gaps of up to CCVFS_VERIFY_RUN_GAP bytes are read through to get fewer, larger
+ * sequential reads.
+ */
+#define CCVFS_VERIFY_RUN_SIZE   (4 * 1024 * 1024)  // Largest merged read
+#define CCVFS_VERIFY_RUN_GAP    (64 * 1024)        // Largest gap read through within a run
+
+#define CCVFS_VERIFY_OK         0
+#define CCVFS_VERIFY_CHECKSUM   1
+#define CCVFS_VERIFY_DECODE     2
+
+typedef struct {
+    uint64_t physical_offset;
+    uint32_t size;
+    uint32_t iBlock;
+    int status;                   // CCVFS_VERIFY_*, set by the worker that checks the run
+} CCVFSVerifyExtent;
+
+typedef struct {
+    uint64_t iOffset;             // File offset of aRun[0]
+    uint32_t iFirst;              // First extent of the run
+    uint32_t nExtent;
+    unsigned char *aRun;          // Bytes of the run as stored
+    unsigned char *aDecrypted;    // Decryption output
+    unsigned char *aPage;         // Decoded block
+} CCVFSVerifySlot;
+
+// Neighbouring extents read with one call
+typedef struct {
+    uint64_t iOffset;
+    uint32_t nByte;
+    uint32_t nExtent;
+} CCVFSVerifyRun;
+
+typedef struct {
+    CCVFSVerifySlot *aSlot;
+    CCVFSVerifyExtent *aExtent;
+    CCVFSRestore codec;           // Index, algorithms and key for ccvfs_block_decode()
+    uint32_t nAlloc;              // Size of aDecrypted
+    int decode;                   // Decrypt and decompress, not only checksum
+} CCVFSVerify;
+
+static int ccvfs_verify_extent_cmp(const void *a, const void *b) {
+    const CCVFSVerifyExtent *x = (const CCVFSVerifyExtent *)a;
+    const CCVFSVerifyExtent *y = (const CCVFSVerifyExtent *)b;
+    if (x->physical_offset != y->physical_offset) {
+        return x->physical_offset < y->physical_offset ? -1 : 1;
+    }
+    return x->iBlock < y->iBlock ? -1 : (x->iBlock > y->iBlock);
+}
+
+static int ccvfs_verify_block_cmp(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return x < y ? -1 : (x > y);
+}
+
+static int ccvfs_verify_run(void *pCtx, uint32_t iSlot) {
+    const CCVFSVerify *p = (const CCVFSVerify *)pCtx;
+    CCVFSVerifySlot *pSlot = &p->aSlot[iSlot];
+    uint32_t i;
+    
+    for (i = 0; i < pSlot->nExtent; i++) {
+        CCVFSVerifyExtent *pExtent = &p->aExtent[pSlot->iFirst + i];
+        const unsigned char *aStored = pSlot->aRun + (pExtent->physical_offset - pSlot->iOffset);
+        
+        if (ccvfs_crc32(aStored, (int)pExtent->size) != p->codec.aIndex[pExtent->iBlock].checksum) {
+            pExtent->status = CCVFS_VERIFY_CHECKSUM;
+        } else if (p->decode && ccvfs_block_decode(&p->codec, pExtent->iBlock, aStored, pSlot->aDecrypted,
+                                                   p->nAlloc, pSlot->aPage) != SQLITE_OK) {
+            pExtent->status = CCVFS_VERIFY_DECODE;
+        } else {
+            pExtent->status = CCVFS_VERIFY_OK;
+        }
+    }
+    return SQLITE_OK;
+}
+
+static void ccvfs_verify_report(CCVFSVerifyResult *pResult, uint32_t iBlock) {
+    if (pResult->corrupt_count < CCVFS_VERIFY_MAX_REPORTED) {
+        pResult->corrupt_blocks[pResult->corrupt_count] = iBlock;
+    }
+    pResult->corrupt_count++;
+}
+
+int sqlite3_ccvfs_verify(
+    const char *path,
+    const CCVFSVerifyOptions *pOptions,
+    CCVFSVerifyResult *pResult
+) {
+    CCVFSVerifyOptions opts;
+    CCVFSVerify verify;
+    CCVFSFileHeader header, after;
+    CCVFSPageIndex *aIndex = NULL;
+    CCVFSVerifyExtent *aExtent = NULL;
+    CCVFSVerifyRun *aRunPlan = NULL;
+    CCVFSWorkRing ring;
+    sqlite3_vfs *pVfs = sqlite3_vfs_find(NULL);
+    sqlite3_file *pFile = NULL;
+    sqlite3_filename zName = NULL;
+    sqlite3_int64 nFile = 0;
+    uint64_t iCursor, iEnd;
+    uint32_t nEntry, nExtent = 0, nRun = 0, nSlot = 0, nDone = 0, nTallied = 0, nReported = 0;
+    uint32_t nStoredMax = 0, nRunMax = 0;
+    uint32_t i;
+    int locked = 0;
+    int rc;
+    
+    if (!path || !pResult || !pVfs) {
+        return SQLITE_MISUSE;
+    }
+    memset(pResult, 0, sizeof(*pResult));
+    memset(&opts, 0, sizeof(opts));
+    if (pOptions) {
+        opts = *pOptions;
+    }
+    memset(&verify, 0, sizeof(verify));
+    memset(&ring, 0, sizeof(ring));
+    
+    // 经由默认VFS打开，原因见ccvfs_transcode_read_header()；共享锁使回滚日志模式的写入者无法提交
+    // Open through the default VFS, see ccvfs_transcode_read_header(); the shared lock keeps
+    // writers in rollback journal mode from committing
+    zName = sqlite3_create_filename(path, "", "", 0, NULL);
+    pFile = (sqlite3_file *)sqlite3_malloc(pVfs->szOsFile);
+    if (!zName || !pFile) {
+        rc = SQLITE_NOMEM;
+        goto cleanup;
+    }
+    memset(pFile, 0, pVfs->szOsFile);
+    rc = pVfs->xOpen(pVfs, zName, pFile, SQLITE_OPEN_READONLY | SQLITE_OPEN_MAIN_DB, NULL);
+    if (rc == SQLITE_OK) {
+        rc = pFile->pMethods->xLock(pFile, SQLITE_LOCK_SHARED);
+        locked = rc == SQLITE_OK;
+    }
+    if (rc == SQLITE_OK) {
+        rc = pFile->pMethods->xFileSize(pFile, &nFile);
+    }
+    if (rc == SQLITE_OK) {
+        rc = pFile->pMethods->xRead(pFile, &header, CCVFS_HEADER_SIZE, 0);
+        if (rc == SQLITE_IOERR_SHORT_READ || (rc == SQLITE_OK && memcmp(header.magic, CCVFS_MAGIC, 8) != 0)) {
+            CCVFS_ERROR("%s is not a CCVFS file", path);
+            rc = SQLITE_NOTADB;
+        }
+    }
+    if (rc != SQLITE_OK) {
+        goto cleanup;
+    }
+    pResult->file_size = (uint64_t)nFile;
+    pResult->block_size = header.page_size;
+    pResult->total_blocks = header.total_pages;
+    if (header.page_size < CCVFS_MIN_PAGE_SIZE || header.page_size > CCVFS_MAX_PAGE_SIZE ||
+        (header.page_size & (header.page_size - 1)) != 0 || header.total_pages > CCVFS_MAX_PAGES ||
+        header.index_table_offset != CCVFS_INDEX_TABLE_OFFSET) {
+        CCVFS_ERROR("Invalid CCVFS header in %s: block size %u, %u blocks, index at %llu", path,
+                    header.page_size, header.total_pages, (unsigned long long)header.index_table_offset);
+        rc = SQLITE_CORRUPT;
+        goto cleanup;
+    }
+    
+    if (opts.vfs_name) {
+        CCVFS *pCcvfs = (CCVFS *)sqlite3_vfs_find(opts.vfs_name);
+        if (!pCcvfs) {
+            CCVFS_ERROR("VFS %s does not exist", opts.vfs_name);
+            rc = SQLITE_ERROR;
+            goto cleanup;
+        }
+        verify.codec.pCompressAlg = pCcvfs->pCompressAlg;
+        verify.codec.pEncryptAlg = pCcvfs->pEncryptAlg;
+        if (pCcvfs->key_set) {
+            verify.codec.key = pCcvfs->encryption_key;
+            verify.codec.key_len = pCcvfs->key_length;
+        }
+    } else {
+        header.compress_algorithm[CCVFS_MAX_ALGORITHM_NAME - 1] = '\0';
+        header.encrypt_algorithm[CCVFS_MAX_ALGORITHM_NAME - 1] = '\0';
+        rc = ccvfs_pipeline_algorithms(header.compress_algorithm, header.encrypt_algorithm,
+                                       &verify.codec.pCompressAlg, &verify.codec.pEncryptAlg);
+        if (rc != SQLITE_OK) {
+            goto cleanup;
+        }
+        if (header.compress_algorithm[0] && strcmp(header.compress_algorithm, "none") != 0 &&
+            !verify.codec.pCompressAlg) {
+            CCVFS_ERROR("Compression algorithm %s is not available", header.compress_algorithm);
+            rc = SQLITE_ERROR;
+            goto cleanup;
+        }
+        verify.codec.key = opts.key;
+        verify.codec.key_len = opts.key_len;
+    }
+    if (verify.codec.key_len < 0 || verify.codec.key_len > 64) {
+        rc = SQLITE_MISUSE;
+        goto cleanup;
+    }
+    // 没有密钥时加密的块只检查校验和
+    // Without a key encrypted blocks get their checksums checked only
+    verify.decode = !verify.codec.pEncryptAlg || (verify.codec.key && verify.codec.key_len > 0);
+    verify.codec.page_size = header.page_size;
+    pResult->decoded = verify.decode;
+    
+    nEntry = header.total_pages;
+    aIndex = (CCVFSPageIndex *)sqlite3_malloc64(sizeof(CCVFSPageIndex) * (nEntry ? nEntry : 1));
+    aExtent = (CCVFSVerifyExtent *)sqlite3_malloc64(sizeof(CCVFSVerifyExtent) * (nEntry ? nEntry : 1));
+    aRunPlan = (CCVFSVerifyRun *)sqlite3_malloc64(sizeof(CCVFSVerifyRun) * (nEntry ? nEntry : 1));
+    if (!aIndex || !aExtent || !aRunPlan) {
+        rc = SQLITE_NOMEM;
+        goto cleanup;
+    }
+    if (nEntry > 0) {
+        // 只有稀疏块的文件可能止于索引表中间，缺少的条目读作零
+        // A file of sparse blocks only may end inside the index table, missing entries read as zero
+        rc = pFile->pMethods->xRead(pFile, aIndex, (int)(sizeof(CCVFSPageIndex) * nEntry),
+                                    (sqlite3_int64)header.index_table_offset);
+        if (rc == SQLITE_IOERR_SHORT_READ) {
+            rc = SQLITE_OK;
+        }
+        if (rc != SQLITE_OK) {
+            CCVFS_ERROR("Failed to read the index table of %s: %d", path, rc);
+            goto cleanup;
+        }
+    }
+    verify.codec.aIndex = aIndex;
+    
+    for (i = 0; i < nEntry; i++) {
+        const CCVFSPageIndex *pIndex = &aIndex[i];
+        if (pIndex->physical_offset == 0 || (pIndex->flags & CCVFS_PAGE_SPARSE) || pIndex->compressed_size == 0) {
+            pResult->sparse_blocks++;
+            continue;
+        }
+        if (pIndex->physical_offset < CCVFS_DATA_PAGES_OFFSET || pIndex->original_size > header.page_size ||
+            pIndex->compressed_size > header.page_size * 2 + 64 ||
+            pIndex->physical_offset + pIndex->compressed_size > (uint64_t)nFile) {
+            CCVFS_ERROR("Block %u has an invalid index entry: offset=%llu, size=%u, original=%u",
+                        i, (unsigned long long)pIndex->physical_offset, pIndex->compressed_size,
+                        pIndex->original_size);
+            pResult->invalid_entries++;
+            ccvfs_verify_report(pResult, i);
+            continue;
+        }
+        pResult->stored_blocks++;
+        pResult->stored_bytes += pIndex->compressed_size;
+        if (pIndex->compressed_size > nStoredMax) {
+            nStoredMax = pIndex->compressed_size;
+        }
+        aExtent[nExtent].physical_offset = pIndex->physical_offset;
+        aExtent[nExtent].size = pIndex->compressed_size;
+        aExtent[nExtent].iBlock = i;
+        aExtent[nExtent].status = CCVFS_VERIFY_OK;
+        nExtent++;
+    }
+    qsort(aExtent, nExtent, sizeof(CCVFSVerifyExtent), ccvfs_verify_extent_cmp);
+    
+    // 空间布局：重叠的块和数据区中没有被引用的空隙；同时把块分成顺序读取的段
+    // Layout: overlapping blocks and unreferenced gaps in the data area; the blocks are cut into
+    // runs for sequential reads at the same time
+    iCursor = CCVFS_DATA_PAGES_OFFSET;
+    for (i = 0; i < nExtent; i++) {
+        const CCVFSVerifyExtent *pExtent = &aExtent[i];
+        CCVFSVerifyRun *pPlan = nRun > 0 ? &aRunPlan[nRun - 1] : NULL;
+        
+        iEnd = pExtent->physical_offset + pExtent->size;
+        if (pExtent->physical_offset < iCursor) {
+            pResult->overlapping_extents++;
+        } else if (pExtent->physical_offset > iCursor) {
+            pResult->unreferenced_extents++;
+            pResult->unreferenced_bytes += pExtent->physical_offset - iCursor;
+        }
+        
+        if (!pPlan || pExtent->physical_offset > pPlan->iOffset + pPlan->nByte + CCVFS_VERIFY_RUN_GAP ||
+            iEnd - pPlan->iOffset > CCVFS_VERIFY_RUN_SIZE) {
+            pPlan = &aRunPlan[nRun++];
+            pPlan->iOffset = pExtent->physical_offset;
+            pPlan->nByte = 0;
+            pPlan->nExtent = 0;
+        }
+        if (iEnd - pPlan->iOffset > pPlan->nByte) {
+            pPlan->nByte = (uint32_t)(iEnd - pPlan->iOffset);
+        }
+        pPlan->nExtent++;
+        if (pPlan->nByte > nRunMax) {
+            nRunMax = pPlan->nByte;
+        }
+        if (iEnd > iCursor) {
+            iCursor = iEnd;
+        }
+    }
+    if ((uint64_t)nFile > iCursor && nExtent > 0) {
+        pResult->unreferenced_extents++;
+        pResult->unreferenced_bytes += (uint64_t)nFile - iCursor;
+    }
+    
+    int nThread = ccvfs_ring_threads(opts.threads, nRun);
+    nSlot = (uint32_t)nThread * CCVFS_PIPELINE_SLOTS_PER_THREAD;
+    verify.aExtent = aExtent;
+    verify.nAlloc = nStoredMax ? nStoredMax : 1;
+    verify.aSlot = (CCVFSVerifySlot *)sqlite3_malloc64(sizeof(CCVFSVerifySlot) * nSlot);
+    if (!verify.aSlot) {
+        rc = SQLITE_NOMEM;
+        goto cleanup;
+    }
+    memset(verify.aSlot, 0, sizeof(CCVFSVerifySlot) * nSlot);
+    for (i = 0; i < nSlot && nRun > 0; i++) {
+        CCVFSVerifySlot *pSlot = &verify.aSlot[i];
+        pSlot->aRun = (unsigned char *)sqlite3_malloc(nRunMax);
+        pSlot->aDecrypted = (unsigned char *)sqlite3_malloc(verify.nAlloc);
+        pSlot->aPage = (unsigned char *)sqlite3_malloc(header.page_size);
+        if (!pSlot->aRun || !pSlot->aDecrypted || !pSlot->aPage) {
+            rc = SQLITE_NOMEM;
+            goto cleanup;
+        }
+    }
+    
+    if (nRun > 0) {
+        rc = ccvfs_ring_start(&ring, nThread, ccvfs_verify_run, &verify);
+        if (rc != SQLITE_OK) {
+            goto shutdown;
+        }
+        pResult->threads = ring.nThread;
+    }
+    
+    CCVFS_INFO("Verifying %s: %u of %u blocks stored in %u runs, on %d workers%s", path, nExtent, nEntry, nRun,
+               pResult->threads, verify.decode ? "" : ", checksums only");
+    
+    while (nTallied < nRun) {
+        // 读取：按物理偏移顺序填满在途窗口
+        // Read: fill the in-flight window in physical offset order
+        while (ring.nSubmitted < nRun && ring.nSubmitted - nTallied < nSlot) {
+            CCVFSVerifySlot *pSlot = &verify.aSlot[ccvfs_ring_next(&ring)];
+            const CCVFSVerifyRun *pPlan = &aRunPlan[ring.nSubmitted];
+            
+            pSlot->iOffset = pPlan->iOffset;
+            pSlot->iFirst = nDone;
+            pSlot->nExtent = pPlan->nExtent;
+            nDone += pPlan->nExtent;
+            rc = pFile->pMethods->xRead(pFile, pSlot->aRun, (int)pPlan->nByte, (sqlite3_int64)pPlan->iOffset);
+            if (rc != SQLITE_OK) {
+                CCVFS_ERROR("Failed to read %u bytes at offset %llu of %s: %d", pPlan->nByte,
+                            (unsigned long long)pPlan->iOffset, path, rc);
+                goto shutdown;
+            }
+            ccvfs_ring_submit(&ring);
+        }
+        
+        // 汇总：按读取顺序取回
+        // Tally: collect in read order
+        int rcRun;
+        CCVFSVerifySlot *pSlot = &verify.aSlot[ccvfs_ring_collect(&ring, nTallied, &rcRun)];
+        for (i = 0; i < pSlot->nExtent; i++) {
+            const CCVFSVerifyExtent *pExtent = &aExtent[pSlot->iFirst + i];
+            if (pExtent->status == CCVFS_VERIFY_OK) {
+                continue;
+            }
+            if (pExtent->status == CCVFS_VERIFY_CHECKSUM) {
+                CCVFS_ERROR("Block %u checksum mismatch at offset %llu", pExtent->iBlock,
+                            (unsigned long long)pExtent->physical_offset);
+                pResult->checksum_errors++;
+            } else {
+                pResult->decode_errors++;
+            }
+            ccvfs_verify_report(pResult, pExtent->iBlock);
+        }
+        nTallied++;
+        
+        uint32_t nChecked = pSlot->iFirst + pSlot->nExtent;
+        if (opts.xProgress && (nChecked - nReported >= (nExtent + 99) / 100 || nChecked == nExtent)) {
+            opts.xProgress(opts.pProgressArg, nChecked, nExtent);
+            nReported = nChecked;
+        }
+    }
+    
+shutdown:
+    ccvfs_ring_stop(&ring);
+    if (rc != SQLITE_OK) {
+        goto cleanup;
+    }
+    if (nExtent == 0 && opts.xProgress) {
+        opts.xProgress(opts.pProgressArg, 0, 0);
+    }
+    
+    // 共享锁挡不住WAL检查点：文件头在检查期间变化时结果不可信
+    // A shared lock does not hold off a WAL checkpoint: the findings are void if the header changed
+    // during the check
+    rc = pFile->pMethods->xRead(pFile, &after, CCVFS_HEADER_SIZE, 0);
+    if (rc == SQLITE_OK && (after.change_counter != header.change_counter ||
+                            after.total_pages != header.total_pages)) {
+        CCVFS_ERROR("%s changed while it was verified", path);
+        rc = SQLITE_BUSY;
+        goto cleanup;
+    }
+    if (rc != SQLITE_OK) {
+        goto cleanup;
+    }
+    
+    qsort(pResult->corrupt_blocks,
+          pResult->corrupt_count < CCVFS_VERIFY_MAX_REPORTED ? pResult->corrupt_count : CCVFS_VERIFY_MAX_REPORTED,
+          sizeof(uint32_t), ccvfs_verify_block_cmp);
+    if (pResult->corrupt_count > 0 || pResult->overlapping_extents > 0) {
+        rc = SQLITE_CORRUPT;
+    }
+    CCVFS_INFO("Verified %s: %u blocks, %u corrupt, %u overlapping, %llu unreferenced bytes", path,
+               pResult->stored_blocks, pResult->corrupt_count, pResult->overlapping_extents,
+               (unsigned long long)pResult->unreferenced_bytes);
+    
+cleanup:
+    if (pFile && pFile->pMethods) {
+        if (locked) {
+            pFile->pMethods->xUnlock(pFile, SQLITE_LOCK_NONE);
+        }
+        pFile->pMethods->xClose(pFile);
+    }
+    sqlite3_free(pFile);
+    sqlite3_free_filename(zName);
+    if (verify.aSlot) {
+        for (i = 0; i < nSlot; i++) {
+            sqlite3_free(verify.aSlot[i].aRun);
+            sqlite3_free(verify.aSlot[i].aDecrypted);
+            sqlite3_free(verify.aSlot[i].aPage);
+        }
+        sqlite3_free(verify.aSlot);
+    }
+    sqlite3_free(aRunPlan);
+    sqlite3_free(aExtent);
+    sqlite3_free(aIndex);
+    return rc;
+}
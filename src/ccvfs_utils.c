@@ -1,21 +1,51 @@
 #include "ccvfs_utils.h"
+#include <pthread.h>
 
 /*
  * CRC32 checksum calculation using Ethernet polynomial
+ * 按8字节一组查表（slicing-by-8），结果与逐位计算相同
+ * Eight bytes at a time through lookup tables (slicing-by-8), the result is the same as the
+ * bit by bit calculation
  */
-uint32_t ccvfs_crc32(const unsigned char *data, int len) {
-    uint32_t crc = 0xFFFFFFFF;
-    int i, j;
+static uint32_t ccvfs_crc32_table[8][256];
+static pthread_once_t ccvfs_crc32_once = PTHREAD_ONCE_INIT;
 
-    for (i = 0; i < len; i++) {
-        crc ^= data[i];
+static void ccvfs_crc32_init(void) {
+    uint32_t i, j;
+
+    for (i = 0; i < 256; i++) {
+        uint32_t crc = i;
         for (j = 0; j < 8; j++) {
-            if (crc & 1) {
-                crc = (crc >> 1) ^ CCVFS_CRC32_POLYNOMIAL;
-            } else {
-                crc >>= 1;
-            }
+            crc = (crc & 1) ? (crc >> 1) ^ CCVFS_CRC32_POLYNOMIAL : crc >> 1;
         }
+        ccvfs_crc32_table[0][i] = crc;
+    }
+    for (i = 0; i < 256; i++) {
+        for (j = 1; j < 8; j++) {
+            uint32_t prev = ccvfs_crc32_table[j - 1][i];
+            ccvfs_crc32_table[j][i] = (prev >> 8) ^ ccvfs_crc32_table[0][prev & 0xFF];
+        }
+    }
+}
+
+uint32_t ccvfs_crc32(const unsigned char *data, int len) {
+    uint32_t crc = 0xFFFFFFFF;
+    int i = 0;
+
+    pthread_once(&ccvfs_crc32_once, ccvfs_crc32_init);
+
+    for (; i + 8 <= len; i += 8) {
+        const unsigned char *p = data + i;
+        uint32_t one = crc ^ ((uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+                              ((uint32_t)p[3] << 24));
+        uint32_t two = (uint32_t)p[4] | ((uint32_t)p[5] << 8) | ((uint32_t)p[6] << 16) | ((uint32_t)p[7] << 24);
+        crc = ccvfs_crc32_table[7][one & 0xFF] ^ ccvfs_crc32_table[6][(one >> 8) & 0xFF] ^
+              ccvfs_crc32_table[5][(one >> 16) & 0xFF] ^ ccvfs_crc32_table[4][one >> 24] ^
+              ccvfs_crc32_table[3][two & 0xFF] ^ ccvfs_crc32_table[2][(two >> 8) & 0xFF] ^
+              ccvfs_crc32_table[1][(two >> 16) & 0xFF] ^ ccvfs_crc32_table[0][two >> 24];
+    }
+    for (; i < len; i++) {
+        crc = (crc >> 8) ^ ccvfs_crc32_table[0][(crc ^ data[i]) & 0xFF];
     }
 
     return crc ^ 0xFFFFFFFF;
@@ -36,27 +66,29 @@ int ccvfs_get_space_stats(sqlite3_file *pFile, CCVFSSpaceStats *pStats) {
     }
     
     // Copy basic stats
+    sqlite3_mutex_enter(p->alloc_mutex);
     pStats->total_allocated_space = p->total_allocated_space;
     pStats->total_used_space = p->total_used_space;
     pStats->fragmentation_score = p->fragmentation_score;
-    pStats->space_reuse_count = p->space_reuse_count;
-    pStats->space_expansion_count = p->space_expansion_count;
-    pStats->new_allocation_count = p->new_allocation_count;
-    pStats->hole_reclaim_count = p->hole_reclaim_count;
-    pStats->best_fit_count = p->best_fit_count;
-    pStats->sequential_write_count = p->sequential_write_count;
+    sqlite3_mutex_leave(p->alloc_mutex);
+    pStats->space_reuse_count = CCVFS_COUNTER_GET(p->counters.space_reuse_count);
+    pStats->space_expansion_count = CCVFS_COUNTER_GET(p->counters.space_expansion_count);
+    pStats->new_allocation_count = CCVFS_COUNTER_GET(p->counters.new_allocation_count);
+    pStats->hole_reclaim_count = CCVFS_COUNTER_GET(p->counters.hole_reclaim_count);
+    pStats->best_fit_count = CCVFS_COUNTER_GET(p->counters.best_fit_count);
+    pStats->sequential_write_count = CCVFS_COUNTER_GET(p->counters.sequential_write_count);
     
     // Calculate derived metrics
-    if (p->total_allocated_space > 0) {
-        pStats->space_efficiency_ratio = (double)p->total_used_space / (double)p->total_allocated_space;
+    if (pStats->total_allocated_space > 0) {
+        pStats->space_efficiency_ratio = (double)pStats->total_used_space / (double)pStats->total_allocated_space;
     } else {
         pStats->space_efficiency_ratio = 1.0;
     }
     
-    uint32_t totalOperations = p->space_reuse_count + p->space_expansion_count + p->new_allocation_count;
+    uint64_t totalOperations = pStats->space_reuse_count + pStats->space_expansion_count + pStats->new_allocation_count;
     if (totalOperations > 0) {
-        pStats->reuse_efficiency_ratio = (double)p->space_reuse_count / (double)totalOperations;
-        pStats->hole_reclaim_ratio = (double)p->hole_reclaim_count / (double)totalOperations;
+        pStats->reuse_efficiency_ratio = (double)pStats->space_reuse_count / (double)totalOperations;
+        pStats->hole_reclaim_ratio = (double)pStats->hole_reclaim_count / (double)totalOperations;
     } else {
         pStats->reuse_efficiency_ratio = 0.0;
         pStats->hole_reclaim_ratio = 0.0;
@@ -46,6 +46,22 @@ static uint32_t calculate_crc32(const void* data, int len) {
     return crc ^ 0xFFFFFFFF;
 }
 
+/*
+ * 旧接口的进度输出
+ * Progress output of the original entry points
+ */
+static void print_compress_progress(void *pArg, uint32_t nDone, uint32_t nTotal) {
+    (void)pArg;
+    if (nTotal > 0) {
+        printf("\r进度: %.1f%% (%u/%u 块)", (double)nDone * 100.0 / nTotal, nDone, nTotal);
+        fflush(stdout);
+    }
+}
+
+int sqlite3_ccvfs_compress_database_with_page_size(const char *source_db, const char *compressed_db,
+                                                   const char *compress_algorithm, const char *encrypt_algorithm,
+                                                   uint32_t page_size, int compression_level);
+
 /*
  * Compress an existing SQLite database file
  */
@@ -56,216 +72,9 @@ int sqlite3_ccvfs_compress_database(
     const char *encrypt_algorithm,
     int compression_level
 ) {
-    sqlite3 *source = NULL;
-    sqlite3 *target = NULL;
-    FILE *source_file = NULL;
-    FILE *target_file = NULL;
-    int rc = SQLITE_OK;
-    long source_size, target_size;
-    CCVFSFileHeader header;
-    time_t start_time, end_time;
-    
-    printf("开始压缩数据库...\n");
-    printf("源文件: %s\n", source_db);
-    printf("目标文件: %s\n", compressed_db);
-    printf("压缩算法: %s\n", compress_algorithm ? compress_algorithm : "none");
-    printf("加密算法: %s\n", encrypt_algorithm ? encrypt_algorithm : "none");
-    printf("压缩等级: %d\n", compression_level);
-    
-    start_time = time(NULL);
-    
-    // Check if source database exists
-    if (!file_exists(source_db)) {
-        printf("错误: 源数据库文件不存在: %s\n", source_db);
-        return SQLITE_ERROR;
-    }
-    
-    source_size = get_file_size(source_db);
-    if (source_size <= 0) {
-        printf("错误: 无法获取源文件大小\n");
-        return SQLITE_ERROR;
-    }
-    
-    printf("源文件大小: %ld 字节\n", source_size);
-    
-    // Map string algorithms to algorithm pointers
-    const CompressAlgorithm *pCompressAlg = NULL;
-    const EncryptAlgorithm *pEncryptAlg = NULL;
-    
-    if (compress_algorithm && strcmp(compress_algorithm, "zlib") == 0) {
-#ifdef HAVE_ZLIB
-        pCompressAlg = CCVFS_COMPRESS_ZLIB;
-#else
-        printf("错误: ZLIB压缩算法未编译\n");
-        return SQLITE_ERROR;
-#endif
-    }
-    
-    if (encrypt_algorithm) {
-        if (strcmp(encrypt_algorithm, "aes128") == 0) {
-#ifdef HAVE_OPENSSL
-            pEncryptAlg = CCVFS_ENCRYPT_AES128;
-#else
-            printf("错误: AES128加密算法未编译\n");
-            return SQLITE_ERROR;
-#endif
-        } else if (strcmp(encrypt_algorithm, "aes256") == 0) {
-#ifdef HAVE_OPENSSL
-            pEncryptAlg = CCVFS_ENCRYPT_AES256;
-#else
-            printf("错误: AES256加密算法未编译\n");
-            return SQLITE_ERROR;
-#endif
-        }
-    }
-    
-    // Create CCVFS for compression
-    rc = sqlite3_ccvfs_create("compress_vfs", NULL, pCompressAlg, pEncryptAlg, 
-                              0, CCVFS_CREATE_OFFLINE);
-    if (rc != SQLITE_OK) {
-        printf("错误: 创建压缩VFS失败: %d\n", rc);
-        return rc;
-    }
-    
-    // Open source database in read-only mode
-    rc = sqlite3_open_v2(source_db, &source, SQLITE_OPEN_READONLY, NULL);
-    if (rc != SQLITE_OK) {
-        printf("错误: 打开源数据库失败: %s\n", sqlite3_errmsg(source));
-        goto cleanup;
-    }
-    
-    // Create and open target database with CCVFS
-    rc = sqlite3_open_v2(compressed_db, &target, 
-                         SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, 
-                         "compress_vfs");
-    if (rc != SQLITE_OK) {
-        printf("错误: 创建压缩数据库失败: %s\n", sqlite3_errmsg(target));
-        goto cleanup;
-    }
-    
-    // Copy database schema and data
-    printf("正在复制数据库结构和数据...\n");
-    
-    // Use SQLite backup API for efficient copying
-    sqlite3_backup *backup = sqlite3_backup_init(target, "main", source, "main");
-    if (!backup) {
-        printf("错误: 初始化备份失败\n");
-        rc = SQLITE_ERROR;
-        goto cleanup;
-    }
-    
-    int pages_remaining, total_pages = 0;
-    do {
-        rc = sqlite3_backup_step(backup, 100);  // Copy 100 pages at a time
-        pages_remaining = sqlite3_backup_remaining(backup);
-        if (total_pages == 0) {
-            total_pages = sqlite3_backup_pagecount(backup);
-        }
-        
-        if (total_pages > 0) {
-            printf("\r进度: %.1f%% (%d/%d 页)", 
-                   (double)(total_pages - pages_remaining) * 100.0 / total_pages,
-                   total_pages - pages_remaining, total_pages);
-            fflush(stdout);
-        }
-        
-    } while (rc == SQLITE_OK || rc == SQLITE_BUSY || rc == SQLITE_LOCKED);
-    
-    printf("\n");
-    
-    if (rc != SQLITE_DONE) {
-        printf("错误: 数据库备份失败: %d\n", rc);
-        sqlite3_backup_finish(backup);
-        goto cleanup;
-    }
-    
-    sqlite3_backup_finish(backup);
-    printf("数据库复制完成\n");
-    
-    // Close databases first to ensure all data is written
-    if (source) {
-        sqlite3_close(source);
-        source = NULL;
-    }
-    if (target) {
-        sqlite3_close(target);
-        target = NULL;
-    }
-    
-    // Update file header with correct statistics
-    printf("更新文件头统计信息...\n");
-    FILE *compressed_file = fopen(compressed_db, "r+b");
-    if (compressed_file) {
-        CCVFSFileHeader header;
-        
-        // Read current header
-        if (fread(&header, sizeof(CCVFSFileHeader), 1, compressed_file) == 1) {
-            // Update statistics
-            header.original_file_size = (uint64_t)source_size;
-            target_size = get_file_size(compressed_db);
-            header.compressed_file_size = (uint64_t)target_size;
-            
-            if (source_size > 0 && target_size <= source_size) {
-                header.compression_ratio = (uint32_t)((source_size - target_size) * 100 / source_size);
-            } else if (source_size > 0) {
-                // Compression made file larger, set ratio to 0 (no compression benefit)
-                header.compression_ratio = 0;
-            } else {
-                header.compression_ratio = 0;
-            }
-            
-            // Write updated header back
-            fseek(compressed_file, 0, SEEK_SET);
-            if (fwrite(&header, sizeof(CCVFSFileHeader), 1, compressed_file) == 1) {
-                printf("✓ 文件头统计信息更新成功\n");
-            } else {
-                printf("⚠ 警告: 无法更新文件头统计信息\n");
-            }
-        } else {
-            printf("⚠ 警告: 无法读取文件头\n");
-        }
-        
-        fclose(compressed_file);
-    } else {
-        printf("⚠ 警告: 无法打开压缩文件更新统计信息\n");
-    }
-    
-    // Get final compressed file size
-    target_size = get_file_size(compressed_db);
-    end_time = time(NULL);
-    
-    // Display compression results
-    if (target_size > 0) {
-        double compression_ratio;
-        long space_saved = source_size - target_size;
-        
-        if (source_size > 0 && target_size <= source_size) {
-            compression_ratio = (double)(source_size - target_size) * 100.0 / source_size;
-        } else {
-            compression_ratio = 0.0; // No compression benefit or file grew larger
-        }
-        
-        printf("\n压缩完成!\n");
-        printf("原始大小: %ld 字节\n", source_size);
-        printf("压缩后大小: %ld 字节\n", target_size);
-        printf("压缩比: %.2f%%\n", compression_ratio);
-        printf("节省空间: %ld 字节\n", space_saved);
-        printf("用时: %ld 秒\n", end_time - start_time);
-    } else {
-        printf("警告: 无法获取压缩文件大小\n");
-    }
-    
-    rc = SQLITE_OK;
-
-cleanup:
-    if (source) sqlite3_close(source);
-    if (target) sqlite3_close(target);
-    if (source_file) fclose(source_file);
-    if (target_file) fclose(target_file);
-    
-    sqlite3_ccvfs_destroy("compress_vfs");
-    
-    return rc;
+    return sqlite3_ccvfs_compress_database_with_page_size(source_db, compressed_db,
+                                                          compress_algorithm, encrypt_algorithm,
+                                                          0, compression_level);
 }
 
 /*
@@ -275,9 +84,7 @@ int sqlite3_ccvfs_decompress_database(
     const char *compressed_db,
     const char *output_db
 ) {
-    sqlite3 *source = NULL;
-    sqlite3 *target = NULL;
-    int rc = SQLITE_OK;
+    int rc;
     long source_size, target_size;
     time_t start_time, end_time;
     CCVFSStats stats;
@@ -311,120 +118,24 @@ int sqlite3_ccvfs_decompress_database(
         printf("总页数: %u\n", stats.total_pages);
     } else {
         printf("警告: 无法读取压缩文件统计信息\n");
-        // Set default algorithms if stats reading fails
-        strcpy(stats.compress_algorithm, "zlib");
-        strcpy(stats.encrypt_algorithm, "");
+        // Algorithms are taken from the header by the transcoder
+        memset(&stats, 0, sizeof(stats));
     }
     
-    // Create CCVFS for decompression using the correct algorithms
-    const char *compress_alg = strlen(stats.compress_algorithm) > 0 ? stats.compress_algorithm : NULL;
-    const char *encrypt_alg = strlen(stats.encrypt_algorithm) > 0 ? stats.encrypt_algorithm : NULL;
+    CCVFSDecompressOptions opts;
+    memset(&opts, 0, sizeof(opts));
+    opts.xProgress = print_compress_progress;
     
-    printf("使用算法进行解压: 压缩=%s, 加密=%s\n", 
-           compress_alg ? compress_alg : "无", 
-           encrypt_alg ? encrypt_alg : "无");
-    
-    // Map string algorithms to algorithm pointers
-    const CompressAlgorithm *pCompressAlg = NULL;
-    const EncryptAlgorithm *pEncryptAlg = NULL;
-    
-    if (compress_alg && strcmp(compress_alg, "zlib") == 0) {
-#ifdef HAVE_ZLIB
-        pCompressAlg = CCVFS_COMPRESS_ZLIB;
-#else
-        printf("错误: ZLIB压缩算法未编译\n");
-        return SQLITE_ERROR;
-#endif
-    }
-    
-    if (encrypt_alg) {
-        if (strcmp(encrypt_alg, "aes128") == 0) {
-#ifdef HAVE_OPENSSL
-            pEncryptAlg = CCVFS_ENCRYPT_AES128;
-#else
-            printf("错误: AES128加密算法未编译\n");
-            return SQLITE_ERROR;
-#endif
-        } else if (strcmp(encrypt_alg, "aes256") == 0) {
-#ifdef HAVE_OPENSSL
-            pEncryptAlg = CCVFS_ENCRYPT_AES256;
-#else
-            printf("错误: AES256加密算法未编译\n");
-            return SQLITE_ERROR;
-#endif
-        }
-    }
-    
-    rc = sqlite3_ccvfs_create("decompress_vfs", NULL, pCompressAlg, pEncryptAlg, 0, 0);
-    if (rc != SQLITE_OK) {
-        printf("错误: 创建解压VFS失败: %d\n", rc);
-        return rc;
-    }
-    
-    // Open compressed database with CCVFS
-    rc = sqlite3_open_v2(compressed_db, &source, SQLITE_OPEN_READONLY, "decompress_vfs");
-    if (rc != SQLITE_OK) {
-        printf("错误: 打开压缩数据库失败: %s\n", sqlite3_errmsg(source));
-        goto cleanup;
-    }
-    
-    // Create standard SQLite database
-    rc = sqlite3_open_v2(output_db, &target, 
-                         SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, 
-                         NULL);
-    if (rc != SQLITE_OK) {
-        printf("错误: 创建输出数据库失败: %s\n", sqlite3_errmsg(target));
-        goto cleanup;
-    }
-    
-    // Copy database from compressed to standard format
     printf("正在解压数据库...\n");
-    
-    sqlite3_backup *backup = sqlite3_backup_init(target, "main", source, "main");
-    if (!backup) {
-        printf("错误: 初始化备份失败\n");
-        rc = SQLITE_ERROR;
-        goto cleanup;
-    }
-    
-    int pages_remaining, total_pages = 0;
-    do {
-        rc = sqlite3_backup_step(backup, 100);
-        pages_remaining = sqlite3_backup_remaining(backup);
-        if (total_pages == 0) {
-            total_pages = sqlite3_backup_pagecount(backup);
-        }
-        
-        if (total_pages > 0) {
-            printf("\r进度: %.1f%% (%d/%d 页)", 
-                   (double)(total_pages - pages_remaining) * 100.0 / total_pages,
-                   total_pages - pages_remaining, total_pages);
-            fflush(stdout);
-        }
-        
-    } while (rc == SQLITE_OK || rc == SQLITE_BUSY || rc == SQLITE_LOCKED);
-    
+    rc = sqlite3_ccvfs_decompress_database_parallel(compressed_db, output_db, &opts);
     printf("\n");
     
-    if (rc != SQLITE_DONE) {
+    if (rc != SQLITE_OK) {
         printf("错误: 数据库解压失败: %d\n", rc);
-        sqlite3_backup_finish(backup);
-        goto cleanup;
+        return rc;
     }
-    
-    sqlite3_backup_finish(backup);
     printf("数据库解压完成\n");
     
-    // Close databases
-    if (source) {
-        sqlite3_close(source);
-        source = NULL;
-    }
-    if (target) {
-        sqlite3_close(target);
-        target = NULL;
-    }
-    
     // Get output file size and display results
     target_size = get_file_size(output_db);
     end_time = time(NULL);
@@ -443,15 +154,7 @@ int sqlite3_ccvfs_decompress_database(
         printf("警告: 无法获取输出文件大小\n");
     }
     
-    rc = SQLITE_OK;
-
-cleanup:
-    if (source) sqlite3_close(source);
-    if (target) sqlite3_close(target);
-    
-    sqlite3_ccvfs_destroy("decompress_vfs");
-    
-    return rc;
+    return SQLITE_OK;
 }
 
 /*
@@ -615,27 +318,29 @@ int sqlite3_ccvfs_compress_database_with_page_size(
     uint32_t page_size,
     int compression_level
 ) {
-    sqlite3 *source = NULL;
-    sqlite3 *target = NULL;
-    FILE *source_file = NULL;
-    FILE *target_file = NULL;
-    int rc = SQLITE_OK;
+    CCVFSCompressOptions options;
+    int rc;
     long source_size, target_size;
-    CCVFSFileHeader header;
     time_t start_time, end_time;
     
-    printf("开始压缩数据库 (页大小: %u KB)...\n", page_size / 1024);
+    if (page_size == 0) {
+        printf("开始压缩数据库...\n");
+    } else {
+        printf("开始压缩数据库 (页大小: %u KB)...\n", page_size / 1024);
+    }
     printf("源文件: %s\n", source_db);
     printf("目标文件: %s\n", compressed_db);
     printf("压缩算法: %s\n", compress_algorithm ? compress_algorithm : "none");
     printf("加密算法: %s\n", encrypt_algorithm ? encrypt_algorithm : "none");
-    printf("页大小: %u 字节 (%u KB)\n", page_size, page_size / 1024);
+    if (page_size != 0) {
+        printf("页大小: %u 字节 (%u KB)\n", page_size, page_size / 1024);
+    }
     printf("压缩等级: %d\n", compression_level);
     
     start_time = time(NULL);
     
     // Validate page size
-    if (page_size < CCVFS_MIN_PAGE_SIZE || page_size > CCVFS_MAX_PAGE_SIZE) {
+    if (page_size != 0 && (page_size < CCVFS_MIN_PAGE_SIZE || page_size > CCVFS_MAX_PAGE_SIZE)) {
         printf("错误: 无效的页大小 %u (必须在 %u - %u 之间)\n",
                page_size, CCVFS_MIN_PAGE_SIZE, CCVFS_MAX_PAGE_SIZE);
         return SQLITE_ERROR;
@@ -660,149 +365,26 @@ int sqlite3_ccvfs_compress_database_with_page_size(
     
     printf("源文件大小: %ld 字节\n", source_size);
     
-    // Map string algorithms to algorithm pointers
-    const CompressAlgorithm *pCompressAlg = NULL;
-    const EncryptAlgorithm *pEncryptAlg = NULL;
-    
-    if (compress_algorithm && strcmp(compress_algorithm, "zlib") == 0) {
-#ifdef HAVE_ZLIB
-        pCompressAlg = CCVFS_COMPRESS_ZLIB;
-#else
-        printf("错误: ZLIB压缩算法未编译\n");
-        return SQLITE_ERROR;
-#endif
-    }
-    
-    if (encrypt_algorithm) {
-        if (strcmp(encrypt_algorithm, "aes128") == 0) {
-#ifdef HAVE_OPENSSL
-            pEncryptAlg = CCVFS_ENCRYPT_AES128;
-#else
-            printf("错误: AES128加密算法未编译\n");
-            return SQLITE_ERROR;
-#endif
-        } else if (strcmp(encrypt_algorithm, "aes256") == 0) {
-#ifdef HAVE_OPENSSL
-            pEncryptAlg = CCVFS_ENCRYPT_AES256;
-#else
-            printf("错误: AES256加密算法未编译\n");
-            return SQLITE_ERROR;
-#endif
-        }
-    }
-    
-    // Create CCVFS for compression with custom page size
-    rc = sqlite3_ccvfs_create("compress_vfs_custom", NULL, 
-                              pCompressAlg, pEncryptAlg, 
-                              page_size, CCVFS_CREATE_OFFLINE);
-    if (rc != SQLITE_OK) {
-        printf("错误: 创建压缩VFS失败: %d\n", rc);
-        return rc;
-    }
-    
-    // Open source database in read-only mode
-    rc = sqlite3_open_v2(source_db, &source, SQLITE_OPEN_READONLY, NULL);
-    if (rc != SQLITE_OK) {
-        printf("错误: 打开源数据库失败: %s\n", sqlite3_errmsg(source));
-        goto cleanup;
-    }
-    
-    // Create and open target database with custom CCVFS
-    rc = sqlite3_open_v2(compressed_db, &target, 
-                         SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, 
-                         "compress_vfs_custom");
-    if (rc != SQLITE_OK) {
-        printf("错误: 创建压缩数据库失败: %s\n", sqlite3_errmsg(target));
-        goto cleanup;
-    }
-    
-    // Copy database schema and data
+    // 并行流水线写出数据、索引表和文件头统计信息
+    // The parallel pipeline writes the data, the index table and the header statistics
     printf("正在复制数据库结构和数据...\n");
     
-    // Use SQLite backup API for efficient copying
-    sqlite3_backup *backup = sqlite3_backup_init(target, "main", source, "main");
-    if (!backup) {
-        printf("错误: 初始化备份失败\n");
-        rc = SQLITE_ERROR;
-        goto cleanup;
-    }
-    
-    int pages_remaining, total_pages = 0;
-    do {
-        rc = sqlite3_backup_step(backup, 100);  // Copy 100 pages at a time
-        pages_remaining = sqlite3_backup_remaining(backup);
-        if (total_pages == 0) {
-            total_pages = sqlite3_backup_pagecount(backup);
-        }
-        
-        if (total_pages > 0) {
-            printf("\r进度: %.1f%% (%d/%d 页)", 
-                   (double)(total_pages - pages_remaining) * 100.0 / total_pages,
-                   total_pages - pages_remaining, total_pages);
-            fflush(stdout);
-        }
-        
-    } while (rc == SQLITE_OK || rc == SQLITE_BUSY || rc == SQLITE_LOCKED);
+    memset(&options, 0, sizeof(options));
+    options.compress_algorithm = compress_algorithm;
+    options.encrypt_algorithm = encrypt_algorithm;
+    options.page_size = page_size;
+    options.compression_level = compression_level;
+    options.xProgress = print_compress_progress;
     
+    rc = sqlite3_ccvfs_compress_database_parallel(source_db, compressed_db, &options);
     printf("\n");
     
-    if (rc != SQLITE_DONE) {
-        printf("错误: 数据库备份失败: %d\n", rc);
-        sqlite3_backup_finish(backup);
-        goto cleanup;
+    if (rc != SQLITE_OK) {
+        printf("错误: 数据库压缩失败: %d\n", rc);
+        return rc;
     }
-    
-    sqlite3_backup_finish(backup);
     printf("数据库复制完成\n");
     
-    // Close databases first to ensure all data is written
-    if (source) {
-        sqlite3_close(source);
-        source = NULL;
-    }
-    if (target) {
-        sqlite3_close(target);
-        target = NULL;
-    }
-    
-    // Update file header with correct statistics
-    printf("更新文件头统计信息...\n");
-    FILE *compressed_file = fopen(compressed_db, "r+b");
-    if (compressed_file) {
-        CCVFSFileHeader header;
-        
-        // Read current header
-        if (fread(&header, sizeof(CCVFSFileHeader), 1, compressed_file) == 1) {
-            // Update statistics
-            header.original_file_size = (uint64_t)source_size;
-            target_size = get_file_size(compressed_db);
-            header.compressed_file_size = (uint64_t)target_size;
-            
-            if (source_size > 0 && target_size <= source_size) {
-                header.compression_ratio = (uint32_t)((source_size - target_size) * 100 / source_size);
-            } else if (source_size > 0) {
-                // Compression made file larger, set ratio to 0 (no compression benefit)
-                header.compression_ratio = 0;
-            } else {
-                header.compression_ratio = 0;
-            }
-            
-            // Write updated header back
-            fseek(compressed_file, 0, SEEK_SET);
-            if (fwrite(&header, sizeof(CCVFSFileHeader), 1, compressed_file) == 1) {
-                printf("✓ 文件头统计信息更新成功\n");
-            } else {
-                printf("⚠ 警告: 无法更新文件头统计信息\n");
-            }
-        } else {
-            printf("⚠ 警告: 无法读取文件头\n");
-        }
-        
-        fclose(compressed_file);
-    } else {
-        printf("⚠ 警告: 无法打开压缩文件更新统计信息\n");
-    }
-    
     // Get final compressed file size
     target_size = get_file_size(compressed_db);
     end_time = time(NULL);
@@ -823,23 +405,15 @@ int sqlite3_ccvfs_compress_database_with_page_size(
         printf("压缩后大小: %ld 字节\n", target_size);
         printf("压缩比: %.2f%%\n", compression_ratio);
         printf("节省空间: %ld 字节\n", space_saved);
-        printf("页大小: %u KB\n", page_size / 1024);
+        if (page_size != 0) {
+            printf("页大小: %u KB\n", page_size / 1024);
+        }
         printf("用时: %ld 秒\n", end_time - start_time);
     } else {
         printf("警告: 无法获取压缩文件大小\n");
     }
     
-    rc = SQLITE_OK;
-
-cleanup:
-    if (source) sqlite3_close(source);
-    if (target) sqlite3_close(target);
-    if (source_file) fclose(source_file);
-    if (target_file) fclose(target_file);
-    
-    sqlite3_ccvfs_destroy("compress_vfs_custom");
-    
-    return rc;
+    return SQLITE_OK;
 }
 
 /*
@@ -855,83 +429,15 @@ int sqlite3_ccvfs_compress_database_with_key(
     const unsigned char *key,
     int keyLen
 ) {
-    sqlite3 *source = NULL;
-    sqlite3 *target = NULL;
-    int rc = SQLITE_OK;
-    
-    // Map string algorithms to algorithm pointers
-    const CompressAlgorithm *pCompressAlg = NULL;
-    const EncryptAlgorithm *pEncryptAlg = NULL;
-    
-    if (compress_algorithm && strcmp(compress_algorithm, "zlib") == 0) {
-#ifdef HAVE_ZLIB
-        pCompressAlg = CCVFS_COMPRESS_ZLIB;
-#endif
-    }
-    
-    if (encrypt_algorithm) {
-        if (strcmp(encrypt_algorithm, "aes128") == 0) {
-#ifdef HAVE_OPENSSL
-            pEncryptAlg = CCVFS_ENCRYPT_AES128;
-#endif
-        } else if (strcmp(encrypt_algorithm, "aes256") == 0) {
-#ifdef HAVE_OPENSSL
-            pEncryptAlg = CCVFS_ENCRYPT_AES256;
-#endif
-        }
-    }
-    
-    // Create CCVFS for compression with key
-    // First try to destroy if it already exists
-    sqlite3_ccvfs_destroy("compress_vfs_custom");
-    
-    rc = sqlite3_ccvfs_create_with_key("compress_vfs_custom", NULL, 
-                                      pCompressAlg, pEncryptAlg, 
-                                      page_size, CCVFS_CREATE_OFFLINE,
-                                      key, keyLen);
-    if (rc != SQLITE_OK) {
-        return rc;
-    }
-    
-    // Call the existing compression logic but handle VFS creation ourselves
-    // Since we've already created the VFS with the key, we need to avoid double creation
-    
-    // Open source database in read-only mode
-    rc = sqlite3_open_v2(source_db, &source, SQLITE_OPEN_READONLY, NULL);
-    if (rc != SQLITE_OK) {
-        sqlite3_ccvfs_destroy("compress_vfs_custom");
-        return rc;
-    }
-    
-    // Create and open target database with custom CCVFS
-    rc = sqlite3_open_v2(compressed_db, &target, 
-                         SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, 
-                         "compress_vfs_custom");
-    if (rc != SQLITE_OK) {
-        sqlite3_close(source);
-        sqlite3_ccvfs_destroy("compress_vfs_custom");
-        return rc;
-    }
-    
-    // Use SQLite backup API for efficient copying
-    sqlite3_backup *backup = sqlite3_backup_init(target, "main", source, "main");
-    if (!backup) {
-        sqlite3_close(source);
-        sqlite3_close(target);
-        sqlite3_ccvfs_destroy("compress_vfs_custom");
-        return SQLITE_ERROR;
-    }
-    
-    // Copy all pages
-    do {
-        rc = sqlite3_backup_step(backup, -1);  // Copy all pages at once
-    } while (rc == SQLITE_OK || rc == SQLITE_BUSY || rc == SQLITE_LOCKED);
-    
-    sqlite3_backup_finish(backup);
-    sqlite3_close(source);
-    sqlite3_close(target);
+    CCVFSCompressOptions options;
     
-    sqlite3_ccvfs_destroy("compress_vfs_custom");
+    memset(&options, 0, sizeof(options));
+    options.compress_algorithm = compress_algorithm;
+    options.encrypt_algorithm = encrypt_algorithm;
+    options.page_size = page_size;
+    options.compression_level = compression_level;
+    options.key = key;
+    options.key_len = keyLen;
     
-    return (rc == SQLITE_DONE) ? SQLITE_OK : rc;
+    return sqlite3_ccvfs_compress_database_parallel(source_db, compressed_db, &options);
 }
\ No newline at end of file
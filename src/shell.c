@@ -28,6 +28,10 @@ static void processActivateExtensionsPragma(const char *zRight);
 */
 void sqlite3_ccvfs_show_status(void);
 
+/*
+** shell初始化钩子
+*/
+void ccvfs_shell_init(void);
 
 
 /*
@@ -64,6 +68,15 @@ void sqlite3_ccvfs_show_status(void) {
     printf("==================\n\n");
 }
 
+/*
+** shell初始化钩子（通过SQLITE_SHELL_INIT_PROC调用）
+** 为shell打开的每个连接注册ccvfs_pages虚拟表
+*/
+void ccvfs_shell_init(void) {
+    sqlite3_initialize();
+    sqlite3_auto_extension((void(*)(void))sqlite3_ccvfs_pages_init);
+}
+
 /*
 ** 将16进制字符串解析为二进制数据的辅助函数
 ** 输入: hexStr - 16进制字符串 (例如: "48656c6c6f")
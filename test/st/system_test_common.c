@@ -38,6 +38,12 @@ void cleanup_test_files(const char* prefix) {
     snprintf(filename, sizeof(filename), "%s.db-shm", prefix);
     remove(filename);
     
+    // Shared page index files
+    snprintf(filename, sizeof(filename), "%s.db-ccvfs", prefix);
+    remove(filename);
+    snprintf(filename, sizeof(filename), "%s.db-ccvfs-shm", prefix);
+    remove(filename);
+    
     // Restored file
     snprintf(filename, sizeof(filename), "%s_restored.db", prefix);
     remove(filename);
@@ -24,10 +24,25 @@ int test_key_auto_completion(TestResult* result);
 // Storage tests (test_storage.c)
 int test_hole_detection(TestResult* result);
 int test_simple_hole(TestResult* result);
+int test_index_coherence(TestResult* result);
+int test_shared_index(TestResult* result);
+int test_page_inspection(TestResult* result);
+int test_storage_faults(TestResult* result);
+int test_background_scrub(TestResult* result);
+
+// Concurrency tests (test_concurrency.c)
+int test_thread_stress(TestResult* result);
+int test_snapshot_reads(TestResult* result);
+int test_wal_readers(TestResult* result);
 
 // Buffer tests (test_buffer.c)
 int test_batch_write_buffer(TestResult* result);
 int test_simple_buffer(TestResult* result);
+int test_file_stats(TestResult* result);
+int test_latency_histograms(TestResult* result);
+int test_runtime_pragmas(TestResult* result);
+int test_log_trace(TestResult* result);
+int test_io_hooks(TestResult* result);
 
 // Batch write tests (test_batch.c)
 int test_batch_write(TestResult* result);
@@ -35,5 +50,15 @@ int test_simple_batch(TestResult* result);
 
 // Tools tests (test_tools.c)
 int test_db_tools(TestResult* result);
+int test_io_replay(TestResult* result);
+int test_db_analyze(TestResult* result);
+int test_parallel_compress(TestResult* result);
+int test_parallel_decompress(TestResult* result);
+int test_hot_backup(TestResult* result);
+int test_incremental_backup(TestResult* result);
+int test_parallel_compare(TestResult* result);
+int test_page_verify(TestResult* result);
+int test_parallel_generate(TestResult* result);
+int test_recompress(TestResult* result);
 
 #endif // SYSTEM_TEST_FUNCTIONS_H
\ No newline at end of file
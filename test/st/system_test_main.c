@@ -20,11 +20,34 @@ static TestCase test_cases[] = {
     {"key_auto_completion", "Key length auto-completion", test_key_auto_completion},
     {"hole_detection", "Space hole detection functionality", test_hole_detection},
     {"simple_hole", "Simple hole management test", test_simple_hole},
+    {"index_coherence", "Index coherence across connections", test_index_coherence},
+    {"shared_index", "Shared memory page index", test_shared_index},
+    {"page_inspection", "Per-page storage details through ccvfs_pages", test_page_inspection},
+    {"storage_faults", "Slow storage and fault injection below CCVFS", test_storage_faults},
+    {"background_scrub", "Stored blocks checked by a throttled background thread, trusted reads", test_background_scrub},
+    {"thread_stress", "Multi-threaded access to one file", test_thread_stress},
+    {"snapshot_reads", "Page reads during commits through index snapshots", test_snapshot_reads},
+    {"wal_readers", "WAL readers on their own connections during checkpoints", test_wal_readers},
     {"batch_write_buffer", "Batch write buffer functionality", test_batch_write_buffer},
     {"simple_buffer", "Simple buffer operations", test_simple_buffer},
+    {"file_stats", "Per-file and per-VFS statistics counters", test_file_stats},
+    {"latency_histograms", "Per-stage latency histograms and PRAGMA ccvfs_histograms", test_latency_histograms},
+    {"runtime_pragmas", "Runtime tuning, statistics and compaction PRAGMAs", test_runtime_pragmas},
+    {"log_trace", "Runtime log levels, log callback and page event trace ring", test_log_trace},
+    {"io_hooks", "Page I/O hooks for external profilers", test_io_hooks},
     {"batch_write", "Batch write functionality", test_batch_write},
     {"simple_batch", "Simple batch write operations", test_simple_batch},
     {"db_tools", "Database tools integration test", test_db_tools},
+    {"io_replay", "I/O trace recording and replay on another configuration", test_io_replay},
+    {"db_analyze", "Compression advisor sampling, ranking and CCVFS sources", test_db_analyze},
+    {"parallel_compress", "Pipelined offline compression on parallel workers", test_parallel_compress},
+    {"parallel_decompress", "Direct parallel transcoding back to plain SQLite", test_parallel_decompress},
+    {"hot_backup", "Raw stored-block backup of a live database", test_hot_backup},
+    {"incremental_backup", "Deltas of changed blocks applied to a backup copy", test_incremental_backup},
+    {"parallel_compare", "Hashed rowid ranges and page images compared on a worker pool", test_parallel_compare},
+    {"page_verify", "CCVFS files checked block by block without SQL", test_page_verify},
+    {"parallel_generate", "Seeded test data generated on worker threads, reproducibly", test_parallel_generate},
+    {"recompress", "CCVFS files recompressed into another configuration from a live snapshot", test_recompress},
     {NULL, NULL, NULL} // Terminator
 };
 
@@ -284,4 +284,677 @@ int test_simple_buffer(TestResult* result) {
     sqlite3_ccvfs_destroy("simple_buffer_vfs");
     
     return (result->passed == result->total) ? 1 : 0;
-}
\ No newline at end of file
+}
+// Fill a table in one transaction so the write buffer, allocator and hole counters all move
+static int stats_fill_table(sqlite3 *db, int rows) {
+    int rc = sqlite3_exec(db, "CREATE TABLE t (id INTEGER PRIMARY KEY, data TEXT);"
+                              "BEGIN", NULL, NULL, NULL);
+    for (int i = 0; rc == SQLITE_OK && i < rows; i++) {
+        char sql[256];
+        snprintf(sql, sizeof(sql), "INSERT INTO t (data) VALUES ('File stats record %d %0100d')", i, i);
+        rc = sqlite3_exec(db, sql, NULL, NULL, NULL);
+    }
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_exec(db, "COMMIT; UPDATE t SET data = data || 'x' WHERE id % 3 = 0", NULL, NULL, NULL);
+    }
+    return rc;
+}
+
+// File Statistics Test: per-file 64-bit counters and their aggregation over the VFS
+int test_file_stats(TestResult* result) {
+    result->name = "File Statistics Test";
+    result->passed = 0;
+    result->total = 5;
+    strcpy(result->message, "");
+    
+    cleanup_test_files("test_stats_1");
+    cleanup_test_files("test_stats_2");
+    init_test_algorithms();
+    
+#ifdef HAVE_ZLIB
+    int rc = sqlite3_ccvfs_create("stats_vfs", NULL, CCVFS_COMPRESS_ZLIB, NULL, 4096, CCVFS_CREATE_REALTIME);
+#else
+    int rc = sqlite3_ccvfs_create("stats_vfs", NULL, NULL, NULL, 4096, CCVFS_CREATE_REALTIME);
+#endif
+    if (rc != SQLITE_OK) {
+        snprintf(result->message, sizeof(result->message), "VFS creation failed: %d", rc);
+        return 0;
+    }
+    result->passed++;
+    
+    // Two databases on one VFS
+    sqlite3 *db1 = NULL, *db2 = NULL;
+    rc = sqlite3_open_v2("test_stats_1.db", &db1, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, "stats_vfs");
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_open_v2("test_stats_2.db", &db2, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, "stats_vfs");
+    }
+    if (rc == SQLITE_OK) rc = stats_fill_table(db1, 200);
+    if (rc == SQLITE_OK) rc = stats_fill_table(db2, 100);
+    if (rc != SQLITE_OK) {
+        snprintf(result->message, sizeof(result->message), "Database setup failed: %d", rc);
+        sqlite3_close(db1);
+        sqlite3_close(db2);
+        sqlite3_ccvfs_destroy("stats_vfs");
+        return 0;
+    }
+    result->passed++;
+    
+    // Per-file statistics agree with the legacy buffer statistics
+    CCVFSFileStats s1, s2, total;
+    uint32_t hits, flushes, merges, writes;
+    rc = sqlite3_ccvfs_get_file_stats(db1, &s1);
+    if (rc == SQLITE_OK) rc = sqlite3_ccvfs_get_file_stats(db2, &s2);
+    if (rc == SQLITE_OK) rc = sqlite3_ccvfs_get_buffer_stats(db1, &hits, &flushes, &merges, &writes);
+    if (rc == SQLITE_OK && s1.open_files == 1 && s1.total_buffered_writes > 0 &&
+        s1.total_buffered_writes == writes && s1.buffer_flush_count == flushes &&
+        s1.new_allocation_count + s1.space_reuse_count + s1.hole_reclaim_count > 0) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message),
+                "File stats mismatch: rc=%d, buffered=%llu/%u, flushes=%llu/%u",
+                rc, (unsigned long long)s1.total_buffered_writes, writes,
+                (unsigned long long)s1.buffer_flush_count, flushes);
+        sqlite3_close(db1);
+        sqlite3_close(db2);
+        sqlite3_ccvfs_destroy("stats_vfs");
+        return 0;
+    }
+    
+    // The VFS totals cover both open files (journals are not CCVFS files and are not counted)
+    rc = sqlite3_ccvfs_get_vfs_stats("stats_vfs", &total);
+    if (rc == SQLITE_OK && total.open_files == 2 &&
+        total.total_buffered_writes == s1.total_buffered_writes + s2.total_buffered_writes &&
+        total.new_allocation_count == s1.new_allocation_count + s2.new_allocation_count) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message),
+                "VFS stats mismatch: rc=%d, open_files=%u, buffered=%llu (expected %llu)",
+                rc, total.open_files, (unsigned long long)total.total_buffered_writes,
+                (unsigned long long)(s1.total_buffered_writes + s2.total_buffered_writes));
+        sqlite3_close(db1);
+        sqlite3_close(db2);
+        sqlite3_ccvfs_destroy("stats_vfs");
+        return 0;
+    }
+    
+    // Closing a file keeps its counters in the VFS totals
+    sqlite3_close(db1);
+    CCVFSFileStats afterClose;
+    rc = sqlite3_ccvfs_get_vfs_stats("stats_vfs", &afterClose);
+    if (rc == SQLITE_OK && afterClose.open_files == 1 &&
+        afterClose.total_buffered_writes >= total.total_buffered_writes &&
+        afterClose.new_allocation_count >= total.new_allocation_count) {
+        result->passed++;
+        snprintf(result->message, sizeof(result->message),
+                "Stats consistent: %llu buffered writes, %llu allocations across %u files",
+                (unsigned long long)afterClose.total_buffered_writes,
+                (unsigned long long)afterClose.new_allocation_count, total.open_files);
+    } else {
+        snprintf(result->message, sizeof(result->message),
+                "VFS totals went backwards after close: open_files=%u, buffered=%llu < %llu",
+                afterClose.open_files, (unsigned long long)afterClose.total_buffered_writes,
+                (unsigned long long)total.total_buffered_writes);
+    }
+    
+    sqlite3_close(db2);
+    sqlite3_ccvfs_destroy("stats_vfs");
+    
+    return (result->passed == result->total) ? 1 : 0;
+}
+
+// Run a single-value PRAGMA and copy its text result
+static int query_pragma(sqlite3 *db, const char *sql, char *out, size_t outSize) {
+    sqlite3_stmt *stmt;
+    int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
+    out[0] = '\0';
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+    rc = sqlite3_step(stmt);
+    if (rc == SQLITE_ROW) {
+        const char *text = (const char*)sqlite3_column_text(stmt, 0);
+        snprintf(out, outSize, "%s", text ? text : "");
+        rc = SQLITE_OK;
+    } else if (rc == SQLITE_DONE) {
+        rc = SQLITE_OK;
+    }
+    sqlite3_finalize(stmt);
+    return rc;
+}
+
+// Latency Histogram Test: runtime switch, per-stage samples, PRAGMA report and reset
+int test_latency_histograms(TestResult* result) {
+    result->name = "Latency Histogram Test";
+    result->passed = 0;
+    result->total = 5;
+    strcpy(result->message, "");
+    
+    cleanup_test_files("test_histograms");
+    init_test_algorithms();
+    
+#ifdef HAVE_ZLIB
+    int rc = sqlite3_ccvfs_create("histogram_vfs", NULL, CCVFS_COMPRESS_ZLIB, NULL, 4096, CCVFS_CREATE_REALTIME);
+#else
+    int rc = sqlite3_ccvfs_create("histogram_vfs", NULL, NULL, NULL, 4096, CCVFS_CREATE_REALTIME);
+#endif
+    if (rc != SQLITE_OK) {
+        snprintf(result->message, sizeof(result->message), "VFS creation failed: %d", rc);
+        return 0;
+    }
+    
+    sqlite3 *db = NULL, *reader = NULL;
+    char report[4096];
+    CCVFSLatencyHistogram hist[CCVFS_STAGE_COUNT];
+    rc = sqlite3_open_v2("test_histograms.db", &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, "histogram_vfs");
+    
+    // Off by default: writes record nothing
+    if (rc == SQLITE_OK) rc = stats_fill_table(db, 50);
+    if (rc == SQLITE_OK) rc = sqlite3_ccvfs_get_histograms(db, hist);
+    if (rc == SQLITE_OK && hist[CCVFS_STAGE_WRITE_PAGE].count == 0) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message), "Histograms not empty while off: rc=%d", rc);
+        goto done;
+    }
+    
+    // Switched on for this database through the PRAGMA
+    rc = query_pragma(db, "PRAGMA ccvfs_histograms=ON", report, sizeof(report));
+    for (int i = 0; rc == SQLITE_OK && i < 100; i++) {
+        rc = sqlite3_exec(db, "INSERT INTO t (data) SELECT data FROM t WHERE id = 1", NULL, NULL, NULL);
+    }
+    if (rc == SQLITE_OK) rc = sqlite3_ccvfs_flush_write_buffer(db);
+    if (rc == SQLITE_OK) rc = sqlite3_ccvfs_get_histograms(db, hist);
+    if (rc == SQLITE_OK && strstr(report, "ccvfs_histograms: on") &&
+        hist[CCVFS_STAGE_WRITE_PAGE].count > 0 && hist[CCVFS_STAGE_WRITE_IO].count > 0 &&
+        hist[CCVFS_STAGE_ALLOCATE].count > 0 && hist[CCVFS_STAGE_WRITE_PAGE].total_ns > 0) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message), "No write samples after PRAGMA ON: rc=%d, writes=%llu",
+                rc, (unsigned long long)hist[CCVFS_STAGE_WRITE_PAGE].count);
+        goto done;
+    }
+    
+    // Switched on VFS-wide: a second connection reads pages from disk and times each stage
+    rc = sqlite3_ccvfs_configure_histograms("histogram_vfs", 1);
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_open_v2("test_histograms.db", &reader, SQLITE_OPEN_READONLY, "histogram_vfs");
+    }
+    if (rc == SQLITE_OK) rc = sqlite3_exec(reader, "SELECT count(*), sum(length(data)) FROM t", NULL, NULL, NULL);
+    if (rc == SQLITE_OK) rc = sqlite3_ccvfs_get_histograms(reader, hist);
+    if (rc == SQLITE_OK && hist[CCVFS_STAGE_READ_PAGE].count > 0 && hist[CCVFS_STAGE_READ_IO].count > 0 &&
+        hist[CCVFS_STAGE_CRC_VERIFY].count == hist[CCVFS_STAGE_READ_IO].count) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message), "No read samples: rc=%d, reads=%llu",
+                rc, (unsigned long long)hist[CCVFS_STAGE_READ_PAGE].count);
+        goto done;
+    }
+    
+    // The report lists each stage with samples
+    rc = query_pragma(reader, "PRAGMA ccvfs_histograms", report, sizeof(report));
+    if (rc == SQLITE_OK && strstr(report, "read_page") && strstr(report, "p99_us") && !strstr(report, "write_page")) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message), "Unexpected report: %.200s", report);
+        goto done;
+    }
+    
+    // RESET clears the samples
+    rc = query_pragma(db, "PRAGMA ccvfs_histograms=RESET", report, sizeof(report));
+    if (rc == SQLITE_OK) rc = sqlite3_ccvfs_get_histograms(db, hist);
+    if (rc == SQLITE_OK && hist[CCVFS_STAGE_WRITE_PAGE].count == 0 && strstr(report, "(no samples)")) {
+        result->passed++;
+        snprintf(result->message, sizeof(result->message), "Histograms switched at runtime and reported per stage");
+    } else {
+        snprintf(result->message, sizeof(result->message), "RESET left samples: rc=%d", rc);
+    }
+    
+done:
+    sqlite3_close(reader);
+    sqlite3_close(db);
+    sqlite3_ccvfs_destroy("histogram_vfs");
+    
+    return (result->passed == result->total) ? 1 : 0;
+}
+
+// Runtime PRAGMA Test: per-database tuning, statistics, flush and online compaction
+int test_runtime_pragmas(TestResult* result) {
+    result->name = "Runtime PRAGMA Test";
+    result->passed = 0;
+    result->total = 6;
+    strcpy(result->message, "");
+    
+    cleanup_test_files("test_pragmas");
+    init_test_algorithms();
+    
+#ifdef HAVE_ZLIB
+    int rc = sqlite3_ccvfs_create("pragma_vfs", NULL, CCVFS_COMPRESS_ZLIB, NULL, 4096, CCVFS_CREATE_REALTIME);
+#else
+    int rc = sqlite3_ccvfs_create("pragma_vfs", NULL, NULL, NULL, 4096, CCVFS_CREATE_REALTIME);
+#endif
+    if (rc != SQLITE_OK) {
+        snprintf(result->message, sizeof(result->message), "VFS creation failed: %d", rc);
+        return 0;
+    }
+    
+    sqlite3 *db = NULL;
+    char value[4096];
+    char check[64];
+    rc = sqlite3_open_v2("test_pragmas.db", &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, "pragma_vfs");
+    
+    // Write buffer size: set, read back, out-of-range values rejected
+    if (rc == SQLITE_OK) rc = stats_fill_table(db, 20);
+    if (rc == SQLITE_OK) rc = query_pragma(db, "PRAGMA ccvfs_cache_size=8", value, sizeof(value));
+    if (rc == SQLITE_OK && strcmp(value, "8") == 0 &&
+        query_pragma(db, "PRAGMA ccvfs_cache_size", value, sizeof(value)) == SQLITE_OK && strcmp(value, "8") == 0 &&
+        query_pragma(db, "PRAGMA ccvfs_cache_size=0", value, sizeof(value)) != SQLITE_OK) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message), "ccvfs_cache_size failed: rc=%d, value=%s", rc, value);
+        goto done;
+    }
+    
+    // Compression level applies to later writes, invalid levels rejected
+    rc = query_pragma(db, "PRAGMA ccvfs_compress_level=9", value, sizeof(value));
+    if (rc == SQLITE_OK && strcmp(value, "9") == 0) {
+        rc = sqlite3_exec(db, "UPDATE t SET data = data || 'y'", NULL, NULL, NULL);
+    }
+    if (rc == SQLITE_OK && strcmp(value, "9") == 0 &&
+        query_pragma(db, "PRAGMA ccvfs_compress_level=12", value, sizeof(value)) != SQLITE_OK) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message), "ccvfs_compress_level failed: rc=%d, value=%s", rc, value);
+        goto done;
+    }
+    
+    // Statistics of the file and of the VFS
+    rc = query_pragma(db, "PRAGMA ccvfs_stats", value, sizeof(value));
+    if (rc == SQLITE_OK && strstr(value, "database_pages") && strstr(value, "new_allocation_count") &&
+        strstr(value, "compress_level             9") &&
+        query_pragma(db, "PRAGMA ccvfs_stats=vfs", value, sizeof(value)) == SQLITE_OK &&
+        strstr(value, "ccvfs_stats: vfs pragma_vfs") && strstr(value, "open_files                 1")) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message), "ccvfs_stats failed: rc=%d, %.200s", rc, value);
+        goto done;
+    }
+    
+    // Flush and switching the write buffer off
+    rc = query_pragma(db, "PRAGMA ccvfs_flush", value, sizeof(value));
+    if (rc == SQLITE_OK && value[0] >= '0' && value[0] <= '9' &&
+        query_pragma(db, "PRAGMA ccvfs_write_buffer=OFF", value, sizeof(value)) == SQLITE_OK &&
+        strcmp(value, "off") == 0 &&
+        sqlite3_exec(db, "INSERT INTO t (data) VALUES ('unbuffered')", NULL, NULL, NULL) == SQLITE_OK) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message), "ccvfs_flush/ccvfs_write_buffer failed: rc=%d, value=%s",
+                rc, value);
+        goto done;
+    }
+    
+    // Compaction reclaims the space of a dropped table and keeps the data readable after reopening
+    rc = sqlite3_exec(db, "CREATE TABLE big (data BLOB);"
+                          "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 200) "
+                          "INSERT INTO big SELECT randomblob(3000) FROM n;"
+                          "DROP TABLE big; VACUUM", NULL, NULL, NULL);
+    if (rc == SQLITE_OK) rc = query_pragma(db, "PRAGMA ccvfs_compact", value, sizeof(value));
+    long long reclaimed = 0;
+    const char *pReclaimed = strstr(value, "reclaimed_bytes=");
+    if (pReclaimed) reclaimed = atoll(pReclaimed + strlen("reclaimed_bytes="));
+    if (rc == SQLITE_OK) {
+        sqlite3_close(db);
+        db = NULL;
+        rc = sqlite3_open_v2("test_pragmas.db", &db, SQLITE_OPEN_READWRITE, "pragma_vfs");
+    }
+    if (rc == SQLITE_OK) rc = query_pragma(db, "PRAGMA integrity_check", check, sizeof(check));
+    if (rc == SQLITE_OK && strcmp(check, "ok") == 0 && reclaimed > 200 * 3000 &&
+        query_pragma(db, "SELECT count(*) FROM t", check, sizeof(check)) == SQLITE_OK && strcmp(check, "21") == 0) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message), "ccvfs_compact failed: rc=%d, %s, check=%s",
+                rc, value, check);
+        goto done;
+    }
+    
+    // Compaction is refused inside a write transaction
+    rc = sqlite3_exec(db, "BEGIN IMMEDIATE", NULL, NULL, NULL);
+    if (rc == SQLITE_OK && query_pragma(db, "PRAGMA ccvfs_compact", value, sizeof(value)) != SQLITE_OK &&
+        strstr(sqlite3_errmsg(db), "write transaction")) {
+        result->passed++;
+        snprintf(result->message, sizeof(result->message), "PRAGMAs tuned, reported and compacted (%lld bytes)",
+                reclaimed);
+    } else {
+        snprintf(result->message, sizeof(result->message), "ccvfs_compact ran inside a transaction: rc=%d", rc);
+    }
+    sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
+    
+done:
+    sqlite3_close(db);
+    sqlite3_ccvfs_destroy("pragma_vfs");
+    
+    return (result->passed == result->total) ? 1 : 0;
+}
+
+// Messages received by the log callback of the logging test
+typedef struct {
+    int count[CCVFS_LOG_VERBOSE + 1];
+    int trace_lines;
+    int checksum_errors;
+} LogCapture;
+
+static void capture_log(void *pArg, int level, const char *zMsg) {
+    LogCapture *pCapture = (LogCapture*)pArg;
+    if (level >= 0 && level <= CCVFS_LOG_VERBOSE) {
+        pCapture->count[level]++;
+    }
+    if (strncmp(zMsg, "trace #", 7) == 0) {
+        pCapture->trace_lines++;
+    } else if (level == CCVFS_LOG_ERROR && strstr(zMsg, "checksum mismatch")) {
+        pCapture->checksum_errors++;
+    }
+}
+
+// Count recorded events of one type
+static int count_events(int type, uint64_t *pLastSequence) {
+    static CCVFSTraceEvent aEvent[CCVFS_TRACE_RING_SIZE];
+    int n = sqlite3_ccvfs_trace_read(aEvent, CCVFS_TRACE_RING_SIZE);
+    int count = 0;
+    for (int i = 0; i < n; i++) {
+        if (i > 0 && aEvent[i].sequence <= aEvent[i - 1].sequence) {
+            return -1;  // Events must come oldest first
+        }
+        if ((int)aEvent[i].type == type) {
+            count++;
+        }
+    }
+    if (pLastSequence) {
+        *pLastSequence = n > 0 ? aEvent[n - 1].sequence : 0;
+    }
+    return count;
+}
+
+// Logging and Trace Test: runtime log levels, log callback, page event ring and dump on error
+int test_log_trace(TestResult* result) {
+    result->name = "Logging and Trace Test";
+    result->passed = 0;
+    result->total = 5;
+    strcpy(result->message, "");
+    
+    cleanup_test_files("test_logtrace");
+    init_test_algorithms();
+    
+#ifdef HAVE_ZLIB
+    int rc = sqlite3_ccvfs_create("logtrace_vfs", NULL, CCVFS_COMPRESS_ZLIB, NULL, 4096, CCVFS_CREATE_REALTIME);
+#else
+    int rc = sqlite3_ccvfs_create("logtrace_vfs", NULL, NULL, NULL, 4096, CCVFS_CREATE_REALTIME);
+#endif
+    if (rc != SQLITE_OK) {
+        snprintf(result->message, sizeof(result->message), "VFS creation failed: %d", rc);
+        return 0;
+    }
+    
+    LogCapture capture;
+    memset(&capture, 0, sizeof(capture));
+    int prevLevel = sqlite3_ccvfs_get_log_level();
+    sqlite3_ccvfs_set_log_callback(capture_log, &capture);
+    
+    sqlite3 *db = NULL;
+    char value[8192];
+    rc = sqlite3_open_v2("test_logtrace.db", &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, "logtrace_vfs");
+    
+    // Debug messages only reach the callback while the level allows them
+    if (rc == SQLITE_OK) rc = query_pragma(db, "PRAGMA ccvfs_log_level=OFF", value, sizeof(value));
+    if (rc == SQLITE_OK) rc = stats_fill_table(db, 20);
+    int quiet = capture.count[CCVFS_LOG_DEBUG];
+    if (rc == SQLITE_OK) rc = query_pragma(db, "PRAGMA ccvfs_log_level=debug", value, sizeof(value));
+    if (rc == SQLITE_OK) rc = sqlite3_exec(db, "INSERT INTO t (data) VALUES ('logged')", NULL, NULL, NULL);
+    int loud = capture.count[CCVFS_LOG_DEBUG];
+    sqlite3_ccvfs_set_log_level(CCVFS_LOG_ERROR);
+    if (rc == SQLITE_OK && quiet == 0 && loud > 0 && strcmp(value, "DEBUG") == 0 &&
+        query_pragma(db, "PRAGMA ccvfs_log_level=loud", value, sizeof(value)) != SQLITE_OK) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message), "Log levels failed: rc=%d, quiet=%d, loud=%d, value=%s",
+                rc, quiet, loud, value);
+        goto done;
+    }
+    
+    // Writes, allocations, flushes and syncs land in the ring while tracing is on
+    rc = query_pragma(db, "PRAGMA ccvfs_trace=ON", value, sizeof(value));
+    if (rc == SQLITE_OK) rc = sqlite3_exec(db, "UPDATE t SET data = data || 'traced'", NULL, NULL, NULL);
+    int writes = count_events(CCVFS_EVENT_WRITE, NULL);
+    int allocations = count_events(CCVFS_EVENT_ALLOCATE, NULL);
+    int syncs = count_events(CCVFS_EVENT_SYNC, NULL);
+    if (rc == SQLITE_OK && writes > 0 && allocations >= writes && syncs > 0 &&
+        query_pragma(db, "PRAGMA ccvfs_trace", value, sizeof(value)) == SQLITE_OK &&
+        strstr(value, "ccvfs_trace: on") && strstr(value, " write page=")) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message),
+                "Trace ring failed: rc=%d, writes=%d, allocations=%d, syncs=%d", rc, writes, allocations, syncs);
+        goto done;
+    }
+    
+    // Page reads after reopening, and nothing recorded once tracing is off
+    sqlite3_close(db);
+    db = NULL;
+    rc = sqlite3_open_v2("test_logtrace.db", &db, SQLITE_OPEN_READWRITE, "logtrace_vfs");
+    if (rc == SQLITE_OK) rc = sqlite3_ccvfs_pages_init(db, NULL, NULL);
+    if (rc == SQLITE_OK) rc = query_pragma(db, "SELECT count(*) FROM t", value, sizeof(value));
+    int reads = count_events(CCVFS_EVENT_READ, NULL);
+    uint64_t lastBefore = 0, lastAfter = 0;
+    sqlite3_ccvfs_trace_config(0);
+    count_events(CCVFS_EVENT_READ, &lastBefore);
+    if (rc == SQLITE_OK) rc = query_pragma(db, "SELECT sum(length(data)) FROM t", value, sizeof(value));
+    count_events(CCVFS_EVENT_READ, &lastAfter);
+    if (rc == SQLITE_OK && reads > 0 && lastBefore > 0 && lastAfter == lastBefore) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message), "Read events failed: rc=%d, reads=%d, last=%llu/%llu",
+                rc, reads, (unsigned long long)lastBefore, (unsigned long long)lastAfter);
+        goto done;
+    }
+    
+    // A damaged page is reported through the callback, followed by the events leading up to it
+    long long offset = -1;
+    rc = query_pragma(db, "SELECT physical_offset FROM ccvfs_pages WHERE name = 't' AND pagetype = 'leaf' "
+                          "AND compressed_size > 64 LIMIT 1", value, sizeof(value));
+    if (rc == SQLITE_OK && value[0]) offset = atoll(value);
+    sqlite3_close(db);
+    db = NULL;
+    FILE *fp = offset > 0 ? fopen("test_logtrace.db", "r+b") : NULL;
+    if (fp) {
+        unsigned char garbage[16];
+        memset(garbage, 0xA5, sizeof(garbage));
+        fseek(fp, (long)offset + 32, SEEK_SET);
+        fwrite(garbage, 1, sizeof(garbage), fp);
+        fclose(fp);
+    }
+    sqlite3_ccvfs_trace_config(CCVFS_TRACE_ON | CCVFS_TRACE_DUMP_ON_ERROR);
+    memset(&capture, 0, sizeof(capture));
+    rc = sqlite3_open_v2("test_logtrace.db", &db, SQLITE_OPEN_READWRITE, "logtrace_vfs");
+    int readRc = rc == SQLITE_OK ? query_pragma(db, "SELECT sum(length(data)) FROM t", value, sizeof(value)) : rc;
+    int checksums = count_events(CCVFS_EVENT_CHECKSUM, NULL);
+    if (fp && readRc != SQLITE_OK && checksums > 0 && capture.trace_lines > 0 &&
+        capture.checksum_errors > 0) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message),
+                "Dump on error failed: offset=%lld, rc=%d, checksums=%d, errors=%d, trace_lines=%d",
+                offset, readRc, checksums, capture.count[CCVFS_LOG_ERROR], capture.trace_lines);
+        goto done;
+    }
+    
+    // Switching off restores the defaults
+    sqlite3_ccvfs_trace_config(0);
+    if (sqlite3_ccvfs_set_log_level(CCVFS_LOG_VERBOSE + 1) == SQLITE_RANGE &&
+        sqlite3_ccvfs_event_name(CCVFS_EVENT_CHECKSUM) && strcmp(sqlite3_ccvfs_event_name(CCVFS_EVENT_READ), "read") == 0 &&
+        sqlite3_ccvfs_event_name(CCVFS_EVENT_COUNT) == NULL) {
+        result->passed++;
+        snprintf(result->message, sizeof(result->message), "%d debug messages, %d writes and %d reads traced, %d events dumped",
+                loud, writes, reads, capture.trace_lines);
+    } else {
+        snprintf(result->message, sizeof(result->message), "Invalid level or event name accepted");
+    }
+    
+done:
+    sqlite3_ccvfs_trace_config(0);
+    sqlite3_ccvfs_set_log_callback(NULL, NULL);
+    sqlite3_ccvfs_set_log_level(prevLevel);
+    sqlite3_close(db);
+    sqlite3_ccvfs_destroy("logtrace_vfs");
+    cleanup_test_files("test_logtrace");
+    
+    return (result->passed == result->total) ? 1 : 0;
+}
+
+// Events received by the I/O hook of the hook test
+typedef struct {
+    int events[CCVFS_EVENT_COUNT];
+    int outcomes[CCVFS_CACHE_SPARSE + 1];
+    int disk_reads_with_size;
+    int direct_writes_with_offset;
+    int named;
+    uint64_t sync_ns;
+} HookCapture;
+
+static void capture_io(void *pArg, const CCVFSIoEvent *pEvent) {
+    HookCapture *pCapture = (HookCapture*)pArg;
+    pCapture->events[pEvent->type]++;
+    if (pEvent->type == CCVFS_EVENT_READ || pEvent->type == CCVFS_EVENT_WRITE) {
+        pCapture->outcomes[pEvent->cache]++;
+    }
+    if (pEvent->type == CCVFS_EVENT_READ && pEvent->cache == CCVFS_CACHE_DISK &&
+        pEvent->stored_size > 0 && pEvent->original_size == 4096 && pEvent->offset > 0) {
+        pCapture->disk_reads_with_size++;
+    }
+    if (pEvent->type == CCVFS_EVENT_WRITE && pEvent->cache == CCVFS_CACHE_DISK && pEvent->offset > 0) {
+        pCapture->direct_writes_with_offset++;
+    }
+    if (pEvent->type == CCVFS_EVENT_SYNC) {
+        pCapture->sync_ns += pEvent->duration_ns;
+    }
+    if (pEvent->zFile && strcmp(pEvent->zFile, "test_hooks.db") == 0) {
+        pCapture->named++;
+    }
+}
+
+static void ignore_io(void *pArg, const CCVFSIoEvent *pEvent) {
+    (void)pArg;
+    (void)pEvent;
+}
+
+// I/O Hook Test: registration, page events with sizes, timing and cache outcome, unregistration
+int test_io_hooks(TestResult* result) {
+    result->name = "I/O Hook Test";
+    result->passed = 0;
+    result->total = 5;
+    strcpy(result->message, "");
+    
+    cleanup_test_files("test_hooks");
+    init_test_algorithms();
+    
+#ifdef HAVE_ZLIB
+    int rc = sqlite3_ccvfs_create("hooks_vfs", NULL, CCVFS_COMPRESS_ZLIB, NULL, 4096, CCVFS_CREATE_REALTIME);
+#else
+    int rc = sqlite3_ccvfs_create("hooks_vfs", NULL, NULL, NULL, 4096, CCVFS_CREATE_REALTIME);
+#endif
+    if (rc != SQLITE_OK) {
+        snprintf(result->message, sizeof(result->message), "VFS creation failed: %d", rc);
+        return 0;
+    }
+    
+    HookCapture capture;
+    int slots[CCVFS_MAX_IO_HOOKS];
+    memset(&capture, 0, sizeof(capture));
+    sqlite3 *db = NULL;
+    char value[256];
+    
+    // Registration: invalid arguments and a full table are rejected
+    int registered = 0;
+    for (int i = 0; i < CCVFS_MAX_IO_HOOKS - 1; i++) {
+        if (sqlite3_ccvfs_register_io_hook(ignore_io, &slots[i], CCVFS_EVENT_MASK(CCVFS_EVENT_SYNC)) == SQLITE_OK) {
+            registered++;
+        }
+    }
+    rc = sqlite3_ccvfs_register_io_hook(capture_io, &capture, CCVFS_EVENT_ALL);
+    int full = sqlite3_ccvfs_register_io_hook(ignore_io, &capture, CCVFS_EVENT_ALL);
+    for (int i = 0; i < CCVFS_MAX_IO_HOOKS - 1; i++) {
+        sqlite3_ccvfs_unregister_io_hook(ignore_io, &slots[i]);
+    }
+    if (rc == SQLITE_OK && registered == CCVFS_MAX_IO_HOOKS - 1 && full == SQLITE_FULL &&
+        sqlite3_ccvfs_register_io_hook(NULL, NULL, CCVFS_EVENT_ALL) == SQLITE_MISUSE &&
+        sqlite3_ccvfs_register_io_hook(ignore_io, NULL, 0) == SQLITE_MISUSE) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message), "Registration failed: rc=%d, registered=%d, full=%d",
+                rc, registered, full);
+        goto done;
+    }
+    
+    // Buffered writes, then the flush, allocations and sync of the commit
+    rc = sqlite3_open_v2("test_hooks.db", &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, "hooks_vfs");
+    if (rc == SQLITE_OK) rc = stats_fill_table(db, 50);
+    if (rc == SQLITE_OK && capture.outcomes[CCVFS_CACHE_BUFFER] > 0 && capture.events[CCVFS_EVENT_FLUSH] > 0 &&
+        capture.events[CCVFS_EVENT_ALLOCATE] > 0 && capture.events[CCVFS_EVENT_SYNC] > 0 && capture.sync_ns > 0) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message),
+                "Write events failed: rc=%d, buffered=%d, flushes=%d, allocations=%d, syncs=%d",
+                rc, capture.outcomes[CCVFS_CACHE_BUFFER], capture.events[CCVFS_EVENT_FLUSH],
+                capture.events[CCVFS_EVENT_ALLOCATE], capture.events[CCVFS_EVENT_SYNC]);
+        goto done;
+    }
+    
+    // Reads after reopening come from disk with their stored and logical sizes
+    sqlite3_close(db);
+    db = NULL;
+    rc = sqlite3_open_v2("test_hooks.db", &db, SQLITE_OPEN_READWRITE, "hooks_vfs");
+    if (rc == SQLITE_OK) rc = query_pragma(db, "SELECT sum(length(data)) FROM t", value, sizeof(value));
+    if (rc == SQLITE_OK && capture.disk_reads_with_size > 0 && capture.named > 0) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message), "Read events failed: rc=%d, disk_reads=%d, named=%d",
+                rc, capture.disk_reads_with_size, capture.named);
+        goto done;
+    }
+    
+    // Unbuffered writes go straight to disk and report where the page landed
+    sqlite3_close(db);
+    db = NULL;
+    rc = sqlite3_ccvfs_configure_write_buffer("hooks_vfs", 0, 32, 4*1024*1024, 16);
+    if (rc == SQLITE_OK) rc = sqlite3_open_v2("test_hooks.db", &db, SQLITE_OPEN_READWRITE, "hooks_vfs");
+    if (rc == SQLITE_OK) rc = sqlite3_exec(db, "UPDATE t SET data = data || 'direct'", NULL, NULL, NULL);
+    if (rc == SQLITE_OK && capture.direct_writes_with_offset > 0) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message), "Direct write events failed: rc=%d, direct=%d",
+                rc, capture.direct_writes_with_offset);
+        goto done;
+    }
+    
+    // Nothing is delivered once unregistered
+    rc = sqlite3_ccvfs_unregister_io_hook(capture_io, &capture);
+    int before = capture.events[CCVFS_EVENT_READ] + capture.events[CCVFS_EVENT_WRITE];
+    sqlite3_close(db);
+    db = NULL;
+    if (rc == SQLITE_OK) rc = sqlite3_open_v2("test_hooks.db", &db, SQLITE_OPEN_READWRITE, "hooks_vfs");
+    if (rc == SQLITE_OK) rc = sqlite3_exec(db, "UPDATE t SET data = 'after'", NULL, NULL, NULL);
+    if (rc == SQLITE_OK && before == capture.events[CCVFS_EVENT_READ] + capture.events[CCVFS_EVENT_WRITE] &&
+        sqlite3_ccvfs_unregister_io_hook(capture_io, &capture) == SQLITE_NOTFOUND) {
+        result->passed++;
+        snprintf(result->message, sizeof(result->message), "%d reads, %d writes, %d flushes, %d syncs observed",
+                capture.events[CCVFS_EVENT_READ], capture.events[CCVFS_EVENT_WRITE],
+                capture.events[CCVFS_EVENT_FLUSH], capture.events[CCVFS_EVENT_SYNC]);
+    } else {
+        snprintf(result->message, sizeof(result->message), "Unregistration failed: rc=%d", rc);
+    }
+    
+done:
+    sqlite3_ccvfs_unregister_io_hook(capture_io, &capture);
+    sqlite3_close(db);
+    sqlite3_ccvfs_destroy("hooks_vfs");
+    cleanup_test_files("test_hooks");
+    
+    return (result->passed == result->total) ? 1 : 0;
+}
@@ -0,0 +1,600 @@
+/*
+ * Concurrency Tests
+ *
+ * Contains multi-threaded stress tests for a single CCVFS file shared by
+ * several threads. Build with -DENABLE_TSAN=ON to run them under ThreadSanitizer.
+ */
+
+#include "system_test_common.h"
+
+#ifndef _WIN32
+#include <pthread.h>
+
+#define STRESS_READERS        4
+#define STRESS_BATCHES        40
+#define STRESS_ROWS_PER_BATCH 25
+#define STRESS_INITIAL_ROWS   200
+
+typedef struct {
+    sqlite3 *db;              // Writer connection (shared cache)
+    volatile int writer_done; // Set once the writer finished
+    int writer_errors;
+    int reader_errors[STRESS_READERS];
+    int reader_queries[STRESS_READERS];
+    int maintenance_errors;
+    int maintenance_rounds;
+} StressContext;
+
+typedef struct {
+    StressContext *ctx;
+    int id;
+} ReaderArg;
+
+static int stress_writer_done(StressContext *ctx) {
+    return __atomic_load_n(&ctx->writer_done, __ATOMIC_ACQUIRE);
+}
+
+// Writer: appends batches of rows in separate transactions
+static void* stress_writer_thread(void *arg) {
+    StressContext *ctx = (StressContext*)arg;
+
+    for (int batch = 0; batch < STRESS_BATCHES; batch++) {
+        char sql[512];
+        snprintf(sql, sizeof(sql),
+            "BEGIN;"
+            "WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x+1 FROM c WHERE x < %d) "
+            "INSERT INTO t (data) SELECT printf('batch %d row %%d %%.*c', x, 150, 'w') FROM c;"
+            "COMMIT;", STRESS_ROWS_PER_BATCH, batch);
+        int rc;
+        do {
+            rc = sqlite3_exec(ctx->db, sql, NULL, NULL, NULL);
+            if (rc == SQLITE_LOCKED || rc == SQLITE_BUSY) {
+                sqlite3_exec(ctx->db, "ROLLBACK", NULL, NULL, NULL);
+                sqlite3_sleep(1);
+            }
+        } while (rc == SQLITE_LOCKED || rc == SQLITE_BUSY);
+        if (rc != SQLITE_OK) {
+            ctx->writer_errors++;
+        }
+    }
+
+    __atomic_store_n(&ctx->writer_done, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+// Reader: scans the table through its own shared-cache connection to the same file
+static void* stress_reader_thread(void *arg) {
+    ReaderArg *pArg = (ReaderArg*)arg;
+    StressContext *ctx = pArg->ctx;
+    sqlite3 *db = NULL;
+
+    int rc = sqlite3_open_v2("test_threads.db", &db,
+                             SQLITE_OPEN_READWRITE | SQLITE_OPEN_SHAREDCACHE | SQLITE_OPEN_FULLMUTEX,
+                             "threads_vfs");
+    if (rc != SQLITE_OK) {
+        ctx->reader_errors[pArg->id]++;
+        sqlite3_close(db);
+        return NULL;
+    }
+    sqlite3_exec(db, "PRAGMA read_uncommitted = 1", NULL, NULL, NULL);
+
+    while (!stress_writer_done(ctx)) {
+        sqlite3_stmt *stmt;
+        rc = sqlite3_prepare_v2(db, "SELECT COUNT(*), SUM(LENGTH(data)) FROM t", -1, &stmt, NULL);
+        if (rc == SQLITE_OK) {
+            rc = sqlite3_step(stmt);
+            if (rc == SQLITE_ROW && sqlite3_column_int(stmt, 0) < STRESS_INITIAL_ROWS) {
+                ctx->reader_errors[pArg->id]++;
+            }
+        }
+        sqlite3_finalize(stmt);
+
+        if (rc == SQLITE_ROW) {
+            ctx->reader_queries[pArg->id]++;
+        } else if (rc != SQLITE_LOCKED && rc != SQLITE_BUSY) {
+            ctx->reader_errors[pArg->id]++;
+        }
+    }
+
+    sqlite3_close(db);
+    return NULL;
+}
+
+// Maintenance: flushes the write buffer and reads statistics from outside the connection's I/O thread
+static void* stress_maintenance_thread(void *arg) {
+    StressContext *ctx = (StressContext*)arg;
+
+    while (!stress_writer_done(ctx)) {
+        uint32_t hits, flushes, merges, writes;
+        CCVFSFileStats stats;
+        if (sqlite3_ccvfs_flush_write_buffer(ctx->db) != SQLITE_OK) {
+            ctx->maintenance_errors++;
+        }
+        if (sqlite3_ccvfs_get_buffer_stats(ctx->db, &hits, &flushes, &merges, &writes) != SQLITE_OK) {
+            ctx->maintenance_errors++;
+        }
+        if (sqlite3_ccvfs_get_file_stats(ctx->db, &stats) != SQLITE_OK ||
+            sqlite3_ccvfs_get_vfs_stats("threads_vfs", &stats) != SQLITE_OK) {
+            ctx->maintenance_errors++;
+        }
+        ctx->maintenance_rounds++;
+    }
+    return NULL;
+}
+
+#define SNAPSHOT_READERS   2
+#define SNAPSHOT_ROUNDS    30
+#define SNAPSHOT_ROWS      300
+#define SNAPSHOT_DATA_OFFSET (128 + 65536 * 24)  // Data pages follow the header and the fixed index table
+
+typedef struct {
+    sqlite3_file *pFile;      // Main database file of the writer connection
+    int pageCount;            // Pages that exist before the writer starts
+    volatile int writer_done;
+    int read_errors;          // Shared by all reader threads, updated atomically
+    int reads;
+} SnapshotReader;
+
+// Snapshot reader: reads pages straight through the file handle while the writer commits and flushes
+static void* snapshot_reader_thread(void *arg) {
+    SnapshotReader *pReader = (SnapshotReader*)arg;
+    unsigned char page[4096];
+    unsigned int seed = (unsigned int)(size_t)arg;
+
+    while (!__atomic_load_n(&pReader->writer_done, __ATOMIC_ACQUIRE)) {
+        int pgno = (int)(rand_r(&seed) % pReader->pageCount);
+        int rc = pReader->pFile->pMethods->xRead(pReader->pFile, page, sizeof(page),
+                                                 (sqlite3_int64)pgno * sizeof(page));
+        if (rc != SQLITE_OK || (pgno == 0 && memcmp(page, "SQLite format 3", 16) != 0)) {
+            __atomic_fetch_add(&pReader->read_errors, 1, __ATOMIC_RELAXED);
+        }
+        __atomic_fetch_add(&pReader->reads, 1, __ATOMIC_RELAXED);
+    }
+    return NULL;
+}
+
+static sqlite3_int64 snapshot_file_size(const char *path) {
+    FILE *f = fopen(path, "rb");
+    sqlite3_int64 size = -1;
+    if (f) {
+        fseek(f, 0, SEEK_END);
+        size = ftell(f);
+        fclose(f);
+    }
+    return size;
+}
+
+#define WAL_READERS        3
+#define WAL_BATCHES        60
+#define WAL_ROWS_PER_BATCH 20
+
+typedef struct {
+    volatile int writer_done;
+    int reader_errors;        // Shared by all reader threads, updated atomically
+    int reader_queries;
+    char error[128];          // First reader error
+} WalReaderContext;
+
+// WAL reader: its own connection, row counts never go backwards across checkpoints
+static void* wal_reader_thread(void *arg) {
+    WalReaderContext *ctx = (WalReaderContext*)arg;
+    sqlite3 *db = NULL;
+    int lastCount = 0;
+
+    int rc = sqlite3_open_v2("test_wal_readers.db", &db, SQLITE_OPEN_READWRITE, "wal_readers_vfs");
+    if (rc == SQLITE_OK) {
+        sqlite3_busy_timeout(db, 5000);
+    }
+    while (rc == SQLITE_OK && !__atomic_load_n(&ctx->writer_done, __ATOMIC_ACQUIRE)) {
+        sqlite3_stmt *stmt;
+        int count = -1;
+        rc = sqlite3_prepare_v2(db, "SELECT COUNT(*), SUM(LENGTH(data)) FROM t", -1, &stmt, NULL);
+        if (rc == SQLITE_OK) {
+            rc = sqlite3_step(stmt);
+            if (rc == SQLITE_ROW) {
+                count = sqlite3_column_int(stmt, 0);
+            }
+        }
+        sqlite3_finalize(stmt);
+
+        if (rc == SQLITE_BUSY || rc == SQLITE_LOCKED) {
+            rc = SQLITE_OK;
+        } else if (rc == SQLITE_ROW && count >= lastCount) {
+            lastCount = count;
+            __atomic_fetch_add(&ctx->reader_queries, 1, __ATOMIC_RELAXED);
+            rc = SQLITE_OK;
+        } else if (rc == SQLITE_ROW) {
+            snprintf(ctx->error, sizeof(ctx->error), "row count went back from %d to %d", lastCount, count);
+            rc = SQLITE_ERROR;
+        } else {
+            snprintf(ctx->error, sizeof(ctx->error), "query failed: %s", sqlite3_errmsg(db));
+        }
+    }
+    if (rc != SQLITE_OK) {
+        __atomic_fetch_add(&ctx->reader_errors, 1, __ATOMIC_RELAXED);
+    }
+
+    sqlite3_close(db);
+    return NULL;
+}
+#endif
+
+// Thread stress test: one writer, several readers and a maintenance thread on one file
+int test_thread_stress(TestResult* result) {
+    result->name = "Thread Stress Test";
+    result->passed = 0;
+    result->total = 5;
+    strcpy(result->message, "");
+
+#ifdef _WIN32
+    result->passed = result->total;
+    snprintf(result->message, sizeof(result->message), "Skipped: requires pthreads");
+    return 1;
+#else
+    cleanup_test_files("test_threads");
+
+    // Initialize algorithms
+    init_test_algorithms();
+
+#ifdef HAVE_ZLIB
+    int rc = sqlite3_ccvfs_create("threads_vfs", NULL, CCVFS_COMPRESS_ZLIB, NULL, 4096, CCVFS_CREATE_REALTIME);
+#else
+    int rc = sqlite3_ccvfs_create("threads_vfs", NULL, NULL, NULL, 4096, CCVFS_CREATE_REALTIME);
+#endif
+    if (rc != SQLITE_OK) {
+        snprintf(result->message, sizeof(result->message), "VFS creation failed: %d", rc);
+        return 0;
+    }
+    result->passed++;
+
+    StressContext ctx;
+    memset(&ctx, 0, sizeof(ctx));
+
+    // Writer connection, shared cache so all readers use the same CCVFS file handle
+    rc = sqlite3_open_v2("test_threads.db", &ctx.db,
+                         SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_SHAREDCACHE | SQLITE_OPEN_FULLMUTEX,
+                         "threads_vfs");
+    if (rc == SQLITE_OK) {
+        char sql[512];
+        snprintf(sql, sizeof(sql),
+            "CREATE TABLE t (id INTEGER PRIMARY KEY, data TEXT);"
+            "WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x+1 FROM c WHERE x < %d) "
+            "INSERT INTO t (data) SELECT printf('initial row %%d %%.*c', x, 150, 'i') FROM c;",
+            STRESS_INITIAL_ROWS);
+        rc = sqlite3_exec(ctx.db, sql, NULL, NULL, NULL);
+    }
+    if (rc != SQLITE_OK) {
+        snprintf(result->message, sizeof(result->message), "Setup failed: %s", sqlite3_errmsg(ctx.db));
+        sqlite3_close(ctx.db);
+        sqlite3_ccvfs_destroy("threads_vfs");
+        return 0;
+    }
+    result->passed++;
+
+    // Run all threads concurrently
+    pthread_t writer, maintenance, readers[STRESS_READERS];
+    ReaderArg readerArgs[STRESS_READERS];
+
+    for (int i = 0; i < STRESS_READERS; i++) {
+        readerArgs[i].ctx = &ctx;
+        readerArgs[i].id = i;
+        pthread_create(&readers[i], NULL, stress_reader_thread, &readerArgs[i]);
+    }
+    pthread_create(&maintenance, NULL, stress_maintenance_thread, &ctx);
+    pthread_create(&writer, NULL, stress_writer_thread, &ctx);
+
+    pthread_join(writer, NULL);
+    pthread_join(maintenance, NULL);
+    int readerErrors = 0, readerQueries = 0;
+    for (int i = 0; i < STRESS_READERS; i++) {
+        pthread_join(readers[i], NULL);
+        readerErrors += ctx.reader_errors[i];
+        readerQueries += ctx.reader_queries[i];
+    }
+
+    if (ctx.writer_errors == 0 && readerErrors == 0 && ctx.maintenance_errors == 0) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message),
+                "Thread errors: writer=%d, readers=%d, maintenance=%d",
+                ctx.writer_errors, readerErrors, ctx.maintenance_errors);
+        goto cleanup;
+    }
+
+    // Every committed row is present
+    sqlite3_stmt *stmt;
+    int expected = STRESS_INITIAL_ROWS + STRESS_BATCHES * STRESS_ROWS_PER_BATCH;
+    int count = -1;
+    if (sqlite3_prepare_v2(ctx.db, "SELECT COUNT(*) FROM t", -1, &stmt, NULL) == SQLITE_OK &&
+        sqlite3_step(stmt) == SQLITE_ROW) {
+        count = sqlite3_column_int(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    if (count != expected) {
+        snprintf(result->message, sizeof(result->message), "Row count %d, expected %d", count, expected);
+        goto cleanup;
+    }
+    result->passed++;
+
+    // File is consistent when reopened by a fresh connection
+    sqlite3_close(ctx.db);
+    ctx.db = NULL;
+    sqlite3 *db = NULL;
+    rc = sqlite3_open_v2("test_threads.db", &db, SQLITE_OPEN_READWRITE, "threads_vfs");
+    if (rc == SQLITE_OK && sqlite3_prepare_v2(db, "PRAGMA integrity_check", -1, &stmt, NULL) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW &&
+            strcmp((const char*)sqlite3_column_text(stmt, 0), "ok") == 0) {
+            result->passed++;
+        } else {
+            snprintf(result->message, sizeof(result->message), "Integrity check failed after stress run: %s", (const char*)sqlite3_column_text(stmt, 0));
+        }
+        sqlite3_finalize(stmt);
+    } else {
+        snprintf(result->message, sizeof(result->message), "Reopen failed: %d", rc);
+    }
+    sqlite3_close(db);
+
+cleanup:
+    sqlite3_close(ctx.db);
+    sqlite3_ccvfs_destroy("threads_vfs");
+
+    if (result->passed == result->total) {
+        snprintf(result->message, sizeof(result->message),
+                "%d readers ran %d queries during %d commits and %d flush rounds",
+                STRESS_READERS, readerQueries, STRESS_BATCHES, ctx.maintenance_rounds);
+    }
+
+    cleanup_test_files("test_threads");
+    return (result->passed == result->total) ? 1 : 0;
+#endif
+}
+
+// Snapshot read test: page reads keep working while every committed page is rewritten and flushed
+int test_snapshot_reads(TestResult* result) {
+    result->name = "Snapshot Read Test";
+    result->passed = 0;
+    result->total = 5;
+    strcpy(result->message, "");
+
+#ifdef _WIN32
+    result->passed = result->total;
+    snprintf(result->message, sizeof(result->message), "Skipped: requires pthreads");
+    return 1;
+#else
+    cleanup_test_files("test_snapshot");
+
+    // Initialize algorithms
+    init_test_algorithms();
+
+#ifdef HAVE_ZLIB
+    int rc = sqlite3_ccvfs_create("snapshot_vfs", NULL, CCVFS_COMPRESS_ZLIB, NULL, 4096, CCVFS_CREATE_REALTIME);
+#else
+    int rc = sqlite3_ccvfs_create("snapshot_vfs", NULL, NULL, NULL, 4096, CCVFS_CREATE_REALTIME);
+#endif
+    if (rc != SQLITE_OK) {
+        snprintf(result->message, sizeof(result->message), "VFS creation failed: %d", rc);
+        return 0;
+    }
+    result->passed++;
+
+    // Populate and commit so that every page has been published once
+    sqlite3 *db = NULL;
+    rc = sqlite3_open_v2("test_snapshot.db", &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, "snapshot_vfs");
+    if (rc == SQLITE_OK) {
+        char sql[512];
+        snprintf(sql, sizeof(sql),
+            "PRAGMA page_size = 4096;"
+            "CREATE TABLE t (id INTEGER PRIMARY KEY, data TEXT);"
+            "WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x+1 FROM c WHERE x < %d) "
+            "INSERT INTO t (data) SELECT printf('row %%d %%.*c', x, 200, 'a') FROM c;",
+            SNAPSHOT_ROWS);
+        rc = sqlite3_exec(db, sql, NULL, NULL, NULL);
+    }
+    SnapshotReader reader;
+    memset(&reader, 0, sizeof(reader));
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_file_control(db, NULL, SQLITE_FCNTL_FILE_POINTER, &reader.pFile);
+    }
+    sqlite3_stmt *stmt = NULL;
+    if (rc == SQLITE_OK && sqlite3_prepare_v2(db, "PRAGMA page_count", -1, &stmt, NULL) == SQLITE_OK &&
+        sqlite3_step(stmt) == SQLITE_ROW) {
+        reader.pageCount = sqlite3_column_int(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_OK || !reader.pFile || reader.pageCount <= 1) {
+        snprintf(result->message, sizeof(result->message), "Setup failed: %s", sqlite3_errmsg(db));
+        sqlite3_close(db);
+        sqlite3_ccvfs_destroy("snapshot_vfs");
+        return 0;
+    }
+    sqlite3_int64 initialSize = snapshot_file_size("test_snapshot.db");
+    result->passed++;
+
+    // Rewrite every row in each round while readers go through the file handle
+    pthread_t readers[SNAPSHOT_READERS];
+    for (int i = 0; i < SNAPSHOT_READERS; i++) {
+        pthread_create(&readers[i], NULL, snapshot_reader_thread, &reader);
+    }
+
+    int writerErrors = 0;
+    for (int round = 0; round < SNAPSHOT_ROUNDS && writerErrors == 0; round++) {
+        char sql[256];
+        snprintf(sql, sizeof(sql),
+                 "UPDATE t SET data = printf('row %%d round %d %%.*c', id, 200, char(98 + %d));",
+                 round, round % 20);
+        if (sqlite3_exec(db, sql, NULL, NULL, NULL) != SQLITE_OK ||
+            sqlite3_ccvfs_flush_write_buffer(db) != SQLITE_OK) {
+            writerErrors++;
+        }
+    }
+
+    __atomic_store_n(&reader.writer_done, 1, __ATOMIC_RELEASE);
+    for (int i = 0; i < SNAPSHOT_READERS; i++) {
+        pthread_join(readers[i], NULL);
+    }
+
+    if (writerErrors == 0 && reader.read_errors == 0 && reader.reads > 0) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message),
+                "Errors during rewrite: writer=%d, reads=%d, read errors=%d",
+                writerErrors, reader.reads, reader.read_errors);
+        goto cleanup;
+    }
+
+    // Old copies are reused once no snapshot can read them, so the file stays bounded
+    sqlite3_close(db);
+    db = NULL;
+    sqlite3_int64 finalSize = snapshot_file_size("test_snapshot.db");
+    if (finalSize > 0 &&
+        finalSize - SNAPSHOT_DATA_OFFSET < (initialSize - SNAPSHOT_DATA_OFFSET) * 8) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message),
+                "File grew from %lld to %lld bytes after %d rewrites",
+                (long long)initialSize, (long long)finalSize, SNAPSHOT_ROUNDS);
+        goto cleanup;
+    }
+
+    // Content is consistent when reopened
+    rc = sqlite3_open_v2("test_snapshot.db", &db, SQLITE_OPEN_READWRITE, "snapshot_vfs");
+    if (rc == SQLITE_OK && sqlite3_prepare_v2(db, "PRAGMA integrity_check", -1, &stmt, NULL) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW &&
+            strcmp((const char*)sqlite3_column_text(stmt, 0), "ok") == 0) {
+            result->passed++;
+        } else {
+            snprintf(result->message, sizeof(result->message), "Integrity check failed: %s", (const char*)sqlite3_column_text(stmt, 0));
+        }
+        sqlite3_finalize(stmt);
+    } else {
+        snprintf(result->message, sizeof(result->message), "Reopen failed: %d", rc);
+    }
+
+cleanup:
+    sqlite3_close(db);
+    sqlite3_ccvfs_destroy("snapshot_vfs");
+
+    if (result->passed == result->total) {
+        snprintf(result->message, sizeof(result->message),
+                "%d page reads during %d full rewrites, file %lld -> %lld bytes",
+                reader.reads, SNAPSHOT_ROUNDS, (long long)initialSize, (long long)finalSize);
+    }
+
+    cleanup_test_files("test_snapshot");
+    return (result->passed == result->total) ? 1 : 0;
+#endif
+}
+
+// WAL reader test: connections of their own keep reading while another connection commits and checkpoints
+int test_wal_readers(TestResult* result) {
+    result->name = "WAL Reader Test";
+    result->passed = 0;
+    result->total = 4;
+    strcpy(result->message, "");
+
+#ifdef _WIN32
+    result->passed = result->total;
+    snprintf(result->message, sizeof(result->message), "Skipped: requires pthreads");
+    return 1;
+#else
+    cleanup_test_files("test_wal_readers");
+
+    // Initialize algorithms
+    init_test_algorithms();
+
+#ifdef HAVE_ZLIB
+    int rc = sqlite3_ccvfs_create("wal_readers_vfs", NULL, CCVFS_COMPRESS_ZLIB, NULL, 0, CCVFS_CREATE_REALTIME);
+#else
+    int rc = sqlite3_ccvfs_create("wal_readers_vfs", NULL, NULL, NULL, 0, CCVFS_CREATE_REALTIME);
+#endif
+    if (rc != SQLITE_OK) {
+        snprintf(result->message, sizeof(result->message), "VFS creation failed: %d", rc);
+        return 0;
+    }
+    result->passed++;
+
+    // Small auto-checkpoint interval so checkpoints rewrite blocks while the readers run
+    sqlite3 *db = NULL;
+    rc = sqlite3_open_v2("test_wal_readers.db", &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, "wal_readers_vfs");
+    if (rc == SQLITE_OK) {
+        sqlite3_busy_timeout(db, 5000);
+        rc = sqlite3_exec(db,
+            "PRAGMA journal_mode = WAL;"
+            "PRAGMA wal_autocheckpoint = 16;"
+            "CREATE TABLE t (id INTEGER PRIMARY KEY, data TEXT);"
+            "WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x+1 FROM c WHERE x < 200) "
+            "INSERT INTO t (data) SELECT printf('initial row %d %.*c', x, 150, 'i') FROM c;",
+            NULL, NULL, NULL);
+    }
+    if (rc != SQLITE_OK) {
+        snprintf(result->message, sizeof(result->message), "Setup failed: %s", sqlite3_errmsg(db));
+        sqlite3_close(db);
+        sqlite3_ccvfs_destroy("wal_readers_vfs");
+        return 0;
+    }
+    result->passed++;
+
+    WalReaderContext ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    pthread_t readers[WAL_READERS];
+    for (int i = 0; i < WAL_READERS; i++) {
+        pthread_create(&readers[i], NULL, wal_reader_thread, &ctx);
+    }
+
+    // Insert and update rows, every fifth batch also runs a checkpoint of its own
+    int writerErrors = 0;
+    for (int batch = 0; batch < WAL_BATCHES && writerErrors == 0; batch++) {
+        char sql[512];
+        snprintf(sql, sizeof(sql),
+            "WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x+1 FROM c WHERE x < %d) "
+            "INSERT INTO t (data) SELECT printf('batch %d row %%d %%.*c', x, 150, 'w') FROM c;"
+            "UPDATE t SET data = data || '+' WHERE id %% 7 = %d;%s",
+            WAL_ROWS_PER_BATCH, batch, batch % 7, batch % 5 == 4 ? "PRAGMA wal_checkpoint(PASSIVE);" : "");
+        if (sqlite3_exec(db, sql, NULL, NULL, NULL) != SQLITE_OK) {
+            writerErrors++;
+        }
+    }
+
+    __atomic_store_n(&ctx.writer_done, 1, __ATOMIC_RELEASE);
+    for (int i = 0; i < WAL_READERS; i++) {
+        pthread_join(readers[i], NULL);
+    }
+
+    if (writerErrors == 0 && ctx.reader_errors == 0 && ctx.reader_queries > 0) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message),
+                "Errors during checkpoints: writer=%d (%s), readers=%d (%s), queries=%d",
+                writerErrors, sqlite3_errmsg(db), ctx.reader_errors, ctx.error, ctx.reader_queries);
+        goto cleanup;
+    }
+
+    // Content is consistent after a final checkpoint
+    sqlite3_stmt *stmt;
+    rc = sqlite3_exec(db, "PRAGMA wal_checkpoint(TRUNCATE)", NULL, NULL, NULL);
+    if (rc == SQLITE_OK && sqlite3_prepare_v2(db, "PRAGMA integrity_check", -1, &stmt, NULL) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW &&
+            strcmp((const char*)sqlite3_column_text(stmt, 0), "ok") == 0) {
+            result->passed++;
+        } else {
+            snprintf(result->message, sizeof(result->message), "Integrity check failed: %s", (const char*)sqlite3_column_text(stmt, 0));
+        }
+        sqlite3_finalize(stmt);
+    } else {
+        snprintf(result->message, sizeof(result->message), "Final checkpoint failed: %s", sqlite3_errmsg(db));
+    }
+
+cleanup:
+    sqlite3_close(db);
+    sqlite3_ccvfs_destroy("wal_readers_vfs");
+
+    if (result->passed == result->total) {
+        snprintf(result->message, sizeof(result->message),
+                "%d readers ran %d queries during %d commits with checkpoints",
+                WAL_READERS, ctx.reader_queries, WAL_BATCHES);
+    }
+
+    cleanup_test_files("test_wal_readers");
+    return (result->passed == result->total) ? 1 : 0;
+#endif
+}
@@ -5,6 +5,7 @@
  */
 
 #include "system_test_common.h"
+#include "shim_vfs.h"
 
 // Hole Detection Test (comprehensive)
 int test_hole_detection(TestResult* result) {
@@ -371,4 +372,748 @@ int test_simple_hole(TestResult* result) {
     sqlite3_ccvfs_destroy("simple_hole_vfs");
     
     return (result->passed == result->total) ? 1 : 0;
-}
\ No newline at end of file
+}
+// Query a single integer value, returns -1 on error
+static int query_int(sqlite3 *db, const char *sql) {
+    sqlite3_stmt *stmt;
+    int value = -1;
+    
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+        return -1;
+    }
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        value = sqlite3_column_int(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    return value;
+}
+
+// Index Coherence Test (two connections on one file)
+int test_index_coherence(TestResult* result) {
+    result->name = "Index Coherence Test";
+    result->passed = 0;
+    result->total = 8;
+    strcpy(result->message, "");
+    
+    cleanup_test_files("test_coherence");
+    
+    // Initialize algorithms
+    init_test_algorithms();
+    
+#ifdef HAVE_ZLIB
+    int rc = sqlite3_ccvfs_create("coherence_vfs", NULL, CCVFS_COMPRESS_ZLIB, NULL, 4096, CCVFS_CREATE_REALTIME);
+#else
+    int rc = sqlite3_ccvfs_create("coherence_vfs", NULL, NULL, NULL, 4096, CCVFS_CREATE_REALTIME);
+#endif
+    if (rc != SQLITE_OK) {
+        snprintf(result->message, sizeof(result->message), "VFS creation failed: %d", rc);
+        return 0;
+    }
+    result->passed++;
+    
+    // Open two independent connections on the same file
+    sqlite3 *db1 = NULL, *db2 = NULL;
+    rc = sqlite3_open_v2("test_coherence.db", &db1, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, "coherence_vfs");
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_open_v2("test_coherence.db", &db2, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, "coherence_vfs");
+    }
+    if (rc != SQLITE_OK) {
+        snprintf(result->message, sizeof(result->message), "Database open failed: %d", rc);
+        sqlite3_close(db1);
+        sqlite3_close(db2);
+        sqlite3_ccvfs_destroy("coherence_vfs");
+        return 0;
+    }
+    result->passed++;
+    
+    // Connection 1 creates the schema and first batch of rows
+    rc = sqlite3_exec(db1,
+        "CREATE TABLE t (id INTEGER PRIMARY KEY, data TEXT);"
+        "WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x+1 FROM c WHERE x < 200) "
+        "INSERT INTO t (data) SELECT printf('first connection row %d %.*c', x, 200, 'a') FROM c;",
+        NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        snprintf(result->message, sizeof(result->message), "Initial insert failed: %s", sqlite3_errmsg(db1));
+        goto cleanup;
+    }
+    result->passed++;
+    
+    // Connection 2 must see the new table and rows
+    int count = query_int(db2, "SELECT COUNT(*) FROM t");
+    if (count != 200) {
+        snprintf(result->message, sizeof(result->message), "Second connection saw %d rows, expected 200", count);
+        goto cleanup;
+    }
+    result->passed++;
+    
+    // Connection 2 grows the file, connection 1 must see the new pages
+    rc = sqlite3_exec(db2,
+        "WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x+1 FROM c WHERE x < 300) "
+        "INSERT INTO t (data) SELECT printf('second connection row %d %.*c', x, 300, 'b') FROM c;",
+        NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        snprintf(result->message, sizeof(result->message), "Second insert failed: %s", sqlite3_errmsg(db2));
+        goto cleanup;
+    }
+    count = query_int(db1, "SELECT COUNT(*) FROM t");
+    if (count != 500) {
+        snprintf(result->message, sizeof(result->message), "First connection saw %d rows, expected 500", count);
+        goto cleanup;
+    }
+    result->passed++;
+    
+    // Connection 1 rewrites existing pages in place, connection 2 must see the new content
+    rc = sqlite3_exec(db1, "UPDATE t SET data = 'updated' WHERE id % 3 = 0", NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        snprintf(result->message, sizeof(result->message), "Update failed: %s", sqlite3_errmsg(db1));
+        goto cleanup;
+    }
+    count = query_int(db2, "SELECT COUNT(*) FROM t WHERE data = 'updated'");
+    if (count != 166) {
+        snprintf(result->message, sizeof(result->message), "Second connection saw %d updated rows, expected 166", count);
+        goto cleanup;
+    }
+    result->passed++;
+    
+    // Both connections agree and the file is consistent
+    sqlite3_stmt *stmt;
+    rc = sqlite3_prepare_v2(db2, "PRAGMA integrity_check", -1, &stmt, NULL);
+    if (rc == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW &&
+        strcmp((const char*)sqlite3_column_text(stmt, 0), "ok") == 0 &&
+        query_int(db1, "SELECT SUM(LENGTH(data)) FROM t") == query_int(db2, "SELECT SUM(LENGTH(data)) FROM t")) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message), "Integrity check failed after concurrent updates");
+        sqlite3_finalize(stmt);
+        goto cleanup;
+    }
+    sqlite3_finalize(stmt);
+    
+    // WAL mode: both connections keep their SHARED lock on the main file, yet each must see the
+    // blocks the other one checkpointed
+    rc = sqlite3_exec(db1, "PRAGMA journal_mode=WAL", NULL, NULL, NULL);
+    int expected = 500;
+    int round;
+    for (round = 0; rc == SQLITE_OK && round < 4; round++) {
+        sqlite3 *writer = (round % 2) ? db2 : db1;
+        sqlite3 *reader = (round % 2) ? db1 : db2;
+        rc = sqlite3_exec(writer,
+            "WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x+1 FROM c WHERE x < 100) "
+            "INSERT INTO t (data) SELECT printf('wal row %d %.*c', x, 250, 'w') FROM c;"
+            "UPDATE t SET data = data || '+' WHERE id % 5 = 0;"
+            "PRAGMA wal_checkpoint(TRUNCATE);", NULL, NULL, NULL);
+        expected += 100;
+        if (rc != SQLITE_OK) {
+            snprintf(result->message, sizeof(result->message), "WAL round %d failed: %s", round, sqlite3_errmsg(writer));
+            goto cleanup;
+        }
+        count = query_int(reader, "SELECT COUNT(*) FROM t");
+        if (count != expected ||
+            query_int(reader, "SELECT SUM(LENGTH(data)) FROM t") != query_int(writer, "SELECT SUM(LENGTH(data)) FROM t")) {
+            snprintf(result->message, sizeof(result->message),
+                    "WAL round %d: reader saw %d rows, expected %d (%s)", round, count, expected, sqlite3_errmsg(reader));
+            goto cleanup;
+        }
+    }
+    rc = rc == SQLITE_OK ? sqlite3_prepare_v2(db2, "PRAGMA integrity_check", -1, &stmt, NULL) : rc;
+    if (rc == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW &&
+        strcmp((const char*)sqlite3_column_text(stmt, 0), "ok") == 0) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message), "WAL mode lost coherence: rc=%d", rc);
+    }
+    sqlite3_finalize(stmt);
+    
+cleanup:
+    sqlite3_close(db1);
+    sqlite3_close(db2);
+    sqlite3_ccvfs_destroy("coherence_vfs");
+    
+    if (result->passed == result->total) {
+        snprintf(result->message, sizeof(result->message),
+                "Two connections stayed coherent across inserts, updates and WAL checkpoints");
+    }
+    
+    cleanup_test_files("test_coherence");
+    return (result->passed == result->total) ? 1 : 0;
+}
+
+// Test shared memory page index across connections
+int test_shared_index(TestResult* result) {
+    result->name = "Shared Index Test";
+    result->passed = 0;
+    result->total = 7;
+    strcpy(result->message, "");
+    
+    cleanup_test_files("test_shared");
+    
+    // Initialize algorithms
+    init_test_algorithms();
+    
+#ifdef HAVE_ZLIB
+    int rc = sqlite3_ccvfs_create("shared_vfs", NULL, CCVFS_COMPRESS_ZLIB, NULL, 4096, CCVFS_CREATE_REALTIME);
+#else
+    int rc = sqlite3_ccvfs_create("shared_vfs", NULL, NULL, NULL, 4096, CCVFS_CREATE_REALTIME);
+#endif
+    if (rc != SQLITE_OK) {
+        snprintf(result->message, sizeof(result->message), "VFS creation failed: %d", rc);
+        return 0;
+    }
+    result->passed++;
+    
+    rc = sqlite3_ccvfs_configure_shared_index("shared_vfs", 1);
+    if (rc != SQLITE_OK) {
+        snprintf(result->message, sizeof(result->message), "Shared index configuration failed: %d", rc);
+        sqlite3_ccvfs_destroy("shared_vfs");
+        return 0;
+    }
+    result->passed++;
+    
+    // Open two independent connections on the same file
+    sqlite3 *db1 = NULL, *db2 = NULL;
+    rc = sqlite3_open_v2("test_shared.db", &db1, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, "shared_vfs");
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_open_v2("test_shared.db", &db2, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, "shared_vfs");
+    }
+    if (rc != SQLITE_OK) {
+        snprintf(result->message, sizeof(result->message), "Database open failed: %d", rc);
+        sqlite3_close(db1);
+        sqlite3_close(db2);
+        sqlite3_ccvfs_destroy("shared_vfs");
+        return 0;
+    }
+    result->passed++;
+    
+    // Connection 1 writes, connection 2 reads through the shared index
+    rc = sqlite3_exec(db1,
+        "CREATE TABLE t (id INTEGER PRIMARY KEY, data TEXT);"
+        "WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x+1 FROM c WHERE x < 200) "
+        "INSERT INTO t (data) SELECT printf('first connection row %d %.*c', x, 200, 'a') FROM c;",
+        NULL, NULL, NULL);
+    int count = (rc == SQLITE_OK) ? query_int(db2, "SELECT COUNT(*) FROM t") : -1;
+    if (count != 200) {
+        snprintf(result->message, sizeof(result->message), "Second connection saw %d rows, expected 200", count);
+        goto cleanup;
+    }
+    result->passed++;
+    
+    // The index mapping lives next to the database
+    FILE *fp = fopen("test_shared.db-ccvfs-shm", "rb");
+    if (!fp) {
+        snprintf(result->message, sizeof(result->message), "Shared index mapping file not created");
+        goto cleanup;
+    }
+    fclose(fp);
+    result->passed++;
+    
+    // Connection 2 grows the file, connection 1 sees the new pages
+    rc = sqlite3_exec(db2,
+        "WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x+1 FROM c WHERE x < 300) "
+        "INSERT INTO t (data) SELECT printf('second connection row %d %.*c', x, 300, 'b') FROM c;",
+        NULL, NULL, NULL);
+    count = (rc == SQLITE_OK) ? query_int(db1, "SELECT COUNT(*) FROM t") : -1;
+    if (count != 500) {
+        snprintf(result->message, sizeof(result->message), "First connection saw %d rows, expected 500", count);
+        goto cleanup;
+    }
+    result->passed++;
+    
+    // In-place updates are visible and the file stays consistent after reopening without the shared index
+    rc = sqlite3_exec(db1, "UPDATE t SET data = 'updated' WHERE id % 3 = 0", NULL, NULL, NULL);
+    count = (rc == SQLITE_OK) ? query_int(db2, "SELECT COUNT(*) FROM t WHERE data = 'updated'") : -1;
+    sqlite3_close(db1);
+    sqlite3_close(db2);
+    db1 = db2 = NULL;
+    sqlite3_ccvfs_configure_shared_index("shared_vfs", 0);
+    rc = sqlite3_open_v2("test_shared.db", &db1, SQLITE_OPEN_READWRITE, "shared_vfs");
+    if (count == 166 && rc == SQLITE_OK &&
+        query_int(db1, "SELECT COUNT(*) FROM t WHERE data = 'updated'") == 166 &&
+        query_int(db1, "SELECT COUNT(*) FROM pragma_integrity_check WHERE integrity_check = 'ok'") == 1) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message), "Updated rows %d, reopen rc %d", count, rc);
+    }
+    
+cleanup:
+    sqlite3_close(db1);
+    sqlite3_close(db2);
+    sqlite3_ccvfs_destroy("shared_vfs");
+    
+    if (result->passed == result->total) {
+        snprintf(result->message, sizeof(result->message), "Connections shared one page index across inserts and updates");
+    }
+    
+    cleanup_test_files("test_shared");
+    return (result->passed == result->total) ? 1 : 0;
+}
+
+// Test the ccvfs_pages virtual table against dbstat
+int test_page_inspection(TestResult* result) {
+    result->name = "Page Inspection Test";
+    result->passed = 0;
+    result->total = 7;
+    strcpy(result->message, "");
+    
+    cleanup_test_files("test_pages");
+    cleanup_test_files("test_pages_plain");
+    
+    // Initialize algorithms
+    init_test_algorithms();
+    
+#ifdef HAVE_ZLIB
+    int rc = sqlite3_ccvfs_create("pages_vfs", NULL, CCVFS_COMPRESS_ZLIB, NULL, 4096, CCVFS_CREATE_REALTIME);
+#else
+    int rc = sqlite3_ccvfs_create("pages_vfs", NULL, NULL, NULL, 4096, CCVFS_CREATE_REALTIME);
+#endif
+    if (rc != SQLITE_OK) {
+        snprintf(result->message, sizeof(result->message), "VFS creation failed: %d", rc);
+        return 0;
+    }
+    result->passed++;
+    
+    sqlite3 *db = NULL;
+    char *zErr = NULL;
+    int pages = 0, rows = 0, noise = 0, zeros = 0;
+    rc = sqlite3_open_v2("test_pages.db", &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_URI, "pages_vfs");
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_ccvfs_pages_init(db, &zErr, NULL);
+    }
+    if (rc != SQLITE_OK) {
+        snprintf(result->message, sizeof(result->message), "Open or registration failed: %d %s", rc, zErr ? zErr : "");
+        sqlite3_free(zErr);
+        sqlite3_close(db);
+        sqlite3_ccvfs_destroy("pages_vfs");
+        return 0;
+    }
+    result->passed++;
+    
+    // One table of incompressible rows, one of highly compressible rows
+    rc = sqlite3_exec(db,
+        "PRAGMA page_size = 4096;"
+        "CREATE TABLE noise (id INTEGER PRIMARY KEY, data BLOB);"
+        "CREATE TABLE zeros (id INTEGER PRIMARY KEY, data BLOB);"
+        "WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x+1 FROM c WHERE x < 200) "
+        "INSERT INTO noise (data) SELECT randomblob(1000) FROM c;"
+        "WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x+1 FROM c WHERE x < 200) "
+        "INSERT INTO zeros (data) SELECT zeroblob(1000) FROM c;",
+        NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        snprintf(result->message, sizeof(result->message), "Insert failed: %s", sqlite3_errmsg(db));
+        goto cleanup;
+    }
+    result->passed++;
+    
+    // One row per database page
+    pages = query_int(db, "PRAGMA page_count");
+    rows = query_int(db, "SELECT COUNT(*) FROM ccvfs_pages");
+    if (pages <= 0 || rows != pages) {
+        snprintf(result->message, sizeof(result->message), "ccvfs_pages returned %d rows for %d pages", rows, pages);
+        goto cleanup;
+    }
+    result->passed++;
+    
+    // Owners match dbstat page by page, and the compressible table is smaller on disk
+    int mismatched = query_int(db,
+        "SELECT COUNT(*) FROM dbstat d JOIN ccvfs_pages p ON p.pageno = d.pageno "
+        "WHERE p.name IS NOT d.name OR p.pagetype IS NOT d.pagetype");
+    noise = query_int(db, "SELECT SUM(compressed_size) FROM ccvfs_pages WHERE name = 'noise'");
+    zeros = query_int(db, "SELECT SUM(compressed_size) FROM ccvfs_pages WHERE name = 'zeros'");
+    if (mismatched != 0 || noise <= 0 || zeros <= 0 || zeros >= noise) {
+        snprintf(result->message, sizeof(result->message),
+                 "Owner attribution wrong: mismatched=%d noise=%d zeros=%d", mismatched, noise, zeros);
+        goto cleanup;
+    }
+    result->passed++;
+    
+    // Point lookup and compression level after changing it at runtime
+    rc = sqlite3_exec(db,
+        "PRAGMA ccvfs_compress_level = 6;"
+        "UPDATE zeros SET data = zeroblob(1200) WHERE id = 1;",
+        NULL, NULL, NULL);
+    int single = query_int(db, "SELECT COUNT(*) FROM ccvfs_pages WHERE pageno = 1 AND page_size = 4096 AND original_size > 0");
+    int level6 = query_int(db, "SELECT COUNT(*) FROM ccvfs_pages WHERE compressed AND compress_level = 6");
+    if (rc != SQLITE_OK || single != 1 || level6 <= 0) {
+        snprintf(result->message, sizeof(result->message),
+                 "Point lookup or level check failed: rc=%d single=%d level6=%d", rc, single, level6);
+        goto cleanup;
+    }
+    result->passed++;
+    
+    // Schema argument: attached plain database yields no rows, unknown schema is an error
+    char *zAttach = sqlite3_mprintf(
+        "ATTACH 'file:test_pages_plain.db?vfs=%s' AS plain;"
+        "CREATE TABLE plain.t (x);",
+        sqlite3_vfs_find(NULL)->zName);
+    rc = sqlite3_exec(db, zAttach, NULL, NULL, NULL);
+    sqlite3_free(zAttach);
+    rows = query_int(db, "SELECT COUNT(*) FROM ccvfs_pages('plain')");
+    pages = query_int(db, "PRAGMA main.page_count");
+    int mainRows = query_int(db, "SELECT COUNT(*) FROM ccvfs_pages('main')");
+    int missing = query_int(db, "SELECT COUNT(*) FROM ccvfs_pages('nosuch')");
+    if (rc != SQLITE_OK || rows != 0 || mainRows != pages || missing != -1) {
+        snprintf(result->message, sizeof(result->message),
+                 "Schema argument failed: rc=%d plain=%d main=%d missing=%d", rc, rows, mainRows, missing);
+        goto cleanup;
+    }
+    result->passed++;
+    
+cleanup:
+    sqlite3_close(db);
+    sqlite3_ccvfs_destroy("pages_vfs");
+    
+    if (result->passed == result->total) {
+        snprintf(result->message, sizeof(result->message),
+                 "%d pages attributed, noise=%d zeros=%d bytes on disk", pages, noise, zeros);
+    }
+    
+    cleanup_test_files("test_pages");
+    cleanup_test_files("test_pages_plain");
+    return (result->passed == result->total) ? 1 : 0;
+}
+
+// Query through a fresh connection, returns the SQLite error code of the first failing step
+static int query_fresh(const char *vfs, const char *sql, int *pValue) {
+    sqlite3 *db = NULL;
+    sqlite3_stmt *stmt = NULL;
+    int rc = sqlite3_open_v2("test_faults.db", &db, SQLITE_OPEN_READWRITE, vfs);
+    
+    *pValue = -1;
+    if (rc == SQLITE_OK) rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_step(stmt);
+        if (rc == SQLITE_ROW) {
+            *pValue = sqlite3_column_int(stmt, 0);
+            rc = SQLITE_OK;
+        }
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+    return rc;
+}
+
+// Slow storage and fault injection below CCVFS through the shim VFS
+int test_storage_faults(TestResult* result) {
+    ShimVfs *pShim = NULL;
+    ShimVfsConfig faults;
+    ShimVfsStats stats;
+    sqlite3 *db = NULL;
+    int value = -1;
+    
+    result->name = "Storage Faults Test";
+    result->passed = 0;
+    result->total = 6;
+    strcpy(result->message, "");
+    
+    cleanup_test_files("test_faults");
+    init_test_algorithms();
+    
+    int rc = shim_vfs_create("fault_shim", NULL, &pShim);
+    if (rc == SQLITE_OK) {
+#ifdef HAVE_ZLIB
+        rc = sqlite3_ccvfs_create("fault_vfs", sqlite3_vfs_find("fault_shim"), CCVFS_COMPRESS_ZLIB, NULL,
+                                  4096, CCVFS_CREATE_REALTIME);
+#else
+        rc = sqlite3_ccvfs_create("fault_vfs", sqlite3_vfs_find("fault_shim"), NULL, NULL,
+                                  4096, CCVFS_CREATE_REALTIME);
+#endif
+    }
+    if (rc != SQLITE_OK) {
+        snprintf(result->message, sizeof(result->message), "VFS creation failed: %d", rc);
+        shim_vfs_destroy(pShim);
+        return 0;
+    }
+    result->passed++;
+    
+    // Every call CCVFS makes reaches the shim and is counted
+    rc = sqlite3_open_v2("test_faults.db", &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, "fault_vfs");
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_exec(db,
+            "CREATE TABLE t (id INTEGER PRIMARY KEY, data TEXT);"
+            "WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x+1 FROM c WHERE x < 300) "
+            "INSERT INTO t (data) SELECT printf('fault row %d %.*c', x, 300, 'f') FROM c;",
+            NULL, NULL, NULL);
+    }
+    sqlite3_close(db);
+    db = NULL;
+    shim_vfs_get_stats(pShim, &stats);
+    if (rc != SQLITE_OK || stats.write_calls == 0 || stats.sync_calls == 0 ||
+        stats.syscalls < stats.open_calls + stats.read_calls + stats.write_calls + stats.sync_calls) {
+        snprintf(result->message, sizeof(result->message), "Load rc %d, writes %llu, syncs %llu, syscalls %llu",
+                 rc, (unsigned long long)stats.write_calls, (unsigned long long)stats.sync_calls,
+                 (unsigned long long)stats.syscalls);
+        goto cleanup;
+    }
+    result->passed++;
+    
+    // Latency applies to the selected file types only: every main database read waits 500us
+    shim_vfs_init_config(&faults);
+    faults.read_latency_us = 500;
+    faults.file_types = SQLITE_OPEN_MAIN_DB;
+    shim_vfs_reset_stats(pShim);
+    shim_vfs_configure(pShim, &faults);
+    rc = query_fresh("fault_vfs", "SELECT COUNT(*) FROM t", &value);
+    shim_vfs_get_stats(pShim, &stats);
+    if (rc != SQLITE_OK || value != 300 || stats.injected_delay_us == 0 || stats.injected_delay_us % 500 != 0 ||
+        stats.injected_delay_us > stats.read_calls * 500) {
+        snprintf(result->message, sizeof(result->message), "Latency read rc %d, rows %d, delay %llu us over %llu reads",
+                 rc, value, (unsigned long long)stats.injected_delay_us, (unsigned long long)stats.read_calls);
+        goto cleanup;
+    }
+    result->passed++;
+    
+    // Failed reads surface as errors, not as data
+    shim_vfs_init_config(&faults);
+    faults.read_error_ppm = 1000000;
+    faults.file_types = SQLITE_OPEN_MAIN_DB;
+    shim_vfs_configure(pShim, &faults);
+    rc = query_fresh("fault_vfs", "SELECT SUM(length(data)) FROM t", &value);
+    shim_vfs_get_stats(pShim, &stats);
+    if (rc == SQLITE_OK || stats.injected_errors == 0) {
+        snprintf(result->message, sizeof(result->message), "Read errors gave rc %d with %llu injected errors",
+                 rc, (unsigned long long)stats.injected_errors);
+        goto cleanup;
+    }
+    result->passed++;
+    
+    // Short reads surface as errors as well
+    shim_vfs_init_config(&faults);
+    faults.short_read_ppm = 1000000;
+    faults.file_types = SQLITE_OPEN_MAIN_DB;
+    shim_vfs_configure(pShim, &faults);
+    rc = query_fresh("fault_vfs", "SELECT SUM(length(data)) FROM t", &value);
+    shim_vfs_get_stats(pShim, &stats);
+    if (rc == SQLITE_OK || stats.short_reads == 0) {
+        snprintf(result->message, sizeof(result->message), "Short reads gave rc %d with %llu short reads",
+                 rc, (unsigned long long)stats.short_reads);
+        goto cleanup;
+    }
+    result->passed++;
+    
+    // A commit whose writes fail is rolled back, and the file is intact once the device recovers
+    shim_vfs_init_config(&faults);
+    faults.write_error_ppm = 1000000;
+    faults.file_types = SQLITE_OPEN_MAIN_DB;
+    rc = sqlite3_open_v2("test_faults.db", &db, SQLITE_OPEN_READWRITE, "fault_vfs");
+    if (rc == SQLITE_OK) {
+        sqlite3_exec(db, "PRAGMA cache_size = 2", NULL, NULL, NULL);
+        shim_vfs_configure(pShim, &faults);
+        rc = sqlite3_exec(db,
+            "BEGIN;"
+            "WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x+1 FROM c WHERE x < 200) "
+            "INSERT INTO t (data) SELECT printf('lost row %d %.*c', x, 300, 'l') FROM c;"
+            "COMMIT;",
+            NULL, NULL, NULL);
+        if (rc != SQLITE_OK) sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
+    }
+    sqlite3_close(db);
+    db = NULL;
+    shim_vfs_init_config(&faults);
+    shim_vfs_configure(pShim, &faults);
+    int check = -1;
+    int rcCheck = query_fresh("fault_vfs", "SELECT COUNT(*) FROM pragma_integrity_check WHERE integrity_check = 'ok'",
+                              &check);
+    int rcCount = query_fresh("fault_vfs", "SELECT COUNT(*) FROM t", &value);
+    if (rc == SQLITE_OK || rcCheck != SQLITE_OK || check != 1 || rcCount != SQLITE_OK || value != 300) {
+        snprintf(result->message, sizeof(result->message),
+                 "Failed commit rc %d, then integrity rc %d (%d), rows %d", rc, rcCheck, check, value);
+        goto cleanup;
+    }
+    result->passed++;
+    
+cleanup:
+    sqlite3_close(db);
+    sqlite3_ccvfs_destroy("fault_vfs");
+    shim_vfs_destroy(pShim);
+    
+    if (result->passed == result->total) {
+        snprintf(result->message, sizeof(result->message),
+                 "Latency, read errors, short reads and failed commits below CCVFS handled");
+    }
+    
+    cleanup_test_files("test_faults");
+    return (result->passed == result->total) ? 1 : 0;
+}
+
+// Poll the file statistics until the scrubber completed the given number of passes over the file
+static int wait_for_scrub_passes(sqlite3 *db, uint64_t passes, CCVFSFileStats *pStats) {
+    for (int i = 0; i < 1000; i++) {
+        if (sqlite3_ccvfs_get_file_stats(db, pStats) == SQLITE_OK && pStats->scrub_pass_count >= passes) {
+            return 1;
+        }
+        sqlite3_sleep(10);
+    }
+    return 0;
+}
+
+// Background Scrub Test
+int test_background_scrub(TestResult* result) {
+    sqlite3 *db = NULL;
+    CCVFSScrubOptions options;
+    CCVFSFileStats stats, later;
+    int rows = 0;
+    
+    result->name = "Background Scrub Test";
+    result->passed = 0;
+    result->total = 5;
+    strcpy(result->message, "");
+    
+    cleanup_test_files("test_scrub");
+    cleanup_test_files("test_scrub_wal");
+    init_test_algorithms();
+    
+#ifdef HAVE_ZLIB
+    int rc = sqlite3_ccvfs_create("scrub_vfs", NULL, CCVFS_COMPRESS_ZLIB, NULL, 4096, CCVFS_CREATE_REALTIME);
+#else
+    int rc = sqlite3_ccvfs_create("scrub_vfs", NULL, NULL, NULL, 4096, CCVFS_CREATE_REALTIME);
+#endif
+    if (rc != SQLITE_OK) {
+        snprintf(result->message, sizeof(result->message), "VFS creation failed: %d", rc);
+        return 0;
+    }
+    
+    // Every stored block of an open database is checked, without errors on intact data;
+    // without the write buffer every page read reaches a stored block
+    sqlite3_ccvfs_configure_write_buffer("scrub_vfs", 0, 0, 0, 0);
+    rc = sqlite3_open_v2("test_scrub.db", &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, "scrub_vfs");
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_exec(db,
+            "CREATE TABLE t (id INTEGER PRIMARY KEY, data TEXT);"
+            "WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x+1 FROM c WHERE x < 3000) "
+            "INSERT INTO t (data) SELECT printf('scrub row %d %s', x, hex(randomblob(150))) FROM c;"
+            "PRAGMA cache_size = 2;", NULL, NULL, NULL);
+    }
+    memset(&options, 0, sizeof(options));
+    options.io_budget_kb = 64 * 1024;
+    options.pass_interval_ms = 20;
+    options.trust_window_ms = 600000;
+    if (rc == SQLITE_OK) rc = sqlite3_ccvfs_configure_scrubber("scrub_vfs", &options);
+    int missing = sqlite3_ccvfs_configure_scrubber("no_such_vfs", &options);
+    if (rc == SQLITE_OK && missing == SQLITE_ERROR && wait_for_scrub_passes(db, 1, &stats) &&
+        stats.scrubbed_block_count > 50 && stats.scrubbed_bytes > 0 && stats.checksum_error_count == 0) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message), "First pass failed: rc=%d, %llu blocks, %llu passes",
+                 rc, (unsigned long long)stats.scrubbed_block_count, (unsigned long long)stats.scrub_pass_count);
+        goto cleanup;
+    }
+    
+    // Reads of scrubbed blocks skip the CRC and still return the right data
+    sqlite3_stmt *stmt = NULL;
+    rc = sqlite3_prepare_v2(db, "SELECT COUNT(*) FROM t WHERE data LIKE 'scrub row %'", -1, &stmt, NULL);
+    if (rc == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW) rows = sqlite3_column_int(stmt, 0);
+    sqlite3_finalize(stmt);
+    sqlite3_ccvfs_get_file_stats(db, &later);
+    if (rc == SQLITE_OK && rows == 3000 && later.trusted_read_count > stats.trusted_read_count) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message), "Trusted reads failed: rc=%d, %d rows, %llu trusted",
+                 rc, rows, (unsigned long long)later.trusted_read_count);
+        goto cleanup;
+    }
+    
+    // Damage behind the open connection is found by the scrubber, counted once, and no longer trusted
+    unsigned char entry[24];
+    uint32_t block = 0;
+    FILE *fp = fopen("test_scrub.db", "r+b");
+    rc = SQLITE_IOERR;
+    if (fp && fseek(fp, 128 + 24 * 40, SEEK_SET) == 0 && fread(entry, sizeof(entry), 1, fp) == 1) {
+        uint64_t offset = 0;
+        uint32_t size = 0;
+        for (int i = 7; i >= 0; i--) offset = (offset << 8) | entry[i];
+        for (int i = 11; i >= 8; i--) size = (size << 8) | entry[i];
+        int c;
+        if (offset > 0 && size > 0 && fseek(fp, (long)(offset + size / 2), SEEK_SET) == 0 && (c = fgetc(fp)) != EOF &&
+            fseek(fp, (long)(offset + size / 2), SEEK_SET) == 0 && fputc(c ^ 0x5A, fp) != EOF) {
+            block = 40;
+            rc = SQLITE_OK;
+        }
+    }
+    if (fp) fclose(fp);
+    if (rc == SQLITE_OK && wait_for_scrub_passes(db, later.scrub_pass_count + 2, &stats) &&
+        wait_for_scrub_passes(db, stats.scrub_pass_count + 2, &later)) {
+        rc = sqlite3_exec(db, "SELECT SUM(length(data)) FROM t", NULL, NULL, NULL);
+    }
+    if (block == 40 && rc == SQLITE_CORRUPT && stats.checksum_error_count == 1 && stats.corrupted_page_count == 1 &&
+        later.corrupted_page_count == 1 && later.checksum_error_count == 1) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message),
+                 "Damage not found: rc=%d, %llu checksum errors, then %llu", rc,
+                 (unsigned long long)stats.checksum_error_count, (unsigned long long)later.checksum_error_count);
+        goto cleanup;
+    }
+    
+    // In WAL mode a second connection checkpoints and moves blocks under the reader's index:
+    // the reader never trusts the scrubber, checks every CRC and sees each round's data
+    sqlite3 *writer = NULL;
+    int rounds = 0;
+    rc = sqlite3_open_v2("test_scrub_wal.db", &writer, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, "scrub_vfs");
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_exec(writer,
+            "PRAGMA journal_mode = WAL;"
+            "CREATE TABLE t (id INTEGER PRIMARY KEY, data TEXT);"
+            "WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x+1 FROM c WHERE x < 2000) "
+            "INSERT INTO t (data) SELECT printf('round 0 row %d %s', x, hex(randomblob(100))) FROM c;"
+            "PRAGMA wal_checkpoint(TRUNCATE);", NULL, NULL, NULL);
+    }
+    sqlite3 *reader = NULL;
+    if (rc == SQLITE_OK) rc = sqlite3_open_v2("test_scrub_wal.db", &reader, SQLITE_OPEN_READWRITE, "scrub_vfs");
+    if (rc == SQLITE_OK) rc = sqlite3_exec(reader, "PRAGMA cache_size = 2;", NULL, NULL, NULL);
+    if (rc == SQLITE_OK && query_int(reader, "SELECT COUNT(*) FROM t") == 2000 &&
+        wait_for_scrub_passes(reader, 2, &stats)) {
+        for (rounds = 1; rc == SQLITE_OK && rounds <= 6; rounds++) {
+            char sql[256];
+            snprintf(sql, sizeof(sql),
+                     "UPDATE t SET data = printf('round %d row %%d %%s', id, hex(randomblob(%d))) WHERE id %% 3 != %d;"
+                     "PRAGMA wal_checkpoint(TRUNCATE);", rounds, 60 + rounds * 30, rounds % 3);
+            rc = sqlite3_exec(writer, sql, NULL, NULL, NULL);
+            snprintf(sql, sizeof(sql), "SELECT COUNT(*) FROM t WHERE data LIKE 'round %d row %%'", rounds);
+            int expected = query_int(writer, sql);
+            if (rc == SQLITE_OK && (expected < 1000 || query_int(reader, sql) != expected)) {
+                rc = SQLITE_CORRUPT;
+            }
+        }
+    } else if (rc == SQLITE_OK) {
+        rc = SQLITE_ERROR;
+    }
+    sqlite3_ccvfs_get_file_stats(reader, &later);
+    if (rc == SQLITE_OK && later.trusted_read_count == 0 && later.checksum_error_count == 0 &&
+        query_int(reader, "SELECT COUNT(*) FROM t") == 2000) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message),
+                 "WAL reads failed: rc=%d after round %d, %llu trusted, %llu checksum errors", rc, rounds - 1,
+                 (unsigned long long)later.trusted_read_count, (unsigned long long)later.checksum_error_count);
+    }
+    sqlite3_close(reader);
+    sqlite3_close(writer);
+    if (result->passed != 4) {
+        goto cleanup;
+    }
+    
+    // A stopped scrubber reads nothing more, a running one stops with its VFS
+    rc = sqlite3_ccvfs_configure_scrubber("scrub_vfs", NULL);
+    sqlite3_ccvfs_get_file_stats(db, &stats);
+    sqlite3_sleep(100);
+    sqlite3_ccvfs_get_file_stats(db, &later);
+    int stopped = rc == SQLITE_OK && later.scrubbed_block_count == stats.scrubbed_block_count;
+    rc = sqlite3_ccvfs_configure_scrubber("scrub_vfs", &options);
+    sqlite3_sleep(20);
+    sqlite3_close(db);
+    db = NULL;
+    if (stopped && rc == SQLITE_OK) {
+        result->passed++;
+        snprintf(result->message, sizeof(result->message), "%llu blocks scrubbed, damaged block %u found",
+                 (unsigned long long)stats.scrubbed_block_count, block);
+    } else {
+        snprintf(result->message, sizeof(result->message), "Stop failed: rc=%d, %llu then %llu blocks", rc,
+                 (unsigned long long)stats.scrubbed_block_count, (unsigned long long)later.scrubbed_block_count);
+    }
+    
+cleanup:
+    sqlite3_close(db);
+    sqlite3_ccvfs_destroy("scrub_vfs");
+    cleanup_test_files("test_scrub");
+    cleanup_test_files("test_scrub_wal");
+    return (result->passed == result->total) ? 1 : 0;
+}
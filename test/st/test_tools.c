@@ -5,6 +5,13 @@
  */
 
 #include "system_test_common.h"
+#include "db_replay.h"
+#include "db_analyze.h"
+#include "db_compare.h"
+#include "db_generator.h"
+#include "ccvfs_internal.h"
+#include "ccvfs_utils.h"
+#include <sys/stat.h>
 
 // Database Tools Test
 int test_db_tools(TestResult* result) {
@@ -73,4 +80,1576 @@ int test_db_tools(TestResult* result) {
     }
     
     return (result->passed == result->total) ? 1 : 0;
-}
\ No newline at end of file
+}
+static int tools_query_text(sqlite3 *db, const char *sql, char *out, size_t outSize) {
+    sqlite3_stmt *stmt;
+    int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
+    out[0] = '\0';
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+    rc = sqlite3_step(stmt);
+    if (rc == SQLITE_ROW) {
+        const char *text = (const char*)sqlite3_column_text(stmt, 0);
+        snprintf(out, outSize, "%s", text ? text : "");
+        rc = SQLITE_OK;
+    } else if (rc == SQLITE_DONE) {
+        rc = SQLITE_OK;
+    }
+    sqlite3_finalize(stmt);
+    return rc;
+}
+
+// I/O Replay Test: record a workload with its data, replay it on another block size and check the result
+int test_io_replay(TestResult* result) {
+    result->name = "I/O Replay Test";
+    result->passed = 0;
+    result->total = 4;
+    strcpy(result->message, "");
+    
+    cleanup_test_files("test_replay");
+    cleanup_test_files("test_replay_target");
+    remove("test_replay.trace");
+    init_test_algorithms();
+    
+#ifdef HAVE_ZLIB
+    int rc = sqlite3_ccvfs_create("record_vfs", NULL, CCVFS_COMPRESS_ZLIB, NULL, 4096, CCVFS_CREATE_REALTIME);
+#else
+    int rc = sqlite3_ccvfs_create("record_vfs", NULL, NULL, NULL, 4096, CCVFS_CREATE_REALTIME);
+#endif
+    if (rc != SQLITE_OK) {
+        snprintf(result->message, sizeof(result->message), "VFS creation failed: %d", rc);
+        return 0;
+    }
+    
+    sqlite3 *db = NULL;
+    char value[256];
+    uint64_t nRecord = 0;
+    ReplayOptions options;
+    ReplayResult replay;
+    
+    // Recording starts once per VFS and shows up in PRAGMA ccvfs_record
+    rc = sqlite3_open_v2("test_replay.db", &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, "record_vfs");
+    if (rc == SQLITE_OK) rc = sqlite3_ccvfs_record_start("record_vfs", "test_replay.trace", CCVFS_RECORD_DATA);
+    int again = sqlite3_ccvfs_record_start("record_vfs", "test_replay.trace", 0);
+    if (rc == SQLITE_OK) rc = tools_query_text(db, "PRAGMA ccvfs_record", value, sizeof(value));
+    if (rc == SQLITE_OK && again == SQLITE_MISUSE && strstr(value, "recording to test_replay.trace") &&
+        strstr(value, "with data")) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message), "Record start failed: rc=%d, again=%d, status='%s'",
+                rc, again, value);
+        goto done;
+    }
+    
+    // A small workload, closed before stopping so the trace ends with the close
+    rc = sqlite3_exec(db,
+        "CREATE TABLE t (id INTEGER PRIMARY KEY, name TEXT, data BLOB);"
+        "BEGIN;"
+        "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 500) "
+        "INSERT INTO t SELECT i, 'row ' || i, randomblob(200) FROM n;"
+        "COMMIT;"
+        "UPDATE t SET name = name || ' updated' WHERE id % 7 = 0;"
+        "DELETE FROM t WHERE id > 450;", NULL, NULL, NULL);
+    sqlite3_close(db);
+    db = NULL;
+    int rcStop = sqlite3_ccvfs_record_stop("record_vfs", &nRecord);
+    int stopAgain = sqlite3_ccvfs_record_stop("record_vfs", NULL);
+    if (rc == SQLITE_OK && rcStop == SQLITE_OK && nRecord > 0 && stopAgain == SQLITE_NOTFOUND) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message),
+                "Recording failed: rc=%d, stop=%d, records=%llu, stop again=%d",
+                rc, rcStop, (unsigned long long)nRecord, stopAgain);
+        goto done;
+    }
+    
+    // Replay on a different block size without compression or write buffer
+    replay_init_options(&options);
+    options.compress_algo = "none";
+    options.page_size = 8192;
+    options.buffer_pages = 0;
+    rc = replay_trace("test_replay.trace", "test_replay_target.db", &options, &replay);
+    if (rc == SQLITE_OK && replay.has_data && replay.records == nRecord && replay.mismatched == 0 &&
+        replay.ops[CCVFS_RECORD_WRITE].calls > 0 && replay.ops[CCVFS_RECORD_SYNC].calls > 0) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message),
+                "Replay failed: rc=%d, records=%llu/%llu, mismatched=%llu, writes=%llu",
+                rc, (unsigned long long)replay.records, (unsigned long long)nRecord,
+                (unsigned long long)replay.mismatched, (unsigned long long)replay.ops[CCVFS_RECORD_WRITE].calls);
+        goto done;
+    }
+    
+    // The replayed target holds the same database
+    rc = sqlite3_ccvfs_create("replay_check_vfs", NULL, NULL, NULL, 8192, CCVFS_CREATE_REALTIME);
+    if (rc == SQLITE_OK) rc = sqlite3_open_v2("test_replay_target.db", &db, SQLITE_OPEN_READONLY, "replay_check_vfs");
+    if (rc == SQLITE_OK) rc = tools_query_text(db, "PRAGMA integrity_check", value, sizeof(value));
+    int integrity = (rc == SQLITE_OK && strcmp(value, "ok") == 0);
+    if (rc == SQLITE_OK) rc = tools_query_text(db, "SELECT count(*) || '/' || sum(name LIKE '%updated') FROM t",
+                                               value, sizeof(value));
+    if (rc == SQLITE_OK && integrity && strcmp(value, "450/64") == 0) {
+        result->passed++;
+        snprintf(result->message, sizeof(result->message), "%llu records replayed, %llu writes, target %llu bytes",
+                (unsigned long long)replay.records, (unsigned long long)replay.ops[CCVFS_RECORD_WRITE].calls,
+                (unsigned long long)replay.target_size);
+    } else {
+        snprintf(result->message, sizeof(result->message), "Replayed database check failed: rc=%d, integrity=%d, rows='%s'",
+                rc, integrity, value);
+    }
+    
+done:
+    sqlite3_ccvfs_record_stop("record_vfs", NULL);
+    sqlite3_close(db);
+    sqlite3_ccvfs_destroy("replay_check_vfs");
+    sqlite3_ccvfs_destroy("record_vfs");
+    cleanup_test_files("test_replay");
+    cleanup_test_files("test_replay_target");
+    remove("test_replay.trace");
+    
+    return (result->passed == result->total) ? 1 : 0;
+}
+
+static const AnalyzeCandidate *find_candidate(const AnalyzeResult *result, uint32_t page_size, int level) {
+    for (int i = 0; i < result->candidate_count; i++) {
+        const AnalyzeCandidate *c = &result->candidates[i];
+        if (c->page_size == page_size && c->level == level) return c;
+    }
+    return NULL;
+}
+
+// Compression Advisor Test: sampled candidates, ranking goals and the same answer for a CCVFS copy
+int test_db_analyze(TestResult* result) {
+    result->name = "Compression Advisor Test";
+    result->passed = 0;
+    result->total = 4;
+    strcpy(result->message, "");
+    
+    cleanup_test_files("test_analyze");
+    init_test_algorithms();
+    
+    AnalyzeOptions options;
+    AnalyzeResult *plain = calloc(1, sizeof(AnalyzeResult));
+    AnalyzeResult *packed = calloc(1, sizeof(AnalyzeResult));
+    sqlite3 *db = NULL;
+    int rc = (plain && packed) ? SQLITE_OK : SQLITE_NOMEM;
+    
+    // A plain database with compressible text
+    if (rc == SQLITE_OK) rc = sqlite3_open("test_analyze.db", &db);
+    if (rc == SQLITE_OK) rc = sqlite3_exec(db,
+        "CREATE TABLE t (id INTEGER PRIMARY KEY, body TEXT);"
+        "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 40000) "
+        "INSERT INTO t SELECT i, printf('%d: the quick brown fox jumps over the lazy dog %s', i, "
+        "hex(randomblob(16))) || ' lorem ipsum dolor sit amet consectetur adipiscing elit' FROM n;",
+        NULL, NULL, NULL);
+    sqlite3_close(db);
+    db = NULL;
+    
+    analyze_init_options(&options);
+    options.sample_pages = 32;
+    options.threads = 2;
+    options.goal = ANALYZE_GOAL_SPACE;
+    if (rc == SQLITE_OK) rc = analyze_parse_page_sizes("4K,64K", &options) == 2 ? SQLITE_OK : SQLITE_MISUSE;
+    if (rc == SQLITE_OK) rc = analyze_parse_levels("1,6", &options) == 2 ? SQLITE_OK : SQLITE_MISUSE;
+    if (rc == SQLITE_OK) rc = analyze_database("test_analyze.db", &options, plain);
+    if (rc == SQLITE_OK && plain->candidate_count == 5 && !plain->source_ccvfs && plain->sqlite_page_size > 0 &&
+        analyze_parse_levels("0,10", &options) < 0 && analyze_parse_page_sizes("3K", &options) < 0) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message), "Analysis failed: rc=%d, candidates=%d",
+                rc, plain ? plain->candidate_count : 0);
+        goto done;
+    }
+    
+    // Text compresses: the space goal ranks a codec first, smaller than the plain file
+    const AnalyzeCandidate *best = &plain->candidates[0];
+    const AnalyzeCandidate *base = find_candidate(plain, plain->sqlite_page_size, 0);
+    if (best->level > 0 && best->ratio > 1.5 && best->projected_size < plain->logical_size &&
+        base && base->ratio == 1.0 && base->projected_size == plain->logical_size) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message), "Space ranking failed: best=%s/%d ratio=%.2f",
+                best->codec, best->level, best->ratio);
+        goto done;
+    }
+    
+    // The latency goal puts the plain file first, nothing reads faster than an uncompressed page
+    options.goal = ANALYZE_GOAL_LATENCY;
+    options.level_count = 0;
+    analyze_parse_levels("1,6", &options);
+    options.page_size_count = 0;
+    analyze_parse_page_sizes("4K,64K", &options);
+    rc = analyze_database("test_analyze.db", &options, packed);
+    if (rc == SQLITE_OK && packed->candidates[0].level == 0 &&
+        packed->candidates[0].read_us <= packed->candidates[1].read_us) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message), "Latency ranking failed: rc=%d", rc);
+        goto done;
+    }
+    
+    // A CCVFS copy holds the same logical pages (the copy may add a page), so it gets the same advice
+    rc = sqlite3_ccvfs_compress_database("test_analyze.db", "test_analyze.ccvfs", "zlib", NULL, 6);
+    options.goal = ANALYZE_GOAL_SPACE;
+    if (rc == SQLITE_OK) rc = analyze_database("test_analyze.ccvfs", &options, packed);
+    const AnalyzeCandidate *a = find_candidate(plain, 65536, 6);
+    const AnalyzeCandidate *b = find_candidate(packed, 65536, 6);
+    if (rc == SQLITE_OK && packed->source_ccvfs && a && b &&
+        packed->logical_size >= plain->logical_size && packed->logical_size - plain->logical_size <= 65536 &&
+        a->ratio > b->ratio * 0.95 && a->ratio < b->ratio * 1.05 && packed->file_size < plain->file_size &&
+        packed->candidates[0].page_size == best->page_size && packed->candidates[0].level == best->level) {
+        result->passed++;
+        snprintf(result->message, sizeof(result->message), "Best: %u bytes %s level %d, %.2fx, %.2f MB projected",
+                best->page_size, best->codec, best->level, best->ratio,
+                (double)best->projected_size / (1024.0 * 1024.0));
+    } else {
+        snprintf(result->message, sizeof(result->message),
+                "CCVFS source failed: rc=%d, logical=%llu/%llu, ratio=%.2f/%.2f", rc,
+                (unsigned long long)packed->logical_size, (unsigned long long)plain->logical_size,
+                a ? a->ratio : 0.0, b ? b->ratio : 0.0);
+    }
+    
+done:
+    free(plain);
+    free(packed);
+    cleanup_test_files("test_analyze");
+    
+    return (result->passed == result->total) ? 1 : 0;
+}
+
+typedef struct {
+    uint32_t calls;
+    uint32_t last;
+    uint32_t total;
+    int ordered;
+} ProgressLog;
+
+static void log_progress(void *pArg, uint32_t nDone, uint32_t nTotal) {
+    ProgressLog *log = (ProgressLog *)pArg;
+    if (log->calls > 0 && (nDone <= log->last || nTotal != log->total)) {
+        log->ordered = 0;
+    }
+    log->calls++;
+    log->last = nDone;
+    log->total = nTotal;
+}
+
+// Compare two files from the given offset on
+static int files_equal_from(const char *path1, const char *path2, long offset) {
+    FILE *f1 = fopen(path1, "rb");
+    FILE *f2 = fopen(path2, "rb");
+    int equal = f1 && f2 && fseek(f1, offset, SEEK_SET) == 0 && fseek(f2, offset, SEEK_SET) == 0;
+    while (equal) {
+        int c1 = fgetc(f1);
+        int c2 = fgetc(f2);
+        if (c1 != c2) equal = 0;
+        if (c1 == EOF) break;
+    }
+    if (f1) fclose(f1);
+    if (f2) fclose(f2);
+    return equal;
+}
+
+// Parallel Compression Test: pipelined offline compression against a WAL source, reopened through the VFS
+int test_parallel_compress(TestResult* result) {
+    result->name = "Parallel Compression Test";
+    result->passed = 0;
+    result->total = 5;
+    strcpy(result->message, "");
+    
+    cleanup_test_files("test_parallel");
+    cleanup_test_files("test_parallel_one");
+    init_test_algorithms();
+    
+    sqlite3 *writer = NULL;
+    sqlite3 *db = NULL;
+    char value[256];
+    char rows[64];
+    ProgressLog progress = {0, 0, 0, 1};
+    CCVFSCompressOptions options;
+    
+    // A WAL source whose last transaction is still only in the WAL while its writer stays open
+    int rc = sqlite3_open("test_parallel.db", &writer);
+    if (rc == SQLITE_OK) rc = sqlite3_exec(writer,
+        "PRAGMA journal_mode=WAL;"
+        "CREATE TABLE t (id INTEGER PRIMARY KEY, name TEXT, data BLOB);"
+        "BEGIN;"
+        "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 20000) "
+        "INSERT INTO t SELECT i, 'row ' || (i % 100), zeroblob(100 + i % 200) FROM n;"
+        "COMMIT;"
+        "PRAGMA wal_checkpoint(TRUNCATE);"
+        "UPDATE t SET name = 'wal only' WHERE id % 10 = 0;", NULL, NULL, NULL);
+    if (rc == SQLITE_OK) rc = tools_query_text(writer, "SELECT count(*) || '/' || sum(name = 'wal only') FROM t",
+                                               rows, sizeof(rows));
+    if (rc != SQLITE_OK) {
+        snprintf(result->message, sizeof(result->message), "Cannot create source database: %d", rc);
+        goto done;
+    }
+    
+    // Four workers, the WAL is checkpointed first and progress arrives in order up to the last block
+    memset(&options, 0, sizeof(options));
+    options.compress_algorithm = "zlib";
+    options.page_size = 16384;
+    options.compression_level = 6;
+    options.threads = 4;
+    options.xProgress = log_progress;
+    options.pProgressArg = &progress;
+    rc = sqlite3_ccvfs_compress_database_parallel("test_parallel.db", "test_parallel.ccvfs", &options);
+    CCVFSStats stats;
+    memset(&stats, 0, sizeof(stats));
+    if (rc == SQLITE_OK) rc = sqlite3_ccvfs_get_stats("test_parallel.ccvfs", &stats);
+    if (rc == SQLITE_OK && progress.ordered && progress.calls > 1 && progress.last == progress.total &&
+        stats.total_pages == progress.total && stats.compressed_size < stats.original_size) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message),
+                "Parallel compression failed: rc=%d, progress %u/%u in %u calls, ordered=%d, pages=%u",
+                rc, progress.last, progress.total, progress.calls, progress.ordered, stats.total_pages);
+        goto done;
+    }
+    
+    // One worker lays out the same index and data, only the header timestamp may differ, and a
+    // journal left next to the target is removed instead of being replayed onto the new file
+    FILE *stale = fopen("test_parallel_one.ccvfs-journal", "wb");
+    if (stale) {
+        fputs("stale journal", stale);
+        fclose(stale);
+    }
+    options.threads = 1;
+    options.xProgress = NULL;
+    rc = sqlite3_ccvfs_compress_database_parallel("test_parallel.db", "test_parallel_one.ccvfs", &options);
+    stale = fopen("test_parallel_one.ccvfs-journal", "rb");
+    if (rc == SQLITE_OK && !stale &&
+        files_equal_from("test_parallel.ccvfs", "test_parallel_one.ccvfs", CCVFS_HEADER_SIZE)) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message), "Single worker output differs: rc=%d, stale journal=%d",
+                rc, stale != NULL);
+        if (stale) fclose(stale);
+        goto done;
+    }
+    
+    // The VFS opens the result, sees the WAL-only update and keeps writing into it
+#ifdef HAVE_ZLIB
+    rc = sqlite3_ccvfs_create("parallel_vfs", NULL, CCVFS_COMPRESS_ZLIB, NULL, 16384, CCVFS_CREATE_REALTIME);
+#else
+    rc = sqlite3_ccvfs_create("parallel_vfs", NULL, NULL, NULL, 16384, CCVFS_CREATE_REALTIME);
+#endif
+    if (rc == SQLITE_OK) rc = sqlite3_open_v2("test_parallel.ccvfs", &db, SQLITE_OPEN_READWRITE, "parallel_vfs");
+    if (rc == SQLITE_OK) rc = tools_query_text(db, "SELECT count(*) || '/' || sum(name = 'wal only') FROM t",
+                                               value, sizeof(value));
+    int sameRows = (rc == SQLITE_OK && strcmp(value, rows) == 0);
+    if (rc == SQLITE_OK) rc = sqlite3_exec(db, "PRAGMA journal_mode=DELETE;"
+                                               "INSERT INTO t SELECT id + 20000, name, data FROM t WHERE id <= 1000;",
+                                           NULL, NULL, NULL);
+    if (rc == SQLITE_OK) rc = tools_query_text(db, "PRAGMA integrity_check", value, sizeof(value));
+    if (rc == SQLITE_OK && sameRows && strcmp(value, "ok") == 0) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message), "Reopened database check failed: rc=%d, rows=%d, '%s'",
+                rc, sameRows, value);
+        goto done;
+    }
+    sqlite3_close(db);
+    db = NULL;
+    
+    // Encryption needs a key, block sizes must be powers of two
+    memset(&options, 0, sizeof(options));
+    options.encrypt_algorithm = "aes128";
+    int noKey = sqlite3_ccvfs_compress_database_parallel("test_parallel.db", "test_parallel_one.ccvfs", &options);
+    options.encrypt_algorithm = NULL;
+    options.page_size = 3000;
+    int badSize = sqlite3_ccvfs_compress_database_parallel("test_parallel.db", "test_parallel_one.ccvfs", &options);
+#ifdef HAVE_OPENSSL
+    int expectNoKey = SQLITE_MISUSE;
+#else
+    int expectNoKey = SQLITE_ERROR;
+#endif
+    if (noKey == expectNoKey && badSize == SQLITE_MISUSE) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message), "Invalid options accepted: no key=%d, page size=%d",
+                noKey, badSize);
+        goto done;
+    }
+    
+#ifdef HAVE_OPENSSL
+    // An encrypted copy reads back through a VFS with the same key
+    static const unsigned char key[16] = "parallel-key-16";
+    memset(&options, 0, sizeof(options));
+    options.compress_algorithm = "zlib";
+    options.encrypt_algorithm = "aes128";
+    options.key = key;
+    options.key_len = sizeof(key);
+    options.threads = 3;
+    rc = sqlite3_ccvfs_compress_database_parallel("test_parallel.db", "test_parallel_one.ccvfs", &options);
+#ifdef HAVE_ZLIB
+    if (rc == SQLITE_OK) rc = sqlite3_ccvfs_create_with_key("parallel_key_vfs", NULL, CCVFS_COMPRESS_ZLIB,
+                                                            CCVFS_ENCRYPT_AES128, 0, CCVFS_CREATE_REALTIME,
+                                                            key, sizeof(key));
+#else
+    if (rc == SQLITE_OK) rc = sqlite3_ccvfs_create_with_key("parallel_key_vfs", NULL, NULL,
+                                                            CCVFS_ENCRYPT_AES128, 0, CCVFS_CREATE_REALTIME,
+                                                            key, sizeof(key));
+#endif
+    if (rc == SQLITE_OK) rc = sqlite3_open_v2("test_parallel_one.ccvfs", &db, SQLITE_OPEN_READONLY, "parallel_key_vfs");
+    if (rc == SQLITE_OK) rc = tools_query_text(db, "SELECT count(*) || '/' || sum(name = 'wal only') FROM t",
+                                               value, sizeof(value));
+    if (rc == SQLITE_OK && strcmp(value, rows) == 0) {
+        result->passed++;
+        snprintf(result->message, sizeof(result->message), "%u blocks, %llu -> %llu bytes",
+                stats.total_pages, (unsigned long long)stats.original_size,
+                (unsigned long long)stats.compressed_size);
+    } else {
+        snprintf(result->message, sizeof(result->message), "Encrypted copy check failed: rc=%d, rows='%s'",
+                rc, value);
+    }
+#else
+    result->passed++;
+#endif
+    
+done:
+    sqlite3_close(db);
+    sqlite3_close(writer);
+    sqlite3_ccvfs_destroy("parallel_key_vfs");
+    sqlite3_ccvfs_destroy("parallel_vfs");
+    cleanup_test_files("test_parallel");
+    cleanup_test_files("test_parallel_one");
+    remove("test_parallel_one.ccvfs-journal");
+    
+    return (result->passed == result->total) ? 1 : 0;
+}
+
+// Flip one byte of a file in place
+static int flip_file_byte(const char *path, long offset) {
+    FILE *f = fopen(path, "r+b");
+    int ok = f && fseek(f, offset, SEEK_SET) == 0;
+    int c = ok ? fgetc(f) : EOF;
+    ok = ok && c != EOF && fseek(f, offset, SEEK_SET) == 0 && fputc(c ^ 0xFF, f) != EOF;
+    if (f) fclose(f);
+    return ok;
+}
+
+static int restore_output_exists(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (f) fclose(f);
+    return f != NULL;
+}
+
+// Parallel Decompression Test: direct transcoding back to plain SQLite, byte for byte
+int test_parallel_decompress(TestResult* result) {
+    result->name = "Parallel Decompression Test";
+    result->passed = 0;
+    result->total = 4;
+    strcpy(result->message, "");
+    
+    cleanup_test_files("test_restore");
+    cleanup_test_files("test_restore_vfs");
+    cleanup_test_files("test_restore_key");
+    cleanup_test_files("test_restore_bad");
+    init_test_algorithms();
+    
+    sqlite3 *db = NULL;
+    sqlite3 *writer = NULL;
+    char value[256];
+    char rows[64];
+    ProgressLog progress = {0, 0, 0, 1};
+    CCVFSCompressOptions compress;
+    CCVFSDecompressOptions options;
+    
+    // A plain source, packed into 4KB blocks so the output may use O_DIRECT
+    int rc = sqlite3_open("test_restore.db", &db);
+    if (rc == SQLITE_OK) rc = sqlite3_exec(db,
+        "CREATE TABLE t (id INTEGER PRIMARY KEY, name TEXT, data BLOB);"
+        "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 20000) "
+        "INSERT INTO t SELECT i, 'row ' || (i % 100), randomblob(50 + i % 100) FROM n;"
+        "DELETE FROM t WHERE id % 7 = 0;", NULL, NULL, NULL);
+    sqlite3_close(db);
+    db = NULL;
+    memset(&compress, 0, sizeof(compress));
+    compress.compress_algorithm = "zlib";
+    compress.page_size = 4096;
+    if (rc == SQLITE_OK) rc = sqlite3_ccvfs_compress_database_parallel("test_restore.db", "test_restore.ccvfs", &compress);
+    if (rc != SQLITE_OK) {
+        snprintf(result->message, sizeof(result->message), "Cannot create source files: %d", rc);
+        goto done;
+    }
+    
+    // Four workers restore the plain file byte for byte, with ordered progress
+    memset(&options, 0, sizeof(options));
+    options.threads = 4;
+    options.direct_io = 1;
+    options.xProgress = log_progress;
+    options.pProgressArg = &progress;
+    rc = sqlite3_ccvfs_decompress_database_parallel("test_restore.ccvfs", "test_restore_restored.db", &options);
+    if (rc == SQLITE_OK && progress.ordered && progress.calls > 1 && progress.last == progress.total &&
+        files_equal_from("test_restore.db", "test_restore_restored.db", 0)) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message),
+                "Round trip failed: rc=%d, progress %u/%u in %u calls, ordered=%d",
+                rc, progress.last, progress.total, progress.calls, progress.ordered);
+        goto done;
+    }
+    
+    // A file the VFS rewrote in place, blocks out of physical order, its last transaction still
+    // in the WAL of an open writer
+#ifdef HAVE_ZLIB
+    rc = sqlite3_ccvfs_create("restore_vfs", NULL, CCVFS_COMPRESS_ZLIB, NULL, 4096, CCVFS_CREATE_REALTIME);
+#else
+    rc = sqlite3_ccvfs_create("restore_vfs", NULL, NULL, NULL, 4096, CCVFS_CREATE_REALTIME);
+#endif
+    if (rc == SQLITE_OK) rc = sqlite3_open_v2("test_restore_vfs.db", &writer,
+                                              SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, "restore_vfs");
+    if (rc == SQLITE_OK) rc = sqlite3_exec(writer,
+        "CREATE TABLE t (id INTEGER PRIMARY KEY, name TEXT, data BLOB);"
+        "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 5000) "
+        "INSERT INTO t SELECT i, 'row ' || i, zeroblob(100) FROM n;"
+        "UPDATE t SET data = randomblob(300) WHERE id % 3 = 0;"
+        "PRAGMA journal_mode=WAL;"
+        "UPDATE t SET name = 'wal only' WHERE id % 10 = 0;", NULL, NULL, NULL);
+    if (rc == SQLITE_OK) rc = tools_query_text(writer,
+        "SELECT count(*) || '/' || sum(name = 'wal only') || '/' || sum(length(data)) FROM t", rows, sizeof(rows));
+    memset(&options, 0, sizeof(options));
+    options.threads = 3;
+    if (rc == SQLITE_OK) rc = sqlite3_ccvfs_decompress_database_parallel("test_restore_vfs.db",
+                                                                         "test_restore_vfs_restored.db", &options);
+    if (rc == SQLITE_OK) rc = sqlite3_open("test_restore_vfs_restored.db", &db);
+    if (rc == SQLITE_OK) rc = tools_query_text(db,
+        "SELECT count(*) || '/' || sum(name = 'wal only') || '/' || sum(length(data)) FROM t", value, sizeof(value));
+    int sameRows = (rc == SQLITE_OK && strcmp(value, rows) == 0);
+    if (rc == SQLITE_OK) rc = tools_query_text(db, "PRAGMA integrity_check", value, sizeof(value));
+    // The writer keeps its locks and goes on writing
+    if (rc == SQLITE_OK) rc = sqlite3_exec(writer, "INSERT INTO t (name) VALUES ('after restore')", NULL, NULL, NULL);
+    if (rc == SQLITE_OK && sameRows && strcmp(value, "ok") == 0) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message), "VFS file restore failed: rc=%d, rows=%d (%s), '%s'",
+                rc, sameRows, rows, value);
+        goto done;
+    }
+    sqlite3_close(db);
+    db = NULL;
+    
+#ifdef HAVE_OPENSSL
+    // An encrypted file needs its key, given directly or through a VFS that holds it
+    static const unsigned char key[32] = "restore-key-for-aes256-blocks!!";
+    memset(&compress, 0, sizeof(compress));
+    compress.compress_algorithm = "zlib";
+    compress.encrypt_algorithm = "aes256";
+    compress.key = key;
+    compress.key_len = sizeof(key);
+    rc = sqlite3_ccvfs_compress_database_parallel("test_restore.db", "test_restore_key.ccvfs", &compress);
+    memset(&options, 0, sizeof(options));
+    int noKey = sqlite3_ccvfs_decompress_database_parallel("test_restore_key.ccvfs", "test_restore_key_restored.db",
+                                                           &options);
+    int noKeyOutput = restore_output_exists("test_restore_key_restored.db");
+    options.key = key;
+    options.key_len = sizeof(key);
+    if (rc == SQLITE_OK) rc = sqlite3_ccvfs_decompress_database_parallel("test_restore_key.ccvfs",
+                                                                         "test_restore_key_restored.db", &options);
+    if (rc == SQLITE_OK) rc = sqlite3_ccvfs_create_and_decompress_decrypt("restore_key_vfs", CCVFS_COMPRESS_ZLIB,
+                                                                          CCVFS_ENCRYPT_AES256, "test_restore_key.ccvfs",
+                                                                          "test_restore_key_decrypted.db",
+                                                                          key, sizeof(key));
+    if (rc == SQLITE_OK && noKey == SQLITE_MISUSE && !noKeyOutput &&
+        files_equal_from("test_restore.db", "test_restore_key_restored.db", 0) &&
+        files_equal_from("test_restore.db", "test_restore_key_decrypted.db", 0)) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message), "Encrypted restore failed: rc=%d, no key=%d/%d",
+                rc, noKey, noKeyOutput);
+        goto done;
+    }
+#else
+    result->passed++;
+#endif
+    
+    // A damaged block fails its checksum and leaves no output behind
+    rc = sqlite3_ccvfs_compress_database_parallel("test_restore.db", "test_restore_bad.ccvfs", NULL);
+    long long offset = -1;
+    if (rc == SQLITE_OK) rc = sqlite3_open_v2("test_restore_bad.ccvfs", &db, SQLITE_OPEN_READONLY, "restore_vfs");
+    if (rc == SQLITE_OK) rc = sqlite3_ccvfs_pages_init(db, NULL, NULL);
+    if (rc == SQLITE_OK) rc = tools_query_text(db, "SELECT physical_offset + compressed_size / 2 FROM ccvfs_pages "
+                                                   "WHERE compressed_size > 0 AND pageno > 1 LIMIT 1",
+                                               value, sizeof(value));
+    if (rc == SQLITE_OK && value[0]) offset = atoll(value);
+    sqlite3_close(db);
+    db = NULL;
+    if (offset > 0 && flip_file_byte("test_restore_bad.ccvfs", (long)offset)) {
+        rc = sqlite3_ccvfs_decompress_database_parallel("test_restore_bad.ccvfs", "test_restore_bad_restored.db", NULL);
+    }
+    if (rc == SQLITE_CORRUPT && !restore_output_exists("test_restore_bad_restored.db")) {
+        result->passed++;
+        snprintf(result->message, sizeof(result->message), "%u blocks restored on 4 workers", progress.total);
+    } else {
+        snprintf(result->message, sizeof(result->message), "Damaged block not detected: rc=%d, offset=%lld",
+                rc, offset);
+    }
+    
+done:
+    sqlite3_close(db);
+    sqlite3_close(writer);
+    sqlite3_ccvfs_destroy("restore_vfs");
+    cleanup_test_files("test_restore");
+    cleanup_test_files("test_restore_vfs");
+    cleanup_test_files("test_restore_key");
+    cleanup_test_files("test_restore_bad");
+    
+    return (result->passed == result->total) ? 1 : 0;
+}
+
+// Hot Backup Test: stored blocks copied verbatim or compacted from a live VFS database
+int test_hot_backup(TestResult* result) {
+    result->name = "Hot Backup Test";
+    result->passed = 0;
+    result->total = 4;
+    strcpy(result->message, "");
+    
+    cleanup_test_files("test_backup");
+    cleanup_test_files("test_backup_copy");
+    cleanup_test_files("test_backup_compact");
+    init_test_algorithms();
+    
+    sqlite3 *db = NULL;
+    sqlite3 *copy = NULL;
+    char value[256];
+    char rows[64];
+    ProgressLog progress = {0, 0, 0, 1};
+    CCVFSBackupOptions options;
+    CCVFSDecompressOptions restore;
+    
+    // A live database the VFS rewrote in place, its last transaction still in the WAL
+#ifdef HAVE_ZLIB
+    int rc = sqlite3_ccvfs_create("backup_vfs", NULL, CCVFS_COMPRESS_ZLIB, NULL, 4096, CCVFS_CREATE_REALTIME);
+#else
+    int rc = sqlite3_ccvfs_create("backup_vfs", NULL, NULL, NULL, 4096, CCVFS_CREATE_REALTIME);
+#endif
+    if (rc == SQLITE_OK) rc = sqlite3_open_v2("test_backup.db", &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE,
+                                              "backup_vfs");
+    if (rc == SQLITE_OK) rc = sqlite3_exec(db,
+        "CREATE TABLE t (id INTEGER PRIMARY KEY, name TEXT, data BLOB);"
+        "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 5000) "
+        "INSERT INTO t SELECT i, 'row ' || i, zeroblob(100) FROM n;"
+        "UPDATE t SET data = randomblob(300) WHERE id % 3 = 0;"
+        "DELETE FROM t WHERE id % 5 = 0;"
+        "PRAGMA journal_mode=WAL;"
+        "UPDATE t SET name = 'wal only' WHERE id % 10 = 1;", NULL, NULL, NULL);
+    if (rc == SQLITE_OK) rc = tools_query_text(db,
+        "SELECT count(*) || '/' || sum(name = 'wal only') || '/' || sum(length(data)) FROM t", rows, sizeof(rows));
+    if (rc != SQLITE_OK) {
+        snprintf(result->message, sizeof(result->message), "Cannot create source database: %d", rc);
+        goto done;
+    }
+    
+    // Blocks keep their offsets, the copy decodes to the same plain database as the source
+    memset(&options, 0, sizeof(options));
+    options.xProgress = log_progress;
+    options.pProgressArg = &progress;
+    rc = sqlite3_ccvfs_backup(db, "test_backup_copy.db", &options);
+    memset(&restore, 0, sizeof(restore));
+    if (rc == SQLITE_OK) rc = sqlite3_ccvfs_decompress_database_parallel("test_backup.db", "test_backup_restored.db",
+                                                                         &restore);
+    if (rc == SQLITE_OK) rc = sqlite3_ccvfs_decompress_database_parallel("test_backup_copy.db",
+                                                                         "test_backup_copy_restored.db", &restore);
+    if (rc == SQLITE_OK && progress.ordered && progress.last == progress.total && progress.total > 0 &&
+        files_equal_from("test_backup_restored.db", "test_backup_copy_restored.db", 0)) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message), "Verbatim backup failed: rc=%d, progress %u/%u, ordered=%d",
+                rc, progress.last, progress.total, progress.ordered);
+        goto done;
+    }
+    
+    // Compaction packs the blocks in block order: no larger, same content, still writable
+    options.compact = 1;
+    options.verify = 1;
+    options.xProgress = NULL;
+    rc = sqlite3_ccvfs_backup(db, "test_backup_compact.db", &options);
+    struct stat source, packed;
+    memset(&source, 0, sizeof(source));
+    memset(&packed, 0, sizeof(packed));
+    if (rc == SQLITE_OK && (stat("test_backup.db", &source) != 0 || stat("test_backup_compact.db", &packed) != 0)) {
+        rc = SQLITE_IOERR;
+    }
+    if (rc == SQLITE_OK) rc = sqlite3_open_v2("test_backup_compact.db", &copy, SQLITE_OPEN_READWRITE, "backup_vfs");
+    if (rc == SQLITE_OK) rc = tools_query_text(copy,
+        "SELECT count(*) || '/' || sum(name = 'wal only') || '/' || sum(length(data)) FROM t", value, sizeof(value));
+    int sameRows = (rc == SQLITE_OK && strcmp(value, rows) == 0);
+    if (rc == SQLITE_OK) rc = sqlite3_exec(copy, "INSERT INTO t (name, data) VALUES ('after backup', randomblob(5000))",
+                                           NULL, NULL, NULL);
+    if (rc == SQLITE_OK) rc = tools_query_text(copy, "PRAGMA integrity_check", value, sizeof(value));
+    if (rc == SQLITE_OK && sameRows && strcmp(value, "ok") == 0 &&
+        packed.st_size <= source.st_size) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message),
+                "Compacted backup failed: rc=%d, rows=%d, '%s', %llu -> %llu bytes", rc, sameRows, value,
+                (unsigned long long)source.st_size, (unsigned long long)packed.st_size);
+        goto done;
+    }
+    sqlite3_close(copy);
+    copy = NULL;
+    
+    // The source connection keeps writing after both backups
+    rc = sqlite3_exec(db, "INSERT INTO t (name) VALUES ('after backups')", NULL, NULL, NULL);
+    sqlite3 *plain = NULL;
+    int notCcvfs = SQLITE_ERROR;
+    if (sqlite3_open("test_backup_restored.db", &plain) == SQLITE_OK) {
+        notCcvfs = sqlite3_ccvfs_backup(plain, "test_backup_copy.db", NULL);
+    }
+    sqlite3_close(plain);
+    if (rc == SQLITE_OK && notCcvfs == SQLITE_MISUSE) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message), "Source write or misuse check failed: rc=%d, plain=%d",
+                rc, notCcvfs);
+        goto done;
+    }
+    
+    // A damaged block is caught by verify and leaves no copy behind
+    rc = tools_query_text(db, "SELECT physical_offset + compressed_size / 2 FROM ccvfs_pages "
+                              "WHERE compressed_size > 0 AND pageno > 1 LIMIT 1", value, sizeof(value));
+    if (rc != SQLITE_OK) {
+        rc = sqlite3_ccvfs_pages_init(db, NULL, NULL);
+        if (rc == SQLITE_OK) rc = tools_query_text(db, "SELECT physical_offset + compressed_size / 2 FROM ccvfs_pages "
+                                                       "WHERE compressed_size > 0 AND pageno > 1 LIMIT 1",
+                                                   value, sizeof(value));
+    }
+    long long offset = (rc == SQLITE_OK && value[0]) ? atoll(value) : -1;
+    sqlite3_close(db);
+    db = NULL;
+    remove("test_backup_compact.db");
+    if (offset > 0 && flip_file_byte("test_backup.db", (long)offset)) {
+        rc = sqlite3_open_v2("test_backup.db", &db, SQLITE_OPEN_READONLY, "backup_vfs");
+        if (rc == SQLITE_OK) rc = sqlite3_ccvfs_backup(db, "test_backup_compact.db", &options);
+    }
+    if (rc == SQLITE_CORRUPT && !restore_output_exists("test_backup_compact.db")) {
+        result->passed++;
+        snprintf(result->message, sizeof(result->message), "%u blocks, %llu -> %llu bytes compacted",
+                progress.total, (unsigned long long)source.st_size,
+                (unsigned long long)packed.st_size);
+    } else {
+        snprintf(result->message, sizeof(result->message), "Damaged block not detected: rc=%d, offset=%lld",
+                rc, offset);
+    }
+    
+done:
+    sqlite3_close(copy);
+    sqlite3_close(db);
+    sqlite3_ccvfs_destroy("backup_vfs");
+    cleanup_test_files("test_backup");
+    cleanup_test_files("test_backup_copy");
+    cleanup_test_files("test_backup_compact");
+    
+    return (result->passed == result->total) ? 1 : 0;
+}
+
+// Decode two CCVFS files and compare the plain databases
+static int ccvfs_files_decode_equal(const char *path1, const char *path2) {
+    CCVFSDecompressOptions restore;
+    memset(&restore, 0, sizeof(restore));
+    if (sqlite3_ccvfs_decompress_database_parallel(path1, "test_incr_plain1.db", &restore) != SQLITE_OK ||
+        sqlite3_ccvfs_decompress_database_parallel(path2, "test_incr_plain2.db", &restore) != SQLITE_OK) {
+        return 0;
+    }
+    return files_equal_from("test_incr_plain1.db", "test_incr_plain2.db", 0);
+}
+
+// Incremental Backup Test: deltas of the changed blocks applied to a full copy
+int test_incremental_backup(TestResult* result) {
+    result->name = "Incremental Backup Test";
+    result->passed = 0;
+    result->total = 4;
+    strcpy(result->message, "");
+    
+    const char *files[] = { "test_incr", "test_incr_base", "test_incr_plain1", "test_incr_plain2" };
+    size_t f;
+    for (f = 0; f < sizeof(files) / sizeof(files[0]); f++) {
+        cleanup_test_files(files[f]);
+    }
+    remove("test_incr_1.delta");
+    remove("test_incr_2.delta");
+    remove("test_incr_3.delta");
+    init_test_algorithms();
+    
+    sqlite3 *db = NULL;
+    struct stat source, delta;
+    CCVFSBackupOptions options;
+    memset(&options, 0, sizeof(options));
+    options.verify = 1;
+    
+    // A full copy of the database to start the chain from
+#ifdef HAVE_ZLIB
+    int rc = sqlite3_ccvfs_create("incr_vfs", NULL, CCVFS_COMPRESS_ZLIB, NULL, 4096, CCVFS_CREATE_REALTIME);
+#else
+    int rc = sqlite3_ccvfs_create("incr_vfs", NULL, NULL, NULL, 4096, CCVFS_CREATE_REALTIME);
+#endif
+    if (rc == SQLITE_OK) rc = sqlite3_open_v2("test_incr.db", &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE,
+                                              "incr_vfs");
+    if (rc == SQLITE_OK) rc = sqlite3_exec(db,
+        "CREATE TABLE t (id INTEGER PRIMARY KEY, name TEXT, data BLOB);"
+        "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 20000) "
+        "INSERT INTO t SELECT i, 'row ' || i, randomblob(100) FROM n;", NULL, NULL, NULL);
+    if (rc == SQLITE_OK) rc = sqlite3_ccvfs_backup(db, "test_incr_base.db", NULL);
+    if (rc != SQLITE_OK) {
+        snprintf(result->message, sizeof(result->message), "Cannot create the full backup: %d", rc);
+        goto done;
+    }
+    
+    // A few changed rows give a delta of a few blocks, applying it reproduces the source
+    rc = sqlite3_exec(db, "UPDATE t SET name = 'changed' WHERE id BETWEEN 100 AND 120", NULL, NULL, NULL);
+    if (rc == SQLITE_OK) rc = sqlite3_ccvfs_backup_incremental(db, "test_incr_base.db", "test_incr_1.delta", &options);
+    if (rc == SQLITE_OK) rc = sqlite3_ccvfs_apply_delta("test_incr_base.db", "test_incr_1.delta");
+    if (rc == SQLITE_OK && (stat("test_incr.db", &source) != 0 || stat("test_incr_1.delta", &delta) != 0)) {
+        rc = SQLITE_IOERR;
+    }
+    if (rc == SQLITE_OK && delta.st_size * 10 < source.st_size &&
+        ccvfs_files_decode_equal("test_incr.db", "test_incr_base.db")) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message), "Small delta failed: rc=%d, %lld of %lld bytes",
+                rc, (long long)delta.st_size, (long long)source.st_size);
+        goto done;
+    }
+    
+    // The previous delta serves as the base of the next one, the database grows meanwhile
+    rc = sqlite3_exec(db,
+        "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 3000) "
+        "INSERT INTO t (name, data) SELECT 'more ' || i, randomblob(200) FROM n;"
+        "DELETE FROM t WHERE id BETWEEN 5000 AND 5100;", NULL, NULL, NULL);
+    if (rc == SQLITE_OK) rc = sqlite3_ccvfs_backup_incremental(db, "test_incr_1.delta", "test_incr_2.delta", &options);
+    int stale = SQLITE_OK;
+    if (rc == SQLITE_OK) rc = sqlite3_ccvfs_apply_delta("test_incr_base.db", "test_incr_2.delta");
+    if (rc == SQLITE_OK) stale = sqlite3_ccvfs_apply_delta("test_incr_base.db", "test_incr_1.delta");
+    if (rc == SQLITE_OK && stale == SQLITE_MISMATCH && ccvfs_files_decode_equal("test_incr.db", "test_incr_base.db")) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message), "Delta chain failed: rc=%d, stale delta=%d", rc, stale);
+        goto done;
+    }
+    
+    // Nothing changed: the delta carries no blocks; compaction is refused
+    rc = sqlite3_ccvfs_backup_incremental(db, "test_incr_base.db", "test_incr_3.delta", NULL);
+    if (rc == SQLITE_OK) rc = sqlite3_ccvfs_apply_delta("test_incr_base.db", "test_incr_3.delta");
+    options.compact = 1;
+    int compact = sqlite3_ccvfs_backup_incremental(db, "test_incr_base.db", "test_incr_1.delta", &options);
+    options.compact = 0;
+    if (rc == SQLITE_OK && compact == SQLITE_MISUSE && stat("test_incr_3.delta", &delta) == 0 &&
+        ccvfs_files_decode_equal("test_incr.db", "test_incr_base.db")) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message), "Empty delta failed: rc=%d, compact=%d", rc, compact);
+        goto done;
+    }
+    
+    // A damaged delta is refused before the copy is touched
+    rc = sqlite3_exec(db, "UPDATE t SET data = randomblob(100) WHERE id % 50 = 0", NULL, NULL, NULL);
+    if (rc == SQLITE_OK) rc = sqlite3_ccvfs_backup_incremental(db, "test_incr_base.db", "test_incr_3.delta", &options);
+    if (rc == SQLITE_OK && stat("test_incr_3.delta", &delta) == 0 &&
+        flip_file_byte("test_incr_3.delta", (long)delta.st_size - 1)) {
+        rc = sqlite3_ccvfs_apply_delta("test_incr_base.db", "test_incr_3.delta");
+    }
+    // test_incr_plain1.db still holds the decoded source of the previous step
+    if (rc == SQLITE_CORRUPT &&
+        sqlite3_ccvfs_decompress_database_parallel("test_incr_base.db", "test_incr_plain2.db", NULL) == SQLITE_OK &&
+        files_equal_from("test_incr_plain1.db", "test_incr_plain2.db", 0)) {
+        result->passed++;
+        snprintf(result->message, sizeof(result->message), "Deltas of %lld bytes for a %lld byte file",
+                (long long)delta.st_size, (long long)source.st_size);
+    } else {
+        snprintf(result->message, sizeof(result->message), "Damaged delta not refused: rc=%d", rc);
+    }
+    
+done:
+    sqlite3_close(db);
+    sqlite3_ccvfs_destroy("incr_vfs");
+    for (f = 0; f < sizeof(files) / sizeof(files[0]); f++) {
+        cleanup_test_files(files[f]);
+    }
+    remove("test_incr_1.delta");
+    remove("test_incr_2.delta");
+    remove("test_incr_3.delta");
+    
+    return (result->passed == result->total) ? 1 : 0;
+}
+
+// Parallel Compare Test
+int test_parallel_compare(TestResult* result) {
+    result->name = "Parallel Compare Test";
+    result->passed = 0;
+    result->total = 4;
+    strcpy(result->message, "");
+    
+    const char *files[] = { "test_pcmp1", "test_pcmp2", "test_pcmp_wal" };
+    size_t f;
+    for (f = 0; f < sizeof(files) / sizeof(files[0]); f++) {
+        cleanup_test_files(files[f]);
+    }
+    init_test_algorithms();
+    
+    sqlite3 *db = NULL;
+    sqlite3 *wal = NULL;
+    CompareOptions options;
+    CompareResult ordered, unordered;
+    memset(&options, 0, sizeof(options));
+    options.mode = COMPARE_MODE_HASH;
+    options.threads = 4;
+    options.range_rows = 1000;
+    
+    // compare_databases opens CCVFS files through the VFS named "ccvfs"
+#ifdef HAVE_ZLIB
+    int created = sqlite3_ccvfs_create("ccvfs", NULL, CCVFS_COMPRESS_ZLIB, NULL, 0, 0) == SQLITE_OK;
+#else
+    int created = sqlite3_ccvfs_create("ccvfs", NULL, NULL, NULL, 0, 0) == SQLITE_OK;
+#endif
+    
+    // Two identical databases, one table with rowids and one without
+    const char *sql =
+        "CREATE TABLE t (id INTEGER PRIMARY KEY, name TEXT, score REAL, data BLOB);"
+        "CREATE TABLE w (k TEXT PRIMARY KEY, v INTEGER) WITHOUT ROWID;"
+        "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 20000) "
+        "INSERT INTO t SELECT i, 'row ' || i, i * 0.5, zeroblob(i % 64) FROM n;"
+        "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 2000) "
+        "INSERT INTO w SELECT 'key ' || i, i FROM n;";
+    int rc = sqlite3_open("test_pcmp1.db", &db);
+    if (rc == SQLITE_OK) rc = sqlite3_exec(db, sql, NULL, NULL, NULL);
+    sqlite3_close(db);
+    db = NULL;
+    if (rc == SQLITE_OK) rc = sqlite3_open("test_pcmp2.db", &db);
+    if (rc == SQLITE_OK) rc = sqlite3_exec(db, sql, NULL, NULL, NULL);
+    if (rc == SQLITE_OK) rc = compare_databases("test_pcmp1.db", "test_pcmp2.db", &options, &ordered);
+    if (rc == SQLITE_OK && ordered.records_different == 0 && ordered.records_identical == 22000 &&
+        ordered.tables_identical == 2 && ordered.ranges_compared == 21 && ordered.ranges_different == 0) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message), "Identical databases failed: rc=%d, %d rows, %d ranges",
+                rc, ordered.records_identical, ordered.ranges_compared);
+        goto done;
+    }
+    
+    // A changed row, a deleted row, an added row and a changed row without rowid are found by either hash
+    rc = sqlite3_exec(db,
+        "UPDATE t SET name = 'changed' WHERE id = 1234;"
+        "DELETE FROM t WHERE id = 15000;"
+        "INSERT INTO t VALUES (30000, 'new', 1.0, NULL);"
+        "UPDATE w SET v = -1 WHERE k = 'key 7';", NULL, NULL, NULL);
+    if (rc == SQLITE_OK) rc = compare_databases("test_pcmp1.db", "test_pcmp2.db", &options, &ordered);
+    options.unordered_hash = 1;
+    if (rc == SQLITE_OK) rc = compare_databases("test_pcmp1.db", "test_pcmp2.db", &options, &unordered);
+    options.unordered_hash = 0;
+    if (rc == SQLITE_OK && ordered.records_different == 4 && unordered.records_different == 4 &&
+        ordered.ranges_different == 4 && ordered.tables_different == 2 &&
+        ordered.records_identical == unordered.records_identical) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message), "Changed rows failed: rc=%d, %d/%d rows, %d ranges",
+                rc, ordered.records_different, unordered.records_different, ordered.ranges_different);
+        goto done;
+    }
+    
+    // Decoded CCVFS pages match the pages of the plain database they came from
+    options.mode = COMPARE_MODE_PAGES;
+    rc = sqlite3_ccvfs_compress_database_parallel("test_pcmp1.db", "test_pcmp1.ccvfs", NULL);
+    if (rc == SQLITE_OK) rc = compare_databases("test_pcmp1.db", "test_pcmp1.ccvfs", &options, &ordered);
+    if (rc == SQLITE_OK && created && ordered.pages_compared > 1 && ordered.pages_different == 0) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message), "CCVFS page images failed: rc=%d, %d of %d pages",
+                rc, ordered.pages_different, ordered.pages_compared);
+        goto done;
+    }
+    
+    // Changed pages are counted; a WAL with frames in it is refused
+    rc = compare_databases("test_pcmp1.ccvfs", "test_pcmp2.db", &options, &ordered);
+    int busy = SQLITE_OK;
+    if (rc == SQLITE_OK && sqlite3_open("test_pcmp_wal.db", &wal) == SQLITE_OK &&
+        sqlite3_exec(wal, "PRAGMA journal_mode=WAL; CREATE TABLE x (a);", NULL, NULL, NULL) == SQLITE_OK) {
+        busy = compare_databases("test_pcmp_wal.db", "test_pcmp1.db", &options, &unordered);
+    }
+    if (rc == SQLITE_OK && ordered.pages_different > 0 && ordered.pages_different < ordered.pages_compared &&
+        busy == SQLITE_BUSY) {
+        result->passed++;
+        snprintf(result->message, sizeof(result->message), "%d of %d pages differ", ordered.pages_different,
+                ordered.pages_compared);
+    } else {
+        snprintf(result->message, sizeof(result->message), "Page differences failed: rc=%d, %d pages, wal=%d",
+                rc, ordered.pages_different, busy);
+    }
+    
+done:
+    sqlite3_close(wal);
+    sqlite3_close(db);
+    if (created) sqlite3_ccvfs_destroy("ccvfs");
+    for (f = 0; f < sizeof(files) / sizeof(files[0]); f++) {
+        cleanup_test_files(files[f]);
+    }
+    
+    return (result->passed == result->total) ? 1 : 0;
+}
+
+// Read or write index entry iBlock of a CCVFS file in place
+static int verify_index_entry(const char *path, uint32_t iBlock, CCVFSPageIndex *pEntry, int write) {
+    FILE *fp = fopen(path, "r+b");
+    int ok = fp && fseek(fp, (long)(CCVFS_INDEX_TABLE_OFFSET + iBlock * sizeof(CCVFSPageIndex)), SEEK_SET) == 0 &&
+             (write ? fwrite(pEntry, sizeof(*pEntry), 1, fp) : fread(pEntry, sizeof(*pEntry), 1, fp)) == 1;
+    if (fp) fclose(fp);
+    return ok;
+}
+
+// Page Verify Test
+int test_page_verify(TestResult* result) {
+    result->name = "Page Verify Test";
+    result->passed = 0;
+    result->total = 4;
+    strcpy(result->message, "");
+    
+    cleanup_test_files("test_verify");
+    cleanup_test_files("test_verify_live");
+    init_test_algorithms();
+    
+    sqlite3 *db = NULL;
+    CCVFSCompressOptions compress;
+    CCVFSVerifyOptions options;
+    CCVFSVerifyResult clean, live, found;
+    CCVFSPageIndex entry, other;
+    ProgressLog progress = {0, 0, 0, 1};
+    memset(&compress, 0, sizeof(compress));
+    memset(&options, 0, sizeof(options));
+    compress.page_size = 4096;
+#ifdef HAVE_ZLIB
+    compress.compress_algorithm = "zlib";
+#endif
+    options.threads = 3;
+    options.xProgress = log_progress;
+    options.pProgressArg = &progress;
+    
+    // A compressed copy and a file written through the VFS with rows updated and deleted in place
+    int rc = sqlite3_open("test_verify.db", &db);
+    if (rc == SQLITE_OK) rc = sqlite3_exec(db,
+        "CREATE TABLE t (id INTEGER PRIMARY KEY, name TEXT, data BLOB);"
+        "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 20000) "
+        "INSERT INTO t SELECT i, 'row ' || (i % 500), randomblob(i % 40) FROM n;", NULL, NULL, NULL);
+    sqlite3_close(db);
+    db = NULL;
+    if (rc == SQLITE_OK) rc = sqlite3_ccvfs_compress_database_parallel("test_verify.db", "test_verify.ccvfs", &compress);
+    if (rc == SQLITE_OK) rc = sqlite3_ccvfs_verify("test_verify.ccvfs", &options, &clean);
+#ifdef HAVE_ZLIB
+    int vfs_rc = sqlite3_ccvfs_create("verify_vfs", NULL, CCVFS_COMPRESS_ZLIB, NULL, 4096, CCVFS_CREATE_REALTIME);
+#else
+    int vfs_rc = sqlite3_ccvfs_create("verify_vfs", NULL, NULL, NULL, 4096, CCVFS_CREATE_REALTIME);
+#endif
+    if (rc == SQLITE_OK && vfs_rc == SQLITE_OK &&
+        sqlite3_open_v2("test_verify_live.db", &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, "verify_vfs") == SQLITE_OK) {
+        rc = sqlite3_exec(db,
+            "CREATE TABLE t (id INTEGER PRIMARY KEY, name TEXT);"
+            "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 5000) "
+            "INSERT INTO t SELECT i, hex(randomblob(50)) FROM n;"
+            "UPDATE t SET name = hex(randomblob(80)) WHERE id % 3 = 0;"
+            "DELETE FROM t WHERE id % 7 = 0;", NULL, NULL, NULL);
+        // The verification runs while the writer still has the file open
+        if (rc == SQLITE_OK) rc = sqlite3_ccvfs_verify("test_verify_live.db", NULL, &live);
+    }
+    sqlite3_close(db);
+    db = NULL;
+    if (rc == SQLITE_OK && clean.corrupt_count == 0 && clean.stored_blocks + clean.sparse_blocks == clean.total_blocks &&
+        clean.stored_blocks > 10 && clean.decoded && clean.unreferenced_bytes == 0 &&
+        progress.last == clean.stored_blocks && live.corrupt_count == 0 && live.stored_blocks > 10) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message), "Intact files failed: rc=%d, %u of %u blocks, %u corrupt",
+                rc, clean.stored_blocks, clean.total_blocks, clean.corrupt_count);
+        goto done;
+    }
+    
+    // A flipped byte in block 5 is a checksum error that names the block
+    rc = verify_index_entry("test_verify.ccvfs", 5, &entry, 0) ? SQLITE_OK : SQLITE_IOERR;
+    if (rc == SQLITE_OK && !flip_file_byte("test_verify.ccvfs", (long)(entry.physical_offset + entry.compressed_size / 2))) {
+        rc = SQLITE_IOERR;
+    }
+    if (rc == SQLITE_OK) rc = sqlite3_ccvfs_verify("test_verify.ccvfs", &options, &found);
+    if (rc == SQLITE_CORRUPT && found.checksum_errors == 1 && found.decode_errors == 0 && found.corrupt_count == 1 &&
+        found.corrupt_blocks[0] == 5) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message), "Flipped byte not found: rc=%d, %u checksum errors",
+                rc, found.checksum_errors);
+        goto done;
+    }
+    
+    // Block 7 moved onto block 6 overlaps it and leaves its old place unreferenced, block 9 points past the end
+    rc = sqlite3_ccvfs_compress_database_parallel("test_verify.db", "test_verify.ccvfs", &compress);
+    if (rc == SQLITE_OK && verify_index_entry("test_verify.ccvfs", 6, &other, 0) &&
+        verify_index_entry("test_verify.ccvfs", 7, &entry, 0)) {
+        entry.physical_offset = other.physical_offset;
+        if (!verify_index_entry("test_verify.ccvfs", 7, &entry, 1) ||
+            !verify_index_entry("test_verify.ccvfs", 9, &entry, 0)) {
+            rc = SQLITE_IOERR;
+        }
+        entry.physical_offset = clean.file_size;
+        if (rc == SQLITE_OK && !verify_index_entry("test_verify.ccvfs", 9, &entry, 1)) rc = SQLITE_IOERR;
+    }
+    if (rc == SQLITE_OK) rc = sqlite3_ccvfs_verify("test_verify.ccvfs", &options, &found);
+    if (rc == SQLITE_CORRUPT && found.overlapping_extents == 1 && found.invalid_entries == 1 &&
+        found.unreferenced_extents == 2 && found.unreferenced_bytes > 0 && found.corrupt_count >= 1 &&
+        found.corrupt_blocks[found.corrupt_count - 1] == 9) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message),
+                "Index damage not found: rc=%d, %u overlapping, %u invalid, %u gaps", rc,
+                found.overlapping_extents, found.invalid_entries, found.unreferenced_extents);
+        goto done;
+    }
+    
+    // Stored bytes with a matching checksum that do not decode, and a file that is not CCVFS
+    rc = sqlite3_ccvfs_compress_database_parallel("test_verify.db", "test_verify.ccvfs", &compress);
+    if (rc == SQLITE_OK && verify_index_entry("test_verify.ccvfs", 3, &entry, 0)) {
+        unsigned char *aStored = (unsigned char *)malloc(entry.compressed_size);
+        FILE *fp = fopen("test_verify.ccvfs", "r+b");
+        rc = SQLITE_IOERR;
+        if (aStored && fp && fseek(fp, (long)entry.physical_offset, SEEK_SET) == 0 &&
+            fread(aStored, entry.compressed_size, 1, fp) == 1) {
+            // Truncate the block: its checksum is made to match, decoding must still notice
+            memset(aStored + entry.compressed_size / 2, 0, entry.compressed_size - entry.compressed_size / 2);
+            entry.original_size = 4096;
+            entry.checksum = ccvfs_crc32(aStored, (int)entry.compressed_size);
+            if (fseek(fp, (long)entry.physical_offset, SEEK_SET) == 0 &&
+                fwrite(aStored, entry.compressed_size, 1, fp) == 1) {
+                rc = SQLITE_OK;
+            }
+        }
+        if (fp) fclose(fp);
+        free(aStored);
+        if (rc == SQLITE_OK && !verify_index_entry("test_verify.ccvfs", 3, &entry, 1)) rc = SQLITE_IOERR;
+    }
+    int notadb = sqlite3_ccvfs_verify("test_verify.db", NULL, &clean);
+    if (rc == SQLITE_OK) rc = sqlite3_ccvfs_verify("test_verify.ccvfs", &options, &found);
+    if (notadb == SQLITE_NOTADB &&
+        ((entry.flags & CCVFS_PAGE_COMPRESSED)
+             ? rc == SQLITE_CORRUPT && found.decode_errors == 1 && found.checksum_errors == 0 &&
+               found.corrupt_blocks[0] == 3
+             : rc == SQLITE_OK)) {
+        result->passed++;
+        snprintf(result->message, sizeof(result->message), "%u blocks verified on %d threads",
+                found.stored_blocks, found.threads);
+    } else {
+        snprintf(result->message, sizeof(result->message), "Decode error not found: rc=%d, notadb=%d, %u decode errors",
+                rc, notadb, found.decode_errors);
+    }
+    
+done:
+    sqlite3_close(db);
+    sqlite3_ccvfs_destroy("verify_vfs");
+    cleanup_test_files("test_verify");
+    cleanup_test_files("test_verify_live");
+    
+    return (result->passed == result->total) ? 1 : 0;
+}
+
+// 1 when two files have the same bytes from offset skip on
+static int generate_same_bytes(const char *path1, const char *path2, long skip) {
+    FILE *fp1 = fopen(path1, "rb");
+    FILE *fp2 = fopen(path2, "rb");
+    char buf1[8192], buf2[8192];
+    int same = fp1 && fp2 && fseek(fp1, skip, SEEK_SET) == 0 && fseek(fp2, skip, SEEK_SET) == 0;
+    
+    while (same) {
+        size_t n1 = fread(buf1, 1, sizeof(buf1), fp1);
+        size_t n2 = fread(buf2, 1, sizeof(buf2), fp2);
+        if (n1 != n2 || memcmp(buf1, buf2, n1) != 0) same = 0;
+        if (n1 == 0) break;
+    }
+    if (fp1) fclose(fp1);
+    if (fp2) fclose(fp2);
+    return same;
+}
+
+static int generate_same_file(const char *path1, const char *path2) {
+    return generate_same_bytes(path1, path2, 0);
+}
+
+// 1 when two CCVFS files match apart from the creation time in the header and the header checksum covering it
+static int generate_same_ccvfs_file(const char *path1, const char *path2) {
+    CCVFSFileHeader header1, header2;
+    FILE *fp1 = fopen(path1, "rb");
+    FILE *fp2 = fopen(path2, "rb");
+    int same = fp1 && fp2 && fread(&header1, CCVFS_HEADER_SIZE, 1, fp1) == 1 &&
+               fread(&header2, CCVFS_HEADER_SIZE, 1, fp2) == 1;
+    
+    if (fp1) fclose(fp1);
+    if (fp2) fclose(fp2);
+    if (!same) return 0;
+    header1.timestamp = header2.timestamp = 0;
+    header1.header_checksum = header2.header_checksum = 0;
+    return memcmp(&header1, &header2, CCVFS_HEADER_SIZE) == 0 &&
+           generate_same_bytes(path1, path2, CCVFS_HEADER_SIZE);
+}
+
+// Rows of a table, -1 when the query fails
+static int generate_count_rows(const char *path, const char *table) {
+    sqlite3 *db = NULL;
+    sqlite3_stmt *stmt = NULL;
+    char sql[128];
+    int count = -1;
+    
+    snprintf(sql, sizeof(sql), "SELECT count(*) FROM %s", table);
+    if (sqlite3_open_v2(path, &db, SQLITE_OPEN_READONLY, NULL) == SQLITE_OK &&
+        sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW) {
+        count = sqlite3_column_int(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+    return count;
+}
+
+// Parallel Generate Test
+int test_parallel_generate(TestResult* result) {
+    result->name = "Parallel Generate Test";
+    result->passed = 0;
+    result->total = 4;
+    strcpy(result->message, "");
+    
+    const char *files[] = { "test_pgen1", "test_pgen3", "test_pgen_seed", "test_pgen_c1", "test_pgen_c3",
+                            "test_pgen_s1_users", "test_pgen_s1_products", "test_pgen_s1_orders",
+                            "test_pgen_s2_users", "test_pgen_s2_products", "test_pgen_s2_orders" };
+    size_t f;
+    for (f = 0; f < sizeof(files) / sizeof(files[0]); f++) {
+        cleanup_test_files(files[f]);
+    }
+    init_test_algorithms();
+    
+    GeneratorConfig config;
+    int rc, rc2;
+    sqlite3_ccvfs_init_generator_config(&config);
+    config.target_size = 1024 * 1024;
+    config.table_count = 3;
+    config.data_mode = DATA_MODE_MIXED;
+    config.seed = 42;
+    
+    // The same seed gives the same file on one thread and on a writer fed by workers
+    config.output_file = "test_pgen1.db";
+    config.threads = 1;
+    rc = sqlite3_ccvfs_generate_database(&config);
+    config.output_file = "test_pgen3.db";
+    config.threads = 4;
+    rc2 = sqlite3_ccvfs_generate_database(&config);
+    int users = generate_count_rows("test_pgen1.db", "users");
+    if (rc == SQLITE_OK && rc2 == SQLITE_OK && users > 0 && generate_same_file("test_pgen1.db", "test_pgen3.db")) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message), "Threaded output differs: rc=%d/%d, %d users", rc, rc2, users);
+        goto done;
+    }
+    
+    // Another seed changes the content but not the shape
+    config.output_file = "test_pgen_seed.db";
+    config.seed = 43;
+    rc = sqlite3_ccvfs_generate_database(&config);
+    config.seed = 42;
+    if (rc == SQLITE_OK && generate_count_rows("test_pgen_seed.db", "orders") > 0 &&
+        !generate_same_file("test_pgen1.db", "test_pgen_seed.db")) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message), "Seed had no effect: rc=%d", rc);
+        goto done;
+    }
+    
+    // Compressed output is just as reproducible apart from the creation time in the header, and verifies block by block
+    config.use_compression = 1;
+    config.target_size = 2 * 1024 * 1024;
+    config.output_file = "test_pgen_c1.db";
+    config.threads = 1;
+    rc = sqlite3_ccvfs_generate_database(&config);
+    config.output_file = "test_pgen_c3.db";
+    config.threads = 3;
+    rc2 = sqlite3_ccvfs_generate_database(&config);
+    CCVFSVerifyResult verified;
+    int checked = sqlite3_ccvfs_verify("test_pgen_c3.db", NULL, &verified);
+    config.use_compression = 0;
+    if (rc == SQLITE_OK && rc2 == SQLITE_OK && checked == SQLITE_OK && verified.stored_blocks > 1 &&
+        generate_same_ccvfs_file("test_pgen_c1.db", "test_pgen_c3.db")) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message), "Compressed output failed: rc=%d/%d, verify=%d",
+                rc, rc2, checked);
+        goto done;
+    }
+    
+    // Split tables land in their own databases, built side by side, with the same rows on any thread count
+    config.target_size = 512 * 1024;
+    config.table_count = 3;
+    config.split_tables = 1;
+    config.output_file = "test_pgen_s1.db";
+    config.threads = 1;
+    rc = sqlite3_ccvfs_generate_database(&config);
+    config.output_file = "test_pgen_s2.db";
+    config.threads = 3;
+    rc2 = sqlite3_ccvfs_generate_database(&config);
+    int split_users = generate_count_rows("test_pgen_s2_users.db", "users");
+    int split_orders = generate_count_rows("test_pgen_s2_orders.db", "orders");
+    int stray = generate_count_rows("test_pgen_s2_users.db", "orders");
+    if (rc == SQLITE_OK && rc2 == SQLITE_OK && split_users > 0 && split_orders > 0 && stray < 0 &&
+        generate_same_file("test_pgen_s1_users.db", "test_pgen_s2_users.db") &&
+        generate_same_file("test_pgen_s1_orders.db", "test_pgen_s2_orders.db")) {
+        result->passed++;
+        snprintf(result->message, sizeof(result->message), "%d users, %d users and %d orders split", users,
+                split_users, split_orders);
+    } else {
+        snprintf(result->message, sizeof(result->message), "Split output failed: rc=%d/%d, %d users, %d orders",
+                rc, rc2, split_users, split_orders);
+    }
+    
+done:
+    for (f = 0; f < sizeof(files) / sizeof(files[0]); f++) {
+        cleanup_test_files(files[f]);
+    }
+    
+    return (result->passed == result->total) ? 1 : 0;
+}
+
+// 1 when the stored blocks of a CCVFS file lie back to back in block order
+static int recompress_in_block_order(const char *path) {
+    CCVFSFileHeader header;
+    CCVFSPageIndex entry;
+    uint64_t iNext = CCVFS_DATA_PAGES_OFFSET;
+    uint32_t i;
+    FILE *fp = fopen(path, "rb");
+    int ordered = fp && fread(&header, CCVFS_HEADER_SIZE, 1, fp) == 1 &&
+                  fseek(fp, (long)CCVFS_INDEX_TABLE_OFFSET, SEEK_SET) == 0;
+    
+    for (i = 0; ordered && i < header.total_pages; i++) {
+        if (fread(&entry, sizeof(entry), 1, fp) != 1) {
+            ordered = 0;
+        } else if (entry.compressed_size > 0) {
+            ordered = entry.physical_offset == iNext;
+            iNext += entry.compressed_size;
+        }
+    }
+    if (fp) fclose(fp);
+    return ordered;
+}
+
+static long recompress_file_size(const char *path) {
+    FILE *fp = fopen(path, "rb");
+    long size = fp && fseek(fp, 0, SEEK_END) == 0 ? ftell(fp) : -1;
+    if (fp) fclose(fp);
+    return size;
+}
+
+typedef struct {
+    ProgressLog log;
+    sqlite3 *writer;              // Commits once in the middle of the copy
+    int rc;
+} RecompressLive;
+
+static void recompress_live_progress(void *pArg, uint32_t nDone, uint32_t nTotal) {
+    RecompressLive *live = (RecompressLive *)pArg;
+    log_progress(&live->log, nDone, nTotal);
+    if (live->log.calls == 1) {
+        live->rc = sqlite3_exec(live->writer,
+            "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 100) "
+            "INSERT INTO t (name, data) SELECT 'during copy', randomblob(200) FROM n", NULL, NULL, NULL);
+    }
+}
+
+// Recompress Test: CCVFS to CCVFS with another block size, level or key, from a live snapshot
+int test_recompress(TestResult* result) {
+    result->name = "Recompress Test";
+    result->passed = 0;
+    result->total = 5;
+    strcpy(result->message, "");
+    
+    const char *files[] = { "test_recomp", "test_recomp_reader", "test_recomp_plain", "test_recomp_small", "test_recomp_key",
+                            "test_recomp_key2", "test_recomp_bad", "test_recomp_badout" };
+    size_t f;
+    for (f = 0; f < sizeof(files) / sizeof(files[0]); f++) {
+        cleanup_test_files(files[f]);
+    }
+    init_test_algorithms();
+    
+    sqlite3 *db = NULL;
+    sqlite3 *reader = NULL;
+    char rows[64];
+    char value[256];
+    RecompressLive live;
+    CCVFSRecompressOptions options;
+    CCVFSCompressOptions compress;
+    CCVFSVerifyResult verified;
+    
+    // A file the VFS rewrote in place, blocks out of physical order, its last transaction in the
+    // WAL of an open writer that commits again while the copy runs
+#ifdef HAVE_ZLIB
+    int rc = sqlite3_ccvfs_create("recompress_vfs", NULL, CCVFS_COMPRESS_ZLIB, NULL, 4096, CCVFS_CREATE_REALTIME);
+#else
+    int rc = sqlite3_ccvfs_create("recompress_vfs", NULL, NULL, NULL, 4096, CCVFS_CREATE_REALTIME);
+#endif
+    memset(&live, 0, sizeof(live));
+    live.log.ordered = 1;
+    if (rc == SQLITE_OK) rc = sqlite3_open_v2("test_recomp.db", &live.writer,
+                                              SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, "recompress_vfs");
+    if (rc == SQLITE_OK) rc = sqlite3_exec(live.writer,
+        "CREATE TABLE t (id INTEGER PRIMARY KEY, name TEXT, data BLOB);"
+        "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 5000) "
+        "INSERT INTO t SELECT i, 'row ' || i, zeroblob(100) FROM n;"
+        "UPDATE t SET data = randomblob(300) WHERE id % 3 = 0;"
+        "PRAGMA journal_mode=WAL;"
+        "UPDATE t SET name = 'wal only' WHERE id % 10 = 0;", NULL, NULL, NULL);
+    if (rc == SQLITE_OK) rc = tools_query_text(live.writer,
+        "SELECT count(*) || '/' || sum(name = 'wal only') || '/' || sum(length(data)) FROM t", rows, sizeof(rows));
+    memset(&options, 0, sizeof(options));
+    options.page_size = 16384;
+    options.compression_level = 9;
+    options.threads = 3;
+    options.xProgress = recompress_live_progress;
+    options.pProgressArg = &live;
+    if (rc == SQLITE_OK) rc = sqlite3_ccvfs_recompress("test_recomp.db", "test_recomp.ccvfs", &options);
+    int checked = rc == SQLITE_OK ? sqlite3_ccvfs_verify("test_recomp.ccvfs", NULL, &verified) : rc;
+    int ordered = recompress_in_block_order("test_recomp.ccvfs");
+    if (rc == SQLITE_OK) rc = sqlite3_ccvfs_decompress_database_parallel("test_recomp.ccvfs", "test_recomp_restored.db", NULL);
+    if (rc == SQLITE_OK) rc = sqlite3_open("test_recomp_restored.db", &db);
+    if (rc == SQLITE_OK) rc = tools_query_text(db,
+        "SELECT count(*) || '/' || sum(name = 'wal only') || '/' || sum(length(data)) FROM t", value, sizeof(value));
+    int snapshot = rc == SQLITE_OK && strcmp(value, rows) == 0;
+    if (rc == SQLITE_OK) rc = tools_query_text(db, "PRAGMA integrity_check", value, sizeof(value));
+    sqlite3_close(db);
+    db = NULL;
+    if (rc == SQLITE_OK && live.rc == SQLITE_OK && snapshot && strcmp(value, "ok") == 0 && checked == SQLITE_OK &&
+        verified.block_size == 16384 && ordered && live.log.ordered && live.log.last == live.log.total) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message),
+                "Live recompression failed: rc=%d, writer=%d, snapshot=%d (%s), verify=%d, ordered=%d/%d",
+                rc, live.rc, snapshot, rows, checked, ordered, live.log.ordered);
+        goto done;
+    }
+    
+    // Another connection keeps a read transaction open on the latest snapshot, so the WAL cannot
+    // be truncated, but all of its frames can be backfilled and the copy goes ahead
+    rc = sqlite3_exec(live.writer, "UPDATE t SET name = 'reader' WHERE id % 10 = 5;", NULL, NULL, NULL);
+    if (rc == SQLITE_OK) rc = sqlite3_open_v2("test_recomp.db", &reader, SQLITE_OPEN_READONLY, "recompress_vfs");
+    if (rc == SQLITE_OK) rc = sqlite3_exec(reader, "BEGIN", NULL, NULL, NULL);
+    if (rc == SQLITE_OK) rc = tools_query_text(reader,
+        "SELECT count(*) || '/' || sum(name = 'reader') || '/' || sum(length(data)) FROM t", rows, sizeof(rows));
+    memset(&options, 0, sizeof(options));
+    options.threads = 2;
+    if (rc == SQLITE_OK) rc = sqlite3_ccvfs_recompress("test_recomp.db", "test_recomp_reader.ccvfs", &options);
+    long nWal = recompress_file_size("test_recomp.db-wal");
+    if (rc == SQLITE_OK) rc = sqlite3_ccvfs_decompress_database_parallel("test_recomp_reader.ccvfs",
+                                                                         "test_recomp_reader.db", NULL);
+    if (rc == SQLITE_OK) rc = sqlite3_open("test_recomp_reader.db", &db);
+    if (rc == SQLITE_OK) rc = tools_query_text(db,
+        "SELECT count(*) || '/' || sum(name = 'reader') || '/' || sum(length(data)) FROM t", value, sizeof(value));
+    sqlite3_close(db);
+    db = NULL;
+    sqlite3_close(reader);
+    reader = NULL;
+    if (rc == SQLITE_OK && nWal > 0 && strcmp(value, rows) == 0) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message),
+                "Recompression next to an open reader failed: rc=%d, WAL %ld bytes, rows %s",
+                rc, nWal, rows);
+        goto done;
+    }
+    
+    // Down to 1KB blocks and back up to 64KB without compression, byte for byte
+    rc = sqlite3_open("test_recomp_plain.db", &db);
+    if (rc == SQLITE_OK) rc = sqlite3_exec(db,
+        "CREATE TABLE t (id INTEGER PRIMARY KEY, name TEXT, data BLOB);"
+        "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 20000) "
+        "INSERT INTO t SELECT i, 'row ' || (i % 100), randomblob(50 + i % 100) FROM n;"
+        "DELETE FROM t WHERE id % 7 = 0;", NULL, NULL, NULL);
+    sqlite3_close(db);
+    db = NULL;
+    memset(&compress, 0, sizeof(compress));
+    compress.compress_algorithm = "zlib";
+    if (rc == SQLITE_OK) rc = sqlite3_ccvfs_compress_database_parallel("test_recomp_plain.db", "test_recomp_plain.ccvfs",
+                                                                       &compress);
+    memset(&options, 0, sizeof(options));
+    options.page_size = 1024;
+    options.compression_level = 1;
+    if (rc == SQLITE_OK) rc = sqlite3_ccvfs_recompress("test_recomp_plain.ccvfs", "test_recomp_small.ccvfs", &options);
+    int smallChecked = rc == SQLITE_OK ? sqlite3_ccvfs_verify("test_recomp_small.ccvfs", NULL, &verified) : rc;
+    uint32_t smallBlocks = verified.stored_blocks;
+    memset(&options, 0, sizeof(options));
+    options.page_size = 65536;
+    options.compress_algorithm = "none";
+    options.threads = 2;
+    if (rc == SQLITE_OK) rc = sqlite3_ccvfs_recompress("test_recomp_small.ccvfs", "test_recomp_plain.ccvfs", &options);
+    if (rc == SQLITE_OK) rc = sqlite3_ccvfs_decompress_database_parallel("test_recomp_plain.ccvfs",
+                                                                         "test_recomp_plain_restored.db", NULL);
+    if (rc == SQLITE_OK && smallChecked == SQLITE_OK && verified.block_size == 1024 && smallBlocks > 64 &&
+        files_equal_from("test_recomp_plain.db", "test_recomp_plain_restored.db", 0)) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message), "Block size round trip failed: rc=%d, verify=%d, %u blocks",
+                rc, smallChecked, smallBlocks);
+        goto done;
+    }
+    
+#ifdef HAVE_OPENSSL
+    // The source key opens the source, the target gets another algorithm and key
+    static const unsigned char key1[16] = "recompress-key-1";
+    static const unsigned char key2[32] = "recompress-key-2-for-aes256-abc";
+    CCVFSDecompressOptions restore;
+    memset(&compress, 0, sizeof(compress));
+    compress.compress_algorithm = "zlib";
+    compress.encrypt_algorithm = "aes128";
+    compress.key = key1;
+    compress.key_len = sizeof(key1);
+    rc = sqlite3_ccvfs_compress_database_parallel("test_recomp_plain.db", "test_recomp_key.ccvfs", &compress);
+    memset(&options, 0, sizeof(options));
+    options.encrypt_algorithm = "aes256";
+    options.target_key = key2;
+    options.target_key_len = sizeof(key2);
+    int noKey = sqlite3_ccvfs_recompress("test_recomp_key.ccvfs", "test_recomp_key2.ccvfs", &options);
+    int noKeyOutput = restore_output_exists("test_recomp_key2.ccvfs");
+    options.key = key1;
+    options.key_len = sizeof(key1);
+    if (rc == SQLITE_OK) rc = sqlite3_ccvfs_recompress("test_recomp_key.ccvfs", "test_recomp_key2.ccvfs", &options);
+    memset(&restore, 0, sizeof(restore));
+    restore.key = key1;
+    restore.key_len = sizeof(key1);
+    int oldKey = sqlite3_ccvfs_decompress_database_parallel("test_recomp_key2.ccvfs", "test_recomp_key2_restored.db",
+                                                            &restore);
+    restore.key = key2;
+    restore.key_len = sizeof(key2);
+    if (rc == SQLITE_OK) rc = sqlite3_ccvfs_decompress_database_parallel("test_recomp_key2.ccvfs",
+                                                                         "test_recomp_key2_restored.db", &restore);
+    if (rc == SQLITE_OK && noKey == SQLITE_MISUSE && !noKeyOutput && oldKey != SQLITE_OK &&
+        files_equal_from("test_recomp_plain.db", "test_recomp_key2_restored.db", 0)) {
+        result->passed++;
+    } else {
+        snprintf(result->message, sizeof(result->message), "Rekeying failed: rc=%d, no key=%d/%d, old key=%d",
+                rc, noKey, noKeyOutput, oldKey);
+        goto done;
+    }
+#else
+    result->passed++;
+#endif
+    
+    // A damaged block fails its checksum and leaves no output behind, the source is never the target
+    rc = sqlite3_ccvfs_compress_database_parallel("test_recomp_plain.db", "test_recomp_bad.ccvfs", NULL);
+    if (rc == SQLITE_OK && flip_file_byte("test_recomp_bad.ccvfs", (long)CCVFS_DATA_PAGES_OFFSET + 100)) {
+        rc = sqlite3_ccvfs_recompress("test_recomp_bad.ccvfs", "test_recomp_badout.ccvfs", NULL);
+    }
+    int self = sqlite3_ccvfs_recompress("test_recomp_plain.ccvfs", "test_recomp_plain.ccvfs", NULL);
+    if (rc == SQLITE_CORRUPT && !restore_output_exists("test_recomp_badout.ccvfs") && self == SQLITE_MISUSE) {
+        result->passed++;
+        snprintf(result->message, sizeof(result->message), "%u blocks of 1KB, live copy in %u progress calls",
+                smallBlocks, live.log.calls);
+    } else {
+        snprintf(result->message, sizeof(result->message), "Damaged block not detected: rc=%d, self=%d", rc, self);
+    }
+    
+done:
+    sqlite3_close(db);
+    sqlite3_close(reader);
+    sqlite3_close(live.writer);
+    sqlite3_ccvfs_destroy("recompress_vfs");
+    for (f = 0; f < sizeof(files) / sizeof(files[0]); f++) {
+        cleanup_test_files(files[f]);
+    }
+    
+    return (result->passed == result->total) ? 1 : 0;
+}
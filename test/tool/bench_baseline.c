@@ -0,0 +1,519 @@
+#include "bench_baseline.h"
+#include "ccvfs.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * 基准线存储和回归比较
+ * Benchmark baseline store and regression comparison
+ */
+
+// 构建信息由CMake在配置时传入
+// Build metadata is passed in by CMake at configure time
+#ifndef CCVFS_GIT_HASH
+#define CCVFS_GIT_HASH "unknown"
+#endif
+#ifndef CCVFS_BUILD_FLAGS
+#define CCVFS_BUILD_FLAGS ""
+#endif
+#ifndef CCVFS_BUILD_TYPE
+#define CCVFS_BUILD_TYPE ""
+#endif
+
+#define BENCH_BASELINE_MAX_FILE  (16 * 1024 * 1024)
+
+static void bench_copy_string(char *zDst, size_t nDst, const char *zSrc) {
+    snprintf(zDst, nDst, "%s", zSrc ? zSrc : "");
+}
+
+/*
+ * 从/proc/cpuinfo读取CPU型号（x86为"model name"，ARM为"Hardware"或"CPU part"）
+ * Read the CPU model from /proc/cpuinfo ("model name" on x86, "Hardware" or "CPU part" on ARM)
+ */
+static void bench_get_cpu_model(char *zModel, size_t nModel) {
+    static const char *keys[] = { "model name", "Hardware", "cpu model", "CPU part" };
+    char zLine[256];
+    FILE *f;
+
+    bench_copy_string(zModel, nModel, "unknown");
+    f = fopen("/proc/cpuinfo", "r");
+    if (!f) return;
+
+    for (int k = 0; k < (int)(sizeof(keys) / sizeof(keys[0])); k++) {
+        rewind(f);
+        while (fgets(zLine, sizeof(zLine), f)) {
+            char *zColon = strchr(zLine, ':');
+            if (!zColon || strncmp(zLine, keys[k], strlen(keys[k])) != 0) continue;
+
+            char *zValue = zColon + 1;
+            while (*zValue == ' ' || *zValue == '\t') zValue++;
+            zValue[strcspn(zValue, "\r\n")] = '\0';
+            bench_copy_string(zModel, nModel, zValue);
+            fclose(f);
+            return;
+        }
+    }
+    fclose(f);
+}
+
+void bench_get_build_info(BenchBuildInfo *pInfo) {
+    memset(pInfo, 0, sizeof(*pInfo));
+    bench_copy_string(pInfo->git_hash, sizeof(pInfo->git_hash), CCVFS_GIT_HASH);
+#if defined(__clang__)
+    snprintf(pInfo->compiler, sizeof(pInfo->compiler), "clang %s", __clang_version__);
+#elif defined(__GNUC__)
+    snprintf(pInfo->compiler, sizeof(pInfo->compiler), "gcc %s", __VERSION__);
+#elif defined(_MSC_VER)
+    snprintf(pInfo->compiler, sizeof(pInfo->compiler), "msvc %d", _MSC_VER);
+#else
+    bench_copy_string(pInfo->compiler, sizeof(pInfo->compiler), "unknown");
+#endif
+    bench_copy_string(pInfo->flags, sizeof(pInfo->flags), CCVFS_BUILD_FLAGS);
+    bench_copy_string(pInfo->build_type, sizeof(pInfo->build_type), CCVFS_BUILD_TYPE);
+    bench_get_cpu_model(pInfo->cpu_model, sizeof(pInfo->cpu_model));
+    pInfo->cpu_count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+}
+
+void bench_metric_set_init(BenchMetricSet *pSet, const char *zMode, const char *zConfig) {
+    memset(pSet, 0, sizeof(*pSet));
+    bench_get_build_info(&pSet->build);
+    bench_copy_string(pSet->mode, sizeof(pSet->mode), zMode);
+    bench_copy_string(pSet->config, sizeof(pSet->config), zConfig);
+}
+
+void bench_metric_set_free(BenchMetricSet *pSet) {
+    free(pSet->metrics);
+    pSet->metrics = NULL;
+    pSet->n_metrics = 0;
+    pSet->n_alloc = 0;
+}
+
+static BenchMetric *bench_metric_find(const BenchMetricSet *pSet, const char *zName) {
+    for (int i = 0; i < pSet->n_metrics; i++) {
+        if (strcmp(pSet->metrics[i].name, zName) == 0) return &pSet->metrics[i];
+    }
+    return NULL;
+}
+
+static BenchMetric *bench_metric_append(BenchMetricSet *pSet, const char *zName, int higher_is_better) {
+    if (pSet->n_metrics == pSet->n_alloc) {
+        int nNew = pSet->n_alloc ? pSet->n_alloc * 2 : 64;
+        BenchMetric *aNew = realloc(pSet->metrics, (size_t)nNew * sizeof(BenchMetric));
+        if (!aNew) return NULL;
+        pSet->metrics = aNew;
+        pSet->n_alloc = nNew;
+    }
+
+    BenchMetric *pMetric = &pSet->metrics[pSet->n_metrics++];
+    memset(pMetric, 0, sizeof(*pMetric));
+    bench_copy_string(pMetric->name, sizeof(pMetric->name), zName);
+    pMetric->higher_is_better = higher_is_better;
+    return pMetric;
+}
+
+int bench_metric_add(BenchMetricSet *pSet, const char *zName, int higher_is_better, double value) {
+    BenchMetric *pMetric = bench_metric_find(pSet, zName);
+    if (!pMetric) {
+        pMetric = bench_metric_append(pSet, zName, higher_is_better);
+        if (!pMetric) return -1;
+    }
+
+    // Welford在线更新均值和离差平方和
+    // Welford online update of the mean and the sum of squared deviations
+    pMetric->n++;
+    double delta = value - pMetric->mean;
+    pMetric->mean += delta / pMetric->n;
+    pMetric->m2 += delta * (value - pMetric->mean);
+    return 0;
+}
+
+/*
+ * 双侧95%的t分布分位数
+ * Two-sided 95% quantile of Student's t distribution
+ */
+static double bench_t95(double df) {
+    static const double table[] = {
+        12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+    };
+    int i = (int)df;
+
+    if (i < 1) return 0;
+    if (i <= 30) return table[i - 1];
+    if (i <= 60) return 2.000;
+    if (i <= 120) return 1.980;
+    return 1.960;
+}
+
+void bench_metric_finish(BenchMetricSet *pSet) {
+    for (int i = 0; i < pSet->n_metrics; i++) {
+        BenchMetric *pMetric = &pSet->metrics[i];
+        if (pMetric->n > 1) {
+            pMetric->stddev = sqrt(pMetric->m2 / (pMetric->n - 1));
+            pMetric->ci95 = bench_t95(pMetric->n - 1) * pMetric->stddev / sqrt((double)pMetric->n);
+        } else {
+            pMetric->stddev = 0;
+            pMetric->ci95 = 0;
+        }
+    }
+}
+
+static void bench_print_json_string(FILE *out, const char *z) {
+    fputc('"', out);
+    for (; *z; z++) {
+        unsigned char ch = (unsigned char)*z;
+        if (ch == '"' || ch == '\\') {
+            fprintf(out, "\\%c", ch);
+        } else if (ch < 0x20) {
+            fprintf(out, "\\u%04x", ch);
+        } else {
+            fputc(ch, out);
+        }
+    }
+    fputc('"', out);
+}
+
+void bench_print_build(FILE *out, const BenchBuildInfo *pInfo) {
+    fprintf(out, "  \"build\": {\n");
+    fprintf(out, "    \"git_hash\": ");
+    bench_print_json_string(out, pInfo->git_hash);
+    fprintf(out, ",\n    \"compiler\": ");
+    bench_print_json_string(out, pInfo->compiler);
+    fprintf(out, ",\n    \"flags\": ");
+    bench_print_json_string(out, pInfo->flags);
+    fprintf(out, ",\n    \"build_type\": ");
+    bench_print_json_string(out, pInfo->build_type);
+    fprintf(out, ",\n    \"cpu_model\": ");
+    bench_print_json_string(out, pInfo->cpu_model);
+    fprintf(out, ",\n    \"cpu_count\": %d\n", pInfo->cpu_count);
+    fprintf(out, "  },\n");
+}
+
+static void bench_print_metric(FILE *out, const BenchMetric *pMetric, int first) {
+    fprintf(out, "%s    {\"name\": ", first ? "" : ",\n");
+    bench_print_json_string(out, pMetric->name);
+    fprintf(out, ", \"better\": \"%s\", \"n\": %d, \"mean\": %.9g, \"stddev\": %.9g, \"ci95\": %.9g}",
+            pMetric->higher_is_better ? "higher" : "lower", pMetric->n, pMetric->mean,
+            pMetric->stddev, pMetric->ci95);
+}
+
+void bench_print_summary(FILE *out, const BenchMetricSet *pSet) {
+    fprintf(out, "  \"summary\": [\n");
+    for (int i = 0; i < pSet->n_metrics; i++) {
+        bench_print_metric(out, &pSet->metrics[i], i == 0);
+    }
+    fprintf(out, "%s  ],\n", pSet->n_metrics ? "\n" : "");
+}
+
+int bench_baseline_save(const char *zPath, const BenchMetricSet *pSet) {
+    char zTime[32];
+    time_t now = time(NULL);
+    FILE *out = fopen(zPath, "w");
+
+    if (!out) return -1;
+    strftime(zTime, sizeof(zTime), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+    fprintf(out, "{\n");
+    fprintf(out, "  \"tool\": \"ccvfs_bench\",\n");
+    fprintf(out, "  \"mode\": ");
+    bench_print_json_string(out, pSet->mode);
+    fprintf(out, ",\n  \"timestamp\": \"%s\",\n", zTime);
+    fprintf(out, "  \"ccvfs_version\": \"%d.%d\",\n", CCVFS_VERSION_MAJOR, CCVFS_VERSION_MINOR);
+    fprintf(out, "  \"config_signature\": ");
+    bench_print_json_string(out, pSet->config);
+    fprintf(out, ",\n");
+    bench_print_build(out, &pSet->build);
+    fprintf(out, "  \"metrics\": [\n");
+    for (int i = 0; i < pSet->n_metrics; i++) {
+        bench_print_metric(out, &pSet->metrics[i], i == 0);
+    }
+    fprintf(out, "%s  ]\n", pSet->n_metrics ? "\n" : "");
+    fprintf(out, "}\n");
+
+    return fclose(out) == 0 ? 0 : -1;
+}
+
+/*
+ * 读取基准线文件的最小JSON扫描器：只支持本文件写出的结构（对象、数组、字符串、数字、字面量）
+ * Minimal JSON scanner for reading baseline files: objects, arrays, strings, numbers and
+ * literals, enough for the structure written above
+ */
+static const char *json_skip_ws(const char *z) {
+    while (*z == ' ' || *z == '\t' || *z == '\r' || *z == '\n') z++;
+    return z;
+}
+
+static const char *json_skip_string(const char *z) {
+    if (*z != '"') return NULL;
+    for (z++; *z && *z != '"'; z++) {
+        if (*z == '\\' && z[1]) z++;
+    }
+    return *z == '"' ? z + 1 : NULL;
+}
+
+static const char *json_skip_value(const char *z) {
+    z = json_skip_ws(z);
+    if (*z == '"') return json_skip_string(z);
+    if (*z == '{' || *z == '[') {
+        int depth = 0;
+        while (*z) {
+            if (*z == '"') {
+                z = json_skip_string(z);
+                if (!z) return NULL;
+                continue;
+            }
+            if (*z == '{' || *z == '[') depth++;
+            if (*z == '}' || *z == ']') {
+                if (--depth == 0) return z + 1;
+            }
+            z++;
+        }
+        return NULL;
+    }
+    while (*z && *z != ',' && *z != '}' && *z != ']') z++;
+    return z;
+}
+
+// 在对象zObj（指向'{'）中查找键，返回值的起始位置
+// Find a key in the object zObj (pointing at '{'), returns the start of its value
+static const char *json_find_key(const char *zObj, const char *zKey) {
+    const char *z = json_skip_ws(zObj);
+    size_t nKey = strlen(zKey);
+
+    if (*z != '{') return NULL;
+    z = json_skip_ws(z + 1);
+    while (*z == '"') {
+        const char *zEnd = json_skip_string(z);
+        if (!zEnd) return NULL;
+        int match = (size_t)(zEnd - z - 2) == nKey && strncmp(z + 1, zKey, nKey) == 0;
+
+        z = json_skip_ws(zEnd);
+        if (*z != ':') return NULL;
+        z = json_skip_ws(z + 1);
+        if (match) return z;
+
+        z = json_skip_value(z);
+        if (!z) return NULL;
+        z = json_skip_ws(z);
+        if (*z != ',') return NULL;
+        z = json_skip_ws(z + 1);
+    }
+    return NULL;
+}
+
+static int json_get_string(const char *zValue, char *zBuf, size_t nBuf) {
+    size_t n = 0;
+
+    if (!zValue || *zValue != '"' || nBuf == 0) return -1;
+    for (const char *z = zValue + 1; *z && *z != '"'; z++) {
+        char ch = *z;
+        if (ch == '\\' && z[1]) {
+            z++;
+            ch = *z == 'n' ? '\n' : *z == 't' ? '\t' : *z;
+        }
+        if (n + 1 < nBuf) zBuf[n++] = ch;
+    }
+    zBuf[n] = '\0';
+    return 0;
+}
+
+static int json_get_number(const char *zValue, double *pValue) {
+    char *zEnd;
+
+    if (!zValue) return -1;
+    *pValue = strtod(zValue, &zEnd);
+    return zEnd == zValue ? -1 : 0;
+}
+
+static char *bench_read_file(const char *zPath) {
+    FILE *f = fopen(zPath, "rb");
+    char *zData = NULL;
+    long nData;
+
+    if (!f) return NULL;
+    if (fseek(f, 0, SEEK_END) == 0 && (nData = ftell(f)) >= 0 && nData <= BENCH_BASELINE_MAX_FILE &&
+        fseek(f, 0, SEEK_SET) == 0) {
+        zData = malloc((size_t)nData + 1);
+        if (zData && fread(zData, 1, (size_t)nData, f) == (size_t)nData) {
+            zData[nData] = '\0';
+        } else {
+            free(zData);
+            zData = NULL;
+        }
+    }
+    fclose(f);
+    return zData;
+}
+
+int bench_baseline_load(const char *zPath, BenchMetricSet *pSet) {
+    char *zData = bench_read_file(zPath);
+    const char *zRoot, *zBuild, *zMetrics;
+    int rc = -1;
+
+    memset(pSet, 0, sizeof(*pSet));
+    if (!zData) return -1;
+
+    zRoot = json_skip_ws(zData);
+    json_get_string(json_find_key(zRoot, "mode"), pSet->mode, sizeof(pSet->mode));
+    json_get_string(json_find_key(zRoot, "config_signature"), pSet->config, sizeof(pSet->config));
+
+    zBuild = json_find_key(zRoot, "build");
+    if (zBuild) {
+        double cpuCount = 0;
+        json_get_string(json_find_key(zBuild, "git_hash"), pSet->build.git_hash, sizeof(pSet->build.git_hash));
+        json_get_string(json_find_key(zBuild, "compiler"), pSet->build.compiler, sizeof(pSet->build.compiler));
+        json_get_string(json_find_key(zBuild, "flags"), pSet->build.flags, sizeof(pSet->build.flags));
+        json_get_string(json_find_key(zBuild, "build_type"), pSet->build.build_type, sizeof(pSet->build.build_type));
+        json_get_string(json_find_key(zBuild, "cpu_model"), pSet->build.cpu_model, sizeof(pSet->build.cpu_model));
+        json_get_number(json_find_key(zBuild, "cpu_count"), &cpuCount);
+        pSet->build.cpu_count = (int)cpuCount;
+    }
+
+    zMetrics = json_find_key(zRoot, "metrics");
+    if (zMetrics && *zMetrics == '[') {
+        const char *z = json_skip_ws(zMetrics + 1);
+        rc = 0;
+        while (*z == '{') {
+            char zName[BENCH_METRIC_NAME_MAX], zBetter[16];
+            double n = 0, mean = 0, stddev = 0, ci95 = 0;
+
+            if (json_get_string(json_find_key(z, "name"), zName, sizeof(zName)) != 0 ||
+                json_get_string(json_find_key(z, "better"), zBetter, sizeof(zBetter)) != 0 ||
+                json_get_number(json_find_key(z, "n"), &n) != 0 ||
+                json_get_number(json_find_key(z, "mean"), &mean) != 0) {
+                rc = -1;
+                break;
+            }
+            json_get_number(json_find_key(z, "stddev"), &stddev);
+            json_get_number(json_find_key(z, "ci95"), &ci95);
+
+            BenchMetric *pMetric = bench_metric_append(pSet, zName, strcmp(zBetter, "higher") == 0);
+            if (!pMetric) {
+                rc = -1;
+                break;
+            }
+            pMetric->n = (int)n;
+            pMetric->mean = mean;
+            pMetric->stddev = stddev;
+            pMetric->m2 = n > 1 ? stddev * stddev * (n - 1) : 0;
+            pMetric->ci95 = ci95;
+
+            z = json_skip_value(z);
+            if (!z) {
+                rc = -1;
+                break;
+            }
+            z = json_skip_ws(z);
+            if (*z == ',') z = json_skip_ws(z + 1);
+        }
+    }
+
+    free(zData);
+    if (rc != 0) bench_metric_set_free(pSet);
+    return rc;
+}
+
+/*
+ * Welch t检验：均值差的95%置信区间半宽
+ * Welch t-test: half width of the 95% confidence interval of the difference of the means
+ */
+static double bench_welch_ci95(const BenchMetric *pA, const BenchMetric *pB) {
+    double va = pA->n > 1 ? pA->stddev * pA->stddev / pA->n : 0;
+    double vb = pB->n > 1 ? pB->stddev * pB->stddev / pB->n : 0;
+    double se = sqrt(va + vb);
+    double denom = 0;
+
+    if (se == 0) return 0;
+    if (pA->n > 1) denom += va * va / (pA->n - 1);
+    if (pB->n > 1) denom += vb * vb / (pB->n - 1);
+    return bench_t95(denom > 0 ? (va + vb) * (va + vb) / denom : 1) * se;
+}
+
+static void bench_warn_build(const char *zField, const char *zBaseline, const char *zCurrent) {
+    if (strcmp(zBaseline, zCurrent) != 0) {
+        fprintf(stderr, "警告: 基准线的%s不同: '%s' -> '%s'\n", zField, zBaseline, zCurrent);
+    }
+}
+
+int bench_baseline_compare(FILE *out, const BenchMetricSet *pBaseline, const BenchMetricSet *pCurrent,
+                           double threshold) {
+    int nRegressions = 0, nImprovements = 0, nPrinted = 0;
+
+    if (strcmp(pBaseline->mode, pCurrent->mode) != 0 || strcmp(pBaseline->config, pCurrent->config) != 0) {
+        fprintf(stderr, "错误: 基准线配置不同，无法比较\n  基准线: %s %s\n  当前:   %s %s\n",
+                pBaseline->mode, pBaseline->config, pCurrent->mode, pCurrent->config);
+        return -1;
+    }
+
+    // 构建或主机不同的基准线仍然比较，但结果可能不可比
+    // A baseline from another build or host still compares, but the numbers may not be comparable
+    bench_warn_build("编译器", pBaseline->build.compiler, pCurrent->build.compiler);
+    bench_warn_build("编译选项", pBaseline->build.flags, pCurrent->build.flags);
+    bench_warn_build("构建类型", pBaseline->build.build_type, pCurrent->build.build_type);
+    bench_warn_build("CPU", pBaseline->build.cpu_model, pCurrent->build.cpu_model);
+
+    fprintf(out, "  \"comparison\": {\n");
+    fprintf(out, "    \"baseline_git_hash\": ");
+    bench_print_json_string(out, pBaseline->build.git_hash);
+    fprintf(out, ",\n    \"threshold\": %.4f,\n", threshold);
+    fprintf(out, "    \"metrics\": [\n");
+
+    for (int i = 0; i < pCurrent->n_metrics; i++) {
+        const BenchMetric *pCur = &pCurrent->metrics[i];
+        const BenchMetric *pBase = bench_metric_find(pBaseline, pCur->name);
+        const char *zStatus = "unchanged";
+        double change = 0;
+
+        if (!pBase) {
+            zStatus = "new";
+        } else if (pBase->mean != 0 || pCur->mean != 0) {
+            // worse > 0表示变差；只有超过阈值且置信区间不含零才算显著
+            // worse > 0 means worse; significant only beyond the threshold with a CI excluding zero
+            double diff = pCur->mean - pBase->mean;
+            double worse = pCur->higher_is_better ? -diff : diff;
+            double half = bench_welch_ci95(pBase, pCur);
+            double scale = pBase->mean != 0 ? fabs(pBase->mean) : fabs(pCur->mean);
+
+            change = diff / scale;
+            if (worse / scale > threshold && worse - half > 0) {
+                zStatus = "regression";
+                nRegressions++;
+                fprintf(stderr, "回归: %s %.6g -> %.6g (%+.1f%%, ±%.6g)\n",
+                        pCur->name, pBase->mean, pCur->mean, change * 100, half);
+            } else if (-worse / scale > threshold && -worse - half > 0) {
+                zStatus = "improvement";
+                nImprovements++;
+            }
+        }
+
+        fprintf(out, "%s      {\"name\": ", nPrinted++ == 0 ? "" : ",\n");
+        bench_print_json_string(out, pCur->name);
+        fprintf(out, ", \"baseline\": %.9g, \"current\": %.9g, \"change\": %.4f, \"status\": \"%s\"}",
+                pBase ? pBase->mean : 0, pCur->mean, change, zStatus);
+    }
+
+    // 基准线中有而本次没有的指标
+    // Metrics of the baseline missing from this run
+    for (int i = 0; i < pBaseline->n_metrics; i++) {
+        const BenchMetric *pBase = &pBaseline->metrics[i];
+        if (bench_metric_find(pCurrent, pBase->name)) continue;
+
+        fprintf(out, "%s      {\"name\": ", nPrinted++ == 0 ? "" : ",\n");
+        bench_print_json_string(out, pBase->name);
+        fprintf(out, ", \"baseline\": %.9g, \"current\": null, \"change\": null, \"status\": \"missing\"}",
+                pBase->mean);
+    }
+
+    fprintf(out, "%s    ],\n", nPrinted ? "\n" : "");
+    fprintf(out, "    \"regressions\": %d,\n", nRegressions);
+    fprintf(out, "    \"improvements\": %d\n", nImprovements);
+    fprintf(out, "  },\n");
+
+    fprintf(stderr, "与基准线 %s 比较: %d 个指标回归, %d 个指标改进 (阈值 %.1f%%)\n",
+            pBaseline->build.git_hash, nRegressions, nImprovements, threshold * 100);
+    return nRegressions;
+}
@@ -0,0 +1,97 @@
+#ifndef BENCH_BASELINE_H
+#define BENCH_BASELINE_H
+
+#include <stdio.h>
+
+/*
+ * 基准线存储和回归比较
+ * Benchmark baseline store and regression comparison
+ *
+ * 每个指标在重复运行中收集样本，汇总为均值、标准差和95%置信区间。
+ * Every metric collects one sample per repeated run, summarized as mean, standard deviation
+ * and 95% confidence interval.
+ * 基准线文件是带构建信息（git提交、编译器、编译选项、CPU）的JSON；与基准线比较时，
+ * 只有变差超过阈值且Welch t检验的置信区间不包含零的指标才算回归。
+ * The baseline file is JSON with build metadata (git commit, compiler, flags, CPU). Against a
+ * baseline, a metric regresses only when it is worse by more than the threshold and the
+ * Welch t-test confidence interval of the difference excludes zero.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BENCH_METRIC_NAME_MAX  128
+
+// 构建和主机信息
+// Build and host metadata
+typedef struct {
+    char git_hash[64];
+    char compiler[128];
+    char flags[512];
+    char build_type[32];
+    char cpu_model[128];
+    int cpu_count;
+} BenchBuildInfo;
+
+// 一个指标的样本和统计
+// Samples and statistics of one metric
+typedef struct {
+    char name[BENCH_METRIC_NAME_MAX];
+    int higher_is_better;
+    int n;
+    double mean;
+    double m2;                  // Sum of squared deviations from the mean (Welford)
+    double stddev;              // Sample standard deviation, 0 for a single sample
+    double ci95;                // Half width of the 95% confidence interval of the mean
+} BenchMetric;
+
+// 一次运行或一个基准线文件的全部指标
+// All metrics of one run or of one baseline file
+typedef struct {
+    BenchBuildInfo build;
+    char mode[16];              // "micro" or "workload"
+    char config[512];           // Configuration signature, only equal signatures compare
+    BenchMetric *metrics;
+    int n_metrics;
+    int n_alloc;
+} BenchMetricSet;
+
+// Fill the build metadata of this binary and host
+void bench_get_build_info(BenchBuildInfo *pInfo);
+
+// Initialize an empty set for the given mode and configuration signature
+void bench_metric_set_init(BenchMetricSet *pSet, const char *zMode, const char *zConfig);
+void bench_metric_set_free(BenchMetricSet *pSet);
+
+// Add one sample of a metric, creating the metric on first use
+int bench_metric_add(BenchMetricSet *pSet, const char *zName, int higher_is_better, double value);
+
+// Compute mean, standard deviation and confidence interval of every metric
+void bench_metric_finish(BenchMetricSet *pSet);
+
+// Print the build metadata and the metric summary as top-level JSON members followed by a comma
+void bench_print_build(FILE *out, const BenchBuildInfo *pInfo);
+void bench_print_summary(FILE *out, const BenchMetricSet *pSet);
+
+// Write or read a baseline file, 0 on success
+int bench_baseline_save(const char *zPath, const BenchMetricSet *pSet);
+int bench_baseline_load(const char *zPath, BenchMetricSet *pSet);
+
+/*
+ * 将当前指标与基准线比较，threshold为相对变差的比例（0.05即5%）
+ * Compare the current metrics with a baseline, threshold is the relative change (0.05 for 5%)
+ * 结果作为"comparison"成员（后跟逗号）写入out，回归摘要写到标准错误；
+ * 返回回归指标数，配置不同时返回-1
+ * The result is written to out as the "comparison" member followed by a comma, and a summary
+ * of regressions to stderr; returns the number of regressed metrics, -1 when the
+ * configurations differ
+ */
+int bench_baseline_compare(FILE *out, const BenchMetricSet *pBaseline, const BenchMetricSet *pCurrent,
+                           double threshold);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BENCH_BASELINE_H */
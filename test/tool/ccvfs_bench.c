@@ -0,0 +1,1581 @@
+#include "ccvfs.h"
+#include "ccvfs_utils.h"
+#include "sqlite3.h"
+#include "db_generator.h"
+#include "db_workload.h"
+#include "shim_vfs.h"
+#include "bench_baseline.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * CCVFS微基准测试工具
+ * CCVFS microbenchmark - measures pages/s and MB/s of the page paths
+ *
+ * 每个用例是页大小 x 压缩算法 x 加密算法 x 数据模式矩阵中的一格，分两层测量：
+ * Every case is one cell of the page size x compression x encryption x data mode matrix,
+ * measured on two layers:
+ *   codec - 与writePage/readPage相同的页面编解码步骤（压缩、加密、CRC32），在内存中进行
+ *           the page encode/decode steps of writePage/readPage (compress, encrypt, CRC32), in memory
+ *   vfs   - 通过CCVFS的xWrite/xRead逐页写入和读取一个文件（顺序写、顺序读、随机读）
+ *           whole pages written and read through CCVFS xWrite/xRead (sequential write,
+ *           sequential read, random read)
+ *
+ * 结果以JSON输出，吞吐量按逻辑（未压缩）字节计算
+ * Results are printed as JSON, throughput is counted in logical (uncompressed) bytes
+ *
+ * workload子命令在db_generator的表上运行YCSB风格的宏观负载（见db_workload.h）
+ * The workload subcommand runs YCSB-style macro workloads on the db_generator tables (see db_workload.h)
+ *
+ * 两种模式都可以重复运行（-R），把指标汇总保存为基准线（--save-baseline），
+ * 或与基准线比较（--baseline），出现回归时退出码为2（见bench_baseline.h）
+ * Both modes can repeat their runs (-R), save the metric summary as a baseline
+ * (--save-baseline) or compare against one (--baseline), exiting with 2 on a regression
+ * (see bench_baseline.h)
+ */
+
+#define BENCH_MAX_AXIS        16
+#define BENCH_DEFAULT_DATA    (8 * 1024 * 1024)
+#define BENCH_DEFAULT_RECORD  200
+#define BENCH_DEFAULT_SEED    20240601u
+#define BENCH_VFS_NAME        "ccvfs_bench"
+#define BENCH_FILE_NAME       "ccvfs_bench.db"
+
+#define BENCH_LAYER_CODEC     (1 << 0)
+#define BENCH_LAYER_VFS       (1 << 1)
+
+#define BENCH_DEFAULT_THRESHOLD  0.05
+#define BENCH_EXIT_REGRESSION    2
+
+// 重复运行和基准线选项，两种模式共用
+// Repetition and baseline options, shared by both modes
+typedef struct {
+    int repeat;                 // Runs of every case
+    const char *baseline;       // Baseline file to compare against
+    const char *save_baseline;  // Baseline file to write
+    double threshold;           // Relative change counted as a regression
+} BenchBaselineOptions;
+
+// 基准测试配置
+// Benchmark configuration
+typedef struct {
+    uint32_t page_sizes[BENCH_MAX_AXIS];
+    int n_page_sizes;
+    const char *compress[BENCH_MAX_AXIS];
+    int n_compress;
+    const char *encrypt[BENCH_MAX_AXIS];
+    int n_encrypt;
+    int modes[BENCH_MAX_AXIS];
+    int n_modes;
+    uint64_t data_bytes;        // Logical bytes per case
+    int record_size;            // Record size used to fill pages
+    int level;                  // Compression level
+    int write_buffer;           // Write buffering of the VFS layer
+    int layers;                 // BENCH_LAYER_*
+    unsigned int seed;
+    const char *dir;
+    const char *output;
+    int verbose;
+    BenchBaselineOptions baseline;
+} BenchConfig;
+
+// 一个阶段的计时
+// Timing of one phase
+typedef struct {
+    double seconds;
+    uint64_t pages;
+    uint64_t bytes;
+} BenchTiming;
+
+// 一个用例的结果
+// Result of one case
+typedef struct {
+    uint32_t page_size;
+    const char *compress;
+    const char *encrypt;
+    int mode;
+    uint32_t pages;
+    uint64_t logical_bytes;
+    uint64_t stored_bytes;      // Encoded page bytes (codec layer)
+    uint64_t file_bytes;        // Size of the written file (vfs layer)
+    uint32_t compressed_pages;  // Pages for which compression paid off
+    BenchTiming encode;
+    BenchTiming decode;
+    BenchTiming write;
+    BenchTiming read_seq;
+    BenchTiming read_rand;
+    int rc;
+    char error[160];
+} BenchResult;
+
+static const unsigned char bench_key[32] = {
+    0x43, 0x43, 0x56, 0x46, 0x53, 0x2d, 0x62, 0x65, 0x6e, 0x63, 0x68, 0x2d, 0x6b, 0x65, 0x79, 0x21,
+    0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef, 0xfe, 0xdc, 0xba, 0x98, 0x76, 0x54, 0x32, 0x10
+};
+
+static double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static uint32_t bench_rand(uint32_t *pState) {
+    uint32_t x = *pState;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *pState = x;
+    return x;
+}
+
+/*
+ * 按名称查找编译进来的算法，"none"表示不使用
+ * Look up compiled-in algorithms by name, "none" means no algorithm
+ * 新的编解码器在这里加一行即可进入矩阵
+ * New codecs join the matrix by adding a line here
+ */
+static int bench_find_compress(const char *name, const CompressAlgorithm **ppAlg) {
+    *ppAlg = NULL;
+    if (strcmp(name, "none") == 0) return 0;
+#ifdef HAVE_ZLIB
+    if (strcmp(name, "zlib") == 0) {
+        *ppAlg = CCVFS_COMPRESS_ZLIB;
+        return 0;
+    }
+#endif
+    return -1;
+}
+
+static int bench_find_encrypt(const char *name, const EncryptAlgorithm **ppAlg) {
+    *ppAlg = NULL;
+    if (strcmp(name, "none") == 0) return 0;
+#ifdef HAVE_OPENSSL
+    if (strcmp(name, "aes128") == 0) {
+        *ppAlg = CCVFS_ENCRYPT_AES128;
+        return 0;
+    }
+    if (strcmp(name, "aes256") == 0) {
+        *ppAlg = CCVFS_ENCRYPT_AES256;
+        return 0;
+    }
+#endif
+    return -1;
+}
+
+static void bench_default_config(BenchConfig *pConfig) {
+    static const uint32_t default_page_sizes[] = {
+        CCVFS_PAGE_SIZE_1KB, CCVFS_PAGE_SIZE_4KB, CCVFS_PAGE_SIZE_16KB,
+        CCVFS_PAGE_SIZE_64KB, CCVFS_PAGE_SIZE_256KB, CCVFS_PAGE_SIZE_1MB
+    };
+
+    memset(pConfig, 0, sizeof(*pConfig));
+    for (int i = 0; i < (int)(sizeof(default_page_sizes) / sizeof(default_page_sizes[0])); i++) {
+        pConfig->page_sizes[pConfig->n_page_sizes++] = default_page_sizes[i];
+    }
+
+    pConfig->compress[pConfig->n_compress++] = "none";
+#ifdef HAVE_ZLIB
+    pConfig->compress[pConfig->n_compress++] = "zlib";
+#endif
+    pConfig->encrypt[pConfig->n_encrypt++] = "none";
+#ifdef HAVE_OPENSSL
+    pConfig->encrypt[pConfig->n_encrypt++] = "aes128";
+    pConfig->encrypt[pConfig->n_encrypt++] = "aes256";
+#endif
+    for (int mode = DATA_MODE_RANDOM; mode <= DATA_MODE_MIXED; mode++) {
+        pConfig->modes[pConfig->n_modes++] = mode;
+    }
+
+    pConfig->data_bytes = BENCH_DEFAULT_DATA;
+    pConfig->record_size = BENCH_DEFAULT_RECORD;
+    pConfig->level = CCVFS_DEFAULT_COMPRESS_LEVEL;
+    pConfig->write_buffer = 1;
+    pConfig->layers = BENCH_LAYER_CODEC | BENCH_LAYER_VFS;
+    pConfig->seed = BENCH_DEFAULT_SEED;
+    pConfig->dir = ".";
+    pConfig->baseline.repeat = 1;
+    pConfig->baseline.threshold = BENCH_DEFAULT_THRESHOLD;
+}
+
+/*
+ * 解析逗号分隔的列表，zList会被就地切分
+ * Split a comma separated list, zList is split in place
+ */
+static int bench_split_list(char *zList, const char **azItem, int nMax) {
+    int n = 0;
+    for (char *zItem = strtok(zList, ","); zItem; zItem = strtok(NULL, ",")) {
+        if (n == nMax) return -1;
+        azItem[n++] = zItem;
+    }
+    return n;
+}
+
+static int bench_parse_page_sizes(char *zList, BenchConfig *pConfig) {
+    const char *azItem[BENCH_MAX_AXIS];
+    int n = bench_split_list(zList, azItem, BENCH_MAX_AXIS);
+    if (n <= 0) return -1;
+
+    for (int i = 0; i < n; i++) {
+        uint32_t pageSize = sqlite3_ccvfs_parse_page_size(azItem[i]);
+        if (pageSize == 0) {
+            fprintf(stderr, "错误: 无效的页大小 '%s'\n", azItem[i]);
+            return -1;
+        }
+        pConfig->page_sizes[i] = pageSize;
+    }
+    pConfig->n_page_sizes = n;
+    return 0;
+}
+
+static int bench_parse_compress(char *zList, BenchConfig *pConfig) {
+    int n = bench_split_list(zList, pConfig->compress, BENCH_MAX_AXIS);
+    if (n <= 0) return -1;
+
+    for (int i = 0; i < n; i++) {
+        const CompressAlgorithm *pAlg;
+        if (bench_find_compress(pConfig->compress[i], &pAlg) != 0) {
+            fprintf(stderr, "错误: 压缩算法 '%s' 不可用\n", pConfig->compress[i]);
+            return -1;
+        }
+    }
+    pConfig->n_compress = n;
+    return 0;
+}
+
+static int bench_parse_encrypt(char *zList, BenchConfig *pConfig) {
+    int n = bench_split_list(zList, pConfig->encrypt, BENCH_MAX_AXIS);
+    if (n <= 0) return -1;
+
+    for (int i = 0; i < n; i++) {
+        const EncryptAlgorithm *pAlg;
+        if (bench_find_encrypt(pConfig->encrypt[i], &pAlg) != 0) {
+            fprintf(stderr, "错误: 加密算法 '%s' 不可用\n", pConfig->encrypt[i]);
+            return -1;
+        }
+    }
+    pConfig->n_encrypt = n;
+    return 0;
+}
+
+static int bench_parse_modes(char *zList, BenchConfig *pConfig) {
+    const char *azItem[BENCH_MAX_AXIS];
+    int n = bench_split_list(zList, azItem, BENCH_MAX_AXIS);
+    if (n <= 0) return -1;
+
+    for (int i = 0; i < n; i++) {
+        int mode = sqlite3_ccvfs_parse_data_mode(azItem[i]);
+        if (mode < 0) {
+            fprintf(stderr, "错误: 无效的数据模式 '%s'\n", azItem[i]);
+            return -1;
+        }
+        pConfig->modes[i] = mode;
+    }
+    pConfig->n_modes = n;
+    return 0;
+}
+
+/*
+ * 解析重复运行和基准线选项（-R、--baseline、--save-baseline、--threshold）
+ * Parse the repetition and baseline options (-R, --baseline, --save-baseline, --threshold)
+ */
+#define BENCH_OPT_BASELINE       1100
+#define BENCH_OPT_SAVE_BASELINE  1101
+#define BENCH_OPT_THRESHOLD      1102
+
+static int bench_parse_baseline_option(int c, const char *zArg, BenchBaselineOptions *pOptions) {
+    switch (c) {
+        case 'R':
+            pOptions->repeat = atoi(zArg);
+            if (pOptions->repeat < 1 || pOptions->repeat > 1000) {
+                fprintf(stderr, "错误: 重复次数必须在1-1000之间\n");
+                return -1;
+            }
+            break;
+        case BENCH_OPT_BASELINE:
+            pOptions->baseline = zArg;
+            break;
+        case BENCH_OPT_SAVE_BASELINE:
+            pOptions->save_baseline = zArg;
+            break;
+        case BENCH_OPT_THRESHOLD:
+            pOptions->threshold = atof(zArg) / 100.0;
+            if (pOptions->threshold <= 0 || pOptions->threshold >= 10) {
+                fprintf(stderr, "错误: 无效的回归阈值 '%s'\n", zArg);
+                return -1;
+            }
+            break;
+    }
+    return 0;
+}
+
+/*
+ * 运行前读取基准线并检查配置，避免长时间运行后才发现无法比较
+ * Load the baseline and check its configuration before running, so a baseline that cannot be
+ * compared does not surface after a long run
+ */
+static int bench_open_baseline(const BenchBaselineOptions *pOptions, const BenchMetricSet *pMetrics,
+                               BenchMetricSet *pBaseline) {
+    memset(pBaseline, 0, sizeof(*pBaseline));
+    if (!pOptions->baseline) return 0;
+
+    if (bench_baseline_load(pOptions->baseline, pBaseline) != 0) {
+        fprintf(stderr, "错误: 无法读取基准线文件 '%s'\n", pOptions->baseline);
+        return -1;
+    }
+    if (strcmp(pBaseline->mode, pMetrics->mode) != 0 || strcmp(pBaseline->config, pMetrics->config) != 0) {
+        fprintf(stderr, "错误: 基准线配置不同，无法比较\n  基准线: %s %s\n  当前:   %s %s\n",
+                pBaseline->mode, pBaseline->config, pMetrics->mode, pMetrics->config);
+        bench_metric_set_free(pBaseline);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * 输出汇总，与基准线比较并按需保存新基准线，返回退出码
+ * Print the summary, compare with the baseline and save a new one when asked, returns the exit code
+ * 有失败用例的运行既不与基准线比较，也不会保存为基准线
+ * A run with failed cases is neither compared with the baseline nor saved as one
+ */
+static int bench_finish(FILE *out, const BenchBaselineOptions *pOptions, BenchMetricSet *pMetrics,
+                        const BenchMetricSet *pBaseline, int failures) {
+    int regressions = 0;
+
+    bench_metric_finish(pMetrics);
+    bench_print_summary(out, pMetrics);
+
+    if (pOptions->baseline && failures) {
+        fprintf(stderr, "错误: 有失败的用例，不与基准线比较\n");
+    } else if (pOptions->baseline) {
+        regressions = bench_baseline_compare(out, pBaseline, pMetrics, pOptions->threshold);
+        if (regressions < 0) failures++;
+    }
+
+    if (pOptions->save_baseline) {
+        if (failures) {
+            fprintf(stderr, "错误: 有失败的用例，不保存基准线\n");
+        } else if (bench_baseline_save(pOptions->save_baseline, pMetrics) != 0) {
+            fprintf(stderr, "错误: 无法写入基准线文件 '%s'\n", pOptions->save_baseline);
+            failures++;
+        }
+    }
+
+    fprintf(out, "  \"regressions\": %d,\n", regressions > 0 ? regressions : 0);
+    fprintf(out, "  \"failures\": %d\n", failures);
+    fprintf(out, "}\n");
+
+    if (failures) return 1;
+    return regressions > 0 ? BENCH_EXIT_REGRESSION : 0;
+}
+
+/*
+ * 编解码层：按writePage的顺序压缩（无收益时保留原始数据）、加密、计算CRC32，
+ * 再按readPage的顺序校验CRC32、解密、解压，最后与原始页面比较
+ * Codec layer: compress (keeping the raw page when it does not pay off), encrypt and CRC32
+ * in writePage order, then check the CRC32, decrypt and decompress in readPage order, and
+ * compare against the original pages
+ */
+static int bench_codec(const BenchConfig *pConfig, const CompressAlgorithm *pCompress,
+                       const EncryptAlgorithm *pEncrypt, const unsigned char *aData,
+                       uint32_t pageSize, uint32_t nPages, BenchResult *pResult) {
+    uint32_t slotSize = pageSize;
+    if (pCompress) {
+        int maxSize = pCompress->get_max_compressed_size((int)pageSize);
+        if ((uint32_t)maxSize > slotSize) slotSize = (uint32_t)maxSize;
+    }
+
+    unsigned char *aStored = malloc((size_t)nPages * (slotSize + 32));
+    unsigned char *aDecoded = malloc((size_t)nPages * pageSize);
+    unsigned char *pWork = malloc(slotSize + 32);
+    uint32_t *aSize = malloc(nPages * sizeof(uint32_t));
+    uint32_t *aChecksum = malloc(nPages * sizeof(uint32_t));
+    unsigned char *aCompressed = malloc(nPages);
+    int rc = SQLITE_OK;
+
+    if (!aStored || !aDecoded || !pWork || !aSize || !aChecksum || !aCompressed) {
+        snprintf(pResult->error, sizeof(pResult->error), "out of memory");
+        rc = SQLITE_NOMEM;
+        goto codec_done;
+    }
+
+    // 编码
+    // Encode
+    double tStart = bench_now();
+    for (uint32_t i = 0; i < nPages && rc == SQLITE_OK; i++) {
+        const unsigned char *pPage = aData + (size_t)i * pageSize;
+        unsigned char *pSlot = aStored + (size_t)i * (slotSize + 32);
+        const unsigned char *pPlain = pPage;
+        int size = (int)pageSize;
+
+        aCompressed[i] = 0;
+        if (pCompress) {
+            int n = pCompress->compress(pPage, (int)pageSize, pWork, (int)slotSize, pConfig->level);
+            if (n > 0 && (uint32_t)n < pageSize) {
+                pPlain = pWork;
+                size = n;
+                aCompressed[i] = 1;
+            }
+        }
+        if (pEncrypt) {
+            size = pEncrypt->encrypt(bench_key, pEncrypt->key_size, pPlain, size, pSlot, (int)slotSize + 32);
+            if (size <= 0) {
+                snprintf(pResult->error, sizeof(pResult->error), "encrypt failed on page %u", i);
+                rc = SQLITE_IOERR;
+                break;
+            }
+        } else {
+            memcpy(pSlot, pPlain, size);
+        }
+        aSize[i] = (uint32_t)size;
+        aChecksum[i] = ccvfs_crc32(pSlot, size);
+    }
+    pResult->encode.seconds = bench_now() - tStart;
+    if (rc != SQLITE_OK) goto codec_done;
+
+    for (uint32_t i = 0; i < nPages; i++) {
+        pResult->stored_bytes += aSize[i];
+        pResult->compressed_pages += aCompressed[i];
+    }
+
+    // 解码
+    // Decode
+    tStart = bench_now();
+    for (uint32_t i = 0; i < nPages && rc == SQLITE_OK; i++) {
+        const unsigned char *pSlot = aStored + (size_t)i * (slotSize + 32);
+        unsigned char *pOut = aDecoded + (size_t)i * pageSize;
+        const unsigned char *pPlain = pSlot;
+        int size = (int)aSize[i];
+
+        if (ccvfs_crc32(pSlot, size) != aChecksum[i]) {
+            snprintf(pResult->error, sizeof(pResult->error), "checksum mismatch on page %u", i);
+            rc = SQLITE_CORRUPT;
+            break;
+        }
+        if (pEncrypt) {
+            size = pEncrypt->decrypt(bench_key, pEncrypt->key_size, pSlot, size, pWork, (int)slotSize + 32);
+            if (size < 0) {
+                snprintf(pResult->error, sizeof(pResult->error), "decrypt failed on page %u", i);
+                rc = SQLITE_IOERR;
+                break;
+            }
+            pPlain = pWork;
+        }
+        if (aCompressed[i]) {
+            if (pCompress->decompress(pPlain, size, pOut, (int)pageSize) != (int)pageSize) {
+                snprintf(pResult->error, sizeof(pResult->error), "decompress failed on page %u", i);
+                rc = SQLITE_CORRUPT;
+                break;
+            }
+        } else {
+            memcpy(pOut, pPlain, pageSize);
+        }
+    }
+    pResult->decode.seconds = bench_now() - tStart;
+
+    if (rc == SQLITE_OK && memcmp(aData, aDecoded, (size_t)nPages * pageSize) != 0) {
+        snprintf(pResult->error, sizeof(pResult->error), "decoded pages differ from the original");
+        rc = SQLITE_CORRUPT;
+    }
+
+    pResult->encode.pages = pResult->decode.pages = nPages;
+    pResult->encode.bytes = pResult->decode.bytes = (uint64_t)nPages * pageSize;
+
+codec_done:
+    free(aStored);
+    free(aDecoded);
+    free(pWork);
+    free(aSize);
+    free(aChecksum);
+    free(aCompressed);
+    return rc;
+}
+
+/*
+ * 通过VFS方法打开基准测试文件，不经过SQLite的页缓存。与SQLite的pager一样，
+ * 打开后先查询文件大小（新文件在此时初始化CCVFS文件头）并持有对应的锁
+ * Open the benchmark file through the VFS methods, bypassing SQLite's page cache. Like SQLite's
+ * pager, the file size is queried right after opening (new files get their CCVFS header here)
+ * and the matching lock is held
+ */
+static int bench_open(sqlite3_vfs *pVfs, const char *zName, int flags, sqlite3_file **ppFile) {
+    sqlite3_file *pFile = sqlite3_malloc(pVfs->szOsFile);
+    int outFlags = 0;
+    int rc;
+
+    *ppFile = NULL;
+    if (!pFile) return SQLITE_NOMEM;
+    memset(pFile, 0, pVfs->szOsFile);
+
+    rc = pVfs->xOpen(pVfs, zName, pFile, flags | SQLITE_OPEN_MAIN_DB | SQLITE_OPEN_READWRITE, &outFlags);
+    if (rc != SQLITE_OK) {
+        if (pFile->pMethods) pFile->pMethods->xClose(pFile);
+        sqlite3_free(pFile);
+        return rc;
+    }
+    sqlite3_int64 size;
+    rc = pFile->pMethods->xFileSize(pFile, &size);
+    if (rc == SQLITE_OK) rc = pFile->pMethods->xLock(pFile, SQLITE_LOCK_SHARED);
+    if (rc == SQLITE_OK && (flags & SQLITE_OPEN_CREATE)) {
+        rc = pFile->pMethods->xLock(pFile, SQLITE_LOCK_RESERVED);
+        if (rc == SQLITE_OK) rc = pFile->pMethods->xLock(pFile, SQLITE_LOCK_EXCLUSIVE);
+    }
+    if (rc != SQLITE_OK) {
+        pFile->pMethods->xClose(pFile);
+        sqlite3_free(pFile);
+        return rc;
+    }
+    *ppFile = pFile;
+    return SQLITE_OK;
+}
+
+static void bench_close(sqlite3_file *pFile) {
+    if (pFile) {
+        pFile->pMethods->xUnlock(pFile, SQLITE_LOCK_NONE);
+        pFile->pMethods->xClose(pFile);
+        sqlite3_free(pFile);
+    }
+}
+
+/*
+ * VFS层：整页顺序写入并同步，重新打开后顺序读取，再按随机顺序读取
+ * 读取由操作系统页缓存提供，测量的是CCVFS的页面路径而不是存储设备
+ * VFS layer: whole pages written sequentially and synced, then read back sequentially after
+ * reopening, then in random order. Reads are served by the OS page cache, so this measures the
+ * CCVFS page path rather than the storage device
+ */
+static int bench_vfs(const BenchConfig *pConfig, const CompressAlgorithm *pCompress,
+                     const EncryptAlgorithm *pEncrypt, const unsigned char *aData,
+                     uint32_t pageSize, uint32_t nPages, BenchResult *pResult) {
+    char zPath[1024];
+    sqlite3_filename zName = NULL;
+    sqlite3_file *pFile = NULL;
+    unsigned char *pPage = NULL;
+    uint32_t *aOrder = NULL;
+    int rc;
+
+    snprintf(zPath, sizeof(zPath), "%s/%s", pConfig->dir, BENCH_FILE_NAME);
+    remove(zPath);
+
+    if (pEncrypt) {
+        rc = sqlite3_ccvfs_create_with_key(BENCH_VFS_NAME, NULL, pCompress, pEncrypt, pageSize,
+                                           CCVFS_CREATE_REALTIME, bench_key, pEncrypt->key_size);
+    } else {
+        rc = sqlite3_ccvfs_create(BENCH_VFS_NAME, NULL, pCompress, NULL, pageSize, CCVFS_CREATE_REALTIME);
+    }
+    if (rc != SQLITE_OK) {
+        snprintf(pResult->error, sizeof(pResult->error), "VFS creation failed: %d", rc);
+        return rc;
+    }
+    if (!pConfig->write_buffer) {
+        sqlite3_ccvfs_configure_write_buffer(BENCH_VFS_NAME, 0, 32, 4 * 1024 * 1024, 16);
+    }
+
+    sqlite3_vfs *pVfs = sqlite3_vfs_find(BENCH_VFS_NAME);
+    zName = sqlite3_create_filename(zPath, "", "", 0, NULL);
+    pPage = malloc(pageSize);
+    aOrder = malloc(nPages * sizeof(uint32_t));
+    if (!pVfs || !zName || !pPage || !aOrder) {
+        snprintf(pResult->error, sizeof(pResult->error), "out of memory");
+        rc = SQLITE_NOMEM;
+        goto vfs_done;
+    }
+
+    // 顺序写入
+    // Sequential write
+    rc = bench_open(pVfs, zName, SQLITE_OPEN_CREATE, &pFile);
+    if (rc == SQLITE_OK && pCompress && pConfig->level != CCVFS_DEFAULT_COMPRESS_LEVEL) {
+        char zLevel[16];
+        char *azArg[3] = { NULL, "ccvfs_compress_level", zLevel };
+        snprintf(zLevel, sizeof(zLevel), "%d", pConfig->level);
+        rc = pFile->pMethods->xFileControl(pFile, SQLITE_FCNTL_PRAGMA, azArg);
+        sqlite3_free(azArg[0]);
+    }
+    if (rc != SQLITE_OK) {
+        snprintf(pResult->error, sizeof(pResult->error), "open for write failed: %d", rc);
+        goto vfs_done;
+    }
+    double tStart = bench_now();
+    for (uint32_t i = 0; i < nPages && rc == SQLITE_OK; i++) {
+        rc = pFile->pMethods->xWrite(pFile, aData + (size_t)i * pageSize, (int)pageSize,
+                                     (sqlite3_int64)i * pageSize);
+    }
+    if (rc == SQLITE_OK) rc = pFile->pMethods->xSync(pFile, SQLITE_SYNC_NORMAL);
+    pResult->write.seconds = bench_now() - tStart;
+    bench_close(pFile);
+    pFile = NULL;
+    if (rc != SQLITE_OK) {
+        snprintf(pResult->error, sizeof(pResult->error), "write failed: %d", rc);
+        goto vfs_done;
+    }
+
+    struct stat st;
+    if (stat(zPath, &st) == 0) {
+        pResult->file_bytes = (uint64_t)st.st_size;
+    }
+
+    // 顺序读取
+    // Sequential read
+    rc = bench_open(pVfs, zName, 0, &pFile);
+    if (rc != SQLITE_OK) {
+        snprintf(pResult->error, sizeof(pResult->error), "open for read failed: %d", rc);
+        goto vfs_done;
+    }
+    tStart = bench_now();
+    for (uint32_t i = 0; i < nPages && rc == SQLITE_OK; i++) {
+        rc = pFile->pMethods->xRead(pFile, pPage, (int)pageSize, (sqlite3_int64)i * pageSize);
+        if (rc == SQLITE_OK && memcmp(pPage, aData + (size_t)i * pageSize, pageSize) != 0) {
+            snprintf(pResult->error, sizeof(pResult->error), "page %u differs after sequential read", i);
+            rc = SQLITE_CORRUPT;
+        }
+    }
+    pResult->read_seq.seconds = bench_now() - tStart;
+    if (rc != SQLITE_OK) {
+        if (!pResult->error[0]) snprintf(pResult->error, sizeof(pResult->error), "sequential read failed: %d", rc);
+        goto vfs_done;
+    }
+
+    // 随机读取（固定种子的排列）
+    // Random read (permutation from a fixed seed)
+    uint32_t state = pConfig->seed ? pConfig->seed : 1;
+    for (uint32_t i = 0; i < nPages; i++) aOrder[i] = i;
+    for (uint32_t i = nPages; i > 1; i--) {
+        uint32_t j = bench_rand(&state) % i;
+        uint32_t tmp = aOrder[i - 1];
+        aOrder[i - 1] = aOrder[j];
+        aOrder[j] = tmp;
+    }
+    tStart = bench_now();
+    for (uint32_t i = 0; i < nPages && rc == SQLITE_OK; i++) {
+        uint32_t page = aOrder[i];
+        rc = pFile->pMethods->xRead(pFile, pPage, (int)pageSize, (sqlite3_int64)page * pageSize);
+        if (rc == SQLITE_OK && memcmp(pPage, aData + (size_t)page * pageSize, pageSize) != 0) {
+            snprintf(pResult->error, sizeof(pResult->error), "page %u differs after random read", page);
+            rc = SQLITE_CORRUPT;
+        }
+    }
+    pResult->read_rand.seconds = bench_now() - tStart;
+    if (rc != SQLITE_OK && !pResult->error[0]) {
+        snprintf(pResult->error, sizeof(pResult->error), "random read failed: %d", rc);
+    }
+
+    pResult->write.pages = pResult->read_seq.pages = pResult->read_rand.pages = nPages;
+    pResult->write.bytes = pResult->read_seq.bytes = pResult->read_rand.bytes = (uint64_t)nPages * pageSize;
+
+vfs_done:
+    bench_close(pFile);
+    sqlite3_free_filename(zName);
+    free(pPage);
+    free(aOrder);
+    sqlite3_ccvfs_destroy(BENCH_VFS_NAME);
+    remove(zPath);
+    return rc;
+}
+
+static double bench_mib_per_sec(const BenchTiming *pTiming) {
+    return pTiming->seconds > 0 ? pTiming->bytes / (1024.0 * 1024.0) / pTiming->seconds : 0;
+}
+
+static void bench_print_timing(FILE *out, const char *zName, const BenchTiming *pTiming, int last) {
+    double pagesPerSec = pTiming->seconds > 0 ? pTiming->pages / pTiming->seconds : 0;
+    double mibPerSec = bench_mib_per_sec(pTiming);
+
+    fprintf(out, "        \"%s\": {\"seconds\": %.6f, \"pages\": %llu, \"pages_per_sec\": %.1f, \"mib_per_sec\": %.2f}%s\n",
+            zName, pTiming->seconds, (unsigned long long)pTiming->pages, pagesPerSec, mibPerSec, last ? "" : ",");
+}
+
+static void bench_print_result(FILE *out, const BenchConfig *pConfig, const BenchResult *pResult,
+                               int run, int first) {
+    double ratio = pResult->stored_bytes ? (double)pResult->logical_bytes / pResult->stored_bytes : 0;
+
+    fprintf(out, "%s    {\n", first ? "" : ",\n");
+    fprintf(out, "      \"run\": %d,\n", run);
+    fprintf(out, "      \"page_size\": %u,\n", pResult->page_size);
+    fprintf(out, "      \"compress\": \"%s\",\n", pResult->compress);
+    fprintf(out, "      \"encrypt\": \"%s\",\n", pResult->encrypt);
+    fprintf(out, "      \"data_mode\": \"%s\",\n", sqlite3_ccvfs_data_mode_name((DataMode)pResult->mode));
+    fprintf(out, "      \"pages\": %u,\n", pResult->pages);
+    fprintf(out, "      \"logical_bytes\": %llu,\n", (unsigned long long)pResult->logical_bytes);
+    if (pConfig->layers & BENCH_LAYER_CODEC) {
+        fprintf(out, "      \"stored_bytes\": %llu,\n", (unsigned long long)pResult->stored_bytes);
+        fprintf(out, "      \"compressed_pages\": %u,\n", pResult->compressed_pages);
+        fprintf(out, "      \"ratio\": %.3f,\n", ratio);
+        fprintf(out, "      \"codec\": {\n");
+        bench_print_timing(out, "encode", &pResult->encode, 0);
+        bench_print_timing(out, "decode", &pResult->decode, 1);
+        fprintf(out, "      },\n");
+    }
+    if (pConfig->layers & BENCH_LAYER_VFS) {
+        fprintf(out, "      \"file_bytes\": %llu,\n", (unsigned long long)pResult->file_bytes);
+        fprintf(out, "      \"vfs\": {\n");
+        bench_print_timing(out, "write", &pResult->write, 0);
+        bench_print_timing(out, "read_seq", &pResult->read_seq, 0);
+        bench_print_timing(out, "read_rand", &pResult->read_rand, 1);
+        fprintf(out, "      },\n");
+    }
+    fprintf(out, "      \"rc\": %d,\n", pResult->rc);
+    fprintf(out, "      \"error\": \"%s\"\n", pResult->error);
+    fprintf(out, "    }");
+}
+
+/*
+ * 把一个用例的吞吐量和压缩比加入指标集，名称为 页大小/压缩/加密/数据模式/指标
+ * Add the throughput and ratio of one case to the metric set, named
+ * page_size/compress/encrypt/data_mode/metric
+ */
+static void bench_collect_metrics(BenchMetricSet *pSet, const BenchConfig *pConfig, const BenchResult *pResult) {
+    char zPrefix[96], zName[BENCH_METRIC_NAME_MAX];
+
+    if (pResult->rc != SQLITE_OK) return;
+    snprintf(zPrefix, sizeof(zPrefix), "%u/%s/%s/%s", pResult->page_size, pResult->compress,
+             pResult->encrypt, sqlite3_ccvfs_data_mode_name((DataMode)pResult->mode));
+
+    if (pConfig->layers & BENCH_LAYER_CODEC) {
+        snprintf(zName, sizeof(zName), "%s/ratio", zPrefix);
+        bench_metric_add(pSet, zName, 1,
+                         pResult->stored_bytes ? (double)pResult->logical_bytes / pResult->stored_bytes : 0);
+        snprintf(zName, sizeof(zName), "%s/codec.encode.mib_per_sec", zPrefix);
+        bench_metric_add(pSet, zName, 1, bench_mib_per_sec(&pResult->encode));
+        snprintf(zName, sizeof(zName), "%s/codec.decode.mib_per_sec", zPrefix);
+        bench_metric_add(pSet, zName, 1, bench_mib_per_sec(&pResult->decode));
+    }
+    if (pConfig->layers & BENCH_LAYER_VFS) {
+        snprintf(zName, sizeof(zName), "%s/vfs.write.mib_per_sec", zPrefix);
+        bench_metric_add(pSet, zName, 1, bench_mib_per_sec(&pResult->write));
+        snprintf(zName, sizeof(zName), "%s/vfs.read_seq.mib_per_sec", zPrefix);
+        bench_metric_add(pSet, zName, 1, bench_mib_per_sec(&pResult->read_seq));
+        snprintf(zName, sizeof(zName), "%s/vfs.read_rand.mib_per_sec", zPrefix);
+        bench_metric_add(pSet, zName, 1, bench_mib_per_sec(&pResult->read_rand));
+    }
+}
+
+// 影响测量值的配置，只有相同配置的结果才与基准线比较
+// Settings that change the measured values, only equal settings compare with a baseline
+static void bench_config_signature(const BenchConfig *pConfig, char *zBuf, size_t nBuf) {
+    snprintf(zBuf, nBuf, "data_bytes=%llu;record_size=%d;level=%d;write_buffer=%d;layers=%d;seed=%u",
+             (unsigned long long)pConfig->data_bytes, pConfig->record_size, pConfig->level,
+             pConfig->write_buffer, pConfig->layers, pConfig->seed);
+}
+
+static void bench_print_header(FILE *out, const BenchConfig *pConfig, const BenchBuildInfo *pBuild) {
+    char zTime[32];
+    time_t now = time(NULL);
+    strftime(zTime, sizeof(zTime), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+    fprintf(out, "{\n");
+    fprintf(out, "  \"tool\": \"ccvfs_bench\",\n");
+    fprintf(out, "  \"timestamp\": \"%s\",\n", zTime);
+    fprintf(out, "  \"ccvfs_version\": \"%d.%d\",\n", CCVFS_VERSION_MAJOR, CCVFS_VERSION_MINOR);
+    fprintf(out, "  \"sqlite_version\": \"%s\",\n", sqlite3_libversion());
+    bench_print_build(out, pBuild);
+    fprintf(out, "  \"config\": {\n");
+    fprintf(out, "    \"data_bytes\": %llu,\n", (unsigned long long)pConfig->data_bytes);
+    fprintf(out, "    \"record_size\": %d,\n", pConfig->record_size);
+    fprintf(out, "    \"level\": %d,\n", pConfig->level);
+    fprintf(out, "    \"write_buffer\": %s,\n", pConfig->write_buffer ? "true" : "false");
+    fprintf(out, "    \"repeat\": %d,\n", pConfig->baseline.repeat);
+    fprintf(out, "    \"seed\": %u\n", pConfig->seed);
+    fprintf(out, "  },\n");
+    fprintf(out, "  \"results\": [\n");
+}
+
+/*
+ * 宏观负载基准：在默认VFS和各个CCVFS配置上运行同一个YCSB风格负载
+ * Macro workload benchmark: the same YCSB-style workload on the default VFS and on every
+ * CCVFS configuration
+ * 所有配置都在计数shim VFS之上运行，写入字节数和fsync次数是落到文件系统的真实数量
+ * Every configuration runs on top of the counting shim VFS, so bytes written and fsync counts
+ * are what actually reaches the file system
+ */
+#define WORKLOAD_SHIM_NAME    "ccvfs_bench_shim"
+#define WORKLOAD_FILE_NAME    "ccvfs_workload.db"
+
+typedef struct {
+    WorkloadConfig workload;
+    const char *compress[BENCH_MAX_AXIS];
+    int n_compress;
+    const char *encrypt[BENCH_MAX_AXIS];
+    int n_encrypt;
+    uint32_t page_size;         // CCVFS page size, 0 for the CCVFS default
+    ShimVfsConfig storage;      // Storage model of the shim during the run phase
+    int include_default;        // Run the default VFS as the baseline
+    const char *mix_name;
+    const char *dir;
+    const char *output;
+    int verbose;
+    BenchBaselineOptions baseline;
+} WorkloadBenchConfig;
+
+// 一个配置的负载结果
+// Workload result of one configuration
+typedef struct {
+    const char *compress;       // NULL for the default VFS
+    const char *encrypt;
+    double load_seconds;
+    WorkloadResult run;
+    ShimVfsStats io;
+    uint64_t file_bytes;
+    int rc;
+    char error[160];
+} WorkloadBenchResult;
+
+static void workload_remove_files(const char *zPath) {
+    static const char *suffixes[] = { "", "-wal", "-shm", "-journal" };
+    char zFile[1100];
+
+    for (int i = 0; i < (int)(sizeof(suffixes) / sizeof(suffixes[0])); i++) {
+        snprintf(zFile, sizeof(zFile), "%s%s", zPath, suffixes[i]);
+        remove(zFile);
+    }
+}
+
+static int workload_bench_one(const WorkloadBenchConfig *pConfig, const CompressAlgorithm *pCompress,
+                              const EncryptAlgorithm *pEncrypt, int isDefault, WorkloadBenchResult *pResult) {
+    WorkloadConfig workload = pConfig->workload;
+    ShimVfs *pShim = NULL;
+    char zPath[1024];
+    int rc;
+
+    snprintf(zPath, sizeof(zPath), "%s/%s", pConfig->dir, WORKLOAD_FILE_NAME);
+    workload_remove_files(zPath);
+
+    rc = shim_vfs_create(WORKLOAD_SHIM_NAME, NULL, &pShim);
+    if (rc != SQLITE_OK) {
+        snprintf(pResult->error, sizeof(pResult->error), "shim VFS creation failed: %d", rc);
+        return rc;
+    }
+
+    if (isDefault) {
+        workload.vfs_name = WORKLOAD_SHIM_NAME;
+    } else {
+        sqlite3_vfs *pRoot = sqlite3_vfs_find(WORKLOAD_SHIM_NAME);
+        if (pEncrypt) {
+            rc = sqlite3_ccvfs_create_with_key(BENCH_VFS_NAME, pRoot, pCompress, pEncrypt, pConfig->page_size,
+                                               CCVFS_CREATE_REALTIME, bench_key, pEncrypt->key_size);
+        } else {
+            rc = sqlite3_ccvfs_create(BENCH_VFS_NAME, pRoot, pCompress, NULL, pConfig->page_size,
+                                      CCVFS_CREATE_REALTIME);
+        }
+        if (rc != SQLITE_OK) {
+            snprintf(pResult->error, sizeof(pResult->error), "VFS creation failed: %d", rc);
+            shim_vfs_destroy(pShim);
+            return rc;
+        }
+        workload.vfs_name = BENCH_VFS_NAME;
+    }
+    workload.db_path = zPath;
+
+    double tStart = bench_now();
+    rc = sqlite3_ccvfs_workload_load(&workload);
+    pResult->load_seconds = bench_now() - tStart;
+    if (rc != SQLITE_OK) {
+        snprintf(pResult->error, sizeof(pResult->error), "load failed: %d", rc);
+    }
+
+    // 存储模型只作用于运行阶段，加载阶段以本地存储速度进行
+    // The storage model applies to the run phase only, the load runs at local storage speed
+    if (rc == SQLITE_OK) {
+        shim_vfs_reset_stats(pShim);
+        shim_vfs_configure(pShim, &pConfig->storage);
+        rc = sqlite3_ccvfs_workload_run(&workload, &pResult->run);
+        shim_vfs_get_stats(pShim, &pResult->io);
+        if (rc != SQLITE_OK) {
+            snprintf(pResult->error, sizeof(pResult->error), "run failed: %d", rc);
+        } else if (pResult->run.errors > 0) {
+            // BUSY以外的操作错误（如校验和不匹配）说明结果不可信
+            // Operation errors other than BUSY (such as checksum mismatches) make the result untrustworthy
+            snprintf(pResult->error, sizeof(pResult->error), "%llu operations failed",
+                     (unsigned long long)pResult->run.errors);
+            rc = SQLITE_ERROR;
+        }
+    }
+
+    // 所有连接关闭后（WAL已检查点）的文件大小
+    // File size once every connection is closed (and the WAL checkpointed)
+    struct stat st;
+    if (stat(zPath, &st) == 0) {
+        pResult->file_bytes = (uint64_t)st.st_size;
+    }
+
+    if (!isDefault) sqlite3_ccvfs_destroy(BENCH_VFS_NAME);
+    shim_vfs_destroy(pShim);
+    workload_remove_files(zPath);
+    return rc;
+}
+
+static void workload_print_result(FILE *out, const WorkloadBenchResult *pResult, int run, int first) {
+    fprintf(out, "%s    {\n", first ? "" : ",\n");
+    fprintf(out, "      \"run\": %d,\n", run);
+    fprintf(out, "      \"vfs\": \"%s\",\n", pResult->compress ? "ccvfs" : "default");
+    fprintf(out, "      \"compress\": \"%s\",\n", pResult->compress ? pResult->compress : "none");
+    fprintf(out, "      \"encrypt\": \"%s\",\n", pResult->encrypt ? pResult->encrypt : "none");
+    fprintf(out, "      \"load_seconds\": %.6f,\n", pResult->load_seconds);
+    fprintf(out, "      \"seconds\": %.6f,\n", pResult->run.seconds);
+    fprintf(out, "      \"operations\": %llu,\n", (unsigned long long)pResult->run.operations);
+    fprintf(out, "      \"busy\": %llu,\n", (unsigned long long)pResult->run.busy);
+    fprintf(out, "      \"errors\": %llu,\n", (unsigned long long)pResult->run.errors);
+    fprintf(out, "      \"ops_per_sec\": %.1f,\n", pResult->run.ops_per_sec);
+    fprintf(out, "      \"latency_us\": {\n");
+    for (int op = 0; op < WORKLOAD_STAT_COUNT; op++) {
+        const WorkloadLatency *pLat = &pResult->run.latency[op];
+        fprintf(out, "        \"%s\": {\"count\": %llu, \"busy\": %llu, \"errors\": %llu, \"mean\": %.1f, "
+                "\"p50\": %.1f, \"p99\": %.1f, \"p999\": %.1f, \"max\": %.1f}%s\n",
+                sqlite3_ccvfs_workload_op_name(op), (unsigned long long)pLat->count,
+                (unsigned long long)pLat->busy, (unsigned long long)pLat->errors, pLat->mean_us, pLat->p50_us, pLat->p99_us,
+                pLat->p999_us, pLat->max_us, op == WORKLOAD_STAT_COUNT - 1 ? "" : ",");
+    }
+    fprintf(out, "      },\n");
+    fprintf(out, "      \"io\": {\"bytes_written\": %llu, \"write_calls\": %llu, \"bytes_read\": %llu, "
+            "\"read_calls\": %llu, \"fsync_count\": %llu, \"truncate_calls\": %llu, \"syscalls\": %llu, "
+            "\"injected_delay_us\": %llu},\n",
+            (unsigned long long)pResult->io.write_bytes, (unsigned long long)pResult->io.write_calls,
+            (unsigned long long)pResult->io.read_bytes, (unsigned long long)pResult->io.read_calls,
+            (unsigned long long)pResult->io.sync_calls, (unsigned long long)pResult->io.truncate_calls,
+            (unsigned long long)pResult->io.syscalls, (unsigned long long)pResult->io.injected_delay_us);
+    fprintf(out, "      \"file_bytes\": %llu,\n", (unsigned long long)pResult->file_bytes);
+    fprintf(out, "      \"rc\": %d,\n", pResult->rc);
+    fprintf(out, "      \"error\": \"%s\"\n", pResult->error);
+    fprintf(out, "    }");
+}
+
+/*
+ * 把一个配置的吞吐量、p50/p99延迟和I/O量加入指标集，名称为 vfs/压缩/加密/指标
+ * Add the throughput, p50/p99 latencies and I/O volume of one configuration to the metric set,
+ * named vfs/compress/encrypt/metric
+ */
+static void workload_collect_metrics(BenchMetricSet *pSet, const WorkloadBenchResult *pResult) {
+    char zPrefix[64], zName[BENCH_METRIC_NAME_MAX];
+
+    if (pResult->rc != SQLITE_OK) return;
+    snprintf(zPrefix, sizeof(zPrefix), "%s/%s/%s", pResult->compress ? "ccvfs" : "default",
+             pResult->compress ? pResult->compress : "none", pResult->encrypt ? pResult->encrypt : "none");
+
+    snprintf(zName, sizeof(zName), "%s/ops_per_sec", zPrefix);
+    bench_metric_add(pSet, zName, 1, pResult->run.ops_per_sec);
+    for (int op = 0; op < WORKLOAD_STAT_COUNT; op++) {
+        const WorkloadLatency *pLat = &pResult->run.latency[op];
+        if (pLat->count == 0) continue;
+        snprintf(zName, sizeof(zName), "%s/latency_us.%s.p50", zPrefix, sqlite3_ccvfs_workload_op_name(op));
+        bench_metric_add(pSet, zName, 0, pLat->p50_us);
+        snprintf(zName, sizeof(zName), "%s/latency_us.%s.p99", zPrefix, sqlite3_ccvfs_workload_op_name(op));
+        bench_metric_add(pSet, zName, 0, pLat->p99_us);
+    }
+    snprintf(zName, sizeof(zName), "%s/io.bytes_written", zPrefix);
+    bench_metric_add(pSet, zName, 0, (double)pResult->io.write_bytes);
+    snprintf(zName, sizeof(zName), "%s/io.fsync_count", zPrefix);
+    bench_metric_add(pSet, zName, 0, (double)pResult->io.sync_calls);
+    snprintf(zName, sizeof(zName), "%s/io.syscalls", zPrefix);
+    bench_metric_add(pSet, zName, 0, (double)pResult->io.syscalls);
+    snprintf(zName, sizeof(zName), "%s/file_bytes", zPrefix);
+    bench_metric_add(pSet, zName, 0, (double)pResult->file_bytes);
+}
+
+static void workload_config_signature(const WorkloadBenchConfig *pConfig, char *zBuf, size_t nBuf) {
+    const WorkloadConfig *w = &pConfig->workload;
+    const ShimVfsConfig *st = &pConfig->storage;
+    snprintf(zBuf, nBuf, "mix=%d:%d:%d:%d;records=%d;operations=%d;threads=%d;connections=%d;txn_size=%d;"
+             "scan_length=%d;distribution=%d;data_mode=%d;wal=%d;page_size=%u;seed=%u;"
+             "storage=%u:%u:%u:%u:%llu",
+             w->mix[WORKLOAD_READ], w->mix[WORKLOAD_UPDATE], w->mix[WORKLOAD_INSERT], w->mix[WORKLOAD_SCAN],
+             w->records, w->operations, w->threads, w->connections, w->txn_size, w->scan_length,
+             (int)w->distribution, (int)w->data_mode, w->use_wal_mode, pConfig->page_size, w->seed,
+             st->read_latency_us, st->write_latency_us, st->sync_latency_us, st->jitter_us,
+             (unsigned long long)st->bandwidth);
+}
+
+static void workload_print_header(FILE *out, const WorkloadBenchConfig *pConfig, const BenchBuildInfo *pBuild) {
+    const WorkloadConfig *w = &pConfig->workload;
+    char zTime[32];
+    time_t now = time(NULL);
+    strftime(zTime, sizeof(zTime), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+    fprintf(out, "{\n");
+    fprintf(out, "  \"tool\": \"ccvfs_bench\",\n");
+    fprintf(out, "  \"mode\": \"workload\",\n");
+    fprintf(out, "  \"timestamp\": \"%s\",\n", zTime);
+    fprintf(out, "  \"ccvfs_version\": \"%d.%d\",\n", CCVFS_VERSION_MAJOR, CCVFS_VERSION_MINOR);
+    fprintf(out, "  \"sqlite_version\": \"%s\",\n", sqlite3_libversion());
+    bench_print_build(out, pBuild);
+    fprintf(out, "  \"config\": {\n");
+    fprintf(out, "    \"workload\": \"%s\",\n", pConfig->mix_name);
+    fprintf(out, "    \"mix\": {\"read\": %d, \"update\": %d, \"insert\": %d, \"scan\": %d},\n",
+            w->mix[WORKLOAD_READ], w->mix[WORKLOAD_UPDATE], w->mix[WORKLOAD_INSERT], w->mix[WORKLOAD_SCAN]);
+    fprintf(out, "    \"records\": %d,\n", w->records);
+    fprintf(out, "    \"operations\": %d,\n", w->operations);
+    fprintf(out, "    \"threads\": %d,\n", w->threads);
+    fprintf(out, "    \"connections\": %d,\n", w->connections);
+    fprintf(out, "    \"txn_size\": %d,\n", w->txn_size);
+    fprintf(out, "    \"scan_length\": %d,\n", w->scan_length);
+    fprintf(out, "    \"distribution\": \"%s\",\n", w->distribution == WORKLOAD_ZIPFIAN ? "zipfian" : "uniform");
+    fprintf(out, "    \"data_mode\": \"%s\",\n", sqlite3_ccvfs_data_mode_name(w->data_mode));
+    fprintf(out, "    \"journal_mode\": \"%s\",\n", w->use_wal_mode ? "wal" : "delete");
+    fprintf(out, "    \"storage\": {\"read_latency_us\": %u, \"write_latency_us\": %u, \"sync_latency_us\": %u, "
+            "\"jitter_us\": %u, \"bandwidth\": %llu},\n",
+            pConfig->storage.read_latency_us, pConfig->storage.write_latency_us,
+            pConfig->storage.sync_latency_us, pConfig->storage.jitter_us,
+            (unsigned long long)pConfig->storage.bandwidth);
+    fprintf(out, "    \"page_size\": %u,\n", pConfig->page_size ? pConfig->page_size : CCVFS_DEFAULT_PAGE_SIZE);
+    fprintf(out, "    \"repeat\": %d,\n", pConfig->baseline.repeat);
+    fprintf(out, "    \"seed\": %u\n", w->seed);
+    fprintf(out, "  },\n");
+    fprintf(out, "  \"results\": [\n");
+}
+
+static void print_workload_usage(const char *program_name) {
+    printf("用法: %s workload [选项]\n\n", program_name);
+    printf("在默认VFS和每个CCVFS配置（压缩 x 加密）上运行同一个YCSB风格负载\n\n");
+
+    printf("负载选项:\n");
+    printf("  -w, --workload <名称>       YCSB核心负载 A-F，或 读:更新:插入:扫描 百分比，默认 A\n");
+    printf("  -n, --records <数量>        预加载的用户/商品/订单数，默认 10000\n");
+    printf("      --operations <数量>     所有线程的操作总数，默认 20000\n");
+    printf("  -t, --threads <数量>        工作线程数，默认 1\n");
+    printf("      --connections <数量>    连接数（线程轮流共享），默认 1\n");
+    printf("      --txn-size <数量>       每个事务的操作数，1为自动提交，默认 1\n");
+    printf("      --scan-length <行数>    最长范围扫描，默认 100\n");
+    printf("      --distribution <分布>   uniform 或 zipfian，默认 zipfian\n");
+    printf("  -m, --mode <模式>           文本列的数据模式，默认 lorem\n");
+    printf("      --no-wal                使用DELETE日志模式\n");
+    printf("      --seed <数字>           随机种子\n\n");
+
+    printf("配置选项:\n");
+    printf("  -c, --compress <列表>       CCVFS压缩算法，默认全部可用算法\n");
+    printf("  -e, --encrypt <列表>        CCVFS加密算法，默认 none\n");
+    printf("  -b, --page-size <大小>      CCVFS页大小，默认 64K\n");
+    printf("      --no-default            不运行默认VFS基线\n");
+    printf("  -q, --quick                 小规模快速运行\n\n");
+
+    printf("存储模型选项 (只作用于运行阶段):\n");
+    printf("      --latency <微秒>        每次读写的延迟\n");
+    printf("      --sync-latency <微秒>   每次fsync的延迟\n");
+    printf("      --jitter <微秒>         每次读、写、fsync额外的随机延迟上限\n");
+    printf("      --bandwidth <大小>      每秒传输字节数，如 200M，默认不限\n\n");
+
+    printf("基准线选项:\n");
+    printf("  -R, --repeat <次数>         每个用例重复运行的次数，默认 1\n");
+    printf("      --save-baseline <文件>  把指标汇总和构建信息保存为基准线\n");
+    printf("      --baseline <文件>       与基准线比较，回归时退出码为 2\n");
+    printf("      --threshold <百分比>    变差超过该比例且统计显著时算作回归，默认 5\n\n");
+
+    printf("输出选项:\n");
+    printf("  -d, --dir <目录>            数据库文件目录，默认当前目录\n");
+    printf("  -o, --output <文件>         JSON输出文件，默认标准输出\n");
+    printf("  -v, --verbose               在标准错误输出进度\n");
+    printf("  -h, --help                  显示帮助信息\n");
+}
+
+static int workload_main(int argc, char *argv[]) {
+    WorkloadBenchConfig config;
+
+    memset(&config, 0, sizeof(config));
+    sqlite3_ccvfs_init_workload_config(&config.workload);
+#ifdef HAVE_ZLIB
+    config.compress[config.n_compress++] = "zlib";
+#else
+    config.compress[config.n_compress++] = "none";
+#endif
+    config.encrypt[config.n_encrypt++] = "none";
+    config.include_default = 1;
+    config.mix_name = "A";
+    config.dir = ".";
+    config.baseline.repeat = 1;
+    config.baseline.threshold = BENCH_DEFAULT_THRESHOLD;
+    shim_vfs_init_config(&config.storage);
+    config.storage.seed = config.workload.seed;
+
+    static struct option long_options[] = {
+        {"workload", required_argument, 0, 'w'},
+        {"records", required_argument, 0, 'n'},
+        {"operations", required_argument, 0, 1000},
+        {"threads", required_argument, 0, 't'},
+        {"connections", required_argument, 0, 1001},
+        {"txn-size", required_argument, 0, 1002},
+        {"scan-length", required_argument, 0, 1003},
+        {"distribution", required_argument, 0, 1004},
+        {"mode", required_argument, 0, 'm'},
+        {"no-wal", no_argument, 0, 1005},
+        {"seed", required_argument, 0, 1006},
+        {"compress", required_argument, 0, 'c'},
+        {"encrypt", required_argument, 0, 'e'},
+        {"page-size", required_argument, 0, 'b'},
+        {"no-default", no_argument, 0, 1007},
+        {"latency", required_argument, 0, 1008},
+        {"sync-latency", required_argument, 0, 1009},
+        {"jitter", required_argument, 0, 1010},
+        {"bandwidth", required_argument, 0, 1011},
+        {"quick", no_argument, 0, 'q'},
+        {"repeat", required_argument, 0, 'R'},
+        {"baseline", required_argument, 0, BENCH_OPT_BASELINE},
+        {"save-baseline", required_argument, 0, BENCH_OPT_SAVE_BASELINE},
+        {"threshold", required_argument, 0, BENCH_OPT_THRESHOLD},
+        {"dir", required_argument, 0, 'd'},
+        {"output", required_argument, 0, 'o'},
+        {"verbose", no_argument, 0, 'v'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    int c;
+    while ((c = getopt_long(argc, argv, "w:n:t:m:c:e:b:qR:d:o:vh", long_options, NULL)) != -1) {
+        switch (c) {
+            case 'w':
+                if (sqlite3_ccvfs_parse_workload_mix(optarg, config.workload.mix) != 0) {
+                    fprintf(stderr, "错误: 无效的负载 '%s'\n", optarg);
+                    return 1;
+                }
+                config.mix_name = optarg;
+                break;
+            case 'n':
+                config.workload.records = atoi(optarg);
+                if (config.workload.records < 10) {
+                    fprintf(stderr, "错误: 记录数至少为10\n");
+                    return 1;
+                }
+                break;
+            case 1000: // --operations
+                config.workload.operations = atoi(optarg);
+                break;
+            case 't':
+                config.workload.threads = atoi(optarg);
+                break;
+            case 1001: // --connections
+                config.workload.connections = atoi(optarg);
+                break;
+            case 1002: // --txn-size
+                config.workload.txn_size = atoi(optarg);
+                break;
+            case 1003: // --scan-length
+                config.workload.scan_length = atoi(optarg);
+                break;
+            case 1004: // --distribution
+                if (strcmp(optarg, "uniform") == 0) {
+                    config.workload.distribution = WORKLOAD_UNIFORM;
+                } else if (strcmp(optarg, "zipfian") == 0) {
+                    config.workload.distribution = WORKLOAD_ZIPFIAN;
+                } else {
+                    fprintf(stderr, "错误: 无效的分布 '%s'\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'm': {
+                int mode = sqlite3_ccvfs_parse_data_mode(optarg);
+                if (mode < 0) {
+                    fprintf(stderr, "错误: 无效的数据模式 '%s'\n", optarg);
+                    return 1;
+                }
+                config.workload.data_mode = (DataMode)mode;
+                break;
+            }
+            case 1005: // --no-wal
+                config.workload.use_wal_mode = 0;
+                break;
+            case 1006: // --seed
+                config.workload.seed = (unsigned int)strtoul(optarg, NULL, 10);
+                break;
+            case 'c': {
+                BenchConfig axis;
+                if (bench_parse_compress(optarg, &axis) != 0) return 1;
+                memcpy(config.compress, axis.compress, sizeof(config.compress));
+                config.n_compress = axis.n_compress;
+                break;
+            }
+            case 'e': {
+                BenchConfig axis;
+                if (bench_parse_encrypt(optarg, &axis) != 0) return 1;
+                memcpy(config.encrypt, axis.encrypt, sizeof(config.encrypt));
+                config.n_encrypt = axis.n_encrypt;
+                break;
+            }
+            case 'b':
+                config.page_size = sqlite3_ccvfs_parse_page_size(optarg);
+                if (config.page_size == 0) {
+                    fprintf(stderr, "错误: 无效的页大小 '%s'\n", optarg);
+                    return 1;
+                }
+                break;
+            case 1007: // --no-default
+                config.include_default = 0;
+                break;
+            case 1008: // --latency
+                config.storage.read_latency_us = (uint32_t)strtoul(optarg, NULL, 10);
+                config.storage.write_latency_us = config.storage.read_latency_us;
+                break;
+            case 1009: // --sync-latency
+                config.storage.sync_latency_us = (uint32_t)strtoul(optarg, NULL, 10);
+                break;
+            case 1010: // --jitter
+                config.storage.jitter_us = (uint32_t)strtoul(optarg, NULL, 10);
+                break;
+            case 1011: // --bandwidth
+                config.storage.bandwidth = (uint64_t)sqlite3_ccvfs_parse_size_string(optarg);
+                if (config.storage.bandwidth == 0) {
+                    fprintf(stderr, "错误: 无效的带宽 '%s'\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'q':
+                config.workload.records = 500;
+                config.workload.operations = 1000;
+                config.workload.threads = 2;
+                config.workload.connections = 2;
+                config.workload.txn_size = 10;
+                config.workload.scan_length = 20;
+                break;
+            case 'R':
+            case BENCH_OPT_BASELINE:
+            case BENCH_OPT_SAVE_BASELINE:
+            case BENCH_OPT_THRESHOLD:
+                if (bench_parse_baseline_option(c, optarg, &config.baseline) != 0) return 1;
+                break;
+            case 'd':
+                config.dir = optarg;
+                break;
+            case 'o':
+                config.output = optarg;
+                break;
+            case 'v':
+                config.verbose = 1;
+                break;
+            case 'h':
+                print_workload_usage(argv[0]);
+                return 0;
+            default:
+                print_workload_usage(argv[0]);
+                return 1;
+        }
+    }
+
+    WorkloadConfig *w = &config.workload;
+    if (w->operations <= 0 || w->threads <= 0 || w->connections <= 0 || w->txn_size <= 0 || w->scan_length <= 0) {
+        fprintf(stderr, "错误: 操作数、线程数、连接数、事务大小和扫描长度必须为正数\n");
+        return 1;
+    }
+    if (w->connections > w->threads) w->connections = w->threads;
+
+    BenchMetricSet baseline, metrics;
+    char zSignature[512];
+    workload_config_signature(&config, zSignature, sizeof(zSignature));
+    bench_metric_set_init(&metrics, "workload", zSignature);
+    if (bench_open_baseline(&config.baseline, &metrics, &baseline) != 0) return 1;
+
+    FILE *out = stdout;
+    if (config.output) {
+        out = fopen(config.output, "w");
+    } else {
+        // 内置SQLite会把执行的PRAGMA回显到stdout，JSON改写到stdout的副本，stdout转向stderr
+        // The bundled SQLite echoes executed PRAGMAs to stdout, so the JSON goes to a copy of
+        // stdout and stdout is redirected to stderr
+        fflush(stdout);
+        int fd = dup(STDOUT_FILENO);
+        out = fd >= 0 ? fdopen(fd, "w") : NULL;
+        if (out) dup2(STDERR_FILENO, STDOUT_FILENO);
+    }
+    if (!out) {
+        fprintf(stderr, "错误: 无法创建输出文件 '%s'\n", config.output ? config.output : "stdout");
+        return 1;
+    }
+
+    int failures = 0;
+    int nPrinted = 0;
+    workload_print_header(out, &config, &metrics.build);
+
+    // 先运行默认VFS基线，再运行每个压缩 x 加密组合（none/none只是透传，跳过）；
+    // 重复运行在外层，使漂移分散到所有配置上
+    // The default VFS baseline first, then every compression x encryption pair (none/none is a
+    // plain pass-through and is skipped); repetitions are the outer loop so drift spreads over
+    // every configuration
+    for (int run = 0; run < config.baseline.repeat; run++) {
+        for (int i = config.include_default ? -1 : 0; i < config.n_compress * config.n_encrypt; i++) {
+            const CompressAlgorithm *pCompress = NULL;
+            const EncryptAlgorithm *pEncrypt = NULL;
+            WorkloadBenchResult result;
+
+            memset(&result, 0, sizeof(result));
+            if (i >= 0) {
+                result.compress = config.compress[i / config.n_encrypt];
+                result.encrypt = config.encrypt[i % config.n_encrypt];
+                bench_find_compress(result.compress, &pCompress);
+                bench_find_encrypt(result.encrypt, &pEncrypt);
+                if (!pCompress && !pEncrypt) continue;
+            }
+
+            if (config.verbose) {
+                fprintf(stderr, "[%d/%d] workload %s: vfs=%s compress=%s encrypt=%s\n", run + 1,
+                        config.baseline.repeat, config.mix_name,
+                        i < 0 ? "default" : "ccvfs", result.compress ? result.compress : "none",
+                        result.encrypt ? result.encrypt : "none");
+            }
+
+            result.rc = workload_bench_one(&config, pCompress, pEncrypt, i < 0, &result);
+            if (result.rc != SQLITE_OK) {
+                fprintf(stderr, "错误: 负载失败 compress=%s encrypt=%s: %s\n",
+                        result.compress ? result.compress : "none", result.encrypt ? result.encrypt : "none",
+                        result.error);
+                failures++;
+            }
+            workload_print_result(out, &result, run, nPrinted++ == 0);
+            workload_collect_metrics(&metrics, &result);
+        }
+    }
+
+    fprintf(out, "\n  ],\n");
+    int exitCode = bench_finish(out, &config.baseline, &metrics, &baseline, failures);
+
+    fclose(out);
+    bench_metric_set_free(&metrics);
+    bench_metric_set_free(&baseline);
+    return exitCode;
+}
+
+static void print_usage(const char *program_name) {
+    printf("CCVFS微基准测试工具\n");
+    printf("用法: %s [选项]\n", program_name);
+    printf("      %s workload [选项]    宏观负载基准，见 workload --help\n\n", program_name);
+
+    printf("矩阵选项 (逗号分隔的列表):\n");
+    printf("  -b, --page-size <列表>      页大小，默认 1K,4K,16K,64K,256K,1M\n");
+    printf("  -c, --compress <列表>       压缩算法 (none, zlib)，默认全部可用算法\n");
+    printf("  -e, --encrypt <列表>        加密算法 (none, aes128, aes256)，默认全部可用算法\n");
+    printf("  -m, --mode <列表>           数据模式 (random, sequential, lorem, binary, mixed)，默认全部\n\n");
+
+    printf("测量选项:\n");
+    printf("  -s, --data-size <大小>      每个用例的逻辑数据量，默认 8M\n");
+    printf("  -r, --record-size <字节>    填充页面的记录大小，默认 %d\n", BENCH_DEFAULT_RECORD);
+    printf("  -l, --level <1-9>           压缩等级，默认 %d\n", CCVFS_DEFAULT_COMPRESS_LEVEL);
+    printf("      --layer <codec|vfs|all> 测量的层，默认 all\n");
+    printf("      --no-buffer             VFS层禁用写入缓冲\n");
+    printf("      --seed <数字>           数据和随机读顺序的种子\n");
+    printf("  -q, --quick                 小矩阵快速运行 (4K,64K; random,lorem; 1M)\n\n");
+
+    printf("基准线选项:\n");
+    printf("  -R, --repeat <次数>         每个用例重复运行的次数，默认 1\n");
+    printf("      --save-baseline <文件>  把指标汇总和构建信息保存为基准线\n");
+    printf("      --baseline <文件>       与基准线比较，回归时退出码为 2\n");
+    printf("      --threshold <百分比>    变差超过该比例且统计显著时算作回归，默认 5\n\n");
+
+    printf("输出选项:\n");
+    printf("  -d, --dir <目录>            临时文件目录，默认当前目录\n");
+    printf("  -o, --output <文件>         JSON输出文件，默认标准输出\n");
+    printf("  -v, --verbose               在标准错误输出进度\n");
+    printf("  -h, --help                  显示帮助信息\n");
+}
+
+int main(int argc, char *argv[]) {
+    BenchConfig config;
+
+    if (argc > 1 && strcmp(argv[1], "workload") == 0) {
+        return workload_main(argc - 1, argv + 1);
+    }
+    bench_default_config(&config);
+
+    static struct option long_options[] = {
+        {"page-size", required_argument, 0, 'b'},
+        {"compress", required_argument, 0, 'c'},
+        {"encrypt", required_argument, 0, 'e'},
+        {"mode", required_argument, 0, 'm'},
+        {"data-size", required_argument, 0, 's'},
+        {"record-size", required_argument, 0, 'r'},
+        {"level", required_argument, 0, 'l'},
+        {"layer", required_argument, 0, 1000},
+        {"no-buffer", no_argument, 0, 1001},
+        {"seed", required_argument, 0, 1002},
+        {"quick", no_argument, 0, 'q'},
+        {"repeat", required_argument, 0, 'R'},
+        {"baseline", required_argument, 0, BENCH_OPT_BASELINE},
+        {"save-baseline", required_argument, 0, BENCH_OPT_SAVE_BASELINE},
+        {"threshold", required_argument, 0, BENCH_OPT_THRESHOLD},
+        {"dir", required_argument, 0, 'd'},
+        {"output", required_argument, 0, 'o'},
+        {"verbose", no_argument, 0, 'v'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    int c;
+    while ((c = getopt_long(argc, argv, "b:c:e:m:s:r:l:qR:d:o:vh", long_options, NULL)) != -1) {
+        switch (c) {
+            case 'b':
+                if (bench_parse_page_sizes(optarg, &config) != 0) return 1;
+                break;
+            case 'c':
+                if (bench_parse_compress(optarg, &config) != 0) return 1;
+                break;
+            case 'e':
+                if (bench_parse_encrypt(optarg, &config) != 0) return 1;
+                break;
+            case 'm':
+                if (bench_parse_modes(optarg, &config) != 0) return 1;
+                break;
+            case 's':
+                config.data_bytes = (uint64_t)sqlite3_ccvfs_parse_size_string(optarg);
+                if (config.data_bytes == 0) {
+                    fprintf(stderr, "错误: 无效的数据量 '%s'\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'r':
+                config.record_size = atoi(optarg);
+                if (config.record_size < 32 || config.record_size > 4096) {
+                    fprintf(stderr, "错误: 记录大小必须在32-4096之间\n");
+                    return 1;
+                }
+                break;
+            case 'l':
+                config.level = atoi(optarg);
+                if (config.level < 1 || config.level > 9) {
+                    fprintf(stderr, "错误: 压缩等级必须在1-9之间\n");
+                    return 1;
+                }
+                break;
+            case 1000: // --layer
+                if (strcmp(optarg, "codec") == 0) {
+                    config.layers = BENCH_LAYER_CODEC;
+                } else if (strcmp(optarg, "vfs") == 0) {
+                    config.layers = BENCH_LAYER_VFS;
+                } else if (strcmp(optarg, "all") == 0) {
+                    config.layers = BENCH_LAYER_CODEC | BENCH_LAYER_VFS;
+                } else {
+                    fprintf(stderr, "错误: 无效的测量层 '%s'\n", optarg);
+                    return 1;
+                }
+                break;
+            case 1001: // --no-buffer
+                config.write_buffer = 0;
+                break;
+            case 1002: // --seed
+                config.seed = (unsigned int)strtoul(optarg, NULL, 10);
+                break;
+            case 'q':
+                config.page_sizes[0] = CCVFS_PAGE_SIZE_4KB;
+                config.page_sizes[1] = CCVFS_PAGE_SIZE_64KB;
+                config.n_page_sizes = 2;
+                config.modes[0] = DATA_MODE_RANDOM;
+                config.modes[1] = DATA_MODE_LOREM;
+                config.n_modes = 2;
+                config.data_bytes = 1024 * 1024;
+                break;
+            case 'R':
+            case BENCH_OPT_BASELINE:
+            case BENCH_OPT_SAVE_BASELINE:
+            case BENCH_OPT_THRESHOLD:
+                if (bench_parse_baseline_option(c, optarg, &config.baseline) != 0) return 1;
+                break;
+            case 'd':
+                config.dir = optarg;
+                break;
+            case 'o':
+                config.output = optarg;
+                break;
+            case 'v':
+                config.verbose = 1;
+                break;
+            case 'h':
+                print_usage(argv[0]);
+                return 0;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+
+    BenchMetricSet baseline, metrics;
+    char zSignature[512];
+    bench_config_signature(&config, zSignature, sizeof(zSignature));
+    bench_metric_set_init(&metrics, "micro", zSignature);
+    if (bench_open_baseline(&config.baseline, &metrics, &baseline) != 0) return 1;
+
+    FILE *out = stdout;
+    if (config.output) {
+        out = fopen(config.output, "w");
+        if (!out) {
+            fprintf(stderr, "错误: 无法创建输出文件 '%s'\n", config.output);
+            return 1;
+        }
+    }
+
+    int nCases = config.n_page_sizes * config.n_compress * config.n_encrypt * config.n_modes *
+                 config.baseline.repeat;
+    int iCase = 0;
+    int failures = 0;
+    int nPrinted = 0;
+
+    bench_print_header(out, &config, &metrics.build);
+
+    // 重复运行在外层，使漂移分散到所有用例上
+    // Repetitions are the outer loop so drift spreads over every case
+    for (int run = 0; run < config.baseline.repeat; run++) {
+        for (int m = 0; m < config.n_modes; m++) {
+            for (int p = 0; p < config.n_page_sizes; p++) {
+                uint32_t pageSize = config.page_sizes[p];
+                uint32_t nPages = (uint32_t)((config.data_bytes + pageSize - 1) / pageSize);
+                if (nPages < 4) nPages = 4;
+
+                // 每个数据模式和页大小生成一次数据，所有算法组合使用相同的页面
+                // Data is generated once per mode and page size, all algorithm combinations see the same pages
+                unsigned char *aData = malloc((size_t)nPages * pageSize);
+                if (!aData) {
+                    fprintf(stderr, "错误: 无法分配 %llu 字节的测试数据\n",
+                            (unsigned long long)nPages * pageSize);
+                    failures++;
+                    continue;
+                }
+                srand(config.seed);
+                sqlite3_ccvfs_fill_data(aData, (int)((size_t)nPages * pageSize), (DataMode)config.modes[m],
+                                        config.record_size, 0);
+
+                for (int ci = 0; ci < config.n_compress; ci++) {
+                    for (int ei = 0; ei < config.n_encrypt; ei++) {
+                        const CompressAlgorithm *pCompress;
+                        const EncryptAlgorithm *pEncrypt;
+                        BenchResult result;
+
+                        bench_find_compress(config.compress[ci], &pCompress);
+                        bench_find_encrypt(config.encrypt[ei], &pEncrypt);
+
+                        memset(&result, 0, sizeof(result));
+                        result.page_size = pageSize;
+                        result.compress = config.compress[ci];
+                        result.encrypt = config.encrypt[ei];
+                        result.mode = config.modes[m];
+                        result.pages = nPages;
+                        result.logical_bytes = (uint64_t)nPages * pageSize;
+
+                        if (config.verbose) {
+                            fprintf(stderr, "[%d/%d] page_size=%u compress=%s encrypt=%s mode=%s\n",
+                                    ++iCase, nCases, pageSize, result.compress, result.encrypt,
+                                    sqlite3_ccvfs_data_mode_name((DataMode)result.mode));
+                        }
+
+                        if (config.layers & BENCH_LAYER_CODEC) {
+                            result.rc = bench_codec(&config, pCompress, pEncrypt, aData, pageSize, nPages, &result);
+                        }
+                        if (result.rc == SQLITE_OK && (config.layers & BENCH_LAYER_VFS)) {
+                            result.rc = bench_vfs(&config, pCompress, pEncrypt, aData, pageSize, nPages, &result);
+                        }
+                        if (result.rc != SQLITE_OK) {
+                            fprintf(stderr, "错误: 用例失败 page_size=%u compress=%s encrypt=%s: %s\n",
+                                    pageSize, result.compress, result.encrypt, result.error);
+                            failures++;
+                        }
+
+                        bench_print_result(out, &config, &result, run, nPrinted++ == 0);
+                        bench_collect_metrics(&metrics, &config, &result);
+                    }
+                }
+                free(aData);
+            }
+        }
+    }
+
+    fprintf(out, "\n  ],\n");
+    int exitCode = bench_finish(out, &config.baseline, &metrics, &baseline, failures);
+
+    if (out != stdout) fclose(out);
+    bench_metric_set_free(&metrics);
+    bench_metric_set_free(&baseline);
+    return exitCode;
+}
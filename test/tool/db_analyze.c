@@ -0,0 +1,637 @@
+#include "db_analyze.h"
+#include "ccvfs_utils.h"
+#include "sqlite3.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/*
+ * 压缩配置建议
+ * 先单线程通过VFS读出每种页大小的样本块（CCVFS源文件读出的是解码后的逻辑内容），
+ * 再由线程池对每个页大小×编解码器×等级组合做编码、解码和往返校验。与CCVFS写页一样，
+ * 压缩后不更小的块按原样存储。读取代价按一次未缓存的SQLite页读取计算：
+ * 需要读取的块的物理字节按设备带宽折算成时间，加上这些块的解码时间。
+ * 不压缩的普通SQLite文件作为基准参与排名。
+ *
+ * Compression advisor
+ * The samples of every page size are read first, on one thread, through the VFS (a CCVFS
+ * source yields its decoded logical content). A thread pool then encodes, decodes and checks
+ * every page size x codec x level combination. As in CCVFS page writes, a block that does not
+ * get smaller is stored as is. The read cost is that of one uncached SQLite page read: the
+ * physical bytes of the blocks it needs at the device bandwidth, plus their decode time.
+ * The uncompressed plain SQLite file is ranked alongside as the baseline.
+ */
+
+#define ANALYZE_VFS_NAME          "ccvfs_analyze"
+#define ANALYZE_DEFAULT_SAMPLES   256
+#define ANALYZE_SAMPLE_BUDGET     (8 * 1024 * 1024)   // Most sampled bytes per page size
+#define ANALYZE_DEFAULT_DISK_MBPS 500.0
+#define ANALYZE_DEFAULT_SEED      20250101
+#define ANALYZE_DEFAULT_TOP       10
+
+// Compiled-in codec
+typedef struct {
+    const char *name;
+    const CompressAlgorithm *pAlg;
+} AnalyzeCodec;
+
+// Sampled blocks of one page size
+typedef struct {
+    uint32_t page_size;
+    uint32_t count;
+    uint64_t total_blocks;        // Blocks of the whole file at this page size
+    unsigned char *data;          // count * page_size bytes, the tail of the last block is zero
+} AnalyzeSample;
+
+// One candidate evaluated by a worker
+typedef struct {
+    const AnalyzeSample *sample;
+    const CompressAlgorithm *pAlg;
+    AnalyzeCandidate *candidate;
+    double encode_seconds;
+    double decode_seconds;
+} AnalyzeTask;
+
+typedef struct {
+    AnalyzeTask *tasks;
+    int count;
+    int next;
+    pthread_mutex_t mutex;
+} AnalyzeQueue;
+
+static const uint32_t analyze_default_page_sizes[] = {
+    4096, 8192, 16384, 32768, 65536, 131072, 262144, 524288, 1048576
+};
+
+static double analyze_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static uint32_t analyze_rand(uint32_t *pState) {
+    uint32_t x = *pState;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *pState = x;
+    return x;
+}
+
+/*
+ * 编译进来的编解码器；新的编解码器在这里加一行即可参与比较
+ * Compiled-in codecs; a new codec joins the comparison by adding a line here
+ */
+static int analyze_codecs(AnalyzeCodec *aCodec) {
+    int n = 0;
+
+#ifdef HAVE_ZLIB
+    aCodec[n].name = "zlib";
+    aCodec[n++].pAlg = CCVFS_COMPRESS_ZLIB;
+#endif
+    return n;
+}
+
+void analyze_init_options(AnalyzeOptions *options) {
+    memset(options, 0, sizeof(AnalyzeOptions));
+    options->sample_pages = ANALYZE_DEFAULT_SAMPLES;
+    options->goal = ANALYZE_GOAL_BALANCED;
+    options->disk_mbps = ANALYZE_DEFAULT_DISK_MBPS;
+    options->seed = ANALYZE_DEFAULT_SEED;
+    options->top = ANALYZE_DEFAULT_TOP;
+}
+
+int analyze_parse_page_sizes(const char *list, AnalyzeOptions *options) {
+    const char *p = list;
+    int n = 0;
+
+    while (*p) {
+        char *end;
+        long value = strtol(p, &end, 10);
+
+        if (end == p || value <= 0) return -1;
+        if (*end == 'K' || *end == 'k') {
+            value *= 1024;
+            end++;
+        } else if (*end == 'M' || *end == 'm') {
+            value *= 1024 * 1024;
+            end++;
+        }
+        if (value < CCVFS_MIN_PAGE_SIZE || value > CCVFS_MAX_PAGE_SIZE || (value & (value - 1)) != 0 ||
+            n >= ANALYZE_MAX_PAGE_SIZES || (*end != ',' && *end != '\0')) {
+            return -1;
+        }
+        options->page_sizes[n++] = (uint32_t)value;
+        p = *end == ',' ? end + 1 : end;
+    }
+    options->page_size_count = n;
+    return n;
+}
+
+int analyze_parse_levels(const char *list, AnalyzeOptions *options) {
+    const char *p = list;
+    int n = 0;
+
+    while (*p) {
+        char *end;
+        long first = strtol(p, &end, 10);
+        long last = first;
+
+        if (end == p) return -1;
+        if (*end == '-') {
+            p = end + 1;
+            last = strtol(p, &end, 10);
+            if (end == p) return -1;
+        }
+        if (first < CCVFS_MIN_COMPRESS_LEVEL || last > CCVFS_MAX_COMPRESS_LEVEL || first > last ||
+            (*end != ',' && *end != '\0')) {
+            return -1;
+        }
+        for (long level = first; level <= last; level++) {
+            if (n >= ANALYZE_MAX_LEVELS) return -1;
+            options->levels[n++] = (int)level;
+        }
+        p = *end == ',' ? end + 1 : end;
+    }
+    options->level_count = n;
+    return n;
+}
+
+/*
+ * 打开源数据库：CCVFS文件通过按文件头算法创建的VFS读取，普通文件通过默认VFS读取
+ * Open the source: a CCVFS file is read through a VFS created with the algorithms of its
+ * header, a plain file through the default VFS
+ */
+static int analyze_open_source(const char *db_path, const AnalyzeOptions *options, AnalyzeResult *result,
+                               sqlite3_vfs **ppVfs, sqlite3_file **ppFile, sqlite3_filename *pzName) {
+    const CompressAlgorithm *pCompress = NULL;
+    const EncryptAlgorithm *pEncrypt = NULL;
+    CCVFSStats stats;
+    sqlite3_vfs *pVfs;
+    sqlite3_file *pFile;
+    sqlite3_int64 size = 0;
+    unsigned char aHeader[100];
+    int rc;
+
+    if (sqlite3_ccvfs_get_stats(db_path, &stats) == SQLITE_OK) {
+        result->source_ccvfs = 1;
+        memcpy(result->source_compress, stats.compress_algorithm, CCVFS_MAX_ALGORITHM_NAME);
+        memcpy(result->source_encrypt, stats.encrypt_algorithm, CCVFS_MAX_ALGORITHM_NAME);
+#ifdef HAVE_ZLIB
+        if (strcmp(stats.compress_algorithm, "zlib") == 0) pCompress = CCVFS_COMPRESS_ZLIB;
+#endif
+#ifdef HAVE_OPENSSL
+        if (strcmp(stats.encrypt_algorithm, "aes128") == 0) pEncrypt = CCVFS_ENCRYPT_AES128;
+        if (strcmp(stats.encrypt_algorithm, "aes256") == 0) pEncrypt = CCVFS_ENCRYPT_AES256;
+#endif
+        if ((stats.compress_algorithm[0] && !pCompress) || (stats.encrypt_algorithm[0] && !pEncrypt)) {
+            fprintf(stderr, "错误: 源文件使用的算法未编译 (压缩=%s, 加密=%s)\n",
+                    stats.compress_algorithm, stats.encrypt_algorithm);
+            return SQLITE_ERROR;
+        }
+        if (pEncrypt && !options->key) {
+            fprintf(stderr, "错误: 源文件已加密，需要指定密钥 (-k 参数)\n");
+            return SQLITE_MISUSE;
+        }
+        if (pEncrypt) {
+            rc = sqlite3_ccvfs_create_with_key(ANALYZE_VFS_NAME, NULL, pCompress, pEncrypt, 0, 0,
+                                               options->key, options->key_len);
+        } else {
+            rc = sqlite3_ccvfs_create(ANALYZE_VFS_NAME, NULL, pCompress, NULL, 0, 0);
+        }
+        if (rc != SQLITE_OK) {
+            fprintf(stderr, "错误: 无法创建分析VFS: %d\n", rc);
+            return rc;
+        }
+        pVfs = sqlite3_vfs_find(ANALYZE_VFS_NAME);
+    } else {
+        pVfs = sqlite3_vfs_find(NULL);
+    }
+
+    *pzName = sqlite3_create_filename(db_path, "", "", 0, NULL);
+    pFile = (sqlite3_file*)sqlite3_malloc(pVfs->szOsFile);
+    if (!*pzName || !pFile) {
+        sqlite3_free(pFile);
+        return SQLITE_NOMEM;
+    }
+    memset(pFile, 0, pVfs->szOsFile);
+    rc = pVfs->xOpen(pVfs, *pzName, pFile, SQLITE_OPEN_READONLY | SQLITE_OPEN_MAIN_DB, NULL);
+    if (rc == SQLITE_OK) rc = pFile->pMethods->xFileSize(pFile, &size);
+    if (rc == SQLITE_OK) rc = pFile->pMethods->xLock(pFile, SQLITE_LOCK_SHARED);
+    if (rc == SQLITE_OK && size < (sqlite3_int64)sizeof(aHeader)) rc = SQLITE_NOTADB;
+    if (rc == SQLITE_OK) rc = pFile->pMethods->xRead(pFile, aHeader, sizeof(aHeader), 0);
+    if (rc == SQLITE_OK && memcmp(aHeader, "SQLite format 3", 16) != 0) rc = SQLITE_NOTADB;
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "错误: 无法读取数据库 '%s': %d\n", db_path, rc);
+        if (pFile->pMethods) pFile->pMethods->xClose(pFile);
+        sqlite3_free(pFile);
+        return rc;
+    }
+
+    // 文件头偏移16处的大端页大小，1表示65536
+    // Big-endian page size at offset 16 of the header, 1 means 65536
+    result->sqlite_page_size = ((uint32_t)aHeader[16] << 8) | aHeader[17];
+    if (result->sqlite_page_size == 1) result->sqlite_page_size = 65536;
+    result->logical_size = (uint64_t)size;
+    *ppVfs = pVfs;
+    *ppFile = pFile;
+    return SQLITE_OK;
+}
+
+/*
+ * 按页大小分层抽样：文件分成count段，每段取一个块，段内位置由种子决定
+ * Stratified sampling per page size: the file is cut into count strata with one block from
+ * each, its place within the stratum set by the seed
+ */
+static int analyze_read_sample(sqlite3_file *pFile, uint64_t logicalSize, uint32_t pageSize,
+                               const AnalyzeOptions *options, AnalyzeSample *pSample) {
+    uint32_t state = (options->seed ^ pageSize) | 1;
+    uint64_t budget = ANALYZE_SAMPLE_BUDGET / pageSize;
+    uint64_t count;
+
+    pSample->page_size = pageSize;
+    pSample->total_blocks = (logicalSize + pageSize - 1) / pageSize;
+    count = (uint64_t)options->sample_pages;
+    if (count > pSample->total_blocks) count = pSample->total_blocks;
+    if (count > budget) count = budget > 0 ? budget : 1;
+    pSample->count = (uint32_t)count;
+    pSample->data = (unsigned char*)calloc((size_t)count, pageSize);
+    if (!pSample->data) return SQLITE_NOMEM;
+
+    for (uint32_t i = 0; i < pSample->count; i++) {
+        uint64_t first = pSample->total_blocks * i / count;
+        uint64_t span = pSample->total_blocks * (i + 1) / count - first;
+        uint64_t block = first + (span > 1 ? analyze_rand(&state) % span : 0);
+        uint64_t offset = block * pageSize;
+        uint32_t amount = (uint32_t)(logicalSize - offset < pageSize ? logicalSize - offset : pageSize);
+        int rc = pFile->pMethods->xRead(pFile, pSample->data + (size_t)i * pageSize, (int)amount,
+                                        (sqlite3_int64)offset);
+
+        if (rc != SQLITE_OK && rc != SQLITE_IOERR_SHORT_READ) {
+            fprintf(stderr, "错误: 读取偏移 %llu 处的样本失败: %d\n", (unsigned long long)offset, rc);
+            return rc;
+        }
+    }
+    return SQLITE_OK;
+}
+
+// 编码、解码并校验一个候选的全部样本块
+// Encode, decode and check every sampled block of one candidate
+static void analyze_evaluate(AnalyzeTask *pTask) {
+    const AnalyzeSample *pSample = pTask->sample;
+    AnalyzeCandidate *pCand = pTask->candidate;
+    uint32_t pageSize = pSample->page_size;
+    int slotSize = (int)pageSize;
+    int maxSize = pTask->pAlg->get_max_compressed_size((int)pageSize);
+    unsigned char *pWork;
+    unsigned char *pOut;
+
+    if (maxSize > slotSize) slotSize = maxSize;
+    pWork = (unsigned char*)malloc((size_t)slotSize);
+    pOut = (unsigned char*)malloc(pageSize);
+    if (!pWork || !pOut) {
+        pCand->rc = SQLITE_NOMEM;
+        free(pWork);
+        free(pOut);
+        return;
+    }
+
+    for (uint32_t i = 0; i < pSample->count; i++) {
+        const unsigned char *pBlock = pSample->data + (size_t)i * pageSize;
+        double t0 = analyze_now();
+        int n = pTask->pAlg->compress(pBlock, (int)pageSize, pWork, slotSize, pCand->level);
+        double t1 = analyze_now();
+        pTask->encode_seconds += t1 - t0;
+
+        if (n > 0 && (uint32_t)n < pageSize) {
+            pCand->stored_bytes += (uint64_t)n;
+            if (pTask->pAlg->decompress(pWork, n, pOut, (int)pageSize) != (int)pageSize) {
+                pCand->rc = SQLITE_CORRUPT;
+            }
+        } else {
+            pCand->stored_bytes += pageSize;
+            memcpy(pOut, pBlock, pageSize);
+        }
+        pTask->decode_seconds += analyze_now() - t1;
+        if (pCand->rc == SQLITE_OK && memcmp(pOut, pBlock, pageSize) != 0) {
+            pCand->rc = SQLITE_CORRUPT;
+        }
+        if (pCand->rc != SQLITE_OK) break;
+    }
+    pCand->sampled_pages = pSample->count;
+    pCand->sampled_bytes = (uint64_t)pSample->count * pageSize;
+    free(pWork);
+    free(pOut);
+}
+
+static void *analyze_worker(void *pArg) {
+    AnalyzeQueue *pQueue = (AnalyzeQueue*)pArg;
+
+    for (;;) {
+        int i;
+
+        pthread_mutex_lock(&pQueue->mutex);
+        i = pQueue->next < pQueue->count ? pQueue->next++ : -1;
+        pthread_mutex_unlock(&pQueue->mutex);
+        if (i < 0) break;
+        analyze_evaluate(&pQueue->tasks[i]);
+    }
+    return NULL;
+}
+
+// 由样本结果推算整个文件的大小和读取代价
+// Project the size and read cost of the whole file from the sample
+static void analyze_project(const AnalyzeTask *pTask, const AnalyzeResult *result, const AnalyzeOptions *options) {
+    AnalyzeCandidate *pCand = pTask->candidate;
+    const AnalyzeSample *pSample = pTask->sample;
+    double mib = (double)pCand->sampled_bytes / (1024.0 * 1024.0);
+    double avgStored = (double)pCand->stored_bytes / (double)pCand->sampled_pages;
+    double blocksPerRead = 1.0;
+    double bytesPerUs = options->disk_mbps * 1024.0 * 1024.0 / 1e6;
+
+    // 比SQLite页小的块：一次页读取需要多个块
+    // Blocks smaller than a SQLite page: one page read needs several of them
+    if (pSample->page_size < result->sqlite_page_size) {
+        blocksPerRead = (double)(result->sqlite_page_size / pSample->page_size);
+    }
+    pCand->ratio = pCand->stored_bytes > 0 ? (double)pCand->sampled_bytes / (double)pCand->stored_bytes : 0.0;
+    pCand->encode_mbps = pTask->encode_seconds > 0 ? mib / pTask->encode_seconds : 0.0;
+    pCand->decode_mbps = pTask->decode_seconds > 0 ? mib / pTask->decode_seconds : 0.0;
+    pCand->projected_size = (uint64_t)CCVFS_DATA_PAGES_OFFSET +
+                            (uint64_t)(avgStored * (double)pSample->total_blocks);
+    pCand->read_amplification = blocksPerRead * avgStored / (double)result->sqlite_page_size;
+    pCand->read_us = blocksPerRead * (avgStored / bytesPerUs +
+                                      pTask->decode_seconds * 1e6 / (double)pCand->sampled_pages);
+    pCand->feasible = pSample->total_blocks <= CCVFS_MAX_PAGES;
+}
+
+// 基准：不经过CCVFS的普通SQLite文件，一次页读取只读这一页
+// Baseline: the plain SQLite file without CCVFS, a page read reads just that page
+static void analyze_baseline(AnalyzeCandidate *pCand, const AnalyzeResult *result, const AnalyzeOptions *options) {
+    double bytesPerUs = options->disk_mbps * 1024.0 * 1024.0 / 1e6;
+
+    pCand->page_size = result->sqlite_page_size;
+    pCand->codec = "none";
+    pCand->level = 0;
+    pCand->ratio = 1.0;
+    pCand->projected_size = result->logical_size;
+    pCand->read_amplification = 1.0;
+    pCand->read_us = (double)result->sqlite_page_size / bytesPerUs;
+    pCand->feasible = 1;
+}
+
+static AnalyzeGoal analyze_sort_goal;
+
+static int analyze_compare(const void *a, const void *b) {
+    const AnalyzeCandidate *x = (const AnalyzeCandidate*)a;
+    const AnalyzeCandidate *y = (const AnalyzeCandidate*)b;
+    int usableX = x->feasible && x->rc == SQLITE_OK;
+    int usableY = y->feasible && y->rc == SQLITE_OK;
+
+    if (usableX != usableY) return usableY - usableX;
+    if (analyze_sort_goal == ANALYZE_GOAL_SPACE && x->projected_size != y->projected_size) {
+        return x->projected_size < y->projected_size ? -1 : 1;
+    }
+    if (analyze_sort_goal == ANALYZE_GOAL_LATENCY && x->read_us != y->read_us) {
+        return x->read_us < y->read_us ? -1 : 1;
+    }
+    if (x->score != y->score) return x->score < y->score ? -1 : 1;
+    return x->page_size < y->page_size ? -1 : (x->page_size > y->page_size ? 1 : 0);
+}
+
+/*
+ * 排名：平衡目标下得分为相对最小文件大小与相对最快读取的乘积，两者同等重要且与单位无关
+ * Ranking: under the balanced goal the score is the size relative to the smallest file times
+ * the read cost relative to the fastest read, weighting both equally and independent of units
+ */
+static void analyze_rank(AnalyzeResult *result, AnalyzeGoal goal) {
+    uint64_t minSize = 0;
+    double minRead = 0.0;
+
+    for (int i = 0; i < result->candidate_count; i++) {
+        const AnalyzeCandidate *c = &result->candidates[i];
+        if (!c->feasible || c->rc != SQLITE_OK) continue;
+        if (minSize == 0 || c->projected_size < minSize) minSize = c->projected_size;
+        if (minRead == 0.0 || c->read_us < minRead) minRead = c->read_us;
+    }
+    for (int i = 0; i < result->candidate_count; i++) {
+        AnalyzeCandidate *c = &result->candidates[i];
+        if (minSize > 0 && minRead > 0.0) {
+            c->score = ((double)c->projected_size / (double)minSize) * (c->read_us / minRead);
+        }
+    }
+    analyze_sort_goal = goal;
+    qsort(result->candidates, (size_t)result->candidate_count, sizeof(AnalyzeCandidate), analyze_compare);
+}
+
+int analyze_database(const char *db_path, const AnalyzeOptions *options, AnalyzeResult *result) {
+    AnalyzeSample aSample[ANALYZE_MAX_PAGE_SIZES];
+    AnalyzeTask aTask[ANALYZE_MAX_CANDIDATES];
+    AnalyzeCodec aCodec[ANALYZE_MAX_CODECS];
+    const uint32_t *aPageSize = options->page_sizes;
+    int nPageSize = options->page_size_count;
+    int aLevel[ANALYZE_MAX_LEVELS];
+    int nLevel = options->level_count;
+    int nCodec = analyze_codecs(aCodec);
+    sqlite3_vfs *pVfs = NULL;
+    sqlite3_file *pFile = NULL;
+    sqlite3_filename zName = NULL;
+    pthread_t *aHandle = NULL;
+    AnalyzeQueue queue;
+    double tStart = analyze_now();
+    struct stat st;
+    int nTask = 0;
+    int rc;
+
+    memset(result, 0, sizeof(AnalyzeResult));
+    memset(aSample, 0, sizeof(aSample));
+    if (options->sample_pages <= 0 || options->disk_mbps <= 0) {
+        return SQLITE_MISUSE;
+    }
+    if (nPageSize == 0) {
+        aPageSize = analyze_default_page_sizes;
+        nPageSize = (int)(sizeof(analyze_default_page_sizes) / sizeof(analyze_default_page_sizes[0]));
+    }
+    if (nLevel == 0) {
+        for (int level = CCVFS_MIN_COMPRESS_LEVEL; level <= CCVFS_MAX_COMPRESS_LEVEL; level++) {
+            aLevel[nLevel++] = level;
+        }
+    } else {
+        memcpy(aLevel, options->levels, sizeof(int) * (size_t)nLevel);
+    }
+    if (stat(db_path, &st) == 0) {
+        result->file_size = (uint64_t)st.st_size;
+    }
+
+    rc = analyze_open_source(db_path, options, result, &pVfs, &pFile, &zName);
+    if (rc == SQLITE_OK) {
+        analyze_baseline(&result->candidates[0], result, options);
+    }
+
+    // 读取样本并为每个组合建立任务
+    // Read the samples and queue one task per combination
+    for (int p = 0; rc == SQLITE_OK && p < nPageSize; p++) {
+        rc = analyze_read_sample(pFile, result->logical_size, aPageSize[p], options, &aSample[p]);
+        for (int c = 0; rc == SQLITE_OK && c < nCodec; c++) {
+            for (int l = 0; l < nLevel; l++) {
+                AnalyzeCandidate *pCand = &result->candidates[1 + nTask];
+
+                pCand->page_size = aPageSize[p];
+                pCand->codec = aCodec[c].name;
+                pCand->level = aLevel[l];
+                memset(&aTask[nTask], 0, sizeof(AnalyzeTask));
+                aTask[nTask].sample = &aSample[p];
+                aTask[nTask].pAlg = aCodec[c].pAlg;
+                aTask[nTask].candidate = pCand;
+                nTask++;
+            }
+        }
+        if (rc == SQLITE_OK && options->verbose) {
+            printf("页大小 %u: 抽样 %u / %llu 块\n", aPageSize[p], aSample[p].count,
+                   (unsigned long long)aSample[p].total_blocks);
+        }
+    }
+    if (pFile) {
+        if (pFile->pMethods) {
+            pFile->pMethods->xUnlock(pFile, SQLITE_LOCK_NONE);
+            pFile->pMethods->xClose(pFile);
+        }
+        sqlite3_free(pFile);
+    }
+    sqlite3_free_filename(zName);
+    if (result->source_ccvfs) {
+        sqlite3_ccvfs_destroy(ANALYZE_VFS_NAME);
+    }
+
+    // 线程池评估全部组合
+    // The thread pool evaluates every combination
+    if (rc == SQLITE_OK) {
+        result->candidate_count = 1 + nTask;
+    }
+    if (rc == SQLITE_OK && nTask > 0) {
+        int nThread = options->threads > 0 ? options->threads : (int)sysconf(_SC_NPROCESSORS_ONLN);
+        int nStarted = 0;
+
+        if (nThread > nTask) nThread = nTask;
+        if (nThread < 1) nThread = 1;
+        result->threads = nThread;
+        queue.tasks = aTask;
+        queue.count = nTask;
+        queue.next = 0;
+        pthread_mutex_init(&queue.mutex, NULL);
+        aHandle = (pthread_t*)calloc((size_t)nThread, sizeof(pthread_t));
+        if (!aHandle) rc = SQLITE_NOMEM;
+        for (int i = 0; rc == SQLITE_OK && i < nThread; i++) {
+            if (pthread_create(&aHandle[i], NULL, analyze_worker, &queue) == 0) nStarted++;
+        }
+        if (rc == SQLITE_OK && nStarted == 0) {
+            analyze_worker(&queue);
+        }
+        for (int i = 0; i < nStarted; i++) {
+            pthread_join(aHandle[i], NULL);
+        }
+        pthread_mutex_destroy(&queue.mutex);
+        free(aHandle);
+    }
+
+    if (rc == SQLITE_OK) {
+        for (int i = 0; i < nTask; i++) {
+            if (aTask[i].candidate->rc != SQLITE_OK) {
+                fprintf(stderr, "错误: %s 等级 %d 页大小 %u 的样本往返校验失败\n", aTask[i].candidate->codec,
+                        aTask[i].candidate->level, aTask[i].candidate->page_size);
+                rc = aTask[i].candidate->rc;
+            } else {
+                analyze_project(&aTask[i], result, options);
+            }
+        }
+    }
+    if (rc == SQLITE_OK) {
+        analyze_rank(result, options->goal);
+    }
+    for (int p = 0; p < nPageSize; p++) {
+        free(aSample[p].data);
+    }
+    result->elapsed_seconds = analyze_now() - tStart;
+    return rc;
+}
+
+static const char *analyze_size_label(uint32_t size, char *zBuf, size_t nBuf) {
+    if (size >= 1024 * 1024) {
+        snprintf(zBuf, nBuf, "%uM", size / (1024 * 1024));
+    } else {
+        snprintf(zBuf, nBuf, "%uK", size / 1024);
+    }
+    return zBuf;
+}
+
+static const char *analyze_goal_name(AnalyzeGoal goal) {
+    switch (goal) {
+        case ANALYZE_GOAL_SPACE: return "space";
+        case ANALYZE_GOAL_LATENCY: return "latency";
+        default: return "balanced";
+    }
+}
+
+void print_analyze_results(const AnalyzeResult *result, const AnalyzeOptions *options) {
+    int nShow = options->top > 0 && options->top < result->candidate_count ? options->top : result->candidate_count;
+    const AnalyzeCandidate *pBest = result->candidate_count > 0 ? &result->candidates[0] : NULL;
+    char zLabel[16];
+
+    printf("\n=== Compression Analysis ===\n");
+    if (result->source_ccvfs) {
+        printf("Source:             CCVFS (compress=%s, encrypt=%s)\n",
+               result->source_compress[0] ? result->source_compress : "none",
+               result->source_encrypt[0] ? result->source_encrypt : "none");
+    } else {
+        printf("Source:             plain SQLite\n");
+    }
+    printf("Database size:      %llu bytes logical, %llu bytes on disk\n",
+           (unsigned long long)result->logical_size, (unsigned long long)result->file_size);
+    printf("SQLite page size:   %u\n", result->sqlite_page_size);
+    printf("Candidates:         %d on %d threads in %.2f s\n", result->candidate_count, result->threads,
+           result->elapsed_seconds);
+    printf("Ranking goal:       %s (device %.0f MB/s)\n", analyze_goal_name(options->goal), options->disk_mbps);
+
+    printf("\n%-4s %-5s %-5s %5s %8s %7s %9s %9s %13s %8s %9s %8s\n", "Rank", "Page", "Codec", "Level",
+           "Samples", "Ratio", "Enc MB/s", "Dec MB/s", "Projected MB", "Read amp", "Read us", "Score");
+    for (int i = 0; i < nShow; i++) {
+        const AnalyzeCandidate *c = &result->candidates[i];
+        if (c->level == 0) {
+            printf("%-4d %-5s %-5s %5s %8s %6.2fx %9s %9s %13.2f %8.2f %9.1f %8.2f  (plain SQLite)\n", i + 1,
+                   analyze_size_label(c->page_size, zLabel, sizeof(zLabel)), c->codec, "-", "-", c->ratio,
+                   "-", "-", (double)c->projected_size / (1024.0 * 1024.0), c->read_amplification,
+                   c->read_us, c->score);
+            continue;
+        }
+        printf("%-4d %-5s %-5s %5d %8u %6.2fx %9.1f %9.1f %13.2f %8.2f %9.1f %8.2f%s\n", i + 1,
+               analyze_size_label(c->page_size, zLabel, sizeof(zLabel)), c->codec, c->level,
+               c->sampled_pages, c->ratio, c->encode_mbps, c->decode_mbps,
+               (double)c->projected_size / (1024.0 * 1024.0), c->read_amplification, c->read_us, c->score,
+               c->feasible ? "" : "  (exceeds CCVFS_MAX_PAGES)");
+    }
+
+    if (!pBest || !pBest->feasible) {
+        printf("\nRecommendation:     none, the database does not fit any candidate page size\n");
+        return;
+    }
+    printf("\nRecommendation:     page size %s, codec %s",
+           analyze_size_label(pBest->page_size, zLabel, sizeof(zLabel)), pBest->codec);
+    if (pBest->level > 0) {
+        printf(", level %d", pBest->level);
+    } else {
+        printf(" (keep the plain SQLite file)");
+    }
+    printf("\n                    projected %.2f MB", (double)pBest->projected_size / (1024.0 * 1024.0));
+    if (result->file_size > 0) {
+        printf(" (%.2fx the current file)", (double)pBest->projected_size / (double)result->file_size);
+    }
+    printf(", %.1f us per uncached page read\n", pBest->read_us);
+    if (pBest->level > 0) {
+        printf("                    db_tool compress -b %s -c %s -l %d <source> <target>\n",
+               zLabel, pBest->codec, pBest->level);
+    }
+}
@@ -0,0 +1,103 @@
+#ifndef DB_ANALYZE_H
+#define DB_ANALYZE_H
+
+#include "ccvfs.h"
+#include <stdint.h>
+
+/*
+ * Compression advisor - 压缩配置建议
+ * Samples blocks of a plain SQLite or CCVFS database, encodes them with every candidate
+ * CCVFS page size, codec and level on a pool of threads, and ranks the candidates by projected
+ * file size and the cost of reading one SQLite page from a block that is not cached.
+ *
+ * 样本按页大小分层均匀抽取，同一个种子每次抽到相同的块。
+ * Samples are spread evenly over the file for every page size, the same seed picks the same
+ * blocks every run.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ANALYZE_MAX_PAGE_SIZES  11    // 1KB to 1MB
+#define ANALYZE_MAX_LEVELS      9     // CCVFS_MIN_COMPRESS_LEVEL to CCVFS_MAX_COMPRESS_LEVEL
+#define ANALYZE_MAX_CODECS      1     // Compiled-in codecs
+#define ANALYZE_MAX_CANDIDATES  (1 + ANALYZE_MAX_PAGE_SIZES * ANALYZE_MAX_CODECS * ANALYZE_MAX_LEVELS)
+
+// Ranking goal
+typedef enum {
+    ANALYZE_GOAL_BALANCED = 0,    // Product of the normalized file size and read latency
+    ANALYZE_GOAL_SPACE,           // Smallest file, read latency breaks ties
+    ANALYZE_GOAL_LATENCY          // Fastest uncached page read, file size breaks ties
+} AnalyzeGoal;
+
+// Analysis options
+typedef struct {
+    int sample_pages;             // Blocks sampled per page size
+    uint32_t page_sizes[ANALYZE_MAX_PAGE_SIZES];
+    int page_size_count;          // 0 for the default set, 4KB to 1MB
+    int levels[ANALYZE_MAX_LEVELS];
+    int level_count;              // 0 for every level
+    int threads;                  // 0 for one per online CPU
+    AnalyzeGoal goal;
+    double disk_mbps;             // Device bandwidth used to cost physical reads
+    const unsigned char *key;     // Key of an encrypted CCVFS source (NULL for none)
+    int key_len;
+    uint32_t seed;                // Sample selection seed
+    int top;                      // Candidates printed, 0 for all
+    int verbose;
+} AnalyzeOptions;
+
+// One page size, codec and level combination, or the plain SQLite file ("none")
+typedef struct {
+    uint32_t page_size;           // SQLite page size for "none"
+    const char *codec;            // "none" or a codec name
+    int level;                    // 0 for "none"
+    uint32_t sampled_pages;
+    uint64_t sampled_bytes;       // Logical bytes of the sample
+    uint64_t stored_bytes;        // Bytes the sample takes on disk
+    double ratio;                 // sampled_bytes / stored_bytes
+    double encode_mbps;           // Logical MB/s
+    double decode_mbps;           // Logical MB/s
+    uint64_t projected_size;      // Estimated size of the whole file
+    double read_amplification;    // Physical bytes read per SQLite page read
+    double read_us;               // Device time plus decode time of one uncached block
+    int feasible;                 // The file fits in CCVFS_MAX_PAGES blocks
+    double score;                 // Lower ranks first
+    int rc;                       // SQLITE_CORRUPT when a block did not round-trip
+} AnalyzeCandidate;
+
+// Analysis result, candidates sorted by rank
+typedef struct {
+    uint64_t logical_size;        // Size of the SQLite database
+    uint64_t file_size;           // Size of the source file on disk
+    uint32_t sqlite_page_size;
+    int source_ccvfs;
+    char source_compress[CCVFS_MAX_ALGORITHM_NAME];
+    char source_encrypt[CCVFS_MAX_ALGORITHM_NAME];
+    int threads;
+    int candidate_count;
+    AnalyzeCandidate candidates[ANALYZE_MAX_CANDIDATES];
+    double elapsed_seconds;
+} AnalyzeResult;
+
+// Initialize options with default values
+void analyze_init_options(AnalyzeOptions *options);
+
+// Parse a comma separated list of page sizes ("4K,16K,64K"), returns the count or -1
+int analyze_parse_page_sizes(const char *list, AnalyzeOptions *options);
+
+// Parse a comma separated list of levels ("1,6,9" or "1-9"), returns the count or -1
+int analyze_parse_levels(const char *list, AnalyzeOptions *options);
+
+// Sample db_path and evaluate every candidate
+int analyze_database(const char *db_path, const AnalyzeOptions *options, AnalyzeResult *result);
+
+// Print the ranked candidates and the recommendation
+void print_analyze_results(const AnalyzeResult *result, const AnalyzeOptions *options);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DB_ANALYZE_H */
@@ -1,43 +1,14 @@
-#ifndef DB_COMPARE_H
-#define DB_COMPARE_H
-
-#include <sqlite3.h>
-
-// Comparison result structure
-typedef struct {
-    int tables_compared;
-    int tables_identical;
-    int tables_different;
-    int records_compared;
-    int records_identical;
-    int records_different;
-    int schema_differences;
-} CompareResult;
-
-// Comparison options
-typedef struct {
-    int ignore_case;          // Ignore case in string comparisons
-    int ignore_whitespace;    // Ignore whitespace differences
-    int compare_schema_only;  // Only compare schema, not data
-    int verbose;              // Verbose output
-    const char *ignore_tables; // Comma-separated list of tables to ignore
-    const char *key_hex;      // Encryption key in hex format for encrypted databases
-} CompareOptions;
-
-// Function to compare two databases
-int compare_databases(const char *db1_path, const char *db2_path,
-                      const CompareOptions *options, CompareResult *result);
-
-// Function to print comparison results
-void print_compare_results(const CompareResult *result, const CompareOptions *options);
-
-#endif // DB_COMPARE_H
 #include "ccvfs.h"
 #include "db_compare.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <getopt.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #ifdef _WIN32
 #define strcasecmp _stricmp
@@ -225,6 +196,70 @@ static unsigned long simple_string_hash(const char *str) {
     return hash;
 }
 
+// Compare all columns of the current rows of two statements
+static int compare_row_values(sqlite3_stmt *stmt1, sqlite3_stmt *stmt2, const CompareOptions *options) {
+    int total_columns = sqlite3_column_count(stmt1);
+    int row_identical = 1;
+    
+    if (sqlite3_column_count(stmt2) != total_columns) return 0;
+    
+    for (int col = 0; col < total_columns; col++) {
+        int type1 = sqlite3_column_type(stmt1, col);
+        int type2 = sqlite3_column_type(stmt2, col);
+        
+        if (type1 != type2) {
+            row_identical = 0;
+            break;
+        }
+        
+        switch (type1) {
+            case SQLITE_INTEGER: {
+                long long val1 = sqlite3_column_int64(stmt1, col);
+                long long val2 = sqlite3_column_int64(stmt2, col);
+                if (val1 != val2) row_identical = 0;
+                break;
+            }
+            case SQLITE_FLOAT: {
+                double val1 = sqlite3_column_double(stmt1, col);
+                double val2 = sqlite3_column_double(stmt2, col);
+                if (val1 != val2) row_identical = 0;
+                break;
+            }
+            case SQLITE_TEXT: {
+                const char *text1 = (const char*)sqlite3_column_text(stmt1, col);
+                const char *text2 = (const char*)sqlite3_column_text(stmt2, col);
+                if (!text1 && !text2) {
+                    // Both NULL
+                } else if (!text1 || !text2) {
+                    row_identical = 0;
+                } else if (options->ignore_case) {
+                    if (strcasecmp(text1, text2) != 0) row_identical = 0;
+                } else {
+                    if (strcmp(text1, text2) != 0) row_identical = 0;
+                }
+                break;
+            }
+            case SQLITE_BLOB: {
+                const void *blob1 = sqlite3_column_blob(stmt1, col);
+                const void *blob2 = sqlite3_column_blob(stmt2, col);
+                int size1 = sqlite3_column_bytes(stmt1, col);
+                int size2 = sqlite3_column_bytes(stmt2, col);
+                if (size1 != size2 || memcmp(blob1, blob2, size1) != 0) {
+                    row_identical = 0;
+                }
+                break;
+            }
+            case SQLITE_NULL:
+                // Both are NULL, identical
+                break;
+        }
+        
+        if (!row_identical) break;
+    }
+    
+    return row_identical;
+}
+
 // Compare table data using a simple row-by-row comparison
 static int compare_table_data_detailed(sqlite3 *db1, sqlite3 *db2, const char *table_name,
                                       const CompareOptions *options, CompareResult *result) {
@@ -318,62 +353,7 @@ static int compare_table_data_detailed(sqlite3 *db1, sqlite3 *db2, const char *t
         rows_compared++;
         
         // Compare all columns for this row
-        int total_columns = sqlite3_column_count(stmt1);
-        int row_identical = 1;
-        
-        for (int col = 0; col < total_columns; col++) {
-            int type1 = sqlite3_column_type(stmt1, col);
-            int type2 = sqlite3_column_type(stmt2, col);
-            
-            if (type1 != type2) {
-                row_identical = 0;
-                break;
-            }
-            
-            switch (type1) {
-                case SQLITE_INTEGER: {
-                    long long val1 = sqlite3_column_int64(stmt1, col);
-                    long long val2 = sqlite3_column_int64(stmt2, col);
-                    if (val1 != val2) row_identical = 0;
-                    break;
-                }
-                case SQLITE_FLOAT: {
-                    double val1 = sqlite3_column_double(stmt1, col);
-                    double val2 = sqlite3_column_double(stmt2, col);
-                    if (val1 != val2) row_identical = 0;
-                    break;
-                }
-                case SQLITE_TEXT: {
-                    const char *text1 = (const char*)sqlite3_column_text(stmt1, col);
-                    const char *text2 = (const char*)sqlite3_column_text(stmt2, col);
-                    if (!text1 && !text2) {
-                        // Both NULL
-                    } else if (!text1 || !text2) {
-                        row_identical = 0;
-                    } else if (options->ignore_case) {
-                        if (strcasecmp(text1, text2) != 0) row_identical = 0;
-                    } else {
-                        if (strcmp(text1, text2) != 0) row_identical = 0;
-                    }
-                    break;
-                }
-                case SQLITE_BLOB: {
-                    const void *blob1 = sqlite3_column_blob(stmt1, col);
-                    const void *blob2 = sqlite3_column_blob(stmt2, col);
-                    int size1 = sqlite3_column_bytes(stmt1, col);
-                    int size2 = sqlite3_column_bytes(stmt2, col);
-                    if (size1 != size2 || memcmp(blob1, blob2, size1) != 0) {
-                        row_identical = 0;
-                    }
-                    break;
-                }
-                case SQLITE_NULL:
-                    // Both are NULL, identical
-                    break;
-            }
-            
-            if (!row_identical) break;
-        }
+        int row_identical = compare_row_values(stmt1, stmt2, options);
         
         if (!row_identical) {
             rows_different++;
@@ -426,6 +406,671 @@ static int is_ccvfs_file(const char *filename) {
     
     return 0;
 }
+
+// ============================================================================
+// PARALLEL COMPARISON (HASH AND PAGES MODES)
+// ============================================================================
+
+// 每个表最多切成的 rowid 区间数，rowid 稀疏时区间按跨度而不是行数切分
+// Most rowid ranges per table, sparse rowids split by span rather than by row count
+#define COMPARE_MAX_RANGES          4096
+#define COMPARE_PAGE_CHUNK          256     // Pages per PAGES task
+#define COMPARE_MAX_REPORTED_PAGES  10
+#define COMPARE_FNV_OFFSET          0xcbf29ce484222325ULL
+#define COMPARE_FNV_PRIME           0x100000001b3ULL
+
+// One rowid range of one table, hashed in both databases
+typedef struct {
+    int table;                    // Index into the table list
+    int has_rowid;                // 0 for WITHOUT ROWID tables, hashed whole and unordered
+    sqlite3_int64 lo, hi;         // Inclusive rowid bounds
+    uint64_t hash[2];
+    sqlite3_int64 rows[2];
+    int rc;
+} CompareRange;
+
+// A run of pages compared in both databases
+typedef struct {
+    uint32_t first;               // First page number
+    uint32_t count;
+    int different;                // Pages that differ
+    uint32_t diff_pages[COMPARE_MAX_REPORTED_PAGES];
+    int rc;
+} ComparePageRun;
+
+// Task queue shared by the workers
+typedef struct {
+    const char *db_path[2];
+    const char *vfs[2];
+    const CompareOptions *options;
+    char **tables;
+    CompareRange *ranges;
+    ComparePageRun *runs;
+    uint32_t page_size;
+    int count;
+    int next;
+    pthread_mutex_t mutex;
+} CompareQueue;
+
+static int compare_next_task(CompareQueue *pQueue) {
+    int i;
+
+    pthread_mutex_lock(&pQueue->mutex);
+    i = pQueue->next < pQueue->count ? pQueue->next++ : -1;
+    pthread_mutex_unlock(&pQueue->mutex);
+    return i;
+}
+
+// 在线程池上运行队列中的任务，没有线程能启动时在当前线程运行
+// Run the queued tasks on a pool of threads, inline when no thread starts
+static int compare_run_pool(CompareQueue *pQueue, void *(*xWorker)(void*)) {
+    int nThread = pQueue->options->threads;
+    pthread_t *aThread;
+    int nStarted = 0;
+
+    if (nThread <= 0) {
+        long nCpu = sysconf(_SC_NPROCESSORS_ONLN);
+        nThread = nCpu > 0 ? (int)nCpu : 1;
+    }
+    if (nThread > pQueue->count) nThread = pQueue->count > 0 ? pQueue->count : 1;
+
+    aThread = (pthread_t*)malloc(sizeof(pthread_t) * nThread);
+    if (aThread) {
+        for (int i = 0; i < nThread; i++) {
+            if (pthread_create(&aThread[nStarted], NULL, xWorker, pQueue) == 0) nStarted++;
+        }
+    }
+    if (nStarted == 0) {
+        xWorker(pQueue);
+        nStarted = 1;
+    } else {
+        for (int i = 0; i < nStarted; i++) pthread_join(aThread[i], NULL);
+    }
+    free(aThread);
+    return nStarted;
+}
+
+static int compare_open(const char *db_path, const char *vfs, sqlite3 **pDb) {
+    int rc = sqlite3_open_v2(db_path, pDb, SQLITE_OPEN_READONLY, vfs);
+
+    if (rc != SQLITE_OK) {
+        sqlite3_close(*pDb);
+        *pDb = NULL;
+    }
+    return rc;
+}
+
+// FNV-1a over 8-byte words, then the tail bytes
+static uint64_t compare_hash_bytes(uint64_t h, const void *pData, int n) {
+    const unsigned char *z = (const unsigned char*)pData;
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        uint64_t w;
+        memcpy(&w, z + i, 8);
+        h ^= w;
+        h *= COMPARE_FNV_PRIME;
+        h ^= h >> 29;
+    }
+    for (; i < n; i++) {
+        h ^= z[i];
+        h *= COMPARE_FNV_PRIME;
+    }
+    return h;
+}
+
+// splitmix64 finalizer, spreads row hashes before they are summed
+static uint64_t compare_hash_mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+// 按与 compare_row_values 相同的相等规则哈希当前行
+// Hash the current row under the same equality rules as compare_row_values
+static uint64_t compare_hash_row(sqlite3_stmt *pStmt, uint64_t h, const CompareOptions *options) {
+    int nCol = sqlite3_column_count(pStmt);
+
+    for (int col = 0; col < nCol; col++) {
+        unsigned char type = (unsigned char)sqlite3_column_type(pStmt, col);
+
+        h = compare_hash_bytes(h, &type, 1);
+        switch (type) {
+            case SQLITE_INTEGER: {
+                sqlite3_int64 v = sqlite3_column_int64(pStmt, col);
+                h = compare_hash_bytes(h, &v, sizeof(v));
+                break;
+            }
+            case SQLITE_FLOAT: {
+                double v = sqlite3_column_double(pStmt, col);
+                if (v == 0.0) v = 0.0;    // -0.0 equals 0.0
+                h = compare_hash_bytes(h, &v, sizeof(v));
+                break;
+            }
+            case SQLITE_TEXT: {
+                const unsigned char *z = sqlite3_column_text(pStmt, col);
+                int n = (int)strlen((const char*)z);
+                if (options->ignore_case) {
+                    for (int i = 0; i < n; i++) {
+                        unsigned char c = (unsigned char)tolower(z[i]);
+                        h = compare_hash_bytes(h, &c, 1);
+                    }
+                } else {
+                    h = compare_hash_bytes(h, z, n);
+                }
+                h = compare_hash_bytes(h, &n, sizeof(n));
+                break;
+            }
+            case SQLITE_BLOB: {
+                int n = sqlite3_column_bytes(pStmt, col);
+                h = compare_hash_bytes(h, sqlite3_column_blob(pStmt, col), n);
+                h = compare_hash_bytes(h, &n, sizeof(n));
+                break;
+            }
+            default:
+                break;
+        }
+    }
+    return h;
+}
+
+static sqlite3_stmt *compare_prepare_range(sqlite3 *db, const char *table_name, int has_rowid) {
+    sqlite3_stmt *pStmt = NULL;
+    char *zSql = has_rowid
+        ? sqlite3_mprintf("SELECT rowid, * FROM \"%w\" WHERE rowid BETWEEN ?1 AND ?2 ORDER BY rowid", table_name)
+        : sqlite3_mprintf("SELECT * FROM \"%w\"", table_name);
+
+    if (zSql) {
+        sqlite3_prepare_v2(db, zSql, -1, &pStmt, NULL);
+        sqlite3_free(zSql);
+    }
+    return pStmt;
+}
+
+// Hash the rows of one range
+static int compare_hash_range(sqlite3_stmt *pStmt, const CompareRange *pRange, const CompareOptions *options,
+                              uint64_t *pHash, sqlite3_int64 *pRows) {
+    int unordered = options->unordered_hash || !pRange->has_rowid;
+    uint64_t h = unordered ? 0 : COMPARE_FNV_OFFSET;
+    sqlite3_int64 nRow = 0;
+    int rc;
+
+    if (pRange->has_rowid) {
+        sqlite3_bind_int64(pStmt, 1, pRange->lo);
+        sqlite3_bind_int64(pStmt, 2, pRange->hi);
+    }
+    while ((rc = sqlite3_step(pStmt)) == SQLITE_ROW) {
+        if (unordered) {
+            h += compare_hash_mix(compare_hash_row(pStmt, COMPARE_FNV_OFFSET, options));
+        } else {
+            h = compare_hash_row(pStmt, h, options);
+        }
+        nRow++;
+    }
+    sqlite3_reset(pStmt);
+    *pHash = h;
+    *pRows = nRow;
+    return rc == SQLITE_DONE ? SQLITE_OK : rc;
+}
+
+// 每个线程打开自己的一对只读连接，同一个表的区间复用预编译语句
+// Every thread opens its own pair of read-only connections and reuses statements across ranges of a table
+static void *compare_hash_worker(void *pArg) {
+    CompareQueue *pQueue = (CompareQueue*)pArg;
+    sqlite3 *aDb[2] = {NULL, NULL};
+    sqlite3_stmt *aStmt[2] = {NULL, NULL};
+    int iTable = -1;
+    int rc;
+    int i;
+
+    rc = compare_open(pQueue->db_path[0], pQueue->vfs[0], &aDb[0]);
+    if (rc == SQLITE_OK) rc = compare_open(pQueue->db_path[1], pQueue->vfs[1], &aDb[1]);
+
+    while ((i = compare_next_task(pQueue)) >= 0) {
+        CompareRange *pRange = &pQueue->ranges[i];
+
+        if (rc != SQLITE_OK) {
+            pRange->rc = rc;
+            continue;
+        }
+        if (pRange->table != iTable) {
+            for (int k = 0; k < 2; k++) {
+                sqlite3_finalize(aStmt[k]);
+                aStmt[k] = compare_prepare_range(aDb[k], pQueue->tables[pRange->table], pRange->has_rowid);
+            }
+            iTable = pRange->table;
+        }
+        for (int k = 0; k < 2 && pRange->rc == SQLITE_OK; k++) {
+            pRange->rc = aStmt[k] ? compare_hash_range(aStmt[k], pRange, pQueue->options, &pRange->hash[k],
+                                                       &pRange->rows[k])
+                                  : SQLITE_ERROR;
+        }
+    }
+
+    for (int k = 0; k < 2; k++) {
+        sqlite3_finalize(aStmt[k]);
+        sqlite3_close(aDb[k]);
+    }
+    return NULL;
+}
+
+// 返回表两边的 rowid 范围，WITHOUT ROWID 表返回 has_rowid = 0
+// Return the rowid bounds of a table over both databases, has_rowid = 0 for WITHOUT ROWID tables
+static int compare_rowid_bounds(sqlite3 *db1, sqlite3 *db2, const char *table_name, int *pHasRowid,
+                                sqlite3_int64 *pLo, sqlite3_int64 *pHi) {
+    sqlite3 *aDb[2] = {db1, db2};
+    char *zSql = sqlite3_mprintf("SELECT min(rowid), max(rowid) FROM \"%w\"", table_name);
+    int found = 0;
+    int rc = SQLITE_OK;
+
+    if (!zSql) return SQLITE_NOMEM;
+    *pHasRowid = 1;
+    *pLo = *pHi = 0;
+    for (int k = 0; k < 2 && rc == SQLITE_OK; k++) {
+        sqlite3_stmt *pStmt = NULL;
+
+        if (sqlite3_prepare_v2(aDb[k], zSql, -1, &pStmt, NULL) != SQLITE_OK) {
+            // No rowid column, the table is hashed whole
+            *pHasRowid = 0;
+            break;
+        }
+        rc = sqlite3_step(pStmt);
+        if (rc == SQLITE_ROW) {
+            rc = SQLITE_OK;
+            if (sqlite3_column_type(pStmt, 0) != SQLITE_NULL) {
+                sqlite3_int64 lo = sqlite3_column_int64(pStmt, 0);
+                sqlite3_int64 hi = sqlite3_column_int64(pStmt, 1);
+                if (!found || lo < *pLo) *pLo = lo;
+                if (!found || hi > *pHi) *pHi = hi;
+                found = 1;
+            }
+        }
+        sqlite3_finalize(pStmt);
+    }
+    sqlite3_free(zSql);
+    return rc;
+}
+
+// 逐行复查一个哈希不同的区间，按 rowid 归并两边的行
+// Re-read one range whose hashes differ, merging the rows of both sides by rowid
+static int compare_range_rows(sqlite3 *db1, sqlite3 *db2, const char *table_name, const CompareRange *pRange,
+                              const CompareOptions *options, int *pCompared, int *pDifferent) {
+    sqlite3_stmt *stmt1 = compare_prepare_range(db1, table_name, pRange->has_rowid);
+    sqlite3_stmt *stmt2 = compare_prepare_range(db2, table_name, pRange->has_rowid);
+    int rc = SQLITE_OK;
+    int s1, s2;
+
+    *pCompared = 0;
+    *pDifferent = 0;
+    if (!stmt1 || !stmt2) {
+        rc = SQLITE_ERROR;
+        goto range_done;
+    }
+    if (pRange->has_rowid) {
+        sqlite3_bind_int64(stmt1, 1, pRange->lo);
+        sqlite3_bind_int64(stmt1, 2, pRange->hi);
+        sqlite3_bind_int64(stmt2, 1, pRange->lo);
+        sqlite3_bind_int64(stmt2, 2, pRange->hi);
+    }
+
+    s1 = sqlite3_step(stmt1);
+    s2 = sqlite3_step(stmt2);
+    while (s1 == SQLITE_ROW || s2 == SQLITE_ROW) {
+        int advance1 = s1 == SQLITE_ROW;
+        int advance2 = s2 == SQLITE_ROW;
+
+        if (advance1 && advance2) {
+            if (pRange->has_rowid) {
+                sqlite3_int64 r1 = sqlite3_column_int64(stmt1, 0);
+                sqlite3_int64 r2 = sqlite3_column_int64(stmt2, 0);
+                if (r1 < r2) advance2 = 0;
+                if (r2 < r1) advance1 = 0;
+            }
+            if (advance1 && advance2 && compare_row_values(stmt1, stmt2, options)) {
+                (*pCompared)++;
+                if (advance1) s1 = sqlite3_step(stmt1);
+                if (advance2) s2 = sqlite3_step(stmt2);
+                continue;
+            }
+        }
+
+        // Rows that differ, or exist on one side only
+        (*pCompared)++;
+        (*pDifferent)++;
+        if (options->verbose && *pDifferent <= 5) {
+            if (pRange->has_rowid) {
+                sqlite3_int64 rowid = sqlite3_column_int64(advance1 ? stmt1 : stmt2, 0);
+                printf("DATA DIFFERENCE: Table '%s' rowid %lld %s\n", table_name, (long long)rowid,
+                       advance1 && advance2 ? "differs" : advance1 ? "exists in database 1 only"
+                                                                   : "exists in database 2 only");
+            } else {
+                printf("DATA DIFFERENCE: Table '%s' row %d differs\n", table_name, *pCompared);
+            }
+        }
+        if (advance1) s1 = sqlite3_step(stmt1);
+        if (advance2) s2 = sqlite3_step(stmt2);
+    }
+    if (s1 != SQLITE_DONE || s2 != SQLITE_DONE) {
+        fprintf(stderr, "Error stepping through table '%s': %s\n", table_name,
+                sqlite3_errmsg(s1 != SQLITE_DONE ? db1 : db2));
+        rc = s1 != SQLITE_DONE ? s1 : s2;
+    }
+
+range_done:
+    sqlite3_finalize(stmt1);
+    sqlite3_finalize(stmt2);
+    return rc;
+}
+
+// 用哈希区间比较表数据，aDifferent 返回每个表不同的行数
+// Compare table data by hashed ranges, aDifferent receives the rows that differ per table
+static int compare_tables_hashed(sqlite3 *db1, sqlite3 *db2, const char *db1_path, const char *db2_path,
+                                 const char *vfs1, const char *vfs2, char **tables, const int *aCompare,
+                                 int table_count, const CompareOptions *options, CompareResult *result,
+                                 int *aDifferent) {
+    uint64_t nRangeRows = options->range_rows > 0 ? (uint64_t)options->range_rows : COMPARE_DEFAULT_RANGE_ROWS;
+    CompareQueue queue;
+    int nAlloc = 0;
+    int rc = SQLITE_OK;
+
+    memset(&queue, 0, sizeof(queue));
+    queue.db_path[0] = db1_path;
+    queue.db_path[1] = db2_path;
+    queue.vfs[0] = vfs1;
+    queue.vfs[1] = vfs2;
+    queue.options = options;
+    queue.tables = tables;
+
+    // Plan the ranges of every table
+    for (int t = 0; t < table_count && rc == SQLITE_OK; t++) {
+        sqlite3_int64 lo, hi;
+        uint64_t span, width;
+        int has_rowid, nRange;
+
+        if (!aCompare[t]) continue;
+        rc = compare_rowid_bounds(db1, db2, tables[t], &has_rowid, &lo, &hi);
+        if (rc != SQLITE_OK) break;
+
+        span = (uint64_t)hi - (uint64_t)lo + 1;
+        if (span == 0) span = UINT64_MAX;       // Every rowid
+        nRange = !has_rowid ? 1
+               : span / nRangeRows >= COMPARE_MAX_RANGES ? COMPARE_MAX_RANGES
+               : (int)((span + nRangeRows - 1) / nRangeRows);
+        if (nRange < 1) nRange = 1;
+        width = span / (uint64_t)nRange + (span % (uint64_t)nRange != 0);
+
+        if (queue.count + nRange > nAlloc) {
+            int nNew = (queue.count + nRange) * 2;
+            CompareRange *aNew = (CompareRange*)realloc(queue.ranges, sizeof(CompareRange) * nNew);
+            if (!aNew) {
+                rc = SQLITE_NOMEM;
+                break;
+            }
+            queue.ranges = aNew;
+            nAlloc = nNew;
+        }
+        for (int r = 0; r < nRange; r++) {
+            CompareRange *pRange = &queue.ranges[queue.count++];
+            uint64_t first = (uint64_t)lo + (uint64_t)r * width;
+
+            memset(pRange, 0, sizeof(*pRange));
+            pRange->table = t;
+            pRange->has_rowid = has_rowid;
+            pRange->lo = (sqlite3_int64)first;
+            pRange->hi = r == nRange - 1 ? hi : (sqlite3_int64)(first + width - 1);
+        }
+    }
+    if (rc != SQLITE_OK || queue.count == 0) {
+        free(queue.ranges);
+        return rc;
+    }
+
+    pthread_mutex_init(&queue.mutex, NULL);
+    result->threads = compare_run_pool(&queue, compare_hash_worker);
+    pthread_mutex_destroy(&queue.mutex);
+
+    // Re-read the ranges whose hashes differ
+    for (int i = 0; i < queue.count && rc == SQLITE_OK; i++) {
+        CompareRange *pRange = &queue.ranges[i];
+        const char *table_name = tables[pRange->table];
+
+        rc = pRange->rc;
+        if (rc != SQLITE_OK) {
+            fprintf(stderr, "Error hashing table '%s': %s\n", table_name, sqlite3_errstr(rc));
+            break;
+        }
+        result->ranges_compared++;
+        if (pRange->hash[0] == pRange->hash[1] && pRange->rows[0] == pRange->rows[1]) {
+            result->records_compared += (int)pRange->rows[0];
+            result->records_identical += (int)pRange->rows[0];
+            continue;
+        }
+
+        int compared = 0, different = 0;
+        result->ranges_different++;
+        rc = compare_range_rows(db1, db2, table_name, pRange, options, &compared, &different);
+        if (rc != SQLITE_OK) break;
+        if (options->verbose) {
+            if (pRange->has_rowid) {
+                printf("HASH DIFFERENCE: Table '%s' rowids %lld..%lld: %lld vs %lld rows, %d differ\n", table_name,
+                       (long long)pRange->lo, (long long)pRange->hi, (long long)pRange->rows[0],
+                       (long long)pRange->rows[1], different);
+            } else {
+                printf("HASH DIFFERENCE: Table '%s': %lld vs %lld rows, %d differ\n", table_name,
+                       (long long)pRange->rows[0], (long long)pRange->rows[1], different);
+            }
+        }
+        result->records_compared += compared;
+        result->records_identical += compared - different;
+        result->records_different += different;
+        aDifferent[pRange->table] += different;
+    }
+
+    for (int t = 0; t < table_count; t++) {
+        if (aDifferent[t] > 0) {
+            printf("DATA DIFFERENCE: Table '%s' has %d different rows\n", tables[t], aDifferent[t]);
+        } else if (aCompare[t] && options->verbose) {
+            printf("DATA MATCH: Table '%s' has identical content\n", tables[t]);
+        }
+    }
+
+    free(queue.ranges);
+    return rc;
+}
+
+// Read one page through the connection's file handle
+static int compare_read_page(sqlite3_file *pFile, uint32_t page_size, uint32_t pgno, unsigned char *aBuf) {
+    return pFile->pMethods->xRead(pFile, aBuf, (int)page_size, (sqlite3_int64)(pgno - 1) * page_size);
+}
+
+// 第1页中每次提交都会变化的计数字段不参与比较
+// The counters in page 1 that change on every commit take no part in the comparison
+static void compare_clear_page1_counters(unsigned char *aPage) {
+    memset(aPage + 24, 0, 4);     // File change counter
+    memset(aPage + 92, 0, 8);     // Version-valid-for number and SQLITE_VERSION_NUMBER
+}
+
+// 打开连接并开启读事务，页面通过连接自己的文件句柄读取，POSIX 锁保持有效
+// Open a connection with a read transaction, pages are read through the connection's own file handle so
+// its POSIX locks stay valid
+static int compare_open_snapshot(const char *db_path, const char *vfs, sqlite3 **pDb, sqlite3_file **ppFile) {
+    int rc = compare_open(db_path, vfs, pDb);
+
+    if (rc == SQLITE_OK) rc = sqlite3_exec(*pDb, "BEGIN; SELECT count(*) FROM sqlite_master;", NULL, NULL, NULL);
+    if (rc == SQLITE_OK) rc = sqlite3_file_control(*pDb, "main", SQLITE_FCNTL_FILE_POINTER, ppFile);
+    if (rc == SQLITE_OK && (!*ppFile || !(*ppFile)->pMethods)) rc = SQLITE_ERROR;
+    return rc;
+}
+
+static void *compare_page_worker(void *pArg) {
+    CompareQueue *pQueue = (CompareQueue*)pArg;
+    sqlite3 *aDb[2] = {NULL, NULL};
+    sqlite3_file *aFile[2] = {NULL, NULL};
+    unsigned char *aBuf[2];
+    int rc;
+    int i;
+
+    aBuf[0] = (unsigned char*)malloc(pQueue->page_size);
+    aBuf[1] = (unsigned char*)malloc(pQueue->page_size);
+    rc = aBuf[0] && aBuf[1] ? SQLITE_OK : SQLITE_NOMEM;
+    for (int k = 0; k < 2 && rc == SQLITE_OK; k++) {
+        rc = compare_open_snapshot(pQueue->db_path[k], pQueue->vfs[k], &aDb[k], &aFile[k]);
+    }
+
+    while ((i = compare_next_task(pQueue)) >= 0) {
+        ComparePageRun *pRun = &pQueue->runs[i];
+
+        pRun->rc = rc;
+        for (uint32_t p = pRun->first; p < pRun->first + pRun->count && pRun->rc == SQLITE_OK; p++) {
+            pRun->rc = compare_read_page(aFile[0], pQueue->page_size, p, aBuf[0]);
+            if (pRun->rc == SQLITE_OK) pRun->rc = compare_read_page(aFile[1], pQueue->page_size, p, aBuf[1]);
+            if (pRun->rc != SQLITE_OK) break;
+            if (p == 1) {
+                compare_clear_page1_counters(aBuf[0]);
+                compare_clear_page1_counters(aBuf[1]);
+            }
+            if (memcmp(aBuf[0], aBuf[1], pQueue->page_size) != 0) {
+                if (pRun->different < COMPARE_MAX_REPORTED_PAGES) pRun->diff_pages[pRun->different] = p;
+                pRun->different++;
+            }
+        }
+    }
+
+    for (int k = 0; k < 2; k++) {
+        sqlite3_close(aDb[k]);    // Ends the read transaction
+        free(aBuf[k]);
+    }
+    return NULL;
+}
+
+// 页映像看不到 WAL 中的帧，WAL 非空时拒绝比较
+// Page images do not see frames in the WAL, refuse while the WAL is not empty
+static int compare_wal_is_empty(const char *db_path) {
+    char *zWal = sqlite3_mprintf("%s-wal", db_path);
+    struct stat st;
+    int empty;
+
+    if (!zWal) return 0;
+    empty = stat(zWal, &st) != 0 || st.st_size == 0;
+    sqlite3_free(zWal);
+    return empty;
+}
+
+static int compare_pragma_int(sqlite3 *db, const char *zPragma, int *pValue) {
+    sqlite3_stmt *pStmt = NULL;
+    int rc = sqlite3_prepare_v2(db, zPragma, -1, &pStmt, NULL);
+
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_step(pStmt);
+        if (rc == SQLITE_ROW) {
+            *pValue = sqlite3_column_int(pStmt, 0);
+            rc = SQLITE_OK;
+        }
+    }
+    sqlite3_finalize(pStmt);
+    return rc;
+}
+
+// 比较两个数据库解码后的页映像
+// Compare the decoded page images of two databases
+static int compare_database_pages(const char *db1_path, const char *db2_path, const char *vfs1, const char *vfs2,
+                                  const CompareOptions *options, CompareResult *result) {
+    const char *aPath[2] = {db1_path, db2_path};
+    const char *aVfs[2] = {vfs1, vfs2};
+    sqlite3 *aDb[2] = {NULL, NULL};
+    int aPageSize[2] = {0, 0};
+    int aPageCount[2] = {0, 0};
+    int nReported = 0;            // Differing pages found by the workers
+    CompareQueue queue;
+    uint32_t nCommon;
+    int rc = SQLITE_OK;
+
+    if (options->compare_schema_only || options->ignore_case || options->ignore_tables) {
+        fprintf(stderr, "Page comparison does not support schema-only, ignore-case or ignored tables\n");
+        return SQLITE_MISUSE;
+    }
+
+    for (int k = 0; k < 2 && rc == SQLITE_OK; k++) {
+        if (!compare_wal_is_empty(aPath[k])) {
+            fprintf(stderr, "Database %d '%s' has frames in its WAL file, checkpoint it before a page comparison\n",
+                    k + 1, aPath[k]);
+            rc = SQLITE_BUSY;
+            break;
+        }
+        rc = compare_open(aPath[k], aVfs[k], &aDb[k]);
+        if (rc == SQLITE_OK) rc = compare_pragma_int(aDb[k], "PRAGMA page_size", &aPageSize[k]);
+        if (rc == SQLITE_OK) rc = compare_pragma_int(aDb[k], "PRAGMA page_count", &aPageCount[k]);
+        if (rc != SQLITE_OK) {
+            fprintf(stderr, "Cannot read database %d '%s': %s\n", k + 1, aPath[k],
+                    aDb[k] ? sqlite3_errmsg(aDb[k]) : sqlite3_errstr(rc));
+        }
+    }
+    sqlite3_close(aDb[0]);
+    sqlite3_close(aDb[1]);
+    if (rc != SQLITE_OK) return rc;
+
+    result->pages_compared = aPageCount[0] > aPageCount[1] ? aPageCount[0] : aPageCount[1];
+    if (aPageSize[0] != aPageSize[1]) {
+        printf("PAGE DIFFERENCE: Page sizes differ: %d vs %d\n", aPageSize[0], aPageSize[1]);
+        result->pages_different = result->pages_compared;
+        return SQLITE_OK;
+    }
+    if (aPageCount[0] != aPageCount[1]) {
+        printf("PAGE DIFFERENCE: Page counts differ: %d vs %d\n", aPageCount[0], aPageCount[1]);
+        result->pages_different += abs(aPageCount[0] - aPageCount[1]);
+    }
+
+    nCommon = (uint32_t)(aPageCount[0] < aPageCount[1] ? aPageCount[0] : aPageCount[1]);
+    if (nCommon == 0) return SQLITE_OK;
+
+    memset(&queue, 0, sizeof(queue));
+    queue.db_path[0] = db1_path;
+    queue.db_path[1] = db2_path;
+    queue.vfs[0] = vfs1;
+    queue.vfs[1] = vfs2;
+    queue.options = options;
+    queue.page_size = (uint32_t)aPageSize[0];
+    queue.count = (int)((nCommon + COMPARE_PAGE_CHUNK - 1) / COMPARE_PAGE_CHUNK);
+    queue.runs = (ComparePageRun*)calloc(queue.count, sizeof(ComparePageRun));
+    if (!queue.runs) return SQLITE_NOMEM;
+    for (int i = 0; i < queue.count; i++) {
+        queue.runs[i].first = 1 + (uint32_t)i * COMPARE_PAGE_CHUNK;
+        queue.runs[i].count = nCommon - (uint32_t)i * COMPARE_PAGE_CHUNK < COMPARE_PAGE_CHUNK
+                            ? nCommon - (uint32_t)i * COMPARE_PAGE_CHUNK : COMPARE_PAGE_CHUNK;
+    }
+
+    pthread_mutex_init(&queue.mutex, NULL);
+    result->threads = compare_run_pool(&queue, compare_page_worker);
+    pthread_mutex_destroy(&queue.mutex);
+
+    for (int i = 0; i < queue.count; i++) {
+        ComparePageRun *pRun = &queue.runs[i];
+
+        if (pRun->rc != SQLITE_OK) {
+            fprintf(stderr, "Error reading pages %u..%u: %s\n", pRun->first, pRun->first + pRun->count - 1,
+                    sqlite3_errstr(pRun->rc));
+            rc = pRun->rc;
+            break;
+        }
+        for (int d = 0; d < pRun->different && d < COMPARE_MAX_REPORTED_PAGES; d++) {
+            if (nReported + d < COMPARE_MAX_REPORTED_PAGES) {
+                printf("PAGE DIFFERENCE: Page %u differs\n", pRun->diff_pages[d]);
+            }
+        }
+        nReported += pRun->different;
+        result->pages_different += pRun->different;
+    }
+    if (rc == SQLITE_OK && nReported > COMPARE_MAX_REPORTED_PAGES) {
+        printf("PAGE DIFFERENCE: ... %d more pages differ\n", nReported - COMPARE_MAX_REPORTED_PAGES);
+    }
+
+    free(queue.runs);
+    return rc;
+}
+
 int compare_databases(const char *db1_path, const char *db2_path, 
                       const CompareOptions *options, CompareResult *result) {
     sqlite3 *db1 = NULL, *db2 = NULL;
@@ -439,6 +1084,10 @@ int compare_databases(const char *db1_path, const char *db2_path,
     const char *vfs1 = is_ccvfs_file(db1_path) ? "ccvfs" : NULL;
     const char *vfs2 = is_ccvfs_file(db2_path) ? "ccvfs" : NULL;
     
+    if (options->mode == COMPARE_MODE_PAGES) {
+        return compare_database_pages(db1_path, db2_path, vfs1, vfs2, options, result);
+    }
+    
     rc = sqlite3_open_v2(db1_path, &db1, SQLITE_OPEN_READONLY, vfs1);
     if (rc != SQLITE_OK) {
         fprintf(stderr, "Cannot open database 1 '%s': %s\n", db1_path, sqlite3_errmsg(db1));
@@ -508,6 +1157,15 @@ int compare_databases(const char *db1_path, const char *db2_path,
     
     printf("Comparing %d tables...\n\n", all_table_count);
     
+    // Per-table state: 0 identical so far, 1 different; HASH mode defers the data comparison
+    int *table_state = calloc(all_table_count + 1, sizeof(int));
+    int *table_hashed = calloc(all_table_count + 1, sizeof(int));
+    int *table_rows_different = calloc(all_table_count + 1, sizeof(int));
+    if (!table_state || !table_hashed || !table_rows_different) {
+        rc = SQLITE_NOMEM;
+        goto cleanup_all;
+    }
+    
     // Compare each table
     for (int i = 0; i < all_table_count; i++) {
         const char *table_name = all_tables[i];
@@ -544,29 +1202,50 @@ int compare_databases(const char *db1_path, const char *db2_path,
             if (!exists_in_db1 && !exists_in_db2) {
                 printf("  (This should not happen - internal error)\n");
             }
+            table_state[i] = -1;    // Already counted
             result->tables_different++;
             continue;
         }
         
+        int differences_before = result->schema_differences + result->records_different;
+        
         // Compare schema
         compare_table_schemas(db1, db2, table_name, options, result);
         
         // Compare data (unless schema-only mode)
         if (!options->compare_schema_only) {
-            compare_table_data_detailed(db1, db2, table_name, options, result);
+            if (options->mode == COMPARE_MODE_HASH) {
+                table_hashed[i] = 1;
+            } else {
+                compare_table_data_detailed(db1, db2, table_name, options, result);
+            }
         }
         
-        // Determine if table is identical
-        int table_identical = 1;
-        // This is a simplification - in a full implementation, we'd track per-table differences
-        
-        if (table_identical) {
-            result->tables_identical++;
-        } else {
+        if (result->schema_differences + result->records_different != differences_before) {
+            table_state[i] = 1;
+        }
+    }
+    
+    if (options->mode == COMPARE_MODE_HASH && !options->compare_schema_only) {
+        rc = compare_tables_hashed(db1, db2, db1_path, db2_path, vfs1, vfs2, all_tables, table_hashed,
+                                   all_table_count, options, result, table_rows_different);
+    }
+    
+    // Determine which tables are identical
+    for (int i = 0; i < all_table_count; i++) {
+        if (table_state[i] < 0) continue;
+        if (table_state[i] > 0 || table_rows_different[i] > 0) {
             result->tables_different++;
+        } else {
+            result->tables_identical++;
         }
     }
     
+cleanup_all:
+    free(table_state);
+    free(table_hashed);
+    free(table_rows_different);
+    
     // Cleanup all_tables
     for (int i = 0; i < all_table_count; i++) {
         free(all_tables[i]);
@@ -599,19 +1278,32 @@ cleanup:
 // Print comparison results
 void print_compare_results(const CompareResult *result, const CompareOptions *options) {
     printf("\n=== Database Comparison Results ===\n");
-    printf("Tables compared:    %d\n", result->tables_compared);
-    printf("  Identical:        %d\n", result->tables_identical);
-    printf("  Different:        %d\n", result->tables_different);
-    
-    if (!options->compare_schema_only) {
-        printf("Records compared:   %d\n", result->records_compared);
-        printf("  Identical:        %d\n", result->records_identical);
-        printf("  Different:        %d\n", result->records_different);
+    if (options->mode == COMPARE_MODE_PAGES) {
+        printf("Pages compared:     %d\n", result->pages_compared);
+        printf("  Identical:        %d\n", result->pages_compared - result->pages_different);
+        printf("  Different:        %d\n", result->pages_different);
+        printf("Threads:            %d\n", result->threads);
+    } else {
+        printf("Tables compared:    %d\n", result->tables_compared);
+        printf("  Identical:        %d\n", result->tables_identical);
+        printf("  Different:        %d\n", result->tables_different);
+        
+        if (!options->compare_schema_only) {
+            printf("Records compared:   %d\n", result->records_compared);
+            printf("  Identical:        %d\n", result->records_identical);
+            printf("  Different:        %d\n", result->records_different);
+        }
+        if (options->mode == COMPARE_MODE_HASH && !options->compare_schema_only) {
+            printf("Ranges hashed:      %d (%s, %d threads)\n", result->ranges_compared,
+                   options->unordered_hash ? "unordered" : "ordered", result->threads);
+            printf("  Re-read:          %d\n", result->ranges_different);
+        }
+        
+        printf("Schema differences: %d\n", result->schema_differences);
     }
     
-    printf("Schema differences: %d\n", result->schema_differences);
-    
-    int total_differences = result->tables_different + result->records_different + result->schema_differences;
+    int total_differences = result->tables_different + result->records_different + result->schema_differences +
+                            result->pages_different;
     if (total_differences == 0) {
         printf("\n✓ Databases are IDENTICAL\n");
     } else {
@@ -630,6 +1322,11 @@ static void print_usage(const char *program_name) {
     printf("  -w, --ignore-whitespace      忽略空白字符差异\n");
     printf("  -t, --ignore-tables <表名>   忽略指定的表（逗号分隔）\n");
     printf("  -k, --key <密钥>             加密数据库的解密密钥（十六进制格式）\n");
+    printf("  --hash                       按 rowid 区间并行计算哈希，只逐行复查哈希不同的区间\n");
+    printf("  --pages                      并行比较解码后的页映像\n");
+    printf("  --threads <数量>             并行线程数（默认: CPU核数）\n");
+    printf("  --range-rows <数量>          每个哈希区间的 rowid 数（默认: %d）\n", COMPARE_DEFAULT_RANGE_ROWS);
+    printf("  --unordered                  区间哈希与行顺序无关\n");
     printf("  -v, --verbose                详细输出\n");
     printf("  -h, --help                   显示帮助信息\n\n");
     
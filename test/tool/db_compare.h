@@ -10,6 +10,22 @@
 extern "C" {
 #endif
 
+/*
+ * 比较方式 - Comparison modes
+ * ROWS 在一对连接上逐行比较；HASH 把每个表按 rowid 切成区间，在线程池上（每个线程一对连接）
+ * 计算区间哈希，只逐行复查哈希不同的区间；PAGES 直接比较解码后的页映像。
+ * ROWS walks every table row by row on one pair of connections. HASH splits every table into
+ * rowid ranges, hashes the ranges on a pool of threads (one pair of connections per thread) and
+ * re-reads row by row only the ranges whose hashes differ. PAGES compares decoded page images.
+ */
+typedef enum {
+    COMPARE_MODE_ROWS = 0,    // Row by row (default)
+    COMPARE_MODE_HASH,        // Hashed rowid ranges on a worker pool
+    COMPARE_MODE_PAGES        // Decoded page images on a worker pool
+} CompareMode;
+
+#define COMPARE_DEFAULT_RANGE_ROWS  10000
+
 // Comparison result structure
 typedef struct {
     int tables_compared;
@@ -19,6 +35,11 @@ typedef struct {
     int records_identical;
     int records_different;
     int schema_differences;
+    int ranges_compared;      // HASH: rowid ranges hashed
+    int ranges_different;     // HASH: ranges re-read row by row
+    int pages_compared;       // PAGES: pages in the larger database
+    int pages_different;      // PAGES: pages that differ or exist in one database only
+    int threads;              // HASH and PAGES: worker threads used
 } CompareResult;
 
 // Comparison options
@@ -29,6 +50,10 @@ typedef struct {
     int verbose;              // Verbose output
     const char *ignore_tables; // Comma-separated list of tables to ignore
     const char *key_hex;      // Encryption key in hex format for encrypted databases
+    CompareMode mode;         // COMPARE_MODE_ROWS by default
+    int threads;              // HASH and PAGES: 0 for one per online CPU
+    int range_rows;           // HASH: rowids per range, 0 for COMPARE_DEFAULT_RANGE_ROWS
+    int unordered_hash;       // HASH: sum of row hashes instead of a hash chained in rowid order
 } CompareOptions;
 
 // Main function to compare two databases
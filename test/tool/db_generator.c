@@ -5,6 +5,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <pthread.h>
+#include <unistd.h>
 #include <sys/stat.h>
 #include "db_generator.h"
 #ifndef _WIN32
@@ -16,6 +18,11 @@
  * Supports both compressed and uncompressed database generation
  */
 
+#define GEN_BATCH_ROWS   100          // Rows per batch, also rows per transaction
+#define GEN_MAX_COLUMNS  12           // Most bound columns of any table
+#define GEN_ROW_TEXT     4096         // Text arena of one row
+#define GEN_EPOCH        1704067200   // 2024-01-01 00:00:00 UTC, base of generated timestamps
+#define GEN_FILL_SEED    0x5EEDF111ULL // Seed of sqlite3_ccvfs_fill_data, which has no configuration
 
 // Get file size
 static long get_file_size(const char *filename) {
@@ -26,30 +33,67 @@ static long get_file_size(const char *filename) {
     return -1;
 }
 
-// Generate random string - optimized version with pre-generated random data
-static void generate_random_string(char *buffer, int length) {
+// xoshiro256** 伪随机数发生器，每行按 (种子, 表, 记录号) 单独播种，结果与线程数无关
+// xoshiro256** PRNG, seeded per row from (seed, table, record) so rows do not depend on the thread count
+typedef struct {
+    uint64_t s[4];
+} GenRng;
+
+static uint64_t gen_splitmix64(uint64_t *pState) {
+    uint64_t z = (*pState += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static void gen_rng_seed(GenRng *pRng, uint64_t seed, uint64_t stream) {
+    uint64_t x = seed ^ gen_splitmix64(&stream);
+
+    for (int i = 0; i < 4; i++) {
+        pRng->s[i] = gen_splitmix64(&x);
+    }
+}
+
+static inline uint64_t gen_rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+static uint64_t gen_rng_next(GenRng *pRng) {
+    uint64_t *s = pRng->s;
+    uint64_t result = gen_rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = gen_rotl(s[3], 45);
+    return result;
+}
+
+// Uniform value in [0, n) without a division
+static uint32_t gen_rng_below(GenRng *pRng, uint32_t n) {
+    return (uint32_t)(((gen_rng_next(pRng) >> 32) * n) >> 32);
+}
+
+// Generate random string, eight characters per PRNG draw
+static void generate_random_string(GenRng *pRng, char *buffer, int length) {
     const char charset[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789 ";
     int charset_size = sizeof(charset) - 1;
-    
-    // Generate multiple random values at once to reduce rand() calls
-    static unsigned int rand_cache = 0;
-    static int rand_bits = 0;
-    
+    uint64_t bits = 0;
+
     for (int i = 0; i < length - 1; i++) {
-        if (rand_bits < 8) {
-            rand_cache = rand();
-            rand_bits = 32;
-        }
-        buffer[i] = charset[(rand_cache & 0xFF) % charset_size];
-        rand_cache >>= 8;
-        rand_bits -= 8;
+        if ((i & 7) == 0) bits = gen_rng_next(pRng);
+        buffer[i] = charset[(bits & 0xFF) % charset_size];
+        bits >>= 8;
     }
     buffer[length - 1] = '\0';
 }
 
 // Generate Lorem ipsum text
-static void generate_lorem_text(char *buffer, int length) {
-    const char *lorem_words[] = {
+static void generate_lorem_text(GenRng *pRng, char *buffer, int length) {
+    static const char *lorem_words[] = {
         "Lorem", "ipsum", "dolor", "sit", "amet", "consectetur", "adipiscing", "elit",
         "sed", "do", "eiusmod", "tempor", "incididunt", "ut", "labore", "et", "dolore",
         "magna", "aliqua", "Ut", "enim", "ad", "minim", "veniam", "quis", "nostrud",
@@ -61,11 +105,11 @@ static void generate_lorem_text(char *buffer, int length) {
     
     int pos = 0;
     while (pos < length - 20) {  // Leave space for word and null terminator
-        const char *word = lorem_words[rand() % word_count];
+        const char *word = lorem_words[gen_rng_below(pRng, word_count)];
         int word_len = strlen(word);
         
         if (pos + word_len + 1 < length) {
-            strcpy(buffer + pos, word);
+            memcpy(buffer + pos, word, word_len);
             pos += word_len;
             if (pos < length - 1) {
                 buffer[pos++] = ' ';
@@ -77,11 +121,23 @@ static void generate_lorem_text(char *buffer, int length) {
     buffer[pos] = '\0';
 }
 
+// Fill bytes from PRNG draws, each byte mapped into [base, base + span)
+static void generate_bytes(GenRng *pRng, char *buffer, int length, int base, int span) {
+    uint64_t bits = 0;
+
+    for (int i = 0; i < length - 1; i++) {
+        if ((i & 7) == 0) bits = gen_rng_next(pRng);
+        buffer[i] = (char)(base + (int)((bits & 0xFF) % span));
+        bits >>= 8;
+    }
+    buffer[length - 1] = '\0';
+}
+
 // Generate data based on mode
-static void generate_data(char *buffer, int length, DataMode mode, int record_id) {
+static void generate_data(GenRng *pRng, char *buffer, int length, DataMode mode, int record_id) {
     switch (mode) {
         case DATA_MODE_RANDOM:
-            generate_random_string(buffer, length);
+            generate_random_string(pRng, buffer, length);
             break;
             
         case DATA_MODE_SEQUENTIAL:
@@ -89,60 +145,206 @@ static void generate_data(char *buffer, int length, DataMode mode, int record_id
             break;
             
         case DATA_MODE_LOREM:
-            generate_lorem_text(buffer, length);
+            generate_lorem_text(pRng, buffer, length);
             break;
             
         case DATA_MODE_BINARY:
-            // Optimized binary data generation
-            {
-                static unsigned int rand_cache = 0;
-                static int rand_bits = 0;
-                
-                for (int i = 0; i < length - 1; i++) {
-                    if (rand_bits < 8) {
-                        rand_cache = rand();
-                        rand_bits = 32;
-                    }
-                    buffer[i] = (char)(rand_cache & 0xFF);
-                    rand_cache >>= 8;
-                    rand_bits -= 8;
-                }
-            }
-            buffer[length - 1] = '\0';
+            generate_bytes(pRng, buffer, length, 0, 256);
             break;
             
         case DATA_MODE_MIXED:
             if (record_id % 4 == 0) {
-                generate_random_string(buffer, length);
+                generate_random_string(pRng, buffer, length);
             } else if (record_id % 4 == 1) {
-                generate_lorem_text(buffer, length);
+                generate_lorem_text(pRng, buffer, length);
             } else if (record_id % 4 == 2) {
-                snprintf(buffer, length, "Mixed_Record_%d_Time_%ld", record_id, time(NULL));
+                // 时间取自记录号而不是时钟，同一种子得到相同内容
+                // Time comes from the record, not the clock, so a seed gives the same content
+                snprintf(buffer, length, "Mixed_Record_%d_Time_%ld", record_id, (long)GEN_EPOCH + record_id);
             } else {
-                // Optimized printable ASCII generation
-                static unsigned int rand_cache = 0;
-                static int rand_bits = 0;
-                
-                for (int i = 0; i < length - 1; i++) {
-                    if (rand_bits < 8) {
-                        rand_cache = rand();
-                        rand_bits = 32;
-                    }
-                    buffer[i] = (char)(32 + ((rand_cache & 0xFF) % 95));
-                    rand_cache >>= 8;
-                    rand_bits -= 8;
-                }
-                buffer[length - 1] = '\0';
+                generate_bytes(pRng, buffer, length, 32, 95);
             }
             break;
     }
 }
 
+// 一行的列值：文本指向行内缓冲区或静态字符串，写入线程绑定时不复制
+// Column values of one row; text points into the row arena or at a static string, bound without a copy
+typedef struct {
+    int type;                   // SQLITE_INTEGER, SQLITE_FLOAT or SQLITE_TEXT
+    sqlite3_int64 i;
+    double r;
+    const char *z;
+} GenValue;
+
+typedef struct {
+    int table;                  // Table slot the row goes to
+    int nCol;
+    int nText;                  // Bytes of aText in use
+    GenValue aCol[GEN_MAX_COLUMNS];
+    char aText[GEN_ROW_TEXT];
+} GenRow;
+
+// Append a text column and return its buffer in the row arena
+static char *gen_col_text(GenRow *pRow, int size) {
+    GenValue *pVal = &pRow->aCol[pRow->nCol++];
+    char *z = &pRow->aText[pRow->nText];
+
+    pRow->nText += size;
+    pVal->type = SQLITE_TEXT;
+    pVal->z = z;
+    return z;
+}
+
+static void gen_col_static(GenRow *pRow, const char *z) {
+    GenValue *pVal = &pRow->aCol[pRow->nCol++];
+    pVal->type = SQLITE_TEXT;
+    pVal->z = z;
+}
+
+static void gen_col_int(GenRow *pRow, sqlite3_int64 v) {
+    GenValue *pVal = &pRow->aCol[pRow->nCol++];
+    pVal->type = SQLITE_INTEGER;
+    pVal->i = v;
+}
+
+static void gen_col_real(GenRow *pRow, double v) {
+    GenValue *pVal = &pRow->aCol[pRow->nCol++];
+    pVal->type = SQLITE_FLOAT;
+    pVal->r = v;
+}
+
+// Timestamp column derived from the record, so DEFAULT CURRENT_TIMESTAMP never makes runs differ
+static void gen_col_time(GenRow *pRow, int record_id, long offset) {
+    time_t t = (time_t)GEN_EPOCH + (time_t)record_id * 60 + offset;
+    struct tm tm;
+
+    gmtime_r(&t, &tm);
+    strftime(gen_col_text(pRow, 20), 20, "%Y-%m-%d %H:%M:%S", &tm);
+}
+
+// 各表的行生成函数，列顺序与表定义中的 INSERT 语句一致
+// Row builders, columns in the order of the table's INSERT statement
+static void fill_users(GenRow *pRow, GenRng *pRng, const GeneratorConfig *config, int record_id) {
+    (void)config;
+    snprintf(gen_col_text(pRow, 50), 50, "user_%d", record_id);
+    snprintf(gen_col_text(pRow, 100), 100, "user_%d@example.com", record_id);
+    snprintf(gen_col_text(pRow, 32), 32, "hash_%08x", (unsigned)gen_rng_next(pRng));
+    generate_data(pRng, gen_col_text(pRow, 50), 50, DATA_MODE_LOREM, record_id);
+    generate_data(pRng, gen_col_text(pRow, 50), 50, DATA_MODE_LOREM, record_id + 1);
+    snprintf(gen_col_text(pRow, 20), 20, "+1%03u%03u%04u", gen_rng_below(pRng, 900) + 100,
+             gen_rng_below(pRng, 900) + 100, gen_rng_below(pRng, 10000));
+    gen_col_static(pRow, (record_id % 10 == 0) ? "inactive" : "active");
+    gen_col_static(pRow, (record_id % 3 == 0) ? "{\"preferences\":{\"theme\":\"dark\",\"notifications\":true}}"
+                                              : "{\"preferences\":{\"theme\":\"dark\",\"notifications\":false}}");
+    gen_col_time(pRow, record_id, 0);
+    gen_col_time(pRow, record_id, 3600);
+}
+
+static void fill_products(GenRow *pRow, GenRng *pRng, const GeneratorConfig *config, int record_id) {
+    snprintf(gen_col_text(pRow, 50), 50, "SKU-%08d", record_id);
+    generate_data(pRng, gen_col_text(pRow, 200), 200, DATA_MODE_LOREM, record_id);
+    generate_data(pRng, gen_col_text(pRow, 512), 512, config->data_mode, record_id);
+    gen_col_int(pRow, (record_id % 10) + 1);
+    gen_col_real(pRow, (double)gen_rng_below(pRng, 10000) / 100.0);
+    gen_col_int(pRow, gen_rng_below(pRng, 1000));
+    gen_col_real(pRow, (double)gen_rng_below(pRng, 5000) / 1000.0);
+    gen_col_static(pRow, (record_id % 20 == 0) ? "discontinued" : "active");
+    snprintf(gen_col_text(pRow, 64), 64, "{\"brand\":\"Brand_%d\",\"weight_unit\":\"kg\"}", record_id % 50);
+    gen_col_time(pRow, record_id, 0);
+    gen_col_time(pRow, record_id, 3600);
+}
+
+static void fill_orders(GenRow *pRow, GenRng *pRng, const GeneratorConfig *config, int record_id) {
+    static const char *statuses[] = {"pending", "processing", "shipped", "delivered", "cancelled"};
+    static const char *payment_methods[] = {"credit_card", "paypal", "bank_transfer", "cash"};
+
+    gen_col_int(pRow, (record_id % 1000) + 1);
+    snprintf(gen_col_text(pRow, 50), 50, "ORD-%08d", record_id);
+    gen_col_static(pRow, statuses[record_id % 5]);
+    gen_col_real(pRow, (double)gen_rng_below(pRng, 100000) / 100.0);
+    gen_col_real(pRow, (double)gen_rng_below(pRng, 1000) / 100.0);
+    gen_col_real(pRow, (double)gen_rng_below(pRng, 5000) / 100.0);
+    gen_col_static(pRow, payment_methods[record_id % 4]);
+    generate_data(pRng, gen_col_text(pRow, 256), 256, DATA_MODE_LOREM, record_id);
+    generate_data(pRng, gen_col_text(pRow, 256), 256, DATA_MODE_LOREM, record_id + 1);
+    generate_data(pRng, gen_col_text(pRow, 512), 512, config->data_mode, record_id);
+    gen_col_time(pRow, record_id, 0);
+    gen_col_time(pRow, record_id, 3600);
+}
+
+static void fill_order_items(GenRow *pRow, GenRng *pRng, const GeneratorConfig *config, int record_id) {
+    int quantity = (int)gen_rng_below(pRng, 10) + 1;
+    double unit_price = (double)gen_rng_below(pRng, 10000) / 100.0;
+
+    (void)config;
+    gen_col_int(pRow, (record_id % 500) + 1);
+    gen_col_int(pRow, (record_id % 1000) + 1);
+    gen_col_int(pRow, quantity);
+    gen_col_real(pRow, unit_price);
+    gen_col_real(pRow, unit_price * quantity);
+    gen_col_time(pRow, record_id, 0);
+}
+
+static void fill_categories(GenRow *pRow, GenRng *pRng, const GeneratorConfig *config, int record_id) {
+    generate_data(pRng, gen_col_text(pRow, 100), 100, DATA_MODE_LOREM, record_id);
+    gen_col_int(pRow, (record_id > 10) ? (record_id % 10) + 1 : 0);
+    generate_data(pRng, gen_col_text(pRow, 256), 256, config->data_mode, record_id);
+    snprintf(gen_col_text(pRow, 255), 255, "https://example.com/images/category_%d.jpg", record_id);
+    gen_col_int(pRow, record_id % 100);
+    gen_col_int(pRow, (record_id % 20 == 0) ? 0 : 1);
+    gen_col_time(pRow, record_id, 0);
+    gen_col_time(pRow, record_id, 3600);
+}
+
+static void fill_activity_logs(GenRow *pRow, GenRng *pRng, const GeneratorConfig *config, int record_id) {
+    static const char *actions[] = {"login", "logout", "create", "update", "delete", "view"};
+    static const char *resources[] = {"user", "product", "order", "category"};
+
+    gen_col_int(pRow, (record_id % 1000) + 1);
+    gen_col_static(pRow, actions[record_id % 6]);
+    gen_col_static(pRow, resources[record_id % 4]);
+    gen_col_int(pRow, record_id);
+    snprintf(gen_col_text(pRow, 45), 45, "192.168.%u.%u", gen_rng_below(pRng, 256), gen_rng_below(pRng, 256));
+    generate_data(pRng, gen_col_text(pRow, 256), 256, DATA_MODE_RANDOM, record_id);
+    generate_data(pRng, gen_col_text(pRow, 512), 512, config->data_mode, record_id);
+    gen_col_time(pRow, record_id, 0);
+}
+
+static void fill_user_sessions(GenRow *pRow, GenRng *pRng, const GeneratorConfig *config, int record_id) {
+    uint64_t id = gen_rng_next(pRng);
+
+    (void)config;
+    snprintf(gen_col_text(pRow, 40), 40, "sess_%08x_%08x", (unsigned)(id >> 32), (unsigned)id);
+    gen_col_int(pRow, (record_id % 1000) + 1);
+    snprintf(gen_col_text(pRow, 45), 45, "10.0.%u.%u", gen_rng_below(pRng, 256), gen_rng_below(pRng, 256));
+    generate_data(pRng, gen_col_text(pRow, 256), 256, DATA_MODE_RANDOM, record_id);
+    gen_col_time(pRow, record_id, 1800);
+    gen_col_time(pRow, record_id, 86400);
+    gen_col_time(pRow, record_id, 0);
+}
+
+static void fill_app_settings(GenRow *pRow, GenRng *pRng, const GeneratorConfig *config, int record_id) {
+    static const char *types[] = {"string", "integer", "boolean", "json"};
+    static const char *categories[] = {"system", "ui", "security", "performance"};
+
+    snprintf(gen_col_text(pRow, 100), 100, "setting_%d", record_id);
+    generate_data(pRng, gen_col_text(pRow, 512), 512, config->data_mode, record_id);
+    gen_col_static(pRow, types[record_id % 4]);
+    gen_col_static(pRow, categories[record_id % 4]);
+    generate_data(pRng, gen_col_text(pRow, 256), 256, DATA_MODE_LOREM, record_id);
+    gen_col_int(pRow, (record_id % 5 == 0) ? 1 : 0);
+    gen_col_time(pRow, record_id, 0);
+    gen_col_time(pRow, record_id, 3600);
+}
+
 // Table definitions with realistic schemas
 typedef struct {
     const char *name;
     const char *schema;
     const char *indexes[5];  // Up to 5 indexes per table
+    const char *insert;      // INSERT statement, %s is the table name
+    void (*xFill)(GenRow *pRow, GenRng *pRng, const GeneratorConfig *config, int record_id);
 } TableDef;
 
 static TableDef table_definitions[] = {
@@ -168,7 +370,10 @@ static TableDef table_definitions[] = {
             "CREATE INDEX IF NOT EXISTS idx_users_status ON users(status)",
             "CREATE INDEX IF NOT EXISTS idx_users_created ON users(created_at)",
             NULL
-        }
+        },
+        "INSERT INTO %s (username, email, password_hash, first_name, last_name, phone, status, profile_data, "
+        "created_at, updated_at) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?)",
+        fill_users
     },
     // Products table
     {
@@ -193,7 +398,10 @@ static TableDef table_definitions[] = {
             "CREATE INDEX IF NOT EXISTS idx_products_price ON products(price)",
             "CREATE INDEX IF NOT EXISTS idx_products_status ON products(status)",
             "CREATE INDEX IF NOT EXISTS idx_products_name ON products(name)"
-        }
+        },
+        "INSERT INTO %s (sku, name, description, category_id, price, stock_quantity, weight, status, metadata, "
+        "created_at, updated_at) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)",
+        fill_products
     },
     // Orders table
     {
@@ -219,7 +427,10 @@ static TableDef table_definitions[] = {
             "CREATE INDEX IF NOT EXISTS idx_orders_status ON orders(status)",
             "CREATE INDEX IF NOT EXISTS idx_orders_created ON orders(created_at)",
             "CREATE INDEX IF NOT EXISTS idx_orders_amount ON orders(total_amount)"
-        }
+        },
+        "INSERT INTO %s (user_id, order_number, status, total_amount, tax_amount, shipping_amount, payment_method, "
+        "shipping_address, billing_address, notes, created_at, updated_at) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)",
+        fill_orders
     },
     // Order items table
     {
@@ -239,7 +450,10 @@ static TableDef table_definitions[] = {
             "CREATE INDEX IF NOT EXISTS idx_order_items_composite ON order_items(order_id, product_id)",
             NULL,
             NULL
-        }
+        },
+        "INSERT INTO %s (order_id, product_id, quantity, unit_price, total_price, created_at) "
+        "VALUES (?, ?, ?, ?, ?, ?)",
+        fill_order_items
     },
     // Categories table
     {
@@ -261,7 +475,10 @@ static TableDef table_definitions[] = {
             "CREATE INDEX IF NOT EXISTS idx_categories_sort ON categories(sort_order)",
             NULL,
             NULL
-        }
+        },
+        "INSERT INTO %s (name, parent_id, description, image_url, sort_order, is_active, created_at, updated_at) "
+        "VALUES (?, ?, ?, ?, ?, ?, ?, ?)",
+        fill_categories
     },
     // Logs table
     {
@@ -283,7 +500,10 @@ static TableDef table_definitions[] = {
             "CREATE INDEX IF NOT EXISTS idx_logs_resource ON activity_logs(resource_type, resource_id)",
             "CREATE INDEX IF NOT EXISTS idx_logs_created ON activity_logs(created_at)",
             NULL
-        }
+        },
+        "INSERT INTO %s (user_id, action, resource_type, resource_id, ip_address, user_agent, details, created_at) "
+        "VALUES (?, ?, ?, ?, ?, ?, ?, ?)",
+        fill_activity_logs
     },
     // Sessions table
     {
@@ -303,7 +523,10 @@ static TableDef table_definitions[] = {
             "CREATE INDEX IF NOT EXISTS idx_sessions_activity ON user_sessions(last_activity)",
             NULL,
             NULL
-        }
+        },
+        "INSERT INTO %s (session_id, user_id, ip_address, user_agent, last_activity, expires_at, created_at) "
+        "VALUES (?, ?, ?, ?, ?, ?, ?)",
+        fill_user_sessions
     },
     // Settings table
     {
@@ -325,535 +548,671 @@ static TableDef table_definitions[] = {
             "CREATE INDEX IF NOT EXISTS idx_settings_public ON app_settings(is_public)",
             NULL,
             NULL
-        }
+        },
+        "INSERT INTO %s (key, value, type, category, description, is_public, created_at, updated_at) "
+        "VALUES (?, ?, ?, ?, ?, ?, ?, ?)",
+        fill_app_settings
     }
 };
 
 static int table_definitions_count = sizeof(table_definitions) / sizeof(table_definitions[0]);
 
-// Create database tables and indexes
-static int create_tables(sqlite3 *db, GeneratorConfig *config) {
+// Full name of a table slot, suffixed when the slots cycle through the definitions
+static void gen_table_name(const GeneratorConfig *config, int slot, char *name, int size) {
+    const char *base = table_definitions[slot % table_definitions_count].name;
+
+    if (config->table_count > table_definitions_count) {
+        snprintf(name, size, "%s_%d", base, slot / table_definitions_count);
+    } else {
+        snprintf(name, size, "%s", base);
+    }
+}
+
+// Create one table slot and its indexes
+static int create_table_slot(sqlite3 *db, const GeneratorConfig *config, int i) {
     char sql[2048];
     int tables_to_create = config->table_count;
+    int table_def_index = i % table_definitions_count;
+    TableDef *table_def = &table_definitions[table_def_index];
     
-    // Limit to available predefined tables, or cycle through them
+    // Create table with suffix if cycling through definitions
     if (tables_to_create > table_definitions_count) {
-        printf("注意: 请求创建 %d 个表，但只有 %d 个预定义表模式，将循环使用\n", 
-               tables_to_create, table_definitions_count);
+        int suffix = i / table_definitions_count;
+        snprintf(sql, sizeof(sql), "%s", table_def->schema);
+        
+        // Replace table name with suffixed version
+        char original_name[100];
+        char new_name[100];
+        snprintf(original_name, sizeof(original_name), "CREATE TABLE IF NOT EXISTS %s", table_def->name);
+        snprintf(new_name, sizeof(new_name), "CREATE TABLE IF NOT EXISTS %s_%d", table_def->name, suffix);
+        
+        char *pos = strstr(sql, original_name);
+        if (pos) {
+            // Replace the table name in the schema
+            char temp_sql[2048];
+            strncpy(temp_sql, sql, pos - sql);
+            temp_sql[pos - sql] = '\0';
+            strcat(temp_sql, new_name);
+            strcat(temp_sql, pos + strlen(original_name));
+            strcpy(sql, temp_sql);
+        }
+    } else {
+        strcpy(sql, table_def->schema);
     }
     
-    printf("创建数据库表和索引...\n");
+    // Create the table
+    int rc = sqlite3_exec(db, sql, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "错误: 创建表失败: %s\n", sqlite3_errmsg(db));
+        return rc;
+    }
     
-    for (int i = 0; i < tables_to_create; i++) {
-        int table_def_index = i % table_definitions_count;
-        TableDef *table_def = &table_definitions[table_def_index];
-        
-        // Create table with suffix if cycling through definitions
+    if (config->verbose) {
+        if (tables_to_create > table_definitions_count) {
+            printf("✓ 创建表 %s_%d\n", table_def->name, i / table_definitions_count);
+        } else {
+            printf("✓ 创建表 %s\n", table_def->name);
+        }
+    }
+    
+    // Create indexes for this table
+    for (int j = 0; j < 5 && table_def->indexes[j] != NULL; j++) {
         if (tables_to_create > table_definitions_count) {
+            // Modify index names for suffixed tables
             int suffix = i / table_definitions_count;
-            snprintf(sql, sizeof(sql), "%s", table_def->schema);
+            strcpy(sql, table_def->indexes[j]);
             
-            // Replace table name with suffixed version
-            char original_name[100];
-            char new_name[100];
-            snprintf(original_name, sizeof(original_name), "CREATE TABLE IF NOT EXISTS %s", table_def->name);
-            snprintf(new_name, sizeof(new_name), "CREATE TABLE IF NOT EXISTS %s_%d", table_def->name, suffix);
+            // Replace table references in index
+            char search_name[100];
+            char replace_name[100];
+            snprintf(search_name, sizeof(search_name), " %s(", table_def->name);
+            snprintf(replace_name, sizeof(replace_name), " %s_%d(", table_def->name, suffix);
+            
+            char *pos = strstr(sql, search_name);
+            if (pos) {
+                char temp_sql[2048];
+                strncpy(temp_sql, sql, pos - sql);
+                temp_sql[pos - sql] = '\0';
+                strcat(temp_sql, replace_name);
+                strcat(temp_sql, pos + strlen(search_name));
+                strcpy(sql, temp_sql);
+            }
             
-            char *pos = strstr(sql, original_name);
+            // Also update index name
+            snprintf(search_name, sizeof(search_name), "idx_%s_", table_def->name);
+            snprintf(replace_name, sizeof(replace_name), "idx_%s_%d_", table_def->name, suffix);
+            pos = strstr(sql, search_name);
             if (pos) {
-                // Replace the table name in the schema
                 char temp_sql[2048];
                 strncpy(temp_sql, sql, pos - sql);
                 temp_sql[pos - sql] = '\0';
-                strcat(temp_sql, new_name);
-                strcat(temp_sql, pos + strlen(original_name));
+                strcat(temp_sql, replace_name);
+                strcat(temp_sql, pos + strlen(search_name));
                 strcpy(sql, temp_sql);
             }
         } else {
-            strcpy(sql, table_def->schema);
+            strcpy(sql, table_def->indexes[j]);
         }
         
-        // Create the table
-        int rc = sqlite3_exec(db, sql, NULL, NULL, NULL);
+        rc = sqlite3_exec(db, sql, NULL, NULL, NULL);
         if (rc != SQLITE_OK) {
-            fprintf(stderr, "错误: 创建表失败: %s\n", sqlite3_errmsg(db));
+            fprintf(stderr, "错误: 创建索引失败: %s\n", sqlite3_errmsg(db));
             return rc;
         }
         
         if (config->verbose) {
-            if (tables_to_create > table_definitions_count) {
-                printf("✓ 创建表 %s_%d\n", table_def->name, i / table_definitions_count);
-            } else {
-                printf("✓ 创建表 %s\n", table_def->name);
-            }
-        }
-        
-        // Create indexes for this table
-        for (int j = 0; j < 5 && table_def->indexes[j] != NULL; j++) {
-            if (tables_to_create > table_definitions_count) {
-                // Modify index names for suffixed tables
-                int suffix = i / table_definitions_count;
-                strcpy(sql, table_def->indexes[j]);
-                
-                // Replace table references in index
-                char search_name[100];
-                char replace_name[100];
-                snprintf(search_name, sizeof(search_name), " %s(", table_def->name);
-                snprintf(replace_name, sizeof(replace_name), " %s_%d(", table_def->name, suffix);
-                
-                char *pos = strstr(sql, search_name);
-                if (pos) {
-                    char temp_sql[2048];
-                    strncpy(temp_sql, sql, pos - sql);
-                    temp_sql[pos - sql] = '\0';
-                    strcat(temp_sql, replace_name);
-                    strcat(temp_sql, pos + strlen(search_name));
-                    strcpy(sql, temp_sql);
-                }
-                
-                // Also update index name
-                snprintf(search_name, sizeof(search_name), "idx_%s_", table_def->name);
-                snprintf(replace_name, sizeof(replace_name), "idx_%s_%d_", table_def->name, suffix);
-                pos = strstr(sql, search_name);
-                if (pos) {
-                    char temp_sql[2048];
-                    strncpy(temp_sql, sql, pos - sql);
-                    temp_sql[pos - sql] = '\0';
-                    strcat(temp_sql, replace_name);
-                    strcat(temp_sql, pos + strlen(search_name));
-                    strcpy(sql, temp_sql);
-                }
-            } else {
-                strcpy(sql, table_def->indexes[j]);
-            }
-            
-            rc = sqlite3_exec(db, sql, NULL, NULL, NULL);
-            if (rc != SQLITE_OK) {
-                fprintf(stderr, "错误: 创建索引失败: %s\n", sqlite3_errmsg(db));
-                return rc;
-            }
-            
-            if (config->verbose) {
-                printf("  ✓ 创建索引 %d\n", j + 1);
-            }
+            printf("  ✓ 创建索引 %d\n", j + 1);
         }
     }
-    
-    printf("✅ 完成创建 %d 个表和相应索引\n\n", tables_to_create);
     return SQLITE_OK;
 }
 
-// Generate realistic data for specific table types
-static int generate_table_data(sqlite3 *db, const char *table_name, int table_suffix, 
-                              GeneratorConfig *config, int record_id) {
-    char sql[2048];
-    sqlite3_stmt *stmt = NULL;
-    int rc;
+// Create database tables and indexes
+static int create_tables(sqlite3 *db, const GeneratorConfig *config) {
+    int tables_to_create = config->table_count;
     
-    // Generate table name with suffix if needed
-    char full_table_name[100];
-    if (table_suffix >= 0) {
-        snprintf(full_table_name, sizeof(full_table_name), "%s_%d", table_name, table_suffix);
-    } else {
-        strcpy(full_table_name, table_name);
+    // Limit to available predefined tables, or cycle through them
+    if (tables_to_create > table_definitions_count) {
+        printf("注意: 请求创建 %d 个表，但只有 %d 个预定义表模式，将循环使用\n", 
+               tables_to_create, table_definitions_count);
     }
     
-    if (strcmp(table_name, "users") == 0) {
-        // Users table data
-        snprintf(sql, sizeof(sql),
-            "INSERT INTO %s (username, email, password_hash, first_name, last_name, phone, status, profile_data) "
-            "VALUES (?, ?, ?, ?, ?, ?, ?, ?)", full_table_name);
-            
-        rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
-        if (rc != SQLITE_OK) return rc;
-        
-        char username[50], email[100], password_hash[255], first_name[50], last_name[50];
-        char phone[20], status[20], profile_data[512];
-        
-        snprintf(username, sizeof(username), "user_%d", record_id);
-        snprintf(email, sizeof(email), "user_%d@example.com", record_id);
-        snprintf(password_hash, sizeof(password_hash), "hash_%08x", rand());
-        generate_data(first_name, sizeof(first_name), DATA_MODE_LOREM, record_id);
-        generate_data(last_name, sizeof(last_name), DATA_MODE_LOREM, record_id + 1);
-        snprintf(phone, sizeof(phone), "+1%03d%03d%04d", rand() % 900 + 100, rand() % 900 + 100, rand() % 10000);
-        strcpy(status, (record_id % 10 == 0) ? "inactive" : "active");
-        snprintf(profile_data, sizeof(profile_data), "{\"preferences\":{\"theme\":\"dark\",\"notifications\":%s}}", 
-                 (record_id % 3 == 0) ? "true" : "false");
-        
-        sqlite3_bind_text(stmt, 1, username, -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 2, email, -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 3, password_hash, -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 4, first_name, -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 5, last_name, -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 6, phone, -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 7, status, -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 8, profile_data, -1, SQLITE_STATIC);
-        
-    } else if (strcmp(table_name, "products") == 0) {
-        // Products table data
-        snprintf(sql, sizeof(sql),
-            "INSERT INTO %s (sku, name, description, category_id, price, stock_quantity, weight, status, metadata) "
-            "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?)", full_table_name);
-            
-        rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
-        if (rc != SQLITE_OK) return rc;
-        
-        char sku[50], name[200], description[512], status[20], metadata[512];
-        
-        snprintf(sku, sizeof(sku), "SKU-%08d", record_id);
-        generate_data(name, sizeof(name), DATA_MODE_LOREM, record_id);
-        generate_data(description, sizeof(description), config->data_mode, record_id);
-        strcpy(status, (record_id % 20 == 0) ? "discontinued" : "active");
-        snprintf(metadata, sizeof(metadata), "{\"brand\":\"Brand_%d\",\"weight_unit\":\"kg\"}", record_id % 50);
-        
-        sqlite3_bind_text(stmt, 1, sku, -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 2, name, -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 3, description, -1, SQLITE_STATIC);
-        sqlite3_bind_int(stmt, 4, (record_id % 10) + 1);
-        sqlite3_bind_double(stmt, 5, (double)(rand() % 10000) / 100.0);
-        sqlite3_bind_int(stmt, 6, rand() % 1000);
-        sqlite3_bind_double(stmt, 7, (double)(rand() % 5000) / 1000.0);
-        sqlite3_bind_text(stmt, 8, status, -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 9, metadata, -1, SQLITE_STATIC);
-        
-    } else if (strcmp(table_name, "orders") == 0) {
-        // Orders table data
-        snprintf(sql, sizeof(sql),
-            "INSERT INTO %s (user_id, order_number, status, total_amount, tax_amount, shipping_amount, payment_method, shipping_address, billing_address, notes) "
-            "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?)", full_table_name);
-            
-        rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
-        if (rc != SQLITE_OK) return rc;
-        
-        char order_number[50], status[20], payment_method[50], shipping_address[256], billing_address[256], notes[512];
-        const char *statuses[] = {"pending", "processing", "shipped", "delivered", "cancelled"};
-        const char *payment_methods[] = {"credit_card", "paypal", "bank_transfer", "cash"};
-        
-        snprintf(order_number, sizeof(order_number), "ORD-%08d", record_id);
-        strcpy(status, statuses[record_id % 5]);
-        strcpy(payment_method, payment_methods[record_id % 4]);
-        generate_data(shipping_address, sizeof(shipping_address), DATA_MODE_LOREM, record_id);
-        generate_data(billing_address, sizeof(billing_address), DATA_MODE_LOREM, record_id + 1);
-        generate_data(notes, sizeof(notes), config->data_mode, record_id);
-        
-        sqlite3_bind_int(stmt, 1, (record_id % 1000) + 1);
-        sqlite3_bind_text(stmt, 2, order_number, -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 3, status, -1, SQLITE_STATIC);
-        sqlite3_bind_double(stmt, 4, (double)(rand() % 100000) / 100.0);
-        sqlite3_bind_double(stmt, 5, (double)(rand() % 1000) / 100.0);
-        sqlite3_bind_double(stmt, 6, (double)(rand() % 5000) / 100.0);
-        sqlite3_bind_text(stmt, 7, payment_method, -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 8, shipping_address, -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 9, billing_address, -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 10, notes, -1, SQLITE_STATIC);
-        
-    } else if (strcmp(table_name, "order_items") == 0) {
-        // Order items table data
-        snprintf(sql, sizeof(sql),
-            "INSERT INTO %s (order_id, product_id, quantity, unit_price, total_price) "
-            "VALUES (?, ?, ?, ?, ?)", full_table_name);
-            
-        rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
-        if (rc != SQLITE_OK) return rc;
-        
-        int quantity = (rand() % 10) + 1;
-        double unit_price = (double)(rand() % 10000) / 100.0;
-        
-        sqlite3_bind_int(stmt, 1, (record_id % 500) + 1);
-        sqlite3_bind_int(stmt, 2, (record_id % 1000) + 1);
-        sqlite3_bind_int(stmt, 3, quantity);
-        sqlite3_bind_double(stmt, 4, unit_price);
-        sqlite3_bind_double(stmt, 5, unit_price * quantity);
-        
-    } else if (strcmp(table_name, "categories") == 0) {
-        // Categories table data
-        snprintf(sql, sizeof(sql),
-            "INSERT INTO %s (name, parent_id, description, image_url, sort_order, is_active) "
-            "VALUES (?, ?, ?, ?, ?, ?)", full_table_name);
-            
-        rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
-        if (rc != SQLITE_OK) return rc;
-        
-        char name[100], description[256], image_url[255];
-        
-        generate_data(name, sizeof(name), DATA_MODE_LOREM, record_id);
-        generate_data(description, sizeof(description), config->data_mode, record_id);
-        snprintf(image_url, sizeof(image_url), "https://example.com/images/category_%d.jpg", record_id);
-        
-        sqlite3_bind_text(stmt, 1, name, -1, SQLITE_STATIC);
-        sqlite3_bind_int(stmt, 2, (record_id > 10) ? (record_id % 10) + 1 : 0);
-        sqlite3_bind_text(stmt, 3, description, -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 4, image_url, -1, SQLITE_STATIC);
-        sqlite3_bind_int(stmt, 5, record_id % 100);
-        sqlite3_bind_int(stmt, 6, (record_id % 20 == 0) ? 0 : 1);
-        
-    } else if (strcmp(table_name, "activity_logs") == 0) {
-        // Activity logs table data
-        snprintf(sql, sizeof(sql),
-            "INSERT INTO %s (user_id, action, resource_type, resource_id, ip_address, user_agent, details) "
-            "VALUES (?, ?, ?, ?, ?, ?, ?)", full_table_name);
-            
-        rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
-        if (rc != SQLITE_OK) return rc;
-        
-        char action[50], resource_type[50], ip_address[45], user_agent[256], details[512];
-        const char *actions[] = {"login", "logout", "create", "update", "delete", "view"};
-        const char *resources[] = {"user", "product", "order", "category"};
-        
-        strcpy(action, actions[record_id % 6]);
-        strcpy(resource_type, resources[record_id % 4]);
-        snprintf(ip_address, sizeof(ip_address), "192.168.%d.%d", rand() % 256, rand() % 256);
-        generate_data(user_agent, sizeof(user_agent), DATA_MODE_RANDOM, record_id);
-        generate_data(details, sizeof(details), config->data_mode, record_id);
-        
-        sqlite3_bind_int(stmt, 1, (record_id % 1000) + 1);
-        sqlite3_bind_text(stmt, 2, action, -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 3, resource_type, -1, SQLITE_STATIC);
-        sqlite3_bind_int(stmt, 4, record_id);
-        sqlite3_bind_text(stmt, 5, ip_address, -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 6, user_agent, -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 7, details, -1, SQLITE_STATIC);
-        
-    } else if (strcmp(table_name, "user_sessions") == 0) {
-        // User sessions table data
-        snprintf(sql, sizeof(sql),
-            "INSERT INTO %s (session_id, user_id, ip_address, user_agent, expires_at) "
-            "VALUES (?, ?, ?, ?, datetime('now', '+1 day'))", full_table_name);
-            
-        rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
-        if (rc != SQLITE_OK) return rc;
-        
-        char session_id[255], ip_address[45], user_agent[256];
-        
-        snprintf(session_id, sizeof(session_id), "sess_%08x_%08x", rand(), rand());
-        snprintf(ip_address, sizeof(ip_address), "10.0.%d.%d", rand() % 256, rand() % 256);
-        generate_data(user_agent, sizeof(user_agent), DATA_MODE_RANDOM, record_id);
-        
-        sqlite3_bind_text(stmt, 1, session_id, -1, SQLITE_STATIC);
-        sqlite3_bind_int(stmt, 2, (record_id % 1000) + 1);
-        sqlite3_bind_text(stmt, 3, ip_address, -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 4, user_agent, -1, SQLITE_STATIC);
-        
-    } else if (strcmp(table_name, "app_settings") == 0) {
-        // App settings table data
-        snprintf(sql, sizeof(sql),
-            "INSERT INTO %s (key, value, type, category, description, is_public) "
-            "VALUES (?, ?, ?, ?, ?, ?)", full_table_name);
-            
-        rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
+    printf("创建数据库表和索引...\n");
+    
+    for (int i = 0; i < tables_to_create; i++) {
+        int rc = create_table_slot(db, config, i);
         if (rc != SQLITE_OK) return rc;
-        
-        char key[100], value[512], type[20], category[50], description[256];
-        const char *types[] = {"string", "integer", "boolean", "json"};
-        const char *categories[] = {"system", "ui", "security", "performance"};
-        
-        snprintf(key, sizeof(key), "setting_%d", record_id);
-        generate_data(value, sizeof(value), config->data_mode, record_id);
-        strcpy(type, types[record_id % 4]);
-        strcpy(category, categories[record_id % 4]);
-        generate_data(description, sizeof(description), DATA_MODE_LOREM, record_id);
-        
-        sqlite3_bind_text(stmt, 1, key, -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 2, value, -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 3, type, -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 4, category, -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 5, description, -1, SQLITE_STATIC);
-        sqlite3_bind_int(stmt, 6, (record_id % 5 == 0) ? 1 : 0);
     }
     
-    if (stmt) {
-        rc = sqlite3_step(stmt);
-        sqlite3_finalize(stmt);
-        return (rc == SQLITE_DONE) ? SQLITE_OK : rc;
+    printf("✅ 完成创建 %d 个表和相应索引\n\n", tables_to_create);
+    return SQLITE_OK;
+}
+
+// Build one row of a table slot; the PRNG stream is keyed by slot and record only
+static void gen_fill_row(const GeneratorConfig *config, int slot, int record_id, GenRow *pRow) {
+    GenRng rng;
+
+    gen_rng_seed(&rng, config->seed, ((uint64_t)(uint32_t)slot << 32) | (uint32_t)record_id);
+    pRow->table = slot;
+    pRow->nCol = 0;
+    pRow->nText = 0;
+    table_definitions[slot % table_definitions_count].xFill(pRow, &rng, config, record_id);
+}
+
+// Prepare the INSERT statement of a table slot
+static int gen_prepare_insert(sqlite3 *db, const GeneratorConfig *config, int slot, sqlite3_stmt **ppStmt) {
+    char name[100];
+    char sql[512];
+
+    gen_table_name(config, slot, name, sizeof(name));
+    snprintf(sql, sizeof(sql), table_definitions[slot % table_definitions_count].insert, name);
+    return sqlite3_prepare_v2(db, sql, -1, ppStmt, NULL);
+}
+
+// Bind a generated row and run the prepared INSERT
+static int gen_insert_row(sqlite3_stmt *pStmt, const GenRow *pRow) {
+    int rc;
+
+    for (int i = 0; i < pRow->nCol; i++) {
+        const GenValue *pVal = &pRow->aCol[i];
+        switch (pVal->type) {
+            case SQLITE_INTEGER: sqlite3_bind_int64(pStmt, i + 1, pVal->i); break;
+            case SQLITE_FLOAT:   sqlite3_bind_double(pStmt, i + 1, pVal->r); break;
+            default:             sqlite3_bind_text(pStmt, i + 1, pVal->z, -1, SQLITE_STATIC); break;
+        }
     }
-    
-    return SQLITE_ERROR;
+    rc = sqlite3_step(pStmt);
+    sqlite3_reset(pStmt);
+    return (rc == SQLITE_DONE) ? SQLITE_OK : rc;
+}
+
+// 生成队列：工作线程按批号填充预分配的行，唯一的写入线程按批号顺序取用
+// Generation queue: workers fill preallocated rows batch by batch, the single writer takes batches in order
+typedef struct {
+    int batch;                  // Batch number held, -1 when the slot is free
+    int ready;
+    GenRow *aRow;               // GEN_BATCH_ROWS rows
+} GenBatch;
+
+typedef struct {
+    const GeneratorConfig *config;
+    int only_table;             // Table slot of every row, -1 to cycle through all slots
+    int nWorker;                // 0: the writer generates inline
+    GenBatch *aSlot;
+    int nSlot;
+    int next_claim;             // Next batch a worker generates
+    int next_write;             // Next batch the writer inserts
+    int stop;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} GenQueue;
+
+// Rows of batch k are records k*GEN_BATCH_ROWS.. in order, so contents never depend on who built them
+static void gen_fill_batch(GenQueue *pQueue, GenBatch *pBatch, int k) {
+    const GeneratorConfig *config = pQueue->config;
+
+    for (int i = 0; i < GEN_BATCH_ROWS; i++) {
+        int record_id = k * GEN_BATCH_ROWS + i;
+        int slot = pQueue->only_table >= 0 ? pQueue->only_table : record_id % config->table_count;
+        gen_fill_row(config, slot, record_id, &pBatch->aRow[i]);
+    }
+}
+
+static void *gen_worker(void *pArg) {
+    GenQueue *pQueue = (GenQueue*)pArg;
+
+    pthread_mutex_lock(&pQueue->mutex);
+    for (;;) {
+        while (!pQueue->stop && pQueue->next_claim >= pQueue->next_write + pQueue->nSlot) {
+            pthread_cond_wait(&pQueue->cond, &pQueue->mutex);
+        }
+        if (pQueue->stop) break;
+
+        int k = pQueue->next_claim++;
+        GenBatch *pBatch = &pQueue->aSlot[k % pQueue->nSlot];
+        pBatch->batch = k;
+        pthread_mutex_unlock(&pQueue->mutex);
+
+        gen_fill_batch(pQueue, pBatch, k);
+
+        pthread_mutex_lock(&pQueue->mutex);
+        pBatch->ready = 1;
+        pthread_cond_broadcast(&pQueue->cond);
+    }
+    pthread_mutex_unlock(&pQueue->mutex);
+    return NULL;
+}
+
+// Wait for the next batch in order, or build it when there are no workers
+static GenBatch *gen_next_batch(GenQueue *pQueue) {
+    GenBatch *pBatch = &pQueue->aSlot[pQueue->next_write % pQueue->nSlot];
+
+    if (pQueue->nWorker == 0) {
+        gen_fill_batch(pQueue, pBatch, pQueue->next_write);
+        return pBatch;
+    }
+    pthread_mutex_lock(&pQueue->mutex);
+    while (!(pBatch->ready && pBatch->batch == pQueue->next_write)) {
+        pthread_cond_wait(&pQueue->cond, &pQueue->mutex);
+    }
+    pthread_mutex_unlock(&pQueue->mutex);
+    return pBatch;
+}
+
+static void gen_release_batch(GenQueue *pQueue, GenBatch *pBatch) {
+    pthread_mutex_lock(&pQueue->mutex);
+    pBatch->ready = 0;
+    pBatch->batch = -1;
+    pQueue->next_write++;
+    pthread_cond_broadcast(&pQueue->cond);
+    pthread_mutex_unlock(&pQueue->mutex);
+}
+
+static void gen_queue_free(GenQueue *pQueue) {
+    if (pQueue->aSlot) {
+        for (int i = 0; i < pQueue->nSlot; i++) free(pQueue->aSlot[i].aRow);
+        free(pQueue->aSlot);
+    }
+    pthread_cond_destroy(&pQueue->cond);
+    pthread_mutex_destroy(&pQueue->mutex);
 }
 
+// Two batches in flight per worker keep the writer fed without unbounded memory
+static int gen_queue_init(GenQueue *pQueue, const GeneratorConfig *config, int only_table, int nWorker) {
+    memset(pQueue, 0, sizeof(*pQueue));
+    pQueue->config = config;
+    pQueue->only_table = only_table;
+    pQueue->nWorker = nWorker;
+    pQueue->nSlot = nWorker > 0 ? nWorker * 2 : 1;
+    pthread_mutex_init(&pQueue->mutex, NULL);
+    pthread_cond_init(&pQueue->cond, NULL);
+
+    pQueue->aSlot = (GenBatch*)calloc(pQueue->nSlot, sizeof(GenBatch));
+    if (!pQueue->aSlot) return SQLITE_NOMEM;
+    for (int i = 0; i < pQueue->nSlot; i++) {
+        pQueue->aSlot[i].batch = -1;
+        pQueue->aSlot[i].aRow = (GenRow*)malloc(sizeof(GenRow) * GEN_BATCH_ROWS);
+        if (!pQueue->aSlot[i].aRow) return SQLITE_NOMEM;
+    }
+    return SQLITE_OK;
+}
+
+// 一个输出数据库的生成任务
+// Generation job for one output database
+typedef struct {
+    const GeneratorConfig *config;
+    const char *vfs;            // NULL for a plain database
+    char path[1024];
+    int only_table;             // Table slot of a split database, -1 for all tables
+    double target_size;
+    int nWorker;
+    int quiet;                  // No progress line, jobs run side by side
+    int records;                // Rows inserted
+    int rc;
+} GenJob;
+
 // Generate database content with realistic data - optimized version
-static int generate_database_content(sqlite3 *db, GeneratorConfig *config) {
+static int generate_database_content(sqlite3 *db, GenJob *pJob, GenQueue *pQueue, sqlite3_stmt **aStmt) {
+    const GeneratorConfig *config = pJob->config;
+    const char *path = pJob->path;
+    double target_size = pJob->target_size;
     int record_id = 0;
     long current_size = 0;
     time_t start_time = time(NULL);
     int records_inserted = 0;
+    int rc = SQLITE_OK;
     
-    // Use smaller batch size for better size control
-    int effective_batch_size = 100;  // Use small batch size for precise control
+    // 每批恰好一个事务，大小只在批边界检查，相同种子停在相同的记录
+    // One transaction per batch and size checks only at batch ends, so a seed stops at the same record
+    int effective_batch_size = GEN_BATCH_ROWS;
     
     // Start transaction
     sqlite3_exec(db, "BEGIN TRANSACTION", NULL, NULL, NULL);
     
-    printf("开始生成数据库内容...\n");
-    printf("目标大小: %.0f 字节 (%.2f MB)\n", config->target_size, config->target_size / (1024.0 * 1024.0));
-    printf("数据模式: ");
-    switch (config->data_mode) {
-        case DATA_MODE_RANDOM: printf("随机数据\n"); break;
-        case DATA_MODE_SEQUENTIAL: printf("顺序数据\n"); break;
-        case DATA_MODE_LOREM: printf("Lorem ipsum\n"); break;
-        case DATA_MODE_BINARY: printf("二进制数据\n"); break;
-        case DATA_MODE_MIXED: printf("混合数据\n"); break;
+    if (!pJob->quiet) {
+        printf("开始生成数据库内容...\n");
+        printf("目标大小: %.0f 字节 (%.2f MB)\n", target_size, target_size / (1024.0 * 1024.0));
+        printf("数据模式: ");
+        switch (config->data_mode) {
+            case DATA_MODE_RANDOM: printf("随机数据\n"); break;
+            case DATA_MODE_SEQUENTIAL: printf("顺序数据\n"); break;
+            case DATA_MODE_LOREM: printf("Lorem ipsum\n"); break;
+            case DATA_MODE_BINARY: printf("二进制数据\n"); break;
+            case DATA_MODE_MIXED: printf("混合数据\n"); break;
+        }
+        printf("表数量: %d\n", config->table_count);
+        printf("批量大小: %d\n", effective_batch_size);
+        printf("生成线程: %d\n", pQueue->nWorker);
+        printf("\n");
     }
-    printf("表数量: %d\n", config->table_count);
-    printf("批量大小: %d\n", effective_batch_size);
-    printf("\n");
     
     
     // Progress tracking variables for DELETE journal mode
-    static double estimated_bytes_per_record = 0;
-    static double calibration_factor = 1.0;
-    static int last_calibration_records = 0;
-    static int calibration_count = 0;
-    static double running_average_bytes_per_record = 0;
+    double estimated_bytes_per_record = 0;
+    double calibration_factor = 1.0;
+    int last_calibration_records = 0;
+    int calibration_count = 0;
+    double running_average_bytes_per_record = 0;
     
-    while (current_size < (long)config->target_size) {
-        int table_index = record_id % config->table_count;
-        int table_def_index = table_index % table_definitions_count;
-        const char *table_name = table_definitions[table_def_index].name;
+    while (current_size < (long)target_size) {
+        GenBatch *pBatch = gen_next_batch(pQueue);
         
-        int table_suffix = -1;
-        if (config->table_count > table_definitions_count) {
-            table_suffix = table_index / table_definitions_count;
+        for (int i = 0; rc == SQLITE_OK && i < GEN_BATCH_ROWS; i++) {
+            const GenRow *pRow = &pBatch->aRow[i];
+            rc = gen_insert_row(aStmt[pRow->table], pRow);
         }
-        
-        int rc = generate_table_data(db, table_name, table_suffix, config, record_id);
+        gen_release_batch(pQueue, pBatch);
         if (rc != SQLITE_OK) {
             fprintf(stderr, "错误: 插入数据失败: %s\n", sqlite3_errmsg(db));
             break;
         }
         
-        record_id++;
-        records_inserted++;
+        record_id += GEN_BATCH_ROWS;
+        records_inserted += GEN_BATCH_ROWS;
         
         // Commit transaction periodically and check file size
-        if (record_id % effective_batch_size == 0) {
-            sqlite3_exec(db, "COMMIT", NULL, NULL, NULL);
+        sqlite3_exec(db, "COMMIT", NULL, NULL, NULL);
+        
+        // Force flush to disk before checking size
+        if (config->use_wal_mode) {
+            sqlite3_exec(db, "PRAGMA wal_checkpoint(FULL)", NULL, NULL, NULL);
+        }
+        
+        // Check file size after commit
+        current_size = get_file_size(path);
+        
+        // Debug output
+        if (config->verbose && !pJob->quiet && record_id % (effective_batch_size * 10) == 0) {
+            printf("\n[DEBUG] 记录数: %d, 文件大小: %ld 字节, 目标: %.0f 字节\n", 
+                   records_inserted, current_size, target_size);
+        }
+        
+        // Show progress
+        time_t current_time = time(NULL);
+        double elapsed = difftime(current_time, start_time);
+        double progress;
+        
+        // In non-WAL mode, file size might be 0 during transactions (DELETE journal mode)
+        // Use record-based estimation if file size is 0 after inserting records
+        if (current_size == 0 && records_inserted > 100) {
+            // In DELETE journal mode, use improved calibration system
+            // More frequent calibration for better accuracy
+            if (records_inserted >= 500 && (last_calibration_records == 0 || (records_inserted - last_calibration_records) >= 500)) {
+                // Force a commit to get actual file size for calibration
+                sqlite3_exec(db, "COMMIT", NULL, NULL, NULL);
+                long calibration_size = get_file_size(path);
+                if (calibration_size > 0) {
+                    double actual_bytes_per_record = (double)calibration_size / records_inserted;
+                    calibration_count++;
+                    
+                    // Use running average for stability
+                    if (running_average_bytes_per_record == 0) {
+                        running_average_bytes_per_record = actual_bytes_per_record;
+                    } else {
+                        // Weighted average (give more weight to recent measurements)
+                        running_average_bytes_per_record = running_average_bytes_per_record * 0.7 + actual_bytes_per_record * 0.3;
+                    }
+                    
+                    if (estimated_bytes_per_record > 0) {
+                        // Conservative calibration factor update
+                        double new_factor = running_average_bytes_per_record / estimated_bytes_per_record;
+                        calibration_factor = calibration_factor * 0.8 + new_factor * 0.2; // Smooth transition
+                        if (!pJob->quiet) {
+                            printf("\n[校准 #%d] 实际: %.1f 字节/记录, 平均: %.1f, 校准因子: %.3f\n", 
+                                   calibration_count, actual_bytes_per_record, running_average_bytes_per_record, calibration_factor);
+                        }
+                    } else {
+                        calibration_factor = 1.0;
+                    }
+                    
+                    estimated_bytes_per_record = running_average_bytes_per_record;
+                    last_calibration_records = records_inserted;
+                }
+            }
             
-            // Force flush to disk before checking size
-            if (config->use_wal_mode) {
-                sqlite3_exec(db, "PRAGMA wal_checkpoint(FULL)", NULL, NULL, NULL);
-            } /*else {
-                // In DELETE mode, force a sync to ensure data is written to disk
-                sqlite3_exec(db, "PRAGMA synchronous=NORMAL", NULL, NULL, NULL);
-                sqlite3_exec(db, "PRAGMA synchronous=OFF", NULL, NULL, NULL);
-            }*/
+            if (estimated_bytes_per_record == 0) {
+                // Very conservative initial estimate
+                estimated_bytes_per_record = config->record_size * 0.6; // Even more conservative
+            }
             
-            // Check file size after commit
-            current_size = get_file_size(config->output_file);
+            // Apply calibration factor to estimation with safety cap
+            double base_estimate = records_inserted * estimated_bytes_per_record;
+            double calibrated_estimated_size = base_estimate * calibration_factor;
             
-            // Debug output
-            if (config->verbose && record_id % (effective_batch_size * 10) == 0) {
-                printf("\n[DEBUG] 记录数: %d, 文件大小: %ld 字节, 目标: %.0f 字节\n", 
-                       records_inserted, current_size, config->target_size);
+            // Safety cap: don't let calibration factor push us too far
+            if (calibration_factor > 2.0) {
+                calibrated_estimated_size = base_estimate * 2.0;
             }
             
-            // Show progress
-            time_t current_time = time(NULL);
-            double elapsed = difftime(current_time, start_time);
-            double progress;
+            progress = calibrated_estimated_size / target_size * 100.0;
             
-            // In non-WAL mode, file size might be 0 during transactions (DELETE journal mode)
-            // Use record-based estimation if file size is 0 after inserting records
-            if (current_size == 0 && records_inserted > 100) {
-                // In DELETE journal mode, use improved calibration system
-                // More frequent calibration for better accuracy
-                if (records_inserted >= 500 && (last_calibration_records == 0 || (records_inserted - last_calibration_records) >= 500)) {
-                    // Force a commit to get actual file size for calibration
-                    sqlite3_exec(db, "COMMIT", NULL, NULL, NULL);
-                    long calibration_size = get_file_size(config->output_file);
-                    if (calibration_size > 0) {
-                        double actual_bytes_per_record = (double)calibration_size / records_inserted;
-                        calibration_count++;
-                        
-                        // Use running average for stability
-                        if (running_average_bytes_per_record == 0) {
-                            running_average_bytes_per_record = actual_bytes_per_record;
-                        } else {
-                            // Weighted average (give more weight to recent measurements)
-                            running_average_bytes_per_record = running_average_bytes_per_record * 0.7 + actual_bytes_per_record * 0.3;
-                        }
-                        
-                        if (estimated_bytes_per_record > 0) {
-                            // Conservative calibration factor update
-                            double new_factor = running_average_bytes_per_record / estimated_bytes_per_record;
-                            calibration_factor = calibration_factor * 0.8 + new_factor * 0.2; // Smooth transition
-                            printf("\n[校准 #%d] 实际: %.1f 字节/记录, 平均: %.1f, 校准因子: %.3f\n", 
-                                   calibration_count, actual_bytes_per_record, running_average_bytes_per_record, calibration_factor);
-                        } else {
-                            calibration_factor = 1.0;
-                        }
-                        
-                        estimated_bytes_per_record = running_average_bytes_per_record;
-                        last_calibration_records = records_inserted;
-                    }
-                    // Restart transaction
-                    sqlite3_exec(db, "BEGIN TRANSACTION", NULL, NULL, NULL);
-                }
-                
-                if (estimated_bytes_per_record == 0) {
-                    // Very conservative initial estimate
-                    estimated_bytes_per_record = config->record_size * 0.6; // Even more conservative
-                }
-                
-                // Apply calibration factor to estimation with safety cap
-                double base_estimate = records_inserted * estimated_bytes_per_record;
-                double calibrated_estimated_size = base_estimate * calibration_factor;
-                
-                // Safety cap: don't let calibration factor push us too far
-                if (calibration_factor > 2.0) {
-                    calibrated_estimated_size = base_estimate * 2.0;
-                }
-                
-                progress = calibrated_estimated_size / config->target_size * 100.0;
-                
+            if (!pJob->quiet) {
                 printf("\r进度: %.1f%% (估算: %d 记录, ~%.1f MB) - %.1f 记录/秒 [%s]",
                        progress, records_inserted, calibrated_estimated_size / (1024*1024),
                        records_inserted / (elapsed > 0 ? elapsed : 1),
                        (calibration_count > 0) ? "智能校准" : "保守估算");
-            } else {
-                // Use file size based progress (WAL mode or final result)
-                progress = (current_size > 0) ? (double)current_size / config->target_size * 100.0 : 0.0;
-                
+            }
+        } else {
+            // Use file size based progress (WAL mode or final result)
+            progress = (current_size > 0) ? (double)current_size / target_size * 100.0 : 0.0;
+            
+            if (!pJob->quiet) {
                 printf("\r进度: %.1f%% (%.2f MB/%.2f MB) - %d 记录 - %.1f 记录/秒",
-                       progress, current_size / (1024.0*1024.0), config->target_size / (1024.0*1024.0), records_inserted,
+                       progress, current_size / (1024.0*1024.0), target_size / (1024.0*1024.0), records_inserted,
                        records_inserted / (elapsed > 0 ? elapsed : 1));
             }
-            fflush(stdout);
-            
-            // Check if we've reached the target size - break before starting new transaction
-            if (current_size >= (long)config->target_size) {
-                printf("\n目标大小已达到，停止生成数据\n");
-                break;
+        }
+        if (!pJob->quiet) fflush(stdout);
+        
+        // Check if we've reached the target size - break before starting new transaction
+        if (current_size >= (long)target_size) {
+            if (!pJob->quiet) printf("\n目标大小已达到，停止生成数据\n");
+            break;
+        }
+        
+        // In estimation mode (DELETE journal), use smart threshold based on calibration quality
+        if (current_size == 0 && records_inserted > 100) {
+            // Use adaptive threshold based on calibration confidence
+            double threshold;
+            if (calibration_count >= 3) {
+                threshold = 95.0; // High confidence - stop at 95%
+            } else if (calibration_count >= 1) {
+                threshold = 90.0; // Some calibration - stop at 90%
+            } else {
+                threshold = 85.0; // No calibration - very conservative 85%
             }
             
-            // In estimation mode (DELETE journal), use smart threshold based on calibration quality
-            if (current_size == 0 && records_inserted > 100) {
-                // Use adaptive threshold based on calibration confidence
-                double threshold;
-                if (calibration_count >= 3) {
-                    threshold = 95.0; // High confidence - stop at 95%
-                } else if (calibration_count >= 1) {
-                    threshold = 90.0; // Some calibration - stop at 90%
-                } else {
-                    threshold = 85.0; // No calibration - very conservative 85%
-                }
-                
-                if (progress >= threshold) {
+            if (progress >= threshold) {
+                if (!pJob->quiet) {
                     printf("\n基于智能估算已达到目标 (阈值: %.1f%%, 校准次数: %d)，停止生成数据\n", threshold, calibration_count);
-                    break;
                 }
+                break;
             }
-            
-            // Start new transaction
-            sqlite3_exec(db, "BEGIN TRANSACTION", NULL, NULL, NULL);
         }
+        
+        // Start new transaction
+        sqlite3_exec(db, "BEGIN TRANSACTION", NULL, NULL, NULL);
     }
     
     // Final commit
     sqlite3_exec(db, "COMMIT", NULL, NULL, NULL);
-    printf("\n");
+    pJob->records = records_inserted;
+    if (!pJob->quiet) {
+        printf("\n");
+        printf("✓ 数据生成完成: %d 记录插入到 %d 个表中\n", records_inserted, config->table_count);
+    }
+    return rc;
+}
+
+// Open, fill and close the database of one job, with its own generation workers
+static int gen_run_job(GenJob *pJob) {
+    const GeneratorConfig *config = pJob->config;
+    sqlite3 *db = NULL;
+    sqlite3_stmt **aStmt = NULL;
+    pthread_t *aThread = NULL;
+    GenQueue queue;
+    int nStarted = 0;
+    int rc;
+
+    // Remove existing file
+    remove(pJob->path);
+
+    rc = sqlite3_open_v2(pJob->path, &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, pJob->vfs);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "Error: Failed to open database: %s\n", sqlite3_errmsg(db));
+        if (db) sqlite3_close(db);
+        return rc;
+    }
     
-    printf("✓ 数据生成完成: %d 记录插入到 %d 个表中\n", records_inserted, config->table_count);
-    return SQLITE_OK;
+    // Configure database for performance
+    if (config->use_wal_mode) {
+        sqlite3_exec(db, "PRAGMA journal_mode=WAL", NULL, NULL, NULL);
+    } else {
+        sqlite3_exec(db, "PRAGMA journal_mode=DELETE", NULL, NULL, NULL);
+    }
+    sqlite3_exec(db, "PRAGMA synchronous=OFF", NULL, NULL, NULL);  // Faster writes
+    sqlite3_exec(db, "PRAGMA cache_size=-8000", NULL, NULL, NULL);  // 8MB cache
+    sqlite3_exec(db, "PRAGMA temp_store=MEMORY", NULL, NULL, NULL);  // Memory temp storage
+    sqlite3_exec(db, "PRAGMA mmap_size=268435456", NULL, NULL, NULL);  // 256MB mmap
+    
+    // Create tables, and one prepared INSERT per table slot reused for every row
+    if (pJob->only_table >= 0) {
+        rc = create_table_slot(db, config, pJob->only_table);
+    } else {
+        rc = create_tables(db, config);
+    }
+    aStmt = (sqlite3_stmt**)calloc(config->table_count, sizeof(sqlite3_stmt*));
+    if (rc == SQLITE_OK && !aStmt) rc = SQLITE_NOMEM;
+    for (int i = 0; rc == SQLITE_OK && i < config->table_count; i++) {
+        if (pJob->only_table < 0 || pJob->only_table == i) {
+            rc = gen_prepare_insert(db, config, i, &aStmt[i]);
+        }
+    }
+    
+    if (rc == SQLITE_OK) rc = gen_queue_init(&queue, config, pJob->only_table, pJob->nWorker);
+    if (rc == SQLITE_OK && pJob->nWorker > 0) {
+        aThread = (pthread_t*)malloc(sizeof(pthread_t) * pJob->nWorker);
+        for (int i = 0; aThread && i < pJob->nWorker; i++) {
+            if (pthread_create(&aThread[nStarted], NULL, gen_worker, &queue) == 0) nStarted++;
+        }
+        // 没有线程能启动时由写入线程自己生成
+        // The writer generates inline when no worker starts
+        if (nStarted == 0) queue.nWorker = 0;
+    }
+    
+    // Generate content
+    if (rc == SQLITE_OK) {
+        rc = generate_database_content(db, pJob, &queue, aStmt);
+        
+        pthread_mutex_lock(&queue.mutex);
+        queue.stop = 1;
+        pthread_cond_broadcast(&queue.cond);
+        pthread_mutex_unlock(&queue.mutex);
+        for (int i = 0; i < nStarted; i++) pthread_join(aThread[i], NULL);
+        gen_queue_free(&queue);
+    }
+    
+    for (int i = 0; aStmt && i < config->table_count; i++) {
+        sqlite3_finalize(aStmt[i]);
+    }
+    free(aStmt);
+    free(aThread);
+    
+    // Close database
+    sqlite3_close(db);
+    return rc;
+}
+
+// Split output name: the table name goes before the extension, "test.db" -> "test_users.db"
+static void gen_split_path(const char *output, const char *table, char *path, int size) {
+    const char *dot = strrchr(output, '.');
+    const char *slash = strrchr(output, '/');
+
+    if (!dot || (slash && dot < slash)) {
+        snprintf(path, size, "%s_%s", output, table);
+    } else {
+        snprintf(path, size, "%.*s_%s%s", (int)(dot - output), output, table, dot);
+    }
+}
+
+typedef struct {
+    GenJob *aJob;
+    int nJob;
+    int next;
+    pthread_mutex_t mutex;
+} GenJobQueue;
+
+static void *gen_job_worker(void *pArg) {
+    GenJobQueue *pJobs = (GenJobQueue*)pArg;
+
+    for (;;) {
+        int i;
+        pthread_mutex_lock(&pJobs->mutex);
+        i = pJobs->next < pJobs->nJob ? pJobs->next++ : -1;
+        pthread_mutex_unlock(&pJobs->mutex);
+        if (i < 0) break;
+
+        GenJob *pJob = &pJobs->aJob[i];
+        pJob->rc = gen_run_job(pJob);
+        printf("✓ %s: %d 记录, %ld 字节\n", pJob->path, pJob->records, get_file_size(pJob->path));
+        fflush(stdout);
+    }
+    return NULL;
+}
+
+// 每个表写入自己的数据库，多个数据库并行生成，线程在数据库之间平分
+// Each table gets its own database, databases are built in parallel and share the threads evenly
+static int gen_run_split(const GeneratorConfig *config, const char *vfs, int nThread, long *pTotalSize) {
+    int nJob = config->table_count;
+    int nRunner = nThread < nJob ? nThread : nJob;
+    int perJob = nThread / nJob;
+    GenJobQueue jobs;
+    pthread_t *aThread;
+    int nStarted = 0;
+    int rc = SQLITE_OK;
+
+    memset(&jobs, 0, sizeof(jobs));
+    jobs.aJob = (GenJob*)calloc(nJob, sizeof(GenJob));
+    if (!jobs.aJob) return SQLITE_NOMEM;
+    jobs.nJob = nJob;
+    pthread_mutex_init(&jobs.mutex, NULL);
+
+    for (int i = 0; i < nJob; i++) {
+        GenJob *pJob = &jobs.aJob[i];
+        char name[100];
+
+        gen_table_name(config, i, name, sizeof(name));
+        gen_split_path(config->output_file, name, pJob->path, sizeof(pJob->path));
+        pJob->config = config;
+        pJob->vfs = vfs;
+        pJob->only_table = i;
+        pJob->target_size = config->target_size / nJob;
+        pJob->nWorker = perJob > 1 ? perJob - 1 : 0;
+        pJob->quiet = 1;
+    }
+
+    printf("分表生成 %d 个数据库, 每个目标 %.2f MB, %d 个并行任务\n",
+           nJob, config->target_size / nJob / (1024.0 * 1024.0), nRunner);
+
+    aThread = (pthread_t*)malloc(sizeof(pthread_t) * nRunner);
+    for (int i = 0; aThread && nRunner > 1 && i < nRunner; i++) {
+        if (pthread_create(&aThread[nStarted], NULL, gen_job_worker, &jobs) == 0) nStarted++;
+    }
+    if (nStarted == 0) {
+        gen_job_worker(&jobs);
+    } else {
+        for (int i = 0; i < nStarted; i++) pthread_join(aThread[i], NULL);
+    }
+    free(aThread);
+
+    *pTotalSize = 0;
+    for (int i = 0; i < nJob; i++) {
+        if (jobs.aJob[i].rc != SQLITE_OK && rc == SQLITE_OK) rc = jobs.aJob[i].rc;
+        *pTotalSize += get_file_size(jobs.aJob[i].path);
+    }
+    pthread_mutex_destroy(&jobs.mutex);
+    free(jobs.aJob);
+    return rc;
 }
 
 // Parse size string (e.g., "10MB", "500KB", "2GB")
@@ -917,6 +1276,91 @@ uint32_t sqlite3_ccvfs_parse_page_size(const char *size_str) {
     return (uint32_t)value;
 }
 
+// Create one predefined table and its indexes, without progress output
+int sqlite3_ccvfs_generator_create_table(sqlite3 *db, const char *table_name) {
+    for (int i = 0; i < table_definitions_count; i++) {
+        TableDef *table_def = &table_definitions[i];
+        if (strcmp(table_def->name, table_name) != 0) continue;
+        
+        int rc = sqlite3_exec(db, table_def->schema, NULL, NULL, NULL);
+        for (int j = 0; rc == SQLITE_OK && j < 5 && table_def->indexes[j] != NULL; j++) {
+            rc = sqlite3_exec(db, table_def->indexes[j], NULL, NULL, NULL);
+        }
+        return rc;
+    }
+    return SQLITE_NOTFOUND;
+}
+
+// Insert one generated row into a predefined table
+int sqlite3_ccvfs_generator_insert_row(sqlite3 *db, const char *table_name,
+                                       const GeneratorConfig *config, int record_id) {
+    for (int i = 0; i < table_definitions_count; i++) {
+        TableDef *table_def = &table_definitions[i];
+        if (strcmp(table_def->name, table_name) != 0) continue;
+        
+        char sql[512];
+        sqlite3_stmt *stmt = NULL;
+        GenRow row;
+        
+        snprintf(sql, sizeof(sql), table_def->insert, table_def->name);
+        int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
+        if (rc != SQLITE_OK) return rc;
+        
+        gen_fill_row(config, i, record_id, &row);
+        rc = gen_insert_row(stmt, &row);
+        sqlite3_finalize(stmt);
+        return rc;
+    }
+    return SQLITE_NOTFOUND;
+}
+
+// Data mode names, indexed by DataMode
+static const char *data_mode_names[] = { "random", "sequential", "lorem", "binary", "mixed" };
+
+// Parse data mode name, -1 if unknown
+int sqlite3_ccvfs_parse_data_mode(const char *name) {
+    if (!name) return -1;
+    
+    for (int i = 0; i < (int)(sizeof(data_mode_names) / sizeof(data_mode_names[0])); i++) {
+        if (strcmp(name, data_mode_names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Get data mode name
+const char *sqlite3_ccvfs_data_mode_name(DataMode mode) {
+    if ((int)mode < 0 || (int)mode >= (int)(sizeof(data_mode_names) / sizeof(data_mode_names[0]))) {
+        return "unknown";
+    }
+    return data_mode_names[mode];
+}
+
+// Fill a buffer with records of the given mode packed back to back, the way rows share a page
+void sqlite3_ccvfs_fill_data(unsigned char *buffer, int length, DataMode mode,
+                             int record_size, int first_record) {
+    char record[4096];
+    int pos = 0;
+    int record_id = first_record;
+    GenRng rng;
+    
+    gen_rng_seed(&rng, GEN_FILL_SEED, (uint64_t)(uint32_t)first_record);
+    if (record_size < 32) record_size = 32;
+    if (record_size > (int)sizeof(record)) record_size = (int)sizeof(record);
+    
+    while (pos < length) {
+        generate_data(&rng, record, record_size, mode, record_id++);
+        
+        // Text modes stop at the terminator, binary records use their full size
+        int len = (mode == DATA_MODE_BINARY) ? record_size - 1 : (int)strlen(record);
+        if (len <= 0) continue;
+        if (len > length - pos) len = length - pos;
+        memcpy(buffer + pos, record, len);
+        pos += len;
+    }
+}
+
 // Initialize configuration with default values
 void sqlite3_ccvfs_init_generator_config(GeneratorConfig *config) {
     if (!config) return;
@@ -933,33 +1377,29 @@ void sqlite3_ccvfs_init_generator_config(GeneratorConfig *config) {
     config->verbose = 0;
     config->batch_size = 1000;
     config->use_wal_mode = 1;  // Default to WAL mode
+    config->seed = 1;
+    config->threads = 0;  // One per online CPU
+    config->split_tables = 0;
 }
 
 // Main function to generate a database
 int sqlite3_ccvfs_generate_database(const GeneratorConfig *external_config) {
-    if (!external_config || !external_config->output_file || external_config->target_size <= 0) {
+    if (!external_config || !external_config->output_file || external_config->target_size <= 0 ||
+        external_config->table_count < 1) {
         fprintf(stderr, "Error: Invalid configuration parameters\n");
         return SQLITE_ERROR;
     }
 
-    // Convert external config to internal config
-    GeneratorConfig config;
-    config.output_file = (char*)external_config->output_file;
-    config.target_size = external_config->target_size;
-    config.use_compression = external_config->use_compression;
-    config.compress_algorithm = (char*)external_config->compress_algorithm;
-    config.encrypt_algorithm = (char*)external_config->encrypt_algorithm;
-    config.page_size = external_config->page_size;
-    config.compression_level = external_config->compression_level;
-    config.data_mode = external_config->data_mode;
-    config.record_size = external_config->record_size;
-    config.table_count = external_config->table_count;
-    config.verbose = external_config->verbose;
-    config.batch_size = external_config->batch_size;
-    config.use_wal_mode = external_config->use_wal_mode;
+    GeneratorConfig config = *external_config;
+    int nThread = config.threads;
+    const char *vfs = NULL;
+    long final_size = 0;
+    int rc;
     
-    // Initialize random seed
-    srand((unsigned int)time(NULL));
+    if (nThread <= 0) {
+        long nCpu = sysconf(_SC_NPROCESSORS_ONLN);
+        nThread = nCpu > 0 ? (int)nCpu : 1;
+    }
     
     if (config.verbose) {
         printf("=== Database Generator ===\n");
@@ -967,6 +1407,9 @@ int sqlite3_ccvfs_generate_database(const GeneratorConfig *external_config) {
         printf("Target size: %.0f bytes (%.2f MB)\n", config.target_size, config.target_size / (1024.0 * 1024.0));
         printf("Compression: %s\n", config.use_compression ? "Yes" : "No");
         printf("Journal mode: %s\n", config.use_wal_mode ? "WAL" : "DELETE");
+        printf("Seed: %llu\n", (unsigned long long)config.seed);
+        printf("Threads: %d\n", nThread);
+        printf("Split tables: %s\n", config.split_tables ? "Yes" : "No");
         if (config.use_compression) {
             printf("Compression algorithm: %s\n", config.compress_algorithm);
             printf("Encryption algorithm: %s\n", config.encrypt_algorithm ? config.encrypt_algorithm : "None");
@@ -976,12 +1419,6 @@ int sqlite3_ccvfs_generate_database(const GeneratorConfig *external_config) {
         printf("\n");
     }
     
-    // Remove existing file
-    remove(config.output_file);
-    
-    sqlite3 *db = NULL;
-    int rc;
-    
     if (config.use_compression) {
         // Map string algorithms to algorithm pointers
         const CompressAlgorithm *pCompressAlg = NULL;
@@ -1024,73 +1461,38 @@ int sqlite3_ccvfs_generate_database(const GeneratorConfig *external_config) {
             fprintf(stderr, "Error: Failed to create compression VFS: %d\n", rc);
             return rc;
         }
-        
-        // Open database with compression
-        rc = sqlite3_open_v2(config.output_file, &db,
-                             SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE,
-                             "generator_vfs");
-    } else {
-        // Open regular database
-        rc = sqlite3_open_v2(config.output_file, &db,
-                             SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE,
-                             NULL);
+        vfs = "generator_vfs";
     }
     
-    if (rc != SQLITE_OK) {
-        fprintf(stderr, "Error: Failed to open database: %s\n", sqlite3_errmsg(db));
-        if (db) sqlite3_close(db);
-        if (config.use_compression) {
-            sqlite3_ccvfs_destroy("generator_vfs");
-        }
-        return rc;
-    }
+    time_t start_time = time(NULL);
     
-    // Configure database for performance
-    if (config.use_wal_mode) {
-        sqlite3_exec(db, "PRAGMA journal_mode=WAL", NULL, NULL, NULL);
+    if (config.split_tables) {
+        rc = gen_run_split(&config, vfs, nThread, &final_size);
     } else {
-        sqlite3_exec(db, "PRAGMA journal_mode=DELETE", NULL, NULL, NULL);
+        // 一个写入线程，其余线程生成行
+        // One writer, the remaining threads generate rows
+        GenJob job;
+        memset(&job, 0, sizeof(job));
+        job.config = &config;
+        job.vfs = vfs;
+        snprintf(job.path, sizeof(job.path), "%s", config.output_file);
+        job.only_table = -1;
+        job.target_size = config.target_size;
+        job.nWorker = nThread - 1;
+        rc = gen_run_job(&job);
+        final_size = get_file_size(config.output_file);
     }
-    sqlite3_exec(db, "PRAGMA synchronous=OFF", NULL, NULL, NULL);  // Faster writes
-    sqlite3_exec(db, "PRAGMA cache_size=-8000", NULL, NULL, NULL);  // 8MB cache
-    sqlite3_exec(db, "PRAGMA temp_store=MEMORY", NULL, NULL, NULL);  // Memory temp storage
-    sqlite3_exec(db, "PRAGMA mmap_size=268435456", NULL, NULL, NULL);  // 256MB mmap
     
-    time_t start_time = time(NULL);
-    
-    // Create tables
-    rc = create_tables(db, &config);
-    if (rc != SQLITE_OK) {
-        sqlite3_close(db);
-        if (config.use_compression) {
-            sqlite3_ccvfs_destroy("generator_vfs");
-        }
-        return rc;
+    if (vfs) {
+        sqlite3_ccvfs_destroy(vfs);
     }
-    
-    // Generate content
-    rc = generate_database_content(db, &config);
     if (rc != SQLITE_OK) {
-        sqlite3_close(db);
-        if (config.use_compression) {
-            sqlite3_ccvfs_destroy("generator_vfs");
-        }
         return rc;
     }
     
-    // Close database
-    sqlite3_close(db);
-    
-    if (config.use_compression) {
-        sqlite3_ccvfs_destroy("generator_vfs");
-    }
-    
     time_t end_time = time(NULL);
     double elapsed = difftime(end_time, start_time);
     
-    // Get final file size
-    long final_size = get_file_size(config.output_file);
-    
     if (config.verbose) {
         printf("\n=== Generation Complete ===\n");
         printf("Final file size: %ld bytes (%.2f MB)\n", final_size, final_size / (1024.0 * 1024.0));
@@ -1105,4 +1507,4 @@ int sqlite3_ccvfs_generate_database(const GeneratorConfig *external_config) {
     }
     
     return SQLITE_OK;
-}
\ No newline at end of file
+}
@@ -37,6 +37,9 @@ typedef struct {
     int verbose;                // Verbose output
     int batch_size;             // Records per transaction
     int use_wal_mode;           // Use WAL journal mode (default: true)
+    uint64_t seed;              // PRNG seed, the same seed gives the same rows
+    int threads;                // Generation threads including the writer (0: one per online CPU)
+    int split_tables;           // Write each table to its own database, in parallel
 } GeneratorConfig;
 
 // Main function to generate a database
@@ -51,6 +54,23 @@ uint32_t sqlite3_ccvfs_parse_page_size(const char *size_str);
 // Initialize configuration with default values
 void sqlite3_ccvfs_init_generator_config(GeneratorConfig *config);
 
+// Create one predefined table (users, products, orders, order_items, ...) and its indexes
+int sqlite3_ccvfs_generator_create_table(sqlite3 *db, const char *table_name);
+
+// Insert one generated row into a predefined table
+int sqlite3_ccvfs_generator_insert_row(sqlite3 *db, const char *table_name,
+                                       const GeneratorConfig *config, int record_id);
+
+// Parse data mode name (random, sequential, lorem, binary, mixed), -1 if unknown
+int sqlite3_ccvfs_parse_data_mode(const char *name);
+
+// Get data mode name
+const char *sqlite3_ccvfs_data_mode_name(DataMode mode);
+
+// Fill a buffer with generated records of the given mode packed back to back
+void sqlite3_ccvfs_fill_data(unsigned char *buffer, int length, DataMode mode,
+                             int record_size, int first_record);
+
 #ifdef __cplusplus
 }
 #endif
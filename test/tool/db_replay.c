@@ -0,0 +1,587 @@
+#include "db_replay.h"
+#include "db_generator.h"
+#include "sqlite3.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+
+/*
+ * I/O跟踪重放
+ * 直接调用重放VFS的文件方法，按录制顺序重现打开、读写、截断、同步、加锁和关闭。
+ * 每个文件首次打开后先调用xFileSize，新建的CCVFS文件由它初始化文件头。
+ *
+ * I/O trace replay
+ * Calls the file methods of the replay VFS directly, reproducing opens, reads, writes,
+ * truncates, syncs, locks and closes in recorded order. Every file gets an xFileSize right
+ * after its open, which initializes the header of a newly created CCVFS file.
+ */
+
+#define REPLAY_VFS_NAME     "ccvfs_replay"
+#define REPLAY_MAX_NAME     4096        // Longest file name accepted in an open record
+#define REPLAY_FILL_RECORD  64          // Record size of generated write data
+#define REPLAY_FILL_SEED    20250101    // srand() seed of generated write data
+
+// One file opened by the replay, keyed by its recorded id
+typedef struct ReplayFile {
+    uint32_t file_id;
+    sqlite3_file *pFile;
+    sqlite3_filename zName;     // Kept until xClose as the VFS interface requires
+    struct ReplayFile *pNext;
+} ReplayFile;
+
+typedef struct {
+    FILE *trace;
+    sqlite3_vfs *pVfs;
+    const char *target_db;
+    char *base_name;            // Name of the first main database in the trace
+    ReplayFile *pFiles;
+    unsigned char *buffer;      // Read and write buffer
+    uint32_t buffer_size;
+    int fill_mode;
+    const ReplayOptions *options;
+    ReplayResult *result;
+} ReplayContext;
+
+static uint64_t replay_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ull + (uint64_t)ts.tv_nsec / 1000;
+}
+
+void replay_init_options(ReplayOptions *options) {
+    memset(options, 0, sizeof(ReplayOptions));
+    options->compress_algo = "zlib";
+    options->buffer_pages = -1;
+    options->fill_mode = "mixed";
+}
+
+static int replay_read_exact(FILE *trace, void *p, size_t n) {
+    return n == 0 || fread(p, 1, n, trace) == n;
+}
+
+static uint32_t replay_get32(const unsigned char *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// 读取并校验跟踪文件头
+// Read and check the trace header
+static int replay_read_header(FILE *trace, uint32_t *pFlags, uint32_t *pPageSize,
+                              char *zCompress, char *zEncrypt) {
+    unsigned char aHeader[CCVFS_RECORD_HEADER_SIZE];
+
+    if (!replay_read_exact(trace, aHeader, sizeof(aHeader)) ||
+        memcmp(aHeader, CCVFS_RECORD_MAGIC, 8) != 0) {
+        fprintf(stderr, "错误: 不是CCVFS I/O跟踪文件\n");
+        return SQLITE_NOTADB;
+    }
+    if (replay_get32(aHeader + 8) != CCVFS_RECORD_VERSION) {
+        fprintf(stderr, "错误: 不支持的跟踪版本 %u\n", replay_get32(aHeader + 8));
+        return SQLITE_NOTADB;
+    }
+    *pFlags = replay_get32(aHeader + 12);
+    *pPageSize = replay_get32(aHeader + 24);
+    memcpy(zCompress, aHeader + 32, 16);
+    memcpy(zEncrypt, aHeader + 48, 16);
+    zCompress[15] = '\0';
+    zEncrypt[15] = '\0';
+    return SQLITE_OK;
+}
+
+// 跳过记录之后的文件名或写入数据
+// Skip the file name or write data following a record
+static int replay_payload_size(const CCVFSRecord *pRec, int hasData, uint64_t *pSize) {
+    *pSize = 0;
+    if (pRec->op == CCVFS_RECORD_OPEN || pRec->op == CCVFS_RECORD_DELETE) {
+        if (pRec->offset >= REPLAY_MAX_NAME) return 0;
+        *pSize = pRec->offset;
+    } else if (pRec->op == CCVFS_RECORD_WRITE && hasData) {
+        *pSize = pRec->arg;
+    } else if (pRec->op >= CCVFS_RECORD_OP_COUNT) {
+        return 0;
+    }
+    return 1;
+}
+
+/*
+ * 第一遍扫描：找出第一个主数据库的文件名和录制时长
+ * First pass: find the name of the first main database and the span of the recording
+ */
+static int replay_scan(ReplayContext *ctx) {
+    unsigned char aRecord[CCVFS_RECORD_SIZE];
+    char zName[REPLAY_MAX_NAME];
+    long start = ftell(ctx->trace);
+    CCVFSRecord rec;
+
+    while (replay_read_exact(ctx->trace, aRecord, sizeof(aRecord))) {
+        uint64_t payload;
+
+        sqlite3_ccvfs_record_decode(aRecord, &rec);
+        if (!replay_payload_size(&rec, ctx->result->has_data, &payload)) {
+            fprintf(stderr, "错误: 跟踪记录损坏 (op=%u)\n", rec.op);
+            return SQLITE_CORRUPT;
+        }
+        if (rec.op == CCVFS_RECORD_OPEN && !ctx->base_name && payload > 0 &&
+            (rec.arg & SQLITE_OPEN_MAIN_DB)) {
+            if (!replay_read_exact(ctx->trace, zName, (size_t)payload)) break;
+            ctx->base_name = sqlite3_mprintf("%.*s", (int)payload, zName);
+            if (!ctx->base_name) return SQLITE_NOMEM;
+        } else if (payload > 0 && fseek(ctx->trace, (long)payload, SEEK_CUR) != 0) {
+            break;
+        }
+        if ((double)rec.time_ns / 1e9 > ctx->result->trace_seconds) {
+            ctx->result->trace_seconds = (double)rec.time_ns / 1e9;
+        }
+    }
+    if (fseek(ctx->trace, start, SEEK_SET) != 0) {
+        return SQLITE_IOERR_READ;
+    }
+    return SQLITE_OK;
+}
+
+// 录制的文件名映射到目标路径
+// Map a recorded file name to a path next to the target
+static char *replay_map_name(ReplayContext *ctx, const char *zName) {
+    size_t nBase = ctx->base_name ? strlen(ctx->base_name) : 0;
+
+    if (nBase > 0 && strncmp(zName, ctx->base_name, nBase) == 0) {
+        return sqlite3_mprintf("%s%s", ctx->target_db, zName + nBase);
+    }
+    return sqlite3_mprintf("%s-%s", ctx->target_db, zName);
+}
+
+static ReplayFile *replay_find_file(ReplayContext *ctx, uint32_t file_id) {
+    for (ReplayFile *p = ctx->pFiles; p; p = p->pNext) {
+        if (p->file_id == file_id) return p;
+    }
+    return NULL;
+}
+
+static void replay_close_file(ReplayContext *ctx, ReplayFile *pFile) {
+    ReplayFile **pp;
+
+    if (pFile->pFile->pMethods) {
+        pFile->pFile->pMethods->xClose(pFile->pFile);
+    }
+    for (pp = &ctx->pFiles; *pp; pp = &(*pp)->pNext) {
+        if (*pp == pFile) {
+            *pp = pFile->pNext;
+            break;
+        }
+    }
+    sqlite3_free_filename(pFile->zName);
+    sqlite3_free(pFile->pFile);
+    sqlite3_free(pFile);
+}
+
+static int replay_open(ReplayContext *ctx, const CCVFSRecord *pRec, const char *zRecorded) {
+    sqlite3_vfs *pVfs = ctx->pVfs;
+    int flags = (int)pRec->arg & ~SQLITE_OPEN_URI;
+    sqlite3_int64 size;
+    ReplayFile *pFile;
+    int rc;
+
+    if (replay_find_file(ctx, pRec->file_id)) {
+        return SQLITE_OK;  // Already open, the recording introduced it twice
+    }
+    pFile = (ReplayFile*)sqlite3_malloc(sizeof(ReplayFile));
+    if (!pFile) return SQLITE_NOMEM;
+    memset(pFile, 0, sizeof(ReplayFile));
+    pFile->file_id = pRec->file_id;
+    pFile->pFile = (sqlite3_file*)sqlite3_malloc(pVfs->szOsFile);
+    if (!pFile->pFile) {
+        sqlite3_free(pFile);
+        return SQLITE_NOMEM;
+    }
+    memset(pFile->pFile, 0, pVfs->szOsFile);
+
+    // 临时文件没有名字；其余文件在目标旁边创建，文件不存在时必须允许创建
+    // Temporary files have no name; others live next to the target and must be creatable
+    if (zRecorded[0]) {
+        char *zPath = replay_map_name(ctx, zRecorded);
+        int exists = 0;
+
+        if (!zPath) {
+            sqlite3_free(pFile->pFile);
+            sqlite3_free(pFile);
+            return SQLITE_NOMEM;
+        }
+        pFile->zName = sqlite3_create_filename(zPath, "", "", 0, NULL);
+        sqlite3_free(zPath);
+        if (!pFile->zName) {
+            sqlite3_free(pFile->pFile);
+            sqlite3_free(pFile);
+            return SQLITE_NOMEM;
+        }
+        pVfs->xAccess(pVfs, pFile->zName, SQLITE_ACCESS_EXISTS, &exists);
+        if (!exists) {
+            flags = (flags & ~SQLITE_OPEN_READONLY) | SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE;
+        }
+    }
+
+    rc = pVfs->xOpen(pVfs, pFile->zName, pFile->pFile, flags, NULL);
+    if (rc == SQLITE_OK) {
+        rc = pFile->pFile->pMethods->xFileSize(pFile->pFile, &size);
+    }
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "错误: 无法打开重放文件 '%s': %d\n", zRecorded[0] ? zRecorded : "(临时文件)", rc);
+        if (pFile->pFile->pMethods) pFile->pFile->pMethods->xClose(pFile->pFile);
+        sqlite3_free_filename(pFile->zName);
+        sqlite3_free(pFile->pFile);
+        sqlite3_free(pFile);
+        return rc;
+    }
+    pFile->pNext = ctx->pFiles;
+    ctx->pFiles = pFile;
+    ctx->result->files++;
+    if (ctx->options->verbose) {
+        printf("打开文件 %u: %s (flags=0x%x)\n", pRec->file_id, zRecorded[0] ? zRecorded : "(临时文件)", flags);
+    }
+    return SQLITE_OK;
+}
+
+static int replay_grow_buffer(ReplayContext *ctx, uint32_t n) {
+    unsigned char *pNew;
+
+    if (n <= ctx->buffer_size) return SQLITE_OK;
+    pNew = (unsigned char*)sqlite3_realloc64(ctx->buffer, n);
+    if (!pNew) return SQLITE_NOMEM;
+    ctx->buffer = pNew;
+    ctx->buffer_size = n;
+    return SQLITE_OK;
+}
+
+/*
+ * 重放一条记录；重放调用的结果码只与录制结果比较，不终止重放
+ * Replay one record; the result of a replayed call is only compared with the recorded one
+ * and does not stop the replay
+ */
+static int replay_record(ReplayContext *ctx, const CCVFSRecord *pRec) {
+    ReplayOpStats *pStats = &ctx->result->ops[pRec->op];
+    char zName[REPLAY_MAX_NAME];
+    ReplayFile *pFile;
+    uint64_t tStart;
+    int rc = SQLITE_OK;
+
+    if (pRec->op == CCVFS_RECORD_OPEN) {
+        if (!replay_read_exact(ctx->trace, zName, (size_t)pRec->offset)) return SQLITE_CORRUPT;
+        zName[pRec->offset] = '\0';
+        tStart = replay_now_us();
+        rc = replay_open(ctx, pRec, zName);
+        pStats->calls++;
+        pStats->replay_us += replay_now_us() - tStart;
+        pStats->recorded_us += pRec->duration_us;
+        return rc;
+    }
+    if (pRec->op == CCVFS_RECORD_DELETE) {
+        char *zPath;
+
+        if (!replay_read_exact(ctx->trace, zName, (size_t)pRec->offset)) return SQLITE_CORRUPT;
+        zName[pRec->offset] = '\0';
+        zPath = replay_map_name(ctx, zName);
+        if (!zPath) return SQLITE_NOMEM;
+        tStart = replay_now_us();
+        rc = ctx->pVfs->xDelete(ctx->pVfs, zPath, (int)pRec->arg);
+        pStats->calls++;
+        pStats->replay_us += replay_now_us() - tStart;
+        pStats->recorded_us += pRec->duration_us;
+        sqlite3_free(zPath);
+        if ((rc & 0xff) != pRec->rc) {
+            ctx->result->mismatched++;
+            if (ctx->options->verbose) {
+                printf("结果不同: delete %s 录制=%d 重放=%d\n", zName, pRec->rc, rc);
+            }
+        }
+        return SQLITE_OK;
+    }
+
+    // 写入数据：录制的字节或确定性生成的数据
+    // Write data: the recorded bytes or deterministic generated data
+    if (pRec->op == CCVFS_RECORD_READ || pRec->op == CCVFS_RECORD_WRITE) {
+        rc = replay_grow_buffer(ctx, pRec->arg);
+        if (rc != SQLITE_OK) return rc;
+    }
+    if (pRec->op == CCVFS_RECORD_WRITE) {
+        if (ctx->result->has_data) {
+            if (!replay_read_exact(ctx->trace, ctx->buffer, pRec->arg)) return SQLITE_CORRUPT;
+        } else {
+            sqlite3_ccvfs_fill_data(ctx->buffer, (int)pRec->arg, (DataMode)ctx->fill_mode,
+                                    REPLAY_FILL_RECORD, (int)(pRec->offset / REPLAY_FILL_RECORD));
+        }
+    }
+
+    pFile = replay_find_file(ctx, pRec->file_id);
+    if (!pFile) {
+        if (ctx->options->verbose) {
+            printf("跳过未打开文件 %u 的 %s\n", pRec->file_id, sqlite3_ccvfs_record_op_name((int)pRec->op));
+        }
+        return SQLITE_OK;
+    }
+
+    tStart = replay_now_us();
+    switch (pRec->op) {
+        case CCVFS_RECORD_CLOSE:
+            replay_close_file(ctx, pFile);
+            break;
+        case CCVFS_RECORD_READ:
+            rc = pFile->pFile->pMethods->xRead(pFile->pFile, ctx->buffer, (int)pRec->arg,
+                                               (sqlite3_int64)pRec->offset);
+            pStats->bytes += pRec->arg;
+            break;
+        case CCVFS_RECORD_WRITE:
+            rc = pFile->pFile->pMethods->xWrite(pFile->pFile, ctx->buffer, (int)pRec->arg,
+                                                (sqlite3_int64)pRec->offset);
+            pStats->bytes += pRec->arg;
+            break;
+        case CCVFS_RECORD_TRUNCATE:
+            rc = pFile->pFile->pMethods->xTruncate(pFile->pFile, (sqlite3_int64)pRec->offset);
+            break;
+        case CCVFS_RECORD_SYNC:
+            rc = pFile->pFile->pMethods->xSync(pFile->pFile, (int)pRec->arg);
+            break;
+        case CCVFS_RECORD_LOCK:
+            rc = pFile->pFile->pMethods->xLock(pFile->pFile, (int)pRec->arg);
+            break;
+        case CCVFS_RECORD_UNLOCK:
+            rc = pFile->pFile->pMethods->xUnlock(pFile->pFile, (int)pRec->arg);
+            break;
+        default:
+            break;
+    }
+    pStats->calls++;
+    pStats->replay_us += replay_now_us() - tStart;
+    pStats->recorded_us += pRec->duration_us;
+
+    if ((rc & 0xff) != pRec->rc) {
+        ctx->result->mismatched++;
+        if (ctx->options->verbose) {
+            printf("结果不同: %s file=%u offset=%llu 录制=%d 重放=%d\n",
+                   sqlite3_ccvfs_record_op_name((int)pRec->op), pRec->file_id,
+                   (unsigned long long)pRec->offset, pRec->rc, rc);
+        }
+    }
+    return SQLITE_OK;
+}
+
+// 按选项创建重放VFS
+// Create the replay VFS from the options
+static int replay_create_vfs(const ReplayOptions *options) {
+    const CompressAlgorithm *pCompress = NULL;
+    const EncryptAlgorithm *pEncrypt = NULL;
+    int rc;
+
+    if (options->compress_algo && strcmp(options->compress_algo, "none") != 0) {
+#ifdef HAVE_ZLIB
+        if (strcmp(options->compress_algo, "zlib") == 0) pCompress = CCVFS_COMPRESS_ZLIB;
+#endif
+        if (!pCompress) {
+            fprintf(stderr, "错误: 不支持的压缩算法 '%s'\n", options->compress_algo);
+            return SQLITE_ERROR;
+        }
+    }
+    if (options->encrypt_algo && strcmp(options->encrypt_algo, "none") != 0) {
+#ifdef HAVE_OPENSSL
+        if (strcmp(options->encrypt_algo, "aes128") == 0) pEncrypt = CCVFS_ENCRYPT_AES128;
+        if (strcmp(options->encrypt_algo, "aes256") == 0) pEncrypt = CCVFS_ENCRYPT_AES256;
+#endif
+        if (!pEncrypt) {
+            fprintf(stderr, "错误: 不支持的加密算法 '%s'\n", options->encrypt_algo);
+            return SQLITE_ERROR;
+        }
+        if (!options->key || options->key_len <= 0) {
+            fprintf(stderr, "错误: 加密重放需要密钥 (-k 参数)\n");
+            return SQLITE_ERROR;
+        }
+    }
+
+    if (pEncrypt) {
+        rc = sqlite3_ccvfs_create_with_key(REPLAY_VFS_NAME, NULL, pCompress, pEncrypt, options->page_size,
+                                           CCVFS_CREATE_REALTIME, options->key, options->key_len);
+    } else {
+        rc = sqlite3_ccvfs_create(REPLAY_VFS_NAME, NULL, pCompress, NULL, options->page_size,
+                                  CCVFS_CREATE_REALTIME);
+    }
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "错误: 无法创建重放VFS: %d\n", rc);
+        return rc;
+    }
+    if (options->buffer_pages == 0) {
+        rc = sqlite3_ccvfs_configure_write_buffer(REPLAY_VFS_NAME, 0, 0, 0, 0);
+    } else if (options->buffer_pages > 0) {
+        rc = sqlite3_ccvfs_configure_write_buffer(REPLAY_VFS_NAME, 1, (uint32_t)options->buffer_pages,
+                                                  options->buffer_size, 0);
+    }
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "错误: 写入缓冲配置无效: %d\n", rc);
+        sqlite3_ccvfs_destroy(REPLAY_VFS_NAME);
+    }
+    return rc;
+}
+
+// 把种子数据库复制到目标，作为重放开始时的数据库内容
+// Copy the seed database into the target as the database the replay starts from
+static int replay_seed(const char *seed_db, const char *target_db) {
+    sqlite3 *pSrc = NULL;
+    sqlite3 *pDst = NULL;
+    sqlite3_backup *pBackup;
+    int rc;
+
+    rc = sqlite3_open_v2(seed_db, &pSrc, SQLITE_OPEN_READONLY, NULL);
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_open_v2(target_db, &pDst, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, REPLAY_VFS_NAME);
+    }
+    if (rc == SQLITE_OK) {
+        pBackup = sqlite3_backup_init(pDst, "main", pSrc, "main");
+        if (pBackup) {
+            sqlite3_backup_step(pBackup, -1);
+            sqlite3_backup_finish(pBackup);
+        }
+        rc = sqlite3_errcode(pDst);
+    }
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "错误: 无法复制种子数据库 '%s': %s\n", seed_db,
+                pDst ? sqlite3_errmsg(pDst) : (pSrc ? sqlite3_errmsg(pSrc) : sqlite3_errstr(rc)));
+    }
+    sqlite3_close(pDst);
+    sqlite3_close(pSrc);
+    return rc;
+}
+
+int replay_trace(const char *trace_path, const char *target_db,
+                 const ReplayOptions *options, ReplayResult *result) {
+    unsigned char aRecord[CCVFS_RECORD_SIZE];
+    char zCompress[16], zEncrypt[16];
+    uint32_t traceFlags = 0, tracePageSize = 0;
+    ReplayContext ctx;
+    CCVFSRecord rec;
+    uint64_t tStart;
+    struct stat st;
+    int rc;
+
+    memset(result, 0, sizeof(ReplayResult));
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.target_db = target_db;
+    ctx.options = options;
+    ctx.result = result;
+    ctx.fill_mode = sqlite3_ccvfs_parse_data_mode(options->fill_mode ? options->fill_mode : "mixed");
+    if (ctx.fill_mode < 0) {
+        fprintf(stderr, "错误: 未知的数据模式 '%s'\n", options->fill_mode);
+        return SQLITE_ERROR;
+    }
+
+    ctx.trace = fopen(trace_path, "rb");
+    if (!ctx.trace) {
+        fprintf(stderr, "错误: 无法打开跟踪文件 '%s'\n", trace_path);
+        return SQLITE_CANTOPEN;
+    }
+    rc = replay_read_header(ctx.trace, &traceFlags, &tracePageSize, zCompress, zEncrypt);
+    if (rc == SQLITE_OK) {
+        result->has_data = (traceFlags & CCVFS_RECORD_DATA) != 0;
+        rc = replay_scan(&ctx);
+    }
+    if (rc == SQLITE_OK) {
+        if (options->verbose) {
+            printf("跟踪文件: %s (录制配置: 块大小 %u, 压缩 %s, 加密 %s, %s写入数据)\n", trace_path,
+                   tracePageSize, zCompress[0] ? zCompress : "none", zEncrypt[0] ? zEncrypt : "none",
+                   result->has_data ? "含" : "不含");
+            printf("主数据库: %s -> %s\n", ctx.base_name ? ctx.base_name : "(无)", target_db);
+        }
+        rc = replay_create_vfs(options);
+    }
+    if (rc != SQLITE_OK) {
+        fclose(ctx.trace);
+        sqlite3_free(ctx.base_name);
+        return rc;
+    }
+    ctx.pVfs = sqlite3_vfs_find(REPLAY_VFS_NAME);
+
+    // 每次重放从同一个起点开始：删除旧目标，可选复制种子数据库
+    // Every replay starts from the same point: remove the old target, optionally copy the seed
+    {
+        char *zJournal = sqlite3_mprintf("%s-journal", target_db);
+        char *zWal = sqlite3_mprintf("%s-wal", target_db);
+        remove(target_db);
+        if (zJournal) remove(zJournal);
+        if (zWal) remove(zWal);
+        sqlite3_free(zJournal);
+        sqlite3_free(zWal);
+    }
+    if (options->seed_db) {
+        rc = replay_seed(options->seed_db, target_db);
+    }
+
+    srand(REPLAY_FILL_SEED);
+    tStart = replay_now_us();
+    while (rc == SQLITE_OK && replay_read_exact(ctx.trace, aRecord, sizeof(aRecord))) {
+        sqlite3_ccvfs_record_decode(aRecord, &rec);
+        if (rec.op >= CCVFS_RECORD_OP_COUNT ||
+            ((rec.op == CCVFS_RECORD_OPEN || rec.op == CCVFS_RECORD_DELETE) && rec.offset >= REPLAY_MAX_NAME)) {
+            fprintf(stderr, "错误: 跟踪记录损坏 (op=%u)\n", rec.op);
+            rc = SQLITE_CORRUPT;
+            break;
+        }
+
+        // 按原始节奏：等到该调用在录制中开始的时刻
+        // Original pace: wait until the moment the call started in the recording
+        if (options->original_pace) {
+            uint64_t due = tStart + rec.time_ns / 1000;
+            uint64_t now = replay_now_us();
+            if (due > now) {
+                ctx.pVfs->xSleep(ctx.pVfs, (int)(due - now > 0x7FFFFFFF ? 0x7FFFFFFF : due - now));
+            }
+        }
+
+        rc = replay_record(&ctx, &rec);
+        result->records++;
+    }
+    if (rc == SQLITE_OK && ferror(ctx.trace)) {
+        rc = SQLITE_IOERR_READ;
+    }
+
+    // 录制停止时仍打开的文件
+    // Files still open when the recording stopped
+    while (ctx.pFiles) {
+        ctx.pFiles->pFile->pMethods->xUnlock(ctx.pFiles->pFile, SQLITE_LOCK_NONE);
+        replay_close_file(&ctx, ctx.pFiles);
+    }
+    result->elapsed_seconds = (double)(replay_now_us() - tStart) / 1e6;
+    if (stat(target_db, &st) == 0) {
+        result->target_size = (uint64_t)st.st_size;
+    }
+
+    sqlite3_ccvfs_destroy(REPLAY_VFS_NAME);
+    sqlite3_free(ctx.buffer);
+    sqlite3_free(ctx.base_name);
+    fclose(ctx.trace);
+    return rc;
+}
+
+void print_replay_results(const ReplayResult *result, const ReplayOptions *options) {
+    printf("\n=== I/O Replay Results ===\n");
+    printf("Records replayed:   %llu\n", (unsigned long long)result->records);
+    printf("Files opened:       %llu\n", (unsigned long long)result->files);
+    printf("Write data:         %s\n", result->has_data ? "recorded" : options->fill_mode);
+    printf("Configuration:      compress=%s encrypt=%s page_size=%u buffer=%s\n",
+           options->compress_algo ? options->compress_algo : "none",
+           options->encrypt_algo ? options->encrypt_algo : "none",
+           options->page_size ? options->page_size : CCVFS_DEFAULT_PAGE_SIZE,
+           options->buffer_pages == 0 ? "off" : (options->buffer_pages < 0 ? "default" : "on"));
+    printf("Recording span:     %.3f s\n", result->trace_seconds);
+    printf("Replay time:        %.3f s (%s)\n", result->elapsed_seconds,
+           options->original_pace ? "original pace" : "as fast as possible");
+
+    printf("\n%-10s %10s %14s %14s %10s %14s\n", "Operation", "Calls", "Bytes", "Replay us", "Avg us", "Recorded us");
+    for (int op = 0; op < CCVFS_RECORD_OP_COUNT; op++) {
+        const ReplayOpStats *s = &result->ops[op];
+        if (s->calls == 0) continue;
+        printf("%-10s %10llu %14llu %14llu %10.1f %14llu\n", sqlite3_ccvfs_record_op_name(op),
+               (unsigned long long)s->calls, (unsigned long long)s->bytes,
+               (unsigned long long)s->replay_us, (double)s->replay_us / (double)s->calls,
+               (unsigned long long)s->recorded_us);
+    }
+
+    printf("\nResult mismatches:  %llu\n", (unsigned long long)result->mismatched);
+    printf("Target size:        %llu bytes (%.2f MB)\n", (unsigned long long)result->target_size,
+           (double)result->target_size / (1024.0 * 1024.0));
+}
@@ -0,0 +1,72 @@
+#ifndef DB_REPLAY_H
+#define DB_REPLAY_H
+
+#include "ccvfs.h"
+#include <stdint.h>
+
+/*
+ * I/O trace replayer - 重放sqlite3_ccvfs_record_start()录制的跟踪
+ * Replays a trace recorded by sqlite3_ccvfs_record_start() (or PRAGMA ccvfs_record) against a
+ * CCVFS built with the given page size, codec and write buffer settings, calling the file
+ * methods directly in the recorded order.
+ *
+ * 第一个主数据库文件映射到目标路径，其日志和WAL文件映射到目标路径加相同后缀。
+ * The first main database of the trace maps to the target path, its journal and WAL files to
+ * the target path plus the same suffix. Writes use the recorded bytes when the trace has them,
+ * otherwise deterministic generated data, so every run of a trace writes the same bytes.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Replay options
+typedef struct {
+    const char *compress_algo;    // Compression algorithm ("zlib", "none")
+    const char *encrypt_algo;     // Encryption algorithm (NULL for none)
+    const unsigned char *key;     // Encryption key (NULL for none)
+    int key_len;
+    uint32_t page_size;           // CCVFS block size, 0 for the default
+    int buffer_pages;             // Write buffer pages, 0 disables the buffer, -1 for the default
+    uint32_t buffer_size;         // Write buffer bytes, 0 for the default
+    int original_pace;            // Wait for each call's recorded time instead of running flat out
+    const char *seed_db;          // SQLite database copied into the target before replaying (NULL for empty)
+    const char *fill_mode;        // Generated write data when the trace has none (random, lorem, binary, ...)
+    int verbose;
+} ReplayOptions;
+
+// Per operation totals
+typedef struct {
+    uint64_t calls;
+    uint64_t bytes;               // Bytes read or written
+    uint64_t replay_us;           // Time spent in the replayed calls
+    uint64_t recorded_us;         // Time the recorded calls took
+} ReplayOpStats;
+
+// Replay result
+typedef struct {
+    ReplayOpStats ops[CCVFS_RECORD_OP_COUNT];
+    uint64_t records;             // Records replayed
+    uint64_t mismatched;          // Calls whose result code differs from the recorded one
+    uint64_t files;               // Files opened
+    int has_data;                 // The trace carries the written bytes
+    double trace_seconds;         // Span of the recording
+    double elapsed_seconds;       // Wall time of the replay
+    uint64_t target_size;         // Physical size of the target database after the replay
+} ReplayResult;
+
+// Initialize options with default values
+void replay_init_options(ReplayOptions *options);
+
+// Replay a trace into target_db, returns SQLITE_OK or the first error that stopped the replay
+int replay_trace(const char *trace_path, const char *target_db,
+                 const ReplayOptions *options, ReplayResult *result);
+
+// Print replay results
+void print_replay_results(const ReplayResult *result, const ReplayOptions *options);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DB_REPLAY_H */
@@ -2,6 +2,8 @@
 #include "sqlite3.h"
 #include "db_generator.h"
 #include "db_compare.h"
+#include "db_replay.h"
+#include "db_analyze.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -10,20 +12,6 @@
 #include <sys/stat.h>
 
 // Function declarations from db_compress_tool.c
-extern int sqlite3_ccvfs_compress_database_with_page_size(
-    const char *source_db,
-    const char *compressed_db,
-    const char *compress_algorithm,
-    const char *encrypt_algorithm,
-    uint32_t page_size,
-    int compression_level
-);
-
-extern int sqlite3_ccvfs_decompress_database(
-    const char *compressed_db,
-    const char *output_db
-);
-
 extern int sqlite3_ccvfs_get_stats(const char *compressed_db, CCVFSStats *stats);
 
 // Encryption/Decryption functions
@@ -34,9 +22,22 @@ static int perform_decrypt_database(const char *encrypted_db, const char *output
 static int perform_compress_encrypt_database(const char *source_db, const char *target_db, 
                                            const char *compress_algo, const char *encrypt_algo,
                                            const char *key_hex, uint32_t page_size, 
-                                           int compression_level, int verbose);
+                                           int compression_level, int threads, int verbose);
+static int perform_parallel_compress(const char *source_db, const char *target_db,
+                                     const char *compress_algo, const char *encrypt_algo,
+                                     const unsigned char *key, int key_len, uint32_t page_size,
+                                     int compression_level, int threads);
+static int perform_parallel_decompress(const char *compressed_db, const char *output_db,
+                                       const unsigned char *key, int key_len, int threads, int direct_io);
+static int perform_recompress(const char *source_db, const char *target_db, const char *compress_algo,
+                              const char *encrypt_algo, const unsigned char *key, int key_len,
+                              const unsigned char *new_key, int new_key_len, uint32_t page_size,
+                              int compression_level, int threads);
 static int perform_decrypt_decompress_database(const char *encrypted_file, const char *output_db,
-                                              const char *key_hex, int verbose);
+                                              const char *key_hex, int threads, int direct_io, int verbose);
+static int perform_backup(const char *source_db, const char *backup_db, const char *base_backup,
+                          const unsigned char *key, int key_len, int compact, int verify);
+static int perform_verify(const char *path, const unsigned char *key, int key_len, int threads, int verbose);
 
 // Helper functions
 static int parse_hex_key(const char *hex_str, unsigned char *key, int max_len);
@@ -50,11 +51,13 @@ static int perform_batch_test(const char *db_path, int enable_batch,
 // Database generator functions
 static int generate_database(int argc, char *argv[], int verbose,
                            int gen_compress, const char *gen_encrypt_algo,
-                           const char *gen_mode, int gen_table_count, int gen_wal_mode);
+                           const char *gen_mode, int gen_table_count, int gen_wal_mode,
+                           const char *gen_seed, int threads, int gen_split);
 
 static int perform_database_compare(const char *db1_path, const char *db2_path, int verbose,
                                    int schema_only, int ignore_case, int ignore_whitespace,
-                                   const char *ignore_tables, const char *key_hex);
+                                   const char *ignore_tables, const char *key_hex, CompareMode mode,
+                                   int threads, int range_rows, int unordered_hash);
 
 static void print_usage(const char *program_name) {
     printf("SQLite数据库压缩解压工具\n");
@@ -63,16 +66,22 @@ static void print_usage(const char *program_name) {
     printf("操作:\n");
     printf("  compress <源数据库> <目标文件>    压缩SQLite数据库\n");
     printf("  decompress <压缩文件> <输出文件>  解压数据库到标准SQLite格式\n");
+    printf("  recompress <压缩文件> <目标文件>  按新的算法、等级或块大小直接转码CCVFS文件\n");
     printf("  encrypt <源数据库> <加密文件>    加密SQLite数据库\n");
     printf("  decrypt <加密文件> <输出文件>    解密数据库到标准SQLite格式\n");
     printf("  compress-encrypt <源数据库> <目标文件>  压缩并加密SQLite数据库\n");
     printf("  decrypt-decompress <加密文件> <输出文件>  解密并解压SQLite数据库\n");
     printf("  info <压缩文件>                   显示压缩文件信息\n");
+    printf("  backup <压缩文件> <备份文件>      原样复制压缩数据块热备份CCVFS数据库\n");
+    printf("  apply-delta <备份副本> <增量文件>...  按顺序把增量备份应用到备份副本\n");
+    printf("  verify <压缩文件>                 不经过SQL并行校验每个数据块和文件布局\n");
+    printf("  analyze <数据库>                  抽样评估页大小、压缩算法和等级并给出建议\n");
     printf("  generate <输出文件> <大小>        生成指定大小的测试数据库\n");
     printf("  compare <数据库1> <数据库2>       比较两个数据库\n");
     printf("  batch-test <数据库文件>           测试批量写入功能\n");
     printf("  batch-stats <数据库文件>          显示批量写入统计信息\n");
-    printf("  batch-flush <数据库文件>          强制刷新批量写入缓冲区\n\n");
+    printf("  batch-flush <数据库文件>          强制刷新批量写入缓冲区\n");
+    printf("  replay <跟踪文件> <目标数据库>    在指定CCVFS配置上重放I/O跟踪\n\n");
 
     printf("通用选项:\n");
     printf("  -h, --help                       显示帮助信息\n");
@@ -83,21 +92,41 @@ static void print_usage(const char *program_name) {
     printf("  -c, --compress-algo <算法>       压缩算法 (rle, lz4, zlib)\n");
     printf("  -e, --encrypt-algo <算法>        加密算法 (xor, aes128, aes256, chacha20, 默认: aes128)\n");
     printf("  -l, --level <等级>               压缩等级 (1-9, 默认: 6)\n");
-    printf("  -b, --page-size <大小>          页大小 (1K, 4K, 8K, 16K, 32K, 64K, 128K, 256K, 512K, 1M, 默认: 64K)\n\n");
+    printf("  -b, --page-size <大小>          页大小 (1K, 4K, 8K, 16K, 32K, 64K, 128K, 256K, 512K, 1M, 默认: 64K)\n");
+    printf("  --threads <数量>                 并行线程数 (compress, compress-encrypt, decompress, decrypt-decompress, recompress, analyze, compare, verify, generate, 默认: CPU核数)\n");
+    printf("  --direct-io                      解压输出使用O_DIRECT写入，文件系统不支持时改用普通写入\n\n");
+
+    printf("热备份选项 (仅用于 backup，加密的文件另需 -k):\n");
+    printf("  --compact                        按块号顺序紧凑排列数据块，去掉空洞\n");
+    printf("  --verify                         复制前检查每个数据块的校验和\n");
+    printf("  --incremental <基础>             只写出与基础（备份副本或上一个增量文件）不同的数据块\n\n");
+
+    printf("重新压缩选项 (仅用于 recompress，未指定的 -c, -e, -l, -b 沿用源文件的设置):\n");
+    printf("  -k, --key <密钥>                  源文件的密钥（十六进制格式）\n");
+    printf("  --new-key <密钥>                 目标文件的密钥（十六进制格式，默认沿用 -k）\n");
+    printf("  -e none                          去掉加密\n\n");
 
     printf("数据库生成选项 (仅用于 generate):\n");
     printf("  -C, --compress                   启用压缩\n");
     printf("  -E, --encrypt <算法>             加密算法 (xor, aes128, aes256, chacha20)\n");
     printf("  --mode <模式>                    数据生成模式 (random, sequential, lorem, binary, mixed)\n");
     printf("  --tables <数量>                  创建表的数量 (默认: 1)\n");
-    printf("  --no-wal                         禁用WAL模式\n\n");
+    printf("  --no-wal                         禁用WAL模式\n");
+    printf("  --seed <数值>                    随机数种子，相同种子生成相同内容 (默认: 1)\n");
+    printf("  --threads <数量>                 生成线程数，含一个写入线程 (默认: CPU核数)\n");
+    printf("  --split                          每个表写入单独的数据库并行生成，大小在数据库间平分\n\n");
 
     printf("数据库比较选项 (仅用于 compare):\n");
     printf("  -s, --schema-only                只比较表结构，不比较数据\n");
     printf("  -i, --ignore-case                忽略字符串比较中的大小写差异\n");
     printf("  -w, --ignore-whitespace          忽略空白字符差异\n");
     printf("  -t, --ignore-tables <表名>       忽略指定的表（逗号分隔）\n");
-    printf("  -k, --key <密钥>                加密数据库的解密密钥（十六进制格式）\n\n");
+    printf("  -k, --key <密钥>                加密数据库的解密密钥（十六进制格式）\n");
+    printf("  --hash                           按 rowid 区间并行计算哈希，只逐行复查哈希不同的区间\n");
+    printf("  --pages                          并行比较解码后的页映像（WAL 须先检查点）\n");
+    printf("  --range-rows <数量>              每个哈希区间的 rowid 数 (默认: %d)\n", COMPARE_DEFAULT_RANGE_ROWS);
+    printf("  --unordered                      区间哈希与行顺序无关\n");
+    printf("  --threads <数量>                 --hash 和 --pages 的线程数 (默认: CPU核数)\n\n");
 
     printf("批量写入测试选项 (仅用于 batch-test):\n");
     printf("  --batch-enable                   启用批量写入 (默认: 禁用)\n");
@@ -105,6 +134,21 @@ static void print_usage(const char *program_name) {
     printf("  --batch-memory <MB>              批量写入最大内存 (默认: 16MB)\n");
     printf("  --batch-records <数量>           批量测试记录数 (默认: 1000)\n\n");
 
+    printf("I/O重放选项 (仅用于 replay，另可使用 -c, -e, -k, -b):\n");
+    printf("  --pace <节奏>                    fast 尽快重放 (默认), original 按录制时的节奏\n");
+    printf("  --buffer-pages <数量>            写入缓冲页数，0 禁用写入缓冲 (默认: VFS默认值)\n");
+    printf("  --buffer-memory <MB>             写入缓冲最大内存 (默认: VFS默认值)\n");
+    printf("  --seed <数据库>                  重放前把该SQLite数据库复制到目标\n");
+    printf("  --fill <模式>                    跟踪不含写入数据时生成数据的模式 (random, sequential, lorem, binary, mixed, 默认: mixed)\n\n");
+
+    printf("压缩建议选项 (仅用于 analyze，加密的CCVFS文件另需 -k):\n");
+    printf("  --sample <数量>                  每种页大小抽样的块数 (默认: 256，每种页大小最多8MB)\n");
+    printf("  --page-sizes <列表>              候选页大小，逗号分隔 (默认: 4K,8K,16K,32K,64K,128K,256K,512K,1M)\n");
+    printf("  --levels <列表>                  候选压缩等级，如 1,6,9 或 1-9 (默认: 1-9)\n");
+    printf("  --goal <目标>                    排名目标 balanced, space, latency (默认: balanced)\n");
+    printf("  --disk-mbps <MB/s>               估算读取耗时所用的设备带宽 (默认: 500)\n");
+    printf("  --top <数量>                     显示的候选数，0 显示全部 (默认: 10)\n\n");
+
     printf("页大小选项:\n");
     printf("  1K, 1024         1KB 页 (适合极小文件)\n");
     printf("  4K, 4096         4KB 页 (适合小文件)\n");
@@ -122,7 +166,15 @@ static void print_usage(const char *program_name) {
     printf("  %s compress -c zlib -e aes128 -l 9 test.db test.ccvfs\n", program_name);
     printf("  %s compress -b 4K test.db test.ccvfs          # 使用4KB页大小\n", program_name);
     printf("  %s compress -b 1M -c zlib test.db test.ccvfs  # 使用1MB页大小\n", program_name);
+    printf("  %s compress --threads 16 -l 6 big.db big.ccvfs  # 16个线程并行压缩\n", program_name);
     printf("  %s decompress test.ccvfs restored.db\n", program_name);
+    printf("  %s decompress --threads 8 --direct-io big.ccvfs big.db  # 8个线程并行解压\n", program_name);
+    printf("  %s recompress -b 16K -l 9 live.ccvfs new.ccvfs  # 改用16KB块和等级9，不经过普通数据库\n", program_name);
+    printf("  %s recompress -e aes256 --new-key 00112233445566778899AABBCCDDEEFF live.ccvfs secure.ccvfs\n", program_name);
+    printf("  %s backup --compact --verify live.ccvfs backup.ccvfs  # 不解码的热备份\n", program_name);
+    printf("  %s backup --incremental mon.delta live.ccvfs tue.delta  # 增量备份\n", program_name);
+    printf("  %s apply-delta backup.ccvfs mon.delta tue.delta\n", program_name);
+    printf("  %s verify --threads 8 live.ccvfs                # 并行校验每个数据块\n", program_name);
     printf("  %s encrypt -k 0123456789ABCDEF test.db encrypted.db                    # 使用默认aes128\n", program_name);
     printf("  %s encrypt -e aes256 -k 0123456789ABCDEF test.db encrypted.db\n", program_name);
     printf("  %s decrypt -k 0123456789ABCDEF encrypted.db decrypted.db\n", program_name);
@@ -130,14 +182,21 @@ static void print_usage(const char *program_name) {
     printf("  %s compress-encrypt -c zlib -e aes256 -k 0123456789ABCDEF test.db secure.ccvfs\n", program_name);
     printf("  %s decrypt-decompress -k 0123456789ABCDEF secure.ccvfs restored.db\n", program_name);
     printf("  %s info test.ccvfs\n", program_name);
+    printf("  %s analyze app.db                            # 为普通数据库推荐CCVFS配置\n", program_name);
+    printf("  %s analyze --goal space --levels 6-9 app.ccvfs\n", program_name);
     printf("  %s generate test.db 100MB                     # 生成100MB测试数据库\n", program_name);
     printf("  %s generate -C -E aes128 test.ccvfs 500MB    # 生成500MB压缩加密数据库\n", program_name);
+    printf("  %s generate --seed 42 --tables 4 --split t.db 1GB  # 4个表并行写入4个数据库，可重现\n", program_name);
     printf("  %s compare db1.db db2.db                      # 比较两个数据库\n", program_name);
     printf("  %s compare -s db1.db db2.db                   # 只比较表结构\n", program_name);
     printf("  %s compare -k 0123456789ABCDEF original.db encrypted.db  # 比较原始数据库和加密数据库\n", program_name);
+    printf("  %s compare --hash --threads 8 big.db big_copy.db  # 8个线程按区间哈希比较\n", program_name);
+    printf("  %s compare --pages big.db big.ccvfs              # 比较解码后的页映像\n", program_name);
     printf("  %s batch-test --batch-enable --batch-records 5000 test.db\n", program_name);
     printf("  %s batch-stats test.db\n", program_name);
     printf("  %s batch-flush test.db\n", program_name);
+    printf("  %s replay -b 16K -c zlib app.trace replay.db  # 用16KB块重放生产跟踪\n", program_name);
+    printf("  %s replay --pace original --buffer-pages 0 app.trace replay.db\n", program_name);
 }
 
 // Parse page size string to bytes
@@ -194,8 +253,20 @@ int main(int argc, char *argv[]) {
     const char *compress_algo = "zlib";
     const char *encrypt_algo = NULL; // Default to no encryption
     const char *key_hex = NULL; // Encryption key in hex format
+    const char *new_key_hex = NULL; // Target key of recompress in hex format
+    int compress_algo_set = 0;
+    int encrypt_algo_set = 0;
     int compression_level = 6;
+    int compression_level_set = 0;
     uint32_t page_size = 0; // Will be auto-detected from source database
+    int threads = 0; // One per online CPU
+    int direct_io = 0;
+    int backup_compact = 0;
+    int backup_verify = 0;
+    const char *backup_base = NULL;
+    CompareMode compare_mode = COMPARE_MODE_ROWS;
+    int compare_range_rows = 0;
+    int compare_unordered = 0;
     int verbose = 0;
     int rc;
 
@@ -211,6 +282,18 @@ int main(int argc, char *argv[]) {
     const char *gen_mode = "random";
     int gen_table_count = 1;
     int gen_wal_mode = 1;
+    const char *gen_seed = NULL;
+    int gen_split = 0;
+
+    // Analyze options
+    AnalyzeOptions analyze_options;
+    int analyze_option_used = 0;
+    analyze_init_options(&analyze_options);
+
+    // Replay options
+    ReplayOptions replay_options;
+    int replay_option_used = 0;
+    replay_init_options(&replay_options);
 
     static struct option long_options[] = {
         {"compress-algo", required_argument, 0, 'c'},
@@ -227,6 +310,28 @@ int main(int argc, char *argv[]) {
         {"mode", required_argument, 0, 1004},
         {"tables", required_argument, 0, 1005},
         {"no-wal", no_argument, 0, 1006},
+        {"pace", required_argument, 0, 1007},
+        {"buffer-pages", required_argument, 0, 1008},
+        {"buffer-memory", required_argument, 0, 1009},
+        {"seed", required_argument, 0, 1010},
+        {"fill", required_argument, 0, 1011},
+        {"sample", required_argument, 0, 1012},
+        {"page-sizes", required_argument, 0, 1013},
+        {"levels", required_argument, 0, 1014},
+        {"threads", required_argument, 0, 1015},
+        {"goal", required_argument, 0, 1016},
+        {"disk-mbps", required_argument, 0, 1017},
+        {"top", required_argument, 0, 1018},
+        {"direct-io", no_argument, 0, 1019},
+        {"compact", no_argument, 0, 1020},
+        {"verify", no_argument, 0, 1021},
+        {"incremental", required_argument, 0, 1022},
+        {"hash", no_argument, 0, 1023},
+        {"pages", no_argument, 0, 1024},
+        {"range-rows", required_argument, 0, 1025},
+        {"unordered", no_argument, 0, 1026},
+        {"split", no_argument, 0, 1027},
+        {"new-key", required_argument, 0, 1028},
         {"schema-only", no_argument, 0, 's'},
         {"ignore-case", no_argument, 0, 'i'},
         {"ignore-whitespace", no_argument, 0, 'w'},
@@ -241,9 +346,11 @@ int main(int argc, char *argv[]) {
         switch (c) {
             case 'c':
                 compress_algo = optarg;
+                compress_algo_set = 1;
                 break;
             case 'e':
                 encrypt_algo = optarg;
+                encrypt_algo_set = 1;
                 if (strcmp(encrypt_algo, "none") == 0) {
                     encrypt_algo = NULL;
                 }
@@ -257,6 +364,7 @@ int main(int argc, char *argv[]) {
                     fprintf(stderr, "错误: 压缩等级必须在1-9之间\n");
                     return 1;
                 }
+                compression_level_set = 1;
                 break;
             case 'b':
                 page_size = parse_page_size(optarg);
@@ -313,6 +421,136 @@ int main(int argc, char *argv[]) {
             case 1006: // --no-wal
                 gen_wal_mode = 0;
                 break;
+            case 1007: // --pace
+                if (strcmp(optarg, "original") == 0) {
+                    replay_options.original_pace = 1;
+                } else if (strcmp(optarg, "fast") != 0) {
+                    fprintf(stderr, "错误: 重放节奏必须是 fast 或 original\n");
+                    return 1;
+                }
+                replay_option_used = 1;
+                break;
+            case 1008: // --buffer-pages
+                replay_options.buffer_pages = atoi(optarg);
+                if (replay_options.buffer_pages < 0) {
+                    fprintf(stderr, "错误: 写入缓冲页数不能为负数\n");
+                    return 1;
+                }
+                replay_option_used = 1;
+                break;
+            case 1009: // --buffer-memory
+                if (atoi(optarg) <= 0) {
+                    fprintf(stderr, "错误: 写入缓冲内存必须大于0MB\n");
+                    return 1;
+                }
+                replay_options.buffer_size = (uint32_t)atoi(optarg) * 1024 * 1024;
+                replay_option_used = 1;
+                break;
+            case 1010: // --seed, a seed database for replay and a PRNG seed for generate
+                replay_options.seed_db = optarg;
+                gen_seed = optarg;
+                break;
+            case 1011: // --fill
+                if (sqlite3_ccvfs_parse_data_mode(optarg) < 0) {
+                    fprintf(stderr, "错误: 未知的数据模式 '%s'\n", optarg);
+                    return 1;
+                }
+                replay_options.fill_mode = optarg;
+                replay_option_used = 1;
+                break;
+            case 1012: // --sample
+                analyze_options.sample_pages = atoi(optarg);
+                if (analyze_options.sample_pages <= 0) {
+                    fprintf(stderr, "错误: 抽样块数必须大于0\n");
+                    return 1;
+                }
+                analyze_option_used = 1;
+                break;
+            case 1013: // --page-sizes
+                if (analyze_parse_page_sizes(optarg, &analyze_options) <= 0) {
+                    fprintf(stderr, "错误: 无效的页大小列表 '%s'\n", optarg);
+                    return 1;
+                }
+                analyze_option_used = 1;
+                break;
+            case 1014: // --levels
+                if (analyze_parse_levels(optarg, &analyze_options) <= 0) {
+                    fprintf(stderr, "错误: 无效的压缩等级列表 '%s' (有效范围: 1-9)\n", optarg);
+                    return 1;
+                }
+                analyze_option_used = 1;
+                break;
+            case 1015: // --threads
+                threads = atoi(optarg);
+                if (threads <= 0) {
+                    fprintf(stderr, "错误: 线程数必须大于0\n");
+                    return 1;
+                }
+                analyze_options.threads = threads;
+                break;
+            case 1016: // --goal
+                if (strcmp(optarg, "balanced") == 0) {
+                    analyze_options.goal = ANALYZE_GOAL_BALANCED;
+                } else if (strcmp(optarg, "space") == 0) {
+                    analyze_options.goal = ANALYZE_GOAL_SPACE;
+                } else if (strcmp(optarg, "latency") == 0) {
+                    analyze_options.goal = ANALYZE_GOAL_LATENCY;
+                } else {
+                    fprintf(stderr, "错误: 排名目标必须是 balanced, space 或 latency\n");
+                    return 1;
+                }
+                analyze_option_used = 1;
+                break;
+            case 1017: // --disk-mbps
+                analyze_options.disk_mbps = atof(optarg);
+                if (analyze_options.disk_mbps <= 0) {
+                    fprintf(stderr, "错误: 设备带宽必须大于0\n");
+                    return 1;
+                }
+                analyze_option_used = 1;
+                break;
+            case 1018: // --top
+                analyze_options.top = atoi(optarg);
+                if (analyze_options.top < 0) {
+                    fprintf(stderr, "错误: 显示的候选数不能为负数\n");
+                    return 1;
+                }
+                analyze_option_used = 1;
+                break;
+            case 1019: // --direct-io
+                direct_io = 1;
+                break;
+            case 1020: // --compact
+                backup_compact = 1;
+                break;
+            case 1021: // --verify
+                backup_verify = 1;
+                break;
+            case 1022: // --incremental
+                backup_base = optarg;
+                break;
+            case 1023: // --hash
+                compare_mode = COMPARE_MODE_HASH;
+                break;
+            case 1024: // --pages
+                compare_mode = COMPARE_MODE_PAGES;
+                break;
+            case 1025: // --range-rows
+                compare_range_rows = atoi(optarg);
+                if (compare_range_rows <= 0) {
+                    fprintf(stderr, "错误: 无效的区间行数: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 1026: // --unordered
+                compare_unordered = 1;
+                break;
+            case 1027: // --split
+                gen_split = 1;
+                break;
+            case 1028: // --new-key
+                new_key_hex = optarg;
+                break;
             case 's': // --schema-only for compare
                 // Will be handled in compare operation
                 break;
@@ -358,13 +596,65 @@ int main(int argc, char *argv[]) {
 
     // Validate generator options are only used with generate operation
     if (gen_compress || gen_encrypt_algo || strcmp(gen_mode, "random") != 0 || gen_table_count != 1 || gen_wal_mode !=
-        1) {
+        1 || gen_split) {
         if (strcmp(operation, "generate") != 0) {
             fprintf(stderr, "错误: 数据库生成选项只能用于 generate 操作\n");
-            fprintf(stderr, "数据库生成选项: -C, -E, --mode, --tables, --no-wal\n");
+            fprintf(stderr, "数据库生成选项: -C, -E, --mode, --tables, --no-wal, --split\n");
             return 1;
         }
     }
+    if (gen_seed && strcmp(operation, "replay") != 0 && strcmp(operation, "generate") != 0) {
+        fprintf(stderr, "错误: --seed 只能用于 replay 或 generate 操作\n");
+        return 1;
+    }
+
+    // Validate replay options are only used with replay operation
+    if (replay_option_used && strcmp(operation, "replay") != 0) {
+        fprintf(stderr, "错误: I/O重放选项只能用于 replay 操作\n");
+        fprintf(stderr, "I/O重放选项: --pace, --buffer-pages, --buffer-memory, --seed, --fill\n");
+        return 1;
+    }
+
+    // Validate analyze options are only used with analyze operation
+    if (analyze_option_used && strcmp(operation, "analyze") != 0) {
+        fprintf(stderr, "错误: 压缩建议选项只能用于 analyze 操作\n");
+        fprintf(stderr, "压缩建议选项: --sample, --page-sizes, --levels, --goal, --disk-mbps, --top\n");
+        return 1;
+    }
+
+    // Validate the thread count is only used with operations that run in parallel
+    if (threads > 0 && strcmp(operation, "compress") != 0 && strcmp(operation, "compress-encrypt") != 0 &&
+        strcmp(operation, "decompress") != 0 && strcmp(operation, "decrypt-decompress") != 0 &&
+        strcmp(operation, "recompress") != 0 && strcmp(operation, "analyze") != 0 &&
+        strcmp(operation, "compare") != 0 && strcmp(operation, "verify") != 0 && strcmp(operation, "generate") != 0) {
+        fprintf(stderr, "错误: --threads 只能用于 compress, compress-encrypt, decompress, decrypt-decompress, recompress, analyze, compare, verify 或 generate 操作\n");
+        return 1;
+    }
+    if (new_key_hex && strcmp(operation, "recompress") != 0) {
+        fprintf(stderr, "错误: --new-key 只能用于 recompress 操作\n");
+        return 1;
+    }
+    if (direct_io && strcmp(operation, "decompress") != 0 && strcmp(operation, "decrypt-decompress") != 0) {
+        fprintf(stderr, "错误: --direct-io 只能用于 decompress 或 decrypt-decompress 操作\n");
+        return 1;
+    }
+    if ((backup_compact || backup_verify || backup_base) && strcmp(operation, "backup") != 0) {
+        fprintf(stderr, "错误: --compact, --verify 和 --incremental 只能用于 backup 操作\n");
+        return 1;
+    }
+    if ((compare_mode != COMPARE_MODE_ROWS || compare_range_rows || compare_unordered) &&
+        strcmp(operation, "compare") != 0) {
+        fprintf(stderr, "错误: --hash, --pages, --range-rows 和 --unordered 只能用于 compare 操作\n");
+        return 1;
+    }
+    if ((compare_range_rows || compare_unordered) && compare_mode != COMPARE_MODE_HASH) {
+        fprintf(stderr, "错误: --range-rows 和 --unordered 需要 --hash\n");
+        return 1;
+    }
+    if (backup_compact && backup_base) {
+        fprintf(stderr, "错误: 增量备份保持数据块的原偏移，不能与 --compact 一起使用\n");
+        return 1;
+    }
 
     if (strcmp(operation, "compress") == 0) {
         if (optind + 2 >= argc) {
@@ -377,15 +667,14 @@ int main(int argc, char *argv[]) {
         const char *target_db = argv[optind + 2];
 
         // Set encryption key if provided
+        unsigned char key[64];
+        int key_len = 0;
         if (key_hex && encrypt_algo) {
-            unsigned char key[64];
-            int key_len = parse_hex_key(key_hex, key, sizeof(key));
+            key_len = parse_hex_key(key_hex, key, sizeof(key));
             if (key_len <= 0) {
                 fprintf(stderr, "错误: 无效的密钥格式\n");
                 return 1;
             }
-            // Note: The compress function will create its own VFS
-            // We'll need to set the key after VFS creation
             if (verbose) {
                 printf("已解析加密密钥: ");
                 print_hex_key(key, key_len);
@@ -426,9 +715,9 @@ int main(int argc, char *argv[]) {
             printf("\n");
         }
 
-        rc = sqlite3_ccvfs_compress_database_with_page_size(source_db, target_db,
-                                                            compress_algo, encrypt_algo,
-                                                            page_size, compression_level);
+        rc = perform_parallel_compress(source_db, target_db, compress_algo, encrypt_algo,
+                                       key_len > 0 ? key : NULL, key_len, page_size,
+                                       compression_level, threads);
 
         if (rc == SQLITE_OK) {
             printf("\n数据库压缩成功!\n");
@@ -454,15 +743,14 @@ int main(int argc, char *argv[]) {
         const char *output_db = argv[optind + 2];
 
         // Set decryption key if provided
+        unsigned char key[64];
+        int key_len = 0;
         if (key_hex) {
-            unsigned char key[64];
-            int key_len = parse_hex_key(key_hex, key, sizeof(key));
+            key_len = parse_hex_key(key_hex, key, sizeof(key));
             if (key_len <= 0) {
                 fprintf(stderr, "错误: 无效的密钥格式\n");
                 return 1;
             }
-            // Note: The decompress function will create its own VFS
-            // We'll need to set the key after VFS creation
             if (verbose) {
                 printf("已解析解密密钥: ");
                 print_hex_key(key, key_len);
@@ -477,7 +765,8 @@ int main(int argc, char *argv[]) {
             printf("\n");
         }
 
-        rc = sqlite3_ccvfs_decompress_database(compressed_db, output_db);
+        rc = perform_parallel_decompress(compressed_db, output_db, key_hex ? key : NULL, key_len,
+                                         threads, direct_io);
 
         if (rc == SQLITE_OK) {
             printf("\n数据库解压成功!\n");
@@ -486,6 +775,50 @@ int main(int argc, char *argv[]) {
             fprintf(stderr, "数据库解压失败，错误代码: %d\n", rc);
             return 1;
         }
+    } else if (strcmp(operation, "recompress") == 0) {
+        if (optind + 2 >= argc) {
+            fprintf(stderr, "错误: recompress 操作需要压缩文件和目标文件参数\n");
+            print_usage(argv[0]);
+            return 1;
+        }
+
+        unsigned char key[64];
+        unsigned char new_key[64];
+        int key_len = 0;
+        int new_key_len = 0;
+        if (key_hex) {
+            key_len = parse_hex_key(key_hex, key, sizeof(key));
+            if (key_len <= 0) {
+                fprintf(stderr, "错误: 无效的密钥格式\n");
+                return 1;
+            }
+        }
+        if (new_key_hex) {
+            new_key_len = parse_hex_key(new_key_hex, new_key, sizeof(new_key));
+            if (new_key_len <= 0) {
+                fprintf(stderr, "错误: 无效的目标密钥格式\n");
+                return 1;
+            }
+        }
+
+        // -e none removes the encryption, options not given keep the source settings
+        rc = perform_recompress(argv[optind + 1], argv[optind + 2], compress_algo_set ? compress_algo : NULL,
+                                encrypt_algo_set ? (encrypt_algo ? encrypt_algo : "none") : NULL,
+                                key_hex ? key : NULL, key_len, new_key_hex ? new_key : NULL, new_key_len,
+                                page_size, compression_level_set ? compression_level : 0, threads);
+        if (rc == SQLITE_OK) {
+            printf("\n数据库重新压缩成功!\n");
+
+            CCVFSStats stats;
+            if (sqlite3_ccvfs_get_stats(argv[optind + 2], &stats) == SQLITE_OK) {
+                print_stats(&stats);
+            }
+            return 0;
+        } else {
+            fprintf(stderr, "数据库重新压缩失败，错误代码: %d%s\n", rc,
+                    rc == SQLITE_BUSY ? " (WAL无法检查点或源文件在复制期间被修改，请重试)" : "");
+            return 1;
+        }
     } else if (strcmp(operation, "encrypt") == 0) {
         if (optind + 2 >= argc) {
             fprintf(stderr, "错误: encrypt 操作需要源文件和加密文件参数\n");
@@ -569,7 +902,7 @@ int main(int argc, char *argv[]) {
 
         return perform_compress_encrypt_database(source_db, target_db, compress_algo, 
                                                 encrypt_algo, key_hex, page_size, 
-                                                compression_level, verbose);
+                                                compression_level, threads, verbose);
     } else if (strcmp(operation, "decrypt-decompress") == 0) {
         if (optind + 2 >= argc) {
             fprintf(stderr, "错误: decrypt-decompress 操作需要加密文件和输出文件参数\n");
@@ -585,7 +918,7 @@ int main(int argc, char *argv[]) {
             return 1;
         }
 
-        return perform_decrypt_decompress_database(encrypted_file, output_db, key_hex, verbose);
+        return perform_decrypt_decompress_database(encrypted_file, output_db, key_hex, threads, direct_io, verbose);
     } else if (strcmp(operation, "info") == 0) {
         if (optind + 1 >= argc) {
             fprintf(stderr, "错误: info 操作需要压缩文件参数\n");
@@ -605,10 +938,118 @@ int main(int argc, char *argv[]) {
             fprintf(stderr, "无法读取压缩文件信息，错误代码: %d\n", rc);
             return 1;
         }
+    } else if (strcmp(operation, "backup") == 0) {
+        if (optind + 2 >= argc) {
+            fprintf(stderr, "错误: backup 操作需要压缩文件和备份文件参数\n");
+            print_usage(argv[0]);
+            return 1;
+        }
+
+        unsigned char key[64];
+        int key_len = 0;
+        if (key_hex) {
+            key_len = parse_hex_key(key_hex, key, sizeof(key));
+            if (key_len <= 0) {
+                fprintf(stderr, "错误: 无效的密钥格式\n");
+                return 1;
+            }
+        }
+
+        rc = perform_backup(argv[optind + 1], argv[optind + 2], backup_base, key_hex ? key : NULL, key_len,
+                            backup_compact, backup_verify);
+        if (rc == SQLITE_OK) {
+            printf("\n数据库备份成功!\n");
+            return 0;
+        } else {
+            fprintf(stderr, "数据库备份失败，错误代码: %d\n", rc);
+            return 1;
+        }
+    } else if (strcmp(operation, "apply-delta") == 0) {
+        if (optind + 2 >= argc) {
+            fprintf(stderr, "错误: apply-delta 操作需要备份副本和至少一个增量文件参数\n");
+            print_usage(argv[0]);
+            return 1;
+        }
+
+        const char *backup_db = argv[optind + 1];
+        int i;
+        for (i = optind + 2; i < argc; i++) {
+            rc = sqlite3_ccvfs_apply_delta(backup_db, argv[i]);
+            if (rc != SQLITE_OK) {
+                fprintf(stderr, "应用增量 %s 失败，错误代码: %d%s\n", argv[i], rc,
+                        rc == SQLITE_MISMATCH ? " (备份副本不是该增量的基础)" : "");
+                return 1;
+            }
+            printf("已应用 %s\n", argv[i]);
+        }
+        printf("\n增量应用成功!\n");
+        return 0;
+    } else if (strcmp(operation, "verify") == 0) {
+        if (optind + 1 >= argc) {
+            fprintf(stderr, "错误: verify 操作需要压缩文件参数\n");
+            print_usage(argv[0]);
+            return 1;
+        }
+
+        unsigned char key[64];
+        int key_len = 0;
+        if (key_hex) {
+            key_len = parse_hex_key(key_hex, key, sizeof(key));
+            if (key_len <= 0) {
+                fprintf(stderr, "错误: 无效的密钥格式\n");
+                return 1;
+            }
+        }
+
+        rc = perform_verify(argv[optind + 1], key_hex ? key : NULL, key_len, threads, verbose);
+        if (rc == SQLITE_OK) {
+            printf("\n校验通过!\n");
+            return 0;
+        } else if (rc == SQLITE_CORRUPT) {
+            fprintf(stderr, "\n发现损坏!\n");
+            return 2;
+        } else {
+            fprintf(stderr, "校验失败，错误代码: %d%s\n", rc, rc == SQLITE_BUSY ? " (文件在校验期间被修改，请重试)" : "");
+            return 1;
+        }
+    } else if (strcmp(operation, "analyze") == 0) {
+        if (optind + 1 >= argc) {
+            fprintf(stderr, "错误: analyze 操作需要数据库文件参数\n");
+            print_usage(argv[0]);
+            return 1;
+        }
+
+        const char *db_path = argv[optind + 1];
+        unsigned char key[64];
+        AnalyzeResult *analyze_result;
+
+        analyze_options.verbose = verbose;
+        if (key_hex) {
+            analyze_options.key_len = parse_hex_key(key_hex, key, sizeof(key));
+            if (analyze_options.key_len <= 0) {
+                fprintf(stderr, "错误: 无效的密钥格式\n");
+                return 1;
+            }
+            analyze_options.key = key;
+        }
+
+        analyze_result = (AnalyzeResult*)malloc(sizeof(AnalyzeResult));
+        if (!analyze_result) {
+            fprintf(stderr, "错误: 内存不足\n");
+            return 1;
+        }
+        rc = analyze_database(db_path, &analyze_options, analyze_result);
+        if (rc == SQLITE_OK) {
+            print_analyze_results(analyze_result, &analyze_options);
+        } else {
+            fprintf(stderr, "压缩分析失败，错误代码: %d\n", rc);
+        }
+        free(analyze_result);
+        return rc == SQLITE_OK ? 0 : 1;
     } else if (strcmp(operation, "generate") == 0) {
         return generate_database(argc - optind, &argv[optind], verbose,
                                gen_compress, gen_encrypt_algo, gen_mode,
-                               gen_table_count, gen_wal_mode);
+                               gen_table_count, gen_wal_mode, gen_seed, threads, gen_split);
     } else if (strcmp(operation, "compare") == 0) {
         if (optind + 2 >= argc) {
             fprintf(stderr, "错误: compare 操作需要两个数据库文件参数\n");
@@ -656,7 +1097,8 @@ int main(int argc, char *argv[]) {
         }
 
         return perform_database_compare(db1_path, db2_path, verbose, 
-                                       schema_only, ignore_case, ignore_whitespace, ignore_tables, compare_key_hex);
+                                       schema_only, ignore_case, ignore_whitespace, ignore_tables, compare_key_hex,
+                                       compare_mode, threads, compare_range_rows, compare_unordered);
     } else if (strcmp(operation, "batch-test") == 0) {
         if (optind + 1 >= argc) {
             fprintf(stderr, "错误: batch-test 操作需要数据库文件参数\n");
@@ -667,6 +1109,42 @@ int main(int argc, char *argv[]) {
         const char *db_path = argv[optind + 1];
         return perform_batch_test(db_path, batch_enable, batch_pages, 
                                 batch_memory_mb, batch_test_records, verbose);
+    } else if (strcmp(operation, "replay") == 0) {
+        if (optind + 2 >= argc) {
+            fprintf(stderr, "错误: replay 操作需要跟踪文件和目标数据库参数\n");
+            print_usage(argv[0]);
+            return 1;
+        }
+
+        const char *trace_path = argv[optind + 1];
+        const char *target_db = argv[optind + 2];
+        unsigned char key[64];
+        ReplayResult replay_result;
+
+        replay_options.compress_algo = compress_algo;
+        replay_options.encrypt_algo = encrypt_algo;
+        replay_options.page_size = page_size;
+        replay_options.verbose = verbose;
+        if (encrypt_algo) {
+            if (!key_hex) {
+                fprintf(stderr, "错误: 加密重放需要指定密钥 (-k 参数)\n");
+                return 1;
+            }
+            replay_options.key_len = parse_hex_key(key_hex, key, sizeof(key));
+            if (replay_options.key_len <= 0) {
+                fprintf(stderr, "错误: 无效的密钥格式\n");
+                return 1;
+            }
+            replay_options.key = key;
+        }
+
+        rc = replay_trace(trace_path, target_db, &replay_options, &replay_result);
+        if (rc != SQLITE_OK) {
+            fprintf(stderr, "I/O重放失败，错误代码: %d\n", rc);
+            return 1;
+        }
+        print_replay_results(&replay_result, &replay_options);
+        return 0;
     } else {
         fprintf(stderr, "错误: 未知操作 '%s'\n", operation);
         print_usage(argv[0]);
@@ -679,7 +1157,8 @@ int main(int argc, char *argv[]) {
 // ============================================================================
 
 static int generate_database(int argc, char *argv[], int verbose, int gen_compress, const char *gen_encrypt_algo,
-                           const char *gen_mode, int gen_table_count, int gen_wal_mode) {
+                           const char *gen_mode, int gen_table_count, int gen_wal_mode,
+                           const char *gen_seed, int threads, int gen_split) {
     if (argc < 3) {
         fprintf(stderr, "错误: generate 操作需要输出文件和大小参数\n");
         return 1;
@@ -701,22 +1180,25 @@ static int generate_database(int argc, char *argv[], int verbose, int gen_compre
     config.table_count = gen_table_count;
     config.use_wal_mode = gen_wal_mode;
     config.verbose = verbose;
+    config.threads = threads;
+    config.split_tables = gen_split;
+
+    if (gen_seed) {
+        char *end = NULL;
+        config.seed = strtoull(gen_seed, &end, 0);
+        if (!end || *end != '\0') {
+            fprintf(stderr, "错误: 无效的随机数种子 '%s'\n", gen_seed);
+            return 1;
+        }
+    }
 
     // Set data mode
-    if (strcmp(gen_mode, "random") == 0) {
-        config.data_mode = DATA_MODE_RANDOM;
-    } else if (strcmp(gen_mode, "sequential") == 0) {
-        config.data_mode = DATA_MODE_SEQUENTIAL;
-    } else if (strcmp(gen_mode, "lorem") == 0) {
-        config.data_mode = DATA_MODE_LOREM;
-    } else if (strcmp(gen_mode, "binary") == 0) {
-        config.data_mode = DATA_MODE_BINARY;
-    } else if (strcmp(gen_mode, "mixed") == 0) {
-        config.data_mode = DATA_MODE_MIXED;
-    } else {
+    int data_mode = sqlite3_ccvfs_parse_data_mode(gen_mode);
+    if (data_mode < 0) {
         fprintf(stderr, "错误: 无效的数据模式 '%s'\n", gen_mode);
         return 1;
     }
+    config.data_mode = (DataMode)data_mode;
 
     if (verbose) {
         printf("数据库生成参数:\n");
@@ -727,6 +1209,8 @@ static int generate_database(int argc, char *argv[], int verbose, int gen_compre
         printf("  数据模式: %s\n", gen_mode);
         printf("  表数量: %d\n", config.table_count);
         printf("  WAL模式: %s\n", config.use_wal_mode ? "启用" : "禁用");
+        printf("  随机数种子: %llu\n", (unsigned long long)config.seed);
+        printf("  分表输出: %s\n", config.split_tables ? "是" : "否");
         printf("\n");
     }
 
@@ -885,7 +1369,8 @@ static int perform_batch_test(const char *db_path, int enable_batch,
 
 static int perform_database_compare(const char *db1_path, const char *db2_path, int verbose,
                                    int schema_only, int ignore_case, int ignore_whitespace, 
-                                   const char *ignore_tables, const char *key_hex) {
+                                   const char *ignore_tables, const char *key_hex, CompareMode mode,
+                                   int threads, int range_rows, int unordered_hash) {
     // Setup compare options
     CompareOptions options = {0};
     options.compare_schema_only = schema_only;
@@ -894,6 +1379,10 @@ static int perform_database_compare(const char *db1_path, const char *db2_path,
     options.verbose = verbose;
     options.ignore_tables = ignore_tables;
     options.key_hex = key_hex;  // Set encryption key
+    options.mode = mode;
+    options.threads = threads;
+    options.range_rows = range_rows;
+    options.unordered_hash = unordered_hash;
     
     // Initialize SQLite and CCVFS
     sqlite3_initialize();
@@ -972,6 +1461,8 @@ static int perform_database_compare(const char *db1_path, const char *db2_path,
         printf("  数据库2: %s\n", db2_path);
         printf("  仅比较结构: %s\n", options.compare_schema_only ? "是" : "否");
         printf("  忽略大小写: %s\n", options.ignore_case ? "是" : "否");
+        printf("  比较方式: %s\n", options.mode == COMPARE_MODE_HASH ? "区间哈希"
+                                   : options.mode == COMPARE_MODE_PAGES ? "页映像" : "逐行");
         if (options.ignore_tables) {
             printf("  忽略表: %s\n", options.ignore_tables);
         }
@@ -987,7 +1478,8 @@ static int perform_database_compare(const char *db1_path, const char *db2_path,
     if (rc == SQLITE_OK) {
         print_compare_results(&result, &options);
         // Return non-zero if databases are different
-        return (result.tables_different + result.records_different + result.schema_differences) > 0 ? 2 : 0;
+        return (result.tables_different + result.records_different + result.schema_differences +
+                result.pages_different) > 0 ? 2 : 0;
     } else {
         fprintf(stderr, "数据库比较失败，错误代码: %d\n", rc);
         return 1;
@@ -1155,7 +1647,7 @@ static int perform_decrypt_database(const char *encrypted_db, const char *output
 static int perform_compress_encrypt_database(const char *source_db, const char *target_db, 
                                            const char *compress_algo, const char *encrypt_algo,
                                            const char *key_hex, uint32_t page_size, 
-                                           int compression_level, int verbose) {
+                                           int compression_level, int threads, int verbose) {
     unsigned char key[64];
     int key_len = parse_hex_key(key_hex, key, sizeof(key));
     if (key_len <= 0) {
@@ -1181,9 +1673,8 @@ static int perform_compress_encrypt_database(const char *source_db, const char *
     }
     
     // Perform compression and encryption together
-    int rc = sqlite3_ccvfs_compress_database_with_page_size(
-        source_db, target_db, compress_algo, encrypt_algo, 
-        page_size, compression_level);
+    int rc = perform_parallel_compress(source_db, target_db, compress_algo, encrypt_algo,
+                                       key, key_len, page_size, compression_level, threads);
     
     if (rc == SQLITE_OK) {
         printf("\n数据库压缩加密成功!\n");
@@ -1200,8 +1691,227 @@ static int perform_compress_encrypt_database(const char *source_db, const char *
     }
 }
 
+// Progress line of the parallel compression
+static void print_compress_progress(void *pArg, uint32_t nDone, uint32_t nTotal) {
+    (void)pArg;
+    if (nTotal > 0) {
+        printf("\r进度: %.1f%% (%u/%u 块)", (double) nDone * 100.0 / nTotal, nDone, nTotal);
+        fflush(stdout);
+    }
+}
+
+// Compress through the parallel pipeline: N workers encode, blocks are written in order
+static int perform_parallel_compress(const char *source_db, const char *target_db,
+                                     const char *compress_algo, const char *encrypt_algo,
+                                     const unsigned char *key, int key_len, uint32_t page_size,
+                                     int compression_level, int threads) {
+    CCVFSCompressOptions options;
+    struct timespec start, end;
+
+    memset(&options, 0, sizeof(options));
+    options.compress_algorithm = compress_algo;
+    options.encrypt_algorithm = encrypt_algo;
+    options.page_size = page_size;
+    options.compression_level = compression_level;
+    options.key = key;
+    options.key_len = key_len;
+    options.threads = threads;
+    options.xProgress = print_compress_progress;
+
+    printf("正在压缩 %s -> %s ...\n", source_db, target_db);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int rc = sqlite3_ccvfs_compress_database_parallel(source_db, target_db, &options);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("\n");
+
+    if (rc == SQLITE_OK) {
+        double seconds = (double) (end.tv_sec - start.tv_sec) + (double) (end.tv_nsec - start.tv_nsec) / 1e9;
+        printf("用时: %.2f 秒\n", seconds);
+    }
+    return rc;
+}
+
+// Decompress through the direct transcoder: N workers decode, runs of blocks are written in place
+static int perform_parallel_decompress(const char *compressed_db, const char *output_db,
+                                       const unsigned char *key, int key_len, int threads, int direct_io) {
+    CCVFSDecompressOptions options;
+    struct timespec start, end;
+
+    memset(&options, 0, sizeof(options));
+    options.key = key;
+    options.key_len = key_len;
+    options.threads = threads;
+    options.direct_io = direct_io;
+    options.xProgress = print_compress_progress;
+
+    printf("正在解压 %s -> %s ...\n", compressed_db, output_db);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int rc = sqlite3_ccvfs_decompress_database_parallel(compressed_db, output_db, &options);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("\n");
+
+    if (rc == SQLITE_OK) {
+        double seconds = (double) (end.tv_sec - start.tv_sec) + (double) (end.tv_nsec - start.tv_nsec) / 1e9;
+        printf("用时: %.2f 秒\n", seconds);
+    }
+    return rc;
+}
+
+// Recompress a CCVFS file straight into another configuration, N workers decode and encode again
+static int perform_recompress(const char *source_db, const char *target_db, const char *compress_algo,
+                              const char *encrypt_algo, const unsigned char *key, int key_len,
+                              const unsigned char *new_key, int new_key_len, uint32_t page_size,
+                              int compression_level, int threads) {
+    CCVFSRecompressOptions options;
+    struct timespec start, end;
+
+    memset(&options, 0, sizeof(options));
+    options.key = key;
+    options.key_len = key_len;
+    options.compress_algorithm = compress_algo;
+    options.encrypt_algorithm = encrypt_algo;
+    options.page_size = page_size;
+    options.compression_level = compression_level;
+    options.target_key = new_key;
+    options.target_key_len = new_key_len;
+    options.threads = threads;
+    options.xProgress = print_compress_progress;
+
+    printf("正在重新压缩 %s -> %s ...\n", source_db, target_db);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int rc = sqlite3_ccvfs_recompress(source_db, target_db, &options);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("\n");
+
+    if (rc == SQLITE_OK) {
+        double seconds = (double) (end.tv_sec - start.tv_sec) + (double) (end.tv_nsec - start.tv_nsec) / 1e9;
+        printf("用时: %.2f 秒\n", seconds);
+    }
+    return rc;
+}
+
+// Hot backup through a VFS built from the header algorithms, the stored blocks are copied as they are;
+// with a base only the blocks that changed since it go into a delta
+static int perform_backup(const char *source_db, const char *backup_db, const char *base_backup,
+                          const unsigned char *key, int key_len, int compact, int verify) {
+    const CompressAlgorithm *pCompress = NULL;
+    const EncryptAlgorithm *pEncrypt = NULL;
+    CCVFSBackupOptions options;
+    CCVFSStats stats;
+    struct timespec start, end;
+    sqlite3 *db = NULL;
+
+    int rc = sqlite3_ccvfs_get_stats(source_db, &stats);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "错误: %s 不是CCVFS文件\n", source_db);
+        return rc;
+    }
+#ifdef HAVE_ZLIB
+    if (strcmp(stats.compress_algorithm, CCVFS_COMPRESS_ZLIB->name) == 0) pCompress = CCVFS_COMPRESS_ZLIB;
+#endif
+#ifdef HAVE_OPENSSL
+    if (strcmp(stats.encrypt_algorithm, CCVFS_ENCRYPT_AES128->name) == 0) pEncrypt = CCVFS_ENCRYPT_AES128;
+    if (strcmp(stats.encrypt_algorithm, CCVFS_ENCRYPT_AES256->name) == 0) pEncrypt = CCVFS_ENCRYPT_AES256;
+#endif
+    if ((stats.compress_algorithm[0] && strcmp(stats.compress_algorithm, "none") != 0 && !pCompress) ||
+        (stats.encrypt_algorithm[0] && strcmp(stats.encrypt_algorithm, "none") != 0 && !pEncrypt)) {
+        fprintf(stderr, "错误: 算法 %s/%s 不可用\n", stats.compress_algorithm, stats.encrypt_algorithm);
+        return SQLITE_ERROR;
+    }
+    if (pEncrypt && !key) {
+        fprintf(stderr, "错误: %s 使用 %s 加密，需要指定密钥 (-k 参数)\n", source_db, stats.encrypt_algorithm);
+        return SQLITE_MISUSE;
+    }
+
+    if (pEncrypt) {
+        rc = sqlite3_ccvfs_create_with_key("db_tool_backup", NULL, pCompress, pEncrypt, 0, 0, key, key_len);
+    } else {
+        rc = sqlite3_ccvfs_create("db_tool_backup", NULL, pCompress, NULL, 0, 0);
+    }
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "创建 CCVFS 失败，错误代码: %d\n", rc);
+        return rc;
+    }
+
+    memset(&options, 0, sizeof(options));
+    options.compact = compact;
+    options.verify = verify;
+    options.xProgress = print_compress_progress;
+
+    if (base_backup) {
+        printf("正在增量备份 %s (基础 %s) -> %s ...\n", source_db, base_backup, backup_db);
+    } else {
+        printf("正在备份 %s -> %s ...\n", source_db, backup_db);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    rc = sqlite3_open_v2(source_db, &db, SQLITE_OPEN_READONLY, "db_tool_backup");
+    if (rc == SQLITE_OK && base_backup) {
+        rc = sqlite3_ccvfs_backup_incremental(db, base_backup, backup_db, &options);
+    } else if (rc == SQLITE_OK) {
+        rc = sqlite3_ccvfs_backup(db, backup_db, &options);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    sqlite3_close(db);
+    sqlite3_ccvfs_destroy("db_tool_backup");
+    printf("\n");
+
+    if (rc == SQLITE_OK) {
+        double seconds = (double) (end.tv_sec - start.tv_sec) + (double) (end.tv_nsec - start.tv_nsec) / 1e9;
+        printf("用时: %.2f 秒\n", seconds);
+    }
+    return rc;
+}
+
+// Verify every stored block and the layout of a CCVFS file without SQL
+static int perform_verify(const char *path, const unsigned char *key, int key_len, int threads, int verbose) {
+    CCVFSVerifyOptions options;
+    CCVFSVerifyResult result;
+    struct timespec start, end;
+
+    memset(&options, 0, sizeof(options));
+    options.key = key;
+    options.key_len = key_len;
+    options.threads = threads;
+    options.xProgress = verbose ? print_compress_progress : NULL;
+
+    printf("正在校验 %s ...\n", path);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int rc = sqlite3_ccvfs_verify(path, &options, &result);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (verbose) printf("\n");
+    if (rc != SQLITE_OK && rc != SQLITE_CORRUPT) {
+        return rc;
+    }
+
+    double seconds = (double) (end.tv_sec - start.tv_sec) + (double) (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("文件大小:       %llu 字节\n", (unsigned long long) result.file_size);
+    printf("块大小:         %u 字节\n", result.block_size);
+    printf("块:             %u (已存储 %u, 稀疏 %u)\n", result.total_blocks, result.stored_blocks,
+           result.sparse_blocks);
+    printf("已存储数据:     %llu 字节\n", (unsigned long long) result.stored_bytes);
+    printf("校验方式:       %s\n", result.decoded ? "校验和 + 解密/解压" : "仅校验和 (未提供密钥)");
+    printf("校验和错误:     %u\n", result.checksum_errors);
+    printf("解码错误:       %u\n", result.decode_errors);
+    printf("无效索引条目:   %u\n", result.invalid_entries);
+    printf("重叠的数据块:   %u\n", result.overlapping_extents);
+    printf("未引用空间:     %llu 字节 (%u 处)\n", (unsigned long long) result.unreferenced_bytes,
+           result.unreferenced_extents);
+    if (result.corrupt_count > 0) {
+        uint32_t n = result.corrupt_count < CCVFS_VERIFY_MAX_REPORTED ? result.corrupt_count
+                                                                       : CCVFS_VERIFY_MAX_REPORTED;
+        printf("损坏的块:      ");
+        for (uint32_t i = 0; i < n; i++) {
+            printf(" %u", result.corrupt_blocks[i]);
+        }
+        printf("%s\n", result.corrupt_count > n ? " ..." : "");
+    }
+    printf("用时:           %.2f 秒 (%.1f MB/s, %d 个线程)\n", seconds,
+           seconds > 0 ? (double) result.stored_bytes / seconds / (1024.0 * 1024.0) : 0.0, result.threads);
+    return rc;
+}
+
 static int perform_decrypt_decompress_database(const char *encrypted_file, const char *output_db,
-                                              const char *key_hex, int verbose) {
+                                              const char *key_hex, int threads, int direct_io, int verbose) {
     unsigned char key[64];
     int key_len = parse_hex_key(key_hex, key, sizeof(key));
     if (key_len <= 0) {
@@ -1209,9 +1919,6 @@ static int perform_decrypt_decompress_database(const char *encrypted_file, const
         return 1;
     }
     
-    // Set decryption key for decompress VFS
-    // (Note: The decompress function will create its own VFS instance)
-    
     if (verbose) {
         printf("解密解压参数:\n");
         printf("  加密文件: %s\n", encrypted_file);
@@ -1222,8 +1929,8 @@ static int perform_decrypt_decompress_database(const char *encrypted_file, const
         printf("\n\n");
     }
     
-    // Use decompress function which will handle both decryption and decompression
-    int rc = sqlite3_ccvfs_decompress_database(encrypted_file, output_db);
+    // The transcoder takes the algorithms from the header and decrypts with this key
+    int rc = perform_parallel_decompress(encrypted_file, output_db, key, key_len, threads, direct_io);
     
     if (rc == SQLITE_OK) {
         printf("\n数据库解密解压成功!\n");
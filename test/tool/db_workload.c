@@ -0,0 +1,596 @@
+#include "db_workload.h"
+#include "sqlite3.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+
+/*
+ * Workload driver - YCSB风格的负载驱动
+ * Runs read/update/insert/scan mixes from several threads over several connections and
+ * records the latency of every operation
+ */
+
+#define WORKLOAD_LOAD_BATCH   1000
+#define WORKLOAD_ITEMS        3      // Order items per order
+#define WORKLOAD_TEXT_POOL    (64 * 1024)
+#define WORKLOAD_TEXT_SIZE    200
+#define WORKLOAD_ZIPF_THETA   0.99
+
+static const char *workload_op_names[WORKLOAD_STAT_COUNT] = {
+    "read", "update", "insert", "scan", "commit"
+};
+
+// 共享连接，事务期间由一个线程独占
+// Shared connection, owned by one thread for the length of a transaction
+typedef struct {
+    sqlite3 *db;
+    pthread_mutex_t mutex;
+} WorkloadConnection;
+
+// 所有线程共享的运行状态
+// Run state shared by all threads
+typedef struct {
+    const WorkloadConfig *config;
+    WorkloadConnection *connections;
+    const char *text_pool;      // Pre-generated text, columns are slices of it
+    double zipf_zetan;
+    double zipf_eta;
+    double zipf_alpha;
+    int begin_immediate;        // Transactions that may write take the write lock up front
+} WorkloadShared;
+
+// 每个线程的状态和延迟样本
+// Per-thread state and latency samples
+typedef struct {
+    WorkloadShared *shared;
+    int id;
+    int operations;
+    uint64_t rng;
+    uint32_t next_order;
+    uint64_t *samples[WORKLOAD_STAT_COUNT];  // Nanoseconds
+    uint64_t counts[WORKLOAD_STAT_COUNT];
+    uint64_t busy[WORKLOAD_STAT_COUNT];
+    uint64_t errors[WORKLOAD_STAT_COUNT];
+    int rc;
+} WorkloadThread;
+
+static uint64_t workload_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// xorshift64*，每个线程一个，结果只取决于种子
+// xorshift64*, one per thread, results depend on the seed only
+static uint64_t workload_rand(uint64_t *pState) {
+    uint64_t x = *pState;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *pState = x;
+    return x * 0x2545F4914F6CDD1Dull;
+}
+
+static double workload_rand_unit(uint64_t *pState) {
+    return (double)(workload_rand(pState) >> 11) / 9007199254740992.0;
+}
+
+static uint64_t workload_fnv(uint64_t value) {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (int i = 0; i < 8; i++) {
+        hash ^= value & 0xFF;
+        hash *= 0x100000001B3ull;
+        value >>= 8;
+    }
+    return hash;
+}
+
+/*
+ * 在[1, n]中选择一个键
+ * Pick a key in [1, n]
+ * 打乱的zipfian：热点键经过哈希分散到整个键空间，与YCSB相同
+ * Scrambled zipfian: hot keys are hashed across the key space, as in YCSB
+ */
+static int workload_key(WorkloadThread *pThread, int n) {
+    WorkloadShared *pShared = pThread->shared;
+
+    if (pShared->config->distribution == WORKLOAD_UNIFORM) {
+        return 1 + (int)(workload_rand(&pThread->rng) % (uint64_t)n);
+    }
+
+    double u = workload_rand_unit(&pThread->rng);
+    double uz = u * pShared->zipf_zetan;
+    uint64_t rank;
+    if (uz < 1.0) {
+        rank = 0;
+    } else if (uz < 1.0 + pow(0.5, WORKLOAD_ZIPF_THETA)) {
+        rank = 1;
+    } else {
+        rank = (uint64_t)(n * pow(pShared->zipf_eta * u - pShared->zipf_eta + 1.0, pShared->zipf_alpha));
+    }
+    return 1 + (int)(workload_fnv(rank) % (uint64_t)n);
+}
+
+static const char *workload_text(WorkloadThread *pThread, int *pLen) {
+    uint64_t offset = workload_rand(&pThread->rng) % (WORKLOAD_TEXT_POOL - WORKLOAD_TEXT_SIZE);
+    *pLen = WORKLOAD_TEXT_SIZE;
+    return pThread->shared->text_pool + offset;
+}
+
+void sqlite3_ccvfs_init_workload_config(WorkloadConfig *config) {
+    if (!config) return;
+
+    memset(config, 0, sizeof(WorkloadConfig));
+    config->records = 10000;
+    config->operations = 20000;
+    config->threads = 1;
+    config->connections = 1;
+    config->txn_size = 1;
+    config->scan_length = 100;
+    sqlite3_ccvfs_parse_workload_mix("A", config->mix);
+    config->distribution = WORKLOAD_ZIPFIAN;
+    config->data_mode = DATA_MODE_LOREM;
+    config->seed = 1;
+    config->use_wal_mode = 1;
+}
+
+int sqlite3_ccvfs_parse_workload_mix(const char *name, int mix[WORKLOAD_OP_COUNT]) {
+    // YCSB核心负载（F的读-改-写计为更新）
+    // YCSB core workloads (read-modify-write of F counts as update)
+    static const struct { char letter; int mix[WORKLOAD_OP_COUNT]; } core[] = {
+        { 'A', { 50, 50, 0, 0 } },
+        { 'B', { 95, 5, 0, 0 } },
+        { 'C', { 100, 0, 0, 0 } },
+        { 'D', { 95, 0, 5, 0 } },
+        { 'E', { 0, 0, 5, 95 } },
+        { 'F', { 50, 50, 0, 0 } }
+    };
+
+    if (!name || !*name) return -1;
+
+    if (name[1] == '\0') {
+        for (int i = 0; i < (int)(sizeof(core) / sizeof(core[0])); i++) {
+            if (name[0] == core[i].letter || name[0] == core[i].letter + ('a' - 'A')) {
+                memcpy(mix, core[i].mix, sizeof(core[i].mix));
+                return 0;
+            }
+        }
+        return -1;
+    }
+
+    int values[WORKLOAD_OP_COUNT];
+    if (sscanf(name, "%d:%d:%d:%d", &values[0], &values[1], &values[2], &values[3]) != 4) {
+        return -1;
+    }
+    int total = 0;
+    for (int i = 0; i < WORKLOAD_OP_COUNT; i++) {
+        if (values[i] < 0) return -1;
+        total += values[i];
+    }
+    if (total != 100) return -1;
+
+    memcpy(mix, values, sizeof(values));
+    return 0;
+}
+
+const char *sqlite3_ccvfs_workload_op_name(int op) {
+    if (op < 0 || op >= WORKLOAD_STAT_COUNT) return "unknown";
+    return workload_op_names[op];
+}
+
+static int workload_open(const WorkloadConfig *config, sqlite3 **pDb) {
+    int rc = sqlite3_open_v2(config->db_path, pDb,
+                             SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_FULLMUTEX,
+                             config->vfs_name);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "错误: 无法打开数据库 %s: %s\n", config->db_path, sqlite3_errmsg(*pDb));
+        sqlite3_close(*pDb);
+        *pDb = NULL;
+        return rc;
+    }
+    sqlite3_busy_timeout(*pDb, 30000);
+    if (config->use_wal_mode) {
+        rc = sqlite3_exec(*pDb, "PRAGMA journal_mode=WAL", NULL, NULL, NULL);
+    }
+    return rc;
+}
+
+int sqlite3_ccvfs_workload_load(const WorkloadConfig *config) {
+    static const char *tables[] = { "users", "products", "orders", "order_items" };
+    GeneratorConfig row_config;
+    sqlite3 *db = NULL;
+    int rc;
+
+    if (!config || !config->db_path || config->records <= 0) return SQLITE_MISUSE;
+
+    rc = workload_open(config, &db);
+    if (rc != SQLITE_OK) return rc;
+
+    for (int i = 0; rc == SQLITE_OK && i < (int)(sizeof(tables) / sizeof(tables[0])); i++) {
+        rc = sqlite3_ccvfs_generator_create_table(db, tables[i]);
+    }
+
+    // 行内容与db_generator相同，种子固定时可重现
+    // Rows are the db_generator ones, reproducible for a fixed seed
+    sqlite3_ccvfs_init_generator_config(&row_config);
+    row_config.data_mode = config->data_mode;
+    row_config.seed = config->seed;
+
+    for (int i = 0; rc == SQLITE_OK && i < (int)(sizeof(tables) / sizeof(tables[0])); i++) {
+        int rows = config->records * (strcmp(tables[i], "order_items") == 0 ? WORKLOAD_ITEMS : 1);
+        for (int first = 0; rc == SQLITE_OK && first < rows; first += WORKLOAD_LOAD_BATCH) {
+            rc = sqlite3_exec(db, "BEGIN", NULL, NULL, NULL);
+            for (int id = first + 1; rc == SQLITE_OK && id <= first + WORKLOAD_LOAD_BATCH && id <= rows; id++) {
+                rc = sqlite3_ccvfs_generator_insert_row(db, tables[i], &row_config, id);
+            }
+            if (rc == SQLITE_OK) {
+                rc = sqlite3_exec(db, "COMMIT", NULL, NULL, NULL);
+            } else {
+                sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
+            }
+        }
+    }
+
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "错误: 加载数据失败: %s\n", sqlite3_errmsg(db));
+    }
+    sqlite3_close(db);
+    return rc;
+}
+
+// 每个线程在其连接上的预编译语句
+// Prepared statements of one thread on its connection
+typedef struct {
+    sqlite3_stmt *read;
+    sqlite3_stmt *update;
+    sqlite3_stmt *insert_order;
+    sqlite3_stmt *insert_item;
+    sqlite3_stmt *scan;
+} WorkloadStatements;
+
+static int workload_prepare(sqlite3 *db, WorkloadStatements *pStmts) {
+    int rc;
+
+    memset(pStmts, 0, sizeof(*pStmts));
+    rc = sqlite3_prepare_v2(db, "SELECT * FROM users WHERE user_id = ?", -1, &pStmts->read, NULL);
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_prepare_v2(db,
+            "UPDATE users SET profile_data = ?, updated_at = CURRENT_TIMESTAMP WHERE user_id = ?",
+            -1, &pStmts->update, NULL);
+    }
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_prepare_v2(db,
+            "INSERT INTO orders (user_id, order_number, status, total_amount, payment_method, "
+            "shipping_address, notes) VALUES (?, ?, 'pending', ?, 'credit_card', ?, ?)",
+            -1, &pStmts->insert_order, NULL);
+    }
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_prepare_v2(db,
+            "INSERT INTO order_items (order_id, product_id, quantity, unit_price, total_price) "
+            "VALUES (?, ?, ?, ?, ?)", -1, &pStmts->insert_item, NULL);
+    }
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_prepare_v2(db,
+            "SELECT order_id, user_id, total_amount, notes FROM orders "
+            "WHERE order_id >= ? ORDER BY order_id LIMIT ?", -1, &pStmts->scan, NULL);
+    }
+    return rc;
+}
+
+static void workload_finalize(WorkloadStatements *pStmts) {
+    sqlite3_finalize(pStmts->read);
+    sqlite3_finalize(pStmts->update);
+    sqlite3_finalize(pStmts->insert_order);
+    sqlite3_finalize(pStmts->insert_item);
+    sqlite3_finalize(pStmts->scan);
+}
+
+static int workload_step_all(sqlite3_stmt *pStmt) {
+    int rc;
+    while ((rc = sqlite3_step(pStmt)) == SQLITE_ROW) {
+        // 读取所有列，确保数据真正被解码
+        // Fetch every column so the data is really decoded
+        for (int i = 0; i < sqlite3_column_count(pStmt); i++) {
+            (void)sqlite3_column_bytes(pStmt, i);
+        }
+    }
+    sqlite3_reset(pStmt);
+    return rc == SQLITE_DONE ? SQLITE_OK : rc;
+}
+
+static int workload_execute(WorkloadThread *pThread, sqlite3 *db, WorkloadStatements *pStmts, int op) {
+    const WorkloadConfig *config = pThread->shared->config;
+    const char *zText;
+    int nText;
+    int rc;
+
+    switch (op) {
+        case WORKLOAD_READ:
+            sqlite3_bind_int(pStmts->read, 1, workload_key(pThread, config->records));
+            return workload_step_all(pStmts->read);
+
+        case WORKLOAD_UPDATE:
+            zText = workload_text(pThread, &nText);
+            sqlite3_bind_text(pStmts->update, 1, zText, nText, SQLITE_STATIC);
+            sqlite3_bind_int(pStmts->update, 2, workload_key(pThread, config->records));
+            return workload_step_all(pStmts->update);
+
+        case WORKLOAD_INSERT: {
+            char order_number[48];
+            snprintf(order_number, sizeof(order_number), "WL-%d-%u", pThread->id, ++pThread->next_order);
+            zText = workload_text(pThread, &nText);
+            sqlite3_bind_int(pStmts->insert_order, 1, workload_key(pThread, config->records));
+            sqlite3_bind_text(pStmts->insert_order, 2, order_number, -1, SQLITE_TRANSIENT);
+            sqlite3_bind_double(pStmts->insert_order, 3, (double)(workload_rand(&pThread->rng) % 100000) / 100.0);
+            sqlite3_bind_text(pStmts->insert_order, 4, zText, nText / 2, SQLITE_STATIC);
+            sqlite3_bind_text(pStmts->insert_order, 5, zText + nText / 2, nText / 2, SQLITE_STATIC);
+            rc = workload_step_all(pStmts->insert_order);
+
+            sqlite3_int64 order_id = sqlite3_last_insert_rowid(db);
+            for (int i = 0; rc == SQLITE_OK && i < WORKLOAD_ITEMS; i++) {
+                int quantity = 1 + (int)(workload_rand(&pThread->rng) % 10);
+                double unit_price = (double)(workload_rand(&pThread->rng) % 10000) / 100.0;
+                sqlite3_bind_int64(pStmts->insert_item, 1, order_id);
+                sqlite3_bind_int(pStmts->insert_item, 2, workload_key(pThread, config->records));
+                sqlite3_bind_int(pStmts->insert_item, 3, quantity);
+                sqlite3_bind_double(pStmts->insert_item, 4, unit_price);
+                sqlite3_bind_double(pStmts->insert_item, 5, unit_price * quantity);
+                rc = workload_step_all(pStmts->insert_item);
+            }
+            return rc;
+        }
+
+        case WORKLOAD_SCAN:
+            sqlite3_bind_int(pStmts->scan, 1, workload_key(pThread, config->records));
+            sqlite3_bind_int(pStmts->scan, 2, 1 + (int)(workload_rand(&pThread->rng) % (uint64_t)config->scan_length));
+            return workload_step_all(pStmts->scan);
+    }
+    return SQLITE_MISUSE;
+}
+
+static int workload_pick(WorkloadThread *pThread) {
+    int roll = (int)(workload_rand(&pThread->rng) % 100);
+    const int *mix = pThread->shared->config->mix;
+
+    for (int op = 0; op < WORKLOAD_OP_COUNT; op++) {
+        if (roll < mix[op]) return op;
+        roll -= mix[op];
+    }
+    return WORKLOAD_READ;
+}
+
+// 锁竞争（BUSY/LOCKED）是负载的正常结果，其他错误说明运行结果不可信
+// Lock contention (BUSY/LOCKED) is a normal outcome of the load, any other error means the run
+// cannot be trusted
+static void workload_record(WorkloadThread *pThread, int op, uint64_t ns, int rc) {
+    if ((rc & 0xff) == SQLITE_BUSY || (rc & 0xff) == SQLITE_LOCKED) {
+        pThread->busy[op]++;
+        return;
+    }
+    if (rc != SQLITE_OK) {
+        pThread->errors[op]++;
+        return;
+    }
+    pThread->samples[op][pThread->counts[op]++] = ns;
+}
+
+static void *workload_thread_main(void *pArg) {
+    WorkloadThread *pThread = (WorkloadThread*)pArg;
+    WorkloadShared *pShared = pThread->shared;
+    const WorkloadConfig *config = pShared->config;
+    WorkloadConnection *pConn = &pShared->connections[pThread->id % config->connections];
+    WorkloadStatements stmts;
+    int done = 0;
+
+    pthread_mutex_lock(&pConn->mutex);
+    pThread->rc = workload_prepare(pConn->db, &stmts);
+    pthread_mutex_unlock(&pConn->mutex);
+    if (pThread->rc != SQLITE_OK) {
+        workload_finalize(&stmts);
+        return NULL;
+    }
+
+    while (done < pThread->operations) {
+        int batch = config->txn_size;
+        if (batch > pThread->operations - done) batch = pThread->operations - done;
+
+        pthread_mutex_lock(&pConn->mutex);
+        int rc = SQLITE_OK;
+        if (config->txn_size > 1) {
+            rc = sqlite3_exec(pConn->db, pShared->begin_immediate ? "BEGIN IMMEDIATE" : "BEGIN", NULL, NULL, NULL);
+        }
+        for (int i = 0; i < batch; i++) {
+            int op = workload_pick(pThread);
+            uint64_t tStart = workload_now_ns();
+            if (rc == SQLITE_OK) {
+                rc = workload_execute(pThread, pConn->db, &stmts, op);
+            }
+            workload_record(pThread, op, workload_now_ns() - tStart, rc);
+        }
+        if (config->txn_size > 1) {
+            if (rc == SQLITE_OK) {
+                uint64_t tStart = workload_now_ns();
+                rc = sqlite3_exec(pConn->db, "COMMIT", NULL, NULL, NULL);
+                workload_record(pThread, WORKLOAD_COMMIT, workload_now_ns() - tStart, rc);
+            }
+            if (rc != SQLITE_OK && !sqlite3_get_autocommit(pConn->db)) {
+                sqlite3_exec(pConn->db, "ROLLBACK", NULL, NULL, NULL);
+            }
+        }
+        pthread_mutex_unlock(&pConn->mutex);
+        done += batch;
+    }
+
+    pthread_mutex_lock(&pConn->mutex);
+    workload_finalize(&stmts);
+    pthread_mutex_unlock(&pConn->mutex);
+    return NULL;
+}
+
+static int workload_compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+// 最近秩百分位数
+// Nearest-rank percentile
+static double workload_percentile(const uint64_t *aSorted, uint64_t n, double p) {
+    uint64_t rank = (uint64_t)ceil(p * (double)n);
+    if (rank < 1) rank = 1;
+    if (rank > n) rank = n;
+    return (double)aSorted[rank - 1] / 1000.0;
+}
+
+static void workload_summarize(WorkloadThread *aThread, int nThread, int op, WorkloadLatency *pLatency) {
+    uint64_t n = 0;
+    uint64_t total = 0;
+
+    memset(pLatency, 0, sizeof(*pLatency));
+    for (int t = 0; t < nThread; t++) {
+        n += aThread[t].counts[op];
+        pLatency->busy += aThread[t].busy[op];
+        pLatency->errors += aThread[t].errors[op];
+    }
+    pLatency->count = n;
+    if (n == 0) return;
+
+    uint64_t *aAll = malloc(n * sizeof(uint64_t));
+    if (!aAll) return;
+    uint64_t pos = 0;
+    for (int t = 0; t < nThread; t++) {
+        memcpy(aAll + pos, aThread[t].samples[op], aThread[t].counts[op] * sizeof(uint64_t));
+        pos += aThread[t].counts[op];
+    }
+    qsort(aAll, n, sizeof(uint64_t), workload_compare_u64);
+    for (uint64_t i = 0; i < n; i++) total += aAll[i];
+
+    pLatency->mean_us = (double)total / (double)n / 1000.0;
+    pLatency->p50_us = workload_percentile(aAll, n, 0.50);
+    pLatency->p99_us = workload_percentile(aAll, n, 0.99);
+    pLatency->p999_us = workload_percentile(aAll, n, 0.999);
+    pLatency->max_us = (double)aAll[n - 1] / 1000.0;
+    free(aAll);
+}
+
+int sqlite3_ccvfs_workload_run(const WorkloadConfig *config, WorkloadResult *result) {
+    WorkloadShared shared;
+    WorkloadThread *aThread = NULL;
+    pthread_t *aHandle = NULL;
+    char *zPool = NULL;
+    int nConn;
+    int rc = SQLITE_OK;
+
+    if (!config || !result || config->threads <= 0 || config->operations <= 0 ||
+        config->txn_size <= 0 || config->scan_length <= 0) {
+        return SQLITE_MISUSE;
+    }
+    memset(result, 0, sizeof(*result));
+    memset(&shared, 0, sizeof(shared));
+
+    nConn = config->connections;
+    if (nConn <= 0 || nConn > config->threads) nConn = config->threads;
+    WorkloadConfig run_config = *config;
+    run_config.connections = nConn;
+    shared.config = &run_config;
+    shared.begin_immediate = (config->mix[WORKLOAD_UPDATE] + config->mix[WORKLOAD_INSERT]) > 0;
+
+    // 文本列取自一块预生成的数据，生成器本身不是线程安全的
+    // Text columns are slices of one pre-generated block, the generator itself is not thread-safe
+    zPool = malloc(WORKLOAD_TEXT_POOL);
+    shared.connections = calloc(nConn, sizeof(WorkloadConnection));
+    aThread = calloc(config->threads, sizeof(WorkloadThread));
+    aHandle = calloc(config->threads, sizeof(pthread_t));
+    if (!zPool || !shared.connections || !aThread || !aHandle) {
+        rc = SQLITE_NOMEM;
+        goto run_done;
+    }
+    sqlite3_ccvfs_fill_data((unsigned char*)zPool, WORKLOAD_TEXT_POOL, config->data_mode, WORKLOAD_TEXT_SIZE, 0);
+    for (int i = 0; i < WORKLOAD_TEXT_POOL; i++) {
+        if (zPool[i] == '\0') zPool[i] = ' ';
+    }
+    shared.text_pool = zPool;
+
+    if (config->distribution == WORKLOAD_ZIPFIAN) {
+        double zeta2 = 1.0 + pow(0.5, WORKLOAD_ZIPF_THETA);
+        for (int i = 1; i <= config->records; i++) {
+            shared.zipf_zetan += 1.0 / pow((double)i, WORKLOAD_ZIPF_THETA);
+        }
+        shared.zipf_alpha = 1.0 / (1.0 - WORKLOAD_ZIPF_THETA);
+        shared.zipf_eta = (1.0 - pow(2.0 / config->records, 1.0 - WORKLOAD_ZIPF_THETA)) /
+                          (1.0 - zeta2 / shared.zipf_zetan);
+    }
+
+    for (int i = 0; i < nConn; i++) {
+        pthread_mutex_init(&shared.connections[i].mutex, NULL);
+        if (rc == SQLITE_OK) rc = workload_open(config, &shared.connections[i].db);
+    }
+    if (rc != SQLITE_OK) goto run_done;
+
+    for (int t = 0; t < config->threads; t++) {
+        WorkloadThread *pThread = &aThread[t];
+        uint64_t capacity;
+
+        pThread->shared = &shared;
+        pThread->id = t;
+        pThread->operations = config->operations / config->threads +
+                              (t < config->operations % config->threads ? 1 : 0);
+        pThread->rng = workload_fnv(((uint64_t)config->seed << 16) ^ (uint64_t)(t + 1)) | 1;
+        for (int op = 0; op < WORKLOAD_STAT_COUNT; op++) {
+            capacity = op == WORKLOAD_COMMIT ? (uint64_t)pThread->operations / config->txn_size + 1
+                                             : (uint64_t)pThread->operations;
+            pThread->samples[op] = malloc((capacity ? capacity : 1) * sizeof(uint64_t));
+            if (!pThread->samples[op]) rc = SQLITE_NOMEM;
+        }
+    }
+    if (rc != SQLITE_OK) goto run_done;
+
+    uint64_t tStart = workload_now_ns();
+    int started = 0;
+    for (; started < config->threads; started++) {
+        if (pthread_create(&aHandle[started], NULL, workload_thread_main, &aThread[started]) != 0) {
+            rc = SQLITE_ERROR;
+            break;
+        }
+    }
+    for (int t = 0; t < started; t++) {
+        pthread_join(aHandle[t], NULL);
+    }
+    result->seconds = (double)(workload_now_ns() - tStart) / 1e9;
+
+    for (int t = 0; t < started; t++) {
+        if (aThread[t].rc != SQLITE_OK && rc == SQLITE_OK) rc = aThread[t].rc;
+    }
+    for (int op = 0; op < WORKLOAD_STAT_COUNT; op++) {
+        workload_summarize(aThread, started, op, &result->latency[op]);
+        if (op != WORKLOAD_COMMIT) {
+            result->operations += result->latency[op].count;
+        }
+        result->busy += result->latency[op].busy;
+        result->errors += result->latency[op].errors;
+    }
+    result->ops_per_sec = result->seconds > 0 ? (double)result->operations / result->seconds : 0;
+
+run_done:
+    if (shared.connections) {
+        for (int i = 0; i < nConn; i++) {
+            sqlite3_close(shared.connections[i].db);
+            pthread_mutex_destroy(&shared.connections[i].mutex);
+        }
+        free(shared.connections);
+    }
+    if (aThread) {
+        for (int t = 0; t < config->threads; t++) {
+            for (int op = 0; op < WORKLOAD_STAT_COUNT; op++) {
+                free(aThread[t].samples[op]);
+            }
+        }
+        free(aThread);
+    }
+    free(aHandle);
+    free(zPool);
+    return rc;
+}
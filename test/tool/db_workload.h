@@ -0,0 +1,97 @@
+#ifndef DB_WORKLOAD_H
+#define DB_WORKLOAD_H
+
+#include "ccvfs.h"
+#include "db_generator.h"
+#include <stdint.h>
+
+/*
+ * Workload driver - YCSB-style operation mixes on the db_generator schemas
+ * Operations run on the users, products, orders and order_items tables:
+ *   read   - point query of one user by primary key
+ *   update - rewrite the profile of one user
+ *   insert - one order with its order items
+ *   scan   - range query of orders by primary key
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Operations of a mix, followed by the commit of multi-operation transactions
+typedef enum {
+    WORKLOAD_READ,
+    WORKLOAD_UPDATE,
+    WORKLOAD_INSERT,
+    WORKLOAD_SCAN,
+    WORKLOAD_COMMIT
+} WorkloadOp;
+
+#define WORKLOAD_OP_COUNT    4  // Operations chosen by the mix
+#define WORKLOAD_STAT_COUNT  5  // Operations plus commit
+
+// Key distributions
+typedef enum {
+    WORKLOAD_UNIFORM,
+    WORKLOAD_ZIPFIAN           // Scrambled zipfian (theta 0.99), as in YCSB
+} WorkloadDistribution;
+
+// Configuration structure
+typedef struct {
+    const char *db_path;
+    const char *vfs_name;       // VFS used to open the database, NULL for the default VFS
+    int records;                // Users, products and orders loaded before the run
+    int operations;             // Operations over all threads
+    int threads;                // Worker threads
+    int connections;            // Connections shared round-robin by the threads
+    int txn_size;               // Operations per transaction, 1 for autocommit
+    int scan_length;            // Longest range scan in rows
+    int mix[WORKLOAD_OP_COUNT]; // Percentage of each operation, sums to 100
+    WorkloadDistribution distribution;
+    DataMode data_mode;         // Data of generated text columns
+    unsigned int seed;
+    int use_wal_mode;
+} WorkloadConfig;
+
+// Latency summary of one operation type, in microseconds
+typedef struct {
+    uint64_t count;
+    uint64_t busy;              // Operations that gave up on SQLITE_BUSY/SQLITE_LOCKED
+    uint64_t errors;            // Operations that failed with any other error
+    double mean_us;
+    double p50_us;
+    double p99_us;
+    double p999_us;
+    double max_us;
+} WorkloadLatency;
+
+// Result of one run
+typedef struct {
+    double seconds;
+    uint64_t operations;
+    uint64_t busy;
+    uint64_t errors;            // Non-zero means the run is not a valid measurement
+    double ops_per_sec;
+    WorkloadLatency latency[WORKLOAD_STAT_COUNT];
+} WorkloadResult;
+
+// Initialize configuration with default values (workload A, 1 thread, 1 connection)
+void sqlite3_ccvfs_init_workload_config(WorkloadConfig *config);
+
+// Parse a mix: YCSB core workload letter A-F, or "read:update:insert:scan" percentages
+int sqlite3_ccvfs_parse_workload_mix(const char *name, int mix[WORKLOAD_OP_COUNT]);
+
+// Get operation name
+const char *sqlite3_ccvfs_workload_op_name(int op);
+
+// Create the schema and load the initial records
+int sqlite3_ccvfs_workload_load(const WorkloadConfig *config);
+
+// Run the operation mix against a loaded database
+int sqlite3_ccvfs_workload_run(const WorkloadConfig *config, WorkloadResult *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DB_WORKLOAD_H */
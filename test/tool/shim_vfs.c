@@ -0,0 +1,470 @@
+#include "shim_vfs.h"
+#include "ccvfs_sync.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Shim VFS - 透传到底层VFS并统计调用次数和字节数，按配置加入延迟和故障
+ * Pass-through to the root VFS, counting calls and bytes, adding latency and faults as configured
+ */
+
+struct ShimVfs {
+    sqlite3_vfs base;
+    sqlite3_vfs *pRoot;
+    ShimVfsStats stats;
+    sqlite3_mutex *mutex;       // Protects config, rng and busy_until
+    ShimVfsConfig config;
+    uint32_t active;            // Non-zero when the config adds latency or faults
+    uint64_t rng;
+    double busy_until;          // Monotonic time at which the device channel is free again
+    char zName[64];
+};
+
+typedef struct {
+    sqlite3_file base;
+    ShimVfs *pShim;
+    int flags;            // Open flags, matched against ShimVfsConfig.file_types
+    sqlite3_file *pReal;  // Root VFS file, allocated right after this structure
+} ShimFile;
+
+#define SHIM_REAL(pFile) (((ShimFile*)(pFile))->pReal)
+#define SHIM_STATS(pFile) (((ShimFile*)(pFile))->pShim->stats)
+
+#define SHIM_PPM 1000000u
+
+typedef enum {
+    SHIM_IO_READ,
+    SHIM_IO_WRITE,
+    SHIM_IO_SYNC
+} ShimIoKind;
+
+static double shim_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// xorshift64*，调用者持有mutex
+// xorshift64*, the caller holds the mutex
+static uint64_t shim_rand(ShimVfs *pShim) {
+    uint64_t x = pShim->rng;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    pShim->rng = x;
+    return x * 0x2545F4914F6CDD1Dull;
+}
+
+static int shim_draw(ShimVfs *pShim, uint32_t ppm) {
+    return ppm > 0 && (uint32_t)(shim_rand(pShim) % SHIM_PPM) < ppm;
+}
+
+/*
+ * 按存储模型计算一次读、写或同步的延迟并抽取故障，返回SQLITE_OK或要注入的错误码
+ * Apply the storage model to one read, write or sync: sleep for its latency and draw its fault,
+ * returns SQLITE_OK or the error code to inject
+ * 带宽模拟单个设备通道：传输按到达顺序排队，等待时间计入延迟
+ * The bandwidth models one device channel: transfers queue in arrival order and the wait
+ * counts as latency
+ * 注入短读时*pShortAmt为实际读取的字节数
+ * For an injected short read *pShortAmt is the number of bytes actually read
+ */
+static int shim_inject(ShimFile *p, ShimIoKind kind, int iAmt, int *pShortAmt) {
+    ShimVfs *pShim = p->pShim;
+    const ShimVfsConfig *pConfig = &pShim->config;
+    uint64_t delayUs = 0;
+    int rc = SQLITE_OK;
+
+    if (!CCVFS_COUNTER_GET(pShim->active)) return SQLITE_OK;
+
+    sqlite3_mutex_enter(pShim->mutex);
+    if (pConfig->file_types && !(p->flags & pConfig->file_types)) {
+        sqlite3_mutex_leave(pShim->mutex);
+        return SQLITE_OK;
+    }
+
+    switch (kind) {
+        case SHIM_IO_READ:
+            delayUs = pConfig->read_latency_us;
+            if (shim_draw(pShim, pConfig->read_error_ppm)) {
+                rc = SQLITE_IOERR_READ;
+            } else if (iAmt > 0 && shim_draw(pShim, pConfig->short_read_ppm)) {
+                *pShortAmt = (int)(shim_rand(pShim) % (uint64_t)iAmt);
+                rc = SQLITE_IOERR_SHORT_READ;
+            }
+            break;
+        case SHIM_IO_WRITE:
+            delayUs = pConfig->write_latency_us;
+            if (shim_draw(pShim, pConfig->write_error_ppm)) rc = SQLITE_IOERR_WRITE;
+            break;
+        case SHIM_IO_SYNC:
+            delayUs = pConfig->sync_latency_us;
+            if (shim_draw(pShim, pConfig->sync_error_ppm)) rc = SQLITE_IOERR_FSYNC;
+            break;
+    }
+    if (pConfig->jitter_us) {
+        delayUs += shim_rand(pShim) % ((uint64_t)pConfig->jitter_us + 1);
+    }
+    if (pConfig->bandwidth && iAmt > 0) {
+        double now = shim_now();
+        double start = pShim->busy_until > now ? pShim->busy_until : now;
+        pShim->busy_until = start + (double)iAmt / (double)pConfig->bandwidth;
+        delayUs += (uint64_t)((pShim->busy_until - now) * 1e6);
+    }
+    sqlite3_mutex_leave(pShim->mutex);
+
+    if (delayUs > 0) {
+        CCVFS_COUNTER_ADD(pShim->stats.injected_delay_us, delayUs);
+        pShim->pRoot->xSleep(pShim->pRoot, delayUs > 0x7FFFFFFF ? 0x7FFFFFFF : (int)delayUs);
+    }
+    if (rc == SQLITE_IOERR_SHORT_READ) {
+        CCVFS_COUNTER_INC(pShim->stats.short_reads);
+    } else if (rc != SQLITE_OK) {
+        CCVFS_COUNTER_INC(pShim->stats.injected_errors);
+    }
+    return rc;
+}
+
+/*
+ * 文件方法
+ * File methods
+ */
+static int shimClose(sqlite3_file *pFile) {
+    sqlite3_file *pReal = SHIM_REAL(pFile);
+    CCVFS_COUNTER_INC(SHIM_STATS(pFile).close_calls);
+    return pReal->pMethods ? pReal->pMethods->xClose(pReal) : SQLITE_OK;
+}
+
+static int shimRead(sqlite3_file *pFile, void *zBuf, int iAmt, sqlite3_int64 iOfst) {
+    int nShort = 0;
+    int rc;
+
+    CCVFS_COUNTER_INC(SHIM_STATS(pFile).read_calls);
+    CCVFS_COUNTER_ADD(SHIM_STATS(pFile).read_bytes, (uint64_t)iAmt);
+    rc = shim_inject((ShimFile*)pFile, SHIM_IO_READ, iAmt, &nShort);
+    if (rc == SQLITE_IOERR_SHORT_READ) {
+        // 短读只返回前nShort字节，其余按xRead的约定补零
+        // A short read returns only the first nShort bytes, the rest is zero-filled as xRead requires
+        if (nShort > 0) {
+            int rcReal = SHIM_REAL(pFile)->pMethods->xRead(SHIM_REAL(pFile), zBuf, nShort, iOfst);
+            if (rcReal != SQLITE_OK && rcReal != SQLITE_IOERR_SHORT_READ) return rcReal;
+        }
+        memset((char*)zBuf + nShort, 0, (size_t)(iAmt - nShort));
+        return rc;
+    }
+    if (rc != SQLITE_OK) return rc;
+    return SHIM_REAL(pFile)->pMethods->xRead(SHIM_REAL(pFile), zBuf, iAmt, iOfst);
+}
+
+static int shimWrite(sqlite3_file *pFile, const void *zBuf, int iAmt, sqlite3_int64 iOfst) {
+    int rc;
+
+    CCVFS_COUNTER_INC(SHIM_STATS(pFile).write_calls);
+    CCVFS_COUNTER_ADD(SHIM_STATS(pFile).write_bytes, (uint64_t)iAmt);
+    rc = shim_inject((ShimFile*)pFile, SHIM_IO_WRITE, iAmt, NULL);
+    if (rc != SQLITE_OK) return rc;
+    return SHIM_REAL(pFile)->pMethods->xWrite(SHIM_REAL(pFile), zBuf, iAmt, iOfst);
+}
+
+static int shimTruncate(sqlite3_file *pFile, sqlite3_int64 size) {
+    CCVFS_COUNTER_INC(SHIM_STATS(pFile).truncate_calls);
+    return SHIM_REAL(pFile)->pMethods->xTruncate(SHIM_REAL(pFile), size);
+}
+
+static int shimSync(sqlite3_file *pFile, int flags) {
+    int rc;
+
+    CCVFS_COUNTER_INC(SHIM_STATS(pFile).sync_calls);
+    rc = shim_inject((ShimFile*)pFile, SHIM_IO_SYNC, 0, NULL);
+    if (rc != SQLITE_OK) return rc;
+    return SHIM_REAL(pFile)->pMethods->xSync(SHIM_REAL(pFile), flags);
+}
+
+static int shimFileSize(sqlite3_file *pFile, sqlite3_int64 *pSize) {
+    CCVFS_COUNTER_INC(SHIM_STATS(pFile).file_size_calls);
+    return SHIM_REAL(pFile)->pMethods->xFileSize(SHIM_REAL(pFile), pSize);
+}
+
+static int shimLock(sqlite3_file *pFile, int eLock) {
+    CCVFS_COUNTER_INC(SHIM_STATS(pFile).lock_calls);
+    return SHIM_REAL(pFile)->pMethods->xLock(SHIM_REAL(pFile), eLock);
+}
+
+static int shimUnlock(sqlite3_file *pFile, int eLock) {
+    CCVFS_COUNTER_INC(SHIM_STATS(pFile).unlock_calls);
+    return SHIM_REAL(pFile)->pMethods->xUnlock(SHIM_REAL(pFile), eLock);
+}
+
+static int shimCheckReservedLock(sqlite3_file *pFile, int *pResOut) {
+    return SHIM_REAL(pFile)->pMethods->xCheckReservedLock(SHIM_REAL(pFile), pResOut);
+}
+
+static int shimFileControl(sqlite3_file *pFile, int op, void *pArg) {
+    return SHIM_REAL(pFile)->pMethods->xFileControl(SHIM_REAL(pFile), op, pArg);
+}
+
+static int shimSectorSize(sqlite3_file *pFile) {
+    return SHIM_REAL(pFile)->pMethods->xSectorSize(SHIM_REAL(pFile));
+}
+
+static int shimDeviceCharacteristics(sqlite3_file *pFile) {
+    return SHIM_REAL(pFile)->pMethods->xDeviceCharacteristics(SHIM_REAL(pFile));
+}
+
+static int shimShmMap(sqlite3_file *pFile, int iPg, int pgsz, int bExtend, void volatile **pp) {
+    sqlite3_file *pReal = SHIM_REAL(pFile);
+    if (pReal->pMethods->iVersion < 2 || !pReal->pMethods->xShmMap) return SQLITE_IOERR_SHMMAP;
+    return pReal->pMethods->xShmMap(pReal, iPg, pgsz, bExtend, pp);
+}
+
+static int shimShmLock(sqlite3_file *pFile, int offset, int n, int flags) {
+    sqlite3_file *pReal = SHIM_REAL(pFile);
+    if (pReal->pMethods->iVersion < 2 || !pReal->pMethods->xShmLock) return SQLITE_IOERR_SHMLOCK;
+    return pReal->pMethods->xShmLock(pReal, offset, n, flags);
+}
+
+static void shimShmBarrier(sqlite3_file *pFile) {
+    sqlite3_file *pReal = SHIM_REAL(pFile);
+    if (pReal->pMethods->iVersion >= 2 && pReal->pMethods->xShmBarrier) {
+        pReal->pMethods->xShmBarrier(pReal);
+    }
+}
+
+static int shimShmUnmap(sqlite3_file *pFile, int deleteFlag) {
+    sqlite3_file *pReal = SHIM_REAL(pFile);
+    if (pReal->pMethods->iVersion < 2 || !pReal->pMethods->xShmUnmap) return SQLITE_OK;
+    return pReal->pMethods->xShmUnmap(pReal, deleteFlag);
+}
+
+static int shimFetch(sqlite3_file *pFile, sqlite3_int64 iOfst, int iAmt, void **pp) {
+    sqlite3_file *pReal = SHIM_REAL(pFile);
+    *pp = NULL;
+    if (pReal->pMethods->iVersion < 3 || !pReal->pMethods->xFetch) return SQLITE_OK;
+    return pReal->pMethods->xFetch(pReal, iOfst, iAmt, pp);
+}
+
+static int shimUnfetch(sqlite3_file *pFile, sqlite3_int64 iOfst, void *p) {
+    sqlite3_file *pReal = SHIM_REAL(pFile);
+    if (pReal->pMethods->iVersion < 3 || !pReal->pMethods->xUnfetch) return SQLITE_OK;
+    return pReal->pMethods->xUnfetch(pReal, iOfst, p);
+}
+
+static const sqlite3_io_methods shimIoMethods = {
+    3,                          /* iVersion */
+    shimClose,                  /* xClose */
+    shimRead,                   /* xRead */
+    shimWrite,                  /* xWrite */
+    shimTruncate,               /* xTruncate */
+    shimSync,                   /* xSync */
+    shimFileSize,               /* xFileSize */
+    shimLock,                   /* xLock */
+    shimUnlock,                 /* xUnlock */
+    shimCheckReservedLock,      /* xCheckReservedLock */
+    shimFileControl,            /* xFileControl */
+    shimSectorSize,             /* xSectorSize */
+    shimDeviceCharacteristics,  /* xDeviceCharacteristics */
+    shimShmMap,                 /* xShmMap */
+    shimShmLock,                /* xShmLock */
+    shimShmBarrier,             /* xShmBarrier */
+    shimShmUnmap,               /* xShmUnmap */
+    shimFetch,                  /* xFetch */
+    shimUnfetch                 /* xUnfetch */
+};
+
+/*
+ * VFS方法，除xOpen外全部直接转发
+ * VFS methods, all forwarded as is except xOpen
+ */
+#define SHIM_ROOT(pVfs) (((ShimVfs*)(pVfs))->pRoot)
+
+static int shimOpen(sqlite3_vfs *pVfs, sqlite3_filename zName, sqlite3_file *pFile, int flags, int *pOutFlags) {
+    ShimVfs *pShim = (ShimVfs*)pVfs;
+    ShimFile *p = (ShimFile*)pFile;
+    int rc;
+
+    memset(p, 0, sizeof(ShimFile));
+    p->pShim = pShim;
+    p->flags = flags;
+    p->pReal = (sqlite3_file*)&p[1];
+    CCVFS_COUNTER_INC(pShim->stats.open_calls);
+
+    rc = pShim->pRoot->xOpen(pShim->pRoot, zName, p->pReal, flags, pOutFlags);
+    // 底层打开失败时不设置方法，SQLite不会再调用xClose
+    // Methods stay unset when the root open fails, so SQLite does not call xClose
+    if (rc == SQLITE_OK) {
+        p->base.pMethods = &shimIoMethods;
+    }
+    return rc;
+}
+
+static int shimDelete(sqlite3_vfs *pVfs, const char *zName, int syncDir) {
+    CCVFS_COUNTER_INC(((ShimVfs*)pVfs)->stats.delete_calls);
+    return SHIM_ROOT(pVfs)->xDelete(SHIM_ROOT(pVfs), zName, syncDir);
+}
+
+static int shimAccess(sqlite3_vfs *pVfs, const char *zName, int flags, int *pResOut) {
+    CCVFS_COUNTER_INC(((ShimVfs*)pVfs)->stats.access_calls);
+    return SHIM_ROOT(pVfs)->xAccess(SHIM_ROOT(pVfs), zName, flags, pResOut);
+}
+
+static int shimFullPathname(sqlite3_vfs *pVfs, const char *zName, int nOut, char *zOut) {
+    return SHIM_ROOT(pVfs)->xFullPathname(SHIM_ROOT(pVfs), zName, nOut, zOut);
+}
+
+static void *shimDlOpen(sqlite3_vfs *pVfs, const char *zPath) {
+    return SHIM_ROOT(pVfs)->xDlOpen(SHIM_ROOT(pVfs), zPath);
+}
+
+static void shimDlError(sqlite3_vfs *pVfs, int nByte, char *zErrMsg) {
+    SHIM_ROOT(pVfs)->xDlError(SHIM_ROOT(pVfs), nByte, zErrMsg);
+}
+
+static void (*shimDlSym(sqlite3_vfs *pVfs, void *p, const char *zSym))(void) {
+    return SHIM_ROOT(pVfs)->xDlSym(SHIM_ROOT(pVfs), p, zSym);
+}
+
+static void shimDlClose(sqlite3_vfs *pVfs, void *pHandle) {
+    SHIM_ROOT(pVfs)->xDlClose(SHIM_ROOT(pVfs), pHandle);
+}
+
+static int shimRandomness(sqlite3_vfs *pVfs, int nByte, char *zOut) {
+    return SHIM_ROOT(pVfs)->xRandomness(SHIM_ROOT(pVfs), nByte, zOut);
+}
+
+static int shimSleep(sqlite3_vfs *pVfs, int microseconds) {
+    return SHIM_ROOT(pVfs)->xSleep(SHIM_ROOT(pVfs), microseconds);
+}
+
+static int shimCurrentTime(sqlite3_vfs *pVfs, double *pTime) {
+    return SHIM_ROOT(pVfs)->xCurrentTime(SHIM_ROOT(pVfs), pTime);
+}
+
+static int shimGetLastError(sqlite3_vfs *pVfs, int nErr, char *zErr) {
+    return SHIM_ROOT(pVfs)->xGetLastError ? SHIM_ROOT(pVfs)->xGetLastError(SHIM_ROOT(pVfs), nErr, zErr) : 0;
+}
+
+static int shimCurrentTimeInt64(sqlite3_vfs *pVfs, sqlite3_int64 *pTime) {
+    return SHIM_ROOT(pVfs)->xCurrentTimeInt64(SHIM_ROOT(pVfs), pTime);
+}
+
+int shim_vfs_create(const char *zName, sqlite3_vfs *pRoot, ShimVfs **ppShim) {
+    ShimVfs *pShim;
+    int rc;
+
+    *ppShim = NULL;
+    if (!zName || strlen(zName) >= sizeof(pShim->zName)) return SQLITE_MISUSE;
+    if (!pRoot) pRoot = sqlite3_vfs_find(NULL);
+    if (!pRoot) return SQLITE_ERROR;
+
+    pShim = (ShimVfs*)sqlite3_malloc(sizeof(ShimVfs));
+    if (!pShim) return SQLITE_NOMEM;
+    memset(pShim, 0, sizeof(ShimVfs));
+    strcpy(pShim->zName, zName);
+    pShim->mutex = sqlite3_mutex_alloc(SQLITE_MUTEX_FAST);
+    if (!pShim->mutex) {
+        sqlite3_free(pShim);
+        return SQLITE_NOMEM;
+    }
+
+    pShim->pRoot = pRoot;
+    pShim->base.iVersion = 2;
+    pShim->base.szOsFile = (int)sizeof(ShimFile) + pRoot->szOsFile;
+    pShim->base.mxPathname = pRoot->mxPathname;
+    pShim->base.zName = pShim->zName;
+    pShim->base.xOpen = shimOpen;
+    pShim->base.xDelete = shimDelete;
+    pShim->base.xAccess = shimAccess;
+    pShim->base.xFullPathname = shimFullPathname;
+    pShim->base.xDlOpen = shimDlOpen;
+    pShim->base.xDlError = shimDlError;
+    pShim->base.xDlSym = shimDlSym;
+    pShim->base.xDlClose = shimDlClose;
+    pShim->base.xRandomness = shimRandomness;
+    pShim->base.xSleep = shimSleep;
+    pShim->base.xCurrentTime = shimCurrentTime;
+    pShim->base.xGetLastError = shimGetLastError;
+    pShim->base.xCurrentTimeInt64 = shimCurrentTimeInt64;
+
+    rc = sqlite3_vfs_register(&pShim->base, 0);
+    if (rc != SQLITE_OK) {
+        sqlite3_mutex_free(pShim->mutex);
+        sqlite3_free(pShim);
+        return rc;
+    }
+    *ppShim = pShim;
+    return SQLITE_OK;
+}
+
+void shim_vfs_destroy(ShimVfs *pShim) {
+    if (pShim) {
+        sqlite3_vfs_unregister(&pShim->base);
+        sqlite3_mutex_free(pShim->mutex);
+        sqlite3_free(pShim);
+    }
+}
+
+void shim_vfs_get_stats(ShimVfs *pShim, ShimVfsStats *pStats) {
+    pStats->open_calls = CCVFS_COUNTER_GET(pShim->stats.open_calls);
+    pStats->close_calls = CCVFS_COUNTER_GET(pShim->stats.close_calls);
+    pStats->read_calls = CCVFS_COUNTER_GET(pShim->stats.read_calls);
+    pStats->read_bytes = CCVFS_COUNTER_GET(pShim->stats.read_bytes);
+    pStats->write_calls = CCVFS_COUNTER_GET(pShim->stats.write_calls);
+    pStats->write_bytes = CCVFS_COUNTER_GET(pShim->stats.write_bytes);
+    pStats->sync_calls = CCVFS_COUNTER_GET(pShim->stats.sync_calls);
+    pStats->truncate_calls = CCVFS_COUNTER_GET(pShim->stats.truncate_calls);
+    pStats->file_size_calls = CCVFS_COUNTER_GET(pShim->stats.file_size_calls);
+    pStats->lock_calls = CCVFS_COUNTER_GET(pShim->stats.lock_calls);
+    pStats->unlock_calls = CCVFS_COUNTER_GET(pShim->stats.unlock_calls);
+    pStats->delete_calls = CCVFS_COUNTER_GET(pShim->stats.delete_calls);
+    pStats->access_calls = CCVFS_COUNTER_GET(pShim->stats.access_calls);
+    pStats->short_reads = CCVFS_COUNTER_GET(pShim->stats.short_reads);
+    pStats->injected_errors = CCVFS_COUNTER_GET(pShim->stats.injected_errors);
+    pStats->injected_delay_us = CCVFS_COUNTER_GET(pShim->stats.injected_delay_us);
+
+    // 每个计数的调用在unix VFS上至少对应一次系统调用（open/close/pread/pwrite/fsync/
+    // ftruncate/fstat/fcntl/unlink/access）
+    // Every counted call is at least one system call on the unix VFS (open/close/pread/pwrite/
+    // fsync/ftruncate/fstat/fcntl/unlink/access)
+    pStats->syscalls = pStats->open_calls + pStats->close_calls + pStats->read_calls +
+                       pStats->write_calls + pStats->sync_calls + pStats->truncate_calls +
+                       pStats->file_size_calls + pStats->lock_calls + pStats->unlock_calls +
+                       pStats->delete_calls + pStats->access_calls;
+}
+
+void shim_vfs_reset_stats(ShimVfs *pShim) {
+    CCVFS_COUNTER_SET(pShim->stats.open_calls, 0);
+    CCVFS_COUNTER_SET(pShim->stats.close_calls, 0);
+    CCVFS_COUNTER_SET(pShim->stats.read_calls, 0);
+    CCVFS_COUNTER_SET(pShim->stats.read_bytes, 0);
+    CCVFS_COUNTER_SET(pShim->stats.write_calls, 0);
+    CCVFS_COUNTER_SET(pShim->stats.write_bytes, 0);
+    CCVFS_COUNTER_SET(pShim->stats.sync_calls, 0);
+    CCVFS_COUNTER_SET(pShim->stats.truncate_calls, 0);
+    CCVFS_COUNTER_SET(pShim->stats.file_size_calls, 0);
+    CCVFS_COUNTER_SET(pShim->stats.lock_calls, 0);
+    CCVFS_COUNTER_SET(pShim->stats.unlock_calls, 0);
+    CCVFS_COUNTER_SET(pShim->stats.delete_calls, 0);
+    CCVFS_COUNTER_SET(pShim->stats.access_calls, 0);
+    CCVFS_COUNTER_SET(pShim->stats.short_reads, 0);
+    CCVFS_COUNTER_SET(pShim->stats.injected_errors, 0);
+    CCVFS_COUNTER_SET(pShim->stats.injected_delay_us, 0);
+}
+
+void shim_vfs_init_config(ShimVfsConfig *pConfig) {
+    memset(pConfig, 0, sizeof(*pConfig));
+    pConfig->seed = 1;
+}
+
+void shim_vfs_configure(ShimVfs *pShim, const ShimVfsConfig *pConfig) {
+    sqlite3_mutex_enter(pShim->mutex);
+    pShim->config = *pConfig;
+    pShim->rng = pConfig->seed ? pConfig->seed : 1;
+    pShim->busy_until = 0;
+    CCVFS_COUNTER_SET(pShim->active, (uint32_t)(pConfig->read_latency_us || pConfig->write_latency_us ||
+                                                pConfig->sync_latency_us || pConfig->jitter_us ||
+                                                pConfig->bandwidth || pConfig->short_read_ppm ||
+                                                pConfig->read_error_ppm || pConfig->write_error_ppm ||
+                                                pConfig->sync_error_ppm));
+    sqlite3_mutex_leave(pShim->mutex);
+}
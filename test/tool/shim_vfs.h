@@ -0,0 +1,80 @@
+#ifndef SHIM_VFS_H
+#define SHIM_VFS_H
+
+#include "sqlite3.h"
+#include <stdint.h>
+
+/*
+ * Shim VFS - 测试用的透传VFS，统计底层I/O调用，并可模拟慢速存储和注入故障
+ * Test-only pass-through VFS counting the I/O calls that reach the real file system.
+ * Registered under its own name, it can be opened directly or passed to
+ * sqlite3_ccvfs_create() as pRootVfs to count what CCVFS writes underneath.
+ *
+ * 配置后可以为每次调用加入固定延迟、抖动和带宽限制，模拟网络块设备；
+ * 也可以按概率注入短读和I/O错误
+ * Once configured it adds per-call latency, jitter and a bandwidth limit to model network
+ * attached block devices, and injects short reads and I/O errors at given rates.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct ShimVfs ShimVfs;
+
+// I/O counters, all files opened through the shim
+typedef struct {
+    uint64_t open_calls;
+    uint64_t close_calls;
+    uint64_t read_calls;
+    uint64_t read_bytes;
+    uint64_t write_calls;
+    uint64_t write_bytes;
+    uint64_t sync_calls;
+    uint64_t truncate_calls;
+    uint64_t file_size_calls;
+    uint64_t lock_calls;
+    uint64_t unlock_calls;
+    uint64_t delete_calls;
+    uint64_t access_calls;
+    uint64_t syscalls;          // Calls that map to a system call on a real file system
+    uint64_t short_reads;       // Injected short reads
+    uint64_t injected_errors;   // Injected I/O errors
+    uint64_t injected_delay_us; // Total latency added by the storage model
+} ShimVfsStats;
+
+// 存储模型和故障注入，全零时为普通透传
+// Storage model and fault injection, all zero for a plain pass-through
+typedef struct {
+    uint32_t read_latency_us;   // Added to every read
+    uint32_t write_latency_us;  // Added to every write
+    uint32_t sync_latency_us;   // Added to every sync
+    uint32_t jitter_us;         // Uniform extra latency in [0, jitter_us] per read, write and sync
+    uint64_t bandwidth;         // Bytes per second of one device channel shared by all files, 0 for unlimited
+    uint32_t short_read_ppm;    // Short reads per million reads
+    uint32_t read_error_ppm;    // SQLITE_IOERR_READ per million reads
+    uint32_t write_error_ppm;   // SQLITE_IOERR_WRITE per million writes
+    uint32_t sync_error_ppm;    // SQLITE_IOERR_FSYNC per million syncs
+    int file_types;             // SQLITE_OPEN_MAIN_DB, SQLITE_OPEN_WAL... affected, 0 for all files
+    uint64_t seed;              // Seed of the latency jitter and fault draws
+} ShimVfsConfig;
+
+// Register a shim VFS named zName on top of pRoot (NULL for the default VFS)
+int shim_vfs_create(const char *zName, sqlite3_vfs *pRoot, ShimVfs **ppShim);
+
+// Unregister and free the shim, all files must be closed
+void shim_vfs_destroy(ShimVfs *pShim);
+
+// Read or reset the I/O counters
+void shim_vfs_get_stats(ShimVfs *pShim, ShimVfsStats *pStats);
+void shim_vfs_reset_stats(ShimVfs *pShim);
+
+// Set the storage model and faults, takes effect on the next call of every open file
+void shim_vfs_init_config(ShimVfsConfig *pConfig);
+void shim_vfs_configure(ShimVfs *pShim, const ShimVfsConfig *pConfig);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SHIM_VFS_H */